@@ -0,0 +1,50 @@
+// base/kaldi-simd.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <atomic>
+#include "base/kaldi-simd.h"
+
+namespace kaldi {
+
+static std::atomic<int> max_simd_level(kSimdAvx512Vnni);
+
+static SimdLevel DetectSimdLevel() {
+#ifdef KALDI_HAVE_X86_SIMD
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")
+      && __builtin_cpu_supports("avx512vl"))
+    return __builtin_cpu_supports("avx512vnni") ? kSimdAvx512Vnni :
+        kSimdAvx512;
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    return kSimdAvx2;
+#endif
+  return kSimdNone;
+}
+
+SimdLevel GetSimdLevel() {
+  static const SimdLevel cpu_level = DetectSimdLevel();
+  int max_level = max_simd_level.load(std::memory_order_relaxed);
+  return static_cast<SimdLevel>(cpu_level < max_level ? cpu_level : max_level);
+}
+
+void SetMaxSimdLevel(SimdLevel level) {
+  max_simd_level.store(level, std::memory_order_relaxed);
+}
+
+}  // namespace kaldi
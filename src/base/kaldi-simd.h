@@ -0,0 +1,63 @@
+// base/kaldi-simd.h
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_BASE_KALDI_SIMD_H_
+#define KALDI_BASE_KALDI_SIMD_H_
+
+/* Some inner loops (e.g. in feature extraction and in the quantized nnet3
+   components) have hand-written AVX2 and AVX-512 versions in addition to the
+   plain C++ one.  They are compiled with GCC/clang function attributes such as
+   __attribute__((target("avx2,fma"))), so the rest of the code does not need
+   special compiler flags and the binaries still run on older CPUs: which
+   version runs is decided at run time by GetSimdLevel().
+
+   KALDI_HAVE_X86_SIMD is defined if the compiler can build those versions.
+   Define KALDI_NO_SIMD to build only the plain C++ versions.
+*/
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && \
+  !defined(KALDI_NO_SIMD)
+#define KALDI_HAVE_X86_SIMD 1
+#endif
+
+namespace kaldi {
+
+/// The instruction sets for which there are hand-written kernels.  Each level
+/// includes the ones before it.
+enum SimdLevel {
+  kSimdNone = 0,    // plain C++.
+  kSimdAvx2 = 1,    // AVX2 and FMA (Haswell and later).
+  kSimdAvx512 = 2,  // AVX-512 F, BW and VL (Skylake-X and later).
+  kSimdAvx512Vnni = 3  // the above plus the AVX-512 VNNI 8-bit integer dot
+                       // products (Cascade Lake, Ice Lake and later).
+};
+
+/// Returns the most capable SimdLevel that both the CPU and the compiler
+/// support, but no more than the level set by SetMaxSimdLevel().  It is cheap
+/// enough to call from every kernel.
+SimdLevel GetSimdLevel();
+
+/// Limits the level that GetSimdLevel() returns, e.g. to kSimdNone to test
+/// the plain C++ versions against the vectorized ones.  The default is
+/// kSimdAvx512Vnni, i.e. no limit.
+void SetMaxSimdLevel(SimdLevel level);
+
+}  // namespace kaldi
+
+#endif  // KALDI_BASE_KALDI_SIMD_H_
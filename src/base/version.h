@@ -0,0 +1,4 @@
+// This file was automatically created by ./get_version.sh.
+// It is only included by ./kaldi-error.cc.
+#define KALDI_VERSION "5.5.33-ac73"
+#define KALDI_GIT_HEAD "ac73b13ad9c072d943b0d10d113db385d400d71c"
@@ -0,0 +1,109 @@
+// chain/chain-denominator-test.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "chain/chain-den-graph.h"
+#include "chain/chain-denominator.h"
+#include "cudamatrix/cu-device.h"
+#include "fstext/fstext-lib.h"
+#include "hmm/hmm-test-utils.h"
+
+namespace kaldi {
+namespace chain {
+
+// Makes a denominator FST from a random phone language model with only
+// monophone context (as in chain-supervision-test.cc).
+static void ComputeExampleDenFst(const ContextDependency &ctx_dep,
+                                 const TransitionModel &trans_model,
+                                 fst::StdVectorFst *den_fst) {
+  const std::vector<int32> &phones = trans_model.GetPhones();
+  fst::StdVectorFst phone_lm;
+  int32 state = phone_lm.AddState();
+  phone_lm.SetStart(state);
+  Vector<BaseFloat> probs(phones.size() + 1);
+  probs.SetRandn();
+  probs.ApplyPow(2.0);
+  probs.Add(0.01);
+  probs.Scale(1.0 / probs.Sum());
+  for (size_t i = 0; i < phones.size(); i++)
+    phone_lm.AddArc(state, fst::StdArc(phones[i], phones[i],
+                                       fst::TropicalWeight(-log(probs(i))),
+                                       state));
+  phone_lm.SetFinal(state, fst::TropicalWeight(-log(probs(phones.size()))));
+  CreateDenominatorFst(ctx_dep, trans_model, phone_lm, den_fst);
+}
+
+// Checks that the CPU denominator computation gives the same log-prob and
+// derivatives with several threads (each of which does a block of the
+// sequences) as with one, including when there are more threads than
+// sequences.
+void ChainDenominatorThreadsTest() {
+  ContextDependency *ctx_dep;
+  TransitionModel *trans_model = GenRandTransitionModel(&ctx_dep);
+  fst::StdVectorFst den_fst;
+  ComputeExampleDenFst(*ctx_dep, *trans_model, &den_fst);
+  DenominatorGraph den_graph(den_fst, trans_model->NumPdfs());
+
+  int32 num_sequences = RandInt(1, 16),
+      frames_per_sequence = RandInt(5, 50);
+  CuMatrix<BaseFloat> nnet_output(num_sequences * frames_per_sequence,
+                                  den_graph.NumPdfs());
+  nnet_output.SetRandn();
+
+  ChainTrainingOptions opts;
+  DenominatorComputation denominator_computation(opts, den_graph,
+                                                 num_sequences, nnet_output);
+  BaseFloat forward_prob = denominator_computation.Forward();
+  CuMatrix<BaseFloat> nnet_output_deriv(nnet_output.NumRows(),
+                                        nnet_output.NumCols());
+  bool ok = denominator_computation.Backward(0.5, &nnet_output_deriv);
+
+  ChainTrainingOptions opts_threaded(opts);
+  opts_threaded.num_threads = RandInt(2, 20);
+  DenominatorComputation denominator_computation_threaded(
+      opts_threaded, den_graph, num_sequences, nnet_output);
+  BaseFloat forward_prob_threaded = denominator_computation_threaded.Forward();
+  CuMatrix<BaseFloat> nnet_output_deriv_threaded(nnet_output.NumRows(),
+                                                 nnet_output.NumCols());
+  bool ok_threaded = denominator_computation_threaded.Backward(
+      0.5, &nnet_output_deriv_threaded);
+
+  KALDI_LOG << "Forward prob is " << forward_prob << " with one thread and "
+            << forward_prob_threaded << " with " << opts_threaded.num_threads
+            << " threads, for " << num_sequences << " sequences.";
+  KALDI_ASSERT(ok == ok_threaded);
+  KALDI_ASSERT(ApproxEqual(forward_prob, forward_prob_threaded, 1.0e-05));
+  KALDI_ASSERT(nnet_output_deriv.ApproxEqual(nnet_output_deriv_threaded,
+                                             1.0e-05));
+  delete ctx_dep;
+  delete trans_model;
+}
+
+}  // namespace chain
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+#if HAVE_CUDA == 1
+  // The threaded code is only used when not using a GPU.
+  CuDevice::Instantiate().SelectGpuId("no");
+#endif
+  for (int32 i = 0; i < 10; i++)
+    kaldi::chain::ChainDenominatorThreadsTest();
+  KALDI_LOG << "Success.";
+}
@@ -20,6 +20,7 @@
 
 #include "chain/chain-denominator.h"
 #include "chain/chain-kernels-ansi.h"
+#include "util/kaldi-thread.h"
 
 namespace kaldi {
 namespace chain {
@@ -103,7 +104,8 @@ void DenominatorComputation::AlphaFirstFrame() {
 }
 
 
-// the alpha computation for some 0 < t <= num_time_steps_.
+#if HAVE_CUDA == 1
+// the alpha computation for some 0 < t <= num_time_steps_, on GPU.
 void DenominatorComputation::AlphaGeneralFrame(int32 t) {
   NVTX_RANGE(__func__);
   KALDI_ASSERT(t > 0 && t <= frames_per_sequence_);
@@ -120,7 +122,6 @@ void DenominatorComputation::AlphaGeneralFrame(int32 t) {
                                (t-1) * num_sequences_, num_sequences_);
   const BaseFloat *prob_data = probs.Data();
 
-#if HAVE_CUDA == 1
   if (CuDevice::Instantiate().Enabled()) {
     CuTimer tim;
     dim3 dimBlock(std::min<int32>(CU1DBLOCK, num_sequences), 1, 1);
@@ -148,40 +149,11 @@ void DenominatorComputation::AlphaGeneralFrame(int32 t) {
       }
     }
     CuDevice::Instantiate().AccuProfile(__func__, tim);
-  } else
-#endif
-  {
-    int32 prob_stride = probs.Stride();
-    for (int32 h = 0; h < num_hmm_states; h++) {
-      for (int32 s = 0; s < num_sequences; s++) {
-        double this_tot_alpha = 0.0;
-        const DenominatorGraphTransition
-            *trans_iter = transitions + backward_transitions[h].first,
-            *trans_end = transitions + backward_transitions[h].second;
-        for (; trans_iter != trans_end; ++trans_iter) {
-          BaseFloat transition_prob = trans_iter->transition_prob;
-          int32 pdf_id = trans_iter->pdf_id,
-              prev_hmm_state = trans_iter->hmm_state;
-          BaseFloat prob = prob_data[pdf_id * prob_stride + s],
-              this_prev_alpha = prev_alpha_dash[prev_hmm_state * num_sequences + s];
-          this_tot_alpha += this_prev_alpha * transition_prob * prob;
-        }
-        // Let arbitrary_scale be the inverse of the alpha-sum value that we
-        // store in the same place we'd store the alpha for the state numbered
-        // 'num_hmm_states'. We multiply this into all the
-        // transition-probabilities from the previous frame to this frame, in
-        // both the forward and backward passes, in order to keep the alphas in
-        // a good numeric range.  This won't affect the posteriors, but when
-        // computing the total likelihood we'll need to compensate for it later
-        // on.
-        BaseFloat arbitrary_scale =
-            1.0 / prev_alpha_dash[num_hmm_states * num_sequences + s];
-        KALDI_ASSERT(this_tot_alpha - this_tot_alpha == 0);
-        this_alpha[h * num_sequences + s] = this_tot_alpha * arbitrary_scale;
-      }
-    }
+  } else {
+    KALDI_ERR << "AlphaGeneralFrame() is only for GPU; use ForwardCpu().";
   }
 }
+#endif
 
 void DenominatorComputation::AlphaDash(int32 t) {
   NVTX_RANGE(__func__);
@@ -232,12 +204,18 @@ void DenominatorComputation::Beta(int32 t) {
 
 BaseFloat DenominatorComputation::Forward() {
   NVTX_RANGE(__func__);
-  AlphaFirstFrame();
-  AlphaDash(0);
-  for (int32 t = 1; t <= frames_per_sequence_; t++) {
-    AlphaGeneralFrame(t);
-    AlphaDash(t);
+#if HAVE_CUDA == 1
+  if (CuDevice::Instantiate().Enabled()) {
+    AlphaFirstFrame();
+    AlphaDash(0);
+    for (int32 t = 1; t <= frames_per_sequence_; t++) {
+      AlphaGeneralFrame(t);
+      AlphaDash(t);
+    }
+    return ComputeTotLogLike();
   }
+#endif
+  ForwardCpu();
   return ComputeTotLogLike();
 }
 
@@ -284,33 +262,39 @@ bool DenominatorComputation::Backward(
     BaseFloat deriv_weight,
     CuMatrixBase<BaseFloat> *nnet_output_deriv) {
   NVTX_RANGE(__func__);
-  BetaDashLastFrame();
-  Beta(frames_per_sequence_);
-  for (int32 t = frames_per_sequence_ - 1; t >= 0; t--) {
-    BetaDashGeneralFrame(t);
-    if (GetVerboseLevel() >= 1 || t == 0)
-      BetaGeneralFrameDebug(t);
-    Beta(t);
-    if (t % kMaxDerivTimeSteps == 0) {
-      // commit the derivative stored in nnet_output_deriv_transposed_ by adding
-      // its transpose to the appropriate sub-matrix of 'nnet_output_deriv'.
-      int32 chunk_frames = std::min<int32>(static_cast<int32>(kMaxDerivTimeSteps),
-                                           frames_per_sequence_ - t),
-                num_pdfs = exp_nnet_output_transposed_.NumRows();
-      CuSubMatrix<BaseFloat> transposed_deriv_part(
-          nnet_output_deriv_transposed_,
-          0, num_pdfs,
-          0, chunk_frames * num_sequences_);
-      CuSubMatrix<BaseFloat> output_deriv_part(
-          *nnet_output_deriv,
-          t * num_sequences_, chunk_frames * num_sequences_,
-          0, num_pdfs);
-      output_deriv_part.AddMat(deriv_weight, transposed_deriv_part, kTrans);
-      if (t != 0)
-        transposed_deriv_part.SetZero();
+#if HAVE_CUDA == 1
+  if (CuDevice::Instantiate().Enabled()) {
+    BetaDashLastFrame();
+    Beta(frames_per_sequence_);
+    for (int32 t = frames_per_sequence_ - 1; t >= 0; t--) {
+      BetaDashGeneralFrame(t);
+      if (GetVerboseLevel() >= 1 || t == 0)
+        BetaGeneralFrameDebug(t);
+      Beta(t);
+      if (t % kMaxDerivTimeSteps == 0) {
+        // commit the derivative stored in nnet_output_deriv_transposed_ by
+        // adding its transpose to the appropriate sub-matrix of
+        // 'nnet_output_deriv'.
+        int32 chunk_frames = std::min<int32>(
+            static_cast<int32>(kMaxDerivTimeSteps), frames_per_sequence_ - t),
+            num_pdfs = exp_nnet_output_transposed_.NumRows();
+        CuSubMatrix<BaseFloat> transposed_deriv_part(
+            nnet_output_deriv_transposed_,
+            0, num_pdfs,
+            0, chunk_frames * num_sequences_);
+        CuSubMatrix<BaseFloat> output_deriv_part(
+            *nnet_output_deriv,
+            t * num_sequences_, chunk_frames * num_sequences_,
+            0, num_pdfs);
+        output_deriv_part.AddMat(deriv_weight, transposed_deriv_part, kTrans);
+        if (t != 0)
+          transposed_deriv_part.SetZero();
+      }
     }
+    return ok_;
   }
-
+#endif
+  BackwardCpu(deriv_weight, nnet_output_deriv);
   return ok_;
 }
 
@@ -334,6 +318,8 @@ void DenominatorComputation::BetaDashLastFrame() {
   beta_dash_mat.CopyRowsFromVec(inv_tot_prob);
 }
 
+#if HAVE_CUDA == 1
+// beta computation for some 0 <= t < num_time_steps_, on GPU.
 void DenominatorComputation::BetaDashGeneralFrame(int32 t) {
   NVTX_RANGE(__func__);
   KALDI_ASSERT(t >= 0 && t < frames_per_sequence_);
@@ -357,7 +343,6 @@ void DenominatorComputation::BetaDashGeneralFrame(int32 t) {
   int32 num_hmm_states = den_graph_.NumStates(),
       num_sequences = num_sequences_;
 
-#if HAVE_CUDA == 1
   if (CuDevice::Instantiate().Enabled()) {
     CuTimer tim;
     dim3 dimBlock(std::min<int32>(CU1DBLOCK, num_sequences), 1, 1);
@@ -386,41 +371,11 @@ void DenominatorComputation::BetaDashGeneralFrame(int32 t) {
       }
     }
     CuDevice::Instantiate().AccuProfile(__func__, tim);
-  } else
-#endif
-  {
-    int32 prob_stride = probs.Stride(),
-         deriv_stride = log_prob_deriv.Stride();
-    const BaseFloat *prob_data = probs.Data();
-    BaseFloat *log_prob_deriv_data = log_prob_deriv.Data();
-    for (int32 h = 0; h < num_hmm_states; h++) {
-      for (int32 s = 0; s < num_sequences; s++) {
-        BaseFloat this_alpha_dash_prob = this_alpha_dash[h * num_sequences + s],
-            inv_arbitrary_scale =
-            this_alpha_dash[num_hmm_states * num_sequences + s];
-        double tot_variable_factor = 0.0;
-        BaseFloat occupation_factor = this_alpha_dash_prob /
-            inv_arbitrary_scale;
-        const DenominatorGraphTransition
-            *trans_iter = transitions + forward_transitions[h].first,
-            *trans_end = transitions + forward_transitions[h].second;
-        for (; trans_iter != trans_end; ++trans_iter) {
-          BaseFloat transition_prob = trans_iter->transition_prob;
-          int32 pdf_id = trans_iter->pdf_id,
-              next_hmm_state = trans_iter->hmm_state;
-          BaseFloat variable_factor = transition_prob *
-              next_beta[next_hmm_state * num_sequences + s] *
-              prob_data[pdf_id * prob_stride + s];
-          tot_variable_factor += variable_factor;
-          BaseFloat occupation_prob = variable_factor * occupation_factor;
-          log_prob_deriv_data[pdf_id * deriv_stride + s] += occupation_prob;
-        }
-        this_beta_dash[h * num_sequences + s] =
-            tot_variable_factor / inv_arbitrary_scale;
-      }
-    }
+  } else {
+    KALDI_ERR << "BetaDashGeneralFrame() is only for GPU; use BackwardCpu().";
   }
 }
+#endif
 
 void DenominatorComputation::BetaGeneralFrameDebug(int32 t) {
   BaseFloat num_hmm_states = den_graph_.NumStates(),
@@ -459,5 +414,350 @@ void DenominatorComputation::BetaGeneralFrameDebug(int32 t) {
 }
 
 
+// Runs ForwardCpu(seq_begin, seq_end) or BackwardCpu(..., seq_begin, seq_end,
+// ...) for the thread's block of sequences.
+class DenominatorComputation::CpuThreadClass: public MultiThreadable {
+ public:
+  // If nnet_output_deriv is NULL, does the forward computation; otherwise
+  // the backward computation, and sets (*ok)[thread-index].
+  CpuThreadClass(DenominatorComputation *computation,
+                 BaseFloat deriv_weight,
+                 CuMatrixBase<BaseFloat> *nnet_output_deriv,
+                 std::vector<char> *ok):
+      computation_(computation), deriv_weight_(deriv_weight),
+      nnet_output_deriv_(nnet_output_deriv), ok_(ok) { }
+  void operator() () {
+    int32 num_sequences = computation_->num_sequences_,
+        seq_begin = num_sequences * thread_id_ / num_threads_,
+        seq_end = num_sequences * (thread_id_ + 1) / num_threads_;
+    if (nnet_output_deriv_ == NULL)
+      computation_->ForwardCpu(seq_begin, seq_end);
+    else
+      (*ok_)[thread_id_] = computation_->BackwardCpu(
+          deriv_weight_, seq_begin, seq_end, nnet_output_deriv_);
+  }
+ private:
+  DenominatorComputation *computation_;
+  BaseFloat deriv_weight_;
+  CuMatrixBase<BaseFloat> *nnet_output_deriv_;
+  std::vector<char> *ok_;
+};
+
+int32 DenominatorComputation::NumCpuThreads() const {
+  return std::max<int32>(1, std::min<int32>(opts_.num_threads,
+                                            num_sequences_));
+}
+
+void DenominatorComputation::ForwardCpu() {
+  NVTX_RANGE(__func__);
+  int32 num_threads = NumCpuThreads();
+  CpuThreadClass c(this, 0.0, NULL, NULL);
+  // With num_threads == 0, MultiThreader runs it in this thread.
+  MultiThreader<CpuThreadClass> m(num_threads == 1 ? 0 : num_threads, c);
+}
+
+void DenominatorComputation::BackwardCpu(
+    BaseFloat deriv_weight,
+    CuMatrixBase<BaseFloat> *nnet_output_deriv) {
+  NVTX_RANGE(__func__);
+  int32 num_threads = NumCpuThreads();
+  std::vector<char> ok(num_threads, 1);
+  {
+    CpuThreadClass c(this, deriv_weight, nnet_output_deriv, &ok);
+    MultiThreader<CpuThreadClass> m(num_threads == 1 ? 0 : num_threads, c);
+  }
+  for (int32 i = 0; i < num_threads; i++)
+    if (!ok[i]) ok_ = false;
+  // The threads left the beta-dash of frame 0 for this check, which is always
+  // done (see Backward()).
+  BetaGeneralFrameDebug(0);
+}
+
+void DenominatorComputation::ForwardCpu(int32 seq_begin, int32 seq_end) {
+  int32 num_hmm_states = den_graph_.NumStates(),
+      num_sequences = num_sequences_,
+      block_size = seq_end - seq_begin,
+      prob_stride = exp_nnet_output_transposed_.Stride();
+  const Int32Pair *backward_transitions = den_graph_.BackwardTransitions();
+  const DenominatorGraphTransition *transitions = den_graph_.Transitions();
+  const BaseFloat *initial_probs = den_graph_.InitialProbs().Data();
+  std::vector<double> tot_alpha(block_size);
+  std::vector<BaseFloat> arbitrary_scale(block_size);
+
+  // Frame 0: see AlphaFirstFrame().
+  BaseFloat *first_frame_alpha = alpha_.RowData(0) + seq_begin;
+  for (int32 h = 0; h < num_hmm_states; h++)
+    for (int32 i = 0; i < block_size; i++)
+      first_frame_alpha[h * num_sequences + i] = initial_probs[h];
+  AlphaDashCpu(0, seq_begin, seq_end);
+
+  for (int32 t = 1; t <= frames_per_sequence_; t++) {
+    BaseFloat *this_alpha = alpha_.RowData(t) + seq_begin;
+    const BaseFloat *prev_alpha_dash = alpha_.RowData(t - 1) + seq_begin,
+        *prob_data = exp_nnet_output_transposed_.Data() +
+        (t - 1) * num_sequences + seq_begin;
+    // Let arbitrary_scale be the inverse of the alpha-sum value that we store
+    // in the same place we'd store the alpha for the state numbered
+    // 'num_hmm_states'. We multiply this into all the transition-probabilities
+    // from the previous frame to this frame, in both the forward and backward
+    // passes, in order to keep the alphas in a good numeric range.  This won't
+    // affect the posteriors, but when computing the total likelihood we'll
+    // need to compensate for it later on.
+    for (int32 i = 0; i < block_size; i++)
+      arbitrary_scale[i] =
+          1.0 / prev_alpha_dash[num_hmm_states * num_sequences + i];
+    double *tot = tot_alpha.data();
+    for (int32 h = 0; h < num_hmm_states; h++) {
+      std::fill(tot_alpha.begin(), tot_alpha.end(), 0.0);
+      const DenominatorGraphTransition
+          *trans_iter = transitions + backward_transitions[h].first,
+          *trans_end = transitions + backward_transitions[h].second;
+      // Two transitions at a time (as in the CUDA kernel), which halves the
+      // number of times 'tot' is read and written.
+      for (; trans_iter + 1 < trans_end; trans_iter += 2) {
+        BaseFloat transition_prob0 = trans_iter[0].transition_prob,
+            transition_prob1 = trans_iter[1].transition_prob;
+        const BaseFloat
+            *prob0 = prob_data + trans_iter[0].pdf_id * prob_stride,
+            *prob1 = prob_data + trans_iter[1].pdf_id * prob_stride,
+            *prev_alpha0 = prev_alpha_dash +
+            trans_iter[0].hmm_state * num_sequences,
+            *prev_alpha1 = prev_alpha_dash +
+            trans_iter[1].hmm_state * num_sequences;
+        for (int32 i = 0; i < block_size; i++)
+          tot[i] += prev_alpha0[i] * transition_prob0 * prob0[i] +
+              prev_alpha1[i] * transition_prob1 * prob1[i];
+      }
+      if (trans_iter != trans_end) {
+        BaseFloat transition_prob = trans_iter->transition_prob;
+        const BaseFloat *prob = prob_data + trans_iter->pdf_id * prob_stride,
+            *prev_alpha = prev_alpha_dash +
+            trans_iter->hmm_state * num_sequences;
+        for (int32 i = 0; i < block_size; i++)
+          tot[i] += prev_alpha[i] * transition_prob * prob[i];
+      }
+      BaseFloat *this_state_alpha = this_alpha + h * num_sequences;
+      for (int32 i = 0; i < block_size; i++)
+        this_state_alpha[i] = tot[i] * arbitrary_scale[i];
+    }
+    AlphaDashCpu(t, seq_begin, seq_end);
+  }
+}
+
+void DenominatorComputation::AlphaDashCpu(int32 t, int32 seq_begin,
+                                          int32 seq_end) {
+  int32 num_hmm_states = den_graph_.NumStates(),
+      num_sequences = num_sequences_,
+      block_size = seq_end - seq_begin;
+  const BaseFloat *initial_probs = den_graph_.InitialProbs().Data();
+  BaseFloat *this_alpha = alpha_.RowData(t) + seq_begin,
+      *alpha_sum = this_alpha + num_hmm_states * num_sequences;
+  // the alpha-dash is the sum of alpha over all states.
+  for (int32 i = 0; i < block_size; i++)
+    alpha_sum[i] = 0.0;
+  for (int32 h = 0; h < num_hmm_states; h++) {
+    const BaseFloat *this_state_alpha = this_alpha + h * num_sequences;
+    for (int32 i = 0; i < block_size; i++)
+      alpha_sum[i] += this_state_alpha[i];
+  }
+  // This catches NaNs and infinities in any of the alphas.
+  for (int32 i = 0; i < block_size; i++)
+    KALDI_ASSERT(alpha_sum[i] - alpha_sum[i] == 0);
+  for (int32 h = 0; h < num_hmm_states; h++) {
+    BaseFloat *this_state_alpha = this_alpha + h * num_sequences;
+    BaseFloat scale = opts_.leaky_hmm_coefficient * initial_probs[h];
+    for (int32 i = 0; i < block_size; i++)
+      this_state_alpha[i] += scale * alpha_sum[i];
+  }
+}
+
+bool DenominatorComputation::BackwardCpu(
+    BaseFloat deriv_weight, int32 seq_begin, int32 seq_end,
+    CuMatrixBase<BaseFloat> *nnet_output_deriv) {
+  int32 num_hmm_states = den_graph_.NumStates(),
+      num_sequences = num_sequences_,
+      num_pdfs = exp_nnet_output_transposed_.NumRows(),
+      block_size = seq_end - seq_begin,
+      prob_stride = exp_nnet_output_transposed_.Stride(),
+      deriv_stride = nnet_output_deriv_transposed_.Stride();
+  const Int32Pair *forward_transitions = den_graph_.ForwardTransitions();
+  const DenominatorGraphTransition *transitions = den_graph_.Transitions();
+  std::vector<double> tot_variable_factor(block_size);
+  std::vector<BaseFloat> occupation_factor(block_size);
+  bool ok = true;
+
+  // The last frame: see BetaDashLastFrame().
+  int32 T = frames_per_sequence_;
+  const BaseFloat *tot_prob = tot_prob_.Data() + seq_begin;
+  BaseFloat *last_frame_beta_dash = beta_.RowData(T % 2) + seq_begin;
+  for (int32 h = 0; h < num_hmm_states; h++)
+    for (int32 i = 0; i < block_size; i++)
+      last_frame_beta_dash[h * num_sequences + i] = 1.0 / tot_prob[i];
+  BetaCpu(T, seq_begin, seq_end);
+
+  for (int32 t = T - 1; t >= 0; t--) {
+    // See BetaDashGeneralFrame() for t_wrapped.
+    int32 t_wrapped = t % static_cast<int32>(kMaxDerivTimeSteps);
+    const BaseFloat *this_alpha_dash = alpha_.RowData(t) + seq_begin,
+        *next_beta = beta_.RowData((t + 1) % 2) + seq_begin,
+        *prob_data = exp_nnet_output_transposed_.Data() +
+        t * num_sequences + seq_begin,
+        *inv_arbitrary_scale = this_alpha_dash + num_hmm_states * num_sequences;
+    BaseFloat *this_beta_dash = beta_.RowData(t % 2) + seq_begin,
+        *log_prob_deriv_data = nnet_output_deriv_transposed_.Data() +
+        t_wrapped * num_sequences + seq_begin;
+    double *tot = tot_variable_factor.data();
+    BaseFloat *occupation = occupation_factor.data();
+    for (int32 h = 0; h < num_hmm_states; h++) {
+      const BaseFloat *this_state_alpha_dash =
+          this_alpha_dash + h * num_sequences;
+      for (int32 i = 0; i < block_size; i++) {
+        occupation[i] = this_state_alpha_dash[i] / inv_arbitrary_scale[i];
+        tot[i] = 0.0;
+      }
+      const DenominatorGraphTransition
+          *trans_iter = transitions + forward_transitions[h].first,
+          *trans_end = transitions + forward_transitions[h].second;
+      // Two transitions at a time, as in ForwardCpu().
+      for (; trans_iter + 1 < trans_end; trans_iter += 2) {
+        BaseFloat transition_prob0 = trans_iter[0].transition_prob,
+            transition_prob1 = trans_iter[1].transition_prob;
+        int32 pdf_id0 = trans_iter[0].pdf_id, pdf_id1 = trans_iter[1].pdf_id;
+        const BaseFloat *prob0 = prob_data + pdf_id0 * prob_stride,
+            *prob1 = prob_data + pdf_id1 * prob_stride,
+            *beta0 = next_beta + trans_iter[0].hmm_state * num_sequences,
+            *beta1 = next_beta + trans_iter[1].hmm_state * num_sequences;
+        BaseFloat *deriv0 = log_prob_deriv_data + pdf_id0 * deriv_stride,
+            *deriv1 = log_prob_deriv_data + pdf_id1 * deriv_stride;
+        for (int32 i = 0; i < block_size; i++) {
+          BaseFloat variable_factor0 = transition_prob0 * beta0[i] * prob0[i],
+              variable_factor1 = transition_prob1 * beta1[i] * prob1[i];
+          tot[i] += variable_factor0 + variable_factor1;
+          deriv0[i] += variable_factor0 * occupation[i];
+          deriv1[i] += variable_factor1 * occupation[i];
+        }
+      }
+      if (trans_iter != trans_end) {
+        BaseFloat transition_prob = trans_iter->transition_prob;
+        int32 pdf_id = trans_iter->pdf_id;
+        const BaseFloat *prob = prob_data + pdf_id * prob_stride,
+            *beta = next_beta + trans_iter->hmm_state * num_sequences;
+        BaseFloat *deriv = log_prob_deriv_data + pdf_id * deriv_stride;
+        for (int32 i = 0; i < block_size; i++) {
+          BaseFloat variable_factor = transition_prob * beta[i] * prob[i];
+          tot[i] += variable_factor;
+          deriv[i] += variable_factor * occupation[i];
+        }
+      }
+      BaseFloat *this_state_beta_dash = this_beta_dash + h * num_sequences;
+      for (int32 i = 0; i < block_size; i++)
+        this_state_beta_dash[i] = tot[i] / inv_arbitrary_scale[i];
+    }
+    if (t > 0) {
+      if (GetVerboseLevel() >= 1 &&
+          !BetaGeneralFrameDebugCpu(t, seq_begin, seq_end))
+        ok = false;
+      BetaCpu(t, seq_begin, seq_end);
+    }
+    if (t % kMaxDerivTimeSteps == 0) {
+      // commit the derivative stored in nnet_output_deriv_transposed_ for
+      // these sequences by adding it to the corresponding rows of
+      // 'nnet_output_deriv'.
+      int32 chunk_frames = std::min<int32>(
+          static_cast<int32>(kMaxDerivTimeSteps), frames_per_sequence_ - t);
+      const BaseFloat *transposed_deriv = nnet_output_deriv_transposed_.Data();
+      for (int32 f = 0; f < chunk_frames; f++) {
+        for (int32 s = seq_begin; s < seq_end; s++) {
+          BaseFloat *output_deriv_row =
+              nnet_output_deriv->RowData((t + f) * num_sequences + s);
+          const BaseFloat *transposed_deriv_col =
+              transposed_deriv + f * num_sequences + s;
+          for (int32 p = 0; p < num_pdfs; p++)
+            output_deriv_row[p] +=
+                deriv_weight * transposed_deriv_col[p * deriv_stride];
+        }
+      }
+      if (t != 0) {
+        for (int32 p = 0; p < num_pdfs; p++)
+          for (int32 f = 0; f < chunk_frames; f++)
+            std::fill_n(nnet_output_deriv_transposed_.RowData(p) +
+                        f * num_sequences + seq_begin, block_size, 0.0);
+      }
+    }
+  }
+  return ok;
+}
+
+void DenominatorComputation::BetaCpu(int32 t, int32 seq_begin,
+                                     int32 seq_end) {
+  int32 num_hmm_states = den_graph_.NumStates(),
+      num_sequences = num_sequences_,
+      block_size = seq_end - seq_begin;
+  const BaseFloat *initial_probs = den_graph_.InitialProbs().Data();
+  BaseFloat *this_beta_dash = beta_.RowData(t % 2) + seq_begin,
+      *beta_dash_sum = this_beta_dash + num_hmm_states * num_sequences;
+  // the beta-dash-sum for each sequence is the sum over all states i of
+  // beta_i * opts_.leaky_hmm_coefficient * initial_prob_i.
+  for (int32 i = 0; i < block_size; i++)
+    beta_dash_sum[i] = 0.0;
+  for (int32 h = 0; h < num_hmm_states; h++) {
+    const BaseFloat *this_state_beta_dash = this_beta_dash + h * num_sequences;
+    BaseFloat scale = opts_.leaky_hmm_coefficient * initial_probs[h];
+    for (int32 i = 0; i < block_size; i++)
+      beta_dash_sum[i] += scale * this_state_beta_dash[i];
+  }
+  // compute beta in place from beta-dash.
+  for (int32 h = 0; h < num_hmm_states; h++) {
+    BaseFloat *this_state_beta = this_beta_dash + h * num_sequences;
+    for (int32 i = 0; i < block_size; i++)
+      this_state_beta[i] += beta_dash_sum[i];
+  }
+}
+
+bool DenominatorComputation::BetaGeneralFrameDebugCpu(int32 t,
+                                                      int32 seq_begin,
+                                                      int32 seq_end) {
+  int32 num_hmm_states = den_graph_.NumStates(),
+      num_sequences = num_sequences_,
+      num_pdfs = exp_nnet_output_transposed_.NumRows(),
+      block_size = seq_end - seq_begin,
+      t_wrapped = t % static_cast<int32>(kMaxDerivTimeSteps);
+  const BaseFloat *this_alpha_dash = alpha_.RowData(t) + seq_begin,
+      *this_beta_dash = beta_.RowData(t % 2) + seq_begin;
+  double alpha_beta_product = 0.0, this_log_prob_deriv_sum = 0.0;
+  for (int32 h = 0; h < num_hmm_states; h++)
+    for (int32 i = 0; i < block_size; i++)
+      alpha_beta_product += this_alpha_dash[h * num_sequences + i] *
+          this_beta_dash[h * num_sequences + i];
+  for (int32 p = 0; p < num_pdfs; p++) {
+    const BaseFloat *deriv = nnet_output_deriv_transposed_.RowData(p) +
+        t_wrapped * num_sequences + seq_begin;
+    for (int32 i = 0; i < block_size; i++)
+      this_log_prob_deriv_sum += deriv[i];
+  }
+  bool ok = true;
+  // As in BetaGeneralFrameDebug(), but each sequence should contribute one.
+  if (!ApproxEqual(alpha_beta_product, block_size)) {
+    KALDI_WARN << "On time " << t << ", alpha-beta product "
+               << alpha_beta_product << " != " << block_size
+               << " for sequences " << seq_begin << " to " << (seq_end - 1);
+    if (fabs(alpha_beta_product - block_size) > 2.0) {
+      KALDI_WARN << "Excessive error detected, will abandon this minibatch";
+      ok = false;
+    }
+  }
+  if (!ApproxEqual(this_log_prob_deriv_sum, block_size, 0.01)) {
+    KALDI_WARN << "On time " << t << ", log-prob-deriv sum "
+               << this_log_prob_deriv_sum << " != " << block_size
+               << " for sequences " << seq_begin << " to " << (seq_end - 1);
+    if (fabs(this_log_prob_deriv_sum - block_size) > 2.0) {
+      KALDI_WARN << "Excessive error detected, will abandon this minibatch";
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+
 }  // namespace chain
 }  // namespace kaldi
@@ -233,8 +233,11 @@ class DenominatorComputation {
 
   // sets up the alpha for frame t = 0.
   void AlphaFirstFrame();
-  // the alpha computation for some 0 < t <= num_time_steps_.
+#if HAVE_CUDA == 1
+  // the alpha computation for some 0 < t <= num_time_steps_ (GPU only; on
+  // CPU, see ForwardCpu()).
   void AlphaGeneralFrame(int32 t);
+#endif
   // does the 'alpha-dash' computation for time t.  this relates to
   // 'leaky hmm'.
   void AlphaDash(int32 t);
@@ -247,8 +250,11 @@ class DenominatorComputation {
   BaseFloat ComputeTotLogLike();
 
   void BetaDashLastFrame();
-  // beta computation for 0 <= beta < num_time_steps_.
+#if HAVE_CUDA == 1
+  // beta computation for 0 <= beta < num_time_steps_ (GPU only; on CPU, see
+  // BackwardCpu()).
   void BetaDashGeneralFrame(int32 t);
+#endif
   // compute the beta quantity from the beta-dash quantity (relates to leaky hmm).
   void Beta(int32 t);
 
@@ -256,6 +262,37 @@ class DenominatorComputation {
   // Sets ok_ to false if a bad problem is detected.
   void BetaGeneralFrameDebug(int32 t);
 
+  // The CPU versions of Forward() and Backward().  The sequences are
+  // independent of each other, so they are divided into contiguous blocks, one
+  // per thread (see opts_.num_threads), and each thread does the whole
+  // computation for its block; the functions below with a 'seq_begin' and
+  // 'seq_end' argument are what each thread runs.  The values for a state are
+  // contiguous over the sequences, so the inner loops, which are over the
+  // sequences of the block, are vectorized by the compiler.
+  void ForwardCpu();
+  void BackwardCpu(BaseFloat deriv_weight,
+                   CuMatrixBase<BaseFloat> *nnet_output_deriv);
+  class CpuThreadClass;
+  int32 NumCpuThreads() const;
+
+  // Does the alpha computation for all frames, for sequences
+  // seq_begin <= s < seq_end.
+  void ForwardCpu(int32 seq_begin, int32 seq_end);
+  // Does AlphaDash(t) for sequences seq_begin <= s < seq_end.
+  void AlphaDashCpu(int32 t, int32 seq_begin, int32 seq_end);
+  // Does the beta computation for all frames for sequences
+  // seq_begin <= s < seq_end, and adds deriv_weight times their derivatives to
+  // 'nnet_output_deriv'.  It leaves the beta-dash (not the beta) for frame 0,
+  // for BetaGeneralFrameDebug(0).  Returns false if a bad problem was
+  // detected (this is only checked at verbose level >= 1).
+  bool BackwardCpu(BaseFloat deriv_weight, int32 seq_begin, int32 seq_end,
+                   CuMatrixBase<BaseFloat> *nnet_output_deriv);
+  // Does Beta(t) for sequences seq_begin <= s < seq_end.
+  void BetaCpu(int32 t, int32 seq_begin, int32 seq_end);
+  // Does the checks of BetaGeneralFrameDebug(t) for sequences
+  // seq_begin <= s < seq_end, and returns false if a bad problem is detected.
+  bool BetaGeneralFrameDebugCpu(int32 t, int32 seq_begin, int32 seq_end);
+
   const ChainTrainingOptions &opts_;
   const DenominatorGraph &den_graph_;
 
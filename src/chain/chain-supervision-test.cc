@@ -68,7 +68,48 @@ void ComputeExampleDenFst(const ContextDependency &ctx_dep,
 }
 
 
+// Writes 'supervision' in binary mode in the format that was used before
+// <VarintFst>, in which the FST is a StdCompactAcceptorFst.
+void WriteSupervisionOldFormat(const Supervision &supervision,
+                               std::ostream &os) {
+  KALDI_ASSERT(supervision.e2e_fsts.empty());
+  WriteToken(os, true, "<Supervision>");
+  WriteToken(os, true, "<Weight>");
+  WriteBasicType(os, true, supervision.weight);
+  WriteToken(os, true, "<NumSequences>");
+  WriteBasicType(os, true, supervision.num_sequences);
+  WriteToken(os, true, "<FramesPerSeq>");
+  WriteBasicType(os, true, supervision.frames_per_sequence);
+  WriteToken(os, true, "<LabelDim>");
+  WriteBasicType(os, true, supervision.label_dim);
+  WriteToken(os, true, "<End2End>");
+  WriteBasicType(os, true, false);
+  fst::FstWriteOptions write_options("<unknown>");
+  fst::StdCompactAcceptorFst::WriteFst(
+      supervision.fst, fst::AcceptorCompactor<fst::StdArc>(), os,
+      write_options);
+  if (!supervision.alignment_pdfs.empty()) {
+    WriteToken(os, true, "<AlignmentPdfs>");
+    WriteIntegerVector(os, true, supervision.alignment_pdfs);
+  }
+  WriteToken(os, true, "</Supervision>");
+}
+
 void TestSupervisionIo(const Supervision &supervision) {
+  if (supervision.e2e_fsts.empty()) {
+    // Check that we can read the old format, and that the new one is smaller.
+    std::ostringstream os_old, os_new;
+    WriteSupervisionOldFormat(supervision, os_old);
+    supervision.Write(os_new, true);
+    std::istringstream is(os_old.str());
+    Supervision supervision2;
+    supervision2.Read(is, true);
+    KALDI_ASSERT(supervision == supervision2);
+    KALDI_LOG << "Size of supervision is " << os_new.str().size()
+              << " bytes, versus " << os_old.str().size()
+              << " in the old format.";
+    KALDI_ASSERT(os_new.str().size() < os_old.str().size());
+  }
   bool binary = (RandInt(0, 1) == 0);
   std::ostringstream os;
   supervision.Write(os, binary);
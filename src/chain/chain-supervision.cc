@@ -21,6 +21,7 @@
 #include "lat/lattice-functions.h"
 #include "util/text-utils.h"
 #include "hmm/hmm-utils.h"
+#include <cstring>
 #include <numeric>
 
 namespace kaldi {
@@ -546,6 +547,184 @@ void SortBreadthFirstSearch(fst::StdVectorFst *fst) {
 
 
 
+// The FSTs of class Supervision are acceptors whose states are numbered
+// roughly in order of time, so most arcs go to a nearby state.  In binary mode
+// we write them in the following format, which is typically about half the
+// size of fst::StdCompactAcceptorFst (which we used to use, and can still
+// read).  After the token <VarintFst>, the format version (currently 1) and
+// the number of bytes of the data, everything is a varint (7 bits per byte,
+// least significant first, the high bit set on all but the last byte) or a
+// raw float:
+//   num-states, start-state + 1,
+//   then for each state: num-arcs * 4 + f, where f is 0 if the state is not
+//   final, 1 if its final-cost is 0 and 2 if it is followed by the final-cost,
+//   then for each arc: the zigzag-coded difference between its label and that
+//   of the previous arc, then the zigzag-coded difference between its
+//   nextstate and the state, times 2, plus 1 if it is followed by its
+//   (nonzero) cost.
+static const int32 kVarintFstVersion = 1;
+
+static inline void AppendVarint(uint64 value, std::string *buf) {
+  while (value >= 0x80) {
+    buf->push_back(static_cast<char>((value & 0x7F) | 0x80));
+    value >>= 7;
+  }
+  buf->push_back(static_cast<char>(value));
+}
+
+static inline void AppendFloat(float value, std::string *buf) {
+  buf->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static inline uint64 ZigzagEncode(int64 value) {
+  return (static_cast<uint64>(value) << 1) ^ static_cast<uint64>(value >> 63);
+}
+
+static inline int64 ZigzagDecode(uint64 value) {
+  return static_cast<int64>(value >> 1) ^ -static_cast<int64>(value & 1);
+}
+
+// Reads from the data in [*cur, end), advancing *cur.
+static inline uint64 ParseVarint(const char **cur, const char *end) {
+  uint64 ans = 0;
+  for (int32 shift = 0; shift < 64; shift += 7) {
+    if (*cur == end)
+      KALDI_ERR << "Unexpected end of data reading compact FST.";
+    uint64 byte = static_cast<unsigned char>(*((*cur)++));
+    ans |= (byte & 0x7F) << shift;
+    if (!(byte & 0x80))
+      return ans;
+  }
+  KALDI_ERR << "Bad varint reading compact FST.";
+  return 0;
+}
+
+static inline float ParseFloat(const char **cur, const char *end) {
+  float ans;
+  if (end - *cur < static_cast<ptrdiff_t>(sizeof(ans)))
+    KALDI_ERR << "Unexpected end of data reading compact FST.";
+  memcpy(&ans, *cur, sizeof(ans));
+  *cur += sizeof(ans);
+  return ans;
+}
+
+static void WriteVarintFst(std::ostream &os, const fst::StdVectorFst &fst) {
+  typedef fst::StdArc::Weight Weight;
+  std::string buf;
+  int32 num_states = fst.NumStates();
+  AppendVarint(num_states, &buf);
+  AppendVarint(fst.Start() + 1, &buf);
+  int64 prev_label = 0;
+  for (int32 s = 0; s < num_states; s++) {
+    Weight final_weight = fst.Final(s);
+    uint64 num_arcs = fst.NumArcs(s);
+    if (final_weight == Weight::Zero()) {
+      AppendVarint(num_arcs * 4, &buf);
+    } else if (final_weight == Weight::One()) {
+      AppendVarint(num_arcs * 4 + 1, &buf);
+    } else {
+      AppendVarint(num_arcs * 4 + 2, &buf);
+      AppendFloat(final_weight.Value(), &buf);
+    }
+    for (fst::ArcIterator<fst::StdVectorFst> aiter(fst, s); !aiter.Done();
+         aiter.Next()) {
+      const fst::StdArc &arc = aiter.Value();
+      KALDI_ASSERT(arc.ilabel == arc.olabel);  // We only store one label.
+      AppendVarint(ZigzagEncode(arc.ilabel - prev_label), &buf);
+      prev_label = arc.ilabel;
+      bool has_weight = (arc.weight != Weight::One());
+      AppendVarint(ZigzagEncode(arc.nextstate - s) * 2 + (has_weight ? 1 : 0),
+                   &buf);
+      if (has_weight)
+        AppendFloat(arc.weight.Value(), &buf);
+    }
+  }
+  WriteToken(os, true, "<VarintFst>");
+  WriteBasicType(os, true, kVarintFstVersion);
+  WriteBasicType(os, true, static_cast<int32>(buf.size()));
+  os.write(buf.data(), buf.size());
+}
+
+// Reads the rest of the FST, after the <VarintFst> token.
+static void ReadVarintFst(std::istream &is, fst::StdVectorFst *fst) {
+  typedef fst::StdArc::Weight Weight;
+  int32 version, num_bytes;
+  ReadBasicType(is, true, &version);
+  if (version != kVarintFstVersion)
+    KALDI_ERR << "Unsupported version " << version << " of compact FST "
+              << "format (expected " << kVarintFstVersion
+              << "); you may need to recompile.";
+  ReadBasicType(is, true, &num_bytes);
+  if (num_bytes <= 0)
+    KALDI_ERR << "Bad size " << num_bytes << " reading compact FST.";
+  std::string buf(num_bytes, '\0');
+  if (!is.read(&(buf[0]), num_bytes))
+    KALDI_ERR << "Error reading compact FST.";
+  const char *cur = buf.data(), *end = buf.data() + buf.size();
+  uint64 num_states = ParseVarint(&cur, end);
+  if (num_states > buf.size())  // Every state takes at least one byte.
+    KALDI_ERR << "Bad number of states reading compact FST.";
+  fst->DeleteStates();
+  fst->ReserveStates(num_states);
+  for (uint64 s = 0; s < num_states; s++)
+    fst->AddState();
+  int64 start = static_cast<int64>(ParseVarint(&cur, end)) - 1;
+  if (start >= 0)
+    fst->SetStart(start);
+  int64 label = 0;
+  for (uint64 s = 0; s < num_states; s++) {
+    uint64 code = ParseVarint(&cur, end), num_arcs = code / 4;
+    if (code % 4 == 1)
+      fst->SetFinal(s, Weight::One());
+    else if (code % 4 == 2)
+      fst->SetFinal(s, Weight(ParseFloat(&cur, end)));
+    if (num_arcs > static_cast<uint64>(end - cur))
+      KALDI_ERR << "Bad number of arcs reading compact FST.";
+    fst->ReserveArcs(s, num_arcs);
+    for (uint64 i = 0; i < num_arcs; i++) {
+      label += ZigzagDecode(ParseVarint(&cur, end));
+      uint64 code = ParseVarint(&cur, end);
+      int64 nextstate = static_cast<int64>(s) + ZigzagDecode(code / 2);
+      if (nextstate < 0 || nextstate >= static_cast<int64>(num_states))
+        KALDI_ERR << "Bad nextstate reading compact FST.";
+      Weight weight = ((code & 1) ? Weight(ParseFloat(&cur, end)) :
+                       Weight::One());
+      fst->AddArc(s, fst::StdArc(label, label, weight, nextstate));
+    }
+  }
+  if (cur != end)
+    KALDI_ERR << "Unexpected data at the end of compact FST.";
+}
+
+static void WriteSupervisionFst(std::ostream &os, bool binary,
+                                const fst::StdVectorFst &fst) {
+  if (binary == false) {
+    // In text mode, write the FST without any compactification.
+    WriteFstKaldi(os, binary, fst);
+  } else {
+    WriteVarintFst(os, fst);
+  }
+}
+
+static void ReadSupervisionFst(std::istream &is, bool binary,
+                               fst::StdVectorFst *fst) {
+  if (!binary) {
+    ReadFstKaldi(is, binary, fst);
+  } else if (PeekToken(is, binary) == 'V') {
+    ExpectToken(is, binary, "<VarintFst>");
+    ReadVarintFst(is, fst);
+  } else {
+    // The format we used to write, using StdCompactAcceptorFst.
+    fst::StdCompactAcceptorFst *compact_fst =
+        fst::StdCompactAcceptorFst::Read(
+            is, fst::FstReadOptions(std::string("[unknown]")));
+    if (compact_fst == NULL)
+      KALDI_ERR << "Error reading compact FST from disk";
+    *fst = *compact_fst;
+    delete compact_fst;
+  }
+}
+
 void Supervision::Write(std::ostream &os, bool binary) const {
   WriteToken(os, binary, "<Supervision>");
   WriteToken(os, binary, "<Weight>");
@@ -564,33 +743,12 @@ void Supervision::Write(std::ostream &os, bool binary) const {
   // reasons.
   WriteBasicType(os, binary, e2e);
   if (!e2e) {
-    if (binary == false) {
-      // In text mode, write the FST without any compactification.
-      WriteFstKaldi(os, binary, fst);
-    } else {
-      // Write using StdAcceptorCompactFst, making use of the fact that it's an
-      // acceptor.
-      fst::FstWriteOptions write_options("<unknown>");
-      fst::StdCompactAcceptorFst::WriteFst(
-          fst, fst::AcceptorCompactor<fst::StdArc>(), os,
-          write_options);
-    }
+    WriteSupervisionFst(os, binary, fst);
   } else {
     KALDI_ASSERT(e2e_fsts.size() == num_sequences);
     WriteToken(os, binary, "<Fsts>");
-    for (int i = 0; i < num_sequences; i++) {
-      if (binary == false) {
-        // In text mode, write the FST without any compactification.
-        WriteFstKaldi(os, binary, e2e_fsts[i]);
-      } else {
-        // Write using StdAcceptorCompactFst, making use of the fact that it's an
-        // acceptor.
-        fst::FstWriteOptions write_options("<unknown>");
-        fst::StdCompactAcceptorFst::WriteFst(
-            e2e_fsts[i], fst::AcceptorCompactor<fst::StdArc>(), os,
-            write_options);
-      }
-    }
+    for (int i = 0; i < num_sequences; i++)
+      WriteSupervisionFst(os, binary, e2e_fsts[i]);
     WriteToken(os, binary, "</Fsts>");
   }
   if (!alignment_pdfs.empty()) {
@@ -624,33 +782,12 @@ void Supervision::Read(std::istream &is, bool binary) {
   ExpectToken(is, binary, "<End2End>");
   ReadBasicType(is, binary, &e2e);
   if (!e2e) {
-    if (!binary) {
-      ReadFstKaldi(is, binary, &fst);
-    } else {
-      fst::StdCompactAcceptorFst *compact_fst =
-          fst::StdCompactAcceptorFst::Read(
-              is, fst::FstReadOptions(std::string("[unknown]")));
-      if (compact_fst == NULL)
-        KALDI_ERR << "Error reading compact FST from disk";
-      fst = *compact_fst;
-      delete compact_fst;
-    }
+    ReadSupervisionFst(is, binary, &fst);
   } else {
     e2e_fsts.resize(num_sequences);
     ExpectToken(is, binary, "<Fsts>");
-    for (int i = 0; i < num_sequences; i++) {
-      if (!binary) {
-        ReadFstKaldi(is, binary, &e2e_fsts[i]);
-      } else {
-        fst::StdCompactAcceptorFst *compact_fst =
-            fst::StdCompactAcceptorFst::Read(
-                is, fst::FstReadOptions(std::string("[unknown]")));
-        if (compact_fst == NULL)
-          KALDI_ERR << "Error reading compact FST from disk";
-        e2e_fsts[i] = *compact_fst;
-        delete compact_fst;
-      }
-    }
+    for (int i = 0; i < num_sequences; i++)
+      ReadSupervisionFst(is, binary, &e2e_fsts[i]);
     ExpectToken(is, binary, "</Fsts>");
   }
   if (PeekToken(is, binary) == 'A') {
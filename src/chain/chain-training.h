@@ -71,9 +71,13 @@ struct ChainTrainingOptions {
   // should have a softmax as its final nonlinearity.
   BaseFloat xent_regularize;
 
+  // Number of threads for the denominator forward-backward when it is done on
+  // CPU (the sequences of the minibatch are divided among them).
+  int32 num_threads;
+
   ChainTrainingOptions(): l2_regularize(0.0), out_of_range_regularize(0.01),
                           leaky_hmm_coefficient(1.0e-05),
-                          xent_regularize(0.0) { }
+                          xent_regularize(0.0), num_threads(1) { }
 
   void Register(OptionsItf *opts) {
     opts->Register("l2-regularize", &l2_regularize, "l2 regularization "
@@ -94,6 +98,9 @@ struct ChainTrainingOptions {
                    "nonzero, the network is expected to have an output "
                    "named 'output-xent', which should have a softmax as "
                    "its final nonlinearity.");
+    opts->Register("denominator-threads", &num_threads, "Number of threads "
+                   "for the denominator computation of 'chain' training when "
+                   "it is done on CPU (not used with a GPU).");
 
     numerator_opts.Register(opts);
   }
@@ -20,6 +20,7 @@
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
 #include "nnet3/nnet-chain-training.h"
+#include "nnet3/nnet-example-loader.h"
 #include "cudamatrix/cu-allocator.h"
 
 int main(int argc, char *argv[]) {
@@ -33,10 +34,13 @@ int main(int argc, char *argv[]) {
     const char *usage =
         "Train nnet3+chain neural network parameters with backprop and stochastic\n"
         "gradient descent.  Minibatches are to be created by nnet3-chain-merge-egs in\n"
-        "the input pipeline.  This training program is single-threaded (best to\n"
-        "use it with a GPU).\n"
+        "the input pipeline, or by this program with --merge-egs=true.  If several\n"
+        "example archives are given, they are read from in turn.  This training\n"
+        "program is single-threaded (best to use it with a GPU) unless\n"
+        "--num-threads > 1, which does synchronous data-parallel training on the\n"
+        "CPU.\n"
         "\n"
-        "Usage:  nnet3-chain-train [options] <raw-nnet-in> <denominator-fst-in> <chain-training-examples-in> <raw-nnet-out>\n"
+        "Usage:  nnet3-chain-train [options] <raw-nnet-in> <denominator-fst-in> <chain-training-examples-in1> [<chain-training-examples-in2> ...] <raw-nnet-out>\n"
         "\n"
         "nnet3-chain-train 1.raw den.fst 'ark:nnet3-merge-egs 1.cegs ark:-|' 2.raw\n";
 
@@ -44,6 +48,7 @@ int main(int argc, char *argv[]) {
     bool binary_write = true;
     std::string use_gpu = "yes";
     NnetChainTrainingOptions opts;
+    ExampleLoaderOptions loader_opts;
 
     ParseOptions po(usage);
     po.Register("srand", &srand_seed, "Seed for random number generator ");
@@ -52,6 +57,7 @@ int main(int argc, char *argv[]) {
                 "yes|no|optional|wait, only has effect if compiled with CUDA");
 
     opts.Register(&po);
+    loader_opts.Register(&po);
 #if HAVE_CUDA==1
     CuDevice::RegisterDeviceOptions(&po);
 #endif
@@ -61,7 +67,7 @@ int main(int argc, char *argv[]) {
 
     srand(srand_seed);
 
-    if (po.NumArgs() != 4) {
+    if (po.NumArgs() < 4) {
       po.PrintUsage();
       exit(1);
     }
@@ -72,8 +78,10 @@ int main(int argc, char *argv[]) {
 
     std::string nnet_rxfilename = po.GetArg(1),
         den_fst_rxfilename = po.GetArg(2),
-        examples_rspecifier = po.GetArg(3),
-        nnet_wxfilename = po.GetArg(4);
+        nnet_wxfilename = po.GetArg(po.NumArgs());
+    std::vector<std::string> examples_rspecifiers;
+    for (int32 i = 3; i < po.NumArgs(); i++)
+      examples_rspecifiers.push_back(po.GetArg(i));
 
     Nnet nnet;
     ReadKaldiObject(nnet_rxfilename, &nnet);
@@ -86,10 +94,12 @@ int main(int argc, char *argv[]) {
 
       NnetChainTrainer trainer(opts, den_fst, &nnet);
 
-      SequentialNnetChainExampleReader example_reader(examples_rspecifier);
+      NnetChainExampleLoader example_reader(loader_opts,
+                                            examples_rspecifiers);
 
       for (; !example_reader.Done(); example_reader.Next())
         trainer.Train(example_reader.Value());
+      trainer.Flush();
 
       ok = trainer.PrintTotalStats();
     }
@@ -21,6 +21,7 @@
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
 #include "nnet3/nnet-chain-training2.h"
+#include "nnet3/nnet-example-loader.h"
 #include "cudamatrix/cu-allocator.h"
 
 
@@ -35,10 +36,11 @@ int main(int argc, char *argv[]) {
     const char *usage =
         "Train nnet3+chain neural network parameters with backprop and stochastic\n"
         "gradient descent.  Minibatches are to be created by nnet3-chain-merge-egs in\n"
-        "the input pipeline.  This training program is single-threaded (best to\n"
-        "use it with a GPU).\n"
+        "the input pipeline, or by this program with --merge-egs=true.  If several\n"
+        "example archives are given, they are read from in turn.  This training\n"
+        "program is single-threaded (best to use it with a GPU).\n"
         "\n"
-        "Usage:  nnet3-chain-train [options] <raw-nnet-in> <den-fst-dir> <chain-training-examples-in> <raw-nnet-out>\n"
+        "Usage:  nnet3-chain-train [options] <raw-nnet-in> <den-fst-dir> <chain-training-examples-in1> [<chain-training-examples-in2> ...] <raw-nnet-out>\n"
         "\n"
         "nnet3-chain-train 1.raw den.fst 'ark:nnet3-merge-egs 1.cegs ark:-|' 2.raw\n";
 
@@ -46,6 +48,7 @@ int main(int argc, char *argv[]) {
     bool binary_write = true;
     std::string use_gpu = "yes";
     NnetChainTraining2Options opts;
+    ExampleLoaderOptions loader_opts;
 
     ParseOptions po(usage);
     po.Register("srand", &srand_seed, "Seed for random number generator ");
@@ -54,13 +57,14 @@ int main(int argc, char *argv[]) {
                 "yes|no|optional|wait, only has effect if compiled with CUDA");
 
     opts.Register(&po);
+    loader_opts.Register(&po);
     RegisterCuAllocatorOptions(&po);
 
     po.Read(argc, argv);
 
     srand(srand_seed);
 
-    if (po.NumArgs() != 4) {
+    if (po.NumArgs() < 4) {
       po.PrintUsage();
       exit(1);
     }
@@ -71,8 +75,10 @@ int main(int argc, char *argv[]) {
 
     std::string nnet_rxfilename = po.GetArg(1),
         den_fst_dirname = po.GetArg(2),
-        examples_rspecifier = po.GetArg(3),
-        nnet_wxfilename = po.GetArg(4);
+        nnet_wxfilename = po.GetArg(po.NumArgs());
+    std::vector<std::string> examples_rspecifiers;
+    for (int32 i = 3; i < po.NumArgs(); i++)
+      examples_rspecifiers.push_back(po.GetArg(i));
 
     Nnet nnet;
     ReadKaldiObject(nnet_rxfilename, &nnet);
@@ -83,7 +89,8 @@ int main(int argc, char *argv[]) {
       NnetChainModel2 model(opts, &nnet, den_fst_dirname);
       NnetChainTrainer2 trainer(opts, model, &nnet);
 
-      SequentialNnetChainExampleReader example_reader(examples_rspecifier);
+      NnetChainExampleLoader example_reader(loader_opts,
+                                            examples_rspecifiers);
 
       for (; !example_reader.Done(); example_reader.Next())
         trainer.Train(example_reader.Key(), example_reader.Value());
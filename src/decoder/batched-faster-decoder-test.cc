@@ -0,0 +1,113 @@
+// decoder/batched-faster-decoder-test.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "decoder/batched-faster-decoder.h"
+#include "decoder/decodable-matrix.h"
+#include "decoder/faster-decoder.h"
+#include "fstext/fstext-utils.h"
+#include "fstext/rand-fst.h"
+
+namespace kaldi {
+
+// Checks that BatchedFasterDecoder, decoding several utterances at once in
+// chunks, gives each of them the same best path as FasterDecoder when the
+// beams are not limiting.
+void UnitTestBatchedFasterDecoder() {
+  fst::RandFstOptions fst_opts;
+  fst_opts.allow_empty = false;
+  fst::VectorFst<fst::StdArc> *graph = fst::RandFst<fst::StdArc>(fst_opts);
+  fst::CsrFst csr_graph(*graph);
+  int32 num_pdfs = fst_opts.n_syms - 1;  // ilabel 0 is epsilon.
+
+  BatchedFasterDecoderConfig batched_config;
+  batched_config.beam = 1000.0;
+  batched_config.max_active = 100000;
+  batched_config.min_active = RandInt(0, 20);
+  batched_config.num_threads = RandInt(1, 3);
+  FasterDecoderOptions config;
+  config.beam = 1000.0;
+  config.min_active = batched_config.min_active;
+
+  int32 num_channels = RandInt(1, 5);
+  BatchedFasterDecoder batched_decoder(batched_config, csr_graph,
+                                       num_channels);
+  std::vector<Matrix<BaseFloat> > loglikes(num_channels);
+  std::vector<DecodableMatrixScaled*> decodables(num_channels);
+  std::vector<int32> channels(num_channels);
+  for (int32 c = 0; c < num_channels; c++) {
+    loglikes[c].Resize(RandInt(1, 100), num_pdfs);
+    loglikes[c].SetRandn();
+    loglikes[c].ApplyPow(2.0);
+    loglikes[c].Scale(-1.0);
+    decodables[c] = new DecodableMatrixScaled(loglikes[c], 1.0);
+    channels[c] = c;
+  }
+  std::vector<DecodableInterface*> decodable_ptrs(decodables.begin(),
+                                                  decodables.end());
+
+  // Decode in chunks of random size, as an online pipeline would.
+  batched_decoder.InitDecoding(channels);
+  bool done = false;
+  while (!done) {
+    batched_decoder.AdvanceDecoding(channels, decodable_ptrs,
+                                    RandInt(1, 30));
+    done = true;
+    for (int32 c = 0; c < num_channels; c++)
+      if (batched_decoder.NumFramesDecoded(c) < loglikes[c].NumRows())
+        done = false;
+  }
+
+  FasterDecoder decoder(*graph, config);
+  for (int32 c = 0; c < num_channels; c++) {
+    DecodableMatrixScaled decodable(loglikes[c], 1.0);
+    decoder.Decode(&decodable);
+    KALDI_ASSERT(batched_decoder.ReachedFinal(c) == decoder.ReachedFinal());
+    Lattice path, batched_path;
+    bool ans = decoder.GetBestPath(&path),
+        batched_ans = batched_decoder.GetBestPath(c, true, &batched_path);
+    KALDI_ASSERT(ans == batched_ans);
+    if (!ans)
+      continue;
+    std::vector<int32> alignment, batched_alignment, words, batched_words;
+    LatticeWeight weight, batched_weight;
+    fst::GetLinearSymbolSequence(path, &alignment, &words, &weight);
+    fst::GetLinearSymbolSequence(batched_path, &batched_alignment,
+                                 &batched_words, &batched_weight);
+    // The words are not compared: the graph may have epsilon paths that differ
+    // only in their output labels, with the same cost.
+    KALDI_ASSERT(alignment == batched_alignment);
+    KALDI_ASSERT(static_cast<int32>(alignment.size()) ==
+                 loglikes[c].NumRows());
+    KALDI_ASSERT(ApproxEqual(weight.Value1() + weight.Value2(),
+                             batched_weight.Value1() +
+                             batched_weight.Value2()));
+  }
+
+  for (int32 c = 0; c < num_channels; c++)
+    delete decodables[c];
+  delete graph;
+}
+
+}  // namespace kaldi
+
+int main() {
+  for (int32 i = 0; i < 50; i++)
+    kaldi::UnitTestBatchedFasterDecoder();
+  KALDI_LOG << "Success.";
+}
@@ -0,0 +1,419 @@
+// decoder/batched-faster-decoder.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <limits>
+
+#include "decoder/batched-faster-decoder.h"
+
+namespace kaldi {
+
+BatchedFasterDecoder::BatchedFasterDecoder(
+    const BatchedFasterDecoderConfig &config,
+    const fst::CsrFst &graph,
+    int32 num_channels):
+    config_(config), graph_(graph), channels_(num_channels),
+    lanes_(config.num_threads) {
+  config_.Check();
+  KALDI_ASSERT(num_channels > 0);
+}
+
+void BatchedFasterDecoder::InitDecoding(
+    const std::vector<ChannelId> &channels) {
+  Lane *lane = &(lanes_[0]);
+  for (size_t i = 0; i < channels.size(); i++) {
+    Channel *channel = &(channels_[channels[i]]);
+    channel->trace_prev.assign(1, -1);
+    channel->trace_arc.assign(1, -1);
+    channel->trace_ac_cost.assign(1, 0.0);
+    channel->trace_size_after_gc = 1;
+    channel->num_frames_decoded = 0;
+
+    StartFrame(1, lane);
+    int32 t = FindOrAddToken(graph_.Start(), lane);
+    lane->tok_cost[t] = 0.0;
+    lane->tok_trace[t] = 0;
+    ExpandNonEmitting(std::numeric_limits<BaseFloat>::max(), channel, lane);
+    channel->tok_state = lane->tok_state;
+    channel->tok_cost = lane->tok_cost;
+    channel->tok_trace = lane->tok_trace;
+  }
+}
+
+
+// Decodes some of the channels of a batch: thread i decodes the channels with
+// index i, i + num_threads_, and so on, using lane i.
+class BatchedFasterDecoder::AdvanceDecodingClass: public MultiThreadable {
+ public:
+  AdvanceDecodingClass(BatchedFasterDecoder *decoder,
+                       const std::vector<ChannelId> &channels,
+                       const std::vector<DecodableInterface*> &decodables,
+                       int32 max_num_frames):
+      decoder_(decoder), channels_(channels), decodables_(decodables),
+      max_num_frames_(max_num_frames) { }
+  void operator() () {
+    BatchedFasterDecoder::Lane *lane = &(decoder_->lanes_[thread_id_]);
+    for (size_t i = thread_id_; i < channels_.size(); i += num_threads_)
+      decoder_->AdvanceChannel(decodables_[i], max_num_frames_,
+                               &(decoder_->channels_[channels_[i]]), lane);
+  }
+ private:
+  BatchedFasterDecoder *decoder_;
+  const std::vector<ChannelId> &channels_;
+  const std::vector<DecodableInterface*> &decodables_;
+  int32 max_num_frames_;
+};
+
+void BatchedFasterDecoder::AdvanceDecoding(
+    const std::vector<ChannelId> &channels,
+    const std::vector<DecodableInterface*> &decodables,
+    int32 max_num_frames) {
+  KALDI_ASSERT(channels.size() == decodables.size());
+  if (channels.empty()) return;
+  AdvanceDecodingClass c(this, channels, decodables, max_num_frames);
+  int32 num_threads = std::min<int32>(config_.num_threads, channels.size());
+  if (num_threads == 1) {
+    c.thread_id_ = 0;
+    c.num_threads_ = 1;
+    c();
+  } else {
+    MultiThreader<AdvanceDecodingClass> m(num_threads, c);
+  }
+}
+
+void BatchedFasterDecoder::AdvanceChannel(DecodableInterface *decodable,
+                                          int32 max_num_frames,
+                                          Channel *channel, Lane *lane) {
+  KALDI_ASSERT(!channel->trace_prev.empty() &&
+               "You must call InitDecoding() before AdvanceDecoding()");
+  int32 num_frames_ready = decodable->NumFramesReady();
+  // num_frames_ready must be >= num_frames_decoded, or else
+  // the number of frames ready must have decreased (which doesn't
+  // make sense) or the decodable object changed between calls
+  // (which isn't allowed).
+  KALDI_ASSERT(num_frames_ready >= channel->num_frames_decoded);
+  int32 target_frames_decoded = num_frames_ready;
+  if (max_num_frames >= 0)
+    target_frames_decoded = std::min(target_frames_decoded,
+                                     channel->num_frames_decoded +
+                                     max_num_frames);
+  while (channel->num_frames_decoded < target_frames_decoded) {
+    BaseFloat cutoff = ExpandEmitting(decodable, channel, lane);
+    ExpandNonEmitting(cutoff, channel, lane);
+    // The new tokens become the active tokens of the channel.  Swapping
+    // keeps the memory of both sets of arrays.
+    channel->tok_state.swap(lane->tok_state);
+    channel->tok_cost.swap(lane->tok_cost);
+    channel->tok_trace.swap(lane->tok_trace);
+    channel->num_frames_decoded++;
+    GarbageCollect(channel);
+  }
+}
+
+BaseFloat BatchedFasterDecoder::GetCutoff(const Channel &channel, Lane *lane,
+                                          int32 *best_tok) const {
+  const std::vector<BaseFloat> &costs = channel.tok_cost;
+  int32 num_toks = costs.size();
+  *best_tok = std::min_element(costs.begin(), costs.end()) - costs.begin();
+  BaseFloat best_cost = costs[*best_tok],
+      beam_cutoff = best_cost + config_.beam;
+  if (num_toks <= config_.min_active)
+    return std::numeric_limits<BaseFloat>::infinity();
+  if (num_toks <= config_.max_active && config_.min_active <= 0)
+    return beam_cutoff;
+  // The costs are copied into the lane's buffer once per frame.  After the
+  // max-active selection, the first max_active elements are the smallest ones,
+  // so the min-active selection only needs to look at those.
+  std::vector<BaseFloat> &tmp = lane->tmp_costs;
+  tmp.assign(costs.begin(), costs.end());
+  std::vector<BaseFloat>::iterator end = tmp.end();
+  if (num_toks > config_.max_active) {
+    std::nth_element(tmp.begin(), tmp.begin() + config_.max_active, end);
+    BaseFloat max_active_cutoff = tmp[config_.max_active];
+    if (max_active_cutoff < beam_cutoff)  // max_active is tighter than beam.
+      return max_active_cutoff;
+    if (config_.min_active < config_.max_active)
+      end = tmp.begin() + config_.max_active;
+  }
+  if (config_.min_active > 0) {
+    std::nth_element(tmp.begin(), tmp.begin() + config_.min_active, end);
+    BaseFloat min_active_cutoff = tmp[config_.min_active];
+    if (min_active_cutoff > beam_cutoff)  // min_active is looser than beam.
+      return min_active_cutoff;
+  }
+  return beam_cutoff;
+}
+
+void BatchedFasterDecoder::StartFrame(int32 num_toks, Lane *lane) const {
+  lane->tok_state.clear();
+  lane->tok_cost.clear();
+  lane->tok_trace.clear();
+  size_t min_size = 2 * std::max<size_t>(num_toks, 64);
+  if (lane->hash_slots.size() < min_size) {
+    size_t size = 1;
+    while (size < min_size) size *= 2;
+    lane->hash_slots.resize(size);
+    lane->hash_stamps.assign(size, 0);
+    lane->stamp = 0;
+  }
+  if (++lane->stamp == 0) {  // The stamp wrapped around.
+    std::fill(lane->hash_stamps.begin(), lane->hash_stamps.end(), 0);
+    lane->stamp = 1;
+  }
+}
+
+inline int32 BatchedFasterDecoder::FindOrAddToken(StateId state,
+                                                  Lane *lane) const {
+  size_t mask = lane->hash_slots.size() - 1,
+      h = (static_cast<size_t>(state) * 2654435761u) & mask;
+  while (true) {
+    if (lane->hash_stamps[h] != lane->stamp) {
+      break;
+    } else {
+      int32 t = lane->hash_slots[h];
+      if (lane->tok_state[t] == state) return t;
+    }
+    h = (h + 1) & mask;
+  }
+  int32 t = lane->tok_state.size();
+  lane->hash_stamps[h] = lane->stamp;
+  lane->hash_slots[h] = t;
+  lane->tok_state.push_back(state);
+  lane->tok_cost.push_back(std::numeric_limits<BaseFloat>::infinity());
+  lane->tok_trace.push_back(-1);
+  if (2 * lane->tok_state.size() > lane->hash_slots.size()) {
+    // The hash is more than half full; double its size and re-insert the
+    // tokens.
+    size_t size = 2 * lane->hash_slots.size();
+    lane->hash_slots.resize(size);
+    lane->hash_stamps.assign(size, 0);
+    mask = size - 1;
+    for (int32 i = 0; i < static_cast<int32>(lane->tok_state.size()); i++) {
+      h = (static_cast<size_t>(lane->tok_state[i]) * 2654435761u) & mask;
+      while (lane->hash_stamps[h] == lane->stamp)
+        h = (h + 1) & mask;
+      lane->hash_stamps[h] = lane->stamp;
+      lane->hash_slots[h] = i;
+    }
+  }
+  return t;
+}
+
+BaseFloat BatchedFasterDecoder::ExpandEmitting(DecodableInterface *decodable,
+                                               Channel *channel,
+                                               Lane *lane) const {
+  int32 frame = channel->num_frames_decoded,
+      num_toks = channel->tok_state.size();
+  StartFrame(num_toks, lane);
+  if (num_toks == 0) {
+    KALDI_WARN << "No active tokens on frame " << frame;
+    return std::numeric_limits<BaseFloat>::infinity();
+  }
+  int32 best_tok;
+  BaseFloat cutoff = GetCutoff(*channel, lane, &best_tok);
+
+  // Make sure the acoustic-cost cache is big enough and invalidate it; it
+  // uses the same stamp as the hash.
+  int32 num_indices = decodable->NumIndices() + 1;
+  if (static_cast<int32>(lane->ac_costs.size()) < num_indices) {
+    lane->ac_costs.resize(num_indices);
+    lane->ac_cost_stamps.resize(num_indices, 0);
+  }
+  if (lane->stamp == 1)  // StartFrame() reset the stamps.
+    std::fill(lane->ac_cost_stamps.begin(), lane->ac_cost_stamps.end(), 0);
+  BaseFloat *ac_costs = &(lane->ac_costs[0]);
+  uint32 *ac_cost_stamps = &(lane->ac_cost_stamps[0]), stamp = lane->stamp;
+
+  const fst::CsrFst::Label *ilabels = graph_.Ilabels();
+  const float *weights = graph_.Weights();
+  const StateId *nextstates = graph_.Nextstates();
+  BaseFloat next_cutoff = std::numeric_limits<BaseFloat>::infinity();
+  // Process the best token first, to get a reasonably tight bound on the
+  // next cutoff.
+  for (int32 i = -1; i < num_toks; i++) {
+    int32 t = (i == -1 ? best_tok : i);
+    BaseFloat tok_cost = channel->tok_cost[t];
+    if (!(tok_cost < cutoff)) continue;
+    StateId state = channel->tok_state[t];
+    int32 begin = graph_.EmittingBegin(state), end = graph_.EmittingEnd(state),
+        num_arcs = end - begin;
+    if (num_arcs == 0) continue;
+    // Look up the log-likelihoods we have not needed yet on this frame.
+    for (int32 a = begin; a < end; a++) {
+      int32 ilabel = ilabels[a];
+      if (ac_cost_stamps[ilabel] != stamp) {
+        ac_costs[ilabel] = -decodable->LogLikelihood(frame, ilabel);
+        ac_cost_stamps[ilabel] = stamp;
+      }
+    }
+    // Compute the costs of all the arcs, before pruning any of them.
+    if (static_cast<int32>(lane->arc_costs.size()) < num_arcs)
+      lane->arc_costs.resize(num_arcs);
+    BaseFloat *arc_costs = &(lane->arc_costs[0]);
+    const fst::CsrFst::Label *this_ilabels = ilabels + begin;
+    const BaseFloat *this_weights = weights + begin;
+    for (int32 k = 0; k < num_arcs; k++)
+      arc_costs[k] = tok_cost + this_weights[k] + ac_costs[this_ilabels[k]];
+
+    if (i == -1) {
+      BaseFloat best_arc_cost = *std::min_element(arc_costs,
+                                                  arc_costs + num_arcs);
+      next_cutoff = best_arc_cost + config_.beam;
+      continue;
+    }
+    for (int32 k = 0; k < num_arcs; k++) {
+      BaseFloat new_cost = arc_costs[k];
+      if (new_cost < next_cutoff) {
+        if (new_cost + config_.beam < next_cutoff)
+          next_cutoff = new_cost + config_.beam;
+        int32 new_t = FindOrAddToken(nextstates[begin + k], lane);
+        if (new_cost < lane->tok_cost[new_t]) {
+          lane->tok_cost[new_t] = new_cost;
+          lane->tok_trace[new_t] = channel->trace_prev.size();
+          channel->trace_prev.push_back(channel->tok_trace[t]);
+          channel->trace_arc.push_back(begin + k);
+          channel->trace_ac_cost.push_back(ac_costs[this_ilabels[k]]);
+        }
+      }
+    }
+  }
+  return next_cutoff;
+}
+
+void BatchedFasterDecoder::ExpandNonEmitting(BaseFloat cutoff,
+                                             Channel *channel,
+                                             Lane *lane) const {
+  const float *weights = graph_.Weights();
+  const StateId *nextstates = graph_.Nextstates();
+  std::vector<int32> &queue = lane->queue;
+  KALDI_ASSERT(queue.empty());
+  for (int32 t = 0; t < static_cast<int32>(lane->tok_state.size()); t++)
+    queue.push_back(t);
+  while (!queue.empty()) {
+    int32 t = queue.back();
+    queue.pop_back();
+    BaseFloat tok_cost = lane->tok_cost[t];
+    if (tok_cost > cutoff)  // Don't bother processing successors.
+      continue;
+    StateId state = lane->tok_state[t];
+    for (int32 a = graph_.NonEmittingBegin(state),
+             end = graph_.NonEmittingEnd(state); a < end; a++) {
+      BaseFloat new_cost = tok_cost + weights[a];
+      if (new_cost > cutoff) continue;
+      // Note: FindOrAddToken() may add to the lane's arrays, so we don't keep
+      // references into them.
+      int32 new_t = FindOrAddToken(nextstates[a], lane);
+      if (new_cost < lane->tok_cost[new_t]) {
+        lane->tok_cost[new_t] = new_cost;
+        int32 prev_trace = lane->tok_trace[t];
+        lane->tok_trace[new_t] = channel->trace_prev.size();
+        channel->trace_prev.push_back(prev_trace);
+        channel->trace_arc.push_back(a);
+        channel->trace_ac_cost.push_back(0.0);
+        queue.push_back(new_t);
+      }
+    }
+  }
+}
+
+void BatchedFasterDecoder::GarbageCollect(Channel *channel) const {
+  size_t size = channel->trace_prev.size();
+  if (size < 2 * channel->trace_size_after_gc + 10000)
+    return;
+  // Mark the entries on the paths of the active tokens, then keep only those.
+  // An entry's predecessor always comes before it, so we can renumber them in
+  // one pass.
+  std::vector<int32> new_index(size, -1);
+  for (size_t i = 0; i < channel->tok_trace.size(); i++)
+    for (int32 e = channel->tok_trace[i]; e != -1 && new_index[e] == -1;
+         e = channel->trace_prev[e])
+      new_index[e] = 0;
+  int32 num_kept = 0;
+  for (size_t e = 0; e < size; e++) {
+    if (new_index[e] == -1) continue;
+    int32 prev = channel->trace_prev[e];
+    channel->trace_prev[num_kept] = (prev == -1 ? -1 : new_index[prev]);
+    channel->trace_arc[num_kept] = channel->trace_arc[e];
+    channel->trace_ac_cost[num_kept] = channel->trace_ac_cost[e];
+    new_index[e] = num_kept++;
+  }
+  channel->trace_prev.resize(num_kept);
+  channel->trace_arc.resize(num_kept);
+  channel->trace_ac_cost.resize(num_kept);
+  for (size_t i = 0; i < channel->tok_trace.size(); i++)
+    channel->tok_trace[i] = new_index[channel->tok_trace[i]];
+  channel->trace_size_after_gc = num_kept;
+}
+
+bool BatchedFasterDecoder::ReachedFinal(ChannelId c) const {
+  const Channel &channel = channels_[c];
+  for (size_t i = 0; i < channel.tok_state.size(); i++)
+    if (channel.tok_cost[i] != std::numeric_limits<BaseFloat>::infinity() &&
+        graph_.FinalCost(channel.tok_state[i]) !=
+        std::numeric_limits<BaseFloat>::infinity())
+      return true;
+  return false;
+}
+
+bool BatchedFasterDecoder::GetBestPath(ChannelId c, bool use_final_probs,
+                                       Lattice *best_path) const {
+  const Channel &channel = channels_[c];
+  best_path->DeleteStates();
+  bool is_final = ReachedFinal(c);
+  const BaseFloat infinity = std::numeric_limits<BaseFloat>::infinity();
+  BaseFloat best_cost = infinity;
+  int32 best_tok = -1;
+  for (size_t i = 0; i < channel.tok_state.size(); i++) {
+    BaseFloat cost = channel.tok_cost[i];
+    if (is_final) cost += graph_.FinalCost(channel.tok_state[i]);
+    if (cost < best_cost) {
+      best_cost = cost;
+      best_tok = i;
+    }
+  }
+  if (best_tok == -1) return false;  // No output.
+
+  std::vector<int32> entries_reverse;
+  for (int32 e = channel.tok_trace[best_tok]; channel.trace_prev[e] != -1;
+       e = channel.trace_prev[e])
+    entries_reverse.push_back(e);
+
+  LatticeArc::StateId cur_state = best_path->AddState();
+  best_path->SetStart(cur_state);
+  for (ssize_t i = static_cast<ssize_t>(entries_reverse.size()) - 1; i >= 0;
+       i--) {
+    int32 e = entries_reverse[i];
+    fst::CsrFst::Arc arc = graph_.GetArc(channel.trace_arc[e]);
+    LatticeArc l_arc(arc.ilabel, arc.olabel,
+                     LatticeWeight(arc.weight.Value(),
+                                   channel.trace_ac_cost[e]),
+                     best_path->AddState());
+    best_path->AddArc(cur_state, l_arc);
+    cur_state = l_arc.nextstate;
+  }
+  if (is_final && use_final_probs)
+    best_path->SetFinal(cur_state,
+                        LatticeWeight(graph_.FinalCost(
+                            channel.tok_state[best_tok]), 0.0));
+  else
+    best_path->SetFinal(cur_state, LatticeWeight::One());
+  return true;
+}
+
+}  // end namespace kaldi.
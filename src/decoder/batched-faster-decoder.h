@@ -0,0 +1,220 @@
+// decoder/batched-faster-decoder.h
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_DECODER_BATCHED_FASTER_DECODER_H_
+#define KALDI_DECODER_BATCHED_FASTER_DECODER_H_
+
+#include <vector>
+
+#include "decoder/csr-fst.h"
+#include "itf/decodable-itf.h"
+#include "itf/options-itf.h"
+#include "lat/kaldi-lattice.h"
+#include "util/kaldi-thread.h"
+
+namespace kaldi {
+
+/**
+   This file contains a CPU version of the lane/channel design of
+   cudadecoder/cuda-decoder.h: a Viterbi beam search (like FasterDecoder) that
+   decodes many utterances at once over a single, shared graph.
+
+   The terminology is the same as in the CUDA decoder.  A "channel" holds the
+   state of one utterance between calls (its active tokens and the traceback
+   needed for the best path); a "lane" is the scratch space used while a
+   channel is being decoded.  There is one lane per thread, so a lane is
+   reused by every channel that its thread decodes, and after the first few
+   frames nothing is allocated.
+
+   Everything is stored as flat arrays rather than as linked Token objects: the
+   graph is in compressed-sparse-row format (fst::CsrFst, which has the same
+   layout as CudaFst), and the tokens of a channel are a struct of arrays
+   (states, costs, traceback indexes).  The arcs of a state are therefore
+   contiguous, and the costs of all the emitting arcs of a token are computed
+   in one loop before any of them is pruned; see
+   BatchedFasterDecoder::ExpandEmitting().
+
+   The decoder only keeps what is needed for the best path (like FasterDecoder,
+   not LatticeFasterDecoder), so the output of GetBestPath() is a linear
+   lattice.
+*/
+
+struct BatchedFasterDecoderConfig {
+  BaseFloat beam;
+  int32 max_active;
+  int32 min_active;
+  int32 num_threads;
+
+  BatchedFasterDecoderConfig(): beam(16.0),
+                                max_active(7000),
+                                min_active(200),
+                                num_threads(1) { }
+  void Register(OptionsItf *opts) {
+    opts->Register("beam", &beam, "Decoding beam.  Larger->slower, more "
+                   "accurate.");
+    opts->Register("max-active", &max_active, "Decoder max active states.  "
+                   "Larger->slower; more accurate");
+    opts->Register("min-active", &min_active, "Decoder min active states "
+                   "(don't prune if #active less than this).");
+    opts->Register("decoder-threads", &num_threads, "Number of threads the "
+                   "decoder uses to decode the channels of a batch.");
+  }
+  void Check() const {
+    KALDI_ASSERT(beam > 0.0 && max_active > 1 && min_active >= 0 &&
+                 min_active <= max_active && num_threads > 0);
+  }
+};
+
+
+/// BatchedFasterDecoder decodes up to 'num_channels' utterances at once.  Each
+/// call to AdvanceDecoding() takes a list of channels and the decodable objects
+/// of their utterances, and decodes all the frames they have ready, using up
+/// to config.num_threads threads.  Its search is the same as FasterDecoder's
+/// (without the adaptive beam), so it gives the same best path on each
+/// utterance when the beams are not limiting.
+class BatchedFasterDecoder {
+ public:
+  typedef int32 ChannelId;
+  typedef fst::CsrFst::StateId StateId;
+
+  BatchedFasterDecoder(const BatchedFasterDecoderConfig &config,
+                       const fst::CsrFst &graph,
+                       int32 num_channels);
+
+  int32 NumChannels() const { return channels_.size(); }
+
+  /// Starts a new utterance on each of 'channels'.
+  void InitDecoding(const std::vector<ChannelId> &channels);
+
+  /// Decodes, for each i, the frames that decodables[i] has ready on channel
+  /// channels[i] (but no more than 'max_num_frames' of them per channel, if
+  /// max_num_frames >= 0).  The channels must be distinct.  The decodables'
+  /// LogLikelihood() is called from several threads if config.num_threads >
+  /// 1, but each decodable only from one of them.
+  void AdvanceDecoding(const std::vector<ChannelId> &channels,
+                       const std::vector<DecodableInterface*> &decodables,
+                       int32 max_num_frames = -1);
+
+  /// Returns the number of frames decoded so far on 'channel'.
+  int32 NumFramesDecoded(ChannelId channel) const {
+    return channels_[channel].num_frames_decoded;
+  }
+
+  /// Returns true if any of the active tokens of 'channel' is in a final
+  /// state.
+  bool ReachedFinal(ChannelId channel) const;
+
+  /// Outputs the best path of 'channel' as a linear lattice, like
+  /// FasterDecoder::GetBestPath(): if 'use_final_probs' is true and a final
+  /// state was reached, it is the best path ending in a final state.  Returns
+  /// false if there were no active tokens.  Can be called at any time, e.g.
+  /// for partial results.
+  bool GetBestPath(ChannelId channel, bool use_final_probs,
+                   Lattice *best_path) const;
+
+ private:
+  // The state of one utterance.  The active tokens are stored as a struct of
+  // arrays; tok_trace[i] is the index of token i's entry in the traceback,
+  // whose entries record, for each token ever created, the traceback index of
+  // its predecessor, the arc index it came through (in the graph) and its
+  // acoustic cost.  Entries that are no longer reachable from the active
+  // tokens are removed from time to time by GarbageCollect().
+  struct Channel {
+    std::vector<StateId> tok_state;
+    std::vector<BaseFloat> tok_cost;
+    std::vector<int32> tok_trace;
+    std::vector<int32> trace_prev;
+    std::vector<int32> trace_arc;
+    std::vector<BaseFloat> trace_ac_cost;
+    int32 num_frames_decoded;
+    // The size of the traceback after the last garbage collection.
+    size_t trace_size_after_gc;
+    Channel(): num_frames_decoded(0), trace_size_after_gc(0) { }
+  };
+
+  // The scratch space used while decoding a channel.  The new tokens (those
+  // of the frame being decoded) are stored as a struct of arrays, and
+  // hash_slots maps states to their index in it, with open addressing and
+  // linear probing; a slot is in use only if its stamp in 'hash_stamps' is
+  // equal to 'stamp', so clearing the hash for a new frame is just a matter of
+  // incrementing 'stamp'.  The acoustic costs of the frame are cached in
+  // 'ac_costs', indexed by ilabel, with the same stamping scheme.
+  struct Lane {
+    std::vector<StateId> tok_state;
+    std::vector<BaseFloat> tok_cost;
+    std::vector<int32> tok_trace;
+    std::vector<int32> hash_slots;
+    std::vector<uint32> hash_stamps;
+    std::vector<BaseFloat> ac_costs;
+    std::vector<uint32> ac_cost_stamps;
+    uint32 stamp;
+    std::vector<BaseFloat> arc_costs;  // Costs of the arcs of one token.
+    std::vector<int32> queue;  // For ExpandNonEmitting().
+    std::vector<BaseFloat> tmp_costs;  // For GetCutoff().
+    Lane(): stamp(0) { }
+  };
+
+  class AdvanceDecodingClass;
+
+  // Decodes up to 'max_num_frames' frames of 'channel', using 'lane'.
+  void AdvanceChannel(DecodableInterface *decodable, int32 max_num_frames,
+                      Channel *channel, Lane *lane);
+
+  // Returns the cost cutoff for the active tokens of 'channel', taking into
+  // account the beam and max_active/min_active, and sets *best_tok to the
+  // index of the best token.
+  BaseFloat GetCutoff(const Channel &channel, Lane *lane,
+                      int32 *best_tok) const;
+
+  // Returns the index of 'state' in lane->tok_state, adding it with infinite
+  // cost if it is not there.
+  inline int32 FindOrAddToken(StateId state, Lane *lane) const;
+
+  // Starts a new frame in 'lane': clears its tokens and its hash, and makes
+  // sure the hash has at least 2 * 'num_toks' slots.
+  void StartFrame(int32 num_toks, Lane *lane) const;
+
+  // Processes the emitting arcs of the tokens of 'channel' for the frame
+  // channel->num_frames_decoded, putting the new tokens in 'lane'.  Returns
+  // the cutoff for the next frame.
+  BaseFloat ExpandEmitting(DecodableInterface *decodable, Channel *channel,
+                           Lane *lane) const;
+
+  // Processes the non-emitting arcs of the tokens in 'lane', which must have
+  // cost less than 'cutoff'.
+  void ExpandNonEmitting(BaseFloat cutoff, Channel *channel,
+                         Lane *lane) const;
+
+  // Removes the traceback entries of 'channel' that cannot be reached from its
+  // active tokens, if the traceback has grown enough since it was last done.
+  void GarbageCollect(Channel *channel) const;
+
+  BatchedFasterDecoderConfig config_;
+  const fst::CsrFst &graph_;
+  std::vector<Channel> channels_;
+  std::vector<Lane> lanes_;  // One per thread.
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(BatchedFasterDecoder);
+};
+
+
+}  // end namespace kaldi.
+
+
+#endif  // KALDI_DECODER_BATCHED_FASTER_DECODER_H_
@@ -0,0 +1,189 @@
+// decoder/csr-fst-test.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+
+#include "decoder/csr-fst.h"
+#include "decoder/decodable-matrix.h"
+#include "decoder/lattice-faster-decoder.h"
+#include "fstext/fstext-utils.h"
+#include "hmm/hmm-test-utils.h"
+#include "lat/lattice-functions.h"
+
+namespace kaldi {
+
+// Makes a random decoding graph whose ilabels are in [1, max_ilabel], or 0.
+// The epsilon arcs only go to higher-numbered states, so there are no epsilon
+// cycles (which the lattice generation does not allow).
+static void GenerateRandomGraph(int32 max_ilabel,
+                                fst::VectorFst<fst::StdArc> *graph) {
+  int32 num_states = RandInt(2, 30);
+  graph->DeleteStates();
+  for (int32 s = 0; s < num_states; s++)
+    graph->AddState();
+  graph->SetStart(0);
+  for (int32 s = 0; s < num_states; s++) {
+    if (RandInt(0, 2) == 0)
+      graph->SetFinal(s, fst::TropicalWeight(RandUniform()));
+    int32 num_arcs = RandInt(1, 6);
+    for (int32 i = 0; i < num_arcs; i++) {
+      fst::StdArc arc(RandInt(1, max_ilabel), RandInt(0, 10),
+                      fst::TropicalWeight(2.0 * RandUniform()),
+                      RandInt(0, num_states - 1));
+      if (s + 1 < num_states && RandInt(0, 4) == 0) {
+        arc.ilabel = 0;
+        arc.nextstate = RandInt(s + 1, num_states - 1);
+      }
+      graph->AddArc(s, arc);
+    }
+  }
+}
+
+typedef std::pair<std::pair<int32, int32>, std::pair<float, int32> >
+    ArcTuple;
+
+static ArcTuple GetArcTuple(const fst::StdArc &arc) {
+  return std::make_pair(std::make_pair(arc.ilabel, arc.olabel),
+                        std::make_pair(arc.weight.Value(), arc.nextstate));
+}
+
+// Checks that CsrFst has the same start state, final-costs and arcs (in
+// whatever order) as the graph it was made from, with the emitting arcs of
+// each state before its non-emitting ones.  If 'trans_model' is not NULL, the
+// ilabels are expected to have been mapped to pdf-ids plus one.
+void UnitTestCsrFstArcs(const TransitionModel *trans_model) {
+  int32 max_ilabel = (trans_model != NULL ? trans_model->NumTransitionIds()
+                      : RandInt(1, 20));
+  fst::VectorFst<fst::StdArc> graph;
+  GenerateRandomGraph(max_ilabel, &graph);
+  fst::CsrFst csr_graph(graph, trans_model);
+  KALDI_ASSERT(csr_graph.Start() == graph.Start() &&
+               csr_graph.NumStates() == graph.NumStates() &&
+               csr_graph.IlabelsArePdfs() == (trans_model != NULL));
+  for (int32 s = 0; s < graph.NumStates(); s++) {
+    KALDI_ASSERT(csr_graph.Final(s) == graph.Final(s) &&
+                 csr_graph.NumInputEpsilons(s) == graph.NumInputEpsilons(s));
+    std::vector<ArcTuple> arcs, csr_arcs;
+    for (fst::ArcIterator<fst::StdFst> aiter(graph, s); !aiter.Done();
+         aiter.Next()) {
+      fst::StdArc arc = aiter.Value();
+      if (trans_model != NULL && arc.ilabel != 0)
+        arc.ilabel = trans_model->TransitionIdToPdf(arc.ilabel) + 1;
+      arcs.push_back(GetArcTuple(arc));
+    }
+    bool seen_epsilon = false;
+    for (fst::ArcIterator<fst::CsrFst> aiter(csr_graph, s); !aiter.Done();
+         aiter.Next()) {
+      const fst::StdArc &arc = aiter.Value();
+      if (arc.ilabel == 0)
+        seen_epsilon = true;
+      else
+        KALDI_ASSERT(!seen_epsilon);
+      csr_arcs.push_back(GetArcTuple(arc));
+    }
+    std::sort(arcs.begin(), arcs.end());
+    std::sort(csr_arcs.begin(), csr_arcs.end());
+    KALDI_ASSERT(arcs == csr_arcs);
+  }
+}
+
+// Decodes random loglikes with LatticeFasterDecoder on a graph and on its
+// CsrFst copy, and checks that the lattices are the same.  The arcs are
+// visited in a different order, so the states may be numbered differently;
+// we compare the sizes, the total and best-path scores and the best paths.
+void UnitTestCsrFstDecoding() {
+  int32 num_pdfs = RandInt(1, 20);
+  fst::VectorFst<fst::StdArc> graph;
+  GenerateRandomGraph(num_pdfs, &graph);
+  fst::CsrFst csr_graph(graph);
+
+  Matrix<BaseFloat> loglikes(RandInt(1, 50), num_pdfs);
+  loglikes.SetRandn();
+  loglikes.ApplyPow(2.0);
+  loglikes.Scale(-1.0);
+
+  // The beam is wide enough that nothing is pruned while decoding: with a
+  // narrow beam the adaptive cutoff in ProcessEmitting() depends on the
+  // order in which the arcs are visited, so the two decoders could keep
+  // different tokens.  The lattice beam is still exercised.
+  LatticeFasterDecoderConfig config;
+  config.beam = 1000.0;
+  config.lattice_beam = RandInt(2, 10);
+  LatticeFasterDecoderTpl<fst::StdFst> decoder(graph, config);
+  LatticeFasterDecoderTpl<fst::CsrFst> csr_decoder(csr_graph, config);
+  DecodableMatrixScaled decodable(loglikes, 1.0),
+      csr_decodable(loglikes, 1.0);
+  bool ans = decoder.Decode(&decodable),
+      csr_ans = csr_decoder.Decode(&csr_decodable);
+  KALDI_ASSERT(ans == csr_ans &&
+               decoder.NumFramesDecoded() == csr_decoder.NumFramesDecoded());
+  if (!ans)
+    return;
+
+  Lattice lat, csr_lat;
+  bool got_lat = decoder.GetRawLattice(&lat),
+      csr_got_lat = csr_decoder.GetRawLattice(&csr_lat);
+  KALDI_ASSERT(got_lat == csr_got_lat);
+  if (lat.Start() == fst::kNoStateId) {
+    KALDI_ASSERT(csr_lat.Start() == fst::kNoStateId);
+    return;
+  }
+  TopSortLatticeIfNeeded(&lat);
+  TopSortLatticeIfNeeded(&csr_lat);
+  KALDI_ASSERT(lat.NumStates() == csr_lat.NumStates() &&
+               fst::NumArcs(lat) == fst::NumArcs(csr_lat));
+  for (int32 viterbi = 0; viterbi < 2; viterbi++) {
+    std::vector<double> alpha, beta, csr_alpha, csr_beta;
+    double tot_like = ComputeLatticeAlphasAndBetas(lat, viterbi != 0, &alpha,
+                                                   &beta),
+        csr_tot_like = ComputeLatticeAlphasAndBetas(csr_lat, viterbi != 0,
+                                                    &csr_alpha, &csr_beta);
+    KALDI_ASSERT(ApproxEqual(tot_like, csr_tot_like));
+  }
+
+  Lattice best_path, csr_best_path;
+  fst::ShortestPath(lat, &best_path);
+  fst::ShortestPath(csr_lat, &csr_best_path);
+  std::vector<int32> alignment, csr_alignment, words, csr_words;
+  LatticeWeight weight, csr_weight;
+  fst::GetLinearSymbolSequence(best_path, &alignment, &words, &weight);
+  fst::GetLinearSymbolSequence(csr_best_path, &csr_alignment, &csr_words,
+                               &csr_weight);
+  KALDI_ASSERT(alignment == csr_alignment &&
+               static_cast<int32>(alignment.size()) == loglikes.NumRows());
+  KALDI_ASSERT(ApproxEqual(weight.Value1(), csr_weight.Value1()) &&
+               ApproxEqual(weight.Value2(), csr_weight.Value2()));
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  ContextDependency *ctx_dep;
+  TransitionModel *trans_model = GenRandTransitionModel(&ctx_dep);
+  for (int32 i = 0; i < 20; i++) {
+    UnitTestCsrFstArcs(NULL);
+    UnitTestCsrFstArcs(trans_model);
+  }
+  for (int32 i = 0; i < 50; i++)
+    UnitTestCsrFstDecoding();
+  delete ctx_dep;
+  delete trans_model;
+  KALDI_LOG << "Success.";
+}
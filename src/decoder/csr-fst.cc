@@ -0,0 +1,84 @@
+// decoder/csr-fst.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+
+#include "decoder/csr-fst.h"
+
+namespace fst {
+
+CsrFst::CsrFst(const Fst<StdArc> &fst,
+               const kaldi::TransitionModel *trans_model):
+    ilabels_are_pdfs_(trans_model != NULL) {
+  StateId num_states = 0;
+  for (StateIterator<Fst<StdArc> > siter(fst); !siter.Done(); siter.Next())
+    num_states = std::max(num_states, siter.Value() + 1);
+  start_ = fst.Start();
+  if (start_ == kNoStateId)
+    KALDI_ERR << "Decoding graph has no start state.";
+
+  // Count the arcs of each state, then compute the offsets.
+  std::vector<int32> num_e_arcs(num_states, 0), num_ne_arcs(num_states, 0);
+  final_costs_.resize(num_states);
+  for (StateId s = 0; s < num_states; s++) {
+    final_costs_[s] = fst.Final(s).Value();
+    for (ArcIterator<Fst<StdArc> > aiter(fst, s); !aiter.Done();
+         aiter.Next()) {
+      if (aiter.Value().ilabel != 0) num_e_arcs[s]++;
+      else num_ne_arcs[s]++;
+    }
+  }
+  e_offsets_.resize(num_states + 1);
+  ne_offsets_.resize(num_states + 1);
+  e_offsets_[0] = 0;
+  for (StateId s = 0; s < num_states; s++)
+    e_offsets_[s + 1] = e_offsets_[s] + num_e_arcs[s];
+  ne_offsets_[0] = e_offsets_[num_states];
+  for (StateId s = 0; s < num_states; s++)
+    ne_offsets_[s + 1] = ne_offsets_[s] + num_ne_arcs[s];
+
+  int32 num_arcs = ne_offsets_[num_states];
+  ilabels_.resize(e_offsets_[num_states]);
+  olabels_.resize(num_arcs);
+  weights_.resize(num_arcs);
+  nextstates_.resize(num_arcs);
+  for (StateId s = 0; s < num_states; s++) {
+    int32 e = e_offsets_[s], ne = ne_offsets_[s];
+    for (ArcIterator<Fst<StdArc> > aiter(fst, s); !aiter.Done();
+         aiter.Next()) {
+      const StdArc &arc = aiter.Value();
+      int32 a;
+      if (arc.ilabel != 0) {
+        a = e++;
+        ilabels_[a] = (trans_model == NULL ? arc.ilabel :
+                       trans_model->TransitionIdToPdf(arc.ilabel) + 1);
+      } else {
+        a = ne++;
+      }
+      olabels_[a] = arc.olabel;
+      weights_[a] = arc.weight.Value();
+      nextstates_[a] = arc.nextstate;
+    }
+  }
+  KALDI_VLOG(2) << "Graph has " << num_states << " states, "
+                << NumEmittingArcs() << " emitting and "
+                << (num_arcs - NumEmittingArcs()) << " non-emitting arcs.";
+}
+
+}  // namespace fst
@@ -0,0 +1,180 @@
+// decoder/csr-fst.h
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_DECODER_CSR_FST_H_
+#define KALDI_DECODER_CSR_FST_H_
+
+#include <string>
+#include <vector>
+
+#include "fst/fstlib.h"
+#include "hmm/transition-model.h"
+
+namespace fst {
+
+class CsrFst;
+
+// Declare that we'll be overriding class ArcIterator for class CsrFst.  This
+// wouldn't work if we were fully using the OpenFst framework, e.g. if we had
+// CsrFst inherit from class Fst.
+template <> class ArcIterator<CsrFst>;
+
+
+/**
+   CsrFst is a read-only copy of a decoding graph in the layout the decoders
+   want, like the one CudaFst (cudadecoder/cuda-fst.h) puts on the GPU: it is
+   in compressed-sparse-row format, with the emitting arcs of all the states
+   first and then all the non-emitting arcs, and each property of the arcs
+   (ilabel, olabel, weight, nextstate) in its own array.  The emitting arcs of
+   state s are [EmittingBegin(s), EmittingEnd(s)) and its non-emitting arcs
+   are [NonEmittingBegin(s), NonEmittingEnd(s)).
+
+   Like GrammarFst, this class does not inherit from fst::Fst and only supports
+   the parts of its interface that the decoders need, so it can be used as the
+   FST type of the templated decoders (e.g. LatticeFasterDecoderTpl<CsrFst>),
+   whose arc iteration is then non-virtual and over flat arrays.  Decoders that
+   use the arrays directly (BatchedFasterDecoder) can also process all the
+   emitting arcs of a state in one loop over contiguous arrays.
+
+   If a TransitionModel is given to the constructor, the ilabels are converted
+   from transition-ids to pdf-ids plus one, as CudaFst does, so the acoustic
+   scores can be looked up without going through the TransitionModel.  The
+   decodable object must then be indexed by pdf-id plus one (e.g.
+   nnet3::DecodableNnetLoopedOnline rather than
+   nnet3::DecodableAmNnetLoopedOnline), and the output lattices will have
+   pdf-ids plus one as their ilabels, so this is only suitable if you don't
+   need the transition-ids of the output (e.g. if you only want the words).
+*/
+class CsrFst {
+ public:
+  typedef StdArc Arc;
+  typedef Arc::StateId StateId;
+  typedef Arc::Label Label;
+  typedef Arc::Weight Weight;
+
+  /// Makes the CSR copy of 'fst'.  If 'trans_model' is not NULL, the ilabels
+  /// are converted to pdf-ids plus one (see above).
+  explicit CsrFst(const Fst<StdArc> &fst,
+                  const kaldi::TransitionModel *trans_model = NULL);
+
+  StateId Start() const { return start_; }
+  Weight Final(StateId s) const { return Weight(final_costs_[s]); }
+  /// The number of non-emitting arcs of state s.  (The decoders only use this
+  /// on graphs whose epsilons are all on the input side, for which it is the
+  /// same as in OpenFst).
+  size_t NumInputEpsilons(StateId s) const {
+    return ne_offsets_[s + 1] - ne_offsets_[s];
+  }
+  std::string Type() const { return "csr"; }
+
+  StateId NumStates() const { return final_costs_.size(); }
+  int32 NumArcs() const { return weights_.size(); }
+  int32 NumEmittingArcs() const { return ilabels_.size(); }
+  /// True if the ilabels are pdf-ids plus one.
+  bool IlabelsArePdfs() const { return ilabels_are_pdfs_; }
+
+  int32 EmittingBegin(StateId s) const { return e_offsets_[s]; }
+  int32 EmittingEnd(StateId s) const { return e_offsets_[s + 1]; }
+  int32 NonEmittingBegin(StateId s) const { return ne_offsets_[s]; }
+  int32 NonEmittingEnd(StateId s) const { return ne_offsets_[s + 1]; }
+
+  /// The final-cost of state s (infinity if it is not final).
+  float FinalCost(StateId s) const { return final_costs_[s]; }
+
+  /// The arrays of arc properties, indexed by arc index.  Only the emitting
+  /// arcs have ilabels (there are NumEmittingArcs() of them); the other
+  /// arrays have NumArcs() elements.
+  const Label *Ilabels() const { return ilabels_.data(); }
+  const Label *Olabels() const { return olabels_.data(); }
+  const float *Weights() const { return weights_.data(); }
+  const StateId *Nextstates() const { return nextstates_.data(); }
+
+  /// Returns the arc with index 'a'.
+  Arc GetArc(int32 a) const {
+    return Arc(a < NumEmittingArcs() ? ilabels_[a] : 0, olabels_[a],
+               Weight(weights_[a]), nextstates_[a]);
+  }
+
+ private:
+  StateId start_;
+  bool ilabels_are_pdfs_;
+  std::vector<int32> e_offsets_;  // Size NumStates() + 1.
+  std::vector<int32> ne_offsets_;  // Size NumStates() + 1.
+  std::vector<float> final_costs_;
+  std::vector<Label> ilabels_;  // Emitting arcs only.
+  std::vector<Label> olabels_;
+  std::vector<float> weights_;
+  std::vector<StateId> nextstates_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(CsrFst);
+};
+
+
+/**
+   This is the overridden template for class ArcIterator for CsrFst.  It visits
+   the emitting arcs of the state and then its non-emitting arcs.  As in the
+   ArcIterator of GrammarFst, the current arc is copied to a temporary in
+   Done(), which the calling code always calls before Value().
+*/
+template <>
+class ArcIterator<CsrFst> {
+ public:
+  typedef CsrFst::Arc Arc;
+  typedef CsrFst::StateId StateId;
+
+  inline ArcIterator(const CsrFst &fst, StateId s):
+      fst_(fst), i_(fst.EmittingBegin(s)), end_(fst.EmittingEnd(s)),
+      ne_begin_(fst.NonEmittingBegin(s)), ne_end_(fst.NonEmittingEnd(s)),
+      emitting_(true) { }
+
+  inline bool Done() {
+    if (i_ == end_ && emitting_) {
+      // Go on to the non-emitting arcs.
+      i_ = ne_begin_;
+      end_ = ne_end_;
+      emitting_ = false;
+    }
+    if (i_ < end_) {
+      arc_.ilabel = (emitting_ ? fst_.Ilabels()[i_] : 0);
+      arc_.olabel = fst_.Olabels()[i_];
+      arc_.weight = CsrFst::Weight(fst_.Weights()[i_]);
+      arc_.nextstate = fst_.Nextstates()[i_];
+      return false;
+    } else {
+      return true;
+    }
+  }
+
+  inline void Next() { i_++; }
+
+  inline const Arc &Value() const { return arc_; }
+
+ private:
+  const CsrFst &fst_;
+  int32 i_;  // The current arc index.
+  int32 end_;  // The end of the range of arcs we are in.
+  int32 ne_begin_;  // The range of non-emitting arcs.
+  int32 ne_end_;
+  bool emitting_;  // True while we are visiting the emitting arcs.
+  Arc arc_;
+};
+
+}  // namespace fst
+
+#endif  // KALDI_DECODER_CSR_FST_H_
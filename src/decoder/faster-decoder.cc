@@ -25,21 +25,31 @@ namespace kaldi {
 
 FasterDecoder::FasterDecoder(const fst::Fst<fst::StdArc> &fst,
                              const FasterDecoderOptions &opts):
-    fst_(fst), config_(opts), num_frames_decoded_(-1) {
+    use_token_pool_(opts.use_token_pool), fst_(fst), config_(opts),
+    num_frames_decoded_(-1) {
   KALDI_ASSERT(config_.hash_ratio >= 1.0);  // less doesn't make much sense.
   KALDI_ASSERT(config_.max_active > 1);
   KALDI_ASSERT(config_.min_active >= 0 && config_.min_active < config_.max_active);
   toks_.SetSize(1000);  // just so on the first frame we do something reasonable.
 }
 
+FasterDecoder::~FasterDecoder() {
+  ClearToks(toks_.Clear());
+  if (use_token_pool_)
+    KALDI_VLOG(2) << "Peak token-pool usage: " << token_pool_.PeakInUse()
+                  << " tokens, " << token_pool_.MemoryInBytes() / 1024
+                  << " KB.";
+}
+
 
 void FasterDecoder::InitDecoding() {
   // clean up from last time:
   ClearToks(toks_.Clear());
+  use_token_pool_ = config_.use_token_pool;
   StateId start_state = fst_.Start();
   KALDI_ASSERT(start_state != fst::kNoStateId);
   Arc dummy_arc(0, 0, Weight::One(), start_state);
-  toks_.Insert(start_state, new Token(dummy_arc, NULL));
+  toks_.Insert(start_state, NewToken(dummy_arc, NULL));
   ProcessNonemitting(std::numeric_limits<float>::max());
   num_frames_decoded_ = 0;
 }
@@ -273,16 +283,16 @@ double FasterDecoder::ProcessEmitting(DecodableInterface *decodable) {
           BaseFloat ac_cost =  - decodable->LogLikelihood(frame, arc.ilabel);
           double new_weight = arc.weight.Value() + tok->cost_ + ac_cost;
           if (new_weight < next_weight_cutoff) {  // not pruned..
-            Token *new_tok = new Token(arc, ac_cost, tok);
+            Token *new_tok = NewToken(arc, ac_cost, tok);
             Elem *e_found = toks_.Insert(arc.nextstate, new_tok);
             if (new_weight + adaptive_beam < next_weight_cutoff)
               next_weight_cutoff = new_weight + adaptive_beam;
             if (e_found->val != new_tok) {
               if (*(e_found->val) < *new_tok) {
-                Token::TokenDelete(e_found->val);
+                TokenDelete(e_found->val);
                 e_found->val = new_tok;
               } else {
-                Token::TokenDelete(new_tok);
+                TokenDelete(new_tok);
               }
             }
           }
@@ -290,7 +300,7 @@ double FasterDecoder::ProcessEmitting(DecodableInterface *decodable) {
       }
     }
     e_tail = e->tail;
-    Token::TokenDelete(e->val);
+    TokenDelete(e->val);
     toks_.Delete(e);
   }
   num_frames_decoded_++;
@@ -318,20 +328,20 @@ void FasterDecoder::ProcessNonemitting(double cutoff) {
          aiter.Next()) {
       const Arc &arc = aiter.Value();
       if (arc.ilabel == 0) {  // propagate nonemitting only...
-        Token *new_tok = new Token(arc, tok);
+        Token *new_tok = NewToken(arc, tok);
         if (new_tok->cost_ > cutoff) {  // prune
-          Token::TokenDelete(new_tok);
+          TokenDelete(new_tok);
         } else {
           Elem *e_found = toks_.Insert(arc.nextstate, new_tok);
           if (e_found->val == new_tok) {
             queue_.push_back(e_found);
           } else {
             if (*(e_found->val) < *new_tok) {
-              Token::TokenDelete(e_found->val);
+              TokenDelete(e_found->val);
               e_found->val = new_tok;
               queue_.push_back(e_found);
             } else {
-              Token::TokenDelete(new_tok);
+              TokenDelete(new_tok);
             }
           }
         }
@@ -342,7 +352,7 @@ void FasterDecoder::ProcessNonemitting(double cutoff) {
 
 void FasterDecoder::ClearToks(Elem *list) {
   for (Elem *e = list, *e_tail; e != NULL; e = e_tail) {
-    Token::TokenDelete(e->val);
+    TokenDelete(e->val);
     e_tail = e->tail;
     toks_.Delete(e);
   }
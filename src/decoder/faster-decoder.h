@@ -24,6 +24,7 @@
 #include "util/stl-utils.h"
 #include "itf/options-itf.h"
 #include "util/hash-list.h"
+#include "util/pool-allocator.h"
 #include "fst/fstlib.h"
 #include "itf/decodable-itf.h"
 #include "lat/kaldi-lattice.h" // for CompactLatticeArc
@@ -36,12 +37,16 @@ struct FasterDecoderOptions {
   int32 min_active;
   BaseFloat beam_delta;
   BaseFloat hash_ratio;
+  // If true, tokens are allocated from a memory pool owned by the decoder
+  // instead of with new/delete.
+  bool use_token_pool;
   FasterDecoderOptions(): beam(16.0),
                           max_active(std::numeric_limits<int32>::max()),
                           min_active(20), // This decoder mostly used for
                                           // alignment, use small default.
                           beam_delta(0.5),
-                          hash_ratio(2.0) { }
+                          hash_ratio(2.0),
+                          use_token_pool(false) { }
   void Register(OptionsItf *opts, bool full) {  /// if "full", use obscure
     /// options too.
     /// Depends on program.
@@ -55,6 +60,9 @@ struct FasterDecoderOptions {
                      "Increment used in decoder [obscure setting]");
       opts->Register("hash-ratio", &hash_ratio,
                      "Setting used in decoder to control hash behavior");
+      opts->Register("use-token-pool", &use_token_pool, "If true, allocate "
+                     "tokens from a memory pool in the decoder, which is "
+                     "reused across utterances, instead of with new/delete.");
     }
   }
 };
@@ -71,7 +79,7 @@ class FasterDecoder {
 
   void SetOptions(const FasterDecoderOptions &config) { config_ = config; }
 
-  ~FasterDecoder() { ClearToks(toks_.Clear()); }
+  ~FasterDecoder();
 
   void Decode(DecodableInterface *decodable);
 
@@ -135,19 +143,35 @@ class FasterDecoder {
       return cost_ > other.cost_;
     }
 
-    inline static void TokenDelete(Token *tok) {
-      while (--tok->ref_count_ == 0) {
-        Token *prev = tok->prev_;
-        delete tok;
-        if (prev == NULL) return;
-        else tok = prev;
-      }
+  };
+  typedef OpenHashList<StateId, Token*>::Elem Elem;
+
+  // These allocate tokens, either from token_pool_ (which avoids a
+  // malloc/free per token) or with new, depending on use_token_pool_.
+  // NewToken() takes the same arguments as Token's constructors.
+  inline Token *NewToken(const Arc &arc, BaseFloat ac_cost, Token *prev) {
+    if (use_token_pool_) return token_pool_.New(arc, ac_cost, prev);
+    else return new Token(arc, ac_cost, prev);
+  }
+  inline Token *NewToken(const Arc &arc, Token *prev) {
+    if (use_token_pool_) return token_pool_.New(arc, prev);
+    else return new Token(arc, prev);
+  }
+
+  // Decrements the reference count of 'tok', freeing it (and, recursively,
+  // any predecessors whose count reaches zero) if it is no longer used.
+  inline void TokenDelete(Token *tok) {
+    while (--tok->ref_count_ == 0) {
+      Token *prev = tok->prev_;
+      if (use_token_pool_) token_pool_.Delete(tok);
+      else delete tok;
+      if (prev == NULL) return;
+      else tok = prev;
+    }
 #ifdef KALDI_PARANOID
-      KALDI_ASSERT(tok->ref_count_ > 0);
+    KALDI_ASSERT(tok->ref_count_ > 0);
 #endif
-    }
-  };
-  typedef HashList<StateId, Token*>::Elem Elem;
+  }
 
 
   /// Gets the weight cutoff.  Also counts the active tokens.
@@ -164,10 +188,16 @@ class FasterDecoder {
   // TODO: first time we go through this, could avoid using the queue.
   void ProcessNonemitting(double cutoff);
 
-  // HashList defined in ../util/hash-list.h.  It actually allows us to maintain
-  // more than one list (e.g. for current and previous frames), but only one of
-  // them at a time can be indexed by StateId.
-  HashList<StateId, Token*> toks_;
+  // OpenHashList defined in ../util/hash-list.h.  It actually allows us to
+  // maintain more than one list (e.g. for current and previous frames), but
+  // only one of them at a time can be indexed by StateId.
+  OpenHashList<StateId, Token*> toks_;
+  // Memory pool for the tokens, used if use_token_pool_ is true.
+  // use_token_pool_ is copied from the config by the constructor and by
+  // InitDecoding(), when no tokens are alive, so that it cannot change while
+  // tokens are alive.
+  bool use_token_pool_;
+  PoolAllocator<Token> token_pool_;
   const fst::Fst<fst::StdArc> &fst_;
   FasterDecoderOptions config_;
   std::vector<const Elem* > queue_;  // temp variable used in ProcessNonemitting,
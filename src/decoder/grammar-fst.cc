@@ -19,6 +19,7 @@
 
 #include "decoder/grammar-fst.h"
 #include "fstext/grammar-context-fst.h"
+#include "util/kaldi-io.h"
 
 namespace fst {
 
@@ -404,6 +405,9 @@ void GrammarFstTpl<FST>::Write(std::ostream &os, bool binary) const {
 
   std::string stream_name("unknown");
   FstWriteOptions wopts(stream_name);
+  // Aligning the FSTs lets Read(rxfilename) memory-map them; it needs a
+  // seekable stream, so it is skipped when writing to a pipe.
+  wopts.align = (os.tellp() >= 0);
   top_fst_->Write(os, wopts);
 
   for (int32 i = 0; i < num_ifsts; i++) {
@@ -414,13 +418,20 @@ void GrammarFstTpl<FST>::Write(std::ostream &os, bool binary) const {
   WriteToken(os, binary, "</GrammarFst>");
 }
 
+// If 'source' is nonempty it is the name of the file that 'is' reads from,
+// and aligned FSTs will be memory-mapped from it.
 template <typename FST>
-static FST *ReadConstFstFromStream(std::istream &is) {
+static FST *ReadConstFstFromStream(std::istream &is,
+                                   const std::string &source) {
   fst::FstHeader hdr;
   std::string stream_name("unknown");
   if (!hdr.Read(is, stream_name))
     KALDI_ERR << "Reading FST: error reading FST header";
   FstReadOptions ropts("<unspecified>", &hdr);
+  if (!source.empty() && (hdr.GetFlags() & FstHeader::IS_ALIGNED) != 0) {
+    ropts.mode = FstReadOptions::MAP;
+    ropts.source = source;
+  }
   FST *ans = FST::Read(is, ropts);
   if (!ans)
     KALDI_ERR << "Could not read ConstFst from stream.";
@@ -430,6 +441,22 @@ static FST *ReadConstFstFromStream(std::istream &is) {
 
 template <typename FST>
 void GrammarFstTpl<FST>::Read(std::istream &is, bool binary) {
+  Read(is, binary, "");
+}
+
+template <typename FST>
+void GrammarFstTpl<FST>::Read(const std::string &rxfilename) {
+  bool binary;
+  kaldi::Input ki(rxfilename, &binary);
+  if (kaldi::ClassifyRxfilename(rxfilename) == kaldi::kFileInput)
+    Read(ki.Stream(), binary, rxfilename);
+  else
+    Read(ki.Stream(), binary, "");
+}
+
+template <typename FST>
+void GrammarFstTpl<FST>::Read(std::istream &is, bool binary,
+                              const std::string &source) {
   using namespace kaldi;
   if (!binary)
     KALDI_ERR << "GrammarFstTpl<FST>::Read only supports binary mode.";
@@ -443,12 +470,12 @@ void GrammarFstTpl<FST>::Read(std::istream &is, bool binary) {
         "update your code.";
   ReadBasicType(is, binary, &num_ifsts);
   ReadBasicType(is, binary, &nonterm_phones_offset_);
-  top_fst_ = std::shared_ptr<FST >(ReadConstFstFromStream<FST>(is));
+  top_fst_ = std::shared_ptr<FST >(ReadConstFstFromStream<FST>(is, source));
   for (int32 i = 0; i < num_ifsts; i++) {
     int32 nonterminal;
     ReadBasicType(is, binary, &nonterminal);
     std::shared_ptr<FST >
-        this_fst(ReadConstFstFromStream<FST>(is));
+        this_fst(ReadConstFstFromStream<FST>(is, source));
     ifsts_.push_back(std::pair<int32, std::shared_ptr<FST > >(
         nonterminal, this_fst));
   }
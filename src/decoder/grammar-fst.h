@@ -167,6 +167,11 @@ class GrammarFstTpl {
   // Reads the format that Write() outputs.  Will crash if binary == false.
   void Read(std::istream &os, bool binary);
 
+  // Reads the format that Write() outputs from 'rxfilename'.  If it is a
+  // regular file, the FSTs in it that were written aligned are memory-mapped
+  // rather than read into memory, so they are shared between processes.
+  void Read(const std::string &rxfilename);
+
   StateId Start() const {
     // the top 32 bits of the 64-bit state-id will be zero, because the
     // top FST instance has instance-id = 0.
@@ -330,6 +335,10 @@ class GrammarFstTpl {
 
   friend class ArcIterator<GrammarFstTpl<FST> >;
 
+  // Backs both versions of Read(); 'source' is the name of the file 'is'
+  // reads from if FSTs may be memory-mapped from it, else "".
+  void Read(std::istream &is, bool binary, const std::string &source);
+
   // sets up nonterminal_map_.
   void InitNonterminalMap();
 
@@ -21,6 +21,7 @@
 // limitations under the License.
 
 #include "decoder/lattice-faster-decoder.h"
+#include "decoder/csr-fst.h"
 #include "lat/lattice-functions.h"
 
 namespace kaldi {
@@ -32,6 +33,7 @@ LatticeFasterDecoderTpl<FST, Token>::LatticeFasterDecoderTpl(
     const LatticeFasterDecoderConfig &config):
     fst_(&fst), delete_fst_(false), config_(config), num_toks_(0) {
   config.Check();
+  use_token_pool_ = config.use_token_pool;
   toks_.SetSize(1000);  // just so on the first frame we do something reasonable.
 }
 
@@ -41,6 +43,7 @@ LatticeFasterDecoderTpl<FST, Token>::LatticeFasterDecoderTpl(
     const LatticeFasterDecoderConfig &config, FST *fst):
     fst_(fst), delete_fst_(true), config_(config), num_toks_(0) {
   config.Check();
+  use_token_pool_ = config.use_token_pool;
   toks_.SetSize(1000);  // just so on the first frame we do something reasonable.
 }
 
@@ -49,6 +52,12 @@ template <typename FST, typename Token>
 LatticeFasterDecoderTpl<FST, Token>::~LatticeFasterDecoderTpl() {
   DeleteElems(toks_.Clear());
   ClearActiveTokens();
+  if (use_token_pool_)
+    KALDI_VLOG(2) << "Peak token-pool usage: " << token_pool_.PeakInUse()
+                  << " tokens and " << link_pool_.PeakInUse()
+                  << " forward-links, "
+                  << (token_pool_.MemoryInBytes() +
+                      link_pool_.MemoryInBytes()) / 1024 << " KB.";
   if (delete_fst_) delete fst_;
 }
 
@@ -58,6 +67,7 @@ void LatticeFasterDecoderTpl<FST, Token>::InitDecoding() {
   DeleteElems(toks_.Clear());
   cost_offsets_.clear();
   ClearActiveTokens();
+  use_token_pool_ = config_.use_token_pool;
   warned_ = false;
   num_toks_ = 0;
   decoding_finalized_ = false;
@@ -65,7 +75,7 @@ void LatticeFasterDecoderTpl<FST, Token>::InitDecoding() {
   StateId start_state = fst_->Start();
   KALDI_ASSERT(start_state != fst::kNoStateId);
   active_toks_.resize(1);
-  Token *start_tok = new Token(0.0, 0.0, NULL, NULL, NULL);
+  Token *start_tok = NewToken(0.0, 0.0, NULL, NULL, NULL);
   active_toks_[0].toks = start_tok;
   toks_.Insert(start_state, start_tok);
   num_toks_++;
@@ -263,7 +273,7 @@ LatticeFasterDecoderTpl<FST, Token>::FindOrAddToken(
     // tokens on the currently final frame have zero extra_cost
     // as any of them could end up
     // on the winning path.
-    Token *new_tok = new Token (tot_cost, extra_cost, NULL, toks, backpointer);
+    Token *new_tok = NewToken(tot_cost, extra_cost, NULL, toks, backpointer);
     // NULL: no forward links yet
     toks = new_tok;
     num_toks_++;
@@ -340,7 +350,7 @@ void LatticeFasterDecoderTpl<FST, Token>::PruneForwardLinks(
           ForwardLinkT *next_link = link->next;
           if (prev_link != NULL) prev_link->next = next_link;
           else tok->links = next_link;
-          delete link;
+          DeleteForwardLink(link);
           link = next_link;  // advance link but leave prev_link the same.
           *links_pruned = true;
         } else {   // keep the link and update the tok_extra_cost if needed.
@@ -428,7 +438,7 @@ void LatticeFasterDecoderTpl<FST, Token>::PruneForwardLinksFinal() {
           ForwardLinkT *next_link = link->next;
           if (prev_link != NULL) prev_link->next = next_link;
           else tok->links = next_link;
-          delete link;
+          DeleteForwardLink(link);
           link = next_link; // advance link but leave prev_link the same.
         } else { // keep the link and update the tok_extra_cost if needed.
           if (link_extra_cost < 0.0) { // this is just a precaution.
@@ -489,7 +499,7 @@ void LatticeFasterDecoderTpl<FST, Token>::PruneTokensForFrame(int32 frame_plus_o
       // excise tok from list and delete tok.
       if (prev_tok != NULL) prev_tok->next = tok->next;
       else toks = tok->next;
-      delete tok;
+      DeleteToken(tok);
       num_toks_--;
     } else {  // fetch next Token
       prev_tok = tok;
@@ -792,8 +802,8 @@ BaseFloat LatticeFasterDecoderTpl<FST, Token>::ProcessEmitting(
           // NULL: no change indicator needed
 
           // Add ForwardLink from tok to next_tok (put on head of list tok->links)
-          tok->links = new ForwardLinkT(e_next->val, arc.ilabel, arc.olabel,
-                                        graph_cost, ac_cost, tok->links);
+          tok->links = NewForwardLink(e_next->val, arc.ilabel, arc.olabel,
+                                      graph_cost, ac_cost, tok->links);
         }
       } // for all arcs
     }
@@ -803,13 +813,13 @@ BaseFloat LatticeFasterDecoderTpl<FST, Token>::ProcessEmitting(
   return next_cutoff;
 }
 
-// static inline
+// inline
 template <typename FST, typename Token>
 void LatticeFasterDecoderTpl<FST, Token>::DeleteForwardLinks(Token *tok) {
   ForwardLinkT *l = tok->links, *m;
   while (l != NULL) {
     m = l->next;
-    delete l;
+    DeleteForwardLink(l);
     l = m;
   }
   tok->links = NULL;
@@ -873,8 +883,8 @@ void LatticeFasterDecoderTpl<FST, Token>::ProcessNonemitting(BaseFloat cutoff) {
           Elem *e_new = FindOrAddToken(arc.nextstate, frame + 1, tot_cost,
                                           tok, &changed);
 
-          tok->links = new ForwardLinkT(e_new->val, 0, arc.olabel,
-                                        graph_cost, 0, tok->links);
+          tok->links = NewForwardLink(e_new->val, 0, arc.olabel,
+                                      graph_cost, 0, tok->links);
 
           // "changed" tells us whether the new token has a different
           // cost from before, or is new [if so, add into queue].
@@ -897,15 +907,22 @@ void LatticeFasterDecoderTpl<FST, Token>::DeleteElems(Elem *list) {
 
 template <typename FST, typename Token>
 void LatticeFasterDecoderTpl<FST, Token>::ClearActiveTokens() { // a cleanup routine, at utt end/begin
-  for (size_t i = 0; i < active_toks_.size(); i++) {
-    // Delete all tokens alive on this frame, and any forward
-    // links they may have.
-    for (Token *tok = active_toks_[i].toks; tok != NULL; ) {
-      DeleteForwardLinks(tok);
-      Token *next_tok = tok->next;
-      delete tok;
-      num_toks_--;
-      tok = next_tok;
+  if (use_token_pool_) {
+    // Everything allocated for the utterance is freed at once.
+    token_pool_.Reset();
+    link_pool_.Reset();
+    num_toks_ = 0;
+  } else {
+    for (size_t i = 0; i < active_toks_.size(); i++) {
+      // Delete all tokens alive on this frame, and any forward
+      // links they may have.
+      for (Token *tok = active_toks_[i].toks; tok != NULL; ) {
+        DeleteForwardLinks(tok);
+        Token *next_tok = tok->next;
+        DeleteToken(tok);
+        num_toks_--;
+        tok = next_tok;
+      }
     }
   }
   active_toks_.clear();
@@ -999,12 +1016,14 @@ template class LatticeFasterDecoderTpl<fst::ConstFst<fst::StdArc>, decoder::StdT
 
 template class LatticeFasterDecoderTpl<fst::ConstGrammarFst, decoder::StdToken>;
 template class LatticeFasterDecoderTpl<fst::VectorGrammarFst, decoder::StdToken>;
+template class LatticeFasterDecoderTpl<fst::CsrFst, decoder::StdToken>;
 
 template class LatticeFasterDecoderTpl<fst::Fst<fst::StdArc> , decoder::BackpointerToken>;
 template class LatticeFasterDecoderTpl<fst::VectorFst<fst::StdArc>, decoder::BackpointerToken >;
 template class LatticeFasterDecoderTpl<fst::ConstFst<fst::StdArc>, decoder::BackpointerToken >;
 template class LatticeFasterDecoderTpl<fst::ConstGrammarFst, decoder::BackpointerToken>;
 template class LatticeFasterDecoderTpl<fst::VectorGrammarFst, decoder::BackpointerToken>;
+template class LatticeFasterDecoderTpl<fst::CsrFst, decoder::BackpointerToken>;
 
 
 } // end namespace kaldi.
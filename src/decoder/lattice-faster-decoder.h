@@ -30,6 +30,7 @@
 #include "itf/decodable-itf.h"
 #include "fstext/fstext-lib.h"
 #include "lat/determinize-lattice-pruned.h"
+#include "util/pool-allocator.h"
 #include "lat/kaldi-lattice.h"
 #include "decoder/grammar-fst.h"
 
@@ -49,6 +50,9 @@ struct LatticeFasterDecoderConfig {
   // a very important parameter.  It affects the algorithm that prunes the
   // tokens as we go.
   BaseFloat prune_scale;
+  // If true, tokens and forward-links are allocated from memory pools owned by
+  // the decoder instead of with new/delete.
+  bool use_token_pool;
 
   // Most of the options inside det_opts are not actually queried by the
   // LatticeFasterDecoder class itself, but by the code that calls it, for
@@ -63,7 +67,8 @@ struct LatticeFasterDecoderConfig {
                                 determinize_lattice(true),
                                 beam_delta(0.5),
                                 hash_ratio(2.0),
-                                prune_scale(0.1) { }
+                                prune_scale(0.1),
+                                use_token_pool(false) { }
   void Register(OptionsItf *opts) {
     det_opts.Register(opts);
     opts->Register("beam", &beam, "Decoding beam.  Larger->slower, more accurate.");
@@ -82,6 +87,10 @@ struct LatticeFasterDecoderConfig {
                    "max-active constraint is applied.  Larger is more accurate.");
     opts->Register("hash-ratio", &hash_ratio, "Setting used in decoder to "
                    "control hash behavior");
+    opts->Register("use-token-pool", &use_token_pool, "If true, allocate "
+                   "tokens and lattice links from memory pools in the decoder, "
+                   "which are reused across utterances, instead of with "
+                   "new/delete.");
   }
   void Check() const {
     KALDI_ASSERT(beam > 0.0 && max_active > 1 && lattice_beam > 0.0
@@ -345,7 +354,36 @@ class LatticeFasterDecoderTpl {
   // internals.
 
   // Deletes the elements of the singly linked list tok->links.
-  inline static void DeleteForwardLinks(Token *tok);
+  inline void DeleteForwardLinks(Token *tok);
+
+  // These allocate and free tokens and forward-links, either from token_pool_
+  // and link_pool_ or with new/delete, depending on use_token_pool_.
+  inline Token *NewToken(BaseFloat tot_cost, BaseFloat extra_cost,
+                         ForwardLinkT *links, Token *next, Token *backpointer) {
+    if (use_token_pool_)
+      return token_pool_.New(tot_cost, extra_cost, links, next, backpointer);
+    else
+      return new Token(tot_cost, extra_cost, links, next, backpointer);
+  }
+  inline void DeleteToken(Token *tok) {
+    if (use_token_pool_) token_pool_.Delete(tok);
+    else delete tok;
+  }
+  inline ForwardLinkT *NewForwardLink(Token *next_tok, Label ilabel,
+                                      Label olabel, BaseFloat graph_cost,
+                                      BaseFloat acoustic_cost,
+                                      ForwardLinkT *next) {
+    if (use_token_pool_)
+      return link_pool_.New(next_tok, ilabel, olabel, graph_cost,
+                            acoustic_cost, next);
+    else
+      return new ForwardLinkT(next_tok, ilabel, olabel, graph_cost,
+                              acoustic_cost, next);
+  }
+  inline void DeleteForwardLink(ForwardLinkT *link) {
+    if (use_token_pool_) link_pool_.Delete(link);
+    else delete link;
+  }
 
   // head of per-frame list of Tokens (list is in topological order),
   // and something saying whether we ever pruned it using PruneForwardLinks.
@@ -357,7 +395,7 @@ class LatticeFasterDecoderTpl {
                  must_prune_tokens(true) { }
   };
 
-  using Elem = typename HashList<StateId, Token*>::Elem;
+  using Elem = typename OpenHashList<StateId, Token*>::Elem;
   // Equivalent to:
   //  struct Elem {
   //    StateId key;
@@ -449,14 +487,14 @@ class LatticeFasterDecoderTpl {
   /// preceding ProcessEmitting().
   void ProcessNonemitting(BaseFloat cost_cutoff);
 
-  // HashList defined in ../util/hash-list.h.  It actually allows us to maintain
-  // more than one list (e.g. for current and previous frames), but only one of
-  // them at a time can be indexed by StateId.  It is indexed by frame-index
-  // plus one, where the frame-index is zero-based, as used in decodable object.
-  // That is, the emitting probs of frame t are accounted for in tokens at
-  // toks_[t+1].  The zeroth frame is for nonemitting transition at the start of
-  // the graph.
-  HashList<StateId, Token*> toks_;
+  // OpenHashList defined in ../util/hash-list.h.  It actually allows us to
+  // maintain more than one list (e.g. for current and previous frames), but
+  // only one of them at a time can be indexed by StateId.  It is indexed by
+  // frame-index plus one, where the frame-index is zero-based, as used in
+  // decodable object.  That is, the emitting probs of frame t are accounted for
+  // in tokens at toks_[t+1].  The zeroth frame is for nonemitting transition at
+  // the start of the graph.
+  OpenHashList<StateId, Token*> toks_;
 
   std::vector<TokenList> active_toks_; // Lists of tokens, indexed by
   // frame (members of TokenList are toks, must_prune_forward_links,
@@ -478,6 +516,13 @@ class LatticeFasterDecoderTpl {
   int32 num_toks_; // current total #toks allocated...
   bool warned_;
 
+  // Memory pools for the tokens and forward-links, used if use_token_pool_ is
+  // true.  use_token_pool_ is copied from the config by InitDecoding(), so
+  // that it cannot change while tokens are alive.
+  bool use_token_pool_;
+  PoolAllocator<Token> token_pool_;
+  PoolAllocator<ForwardLinkT> link_pool_;
+
   /// decoding_finalized_ is true if someone called FinalizeDecoding().  [note,
   /// calling this is optional].  If true, it's forbidden to decode more.  Also,
   /// if this is set, then the output of ComputeFinalCosts() is in the next
@@ -25,6 +25,7 @@
 // file in sync with lattice-faster-decoder.cc
 
 #include "decoder/lattice-faster-online-decoder.h"
+#include "decoder/csr-fst.h"
 #include "lat/lattice-functions.h"
 
 namespace kaldi {
@@ -172,6 +173,48 @@ typename LatticeFasterOnlineDecoderTpl<FST>::BestPathIterator LatticeFasterOnlin
   return BestPathIterator(tok->backpointer, cur_t + step_t);
 }
 
+template <typename FST>
+typename LatticeFasterOnlineDecoderTpl<FST>::BestPathIterator
+LatticeFasterOnlineDecoderTpl<FST>::ImmortalPoint(int32 max_frames) const {
+  int32 num_frames = this->NumFramesDecoded();
+  KALDI_ASSERT(num_frames > 0);
+  // 'frontier' is the set of tokens on frame t (in the numbering of
+  // active_toks_) at which the best paths of the active tokens enter frame t;
+  // initially, t is the last frame and it is the set of active tokens.
+  unordered_set<Token*> frontier, prev_frontier;
+  for (Token *tok = this->active_toks_.back().toks; tok != NULL;
+       tok = tok->next)
+    frontier.insert(tok);
+  for (int32 t = num_frames; t >= 0 && num_frames - t <= max_frames; t--) {
+    if (frontier.size() == 1)
+      return BestPathIterator(*frontier.begin(), t - 1);
+    if (frontier.empty())
+      break;
+    // Follow each path back through any epsilon links on frame t, to the
+    // emitting link from frame t - 1.
+    prev_frontier.clear();
+    for (typename unordered_set<Token*>::const_iterator iter = frontier.begin();
+         iter != frontier.end(); ++iter) {
+      BestPathIterator path(*iter, t - 1);
+      LatticeArc arc;
+      while (true) {
+        BestPathIterator prev = TraceBackBestPath(path, &arc);
+        if (prev.Done()) {
+          // 'path' is at the start token, on frame 0.
+          prev_frontier.insert(static_cast<Token*>(path.tok));
+          break;
+        } else if (prev.frame < path.frame) {
+          prev_frontier.insert(static_cast<Token*>(prev.tok));
+          break;
+        }
+        path = prev;
+      }
+    }
+    frontier.swap(prev_frontier);
+  }
+  return BestPathIterator(NULL, -1);
+}
+
 template <typename FST>
 bool LatticeFasterOnlineDecoderTpl<FST>::GetRawLatticePruned(
     Lattice *ofst,
@@ -280,6 +323,7 @@ template class LatticeFasterOnlineDecoderTpl<fst::VectorFst<fst::StdArc> >;
 template class LatticeFasterOnlineDecoderTpl<fst::ConstFst<fst::StdArc> >;
 template class LatticeFasterOnlineDecoderTpl<fst::ConstGrammarFst >;
 template class LatticeFasterOnlineDecoderTpl<fst::VectorGrammarFst >;
+template class LatticeFasterOnlineDecoderTpl<fst::CsrFst >;
 
 
 } // end namespace kaldi.
@@ -126,6 +126,22 @@ class LatticeFasterOnlineDecoderTpl:
   BestPathIterator TraceBackBestPath(
       BestPathIterator iter, LatticeArc *arc) const;
 
+  /// Returns an iterator for the most recent token that the best paths of all
+  /// the currently active tokens pass through.  Every path that is decoded from
+  /// now on extends one of those, so the best path up to that token can no
+  /// longer change; it can be traced back with TraceBackBestPath() (e.g. by
+  /// class OnlineWordAligner).  Only looks back 'max_frames' frames; if the
+  /// paths have not met by then, returns an iterator with Done() == true.  If
+  /// they only meet at the start of the utterance, the returned iterator has
+  /// frame == -1.  Requires that NumFramesDecoded() > 0.
+  /// The cost is the number of active tokens on the last frame plus, for each
+  /// frame looked back, the number of distinct best-path predecessors on that
+  /// frame (plus any epsilon links); these merge quickly, but callers that
+  /// call this often should pass a 'max_frames' that stops at the previous
+  /// immortal point, as OnlineWordAligner does, so that each frame is looked
+  /// at about once.
+  BestPathIterator ImmortalPoint(int32 max_frames) const;
+
 
   /// Behaves the same as GetRawLattice but only processes tokens whose
   /// extra_cost is smaller than the best-cost plus the specified beam.
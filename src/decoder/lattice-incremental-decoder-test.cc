@@ -0,0 +1,113 @@
+// decoder/lattice-incremental-decoder-test.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "decoder/lattice-incremental-decoder.h"
+#include "decoder/decodable-matrix.h"
+#include "fstext/rand-fst.h"
+#include "hmm/hmm-test-utils.h"
+
+namespace kaldi {
+
+// Decodes 'loglikes' with 'config', calling AdvanceDecoding() with the chunk
+// sizes in 'chunk_sizes' (the last one repeated as needed), and outputs the
+// final lattice to 'clat'.  After each chunk it also asks for a partial
+// lattice, as an online application would.
+static void DecodeIncrementally(const fst::StdVectorFst &graph,
+                                const TransitionModel &trans_model,
+                                const LatticeIncrementalDecoderConfig &config,
+                                const Matrix<BaseFloat> &loglikes,
+                                const std::vector<int32> &chunk_sizes,
+                                CompactLattice *clat) {
+  LatticeIncrementalDecoderTpl<fst::StdVectorFst> decoder(graph, trans_model,
+                                                          config);
+  DecodableMatrixScaledMapped decodable(trans_model, loglikes, 1.0);
+  decoder.InitDecoding();
+  for (size_t i = 0; decoder.NumFramesDecoded() < loglikes.NumRows(); i++) {
+    int32 chunk_size = chunk_sizes[std::min(i, chunk_sizes.size() - 1)];
+    decoder.AdvanceDecoding(&decodable, chunk_size);
+    if (i % 2 == 1)
+      decoder.GetLattice(decoder.NumFramesDecoded());
+  }
+  decoder.FinalizeDecoding();
+  *clat = decoder.GetLattice(decoder.NumFramesDecoded(), true);
+  fst::Connect(clat);
+}
+
+// Checks that determinizing the chunks of lattice in a background thread
+// (--determinize-in-background) gives the same lattice as doing it in the
+// decoding thread.
+void UnitTestLatticeIncrementalDecoderBackground() {
+  ContextDependency *ctx_dep = NULL;
+  TransitionModel *trans_model = GenRandTransitionModel(&ctx_dep);
+  int32 num_tids = trans_model->NumTransitionIds();
+
+  fst::RandFstOptions fst_opts;
+  fst_opts.allow_empty = false;
+  fst::StdVectorFst *graph = fst::RandFst<fst::StdArc>(fst_opts);
+  // Map the input labels to transition-ids, and add a self-loop to each
+  // state so that there are paths of any length.
+  for (int32 s = 0; s < graph->NumStates(); s++) {
+    for (fst::MutableArcIterator<fst::StdVectorFst> aiter(graph, s);
+         !aiter.Done(); aiter.Next()) {
+      fst::StdArc arc = aiter.Value();
+      if (arc.ilabel != 0) {
+        arc.ilabel = 1 + (arc.ilabel - 1) % num_tids;
+        aiter.SetValue(arc);
+      }
+    }
+    graph->AddArc(s, fst::StdArc(RandInt(1, num_tids), 0, 1.0, s));
+  }
+
+  LatticeIncrementalDecoderConfig config;
+  config.beam = RandInt(8, 16);
+  config.lattice_beam = RandInt(2, 8);
+  config.determinize_min_chunk_size = RandInt(1, 5);
+  config.determinize_max_delay = config.determinize_min_chunk_size +
+      RandInt(1, 10);
+
+  Matrix<BaseFloat> loglikes(RandInt(1, 150), trans_model->NumPdfs());
+  loglikes.SetRandn();
+  loglikes.ApplyPow(2.0);
+  loglikes.Scale(-1.0);
+  std::vector<int32> chunk_sizes;
+  for (int32 i = 0; i < 20; i++)
+    chunk_sizes.push_back(RandInt(1, 20));
+
+  CompactLattice clat, background_clat;
+  DecodeIncrementally(*graph, *trans_model, config, loglikes, chunk_sizes,
+                      &clat);
+  config.determinize_in_background = true;
+  DecodeIncrementally(*graph, *trans_model, config, loglikes, chunk_sizes,
+                      &background_clat);
+  // Only the thread that runs AcceptRawLatticeChunk() differs, so the
+  // lattices should be identical, including the state numbering.
+  KALDI_ASSERT(fst::Equal(clat, background_clat, 1.0e-04));
+
+  delete graph;
+  delete trans_model;
+  delete ctx_dep;
+}
+
+}  // namespace kaldi
+
+int main() {
+  for (int32 i = 0; i < 50; i++)
+    kaldi::UnitTestLatticeIncrementalDecoderBackground();
+  KALDI_LOG << "Success.";
+}
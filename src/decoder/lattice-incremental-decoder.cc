@@ -34,6 +34,7 @@ LatticeIncrementalDecoderTpl<FST, Token>::LatticeIncrementalDecoderTpl(
       config_(config),
       determinizer_(trans_model, config) {
   config.Check();
+  use_token_pool_ = config.use_token_pool;
   toks_.SetSize(1000); // just so on the first frame we do something reasonable.
 }
 
@@ -47,13 +48,22 @@ LatticeIncrementalDecoderTpl<FST, Token>::LatticeIncrementalDecoderTpl(
       config_(config),
       determinizer_(trans_model, config) {
   config.Check();
+  use_token_pool_ = config.use_token_pool;
   toks_.SetSize(1000); // just so on the first frame we do something reasonable.
 }
 
 template <typename FST, typename Token>
 LatticeIncrementalDecoderTpl<FST, Token>::~LatticeIncrementalDecoderTpl() {
+  if (determinize_thread_.joinable())
+    determinize_thread_.join();  // ignore any error; we're being destroyed.
   DeleteElems(toks_.Clear());
   ClearActiveTokens();
+  if (use_token_pool_)
+    KALDI_VLOG(2) << "Peak token-pool usage: " << token_pool_.PeakInUse()
+                  << " tokens and " << link_pool_.PeakInUse()
+                  << " forward-links, "
+                  << (token_pool_.MemoryInBytes() +
+                      link_pool_.MemoryInBytes()) / 1024 << " KB.";
   if (delete_fst_) delete fst_;
 }
 
@@ -63,6 +73,7 @@ void LatticeIncrementalDecoderTpl<FST, Token>::InitDecoding() {
   DeleteElems(toks_.Clear());
   cost_offsets_.clear();
   ClearActiveTokens();
+  use_token_pool_ = config_.use_token_pool;
   warned_ = false;
   num_toks_ = 0;
   decoding_finalized_ = false;
@@ -70,11 +81,12 @@ void LatticeIncrementalDecoderTpl<FST, Token>::InitDecoding() {
   StateId start_state = fst_->Start();
   KALDI_ASSERT(start_state != fst::kNoStateId);
   active_toks_.resize(1);
-  Token *start_tok = new Token(0.0, 0.0, NULL, NULL, NULL);
+  Token *start_tok = NewToken(0.0, 0.0, NULL, NULL, NULL);
   active_toks_[0].toks = start_tok;
   toks_.Insert(start_state, start_tok);
   num_toks_++;
 
+  WaitForDeterminization();
   determinizer_.Init();
   num_frames_in_lattice_ = 0;
   token2label_map_.clear();
@@ -109,10 +121,9 @@ void LatticeIncrementalDecoderTpl<FST, Token>::UpdateLatticeDeterminization() {
     }
   }
   /* OK, determinize the chunk that spans from num_frames_in_lattice_ to
-     best_frame. */
-  bool use_final_probs = false;
-  GetLattice(best_frame, use_final_probs);
-  return;
+     best_frame; if configured, this is done in a background thread while we
+     carry on decoding. */
+  DeterminizeChunk(best_frame, config_.determinize_in_background);
 }
 // Returns true if any kind of traceback is available (not necessarily from
 // a final state).  It should only very rarely return false; this indicates
@@ -207,7 +218,7 @@ inline Token *LatticeIncrementalDecoderTpl<FST, Token>::FindOrAddToken(
     // tokens on the currently final frame have zero extra_cost
     // as any of them could end up
     // on the winning path.
-    Token *new_tok = new Token(tot_cost, extra_cost, NULL, toks, backpointer);
+    Token *new_tok = NewToken(tot_cost, extra_cost, NULL, toks, backpointer);
     // NULL: no forward links yet
     toks = new_tok;
     num_toks_++;
@@ -287,7 +298,7 @@ void LatticeIncrementalDecoderTpl<FST, Token>::PruneForwardLinks(
             prev_link->next = next_link;
           else
             tok->links = next_link;
-          delete link;
+          DeleteForwardLink(link);
           link = next_link; // advance link but leave prev_link the same.
           *links_pruned = true;
         } else { // keep the link and update the tok_extra_cost if needed.
@@ -378,7 +389,7 @@ void LatticeIncrementalDecoderTpl<FST, Token>::PruneForwardLinksFinal() {
             prev_link->next = next_link;
           else
             tok->links = next_link;
-          delete link;
+          DeleteForwardLink(link);
           link = next_link; // advance link but leave prev_link the same.
         } else {            // keep the link and update the tok_extra_cost if needed.
           if (link_extra_cost < 0.0) { // this is just a precaution.
@@ -433,7 +444,7 @@ void LatticeIncrementalDecoderTpl<FST, Token>::PruneTokensForFrame(
         prev_tok->next = tok->next;
       else
         toks = tok->next;
-      delete tok;
+      DeleteToken(tok);
       num_toks_--;
     } else { // fetch next Token
       prev_tok = tok;
@@ -749,8 +760,8 @@ BaseFloat LatticeIncrementalDecoderTpl<FST, Token>::ProcessEmitting(
           // NULL: no change indicator needed
 
           // Add ForwardLink from tok to next_tok (put on head of list tok->links)
-          tok->links = new ForwardLinkT(next_tok, arc.ilabel, arc.olabel, graph_cost,
-                                        ac_cost, tok->links);
+          tok->links = NewForwardLink(next_tok, arc.ilabel, arc.olabel, graph_cost,
+                                      ac_cost, tok->links);
         }
       } // for all arcs
     }
@@ -760,13 +771,13 @@ BaseFloat LatticeIncrementalDecoderTpl<FST, Token>::ProcessEmitting(
   return next_cutoff;
 }
 
-// static inline
+// inline
 template <typename FST, typename Token>
 void LatticeIncrementalDecoderTpl<FST, Token>::DeleteForwardLinks(Token *tok) {
   ForwardLinkT *l = tok->links, *m;
   while (l != NULL) {
     m = l->next;
-    delete l;
+    DeleteForwardLink(l);
     l = m;
   }
   tok->links = NULL;
@@ -827,7 +838,7 @@ void LatticeIncrementalDecoderTpl<FST, Token>::ProcessNonemitting(BaseFloat cuto
               FindOrAddToken(arc.nextstate, frame + 1, tot_cost, tok, &changed);
 
           tok->links =
-              new ForwardLinkT(new_tok, 0, arc.olabel, graph_cost, 0, tok->links);
+              NewForwardLink(new_tok, 0, arc.olabel, graph_cost, 0, tok->links);
 
           // "changed" tells us whether the new token has a different
           // cost from before, or is new [if so, add into queue].
@@ -850,15 +861,22 @@ void LatticeIncrementalDecoderTpl<FST, Token>::DeleteElems(Elem *list) {
 template <typename FST, typename Token>
 void LatticeIncrementalDecoderTpl<
     FST, Token>::ClearActiveTokens() { // a cleanup routine, at utt end/begin
-  for (size_t i = 0; i < active_toks_.size(); i++) {
-    // Delete all tokens alive on this frame, and any forward
-    // links they may have.
-    for (Token *tok = active_toks_[i].toks; tok != NULL;) {
-      DeleteForwardLinks(tok);
-      Token *next_tok = tok->next;
-      delete tok;
-      num_toks_--;
-      tok = next_tok;
+  if (use_token_pool_) {
+    // Everything allocated for the utterance is freed at once.
+    token_pool_.Reset();
+    link_pool_.Reset();
+    num_toks_ = 0;
+  } else {
+    for (size_t i = 0; i < active_toks_.size(); i++) {
+      // Delete all tokens alive on this frame, and any forward
+      // links they may have.
+      for (Token *tok = active_toks_[i].toks; tok != NULL;) {
+        DeleteForwardLinks(tok);
+        Token *next_tok = tok->next;
+        DeleteToken(tok);
+        num_toks_--;
+        tok = next_tok;
+      }
     }
   }
   active_toks_.clear();
@@ -872,7 +890,7 @@ const CompactLattice& LatticeIncrementalDecoderTpl<FST, Token>::GetLattice(
     bool use_final_probs) {
   KALDI_ASSERT(num_frames_to_include >= num_frames_in_lattice_ &&
                num_frames_to_include <= NumFramesDecoded());
-
+  WaitForDeterminization();
 
   if (num_frames_in_lattice_ > 0 &&
       determinizer_.GetLattice().NumStates() == 0) {
@@ -897,196 +915,257 @@ const CompactLattice& LatticeIncrementalDecoderTpl<FST, Token>::GetLattice(
 
 
   if (num_frames_to_include > num_frames_in_lattice_) {
-    /* Make sure the token-pruning is up to date.   If we just pruned the tokens,
-       this will do very little work. */
-    PruneActiveTokens(config_.lattice_beam * config_.prune_scale);
-
-    if (determinizer_.GetLattice().NumStates() == 0 ||
-        determinizer_.GetLattice().Final(0) != CompactLatticeWeight::Zero()) {
-      num_frames_in_lattice_ = 0;
-      determinizer_.Init();
+    bool in_background = false;
+    DeterminizeChunk(num_frames_to_include, in_background);
+    if (determinizer_.GetLattice().NumStates() == 0)
+      return determinizer_.GetLattice();   // Something went wrong, lattice is empty.
+  }
+
+  unordered_map<Token*, BaseFloat> token2final_cost;
+  unordered_map<Label, BaseFloat> token_label2final_cost;
+  if (use_final_probs) {
+    ComputeFinalCosts(&token2final_cost, NULL, NULL);
+    for (const auto &p: token2final_cost) {
+      Token *tok = p.first;
+      BaseFloat cost = p.second;
+      auto iter = token2label_map_.find(tok);
+      if (iter != token2label_map_.end()) {
+        /* Some tokens may not have survived the pruned determinization. */
+        Label token_label = iter->second;
+        bool ret = token_label2final_cost.insert({token_label, cost}).second;
+        KALDI_ASSERT(ret); /* Make sure it was inserted. */
+      }
     }
+  }
+  /* Note: these final-probs won't affect the next chunk, only the lattice
+     returned from GetLattice().  They are kind of temporaries. */
+  determinizer_.SetFinalCosts(token_label2final_cost.empty() ? NULL :
+                              &token_label2final_cost);
 
-    Lattice chunk_lat;
+  return determinizer_.GetLattice();
+}
 
-    unordered_map<Label, LatticeArc::StateId> token_label2state;
-    if (num_frames_in_lattice_ != 0) {
-      determinizer_.InitializeRawLatticeChunk(&chunk_lat,
-                                              &token_label2state);
-    }
 
-    // tok_map will map from Token* to state-id in chunk_lat.
-    // The cur and prev versions alternate on different frames.
-    unordered_map<Token*, StateId> &tok2state_map(temp_token_map_);
-    tok2state_map.clear();
+template <typename FST, typename Token>
+void LatticeIncrementalDecoderTpl<FST, Token>::DeterminizeChunk(
+    int32 num_frames_to_include, bool in_background) {
+  KALDI_ASSERT(num_frames_to_include > num_frames_in_lattice_);
+  WaitForDeterminization();
+  if (num_frames_in_lattice_ > 0 &&
+      determinizer_.GetLattice().NumStates() == 0) {
+    // Something went wrong earlier; the lattice will remain empty.
+    num_frames_in_lattice_ = num_frames_to_include;
+    return;
+  }
 
-    unordered_map<Token*, Label> &next_token2label_map(token2label_map_temp_);
-    next_token2label_map.clear();
+  /* Make sure the token-pruning is up to date.   If we just pruned the tokens,
+     this will do very little work. */
+  PruneActiveTokens(config_.lattice_beam * config_.prune_scale);
 
-    { // Deal with the last frame in the chunk, the one numbered `num_frames_to_include`.
-      // (Yes, this is backwards).   We allocate token labels, and set tokens as
-      // final, but don't add any transitions.  This may leave some states
-      // disconnected (e.g. due to chains of nonemitting arcs), but it's OK; we'll
-      // fix it when we generate the next chunk of lattice.
-      int32 frame = num_frames_to_include;
-      // Allocate state-ids for all tokens on this frame.
+  if (determinizer_.GetLattice().NumStates() == 0 ||
+      determinizer_.GetLattice().Final(0) != CompactLatticeWeight::Zero()) {
+    num_frames_in_lattice_ = 0;
+    determinizer_.Init();
+  }
 
-      for (Token *tok = active_toks_[frame].toks; tok != NULL; tok = tok->next) {
-        /* If we included the final-costs at this stage, they will cause
-           non-final states to be pruned out from the end of the lattice. */
-        BaseFloat final_cost;
-        {  // This block computes final_cost
-          if (decoding_finalized_) {
-            if (final_costs_.empty()) {
-              final_cost = 0.0;  /* No final-state survived, so treat all as final
-                                  * with probability One(). */
-            } else {
-              auto iter = final_costs_.find(tok);
-              if (iter == final_costs_.end())
-                final_cost = std::numeric_limits<BaseFloat>::infinity();
-              else
-                final_cost = iter->second;
-            }
+  // The chunk is a class member so that it can be determinized in the
+  // background after this function returns.
+  Lattice &chunk_lat = raw_chunk_;
+  chunk_lat.DeleteStates();
+
+  unordered_map<Label, LatticeArc::StateId> token_label2state;
+  if (num_frames_in_lattice_ != 0) {
+    determinizer_.InitializeRawLatticeChunk(&chunk_lat,
+                                            &token_label2state);
+  }
+
+  // tok_map will map from Token* to state-id in chunk_lat.
+  // The cur and prev versions alternate on different frames.
+  unordered_map<Token*, StateId> &tok2state_map(temp_token_map_);
+  tok2state_map.clear();
+
+  unordered_map<Token*, Label> &next_token2label_map(token2label_map_temp_);
+  next_token2label_map.clear();
+
+  { // Deal with the last frame in the chunk, the one numbered `num_frames_to_include`.
+    // (Yes, this is backwards).   We allocate token labels, and set tokens as
+    // final, but don't add any transitions.  This may leave some states
+    // disconnected (e.g. due to chains of nonemitting arcs), but it's OK; we'll
+    // fix it when we generate the next chunk of lattice.
+    int32 frame = num_frames_to_include;
+    // Allocate state-ids for all tokens on this frame.
+
+    for (Token *tok = active_toks_[frame].toks; tok != NULL; tok = tok->next) {
+      /* If we included the final-costs at this stage, they will cause
+         non-final states to be pruned out from the end of the lattice. */
+      BaseFloat final_cost;
+      {  // This block computes final_cost
+        if (decoding_finalized_) {
+          if (final_costs_.empty()) {
+            final_cost = 0.0;  /* No final-state survived, so treat all as final
+                                * with probability One(). */
           } else {
-            /* this is a `fake` final-cost used to guide pruning.  It's as if we
-               set the betas (backward-probs) on the final frame to the
-               negatives of the corresponding alphas, so all tokens on the last
-               frae will be on a best path..  the extra_cost for each token
-               always corresponds to its alpha+beta on this assumption.  We want
-               the final_cost here to correspond to the beta (backward-prob), so
-               we get that by final_cost = extra_cost - tot_cost.
-               [The tot_cost is the forward/alpha cost.]
-            */
-            final_cost = tok->extra_cost - tok->tot_cost;
+            auto iter = final_costs_.find(tok);
+            if (iter == final_costs_.end())
+              final_cost = std::numeric_limits<BaseFloat>::infinity();
+            else
+              final_cost = iter->second;
           }
+        } else {
+          /* this is a `fake` final-cost used to guide pruning.  It's as if we
+             set the betas (backward-probs) on the final frame to the
+             negatives of the corresponding alphas, so all tokens on the last
+             frae will be on a best path..  the extra_cost for each token
+             always corresponds to its alpha+beta on this assumption.  We want
+             the final_cost here to correspond to the beta (backward-prob), so
+             we get that by final_cost = extra_cost - tot_cost.
+             [The tot_cost is the forward/alpha cost.]
+          */
+          final_cost = tok->extra_cost - tok->tot_cost;
         }
+      }
 
-        StateId state = chunk_lat.AddState();
-        tok2state_map[tok] = state;
-        if (final_cost < std::numeric_limits<BaseFloat>::infinity()) {
-          next_token2label_map[tok] = AllocateNewTokenLabel();
-          StateId token_final_state = chunk_lat.AddState();
-          LatticeArc::Label ilabel = 0,
-              olabel = (next_token2label_map[tok] = AllocateNewTokenLabel());
-          chunk_lat.AddArc(state,
-                           LatticeArc(ilabel, olabel,
-                                      LatticeWeight::One(),
-                                      token_final_state));
-          chunk_lat.SetFinal(token_final_state, LatticeWeight(final_cost, 0.0));
-        }
+      StateId state = chunk_lat.AddState();
+      tok2state_map[tok] = state;
+      if (final_cost < std::numeric_limits<BaseFloat>::infinity()) {
+        next_token2label_map[tok] = AllocateNewTokenLabel();
+        StateId token_final_state = chunk_lat.AddState();
+        LatticeArc::Label ilabel = 0,
+            olabel = (next_token2label_map[tok] = AllocateNewTokenLabel());
+        chunk_lat.AddArc(state,
+                         LatticeArc(ilabel, olabel,
+                                    LatticeWeight::One(),
+                                    token_final_state));
+        chunk_lat.SetFinal(token_final_state, LatticeWeight(final_cost, 0.0));
       }
     }
+  }
 
-    // Go in reverse order over the remaining frames so we can create arcs as we
-    // go, and their destination-states will already be in the map.
-    for (int32 frame = num_frames_to_include;
-         frame >= num_frames_in_lattice_; frame--) {
-      // The conditional below is needed for the last frame of the utterance.
-      BaseFloat cost_offset = (frame < cost_offsets_.size() ?
-                               cost_offsets_[frame] : 0.0);
-
-      // For the first frame of the chunk, we need to make sure the states are
-      // the ones created by InitializeRawLatticeChunk() (where not pruned away).
-      if (frame == num_frames_in_lattice_ && num_frames_in_lattice_ != 0) {
-        for (Token *tok = active_toks_[frame].toks; tok != NULL; tok = tok->next) {
-          auto iter = token2label_map_.find(tok);
-          KALDI_ASSERT(iter != token2label_map_.end());
-          Label token_label = iter->second;
-          auto iter2 = token_label2state.find(token_label);
-          if (iter2 != token_label2state.end()) {
-            StateId state = iter2->second;
-            tok2state_map[tok] = state;
-          } else {
-            // Some states may have been pruned out, but we should still allocate
-            // them.  They might have been part of chains of nonemitting arcs
-            // where the state became disconnected because the last chunk didn't
-            // include arcs starting at this frame.
-            StateId state = chunk_lat.AddState();
-            tok2state_map[tok] = state;
-          }
-        }
-      } else if (frame != num_frames_to_include) {  // We already created states
-                                                    // for the last frame.
-        for (Token *tok = active_toks_[frame].toks; tok != NULL; tok = tok->next) {
+  // Go in reverse order over the remaining frames so we can create arcs as we
+  // go, and their destination-states will already be in the map.
+  for (int32 frame = num_frames_to_include;
+       frame >= num_frames_in_lattice_; frame--) {
+    // The conditional below is needed for the last frame of the utterance.
+    BaseFloat cost_offset = (frame < cost_offsets_.size() ?
+                             cost_offsets_[frame] : 0.0);
+
+    // For the first frame of the chunk, we need to make sure the states are
+    // the ones created by InitializeRawLatticeChunk() (where not pruned away).
+    if (frame == num_frames_in_lattice_ && num_frames_in_lattice_ != 0) {
+      for (Token *tok = active_toks_[frame].toks; tok != NULL; tok = tok->next) {
+        auto iter = token2label_map_.find(tok);
+        KALDI_ASSERT(iter != token2label_map_.end());
+        Label token_label = iter->second;
+        auto iter2 = token_label2state.find(token_label);
+        if (iter2 != token_label2state.end()) {
+          StateId state = iter2->second;
+          tok2state_map[tok] = state;
+        } else {
+          // Some states may have been pruned out, but we should still allocate
+          // them.  They might have been part of chains of nonemitting arcs
+          // where the state became disconnected because the last chunk didn't
+          // include arcs starting at this frame.
           StateId state = chunk_lat.AddState();
           tok2state_map[tok] = state;
         }
       }
+    } else if (frame != num_frames_to_include) {  // We already created states
+                                                  // for the last frame.
       for (Token *tok = active_toks_[frame].toks; tok != NULL; tok = tok->next) {
-        auto iter = tok2state_map.find(tok);
-        KALDI_ASSERT(iter != tok2state_map.end());
-        StateId cur_state = iter->second;
-        for (ForwardLinkT *l = tok->links; l != NULL; l = l->next) {
-          auto next_iter = tok2state_map.find(l->next_tok);
-          if (next_iter == tok2state_map.end()) {
-            // Emitting arcs from the last frame we're including -- ignore
-            // these.
-            KALDI_ASSERT(frame == num_frames_to_include);
-            continue;
-          }
-          StateId next_state = next_iter->second;
-          BaseFloat this_offset = (l->ilabel != 0 ? cost_offset : 0);
-          LatticeArc arc(l->ilabel, l->olabel,
-                         LatticeWeight(l->graph_cost, l->acoustic_cost - this_offset),
-                         next_state);
-          // Note: the epsilons get redundantly included at the end and beginning
-          // of successive chunks.  These will get removed in the determinization.
-          chunk_lat.AddArc(cur_state, arc);
-        }
+        StateId state = chunk_lat.AddState();
+        tok2state_map[tok] = state;
       }
     }
-    if (num_frames_in_lattice_ == 0) {
-      // This block locates the start token.  NOTE: we use the fact that in the
-      // linked list of tokens, things are added at the head, so the start state
-      // must be at the tail.  If this data structure is changed in future, we
-      // might need to explicitly store the start token as a class member.
-      Token *tok = active_toks_[0].toks;
-      if (tok == NULL) {
-        KALDI_WARN << "No tokens exist on start frame";
-        return determinizer_.GetLattice();  // will be empty.
-      }
-      while (tok->next != NULL)
-        tok = tok->next;
-      Token *start_token = tok;
-      auto iter = tok2state_map.find(start_token);
+    for (Token *tok = active_toks_[frame].toks; tok != NULL; tok = tok->next) {
+      auto iter = tok2state_map.find(tok);
       KALDI_ASSERT(iter != tok2state_map.end());
-      StateId start_state = iter->second;
-      chunk_lat.SetStart(start_state);
+      StateId cur_state = iter->second;
+      for (ForwardLinkT *l = tok->links; l != NULL; l = l->next) {
+        auto next_iter = tok2state_map.find(l->next_tok);
+        if (next_iter == tok2state_map.end()) {
+          // Emitting arcs from the last frame we're including -- ignore
+          // these.
+          KALDI_ASSERT(frame == num_frames_to_include);
+          continue;
+        }
+        StateId next_state = next_iter->second;
+        BaseFloat this_offset = (l->ilabel != 0 ? cost_offset : 0);
+        LatticeArc arc(l->ilabel, l->olabel,
+                       LatticeWeight(l->graph_cost, l->acoustic_cost - this_offset),
+                       next_state);
+        // Note: the epsilons get redundantly included at the end and beginning
+        // of successive chunks.  These will get removed in the determinization.
+        chunk_lat.AddArc(cur_state, arc);
+      }
     }
-    token2label_map_.swap(next_token2label_map);
-
-    // bool finished_before_beam =
-    determinizer_.AcceptRawLatticeChunk(&chunk_lat);
-    // We are ignoring the return status, which say whether it finished before the beam.
+  }
+  if (num_frames_in_lattice_ == 0) {
+    // This block locates the start token.  NOTE: we use the fact that in the
+    // linked list of tokens, things are added at the head, so the start state
+    // must be at the tail.  If this data structure is changed in future, we
+    // might need to explicitly store the start token as a class member.
+    Token *tok = active_toks_[0].toks;
+    if (tok == NULL) {
+      KALDI_WARN << "No tokens exist on start frame";
+      return;  // the lattice will be empty.
+    }
+    while (tok->next != NULL)
+      tok = tok->next;
+    Token *start_token = tok;
+    auto iter = tok2state_map.find(start_token);
+    KALDI_ASSERT(iter != tok2state_map.end());
+    StateId start_state = iter->second;
+    chunk_lat.SetStart(start_state);
+  }
+  token2label_map_.swap(next_token2label_map);
 
-    num_frames_in_lattice_ = num_frames_to_include;
+  if (in_background) {
+    determinize_thread_ = std::thread(
+        &LatticeIncrementalDecoderTpl<FST, Token>::AcceptChunkInBackground,
+        this);
+  } else {
+    AcceptChunk();
+  }
+  num_frames_in_lattice_ = num_frames_to_include;
+}
 
-    if (determinizer_.GetLattice().NumStates() == 0)
-      return determinizer_.GetLattice();   // Something went wrong, lattice is empty.
+template <typename FST, typename Token>
+void LatticeIncrementalDecoderTpl<FST, Token>::AcceptChunk() {
+  // bool finished_before_beam =
+  determinizer_.AcceptRawLatticeChunk(&raw_chunk_);
+  // We are ignoring the return status, which say whether it finished before the
+  // beam.
+  if (determinizer_.GetLattice().NumStates() != 0) {
+    // Among other things this makes the start state final if it has
+    // token-labels leaving it, in which case the next chunk will start again
+    // from the beginning (search for `determinizer_.GetLattice().Final(0)`).
+    determinizer_.SetFinalCosts(NULL);
   }
+}
 
-  unordered_map<Token*, BaseFloat> token2final_cost;
-  unordered_map<Label, BaseFloat> token_label2final_cost;
-  if (use_final_probs) {
-    ComputeFinalCosts(&token2final_cost, NULL, NULL);
-    for (const auto &p: token2final_cost) {
-      Token *tok = p.first;
-      BaseFloat cost = p.second;
-      auto iter = token2label_map_.find(tok);
-      if (iter != token2label_map_.end()) {
-        /* Some tokens may not have survived the pruned determinization. */
-        Label token_label = iter->second;
-        bool ret = token_label2final_cost.insert({token_label, cost}).second;
-        KALDI_ASSERT(ret); /* Make sure it was inserted. */
-      }
-    }
+template <typename FST, typename Token>
+void LatticeIncrementalDecoderTpl<FST, Token>::AcceptChunkInBackground() {
+  try {
+    AcceptChunk();
+  } catch (const std::exception &e) {
+    // The exception is re-thrown from WaitForDeterminization(), in the
+    // decoding thread.
+    background_error_ = e.what();
+    if (background_error_.empty())
+      background_error_ = "unknown error";
   }
-  /* Note: these final-probs won't affect the next chunk, only the lattice
-     returned from GetLattice().  They are kind of temporaries. */
-  determinizer_.SetFinalCosts(token_label2final_cost.empty() ? NULL :
-                              &token_label2final_cost);
+}
 
-  return determinizer_.GetLattice();
+template <typename FST, typename Token>
+void LatticeIncrementalDecoderTpl<FST, Token>::WaitForDeterminization() {
+  if (!determinize_thread_.joinable())
+    return;
+  determinize_thread_.join();
+  if (!background_error_.empty()) {
+    std::string error;
+    error.swap(background_error_);
+    KALDI_ERR << "Error in background lattice determinization: " << error;
+  }
 }
 
 
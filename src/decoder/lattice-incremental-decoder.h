@@ -20,12 +20,14 @@
 #ifndef KALDI_DECODER_LATTICE_INCREMENTAL_DECODER_H_
 #define KALDI_DECODER_LATTICE_INCREMENTAL_DECODER_H_
 
+#include <thread>
 #include "util/stl-utils.h"
 #include "util/hash-list.h"
 #include "fst/fstlib.h"
 #include "itf/decodable-itf.h"
 #include "fstext/fstext-lib.h"
 #include "lat/determinize-lattice-pruned.h"
+#include "util/pool-allocator.h"
 #include "lat/kaldi-lattice.h"
 #include "decoder/grammar-fst.h"
 #include "lattice-faster-decoder.h"
@@ -116,6 +118,7 @@ struct LatticeIncrementalDecoderConfig {
   BaseFloat prune_scale; // Note: we don't make this configurable on the command line,
                          // it's not a very important parameter.  It affects the
                          // algorithm that prunes the tokens as we go.
+  bool use_token_pool;
   // Most of the options inside det_opts are not actually queried by the
   // LatticeIncrementalDecoder class itself, but by the code that calls it, for
   // example in the function DecodeUtteranceLatticeIncremental.
@@ -128,6 +131,7 @@ struct LatticeIncrementalDecoderConfig {
   // If you call
   int32 determinize_max_delay;
   int32 determinize_min_chunk_size;
+  bool determinize_in_background;
 
 
   LatticeIncrementalDecoderConfig()
@@ -139,8 +143,10 @@ struct LatticeIncrementalDecoderConfig {
         beam_delta(0.5),
         hash_ratio(2.0),
         prune_scale(0.01),
+        use_token_pool(false),
         determinize_max_delay(60),
-        determinize_min_chunk_size(20) {
+        determinize_min_chunk_size(20),
+        determinize_in_background(false) {
     det_opts.minimize = false;
   }
   void Register(OptionsItf *opts) {
@@ -163,11 +169,19 @@ struct LatticeIncrementalDecoderConfig {
     opts->Register("hash-ratio", &hash_ratio,
                    "Setting used in decoder to "
                    "control hash behavior");
+    opts->Register("use-token-pool", &use_token_pool, "If true, allocate "
+                   "tokens and lattice links from memory pools in the decoder, "
+                   "which are reused across utterances, instead of with "
+                   "new/delete.");
     opts->Register("determinize-max-delay", &determinize_max_delay,
                    "Maximum frames of delay between decoding a frame and "
                    "determinizing it");
     opts->Register("determinize-min-chunk-size", &determinize_min_chunk_size,
                    "Minimum chunk size used in determinization");
+    opts->Register("determinize-in-background", &determinize_in_background,
+                   "If true, determinize the chunks of lattice in a separate "
+                   "thread while decoding continues (uses up to one extra CPU "
+                   "per decoder).");
 
   }
   void Check() const {
@@ -610,7 +624,33 @@ class LatticeIncrementalDecoderTpl {
 
   /** NOTE: for parts the internal implementation that are shared with LatticeFasterDecoer,
       we have removed the comments.*/
-  inline static void DeleteForwardLinks(Token *tok);
+  inline void DeleteForwardLinks(Token *tok);
+  inline Token *NewToken(BaseFloat tot_cost, BaseFloat extra_cost,
+                         ForwardLinkT *links, Token *next, Token *backpointer) {
+    if (use_token_pool_)
+      return token_pool_.New(tot_cost, extra_cost, links, next, backpointer);
+    else
+      return new Token(tot_cost, extra_cost, links, next, backpointer);
+  }
+  inline void DeleteToken(Token *tok) {
+    if (use_token_pool_) token_pool_.Delete(tok);
+    else delete tok;
+  }
+  inline ForwardLinkT *NewForwardLink(Token *next_tok, Label ilabel,
+                                      Label olabel, BaseFloat graph_cost,
+                                      BaseFloat acoustic_cost,
+                                      ForwardLinkT *next) {
+    if (use_token_pool_)
+      return link_pool_.New(next_tok, ilabel, olabel, graph_cost,
+                            acoustic_cost, next);
+    else
+      return new ForwardLinkT(next_tok, ilabel, olabel, graph_cost,
+                              acoustic_cost, next);
+  }
+  inline void DeleteForwardLink(ForwardLinkT *link) {
+    if (use_token_pool_) link_pool_.Delete(link);
+    else delete link;
+  }
   struct TokenList {
     Token *toks;
     bool must_prune_forward_links;
@@ -648,6 +688,9 @@ class LatticeIncrementalDecoderTpl {
   std::vector<BaseFloat> cost_offsets_;
   int32 num_toks_;
   bool warned_;
+  bool use_token_pool_;
+  PoolAllocator<Token> token_pool_;
+  PoolAllocator<ForwardLinkT> link_pool_;
   bool decoding_finalized_;
 
   unordered_map<Token *, BaseFloat> final_costs_;
@@ -667,6 +710,19 @@ class LatticeIncrementalDecoderTpl {
   /* Just a temporary used in a function; stored here to avoid reallocation. */
   unordered_map<Token*, StateId> temp_token_map_;
 
+  /* The raw lattice for the chunk being determinized; it is a class member
+     because it may be determinized in determinize_thread_. */
+  Lattice raw_chunk_;
+
+  /* If config_.determinize_in_background is true, the thread in which the
+     last chunk is being determinized.  While it is running, nothing but that
+     thread may access determinizer_ or raw_chunk_; the decoding thread must
+     call WaitForDeterminization() first. */
+  std::thread determinize_thread_;
+
+  /* Set by determinize_thread_ if it failed; see WaitForDeterminization(). */
+  std::string background_error_;
+
   /** num_frames_in_lattice_ is the highest `num_frames_to_include_` argument
       for any prior call to GetLattice(). */
   int32 num_frames_in_lattice_;
@@ -716,6 +772,27 @@ class LatticeIncrementalDecoderTpl {
   */
   void UpdateLatticeDeterminization();
 
+  /**
+     Creates the raw lattice for the frames from num_frames_in_lattice_ to
+     `num_frames_to_include`, and determinizes it and appends it to the
+     lattice in determinizer_, either in this thread or (if `in_background`
+     is true) in determinize_thread_.  Sets num_frames_in_lattice_ to
+     `num_frames_to_include`.  Called from GetLattice() and
+     UpdateLatticeDeterminization().
+   */
+  void DeterminizeChunk(int32 num_frames_to_include, bool in_background);
+
+  /** Determinizes raw_chunk_ and appends it to the lattice in determinizer_.
+      Called from DeterminizeChunk(), possibly via AcceptChunkInBackground(). */
+  void AcceptChunk();
+
+  /** The function run in determinize_thread_. */
+  void AcceptChunkInBackground();
+
+  /** Waits for determinize_thread_ to finish, if it is running, and throws if
+      it failed.  Must be called before accessing determinizer_. */
+  void WaitForDeterminization();
+
 
   KALDI_DISALLOW_COPY_AND_ASSIGN(LatticeIncrementalDecoderTpl);
 };
@@ -0,0 +1,156 @@
+// decoder/token-hash-speed-test.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "base/kaldi-common.h"
+#include "base/timer.h"
+#include "matrix/kaldi-matrix.h"
+#include "util/hash-list.h"
+
+namespace kaldi {
+
+// This compares HashList and OpenHashList as the structure that maps states to
+// tokens in the decoders ('toks_' in FasterDecoder and LatticeFasterDecoder).
+// It runs the token-passing loop of FasterDecoder::ProcessEmitting() (without
+// the tokens' tracebacks) on a random graph with random acoustic costs, so the
+// number of active tokens, and the number of times tokens are recombined,
+// depend on the beam as in a real decoder.
+
+struct SpeedTestGraph {
+  // The arcs of state s are [arc_offsets[s], arc_offsets[s+1]).
+  std::vector<int32> arc_offsets;
+  std::vector<int32> arc_pdfs;
+  std::vector<int32> arc_nextstates;
+  std::vector<BaseFloat> arc_weights;
+};
+
+static void MakeSpeedTestGraph(int32 num_states, int32 num_pdfs,
+                               SpeedTestGraph *graph) {
+  graph->arc_offsets.push_back(0);
+  for (int32 s = 0; s < num_states; s++) {
+    int32 num_arcs = 2 + RandInt(0, 4);
+    for (int32 i = 0; i < num_arcs; i++) {
+      // Like in real graphs, most arcs are self-loops or go to nearby
+      // states.
+      int32 nextstate = (i == 0 ? s : (RandInt(0, 3) == 0 ?
+                                       RandInt(0, num_states - 1) :
+                                       (s + RandInt(1, 50)) % num_states));
+      graph->arc_pdfs.push_back(RandInt(0, num_pdfs - 1));
+      graph->arc_nextstates.push_back(nextstate);
+      graph->arc_weights.push_back(4.0 * RandUniform());
+    }
+    graph->arc_offsets.push_back(graph->arc_pdfs.size());
+  }
+}
+
+// Decodes the frames of 'ac_costs' with beam 'beam', using a hash of type
+// HashType, and returns the best cost at the end.  Sets *num_toks to the
+// total number of tokens that were active.
+template<class HashType>
+static BaseFloat DecodeWithHash(const SpeedTestGraph &graph,
+                                const Matrix<BaseFloat> &ac_costs,
+                                BaseFloat beam, int64 *num_toks) {
+  typedef typename HashType::Elem Elem;
+  HashType toks;
+  toks.SetSize(1000);
+  toks.Insert(0, 0.0);
+  *num_toks = 0;
+  for (int32 t = 0; t < ac_costs.NumRows(); t++) {
+    Elem *last_toks = toks.Clear();
+    size_t tok_count = 0;
+    BaseFloat best_cost = std::numeric_limits<BaseFloat>::infinity();
+    for (Elem *e = last_toks; e != NULL; e = e->tail, tok_count++)
+      best_cost = std::min(best_cost, e->val);
+    // As in the decoders' PossiblyResizeHash(), with hash-ratio = 2.
+    if (tok_count * 2 > toks.Size())
+      toks.SetSize(tok_count * 2);
+    BaseFloat cutoff = best_cost + beam,
+        next_cutoff = std::numeric_limits<BaseFloat>::infinity();
+    // Only the tokens within the beam are counted, because which of the
+    // others were created depends on the order of the list.
+    for (Elem *e = last_toks; e != NULL; e = e->tail)
+      if (e->val < cutoff) (*num_toks)++;
+    const BaseFloat *frame_costs = ac_costs.RowData(t);
+    for (Elem *e = last_toks, *e_tail; e != NULL; e = e_tail) {
+      int32 state = e->key;
+      BaseFloat cost = e->val;
+      if (cost < cutoff) {
+        for (int32 a = graph.arc_offsets[state];
+             a < graph.arc_offsets[state + 1]; a++) {
+          BaseFloat tot_cost = cost + graph.arc_weights[a] +
+              frame_costs[graph.arc_pdfs[a]];
+          if (tot_cost < next_cutoff) {
+            if (tot_cost + beam < next_cutoff)
+              next_cutoff = tot_cost + beam;
+            Elem *e_found = toks.Insert(graph.arc_nextstates[a], tot_cost);
+            if (tot_cost < e_found->val)  // Recombination.
+              e_found->val = tot_cost;
+          }
+        }
+      }
+      e_tail = e->tail;
+      toks.Delete(e);
+    }
+  }
+  BaseFloat best_cost = std::numeric_limits<BaseFloat>::infinity();
+  Elem *e = toks.Clear(), *e_tail;
+  for (; e != NULL; e = e_tail) {
+    best_cost = std::min(best_cost, e->val);
+    e_tail = e->tail;
+    toks.Delete(e);
+  }
+  return best_cost;
+}
+
+static void TestTokenHashSpeed() {
+  int32 num_states = 100000, num_pdfs = 2000, num_frames = 500;
+  SpeedTestGraph graph;
+  MakeSpeedTestGraph(num_states, num_pdfs, &graph);
+  Matrix<BaseFloat> ac_costs(num_frames, num_pdfs);
+  ac_costs.SetRandn();
+  ac_costs.Scale(2.0);
+  ac_costs.Add(10.0);
+
+  for (BaseFloat beam = 10.0; beam <= 16.0; beam += 2.0) {
+    int64 num_toks, num_toks_open;
+    Timer timer;
+    BaseFloat cost = DecodeWithHash<HashList<int32, BaseFloat> >(
+        graph, ac_costs, beam, &num_toks);
+    double time = timer.Elapsed();
+    timer.Reset();
+    BaseFloat cost_open = DecodeWithHash<OpenHashList<int32, BaseFloat> >(
+        graph, ac_costs, beam, &num_toks_open);
+    double time_open = timer.Elapsed();
+    // The set of tokens that survive the beam does not depend on the order
+    // in which they are processed, so both must give the same answer.
+    KALDI_ASSERT(num_toks == num_toks_open &&
+                 ApproxEqual(cost, cost_open));
+    KALDI_LOG << "For beam " << beam << ", " << (num_toks / num_frames)
+              << " active tokens per frame: HashList took " << time
+              << " seconds, OpenHashList took " << time_open
+              << " seconds; speedup is " << (time / time_open);
+  }
+}
+
+}  // namespace kaldi
+
+int main() {
+  kaldi::TestTokenHashSpeed();
+  std::cout << "Test OK.\n";
+  return 0;
+}
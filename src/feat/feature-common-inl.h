@@ -25,6 +25,38 @@
 
 namespace kaldi {
 
+namespace internal {
+
+// Calls computer->ComputeBatch() if the feature computer provides it ...
+template <class F>
+auto ComputeFeatureBatch(F *computer,
+                         const VectorBase<BaseFloat> &signal_raw_log_energies,
+                         BaseFloat vtln_warp,
+                         MatrixBase<BaseFloat> *signal_frames,
+                         MatrixBase<BaseFloat> *features, int)
+    -> decltype(computer->ComputeBatch(signal_raw_log_energies, vtln_warp,
+                                       signal_frames, features), void()) {
+  computer->ComputeBatch(signal_raw_log_energies, vtln_warp,
+                         signal_frames, features);
+}
+
+// ... and otherwise calls computer->Compute() on each frame.
+template <class F>
+void ComputeFeatureBatch(F *computer,
+                         const VectorBase<BaseFloat> &signal_raw_log_energies,
+                         BaseFloat vtln_warp,
+                         MatrixBase<BaseFloat> *signal_frames,
+                         MatrixBase<BaseFloat> *features, long) {
+  for (MatrixIndexT i = 0; i < signal_frames->NumRows(); i++) {
+    SubVector<BaseFloat> signal_frame(*signal_frames, i),
+        feature(*features, i);
+    computer->Compute(signal_raw_log_energies(i), vtln_warp,
+                      &signal_frame, &feature);
+  }
+}
+
+}  // namespace internal
+
 template <class F>
 void OfflineFeatureTpl<F>::ComputeFeatures(
     const VectorBase<BaseFloat> &wave,
@@ -69,16 +101,31 @@ void OfflineFeatureTpl<F>::Compute(
     return;
   }
   output->Resize(rows_out, cols_out);
-  Vector<BaseFloat> window;  // windowed waveform.
+  const FrameExtractionOptions &frame_opts = computer_.GetFrameOptions();
+  // The frames are extracted into the rows of 'windows' and given to the
+  // computer kBlockSize at a time, so it can do part of the work for all of
+  // them at once (e.g. the DCT of MFCCs as one matrix multiplication).
+  const int32 kBlockSize = 64;
+  int32 block_size = std::min(kBlockSize, rows_out);
+  Matrix<BaseFloat> windows(block_size, frame_opts.PaddedWindowSize(),
+                            kUndefined);
+  Vector<BaseFloat> raw_log_energies(block_size);
   bool use_raw_log_energy = computer_.NeedRawLogEnergy();
-  for (int32 r = 0; r < rows_out; r++) {  // r is frame index.
-    BaseFloat raw_log_energy = 0.0;
-    ExtractWindow(0, wave, r, computer_.GetFrameOptions(),
-                  feature_window_function_, &window,
-                  (use_raw_log_energy ? &raw_log_energy : NULL));
-
-    SubVector<BaseFloat> output_row(*output, r);
-    computer_.Compute(raw_log_energy, vtln_warp, &window, &output_row);
+  for (int32 r = 0; r < rows_out; r += block_size) {  // r is frame index.
+    int32 this_block_size = std::min(block_size, rows_out - r);
+    SubMatrix<BaseFloat> block_windows(windows, 0, this_block_size,
+                                       0, windows.NumCols()),
+        block_output(*output, r, this_block_size, 0, cols_out);
+    for (int32 i = 0; i < this_block_size; i++) {
+      SubVector<BaseFloat> window(block_windows, i);
+      ExtractWindow(0, wave, r + i, frame_opts, feature_window_function_,
+                    &window,
+                    (use_raw_log_energy ? &(raw_log_energies(i)) : NULL));
+    }
+    internal::ComputeFeatureBatch(&computer_,
+                                  raw_log_energies.Range(0, this_block_size),
+                                  vtln_warp, &block_windows, &block_output,
+                                  0);
   }
 }
 
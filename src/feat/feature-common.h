@@ -94,6 +94,26 @@ class ExampleFeatureComputer {
                VectorBase<BaseFloat> *signal_frame,
                VectorBase<BaseFloat> *feature);
 
+  /**
+     Computes several frames of features at once; it is called by
+     OfflineFeatureTpl, and must give the same output as calling Compute() on
+     each frame, up to roundoff.  This function is optional: for computers
+     that do not have it, OfflineFeatureTpl calls Compute() on each row.
+
+     @param [in] signal_raw_log_energies  The raw log-energy of each frame, as
+         for Compute(); ignored if this->NeedRawLogEnergy() is false.
+     @param [in] vtln_warp  The VTLN warping factor, as for Compute().
+     @param [in] signal_frames  One frame of the signal in each row, as
+         extracted by ExtractWindow(); used as a workspace.
+     @param [out] features  Matrix with the same number of rows as
+         'signal_frames' and this->Dim() columns, to which the features are
+         written.
+  */
+  void ComputeBatch(const VectorBase<BaseFloat> &signal_raw_log_energies,
+                    BaseFloat vtln_warp,
+                    MatrixBase<BaseFloat> *signal_frames,
+                    MatrixBase<BaseFloat> *features);
+
  private:
   // disallow assignment.
   ExampleFeatureComputer &operator = (const ExampleFeatureComputer &in);
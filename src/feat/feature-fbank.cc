@@ -69,20 +69,15 @@ const MelBanks* FbankComputer::GetMelBanks(BaseFloat vtln_warp) {
   return this_mel_banks;
 }
 
-void FbankComputer::Compute(BaseFloat signal_raw_log_energy,
-                            BaseFloat vtln_warp,
-                            VectorBase<BaseFloat> *signal_frame,
-                            VectorBase<BaseFloat> *feature) {
-
-  const MelBanks &mel_banks = *(GetMelBanks(vtln_warp));
-
-  KALDI_ASSERT(signal_frame->Dim() == opts_.frame_opts.PaddedWindowSize() &&
-               feature->Dim() == this->Dim());
-
+void FbankComputer::ComputeMelEnergies(const MelBanks &mel_banks,
+                                       BaseFloat *signal_raw_log_energy,
+                                       VectorBase<BaseFloat> *signal_frame,
+                                       VectorBase<BaseFloat> *mel_energies) {
+  KALDI_ASSERT(signal_frame->Dim() == opts_.frame_opts.PaddedWindowSize());
 
   // Compute energy after window function (not the raw one).
   if (opts_.use_energy && !opts_.raw_energy)
-    signal_raw_log_energy = Log(std::max<BaseFloat>(VecVec(*signal_frame, *signal_frame),
+    *signal_raw_log_energy = Log(std::max<BaseFloat>(VecVec(*signal_frame, *signal_frame),
                                      std::numeric_limits<float>::epsilon()));
 
   if (srfft_ != NULL)  // Compute FFT using split-radix algorithm.
@@ -99,26 +94,74 @@ void FbankComputer::Compute(BaseFloat signal_raw_log_energy,
   if (!opts_.use_power)
     power_spectrum.ApplyPow(0.5);
 
+  // Sum with mel fiterbanks over the power spectrum
+  mel_banks.Compute(power_spectrum, mel_energies);
+}
+
+void FbankComputer::SetEnergy(BaseFloat signal_raw_log_energy,
+                              VectorBase<BaseFloat> *feature) const {
+  // Copy energy as first value (or the last, if htk_compat == true).
+  if (opts_.use_energy) {
+    if (opts_.energy_floor > 0.0 && signal_raw_log_energy < log_energy_floor_) {
+      signal_raw_log_energy = log_energy_floor_;
+    }
+    int32 energy_index = opts_.htk_compat ? opts_.mel_opts.num_bins : 0;
+    (*feature)(energy_index) = signal_raw_log_energy;
+  }
+}
+
+void FbankComputer::Compute(BaseFloat signal_raw_log_energy,
+                            BaseFloat vtln_warp,
+                            VectorBase<BaseFloat> *signal_frame,
+                            VectorBase<BaseFloat> *feature) {
+
+  const MelBanks &mel_banks = *(GetMelBanks(vtln_warp));
+
+  KALDI_ASSERT(feature->Dim() == this->Dim());
+
   int32 mel_offset = ((opts_.use_energy && !opts_.htk_compat) ? 1 : 0);
   SubVector<BaseFloat> mel_energies(*feature,
                                     mel_offset,
                                     opts_.mel_opts.num_bins);
-
-  // Sum with mel fiterbanks over the power spectrum
-  mel_banks.Compute(power_spectrum, &mel_energies);
+  ComputeMelEnergies(mel_banks, &signal_raw_log_energy, signal_frame,
+                     &mel_energies);
   if (opts_.use_log_fbank) {
     // Avoid log of zero (which should be prevented anyway by dithering).
     mel_energies.ApplyFloor(std::numeric_limits<float>::epsilon());
     mel_energies.ApplyLog();  // take the log.
   }
 
-  // Copy energy as first value (or the last, if htk_compat == true).
-  if (opts_.use_energy) {
-    if (opts_.energy_floor > 0.0 && signal_raw_log_energy < log_energy_floor_) {
-      signal_raw_log_energy = log_energy_floor_;
-    }
-    int32 energy_index = opts_.htk_compat ? opts_.mel_opts.num_bins : 0;
-    (*feature)(energy_index) = signal_raw_log_energy;
+  SetEnergy(signal_raw_log_energy, feature);
+}
+
+void FbankComputer::ComputeBatch(
+    const VectorBase<BaseFloat> &signal_raw_log_energies,
+    BaseFloat vtln_warp,
+    MatrixBase<BaseFloat> *signal_frames,
+    MatrixBase<BaseFloat> *features) {
+  int32 num_frames = signal_frames->NumRows();
+  KALDI_ASSERT(signal_raw_log_energies.Dim() == num_frames &&
+               features->NumRows() == num_frames &&
+               features->NumCols() == this->Dim());
+
+  const MelBanks &mel_banks = *(GetMelBanks(vtln_warp));
+  Vector<BaseFloat> log_energies(signal_raw_log_energies);
+  int32 mel_offset = ((opts_.use_energy && !opts_.htk_compat) ? 1 : 0);
+  SubMatrix<BaseFloat> mel_energies(*features, 0, num_frames,
+                                    mel_offset, opts_.mel_opts.num_bins);
+  for (int32 r = 0; r < num_frames; r++) {
+    SubVector<BaseFloat> signal_frame(*signal_frames, r),
+        mel_energies_row(mel_energies, r);
+    ComputeMelEnergies(mel_banks, &(log_energies(r)), &signal_frame,
+                       &mel_energies_row);
+  }
+  if (opts_.use_log_fbank) {
+    mel_energies.ApplyFloor(std::numeric_limits<float>::epsilon());
+    mel_energies.ApplyLog();
+  }
+  for (int32 r = 0; r < num_frames; r++) {
+    SubVector<BaseFloat> feature(*features, r);
+    SetEnergy(log_energies(r), &feature);
   }
 }
 
@@ -126,11 +126,29 @@ class FbankComputer {
                VectorBase<BaseFloat> *signal_frame,
                VectorBase<BaseFloat> *feature);
 
+  /// Computes several frames at once; see ExampleFeatureComputer in
+  /// feature-common.h.
+  void ComputeBatch(const VectorBase<BaseFloat> &signal_raw_log_energies,
+                    BaseFloat vtln_warp,
+                    MatrixBase<BaseFloat> *signal_frames,
+                    MatrixBase<BaseFloat> *features);
+
   ~FbankComputer();
 
  private:
   const MelBanks *GetMelBanks(BaseFloat vtln_warp);
 
+  // The part of Compute() up to the mel filterbank energies (before the log).
+  // Updates *signal_raw_log_energy if the energy is not the raw one.
+  void ComputeMelEnergies(const MelBanks &mel_banks,
+                          BaseFloat *signal_raw_log_energy,
+                          VectorBase<BaseFloat> *signal_frame,
+                          VectorBase<BaseFloat> *mel_energies);
+
+  // Puts the log-energy into the feature, if requested.
+  void SetEnergy(BaseFloat signal_raw_log_energy,
+                 VectorBase<BaseFloat> *feature) const;
+
 
   FbankOptions opts_;
   BaseFloat log_energy_floor_;
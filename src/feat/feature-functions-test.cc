@@ -22,6 +22,7 @@
 
 #include "feat/feature-mfcc.h"
 #include "base/kaldi-math.h"
+#include "base/timer.h"
 #include "matrix/kaldi-matrix-inl.h"
 #include "feat/wave-reader.h"
 
@@ -93,6 +94,49 @@ void UnitTestOnlineCmvn() {
 }
 
 
+// Checks MelBanks::Compute() against VecVec() on the bins, and compares their
+// speed.
+void UnitTestMelBanks() {
+  FrameExtractionOptions frame_opts;
+  MelBanksOptions mel_opts;
+  frame_opts.samp_freq = (RandInt(0, 1) == 0 ? 8000 : 16000);
+  mel_opts.num_bins = RandInt(10, 40);
+  mel_opts.htk_mode = (RandInt(0, 1) == 0);
+  MelBanks mel_banks(mel_opts, frame_opts, 1.0);
+  const std::vector<std::pair<int32, Vector<BaseFloat> > > &bins =
+      mel_banks.GetBins();
+  int32 num_bins = bins.size(),
+      num_fft_bins = frame_opts.PaddedWindowSize() / 2 + 1,
+      num_frames = 2000;
+  Matrix<BaseFloat> power_spectra(num_frames, num_fft_bins),
+      mel_energies(num_frames, num_bins), ref_mel_energies(num_frames, num_bins);
+  power_spectra.SetRandn();
+  power_spectra.ApplyPow(2.0);
+  power_spectra.Scale(100.0);
+
+  Timer timer;
+  for (int32 t = 0; t < num_frames; t++) {
+    SubVector<BaseFloat> mel_energies_row(mel_energies, t);
+    mel_banks.Compute(power_spectra.Row(t), &mel_energies_row);
+  }
+  double elapsed = timer.Elapsed();
+  timer.Reset();
+  for (int32 t = 0; t < num_frames; t++) {
+    for (int32 i = 0; i < num_bins; i++) {
+      int32 offset = bins[i].first, dim = bins[i].second.Dim();
+      BaseFloat energy = VecVec(bins[i].second,
+                                power_spectra.Row(t).Range(offset, dim));
+      if (mel_opts.htk_mode && energy < 1.0) energy = 1.0;
+      ref_mel_energies(t, i) = energy;
+    }
+  }
+  double ref_elapsed = timer.Elapsed();
+  KALDI_LOG << "For " << num_bins << " mel bins, MelBanks::Compute() took "
+            << elapsed << " seconds for " << num_frames << " frames, "
+            << "versus " << ref_elapsed << " seconds with VecVec().";
+  AssertEqual(mel_energies, ref_mel_energies);
+}
+
 }
 
 
@@ -101,6 +145,8 @@ int main() {
   using namespace kaldi;
   try {
     UnitTestOnlineCmvn();
+    for (int32 i = 0; i < 5; i++)
+      UnitTestMelBanks();
     std::cout << "Tests succeeded.\n";
     return 0;
   } catch (const std::exception &e) {
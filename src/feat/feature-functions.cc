@@ -21,6 +21,7 @@
 
 
 #include "feat/feature-functions.h"
+#include "feat/feature-simd.h"
 #include "matrix/matrix-functions.h"
 
 
@@ -41,10 +42,7 @@ void ComputePowerSpectrum(VectorBase<BaseFloat> *waveform) {
   int32 half_dim = dim/2;
   BaseFloat first_energy = (*waveform)(0) * (*waveform)(0),
       last_energy = (*waveform)(1) * (*waveform)(1);  // handle this special case
-  for (int32 i = 1; i < half_dim; i++) {
-    BaseFloat real = (*waveform)(i*2), im = (*waveform)(i*2 + 1);
-    (*waveform)(i) = real*real + im*im;
-  }
+  SimdPowerSpectrum(waveform->Data(), dim);  // bins 1 ... half_dim - 1.
   (*waveform)(0) = first_energy;
   (*waveform)(half_dim) = last_energy;  // Will actually never be used, and anyway
   // if the signal has been bandlimited sensibly this should be zero.
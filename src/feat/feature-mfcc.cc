@@ -25,17 +25,14 @@
 namespace kaldi {
 
 
-void MfccComputer::Compute(BaseFloat signal_raw_log_energy,
-                           BaseFloat vtln_warp,
-                           VectorBase<BaseFloat> *signal_frame,
-                           VectorBase<BaseFloat> *feature) {
-  KALDI_ASSERT(signal_frame->Dim() == opts_.frame_opts.PaddedWindowSize() &&
-               feature->Dim() == this->Dim());
-
-  const MelBanks &mel_banks = *(GetMelBanks(vtln_warp));
+void MfccComputer::ComputeMelEnergies(const MelBanks &mel_banks,
+                                      BaseFloat *signal_raw_log_energy,
+                                      VectorBase<BaseFloat> *signal_frame,
+                                      VectorBase<BaseFloat> *mel_energies) {
+  KALDI_ASSERT(signal_frame->Dim() == opts_.frame_opts.PaddedWindowSize());
 
   if (opts_.use_energy && !opts_.raw_energy)
-    signal_raw_log_energy = Log(std::max<BaseFloat>(VecVec(*signal_frame, *signal_frame),
+    *signal_raw_log_energy = Log(std::max<BaseFloat>(VecVec(*signal_frame, *signal_frame),
                                      std::numeric_limits<float>::epsilon()));
 
   if (srfft_ != NULL)  // Compute FFT using the split-radix algorithm.
@@ -48,19 +45,11 @@ void MfccComputer::Compute(BaseFloat signal_raw_log_energy,
   SubVector<BaseFloat> power_spectrum(*signal_frame, 0,
                                       signal_frame->Dim() / 2 + 1);
 
-  mel_banks.Compute(power_spectrum, &mel_energies_);
-
-  // avoid log of zero (which should be prevented anyway by dithering).
-  mel_energies_.ApplyFloor(std::numeric_limits<float>::epsilon());
-  mel_energies_.ApplyLog();  // take the log.
-
-  feature->SetZero();  // in case there were NaNs.
-  // feature = dct_matrix_ * mel_energies [which now have log]
-  feature->AddMatVec(1.0, dct_matrix_, kNoTrans, mel_energies_, 0.0);
-
-  if (opts_.cepstral_lifter != 0.0)
-    feature->MulElements(lifter_coeffs_);
+  mel_banks.Compute(power_spectrum, mel_energies);
+}
 
+void MfccComputer::SetEnergy(BaseFloat signal_raw_log_energy,
+                             VectorBase<BaseFloat> *feature) const {
   if (opts_.use_energy) {
     if (opts_.energy_floor > 0.0 && signal_raw_log_energy < log_energy_floor_)
       signal_raw_log_energy = log_energy_floor_;
@@ -79,6 +68,67 @@ void MfccComputer::Compute(BaseFloat signal_raw_log_energy,
   }
 }
 
+void MfccComputer::Compute(BaseFloat signal_raw_log_energy,
+                           BaseFloat vtln_warp,
+                           VectorBase<BaseFloat> *signal_frame,
+                           VectorBase<BaseFloat> *feature) {
+  KALDI_ASSERT(feature->Dim() == this->Dim());
+
+  const MelBanks &mel_banks = *(GetMelBanks(vtln_warp));
+  ComputeMelEnergies(mel_banks, &signal_raw_log_energy, signal_frame,
+                     &mel_energies_);
+
+  // avoid log of zero (which should be prevented anyway by dithering).
+  mel_energies_.ApplyFloor(std::numeric_limits<float>::epsilon());
+  mel_energies_.ApplyLog();  // take the log.
+
+  feature->SetZero();  // in case there were NaNs.
+  // feature = dct_matrix_ * mel_energies [which now have log]
+  feature->AddMatVec(1.0, dct_matrix_, kNoTrans, mel_energies_, 0.0);
+
+  if (opts_.cepstral_lifter != 0.0)
+    feature->MulElements(lifter_coeffs_);
+
+  SetEnergy(signal_raw_log_energy, feature);
+}
+
+void MfccComputer::ComputeBatch(
+    const VectorBase<BaseFloat> &signal_raw_log_energies,
+    BaseFloat vtln_warp,
+    MatrixBase<BaseFloat> *signal_frames,
+    MatrixBase<BaseFloat> *features) {
+  int32 num_frames = signal_frames->NumRows();
+  KALDI_ASSERT(signal_raw_log_energies.Dim() == num_frames &&
+               features->NumRows() == num_frames &&
+               features->NumCols() == this->Dim());
+
+  const MelBanks &mel_banks = *(GetMelBanks(vtln_warp));
+  Vector<BaseFloat> log_energies(signal_raw_log_energies);
+  Matrix<BaseFloat> mel_energies(num_frames, opts_.mel_opts.num_bins,
+                                 kUndefined);
+  for (int32 r = 0; r < num_frames; r++) {
+    SubVector<BaseFloat> signal_frame(*signal_frames, r),
+        mel_energies_row(mel_energies, r);
+    ComputeMelEnergies(mel_banks, &(log_energies(r)), &signal_frame,
+                       &mel_energies_row);
+  }
+
+  mel_energies.ApplyFloor(std::numeric_limits<float>::epsilon());
+  mel_energies.ApplyLog();
+
+  features->SetZero();  // in case there were NaNs.
+  // The DCT of all the frames as one matrix multiplication.
+  features->AddMatMat(1.0, mel_energies, kNoTrans, dct_matrix_, kTrans, 0.0);
+
+  if (opts_.cepstral_lifter != 0.0)
+    features->MulColsVec(lifter_coeffs_);
+
+  for (int32 r = 0; r < num_frames; r++) {
+    SubVector<BaseFloat> feature(*features, r);
+    SetEnergy(log_energies(r), &feature);
+  }
+}
+
 MfccComputer::MfccComputer(const MfccOptions &opts):
     opts_(opts), srfft_(NULL),
     mel_energies_(opts.mel_opts.num_bins) {
@@ -124,6 +124,14 @@ class MfccComputer {
                VectorBase<BaseFloat> *signal_frame,
                VectorBase<BaseFloat> *feature);
 
+  /// Computes several frames at once; see ExampleFeatureComputer in
+  /// feature-common.h.  The DCT is done for all of them with one matrix
+  /// multiplication.
+  void ComputeBatch(const VectorBase<BaseFloat> &signal_raw_log_energies,
+                    BaseFloat vtln_warp,
+                    MatrixBase<BaseFloat> *signal_frames,
+                    MatrixBase<BaseFloat> *features);
+
   ~MfccComputer();
  private:
   // disallow assignment.
@@ -132,6 +140,18 @@ class MfccComputer {
  protected:
   const MelBanks *GetMelBanks(BaseFloat vtln_warp);
 
+  // The part of Compute() up to the mel filterbank energies (before the log).
+  // Updates *signal_raw_log_energy if the energy is not the raw one.
+  void ComputeMelEnergies(const MelBanks &mel_banks,
+                          BaseFloat *signal_raw_log_energy,
+                          VectorBase<BaseFloat> *signal_frame,
+                          VectorBase<BaseFloat> *mel_energies);
+
+  // The last part of Compute(): puts the log-energy into the feature if
+  // requested, and reorders it for --htk-compat.
+  void SetEnergy(BaseFloat signal_raw_log_energy,
+                 VectorBase<BaseFloat> *feature) const;
+
   MfccOptions opts_;
   Vector<BaseFloat> lifter_coeffs_;
   Matrix<BaseFloat> dct_matrix_;  // matrix we left-multiply by to perform DCT.
@@ -0,0 +1,173 @@
+// feat/feature-simd-test.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "base/kaldi-math.h"
+#include "base/kaldi-simd.h"
+#include "base/timer.h"
+#include "feat/feature-fbank.h"
+#include "feat/feature-mfcc.h"
+#include "feat/feature-simd.h"
+
+namespace kaldi {
+
+// The SimdLevels to test: the plain C++ code, and whichever vectorized
+// versions this machine supports.
+static std::vector<SimdLevel> LevelsToTest() {
+  SetMaxSimdLevel(kSimdAvx512Vnni);
+  SimdLevel max_level = GetSimdLevel();
+  std::vector<SimdLevel> levels;
+  levels.push_back(kSimdNone);
+  if (max_level >= kSimdAvx2) levels.push_back(kSimdAvx2);
+  if (max_level >= kSimdAvx512) levels.push_back(kSimdAvx512);
+  return levels;
+}
+
+// Checks each kernel against a plain double-precision computation, for
+// lengths around the vector sizes and some longer ones.
+void UnitTestSimdKernels(SimdLevel level) {
+  SetMaxSimdLevel(level);
+  for (int32 n = 0; n < 100; n++) {
+    int32 dim = (n < 70 ? n : RandInt(70, 1100));
+    Vector<BaseFloat> x(dim), y(dim);
+    x.SetRandn();
+    y.SetRandn();
+    double sum = 0.0, abs_sum = 0.0;
+    for (int32 i = 0; i < dim; i++) {
+      sum += x(i);
+      abs_sum += std::abs(x(i));
+    }
+    KALDI_ASSERT(std::abs(SimdSum(x.Data(), dim) - sum) <=
+                 1.0e-05 * (1.0 + abs_sum));
+
+    double dot = 0.0, abs_dot = 0.0;
+    for (int32 i = 0; i < dim; i++) {
+      dot += x(i) * y(i);
+      abs_dot += std::abs(x(i) * y(i));
+    }
+    KALDI_ASSERT(std::abs(SimdDotProduct(x.Data(), y.Data(), dim) - dot) <=
+                 1.0e-05 * (1.0 + abs_dot));
+
+    BaseFloat offset = RandGauss();
+    Vector<BaseFloat> x_offset(x);
+    x_offset.Add(offset);
+    double sumsq = VecVec(Vector<double>(x_offset), Vector<double>(x_offset));
+    Vector<BaseFloat> z(x);
+    BaseFloat simd_sumsq = SimdAddAndSumSquares(offset, z.Data(), dim);
+    KALDI_ASSERT(z.ApproxEqual(x_offset, 1.0e-06));
+    KALDI_ASSERT(std::abs(simd_sumsq - sumsq) <= 1.0e-05 * (1.0 + sumsq));
+
+    BaseFloat preemph_coeff = RandUniform();
+    Vector<BaseFloat> window(dim), ref_preemph(x);
+    window.SetRandn();
+    for (int32 i = dim - 1; i > 0; i--)
+      ref_preemph(i) -= preemph_coeff * ref_preemph(i - 1);
+    if (dim > 0)
+      ref_preemph(0) -= preemph_coeff * ref_preemph(0);
+    ref_preemph.MulElements(window);
+    z.CopyFromVec(x);
+    SimdPreemphasizeAndWindow(preemph_coeff, window.Data(), z.Data(), dim);
+    KALDI_ASSERT(z.ApproxEqual(ref_preemph, 1.0e-06));
+
+    Vector<BaseFloat> ref_power(x);
+    for (int32 i = 1; i < dim / 2; i++)
+      ref_power(i) = x(2 * i) * x(2 * i) + x(2 * i + 1) * x(2 * i + 1);
+    z.CopyFromVec(x);
+    SimdPowerSpectrum(z.Data(), dim);
+    KALDI_ASSERT(z.ApproxEqual(ref_power, 1.0e-06));
+  }
+  SetMaxSimdLevel(kSimdAvx512Vnni);
+}
+
+// Computes MFCCs or filterbanks with the batched path in OfflineFeatureTpl,
+// and checks them against calling the computer frame by frame, and against
+// the same computation with the plain C++ kernels.  Also compares the speed of
+// each SimdLevel.
+template <class C>
+void UnitTestSimdFeatures(const typename C::Options &opts,
+                          const std::string &name) {
+  int32 num_samples = 16000 * 20;
+  Vector<BaseFloat> wave(num_samples);
+  wave.SetRandn();
+  wave.Scale(1000.0);
+
+  std::vector<SimdLevel> levels = LevelsToTest();
+  std::vector<Matrix<BaseFloat> > feats(levels.size());
+  for (size_t l = 0; l < levels.size(); l++) {
+    SetMaxSimdLevel(levels[l]);
+    OfflineFeatureTpl<C> computer(opts);
+    Timer timer;
+    computer.Compute(wave, 1.0, &(feats[l]));
+    KALDI_LOG << "Computing " << feats[l].NumRows() << " frames of " << name
+              << " features took " << timer.Elapsed() << " seconds with SIMD "
+              << "level " << levels[l];
+    AssertEqual(feats[l], feats[0], 1.0e-04);
+  }
+  SetMaxSimdLevel(kSimdAvx512Vnni);
+
+  C computer(opts);
+  FeatureWindowFunction window_function(opts.frame_opts);
+  Matrix<BaseFloat> frame_by_frame_feats(feats[0].NumRows(),
+                                         feats[0].NumCols());
+  Vector<BaseFloat> window;
+  for (int32 r = 0; r < frame_by_frame_feats.NumRows(); r++) {
+    BaseFloat raw_log_energy = 0.0;
+    ExtractWindow(0, wave, r, opts.frame_opts, window_function, &window,
+                  &raw_log_energy);
+    SubVector<BaseFloat> feat(frame_by_frame_feats, r);
+    computer.Compute(raw_log_energy, 1.0, &window, &feat);
+  }
+  AssertEqual(feats.back(), frame_by_frame_feats, 1.0e-04);
+}
+
+void UnitTestSimdFeatures() {
+  for (int32 i = 0; i < 4; i++) {
+    MfccOptions mfcc_opts;
+    mfcc_opts.frame_opts.dither = 0.0;
+    mfcc_opts.use_energy = (i % 2 == 0);
+    mfcc_opts.htk_compat = (i >= 2);
+    mfcc_opts.frame_opts.remove_dc_offset = (i != 1);
+    mfcc_opts.frame_opts.preemph_coeff = (i == 3 ? 0.0 : 0.97);
+    UnitTestSimdFeatures<MfccComputer>(mfcc_opts, "MFCC");
+
+    FbankOptions fbank_opts;
+    fbank_opts.frame_opts.dither = 0.0;
+    fbank_opts.use_energy = (i % 2 == 0);
+    fbank_opts.raw_energy = (i != 2);
+    fbank_opts.htk_compat = (i >= 2);
+    fbank_opts.use_log_fbank = (i != 3);
+    UnitTestSimdFeatures<FbankComputer>(fbank_opts, "filterbank");
+  }
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  try {
+    std::vector<SimdLevel> levels = LevelsToTest();
+    for (size_t l = 0; l < levels.size(); l++)
+      UnitTestSimdKernels(levels[l]);
+    UnitTestSimdFeatures();
+    std::cout << "Tests succeeded.\n";
+    return 0;
+  } catch (const std::exception &e) {
+    std::cerr << e.what();
+    return 1;
+  }
+}
@@ -0,0 +1,340 @@
+// feat/feature-simd.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "base/kaldi-simd.h"
+#include "feat/feature-simd.h"
+
+#if defined(KALDI_HAVE_X86_SIMD) && (KALDI_DOUBLEPRECISION == 0)
+#define KALDI_FEAT_SIMD 1
+#include <immintrin.h>
+#define KALDI_AVX2 __attribute__((target("avx2,fma")))
+#define KALDI_AVX512 \
+  __attribute__((target("avx512f,avx512bw,avx512vl,avx2,fma")))
+#endif
+
+namespace kaldi {
+
+#ifdef KALDI_FEAT_SIMD
+
+// The AVX2 versions.  The loops stop at the last full vector of 8 floats and
+// leave the rest to scalar code.
+//
+// Each kernel calls _mm256_zeroupper() when it is done with the vector
+// registers.  GCC only inserts that itself at -O2 and above, and without it
+// the (non-VEX) SSE code that runs afterwards is slowed down a lot.
+
+static inline KALDI_AVX2 float HorizontalSumAvx2(__m256 v) {
+  __m128 sum = _mm_add_ps(_mm256_castps256_ps128(v),
+                          _mm256_extractf128_ps(v, 1));
+  sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+  sum = _mm_add_ss(sum, _mm_movehdup_ps(sum));
+  return _mm_cvtss_f32(sum);
+}
+
+static KALDI_AVX2 float SumAvx2(const float *x, int32 n) {
+  __m256 sum0 = _mm256_setzero_ps(), sum1 = _mm256_setzero_ps();
+  int32 i = 0;
+  for (; i + 16 <= n; i += 16) {
+    sum0 = _mm256_add_ps(sum0, _mm256_loadu_ps(x + i));
+    sum1 = _mm256_add_ps(sum1, _mm256_loadu_ps(x + i + 8));
+  }
+  if (i + 8 <= n) {
+    sum0 = _mm256_add_ps(sum0, _mm256_loadu_ps(x + i));
+    i += 8;
+  }
+  float sum = HorizontalSumAvx2(_mm256_add_ps(sum0, sum1));
+  _mm256_zeroupper();
+  for (; i < n; i++)
+    sum += x[i];
+  return sum;
+}
+
+static KALDI_AVX2 float AddAndSumSquaresAvx2(float offset, float *x, int32 n) {
+  __m256 off = _mm256_set1_ps(offset), sum = _mm256_setzero_ps();
+  int32 i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256 v = _mm256_add_ps(_mm256_loadu_ps(x + i), off);
+    _mm256_storeu_ps(x + i, v);
+    sum = _mm256_fmadd_ps(v, v, sum);
+  }
+  float ans = HorizontalSumAvx2(sum);
+  _mm256_zeroupper();
+  for (; i < n; i++) {
+    x[i] += offset;
+    ans += x[i] * x[i];
+  }
+  return ans;
+}
+
+static KALDI_AVX2 float DotProductAvx2(const float *a, const float *b,
+                                       int32 n) {
+  __m256 sum0 = _mm256_setzero_ps(), sum1 = _mm256_setzero_ps();
+  int32 i = 0;
+  for (; i + 16 <= n; i += 16) {
+    sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i),
+                           sum0);
+    sum1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8),
+                           _mm256_loadu_ps(b + i + 8), sum1);
+  }
+  if (i + 8 <= n) {
+    sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i),
+                           sum0);
+    i += 8;
+  }
+  float sum = HorizontalSumAvx2(_mm256_add_ps(sum0, sum1));
+  _mm256_zeroupper();
+  for (; i < n; i++)
+    sum += a[i] * b[i];
+  return sum;
+}
+
+static KALDI_AVX2 void PreemphasizeAndWindowAvx2(float preemph_coeff,
+                                                 const float *window,
+                                                 float *x, int32 n) {
+  // We go backwards so that x[i-1] still has its old value when we get to
+  // x[i]; the vector at i reads x[i-1 .. i+7] before it writes x[i .. i+7].
+  __m256 coeff = _mm256_set1_ps(preemph_coeff);
+  int32 i = n - 8;
+  for (; i >= 1; i -= 8) {
+    __m256 cur = _mm256_loadu_ps(x + i), prev = _mm256_loadu_ps(x + i - 1);
+    __m256 diff = _mm256_sub_ps(cur, _mm256_mul_ps(coeff, prev));
+    _mm256_storeu_ps(x + i, _mm256_mul_ps(diff, _mm256_loadu_ps(window + i)));
+  }
+  _mm256_zeroupper();
+  for (int32 j = i + 7; j >= 1; j--)
+    x[j] = (x[j] - preemph_coeff * x[j - 1]) * window[j];
+  if (n > 0)
+    x[0] = (x[0] - preemph_coeff * x[0]) * window[0];
+}
+
+static KALDI_AVX2 void PowerSpectrumAvx2(float *x, int32 n) {
+  // The vector at i reads x[2i .. 2i+15] before it writes x[i .. i+7], and
+  // later vectors only read beyond 2i+15, so this can be done in place.
+  int32 half_dim = n / 2, i = 1;
+  for (; i + 8 <= half_dim; i += 8) {
+    __m256 a = _mm256_loadu_ps(x + 2 * i), b = _mm256_loadu_ps(x + 2 * i + 8);
+    // hadd gives the energies of bins [ i, i+1, i+4, i+5, i+2, i+3, i+6, i+7 ];
+    // the permutation puts them in order.
+    __m256 e = _mm256_hadd_ps(_mm256_mul_ps(a, a), _mm256_mul_ps(b, b));
+    e = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(e),
+                                               _MM_SHUFFLE(3, 1, 2, 0)));
+    _mm256_storeu_ps(x + i, e);
+  }
+  _mm256_zeroupper();
+  for (; i < half_dim; i++) {
+    float real = x[i * 2], im = x[i * 2 + 1];
+    x[i] = real * real + im * im;
+  }
+}
+
+// The AVX-512 versions.  These use masked loads and stores for the last
+// partial vector of 16 floats, where that is simpler than a scalar loop.
+
+static inline KALDI_AVX512 __mmask16 TailMask(int32 n) {
+  return static_cast<__mmask16>((1u << n) - 1);
+}
+
+// This goes through memory because the intrinsics that would split a __m512
+// (and _mm512_reduce_add_ps(), which uses them) give spurious
+// -Wuninitialized warnings with some versions of GCC.
+static inline KALDI_AVX512 float HorizontalSumAvx512(__m512 v) {
+  float buf[16];
+  _mm512_storeu_ps(buf, v);
+  return HorizontalSumAvx2(_mm256_add_ps(_mm256_loadu_ps(buf),
+                                         _mm256_loadu_ps(buf + 8)));
+}
+
+static KALDI_AVX512 float SumAvx512(const float *x, int32 n) {
+  __m512 sum = _mm512_setzero_ps();
+  int32 i = 0;
+  for (; i + 16 <= n; i += 16)
+    sum = _mm512_add_ps(sum, _mm512_loadu_ps(x + i));
+  if (i < n)
+    sum = _mm512_add_ps(sum, _mm512_maskz_loadu_ps(TailMask(n - i), x + i));
+  float ans = HorizontalSumAvx512(sum);
+  _mm256_zeroupper();
+  return ans;
+}
+
+static KALDI_AVX512 float AddAndSumSquaresAvx512(float offset, float *x,
+                                                 int32 n) {
+  __m512 off = _mm512_set1_ps(offset), sum = _mm512_setzero_ps();
+  int32 i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m512 v = _mm512_add_ps(_mm512_loadu_ps(x + i), off);
+    _mm512_storeu_ps(x + i, v);
+    sum = _mm512_fmadd_ps(v, v, sum);
+  }
+  if (i < n) {
+    __mmask16 mask = TailMask(n - i);
+    __m512 v = _mm512_maskz_add_ps(mask, _mm512_maskz_loadu_ps(mask, x + i),
+                                   off);
+    _mm512_mask_storeu_ps(x + i, mask, v);
+    sum = _mm512_fmadd_ps(v, v, sum);
+  }
+  float ans = HorizontalSumAvx512(sum);
+  _mm256_zeroupper();
+  return ans;
+}
+
+static KALDI_AVX512 float DotProductAvx512(const float *a, const float *b,
+                                           int32 n) {
+  __m512 sum = _mm512_setzero_ps();
+  int32 i = 0;
+  for (; i + 16 <= n; i += 16)
+    sum = _mm512_fmadd_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i), sum);
+  if (i < n) {
+    __mmask16 mask = TailMask(n - i);
+    sum = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(mask, a + i),
+                          _mm512_maskz_loadu_ps(mask, b + i), sum);
+  }
+  float ans = HorizontalSumAvx512(sum);
+  _mm256_zeroupper();
+  return ans;
+}
+
+static KALDI_AVX512 void PreemphasizeAndWindowAvx512(float preemph_coeff,
+                                                     const float *window,
+                                                     float *x, int32 n) {
+  // See PreemphasizeAndWindowAvx2() for why we go backwards.
+  __m512 coeff = _mm512_set1_ps(preemph_coeff);
+  int32 i = n - 16;
+  for (; i >= 1; i -= 16) {
+    __m512 cur = _mm512_loadu_ps(x + i), prev = _mm512_loadu_ps(x + i - 1);
+    __m512 diff = _mm512_sub_ps(cur, _mm512_mul_ps(coeff, prev));
+    _mm512_storeu_ps(x + i, _mm512_mul_ps(diff, _mm512_loadu_ps(window + i)));
+  }
+  _mm256_zeroupper();
+  for (int32 j = i + 15; j >= 1; j--)
+    x[j] = (x[j] - preemph_coeff * x[j - 1]) * window[j];
+  if (n > 0)
+    x[0] = (x[0] - preemph_coeff * x[0]) * window[0];
+}
+
+static KALDI_AVX512 void PowerSpectrumAvx512(float *x, int32 n) {
+  // See PowerSpectrumAvx2() for why this can be done in place.
+  const __m512i even = _mm512_set_epi32(30, 28, 26, 24, 22, 20, 18, 16,
+                                        14, 12, 10, 8, 6, 4, 2, 0),
+      odd = _mm512_set_epi32(31, 29, 27, 25, 23, 21, 19, 17,
+                             15, 13, 11, 9, 7, 5, 3, 1);
+  int32 half_dim = n / 2, i = 1;
+  for (; i + 16 <= half_dim; i += 16) {
+    __m512 a = _mm512_loadu_ps(x + 2 * i),
+        b = _mm512_loadu_ps(x + 2 * i + 16);
+    a = _mm512_mul_ps(a, a);
+    b = _mm512_mul_ps(b, b);
+    _mm512_storeu_ps(x + i,
+                     _mm512_add_ps(_mm512_permutex2var_ps(a, even, b),
+                                   _mm512_permutex2var_ps(a, odd, b)));
+  }
+  _mm256_zeroupper();
+  for (; i < half_dim; i++) {
+    float real = x[i * 2], im = x[i * 2 + 1];
+    x[i] = real * real + im * im;
+  }
+}
+
+#endif  // KALDI_FEAT_SIMD
+
+
+BaseFloat SimdSum(const BaseFloat *x, int32 n) {
+#ifdef KALDI_FEAT_SIMD
+  switch (GetSimdLevel()) {
+    case kSimdAvx512Vnni:
+    case kSimdAvx512: return SumAvx512(x, n);
+    case kSimdAvx2: return SumAvx2(x, n);
+    default: break;
+  }
+#endif
+  double sum = 0.0;
+  for (int32 i = 0; i < n; i++)
+    sum += x[i];
+  return sum;
+}
+
+BaseFloat SimdAddAndSumSquares(BaseFloat offset, BaseFloat *x, int32 n) {
+#ifdef KALDI_FEAT_SIMD
+  switch (GetSimdLevel()) {
+    case kSimdAvx512Vnni:
+    case kSimdAvx512: return AddAndSumSquaresAvx512(offset, x, n);
+    case kSimdAvx2: return AddAndSumSquaresAvx2(offset, x, n);
+    default: break;
+  }
+#endif
+  BaseFloat sum = 0.0;
+  for (int32 i = 0; i < n; i++) {
+    x[i] += offset;
+    sum += x[i] * x[i];
+  }
+  return sum;
+}
+
+BaseFloat SimdDotProduct(const BaseFloat *a, const BaseFloat *b, int32 n) {
+#ifdef KALDI_FEAT_SIMD
+  switch (GetSimdLevel()) {
+    case kSimdAvx512Vnni:
+    case kSimdAvx512: return DotProductAvx512(a, b, n);
+    case kSimdAvx2: return DotProductAvx2(a, b, n);
+    default: break;
+  }
+#endif
+  BaseFloat sum = 0.0;
+  for (int32 i = 0; i < n; i++)
+    sum += a[i] * b[i];
+  return sum;
+}
+
+void SimdPreemphasizeAndWindow(BaseFloat preemph_coeff,
+                               const BaseFloat *window,
+                               BaseFloat *x, int32 n) {
+#ifdef KALDI_FEAT_SIMD
+  switch (GetSimdLevel()) {
+    case kSimdAvx512Vnni:
+    case kSimdAvx512:
+      PreemphasizeAndWindowAvx512(preemph_coeff, window, x, n);
+      return;
+    case kSimdAvx2:
+      PreemphasizeAndWindowAvx2(preemph_coeff, window, x, n);
+      return;
+    default: break;
+  }
+#endif
+  for (int32 i = n - 1; i > 0; i--)
+    x[i] = (x[i] - preemph_coeff * x[i - 1]) * window[i];
+  if (n > 0)
+    x[0] = (x[0] - preemph_coeff * x[0]) * window[0];
+}
+
+void SimdPowerSpectrum(BaseFloat *x, int32 n) {
+#ifdef KALDI_FEAT_SIMD
+  switch (GetSimdLevel()) {
+    case kSimdAvx512Vnni:
+    case kSimdAvx512: PowerSpectrumAvx512(x, n); return;
+    case kSimdAvx2: PowerSpectrumAvx2(x, n); return;
+    default: break;
+  }
+#endif
+  int32 half_dim = n / 2;
+  for (int32 i = 1; i < half_dim; i++) {
+    BaseFloat real = x[i * 2], im = x[i * 2 + 1];
+    x[i] = real * real + im * im;
+  }
+}
+
+}  // namespace kaldi
@@ -0,0 +1,60 @@
+// feat/feature-simd.h
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_FEAT_FEATURE_SIMD_H_
+#define KALDI_FEAT_FEATURE_SIMD_H_
+
+#include "base/kaldi-common.h"
+
+namespace kaldi {
+/// @addtogroup  feat FeatureExtraction
+/// @{
+
+// The inner loops of the frame-level feature computation.  Each function has
+// AVX-512, AVX2 and plain C++ versions, and picks one with GetSimdLevel() (see
+// base/kaldi-simd.h).  With --double-precision, only the plain C++ versions
+// are used.  The vectorized versions add up sums in a different order, so
+// their results may differ from the plain ones in the last few bits.
+
+/// Returns x[0] + ... + x[n-1].
+BaseFloat SimdSum(const BaseFloat *x, int32 n);
+
+/// Adds 'offset' to each of x[0] ... x[n-1], and returns the sum of their
+/// squares after the addition.
+BaseFloat SimdAddAndSumSquares(BaseFloat offset, BaseFloat *x, int32 n);
+
+/// Returns the dot product of a[0] ... a[n-1] and b[0] ... b[n-1].
+BaseFloat SimdDotProduct(const BaseFloat *a, const BaseFloat *b, int32 n);
+
+/// Does pre-emphasis and windowing in place, in one pass:
+/// x[i] = (x[i] - preemph_coeff * x[i-1]) * window[i] for i > 0, and
+/// x[0] = (x[0] - preemph_coeff * x[0]) * window[0].
+/// The result is the same as Preemphasize() followed by MulElements().
+void SimdPreemphasizeAndWindow(BaseFloat preemph_coeff,
+                               const BaseFloat *window,
+                               BaseFloat *x, int32 n);
+
+/// Does x[i] = x[2i]^2 + x[2i+1]^2 in place for 1 <= i < n/2; this is the
+/// inner loop of ComputePowerSpectrum(), which deals with x[0] and x[n/2].
+void SimdPowerSpectrum(BaseFloat *x, int32 n);
+
+/// @} End of "addtogroup feat"
+}  // namespace kaldi
+
+#endif  // KALDI_FEAT_FEATURE_SIMD_H_
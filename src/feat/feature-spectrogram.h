@@ -108,6 +108,13 @@ class SpectrogramComputer {
                VectorBase<BaseFloat> *signal_frame,
                VectorBase<BaseFloat> *feature);
 
+  /// Computes several frames at once, by calling Compute() on each of them;
+  /// see ExampleFeatureComputer in feature-common.h.
+  void ComputeBatch(const VectorBase<BaseFloat> &signal_raw_log_energies,
+                    BaseFloat vtln_warp,
+                    MatrixBase<BaseFloat> *signal_frames,
+                    MatrixBase<BaseFloat> *features);
+
   ~SpectrogramComputer();
 
  private:
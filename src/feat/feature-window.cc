@@ -21,6 +21,7 @@
 
 
 #include "feat/feature-window.h"
+#include "feat/feature-simd.h"
 #include "matrix/matrix-functions.h"
 
 
@@ -144,22 +145,44 @@ void ProcessWindow(const FrameExtractionOptions &opts,
   if (opts.dither != 0.0)
     Dither(window, opts.dither);
 
+  // The rest uses the vectorized kernels in feature-simd.h: the DC offset is
+  // removed in the same pass that computes the energy, and pre-emphasis in the
+  // same pass as the window function.
+  BaseFloat *data = window->Data();
+  BaseFloat offset = 0.0;
   if (opts.remove_dc_offset)
-    window->Add(-window->Sum() / frame_length);
+    offset = -SimdSum(data, frame_length) / frame_length;
 
   if (log_energy_pre_window != NULL) {
-    BaseFloat energy = std::max<BaseFloat>(VecVec(*window, *window),
-                                std::numeric_limits<float>::epsilon());
+    BaseFloat energy = std::max<BaseFloat>(
+        SimdAddAndSumSquares(offset, data, frame_length),
+        std::numeric_limits<float>::epsilon());
     *log_energy_pre_window = Log(energy);
+  } else if (offset != 0.0) {
+    window->Add(offset);
   }
 
-  if (opts.preemph_coeff != 0.0)
-    Preemphasize(window, opts.preemph_coeff);
-
-  window->MulElements(window_function.window);
+  KALDI_ASSERT(opts.preemph_coeff >= 0.0 && opts.preemph_coeff <= 1.0);
+  SimdPreemphasizeAndWindow(opts.preemph_coeff, window_function.window.Data(),
+                            data, frame_length);
 }
 
 
+void ExtractWindow(int64 sample_offset,
+                   const VectorBase<BaseFloat> &wave,
+                   int32 f,
+                   const FrameExtractionOptions &opts,
+                   const FeatureWindowFunction &window_function,
+                   Vector<BaseFloat> *window,
+                   BaseFloat *log_energy_pre_window) {
+  int32 frame_length_padded = opts.PaddedWindowSize();
+  if (window->Dim() != frame_length_padded)
+    window->Resize(frame_length_padded, kUndefined);
+  ExtractWindow(sample_offset, wave, f, opts, window_function,
+                static_cast<VectorBase<BaseFloat>*>(window),
+                log_energy_pre_window);
+}
+
 // ExtractWindow extracts a windowed frame of waveform with a power-of-two,
 // padded size.  It does mean subtraction, pre-emphasis and dithering as
 // requested.
@@ -168,7 +191,7 @@ void ExtractWindow(int64 sample_offset,
                    int32 f,  // with 0 <= f < NumFrames(feats, opts)
                    const FrameExtractionOptions &opts,
                    const FeatureWindowFunction &window_function,
-                   Vector<BaseFloat> *window,
+                   VectorBase<BaseFloat> *window,
                    BaseFloat *log_energy_pre_window) {
   KALDI_ASSERT(sample_offset >= 0 && wave.Dim() != 0);
   int32 frame_length = opts.WindowSize(),
@@ -184,8 +207,7 @@ void ExtractWindow(int64 sample_offset,
     KALDI_ASSERT(sample_offset == 0 || start_sample >= sample_offset);
   }
 
-  if (window->Dim() != frame_length_padded)
-    window->Resize(frame_length_padded, kUndefined);
+  KALDI_ASSERT(window->Dim() == frame_length_padded);
 
   // wave_start and wave_end are start and end indexes into 'wave', for the
   // piece of wave that we're trying to extract.
@@ -215,6 +215,17 @@ void ExtractWindow(int64 sample_offset,
                    Vector<BaseFloat> *window,
                    BaseFloat *log_energy_pre_window = NULL);
 
+/// This version of ExtractWindow() is as above, but 'window' is not resized;
+/// it must already have dimension opts.PaddedWindowSize().  It is used to
+/// extract frames into the rows of a matrix.
+void ExtractWindow(int64 sample_offset,
+                   const VectorBase<BaseFloat> &wave,
+                   int32 f,
+                   const FrameExtractionOptions &opts,
+                   const FeatureWindowFunction &window_function,
+                   VectorBase<BaseFloat> *window,
+                   BaseFloat *log_energy_pre_window = NULL);
+
 
 /// @} End of "addtogroup feat"
 }  // namespace kaldi
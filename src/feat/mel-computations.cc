@@ -24,6 +24,7 @@
 #include <iostream>
 
 #include "feat/feature-functions.h"
+#include "feat/feature-simd.h"
 #include "feat/feature-window.h"
 #include "feat/mel-computations.h"
 
@@ -33,13 +34,14 @@ namespace kaldi {
 MelBanks::MelBanks(const MelBanksOptions &opts,
                    const FrameExtractionOptions &frame_opts,
                    BaseFloat vtln_warp_factor):
+    num_fft_bins_(frame_opts.PaddedWindowSize() / 2),
     htk_mode_(opts.htk_mode) {
   int32 num_bins = opts.num_bins;
   if (num_bins < 3) KALDI_ERR << "Must have at least 3 mel bins";
   BaseFloat sample_freq = frame_opts.samp_freq;
   int32 window_length_padded = frame_opts.PaddedWindowSize();
   KALDI_ASSERT(window_length_padded % 2 == 0);
-  int32 num_fft_bins = window_length_padded / 2;
+  int32 num_fft_bins = num_fft_bins_;
   BaseFloat nyquist = 0.5 * sample_freq;
 
   BaseFloat low_freq = opts.low_freq, high_freq;
@@ -144,6 +146,7 @@ MelBanks::MelBanks(const MelBanksOptions &opts,
 MelBanks::MelBanks(const MelBanks &other):
     center_freqs_(other.center_freqs_),
     bins_(other.bins_),
+    num_fft_bins_(other.num_fft_bins_),
     debug_(other.debug_),
     htk_mode_(other.htk_mode_) { }
 
@@ -226,12 +229,16 @@ BaseFloat MelBanks::VtlnWarpMelFreq(BaseFloat vtln_low_cutoff,  // upper+lower f
 void MelBanks::Compute(const VectorBase<BaseFloat> &power_spectrum,
                        VectorBase<BaseFloat> *mel_energies_out) const {
   int32 num_bins = bins_.size();
-  KALDI_ASSERT(mel_energies_out->Dim() == num_bins);
+  KALDI_ASSERT(mel_energies_out->Dim() == num_bins &&
+               power_spectrum.Dim() >= num_fft_bins_);
 
+  const BaseFloat *power_data = power_spectrum.Data();
   for (int32 i = 0; i < num_bins; i++) {
     int32 offset = bins_[i].first;
     const Vector<BaseFloat> &v(bins_[i].second);
-    BaseFloat energy = VecVec(v, power_spectrum.Range(offset, v.Dim()));
+    // The bins are only a few dozen elements long, which is too short for a
+    // BLAS call to pay off.
+    BaseFloat energy = SimdDotProduct(v.Data(), power_data + offset, v.Dim());
     // HTK-like flooring- for testing purposes (we prefer dither)
     if (htk_mode_ && energy < 1.0) energy = 1.0;
     (*mel_energies_out)(i) = energy;
@@ -134,6 +134,10 @@ class MelBanks {
   // (the first nonzero fft-bin), (the vector of weights).
   std::vector<std::pair<int32, Vector<BaseFloat> > > bins_;
 
+  // The number of fft bins the weights in "bins_" may span; Compute() checks
+  // once that the power spectrum has at least that many, instead of per bin.
+  int32 num_fft_bins_;
+
   bool debug_;
   bool htk_mode_;
 };
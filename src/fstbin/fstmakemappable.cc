@@ -0,0 +1,61 @@
+// fstbin/fstmakemappable.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "fst/fstlib.h"
+#include "fstext/kaldi-fst-io.h"
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    using namespace fst;
+
+    const char *usage =
+        "Converts an FST (e.g. HCLG.fst) to a ConstFst whose arrays are aligned\n"
+        "in the file, so that decoders memory-map it instead of reading it:\n"
+        "loading is then near-instant, and processes on the same machine that\n"
+        "decode with the same graph share one copy of it in memory.\n"
+        "The output must be a regular file.  This is equivalent to OpenFst's\n"
+        "'fstconvert --fst_type=const --fst_align'.\n"
+        "\n"
+        "Usage:  fstmakemappable <fst-in> <fst-out>\n"
+        "e.g.: fstmakemappable HCLG.fst HCLG.mappable.fst\n";
+
+    ParseOptions po(usage);
+    po.Read(argc, argv);
+
+    if (po.NumArgs() != 2) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    std::string fst_in_filename = po.GetArg(1),
+        fst_out_filename = po.GetArg(2);
+
+    Fst<StdArc> *fst = ReadFstKaldiGeneric(fst_in_filename);
+    WriteFstKaldiMappable(*fst, fst_out_filename);
+    delete fst;
+    return 0;
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
@@ -230,6 +230,41 @@ CacheDeterministicOnDemandFst<Arc>::CacheDeterministicOnDemandFst(
     cached_arcs_[i].first = kNoStateId; // Invalidate all elements of the cache.
 }
 
+template<class Arc>
+void ComposeDeterministicOnDemandFst<Arc>::PrepareArcs(
+    const std::vector<std::pair<StateId, Label> > &arcs) {
+  std::vector<std::pair<StateId, Label> > arcs1, arcs2;
+  arcs1.reserve(arcs.size());
+  for (size_t i = 0; i < arcs.size(); i++) {
+    KALDI_ASSERT(arcs[i].first < static_cast<StateId>(state_vec_.size()));
+    arcs1.push_back(std::pair<StateId, Label>(
+        state_vec_[arcs[i].first].first, arcs[i].second));
+  }
+  fst1_->PrepareArcs(arcs1);
+  arcs2.reserve(arcs.size());
+  for (size_t i = 0; i < arcs.size(); i++) {
+    Arc arc1;
+    if (fst1_->GetArc(arcs1[i].first, arcs1[i].second, &arc1) &&
+        arc1.olabel != 0)
+      arcs2.push_back(std::pair<StateId, Label>(
+          state_vec_[arcs[i].first].second, arc1.olabel));
+  }
+  fst2_->PrepareArcs(arcs2);
+}
+
+template<class Arc>
+void CacheDeterministicOnDemandFst<Arc>::PrepareArcs(
+    const std::vector<std::pair<StateId, Label> > &arcs) {
+  std::vector<std::pair<StateId, Label> > uncached_arcs;
+  for (size_t i = 0; i < arcs.size(); i++) {
+    size_t index = this->GetIndex(arcs[i].first, arcs[i].second);
+    if (!(cached_arcs_[index].first == arcs[i].first &&
+          cached_arcs_[index].second.ilabel == arcs[i].second))
+      uncached_arcs.push_back(arcs[i]);
+  }
+  fst_->PrepareArcs(uncached_arcs);
+}
+
 template<class Arc>
 bool CacheDeterministicOnDemandFst<Arc>::GetArc(StateId s, Label ilabel,
                                                 Arc *oarc) {
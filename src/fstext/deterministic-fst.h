@@ -85,6 +85,13 @@ class DeterministicOnDemandFst {
   /// Note: ilabel must not be epsilon.
   virtual bool GetArc(StateId s, Label ilabel, Arc *oarc) = 0;
 
+  /// This is a hint that GetArc() is about to be called for each of the
+  /// (state, ilabel) pairs in 'arcs'.  FSTs whose arcs are expensive to work
+  /// out one at a time (e.g. neural-network language models) may override it
+  /// to work them all out in one go; the default implementation does nothing.
+  virtual void PrepareArcs(
+      const std::vector<std::pair<StateId, Label> > &arcs) { }
+
   virtual ~DeterministicOnDemandFst() { }
 };
 
@@ -155,6 +162,10 @@ class ScaleDeterministicOnDemandFst:  public DeterministicOnDemandFst<StdArc> {
     }
   }
 
+  void PrepareArcs(const std::vector<std::pair<StateId, Label> > &arcs) {
+    det_fst_.PrepareArcs(arcs);
+  }
+
  private:
   float scale_;
   DeterministicOnDemandFst<StdArc> &det_fst_;
@@ -215,6 +226,16 @@ class ComposeDeterministicOnDemandFst: public DeterministicOnDemandFst<Arc> {
 
   virtual bool GetArc(StateId s, Label ilabel, Arc *oarc);
 
+  /// Passes the hint on to fst1, then works out the arcs of fst1 to pass the
+  /// hint on to fst2.  Our own states are only created by GetArc(), so the
+  /// result is the same as without the hint, except that fst1's GetArc() is
+  /// called earlier and in a different order.  That does not matter for the
+  /// FSTs in this file, but it would for KaldiRnnlmDeterministicFst with
+  /// --max-ngram-order, whose states depend on the order in which they are
+  /// created; so such an FST should be fst2 (as in the RNNLM rescoring
+  /// programs), for which the hint has no side effects.
+  virtual void PrepareArcs(const std::vector<std::pair<StateId, Label> > &arcs);
+
  private:
   DeterministicOnDemandFst<Arc> *fst1_;
   DeterministicOnDemandFst<Arc> *fst2_;
@@ -244,6 +265,8 @@ class CacheDeterministicOnDemandFst: public DeterministicOnDemandFst<Arc> {
 
   virtual bool GetArc(StateId s, Label ilabel, Arc *oarc);
 
+  virtual void PrepareArcs(const std::vector<std::pair<StateId, Label> > &arcs);
+
  private:
   // Get index for cached arc.
   inline size_t GetIndex(StateId src_state, Label ilabel);
@@ -77,6 +77,14 @@ Fst<StdArc> *ReadFstKaldiGeneric(std::string rxfilename, bool throw_on_err) {
   }
   // Read the FST
   FstReadOptions ropts("<unspecified>", &hdr);
+  if (hdr.FstType() == "const" &&
+      (hdr.GetFlags() & FstHeader::IS_ALIGNED) != 0 &&
+      kaldi::ClassifyRxfilename(rxfilename) == kaldi::kFileInput) {
+    // The arrays of an aligned ConstFst can be mapped directly from the file,
+    // which OpenFst does when given the file name as 'source'.
+    ropts.mode = FstReadOptions::MAP;
+    ropts.source = rxfilename;
+  }
   Fst<StdArc> *fst = Fst<StdArc>::Read(ki.Stream(), ropts);
   if (!fst) {
     if(throw_on_err) {
@@ -123,6 +131,28 @@ void WriteFstKaldi(const VectorFst<StdArc> &fst,
   fst.Write(ko.Stream(), wopts);
 }
 
+void WriteFstKaldiMappable(const Fst<StdArc> &fst,
+                           std::string wxfilename) {
+  if (kaldi::ClassifyWxfilename(wxfilename) != kaldi::kFileOutput)
+    KALDI_ERR << "Writing FST: a memory-mappable FST can only be written "
+              << "to a regular file, not to "
+              << kaldi::PrintableWxfilename(wxfilename);
+  const ConstFst<StdArc> *const_fst =
+      dynamic_cast<const ConstFst<StdArc>*>(&fst);
+  ConstFst<StdArc> *converted = NULL;
+  if (const_fst == NULL)
+    const_fst = converted = new ConstFst<StdArc>(fst);
+  bool write_binary = true, write_header = false;
+  kaldi::Output ko(wxfilename, write_binary, write_header);
+  FstWriteOptions wopts(kaldi::PrintableWxfilename(wxfilename));
+  wopts.align = true;
+  bool ok = const_fst->Write(ko.Stream(), wopts);
+  delete converted;
+  if (!ok || !ko.Close())
+    KALDI_ERR << "Error writing FST to "
+              << kaldi::PrintableWxfilename(wxfilename);
+}
+
 fst::VectorFst<fst::StdArc> *ReadAndPrepareLmFst(std::string rxfilename) {
   // ReadFstKaldi() will die with exception on failure.
   fst::VectorFst<fst::StdArc> *ans = fst::ReadFstKaldi(rxfilename);
@@ -48,6 +48,11 @@ VectorFst<StdArc> *ReadFstKaldi(std::string rxfilename);
 // This version currently supports ConstFst<StdArc> or VectorFst<StdArc>
 // (const-fst can give better performance for decoding). Other
 // types could be also loaded if registered inside OpenFst.
+// If 'rxfilename' is a regular file containing a ConstFst that was written
+// aligned (see WriteFstKaldiMappable()), the FST is memory-mapped rather than
+// read into memory, so loading is near-instant and processes that load the
+// same file share the same physical pages.  Don't overwrite such a file in
+// place while it is in use; write a new file and rename it.
 Fst<StdArc> *ReadFstKaldiGeneric(std::string rxfilename,
                                  bool throw_on_err = true);
 
@@ -68,6 +73,14 @@ void ReadFstKaldi(std::string rxfilename, VectorFst<StdArc> *ofst);
 void WriteFstKaldi(const VectorFst<StdArc> &fst,
                    std::string wxfilename);
 
+// Writes 'fst' as a ConstFst with its arrays aligned, which is the format
+// that ReadFstKaldiGeneric() can memory-map.  It is converted to ConstFst
+// first if it is of another type.  'wxfilename' must be a regular file,
+// because aligning the output requires a seekable stream.  On error, throws
+// using KALDI_ERR.
+void WriteFstKaldiMappable(const Fst<StdArc> &fst,
+                           std::string wxfilename);
+
 // This is a more general Kaldi-type-IO mechanism of writing FSTs to
 // streams, supporting binary or text-mode writing.  (note: we just
 // write the integers, symbol tables are not supported).
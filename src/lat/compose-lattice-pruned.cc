@@ -82,6 +82,19 @@ class PrunedCompactLatticeComposer {
   void ProcessTransition(int32 composed_src_state,
                          int32 arc_index);
 
+  // If the composed state 'composed_state' would next expand an arc with a
+  // nonzero label, outputs to 'lm_arc' the pair (lm-state, label) for the
+  // LM arc we need for it and returns true; otherwise returns false.
+  bool GetNextLmArc(int32 composed_state,
+                    std::pair<int32, int32> *lm_arc) const;
+
+  // Called before we process the element at the top of the queue.  If we
+  // have not already told det_fst_ about the LM arc that it needs, we tell
+  // det_fst_ (via PrepareArcs()) about the LM arcs needed by the first
+  // opts_.lm_batch_size elements of the queue, so that it can compute them
+  // all at once.
+  void PrepareLmArcs();
+
   // This function recomputes certain members of the ComposedStateInfo relating
   // to the output states: namely, 'forward_cost', 'backward_cost' and
   // 'delta_backward_cost'.  In between calls to this function, we try to
@@ -375,6 +388,11 @@ class PrunedCompactLatticeComposer {
   // will matter more for early iterations of the composition, when we need
   // to access the output lattice in topological order).
   std::set<int32> accessed_lat_states_;
+
+  // The set of pairs (lm-state, label) that we have passed to
+  // det_fst_->PrepareArcs().
+  unordered_set<std::pair<int32, int32>,
+                PairHasher<int32> > prepared_lm_arcs_;
 };
 
 
@@ -875,6 +893,48 @@ void PrunedCompactLatticeComposer::ProcessTransition(int32 src_composed_state,
   num_arcs_out_++;
 }
 
+bool PrunedCompactLatticeComposer::GetNextLmArc(
+    int32 composed_state, std::pair<int32, int32> *lm_arc) const {
+  const ComposedStateInfo &info = composed_state_info_[composed_state];
+  const LatticeStateInfo &lat_state_info = lat_state_info_[info.lat_state];
+  if (info.sorted_arc_index < 0)
+    return false;
+  int32 arc_index =
+      lat_state_info.arc_delta_costs[info.sorted_arc_index].second;
+  if (arc_index < 0)  // it's the final-prob.
+    return false;
+  fst::ArcIterator<CompactLattice> aiter(clat_in_, info.lat_state);
+  aiter.Seek(arc_index);
+  int32 olabel = aiter.Value().olabel;
+  if (olabel == 0)
+    return false;
+  lm_arc->first = info.lm_state;
+  lm_arc->second = olabel;
+  return true;
+}
+
+void PrunedCompactLatticeComposer::PrepareLmArcs() {
+  std::pair<int32, int32> lm_arc;
+  if (!GetNextLmArc(composed_state_queue_.top().second, &lm_arc) ||
+      prepared_lm_arcs_.count(lm_arc) != 0)
+    return;
+  // We pop the elements off the queue to look at them, and then put them
+  // back.
+  std::vector<std::pair<BaseFloat, int32> > elements;
+  std::vector<std::pair<int32, int32> > lm_arcs;
+  while (!composed_state_queue_.empty() &&
+         static_cast<int32>(elements.size()) < opts_.lm_batch_size) {
+    elements.push_back(composed_state_queue_.top());
+    composed_state_queue_.pop();
+    if (GetNextLmArc(elements.back().second, &lm_arc) &&
+        prepared_lm_arcs_.insert(lm_arc).second)
+      lm_arcs.push_back(lm_arc);
+  }
+  for (size_t i = 0; i < elements.size(); i++)
+    composed_state_queue_.push(elements[i]);
+  det_fst_->PrepareArcs(lm_arcs);
+}
+
 static int32 TotalNumArcs(const CompactLattice &clat) {
   int32 num_states = clat.NumStates(),
       num_arcs = 0;
@@ -899,6 +959,8 @@ void PrunedCompactLatticeComposer::Compose() {
     int32 this_iter_arc_limit = GetCurrentArcLimit();
     while (num_arcs_out_ < this_iter_arc_limit &&
            !composed_state_queue_.empty()) {
+      if (opts_.lm_batch_size > 1)
+        PrepareLmArcs();
       int32 src_composed_state = composed_state_queue_.top().second;
       composed_state_queue_.pop();
       ProcessQueueElement(src_composed_state);
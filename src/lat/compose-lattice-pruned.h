@@ -121,10 +121,17 @@ struct ComposeLatticePrunedOptions {
   // heuristics will be less accurate).
   BaseFloat growth_ratio;
 
+  // 'lm_batch_size' is the number of states at the front of the queue whose
+  // next LM arcs we ask the LM for at once (via PrepareArcs()), so that LMs
+  // like RNNLMs can evaluate them in one minibatch.  It does not affect the
+  // output.  If <= 1, we don't do this.
+  int32 lm_batch_size;
+
   ComposeLatticePrunedOptions(): lattice_compose_beam(6.0),
                                  max_arcs(100000),
                                  initial_num_arcs(100),
-                                 growth_ratio(1.5) { }
+                                 growth_ratio(1.5),
+                                 lm_batch_size(32) { }
   void Register(OptionsItf *po) {
     po->Register("lattice-compose-beam", &lattice_compose_beam,
                  "Beam used in pruned lattice composition, which determines how "
@@ -135,6 +142,9 @@ struct ComposeLatticePrunedOptions {
     po->Register("growth-ratio", &growth_ratio, "Factor used in the lattice "
                  "composition algorithm; must be >1.0.  Affects speed vs. "
                  "the optimality of the best-first composition.");
+    po->Register("lm-batch-size", &lm_batch_size, "Number of LM states that we "
+                 "ask the LM to expand at once (this speeds up RNNLM "
+                 "rescoring; it does not affect the output).");
   }
 };
 
@@ -136,6 +136,75 @@ template<class Arc> void TestDeterminizeLatticePruned2() {
   }
 }
 
+// test that determinizing long lattices in pieces, on several threads, gives
+// an equivalent result to determinizing them in one go.
+template<class Arc> void TestDeterminizeLatticeSegmented() {
+  typedef kaldi::int32 Int;
+  typedef typename Arc::Weight Weight;
+  typedef ArcTpl<CompactLatticeWeightTpl<Weight, Int> > CompactArc;
+  // The transition model is not used, as we set phone_determinize = false.
+  kaldi::TransitionModel trans_model;
+
+  for (int i = 0; i < 50; i++) {
+    RandFstOptions opts;
+    opts.n_states = 4;
+    opts.n_arcs = 8;
+    opts.n_final = 1;
+    opts.allow_empty = false;
+    opts.weight_multiplier = 0.5;
+    opts.acyclic = true;
+
+    // Concatenate some random FSTs, so there are states that all paths pass
+    // through.
+    VectorFst<Arc> fst;
+    int num_pieces = kaldi::RandInt(2, 6);
+    for (int j = 0; j < num_pieces; j++) {
+      VectorFst<Arc> *piece = RandPairFst<Arc>(opts);
+      if (j == 0)
+        fst = *piece;
+      else
+        Concat(&fst, *piece);
+      delete piece;
+    }
+    Connect(&fst);
+    bool sorted = TopSort(&fst);
+    KALDI_ASSERT(sorted);
+
+    DeterminizeLatticePhonePrunedOptions det_opts;
+    det_opts.phone_determinize = false;
+    det_opts.minimize = (kaldi::Rand() % 2 == 0);
+    VectorFst<CompactArc> det_fst, segmented_det_fst;
+    bool ans = DeterminizeLatticePhonePruned<Weight, Int>(
+        trans_model, fst, 10.0, &det_fst, det_opts);
+    // Sometimes renumber the states randomly, so the input is not
+    // topologically sorted and the start state need not be first.
+    VectorFst<Arc> shuffled_fst(fst);
+    if (kaldi::Rand() % 2 == 0) {
+      std::vector<typename Arc::StateId> order(fst.NumStates());
+      for (size_t s = 0; s < order.size(); s++)
+        order[s] = s;
+      std::random_shuffle(order.begin(), order.end());
+      StateSort(&shuffled_fst, order);
+    }
+    det_opts.num_threads = kaldi::RandInt(2, 3);
+    det_opts.min_segment_states = kaldi::RandInt(1, 5);
+    bool segmented_ans = DeterminizeLatticePhonePruned<Weight, Int>(
+        trans_model, shuffled_fst, 10.0, &segmented_det_fst, det_opts);
+
+    std::cout << "Lattice determinized in pieces is:\n";
+    {
+      FstPrinter<CompactArc> fstprinter(segmented_det_fst, NULL, NULL, NULL,
+                                        false, true, "\t");
+      fstprinter.Print(&std::cout, "standard output");
+    }
+    KALDI_ASSERT(segmented_det_fst.Properties(kIDeterministic, true) &
+                 kIDeterministic);
+    if (ans && segmented_ans)
+      KALDI_ASSERT(RandEquivalent(det_fst, segmented_det_fst, 5/*paths*/,
+                                  0.01/*delta*/, kaldi::Rand()/*seed*/,
+                                  100/*path length, max*/));
+  }
+}
 
 } // end namespace fst
 
@@ -143,5 +212,6 @@ int main() {
   using namespace fst;
   TestDeterminizeLatticePruned<kaldi::LatticeArc>();
   TestDeterminizeLatticePruned2<kaldi::LatticeArc>();
+  TestDeterminizeLatticeSegmented<kaldi::LatticeArc>();
   std::cout << "Tests succeeded\n";
 }
@@ -19,6 +19,7 @@
 // See the Apache 2 License for the specific language governing permissions and
 // limitations under the License.
 
+#include <atomic>
 #include <vector>
 #include <climits>
 #include "fstext/determinize-lattice.h" // for LatticeStringRepository
@@ -27,6 +28,7 @@
 #include "lat/minimize-lattice.h"   // for minimization
 #include "lat/push-lattice.h"       // for minimization
 #include "lat/determinize-lattice-pruned.h"
+#include "util/kaldi-thread.h"
 
 namespace fst {
 
@@ -1410,6 +1412,275 @@ bool DeterminizeLatticePhonePrunedFirstPass(
   return ans;
 }
 
+// Finds the "cut states" of the topologically sorted lattice 'fst': the states
+// other than the start state and the last state that every path from the start
+// state to a final state passes through.  These are the states s such that no
+// arc goes from a state before s to a state after s, and no state before s is
+// final.  Outputs them in increasing order.
+template<class Arc>
+static void FindLatticeCutStates(const ExpandedFst<Arc> &fst,
+                                 vector<typename Arc::StateId> *cut_states) {
+  typedef typename Arc::StateId StateId;
+  typedef typename Arc::Weight Weight;
+  cut_states->clear();
+  StateId num_states = fst.NumStates();
+  if (num_states == 0 || fst.Start() != 0)
+    return;
+  // 'max_dest' is the largest destination of any arc leaving a state before
+  // s.
+  StateId max_dest = 0;
+  for (StateId s = 0; s + 1 < num_states; s++) {
+    if (s > 0 && max_dest <= s)
+      cut_states->push_back(s);
+    if (fst.Final(s) != Weight::Zero())
+      return;  // No later state can be a cut state.
+    for (ArcIterator<ExpandedFst<Arc> > aiter(fst, s); !aiter.Done();
+         aiter.Next())
+      max_dest = std::max(max_dest, aiter.Value().nextstate);
+  }
+}
+
+// Copies states 'begin' through 'end' of the topologically sorted lattice
+// 'ifst', which are cut states or the first and last states, to 'ofst'.
+// Unless 'end' is the last state, only 'end' is final (with unit weight) in
+// 'ofst', and the arcs leaving it are not copied.
+template<class Arc>
+static void ExtractLatticeSegment(const ExpandedFst<Arc> &ifst,
+                                  typename Arc::StateId begin,
+                                  typename Arc::StateId end,
+                                  MutableFst<Arc> *ofst) {
+  typedef typename Arc::StateId StateId;
+  typedef typename Arc::Weight Weight;
+  bool is_last = (end + 1 == ifst.NumStates());
+  ofst->DeleteStates();
+  for (StateId s = begin; s <= end; s++)
+    ofst->AddState();
+  ofst->SetStart(0);
+  for (StateId s = begin; s <= end; s++) {
+    if (s == end && !is_last) {
+      ofst->SetFinal(s - begin, Weight::One());
+      break;
+    }
+    ofst->SetFinal(s - begin, ifst.Final(s));
+    for (ArcIterator<ExpandedFst<Arc> > aiter(ifst, s); !aiter.Done();
+         aiter.Next()) {
+      Arc arc = aiter.Value();
+      KALDI_ASSERT(arc.nextstate <= end);
+      arc.nextstate -= begin;
+      ofst->AddArc(s - begin, arc);
+    }
+  }
+}
+
+// A piece of a lattice, for DeterminizeLatticeSegmented().
+template<class Weight, class IntType>
+struct DeterminizeLatticeSegment {
+  typedef ArcTpl<Weight> Arc;
+  typedef ArcTpl<CompactLatticeWeightTpl<Weight, IntType> > CompactArc;
+  typename Arc::StateId begin;  // first state, in the input lattice.
+  typename Arc::StateId end;  // last state, in the input lattice.
+  bool done;  // true if 'det' is up to date.
+  bool ans;  // the return status of the determinization.
+  VectorFst<CompactArc> det;  // the determinized piece.
+};
+
+// Determinizes the pieces of a lattice that are not done yet; each thread
+// takes the next piece that nobody is working on.
+template<class Weight, class IntType>
+class DeterminizeLatticeSegmentTask: public kaldi::MultiThreadable {
+ public:
+  typedef ArcTpl<Weight> Arc;
+  DeterminizeLatticeSegmentTask(
+      const kaldi::TransitionModel &trans_model,
+      const ExpandedFst<Arc> &ifst, double beam,
+      const DeterminizeLatticePhonePrunedOptions &opts,
+      vector<DeterminizeLatticeSegment<Weight, IntType> > *segments,
+      std::atomic<size_t> *next_segment):
+      trans_model_(trans_model), ifst_(ifst), beam_(beam), opts_(opts),
+      segments_(segments), next_segment_(next_segment) { }
+  // Use the default copy constructor.
+  virtual void operator() () {
+    size_t i;
+    while ((i = (*next_segment_)++) < segments_->size()) {
+      DeterminizeLatticeSegment<Weight, IntType> &segment = (*segments_)[i];
+      if (segment.done)
+        continue;
+      VectorFst<Arc> fst;
+      ExtractLatticeSegment(ifst_, segment.begin, segment.end, &fst);
+      segment.ans = DeterminizeLatticePhonePruned<Weight, IntType>(
+          trans_model_, &fst, beam_, &segment.det, opts_);
+      segment.done = true;
+    }
+  }
+ private:
+  const kaldi::TransitionModel &trans_model_;
+  const ExpandedFst<Arc> &ifst_;
+  double beam_;
+  DeterminizeLatticePhonePrunedOptions opts_;
+  vector<DeterminizeLatticeSegment<Weight, IntType> > *segments_;
+  std::atomic<size_t> *next_segment_;
+};
+
+// Returns true if the determinized piece 'det' can be joined to the piece
+// after it: it is nonempty, and none of its final states has arcs leaving it.
+// If 'is_first' is true, its start state must not be final either.
+template<class CompactArc>
+static bool CanJoinLatticeSegment(const ExpandedFst<CompactArc> &det,
+                                  bool is_first) {
+  typedef typename CompactArc::StateId StateId;
+  typedef typename CompactArc::Weight CompactWeight;
+  if (det.Start() == kNoStateId)
+    return false;
+  for (StateId s = 0; s < det.NumStates(); s++) {
+    if (det.Final(s) != CompactWeight::Zero() &&
+        (det.NumArcs(s) != 0 || (is_first && s == det.Start())))
+      return false;
+  }
+  return true;
+}
+
+// Implements the multi-threaded version of DeterminizeLatticePhonePruned() (see
+// its documentation in the header).  Returns false without doing anything if
+// it cannot split 'ifst' into at least two pieces; otherwise sets 'ans' to the
+// return status and returns true.
+template<class Weight, class IntType>
+static bool DeterminizeLatticeSegmented(
+    const kaldi::TransitionModel &trans_model,
+    const ExpandedFst<ArcTpl<Weight> > &ifst,
+    double beam,
+    MutableFst<ArcTpl<CompactLatticeWeightTpl<Weight, IntType> > > *ofst,
+    const DeterminizeLatticePhonePrunedOptions &opts,
+    bool *ans) {
+  typedef ArcTpl<Weight> Arc;
+  typedef typename Arc::StateId StateId;
+  typedef CompactLatticeWeightTpl<Weight, IntType> CompactWeight;
+  typedef ArcTpl<CompactWeight> CompactArc;
+  typedef DeterminizeLatticeSegment<Weight, IntType> Segment;
+
+  // The pieces are ranges of state ids, so the arcs must go forward and the
+  // start state must come first.  In a topologically sorted lattice the start
+  // state is only not first if there are unreachable states before it.
+  KALDI_ASSERT(ifst.Properties(kTopSorted, true) != 0);
+  if (ifst.Start() != 0)
+    return false;
+
+  vector<StateId> cut_states;
+  FindLatticeCutStates(ifst, &cut_states);
+  // Aim for a few pieces per thread, so the threads are kept busy even if the
+  // pieces take different amounts of time.
+  StateId num_states = ifst.NumStates(),
+      segment_states = std::max<StateId>(
+          opts.min_segment_states, num_states / (4 * opts.num_threads));
+  vector<Segment> segments;
+  Segment segment;
+  segment.begin = 0;
+  segment.done = false;
+  segment.ans = true;
+  for (size_t i = 0; i < cut_states.size(); i++) {
+    if (cut_states[i] - segment.begin >= segment_states &&
+        num_states - cut_states[i] >= segment_states) {
+      segment.end = cut_states[i];
+      segments.push_back(segment);
+      segment.begin = cut_states[i];
+    }
+  }
+  if (segments.empty())
+    return false;
+  segment.end = num_states - 1;
+  segments.push_back(segment);
+  KALDI_VLOG(3) << "Determinizing lattice with " << num_states
+                << " states in " << segments.size() << " pieces.";
+
+  DeterminizeLatticePhonePrunedOptions segment_opts(opts);
+  segment_opts.num_threads = 1;
+  segment_opts.minimize = false;
+  while (true) {
+    {
+      std::atomic<size_t> next_segment(0);
+      kaldi::MultiThreader<DeterminizeLatticeSegmentTask<Weight, IntType> > m(
+          std::min<int>(opts.num_threads, segments.size()),
+          DeterminizeLatticeSegmentTask<Weight, IntType>(
+              trans_model, ifst, beam, segment_opts, &segments,
+              &next_segment));
+    }
+    // Merge each piece that cannot be joined to the next one with it.
+    bool all_ok = true;
+    for (size_t i = 0; i + 1 < segments.size(); i++) {
+      if (!CanJoinLatticeSegment(segments[i].det, i == 0)) {
+        segments[i].end = segments[i + 1].end;
+        segments[i].done = false;
+        segments.erase(segments.begin() + i + 1);
+        all_ok = false;
+      }
+    }
+    if (all_ok)
+      break;
+    KALDI_VLOG(3) << "Re-determinizing after merging pieces; now there are "
+                  << segments.size() << " pieces.";
+  }
+
+  // Join the pieces, starting from the last.  The arcs that enter a final state
+  // of one piece are redirected to the start state of the next one, and take
+  // on the final weight.  'next_start' and 'next_weight' are the state the
+  // next piece starts in (in 'ofst'), and a weight to multiply into arcs that
+  // enter it; the weight is only not One if a piece accepts only the empty
+  // sequence.
+  *ans = true;
+  ofst->DeleteStates();
+  StateId next_start = kNoStateId;
+  CompactWeight next_weight = CompactWeight::One();
+  for (size_t i = segments.size(); i-- > 0; ) {
+    const VectorFst<CompactArc> &det = segments[i].det;
+    bool is_last = (i + 1 == segments.size());
+    *ans = segments[i].ans && *ans;
+    vector<StateId> state_map(det.NumStates(), kNoStateId);
+    for (StateId s = 0; s < det.NumStates(); s++)
+      if (is_last || det.Final(s) == CompactWeight::Zero())
+        state_map[s] = ofst->AddState();
+    for (StateId s = 0; s < det.NumStates(); s++) {
+      if (state_map[s] == kNoStateId)
+        continue;
+      if (is_last)
+        ofst->SetFinal(state_map[s], det.Final(s));
+      for (ArcIterator<VectorFst<CompactArc> > aiter(det, s); !aiter.Done();
+           aiter.Next()) {
+        CompactArc arc = aiter.Value();
+        if (state_map[arc.nextstate] != kNoStateId) {
+          arc.nextstate = state_map[arc.nextstate];
+        } else {
+          arc.weight = Times(arc.weight,
+                             Times(det.Final(arc.nextstate), next_weight));
+          arc.nextstate = next_start;
+        }
+        ofst->AddArc(state_map[s], arc);
+      }
+    }
+    if (is_last && det.Start() == kNoStateId) {
+      // The last piece is empty (e.g. everything was pruned away or the
+      // determinization failed), and so is the whole lattice.
+      ofst->DeleteStates();
+      return true;
+    }
+    if (state_map[det.Start()] != kNoStateId) {
+      next_start = state_map[det.Start()];
+      next_weight = CompactWeight::One();
+    } else {
+      next_weight = Times(det.Final(det.Start()), next_weight);
+    }
+  }
+  // CanJoinLatticeSegment() made sure the first piece's start state is not
+  // final, so next_weight is One.
+  ofst->SetStart(next_start);
+
+  if (opts.minimize) {
+    KALDI_VLOG(3) << "Pushing and minimizing on word lattices.";
+    *ans = PushCompactLatticeStrings<Weight, IntType>(ofst) && *ans;
+    *ans = PushCompactLatticeWeights<Weight, IntType>(ofst) && *ans;
+    *ans = MinimizeCompactLattice<Weight, IntType>(ofst) && *ans;
+  }
+  return true;
+}
+
 // "Destructive" version of DeterminizeLatticePhonePruned() where the input
 // lattice might be modified.
 template<class Weight, class IntType>
@@ -1432,6 +1703,19 @@ bool DeterminizeLatticePhonePruned(
     return ans;
   }
 
+  if (opts.num_threads > 1 &&
+      ifst->NumStates() >= 2 * opts.min_segment_states) {
+    // Splitting the lattice needs it to be topologically sorted; the
+    // determinization below expects this as well.  TopSort() leaves cyclic
+    // lattices unchanged, and we do them in one piece.
+    if (ifst->Properties(kTopSorted, true) == 0)
+      TopSort(ifst);
+    if (ifst->Properties(kTopSorted, true) != 0 &&
+        DeterminizeLatticeSegmented<Weight, IntType>(trans_model, *ifst, beam,
+                                                     ofst, opts, &ans))
+      return ans;
+  }
+
   // Determinization options.
   DeterminizeLatticePrunedOptions det_opts;
   det_opts.delta = opts.delta;
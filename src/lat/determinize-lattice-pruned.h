@@ -155,11 +155,21 @@ struct DeterminizeLatticePhonePrunedOptions {
   bool word_determinize;
   // minimize: if true, push and minimize after determinization.
   bool minimize;
+  // num_threads: if > 1, split long lattices at states that every path passes
+  // through and determinize the pieces in parallel (see
+  // DeterminizeLatticePhonePruned()).  max_mem then applies to each piece
+  // separately, so up to num_threads times max_mem may be in use at once.
+  int num_threads;
+  // min_segment_states: the minimum number of states of the input lattice in
+  // each piece, when num_threads > 1.
+  int min_segment_states;
   DeterminizeLatticePhonePrunedOptions(): delta(kDelta),
                                           max_mem(50000000),
                                           phone_determinize(true),
                                           word_determinize(true),
-                                          minimize(false) {}
+                                          minimize(false),
+                                          num_threads(1),
+                                          min_segment_states(5000) {}
   void Register (kaldi::OptionsItf *opts) {
     opts->Register("delta", &delta, "Tolerance used in determinization");
     opts->Register("max-mem", &max_mem, "Maximum approximate memory usage in "
@@ -172,6 +182,15 @@ struct DeterminizeLatticePhonePrunedOptions {
                    "--phone-determinize)");
     opts->Register("minimize", &minimize, "If true, push and minimize after "
                    "determinization.");
+    opts->Register("determinize-threads", &num_threads, "If >1, long "
+                   "lattices are split at states that every path passes "
+                   "through, and the pieces are determinized in parallel by "
+                   "this many threads.  Pruning is unaffected, but --max-mem "
+                   "applies to each piece separately.");
+    opts->Register("determinize-min-segment-states", &min_segment_states,
+                   "With --determinize-threads > 1, the minimum number of "
+                   "lattice states in each piece that is determinized "
+                   "separately.");
   }
 };
 
@@ -250,6 +269,24 @@ void DeterminizeLatticeDeletePhones(
     due to the max-mem constraint.  The result should be the same as word-level
     determinization in general, but for deeper lattices it is a bit faster,
     despite the fact that we now have two passes of determinization by default.
+
+    If opts.num_threads > 1, we look for "cut states": states that every path
+    of the (topologically sorted) input passes through, such as the states
+    inside long silences.  The lattice is split at some of these into pieces of
+    at least opts.min_segment_states states, which are determinized in
+    parallel, and the results are joined together.  Because every path passes
+    through the cut states, pruning each piece with 'prune' keeps the same
+    paths as pruning the whole lattice.  Joining two determinized pieces only
+    gives a deterministic result if no final state of the first one has arcs
+    leaving it (this fails if some word sequence of the first piece is a prefix
+    of another that reaches the cut state); we check this, and determinize the
+    two pieces together instead if it fails.  The output is equivalent to that
+    with one thread, but the states may be numbered differently.  The input is
+    topologically sorted first if it is not already (which the destructive
+    version does in place); cyclic lattices are determinized in one piece.
+    opts.max_mem is a limit for each piece, not for the whole lattice, so the
+    determinization may use up to opts.num_threads times as much memory, and a
+    lattice that exceeds max_mem as a whole may succeed in pieces.
 */
 template<class Weight, class IntType>
 bool DeterminizeLatticePhonePruned(
@@ -0,0 +1,388 @@
+// lat/sausages-test.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <map>
+
+#include "lat/sausages.h"
+#include "lat/lattice-functions.h"
+
+namespace kaldi {
+
+// This is a copy of the original MinimumBayesRisk code, which kept the
+// per-node arc lists as vectors of indexes and accumulated the stats in
+// std::maps.  It is used to check that the flat-array version in sausages.cc
+// gives the same results.  Only the parts needed for the one-best output, the
+// Bayes risk, the sausage stats and the per-bin times are kept.
+class ReferenceMinimumBayesRisk {
+ public:
+  ReferenceMinimumBayesRisk(const CompactLattice &clat_in,
+                            const std::vector<int32> *words,
+                            MinimumBayesRiskOptions opts): opts_(opts) {
+    CompactLattice clat(clat_in);
+    PrepareLatticeAndInitStats(&clat);
+    if (words != NULL) {
+      R_ = *words;
+    } else {
+      RemoveAlignmentsFromCompactLattice(&clat);
+      Lattice lat;
+      ConvertLattice(clat, &lat);
+      fst::VectorFst<fst::StdArc> fst;
+      ConvertLattice(lat, &fst);
+      fst::VectorFst<fst::StdArc> fst_shortest_path;
+      fst::ShortestPath(fst, &fst_shortest_path);
+      std::vector<int32> alignment;
+      fst::TropicalWeight weight;
+      GetLinearSymbolSequence(fst_shortest_path, &alignment, &R_, &weight);
+    }
+    L_ = 0.0;
+    MbrDecode();
+  }
+
+  const std::vector<int32> &GetOneBest() const { return R_; }
+  BaseFloat GetBayesRisk() const { return L_; }
+  const std::vector<std::vector<std::pair<int32, BaseFloat> > >
+      &GetSausageStats() const { return gamma_; }
+  const std::vector<std::vector<std::pair<BaseFloat, BaseFloat> > >
+      &GetTimes() const { return times_; }
+
+ private:
+  struct Arc {
+    int32 word;
+    int32 start_node;
+    int32 end_node;
+    BaseFloat loglike;
+  };
+
+  struct GammaCompare {
+    bool operator () (const std::pair<int32, BaseFloat> &a,
+                      const std::pair<int32, BaseFloat> &b) const {
+      if (a.second > b.second) return true;
+      else if (a.second < b.second) return false;
+      else return a.first > b.first;
+    }
+  };
+
+  inline double l(int32 a, int32 b, bool penalize = false) {
+    if (a == b) return 0.0;
+    else return (penalize ? 1.0 + 1.0e-05 : 1.0);
+  }
+  inline int32 r(int32 q) { return R_[q-1]; }
+
+  static void AddToMap(int32 i, double d, std::map<int32, double> *gamma) {
+    if (d == 0) return;
+    std::pair<const int32, double> pr(i, d);
+    std::pair<std::map<int32, double>::iterator, bool> ret = gamma->insert(pr);
+    if (!ret.second)
+      ret.first->second += d;
+  }
+
+  static void NormalizeEps(std::vector<int32> *vec) {
+    vec->erase(std::remove(vec->begin(), vec->end(), 0), vec->end());
+    vec->resize(1 + vec->size() * 2);
+    int32 s = vec->size();
+    for (int32 i = s/2 - 1; i >= 0; i--) {
+      (*vec)[i*2 + 1] = (*vec)[i];
+      (*vec)[i*2 + 2] = 0;
+    }
+    (*vec)[0] = 0;
+  }
+
+  void PrepareLatticeAndInitStats(CompactLattice *clat) {
+    CreateSuperFinal(clat);
+    uint64 props = clat->Properties(fst::kFstProperties, false);
+    if (!(props & fst::kTopSorted)) {
+      if (fst::TopSort(clat) == false)
+        KALDI_ERR << "Cycles detected in lattice.";
+    }
+    CompactLatticeStateTimes(*clat, &state_times_);
+    state_times_.push_back(0);
+    for (size_t i = state_times_.size()-1; i > 0; i--)
+      state_times_[i] = state_times_[i-1];
+    int32 N = clat->NumStates();
+    pre_.resize(N+1);
+    for (int32 n = 1; n <= N; n++) {
+      for (fst::ArcIterator<CompactLattice> aiter(*clat, n-1);
+           !aiter.Done(); aiter.Next()) {
+        const CompactLatticeArc &carc = aiter.Value();
+        Arc arc;
+        arc.word = carc.ilabel;
+        arc.start_node = n;
+        arc.end_node = carc.nextstate + 1;
+        arc.loglike = - (carc.weight.Weight().Value1() +
+                         carc.weight.Weight().Value2());
+        pre_[arc.end_node].push_back(arcs_.size());
+        arcs_.push_back(arc);
+      }
+    }
+  }
+
+  void MbrDecode() {
+    for (size_t counter = 0; ; counter++) {
+      NormalizeEps(&R_);
+      AccStats();
+      double delta_Q = 0.0;
+      for (size_t q = 0; q < R_.size(); q++) {
+        if (opts_.decode_mbr) {
+          const std::vector<std::pair<int32, BaseFloat> > &this_gamma =
+              gamma_[q];
+          double old_gamma = 0, new_gamma = this_gamma[0].second;
+          int32 rq = R_[q], rhat = this_gamma[0].first;
+          for (size_t j = 0; j < this_gamma.size(); j++)
+            if (this_gamma[j].first == rq) old_gamma = this_gamma[j].second;
+          delta_Q += (old_gamma - new_gamma);
+          R_[q] = rhat;
+        }
+      }
+      if (delta_Q == 0 || counter > 100) break;
+    }
+    if (!opts_.print_silence)
+      R_.erase(std::remove(R_.begin(), R_.end(), 0), R_.end());
+  }
+
+  double EditDistance(int32 N, int32 Q,
+                      Vector<double> &alpha,
+                      Matrix<double> &alpha_dash,
+                      Vector<double> &alpha_dash_arc) {
+    alpha(1) = 0.0;
+    alpha_dash(1, 0) = 0.0;
+    for (int32 q = 1; q <= Q; q++)
+      alpha_dash(1, q) = alpha_dash(1, q-1) + l(0, r(q));
+    for (int32 n = 2; n <= N; n++) {
+      double alpha_n = kLogZeroDouble;
+      for (size_t i = 0; i < pre_[n].size(); i++) {
+        const Arc &arc = arcs_[pre_[n][i]];
+        alpha_n = LogAdd(alpha_n, alpha(arc.start_node) + arc.loglike);
+      }
+      alpha(n) = alpha_n;
+      for (size_t i = 0; i < pre_[n].size(); i++) {
+        const Arc &arc = arcs_[pre_[n][i]];
+        int32 s_a = arc.start_node, w_a = arc.word;
+        BaseFloat p_a = arc.loglike;
+        for (int32 q = 0; q <= Q; q++) {
+          if (q == 0) {
+            alpha_dash_arc(q) = alpha_dash(s_a, q) + l(w_a, 0, true);
+          } else {
+            int32 r_q = r(q);
+            double a1 = alpha_dash(s_a, q-1) + l(w_a, r_q),
+                a2 = alpha_dash(s_a, q) + l(w_a, 0, true),
+                a3 = alpha_dash_arc(q-1) + l(0, r_q);
+            alpha_dash_arc(q) = std::min(a1, std::min(a2, a3));
+          }
+          alpha_dash(n, q) +=
+              Exp(alpha(s_a) + p_a - alpha(n)) * alpha_dash_arc(q);
+        }
+      }
+    }
+    return alpha_dash(N, Q);
+  }
+
+  void AccStats() {
+    using std::map;
+    int32 N = static_cast<int32>(pre_.size()) - 1,
+        Q = static_cast<int32>(R_.size());
+    Vector<double> alpha(N+1);
+    Matrix<double> alpha_dash(N+1, Q+1);
+    Vector<double> alpha_dash_arc(Q+1);
+    Matrix<double> beta_dash(N+1, Q+1);
+    Vector<double> beta_dash_arc(Q+1);
+    std::vector<char> b_arc(Q+1);
+    std::vector<map<int32, double> > gamma(Q+1), tau_b(Q+1), tau_e(Q+1);
+
+    L_ = EditDistance(N, Q, alpha, alpha_dash, alpha_dash_arc);
+    beta_dash(N, Q) = 1.0;
+    for (int32 n = N; n >= 2; n--) {
+      for (size_t i = 0; i < pre_[n].size(); i++) {
+        const Arc &arc = arcs_[pre_[n][i]];
+        int32 s_a = arc.start_node, w_a = arc.word;
+        BaseFloat p_a = arc.loglike;
+        alpha_dash_arc(0) = alpha_dash(s_a, 0) + l(w_a, 0, true);
+        for (int32 q = 1; q <= Q; q++) {
+          int32 r_q = r(q);
+          double a1 = alpha_dash(s_a, q-1) + l(w_a, r_q),
+              a2 = alpha_dash(s_a, q) + l(w_a, 0, true),
+              a3 = alpha_dash_arc(q-1) + l(0, r_q);
+          if (a1 <= a2) {
+            if (a1 <= a3) { b_arc[q] = 1; alpha_dash_arc(q) = a1; }
+            else { b_arc[q] = 3; alpha_dash_arc(q) = a3; }
+          } else {
+            if (a2 <= a3) { b_arc[q] = 2; alpha_dash_arc(q) = a2; }
+            else { b_arc[q] = 3; alpha_dash_arc(q) = a3; }
+          }
+        }
+        beta_dash_arc.SetZero();
+        for (int32 q = Q; q >= 1; q--) {
+          beta_dash_arc(q) +=
+              Exp(alpha(s_a) + p_a - alpha(n)) * beta_dash(n, q);
+          switch (static_cast<int>(b_arc[q])) {
+            case 1:
+              beta_dash(s_a, q-1) += beta_dash_arc(q);
+              AddToMap(w_a, beta_dash_arc(q), &(gamma[q]));
+              AddToMap(w_a, state_times_[s_a] * beta_dash_arc(q), &(tau_b[q]));
+              AddToMap(w_a, state_times_[n] * beta_dash_arc(q), &(tau_e[q]));
+              break;
+            case 2:
+              beta_dash(s_a, q) += beta_dash_arc(q);
+              break;
+            case 3:
+              beta_dash_arc(q-1) += beta_dash_arc(q);
+              AddToMap(0, beta_dash_arc(q), &(gamma[q]));
+              AddToMap(0, state_times_[n] * beta_dash_arc(q), &(tau_b[q]));
+              AddToMap(0, state_times_[n] * beta_dash_arc(q), &(tau_e[q]));
+              break;
+            default:
+              KALDI_ERR << "Invalid b_arc value";
+          }
+        }
+        beta_dash_arc(0) += Exp(alpha(s_a) + p_a - alpha(n)) * beta_dash(n, 0);
+        beta_dash(s_a, 0) += beta_dash_arc(0);
+      }
+    }
+    beta_dash_arc.SetZero();
+    for (int32 q = Q; q >= 1; q--) {
+      beta_dash_arc(q) += beta_dash(1, q);
+      beta_dash_arc(q-1) += beta_dash_arc(q);
+      AddToMap(0, beta_dash_arc(q), &(gamma[q]));
+      AddToMap(0, state_times_[1] * beta_dash_arc(q), &(tau_b[q]));
+      AddToMap(0, state_times_[1] * beta_dash_arc(q), &(tau_e[q]));
+    }
+    gamma_.clear();
+    gamma_.resize(Q);
+    times_.clear();
+    times_.resize(Q);
+    for (int32 q = 1; q <= Q; q++) {
+      for (map<int32, double>::iterator iter = gamma[q].begin();
+           iter != gamma[q].end(); ++iter)
+        gamma_[q-1].push_back(
+            std::make_pair(iter->first, static_cast<BaseFloat>(iter->second)));
+      GammaCompare comp;
+      std::sort(gamma_[q-1].begin(), gamma_[q-1].end(), comp);
+      for (size_t i = 0; i < gamma_[q-1].size(); i++) {
+        int32 word = gamma_[q-1][i].first;
+        BaseFloat post = gamma_[q-1][i].second;
+        times_[q-1].push_back(
+            std::make_pair(static_cast<BaseFloat>(tau_b[q][word] / post),
+                           static_cast<BaseFloat>(tau_e[q][word] / post)));
+      }
+    }
+  }
+
+  MinimumBayesRiskOptions opts_;
+  std::vector<Arc> arcs_;
+  std::vector<std::vector<int32> > pre_;
+  std::vector<int32> state_times_;
+  std::vector<int32> R_;
+  double L_;
+  std::vector<std::vector<std::pair<int32, BaseFloat> > > gamma_;
+  std::vector<std::vector<std::pair<BaseFloat, BaseFloat> > > times_;
+};
+
+// Makes a random acyclic word lattice whose states have consistent times: the
+// states are numbered in order of time, every state has an arc to the next
+// one, and there are some arcs that skip states.  Some arcs have epsilon words.
+static void RandWordLattice(CompactLattice *clat) {
+  clat->DeleteStates();
+  int32 num_states = RandInt(2, 20);
+  std::vector<int32> times(num_states);
+  for (int32 s = 0; s < num_states; s++) {
+    clat->AddState();
+    times[s] = (s == 0 ? 0 : times[s-1] + RandInt(1, 4));
+  }
+  clat->SetStart(0);
+  clat->SetFinal(num_states - 1, CompactLatticeWeight::One());
+  for (int32 s = 0; s + 1 < num_states; s++) {
+    int32 num_arcs = RandInt(1, 3);
+    for (int32 i = 0; i < num_arcs; i++) {
+      int32 dest = (i == 0 ? s + 1 : RandInt(s + 1, num_states - 1)),
+          word = (RandInt(0, 3) == 0 ? 0 : RandInt(1, 6));
+      std::vector<int32> alignment(times[dest] - times[s]);
+      for (size_t t = 0; t < alignment.size(); t++)
+        alignment[t] = RandInt(1, 10);
+      LatticeWeight weight(RandUniform() * 5.0, RandUniform() * 5.0);
+      clat->AddArc(s, CompactLatticeArc(word, word,
+                                        CompactLatticeWeight(weight,
+                                                             alignment),
+                                        dest));
+    }
+  }
+}
+
+static void AssertSameStats(
+    const std::vector<std::vector<std::pair<int32, BaseFloat> > > &a,
+    const std::vector<std::vector<std::pair<int32, BaseFloat> > > &b) {
+  KALDI_ASSERT(a.size() == b.size());
+  for (size_t q = 0; q < a.size(); q++) {
+    KALDI_ASSERT(a[q].size() == b[q].size());
+    for (size_t i = 0; i < a[q].size(); i++)
+      KALDI_ASSERT(a[q][i].first == b[q][i].first &&
+                   ApproxEqual(a[q][i].second, b[q][i].second, 1.0e-05));
+  }
+}
+
+static void AssertSameTimes(
+    const std::vector<std::vector<std::pair<BaseFloat, BaseFloat> > > &a,
+    const std::vector<std::vector<std::pair<BaseFloat, BaseFloat> > > &b) {
+  KALDI_ASSERT(a.size() == b.size());
+  for (size_t q = 0; q < a.size(); q++) {
+    KALDI_ASSERT(a[q].size() == b[q].size());
+    for (size_t i = 0; i < a[q].size(); i++)
+      KALDI_ASSERT(ApproxEqual(a[q][i].first, b[q][i].first, 1.0e-05) &&
+                   ApproxEqual(a[q][i].second, b[q][i].second, 1.0e-05));
+  }
+}
+
+// Checks that MinimumBayesRisk gives the same results as the original
+// map-based implementation, starting both from the MAP path and from a given
+// word sequence.
+void TestMinimumBayesRiskAgainstReference() {
+  CompactLattice clat;
+  RandWordLattice(&clat);
+  MinimumBayesRiskOptions opts;
+  opts.decode_mbr = (RandInt(0, 3) != 0);
+  opts.print_silence = (RandInt(0, 1) == 0);
+
+  std::vector<int32> words;
+  const std::vector<int32> *init_words = NULL;
+  if (RandInt(0, 1) == 0) {
+    int32 num_words = RandInt(0, 4);
+    for (int32 i = 0; i < num_words; i++)
+      words.push_back(RandInt(1, 6));
+    init_words = &words;
+  }
+
+  ReferenceMinimumBayesRisk ref_mbr(clat, init_words, opts);
+  MinimumBayesRisk *mbr = (init_words == NULL ?
+                           new MinimumBayesRisk(clat, opts) :
+                           new MinimumBayesRisk(clat, words, opts));
+
+  KALDI_ASSERT(mbr->GetOneBest() == ref_mbr.GetOneBest());
+  KALDI_ASSERT(ApproxEqual(mbr->GetBayesRisk(), ref_mbr.GetBayesRisk(),
+                           1.0e-05));
+  AssertSameStats(mbr->GetSausageStats(), ref_mbr.GetSausageStats());
+  AssertSameTimes(mbr->GetTimes(), ref_mbr.GetTimes());
+  delete mbr;
+}
+
+}  // namespace kaldi
+
+int main() {
+  for (int32 i = 0; i < 200; i++)
+    kaldi::TestMinimumBayesRiskAgainstReference();
+  KALDI_LOG << "Success.";
+}
@@ -131,62 +131,98 @@ double MinimumBayesRisk::EditDistance(int32 N, int32 Q,
                                       Vector<double> &alpha,
                                       Matrix<double> &alpha_dash,
                                       Vector<double> &alpha_dash_arc) {
+  // ins_cost[q] is l(0, r(q)), the cost of r(q) not being matched.
+  ins_cost_.resize(Q + 1);
+  for (int32 q = 1; q <= Q; q++)
+    ins_cost_[q] = l(0, r(q));
   alpha(1) = 0.0; // = log(1).  Line 5.
   alpha_dash(1, 0) = 0.0; // Line 5.
   for (int32 q = 1; q <= Q; q++)
-    alpha_dash(1, q) = alpha_dash(1, q-1) + l(0, r(q)); // Line 7.
+    alpha_dash(1, q) = alpha_dash(1, q-1) + ins_cost_[q]; // Line 7.
+  double *arc_data = alpha_dash_arc.Data();
   for (int32 n = 2; n <= N; n++) {
+    const Arc *begin = arcs_.data() + pre_begin_[n],
+        *end = arcs_.data() + pre_begin_[n + 1];
     double alpha_n = kLogZeroDouble;
-    for (size_t i = 0; i < pre_[n].size(); i++) {
-      const Arc &arc = arcs_[pre_[n][i]];
-      alpha_n = LogAdd(alpha_n, alpha(arc.start_node) + arc.loglike);
-    }
+    for (const Arc *arc = begin; arc != end; ++arc)
+      alpha_n = LogAdd(alpha_n, alpha(arc->start_node) + arc->loglike);
     alpha(n) = alpha_n; // Line 10.
     // Line 11 omitted: matrix was initialized to zero.
-    for (size_t i = 0; i < pre_[n].size(); i++) {
-      const Arc &arc = arcs_[pre_[n][i]];
-      int32 s_a = arc.start_node, w_a = arc.word;
-      BaseFloat p_a = arc.loglike;
-      for (int32 q = 0; q <= Q; q++) {
-        if (q == 0) {
-          alpha_dash_arc(q) = // line 15.
-              alpha_dash(s_a, q) + l(w_a, 0, true);
-        } else {  // a1,a2,a3 are the 3 parts of min expression of line 17.
-          int32 r_q = r(q);
-          double a1 = alpha_dash(s_a, q-1) + l(w_a, r_q),
-              a2 = alpha_dash(s_a, q) + l(w_a, 0, true),
-              a3 = alpha_dash_arc(q-1) + l(0, r_q);
-          alpha_dash_arc(q) = std::min(a1, std::min(a2, a3));
-        }
-        // line 19:
-        alpha_dash(n, q) += Exp(alpha(s_a) + p_a - alpha(n)) * alpha_dash_arc(q);
+    double *this_row = alpha_dash.RowData(n);
+    for (const Arc *arc = begin; arc != end; ++arc) {
+      int32 s_a = arc->start_node, w_a = arc->word;
+      const double *prev_row = alpha_dash.RowData(s_a);
+      double del_cost = l(w_a, 0, true);
+      arc_data[0] = prev_row[0] + del_cost; // line 15.
+      for (int32 q = 1; q <= Q; q++) {
+        // a1,a2,a3 are the 3 parts of min expression of line 17.
+        double a1 = prev_row[q-1] + l(w_a, r(q)),
+            a2 = prev_row[q] + del_cost,
+            a3 = arc_data[q-1] + ins_cost_[q];
+        arc_data[q] = std::min(a1, std::min(a2, a3));
       }
+      // line 19:
+      double arc_post = Exp(alpha(s_a) + arc->loglike - alpha(n));
+      for (int32 q = 0; q <= Q; q++)
+        this_row[q] += arc_post * arc_data[q];
     }
   }
   return alpha_dash(N, Q); // line 23.
 }
 
+// static
+inline void MinimumBayesRisk::AddToStats(int32 word, double gamma,
+                                         double tau_b, double tau_e,
+                                         std::vector<GammaEntry> *stats) {
+  if (gamma == 0) return;
+  // There are typically few words per bin, and the last one we added to is
+  // the most likely to be the same one.
+  for (size_t i = stats->size(); i-- > 0; ) {
+    GammaEntry &entry = (*stats)[i];
+    if (entry.word == word) {
+      entry.gamma += gamma;
+      entry.tau_b += tau_b;
+      entry.tau_e += tau_e;
+      return;
+    }
+  }
+  GammaEntry entry;
+  entry.word = word;
+  entry.gamma = gamma;
+  entry.tau_b = tau_b;
+  entry.tau_e = tau_e;
+  stats->push_back(entry);
+}
+
 // Figure 5 in the paper.
 void MinimumBayesRisk::AccStats() {
-  using std::map;
-
-  int32 N = static_cast<int32>(pre_.size()) - 1,
+  int32 N = static_cast<int32>(pre_begin_.size()) - 2,
       Q = static_cast<int32>(R_.size());
 
-  Vector<double> alpha(N+1); // index (1...N)
-  Matrix<double> alpha_dash(N+1, Q+1); // index (1...N, 0...Q)
-  Vector<double> alpha_dash_arc(Q+1); // index 0...Q
-  Matrix<double> beta_dash(N+1, Q+1); // index (1...N, 0...Q)
-  Vector<double> beta_dash_arc(Q+1); // index 0...Q
-  std::vector<char> b_arc(Q+1); // integer in {1,2,3}; index 1...Q
-  std::vector<map<int32, double> > gamma(Q+1); // temp. form of gamma.
-  // index 1...Q [word] -> occ.
-
-  // The tau maps below are the sums over arcs with the same word label
-  // of the tau_b and tau_e timing quantities mentioned in Appendix C of
-  // the paper... we are using these to get averaged times for both the
-  // the sausage bins and the 1-best output.
-  std::vector<map<int32, double> > tau_b(Q+1), tau_e(Q+1);
+  // The work space is kept between iterations, so it is only allocated once
+  // (Resize() just zeroes it if the size has not changed; Q can only shrink).
+  Vector<double> &alpha = alpha_; // index (1...N)
+  Matrix<double> &alpha_dash = alpha_dash_; // index (1...N, 0...Q)
+  Vector<double> &alpha_dash_arc = alpha_dash_arc_; // index 0...Q
+  Matrix<double> &beta_dash = beta_dash_; // index (1...N, 0...Q)
+  Vector<double> &beta_dash_arc = beta_dash_arc_; // index 0...Q
+  alpha.Resize(N+1);
+  alpha_dash.Resize(N+1, Q+1);
+  alpha_dash_arc.Resize(Q+1);
+  beta_dash.Resize(N+1, Q+1);
+  beta_dash_arc.Resize(Q+1);
+  std::vector<char> &b_arc = b_arc_; // integer in {1,2,3}; index 1...Q
+  b_arc.resize(Q+1);
+  // Temp. form of gamma: index 1...Q, and a list of (word, occ.) in each bin.
+  // The stats also contain the sums over arcs with the same word label of the
+  // tau_b and tau_e timing quantities mentioned in Appendix C of the
+  // paper... we are using these to get averaged times for both the the
+  // sausage bins and the 1-best output.
+  std::vector<std::vector<GammaEntry> > &gamma = gamma_stats_;
+  if (static_cast<int32>(gamma.size()) < Q+1)
+    gamma.resize(Q+1);
+  for (int32 q = 1; q <= Q; q++)
+    gamma[q].clear();
 
   double Ltmp = EditDistance(N, Q, alpha, alpha_dash, alpha_dash_arc);
   if (L_ != 0 && Ltmp > L_) { // L_ != 0 is to rule out 1st iter.
@@ -197,108 +233,107 @@ void MinimumBayesRisk::AccStats() {
   KALDI_VLOG(2) << "L = " << L_;
   // omit line 10: zero when initialized.
   beta_dash(N, Q) = 1.0; // Line 11.
+  double *arc_data = alpha_dash_arc.Data(),
+      *beta_arc_data = beta_dash_arc.Data();
   for (int32 n = N; n >= 2; n--) {
-    for (size_t i = 0; i < pre_[n].size(); i++) {
-      const Arc &arc = arcs_[pre_[n][i]];
+    const double *beta_row = beta_dash.RowData(n);
+    for (int32 i = pre_begin_[n]; i < pre_begin_[n + 1]; i++) {
+      const Arc &arc = arcs_[i];
       int32 s_a = arc.start_node, w_a = arc.word;
       BaseFloat p_a = arc.loglike;
-      alpha_dash_arc(0) = alpha_dash(s_a, 0) + l(w_a, 0, true); // line 14.
+      const double *prev_row = alpha_dash.RowData(s_a);
+      double *prev_beta_row = beta_dash.RowData(s_a);
+      double del_cost = l(w_a, 0, true);
+      arc_data[0] = prev_row[0] + del_cost; // line 14.
       for (int32 q = 1; q <= Q; q++) { // this loop == lines 15-18.
-        int32 r_q = r(q);
-        double a1 = alpha_dash(s_a, q-1) + l(w_a, r_q),
-            a2 = alpha_dash(s_a, q) + l(w_a, 0, true),
-            a3 = alpha_dash_arc(q-1) + l(0, r_q);
+        double a1 = prev_row[q-1] + l(w_a, r(q)),
+            a2 = prev_row[q] + del_cost,
+            a3 = arc_data[q-1] + ins_cost_[q];
         if (a1 <= a2) {
-          if (a1 <= a3) { b_arc[q] = 1; alpha_dash_arc(q) = a1; }
-          else { b_arc[q] = 3; alpha_dash_arc(q) = a3; }
+          if (a1 <= a3) { b_arc[q] = 1; arc_data[q] = a1; }
+          else { b_arc[q] = 3; arc_data[q] = a3; }
         } else {
-          if (a2 <= a3) { b_arc[q] = 2; alpha_dash_arc(q) = a2; }
-          else { b_arc[q] = 3; alpha_dash_arc(q) = a3; }
+          if (a2 <= a3) { b_arc[q] = 2; arc_data[q] = a2; }
+          else { b_arc[q] = 3; arc_data[q] = a3; }
         }
       }
       beta_dash_arc.SetZero(); // line 19.
+      double arc_post = Exp(alpha(s_a) + p_a - alpha(n));
       for (int32 q = Q; q >= 1; q--) {
         // line 21:
-        beta_dash_arc(q) += Exp(alpha(s_a) + p_a - alpha(n)) * beta_dash(n, q);
+        beta_arc_data[q] += arc_post * beta_row[q];
         switch (static_cast<int>(b_arc[q])) { // lines 22 and 23:
           case 1:
-            beta_dash(s_a, q-1) += beta_dash_arc(q);
-            // next: gamma(q, w(a)) += beta_dash_arc(q)
-            AddToMap(w_a, beta_dash_arc(q), &(gamma[q]));
-            // next: accumulating times, see decl for tau_b,tau_e
-            AddToMap(w_a, state_times_[s_a] * beta_dash_arc(q), &(tau_b[q]));
-            AddToMap(w_a, state_times_[n] * beta_dash_arc(q), &(tau_e[q]));
+            prev_beta_row[q-1] += beta_arc_data[q];
+            // next: gamma(q, w(a)) += beta_dash_arc(q), and accumulate the
+            // times, see above.
+            AddToStats(w_a, beta_arc_data[q],
+                       state_times_[s_a] * beta_arc_data[q],
+                       state_times_[n] * beta_arc_data[q], &(gamma[q]));
             break;
           case 2:
-            beta_dash(s_a, q) += beta_dash_arc(q);
+            prev_beta_row[q] += beta_arc_data[q];
             break;
           case 3:
-            beta_dash_arc(q-1) += beta_dash_arc(q);
-            // next: gamma(q, epsilon) += beta_dash_arc(q)
-            AddToMap(0, beta_dash_arc(q), &(gamma[q]));
-            // next: accumulating times, see decl for tau_b,tau_e
+            beta_arc_data[q-1] += beta_arc_data[q];
+            // next: gamma(q, epsilon) += beta_dash_arc(q), and the times.
             // WARNING: there was an error in Appendix C.  If we followed
-            // the instructions there the next line would say state_times_[sa], but
-            // it would be wrong.  I will try to publish an erratum.
-            AddToMap(0, state_times_[n] * beta_dash_arc(q), &(tau_b[q]));
-            AddToMap(0, state_times_[n] * beta_dash_arc(q), &(tau_e[q]));
+            // the instructions there the tau_b term would use
+            // state_times_[sa], but it would be wrong.  I will try to publish
+            // an erratum.
+            AddToStats(0, beta_arc_data[q],
+                       state_times_[n] * beta_arc_data[q],
+                       state_times_[n] * beta_arc_data[q], &(gamma[q]));
             break;
           default:
             KALDI_ERR << "Invalid b_arc value"; // error in code.
         }
       }
-      beta_dash_arc(0) += Exp(alpha(s_a) + p_a - alpha(n)) * beta_dash(n, 0);
-      beta_dash(s_a, 0) += beta_dash_arc(0); // line 26.
+      beta_arc_data[0] += arc_post * beta_row[0];
+      prev_beta_row[0] += beta_arc_data[0]; // line 26.
     }
   }
   beta_dash_arc.SetZero(); // line 29.
   for (int32 q = Q; q >= 1; q--) {
     beta_dash_arc(q) += beta_dash(1, q);
     beta_dash_arc(q-1) += beta_dash_arc(q);
-    AddToMap(0, beta_dash_arc(q), &(gamma[q]));
-    // the statements below are actually redundant because
-    // state_times_[1] is zero.
-    AddToMap(0, state_times_[1] * beta_dash_arc(q), &(tau_b[q]));
-    AddToMap(0, state_times_[1] * beta_dash_arc(q), &(tau_e[q]));
+    // the times are actually redundant because state_times_[1] is zero.
+    AddToStats(0, beta_dash_arc(q), state_times_[1] * beta_dash_arc(q),
+               state_times_[1] * beta_dash_arc(q), &(gamma[q]));
   }
   for (int32 q = 1; q <= Q; q++) { // a check (line 35)
     double sum = 0.0;
-    for (map<int32, double>::iterator iter = gamma[q].begin();
-         iter != gamma[q].end(); ++iter) sum += iter->second;
+    for (size_t i = 0; i < gamma[q].size(); i++)
+      sum += gamma[q][i].gamma;
     if (fabs(sum - 1.0) > 0.1)
       KALDI_WARN << "sum of gamma[" << q << ",s] is " << sum;
   }
   // The next part is where we take gamma, and convert
   // to the class member gamma_, which is using a different
   // data structure and indexed from zero, not one.
-  gamma_.clear();
-  gamma_.resize(Q);
-  for (int32 q = 1; q <= Q; q++) {
-    for (map<int32, double>::iterator iter = gamma[q].begin();
-         iter != gamma[q].end(); ++iter)
-      gamma_[q-1].push_back(
-          std::make_pair(iter->first, static_cast<BaseFloat>(iter->second)));
-    // sort gamma_[q-1] from largest to smallest posterior.
-    GammaCompare comp;
-    std::sort(gamma_[q-1].begin(), gamma_[q-1].end(), comp);
-  }
   // We do the same conversion for the state times tau_b and tau_e:
   // they get turned into the times_ data member, which has zero-based
   // indexing.
-  times_.clear();
+  gamma_.resize(Q);
   times_.resize(Q);
   sausage_times_.clear();
   sausage_times_.resize(Q);
+  GammaEntryCompare comp;
   for (int32 q = 1; q <= Q; q++) {
+    // sort from largest to smallest posterior.
+    std::vector<GammaEntry> &this_gamma = gamma[q];
+    std::sort(this_gamma.begin(), this_gamma.end(), comp);
+    gamma_[q-1].resize(this_gamma.size());
+    times_[q-1].resize(this_gamma.size());
     double t_b = 0.0, t_e = 0.0;
-    for (std::vector<std::pair<int32, BaseFloat>>::iterator iter = gamma_[q-1].begin();
-         iter != gamma_[q-1].end(); ++iter) {
-      double w_b = tau_b[q][iter->first], w_e = tau_e[q][iter->first];
+    for (size_t i = 0; i < this_gamma.size(); i++) {
+      BaseFloat post = static_cast<BaseFloat>(this_gamma[i].gamma);
+      gamma_[q-1][i] = std::make_pair(this_gamma[i].word, post);
+      double w_b = this_gamma[i].tau_b, w_e = this_gamma[i].tau_e;
       if (w_b > w_e)
         KALDI_WARN << "Times out of order";  // this is quite bad.
-      times_[q-1].push_back(
-          std::make_pair(static_cast<BaseFloat>(w_b / iter->second),
-                         static_cast<BaseFloat>(w_e / iter->second)));
+      times_[q-1][i] = std::make_pair(static_cast<BaseFloat>(w_b / post),
+                                      static_cast<BaseFloat>(w_e / post));
       t_b += w_b;
       t_e += w_e;
     }
@@ -337,12 +372,12 @@ void MinimumBayesRisk::PrepareLatticeAndInitStats(CompactLattice *clat) {
     state_times_[i] = state_times_[i-1];
 
   // Now we convert the information in "clat" into a special internal
-  // format (pre_, post_ and arcs_) which allows us to access the
+  // format (pre_begin_ and arcs_) which allows us to access the
   // arcs preceding any given state.
   // Note: in our internal format the states will be numbered from 1,
   // which involves adding 1 to the OpenFst states.
   int32 N = clat->NumStates();
-  pre_.resize(N+1);
+  std::vector<Arc> arcs;
 
   // Careful: "Arc" is a class-member struct, not an OpenFst type of arc as one
   // would normally assume.
@@ -359,11 +394,22 @@ void MinimumBayesRisk::PrepareLatticeAndInitStats(CompactLattice *clat) {
                        carc.weight.Weight().Value2());
       // loglike: sum graph/LM and acoustic cost, and negate to
       // convert to loglikes.  We assume acoustic scaling is already done.
-
-      pre_[arc.end_node].push_back(arcs_.size()); // record index of this arc.
-      arcs_.push_back(arc);
+      arcs.push_back(arc);
     }
   }
+  // Sort the arcs by end node (a counting sort, which keeps the order of the
+  // arcs entering each node), so that the arcs entering each node are
+  // contiguous.
+  pre_begin_.clear();
+  pre_begin_.resize(N+2, 0);
+  for (size_t i = 0; i < arcs.size(); i++)
+    pre_begin_[arcs[i].end_node + 1]++;
+  for (int32 n = 1; n <= N+1; n++)
+    pre_begin_[n] += pre_begin_[n-1];
+  std::vector<int32> next_pos(pre_begin_.begin(), pre_begin_.end() - 1);
+  arcs_.resize(arcs.size());
+  for (size_t i = 0; i < arcs.size(); i++)
+    arcs_[next_pos[arcs[i].end_node]++] = arcs[i];
 }
 
 MinimumBayesRisk::MinimumBayesRisk(const CompactLattice &clat_in,
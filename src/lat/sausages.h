@@ -188,14 +188,20 @@ class MinimumBayesRisk {
   static inline BaseFloat delta() { return 1.0e-05; }
 
 
-  /// Function used to increment map.
-  static inline void AddToMap(int32 i, double d, std::map<int32, double> *gamma) {
-    if (d == 0) return;
-    std::pair<const int32, double> pr(i, d);
-    std::pair<std::map<int32, double>::iterator, bool> ret = gamma->insert(pr);
-    if (!ret.second) // not inserted, so add to contents.
-      ret.first->second += d;
-  }
+  /// The stats that AccStats() accumulates for one word in one bin: the
+  /// posterior and the sums of tau_b and tau_e weighted by it.
+  struct GammaEntry {
+    int32 word;
+    double gamma;
+    double tau_b;
+    double tau_e;
+  };
+
+  /// Function used to increment the stats of 'word' in one bin (does nothing
+  /// if gamma is zero).
+  static inline void AddToStats(int32 word, double gamma,
+                                double tau_b, double tau_e,
+                                std::vector<GammaEntry> *stats);
 
   struct Arc {
     int32 word;
@@ -212,12 +218,13 @@ class MinimumBayesRisk {
   /// negated cost).  Indexed from zero.
   std::vector<Arc> arcs_;
 
-  /// For each node in the lattice, a list of arcs entering that node. Indexed
-  /// from 1 (first node == 1).
-  std::vector<std::vector<int32> > pre_;
+  /// arcs_ is sorted on end_node; the arcs entering node n are arcs_[i] for
+  /// pre_begin_[n] <= i < pre_begin_[n+1].  Indexed from 1 (first node == 1),
+  /// and has N+2 elements.
+  std::vector<int32> pre_begin_;
 
   std::vector<int32> state_times_; // time of each state in the word lattice,
-  // indexed from 1 (same index as into pre_)
+  // indexed from 1 (same index as into pre_begin_)
 
   std::vector<int32> R_; // current 1-best word sequence, normalized to have
   // epsilons between each word and at the beginning and end.  R in paper...
@@ -252,15 +259,28 @@ class MinimumBayesRisk {
   // the MAP output if opts_.decode_mbr == false, or the MBR output otherwise).
   // Indexed by the same index as one_best_times_.
 
-  struct GammaCompare{
+  // Work space for EditDistance() and AccStats(), kept as members so that it
+  // is only allocated once, not on each iteration of MbrDecode().  See
+  // AccStats() for their meaning.
+  Vector<double> alpha_;
+  Matrix<double> alpha_dash_;
+  Vector<double> alpha_dash_arc_;
+  Matrix<double> beta_dash_;
+  Vector<double> beta_dash_arc_;
+  std::vector<char> b_arc_;
+  std::vector<double> ins_cost_;  // l(0, r(q)), index 1...Q.
+  std::vector<std::vector<GammaEntry> > gamma_stats_;  // index 1...Q.
+
+  struct GammaEntryCompare {
     // should be like operator <.  But we want reverse order
-    // on the 2nd element (posterior), so it'll be like operator
-    // > that looks first at the posterior.
-    bool operator () (const std::pair<int32, BaseFloat> &a,
-                      const std::pair<int32, BaseFloat> &b) const {
-      if (a.second > b.second) return true;
-      else if (a.second < b.second) return false;
-      else return a.first > b.first;
+    // on the posterior, so it'll be like operator
+    // > that looks first at the posterior (as a BaseFloat, which is how it
+    // is stored in gamma_).
+    bool operator () (const GammaEntry &a, const GammaEntry &b) const {
+      BaseFloat a_gamma = a.gamma, b_gamma = b.gamma;
+      if (a_gamma > b_gamma) return true;
+      else if (a_gamma < b_gamma) return false;
+      else return a.word > b.word;
     }
   };
 };
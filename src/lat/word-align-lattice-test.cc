@@ -0,0 +1,256 @@
+// lat/word-align-lattice-test.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <sstream>
+
+#include "lat/kaldi-lattice.h"
+#include "lat/lattice-functions.h"
+#include "lat/word-align-lattice.h"
+#include "hmm/hmm-test-utils.h"
+#include "hmm/hmm-utils.h"
+
+namespace kaldi {
+
+// Gives each phone a random word-position type, making sure that words can
+// be formed from them, and returns the word-boundary info.  'silence_phones',
+// 'singleton_phones', 'begin_phones', 'internal_phones' and 'end_phones' are
+// output.
+static void GenerateWordBoundaryInfo(const std::vector<int32> &phones,
+                                     std::vector<int32> *silence_phones,
+                                     std::vector<int32> *singleton_phones,
+                                     std::vector<int32> *begin_phones,
+                                     std::vector<int32> *internal_phones,
+                                     std::vector<int32> *end_phones,
+                                     std::string *word_boundary_text) {
+  const char *type_names[] = { "nonword", "singleton", "begin", "internal",
+                               "end" };
+  std::vector<int32> *type_phones[] = { silence_phones, singleton_phones,
+                                        begin_phones, internal_phones,
+                                        end_phones };
+  while (true) {
+    for (int32 i = 0; i < 5; i++)
+      type_phones[i]->clear();
+    std::ostringstream os;
+    for (size_t i = 0; i < phones.size(); i++) {
+      int32 type = RandInt(0, 4);
+      type_phones[type]->push_back(phones[i]);
+      os << phones[i] << ' ' << type_names[type] << '\n';
+    }
+    if (!singleton_phones->empty() ||
+        (!begin_phones->empty() && !end_phones->empty())) {
+      *word_boundary_text = os.str();
+      return;
+    }
+  }
+}
+
+static int32 RandElement(const std::vector<int32> &v) {
+  KALDI_ASSERT(!v.empty());
+  return v[RandInt(0, v.size() - 1)];
+}
+
+// Checks that IncrementalWordAligner, given the arcs of a linear lattice one at
+// a time, gives the same words as WordAlignLattice() followed by
+// CompactLatticeToWordProns().
+void TestIncrementalWordAligner() {
+  ContextDependency *ctx_dep;
+  TransitionModel *trans_model = GenRandTransitionModel(&ctx_dep);
+  std::vector<int32> silence_phones, singleton_phones, begin_phones,
+      internal_phones, end_phones;
+  std::string word_boundary_text;
+  GenerateWordBoundaryInfo(trans_model->GetPhones(), &silence_phones,
+                           &singleton_phones, &begin_phones, &internal_phones,
+                           &end_phones, &word_boundary_text);
+  WordBoundaryInfoNewOpts opts;
+  opts.silence_label = RandInt(0, 1) * 1000;
+  opts.partial_word_label = 1001;
+  opts.reorder = (RandInt(0, 1) == 0);
+  WordBoundaryInfo info(opts);
+  std::istringstream is(word_boundary_text);
+  info.Init(is);
+
+  // Generate a sequence of words and silences.  'phone_word_labels' gives, for
+  // each phone, the label of the word it starts, or 0.
+  std::vector<int32> phone_seq, phone_word_labels, ref_word_seq;
+  int32 num_units = RandInt(1, 6);
+  for (int32 u = 0; u < num_units; u++) {
+    bool can_use_word_phones = !begin_phones.empty() && !end_phones.empty();
+    int32 choice = RandInt(0, 2);
+    if (choice == 0 && !silence_phones.empty()) {
+      phone_seq.push_back(RandElement(silence_phones));
+      phone_word_labels.push_back(0);
+    } else if ((choice == 1 && !singleton_phones.empty()) ||
+               !can_use_word_phones) {
+      int32 word = RandInt(1, 100);
+      phone_seq.push_back(RandElement(singleton_phones));
+      phone_word_labels.push_back(word);
+      ref_word_seq.push_back(word);
+    } else {
+      int32 word = RandInt(1, 100);
+      phone_seq.push_back(RandElement(begin_phones));
+      phone_word_labels.push_back(word);
+      ref_word_seq.push_back(word);
+      int32 num_internal = (internal_phones.empty() ? 0 : RandInt(0, 2));
+      for (int32 i = 0; i < num_internal; i++) {
+        phone_seq.push_back(RandElement(internal_phones));
+        phone_word_labels.push_back(0);
+      }
+      phone_seq.push_back(RandElement(end_phones));
+      phone_word_labels.push_back(0);
+    }
+  }
+
+  std::vector<int32> alignment;
+  GenerateRandomAlignment(*ctx_dep, *trans_model, opts.reorder, phone_seq,
+                          &alignment);
+
+  // Make a linear lattice with one arc per transition-id and the occasional
+  // epsilon arc; each word label goes on the first arc of its word.
+  std::vector<LatticeArc> arcs;
+  std::vector<std::vector<int32> > split_alignment;
+  bool split = SplitToPhones(*trans_model, alignment, &split_alignment);
+  KALDI_ASSERT(split && split_alignment.size() == phone_seq.size());
+  for (size_t p = 0; p < split_alignment.size(); p++) {
+    for (size_t i = 0; i < split_alignment[p].size(); i++) {
+      int32 olabel = (i == 0 ? phone_word_labels[p] : 0);
+      if (RandInt(0, 4) == 0)
+        arcs.push_back(LatticeArc(0, 0, LatticeWeight(RandUniform(),
+                                                      RandUniform()), 0));
+      arcs.push_back(LatticeArc(split_alignment[p][i], olabel,
+                                LatticeWeight(RandUniform(), RandUniform()),
+                                0));
+    }
+  }
+  Lattice lat;
+  lat.AddState();
+  lat.SetStart(0);
+  for (size_t i = 0; i < arcs.size(); i++) {
+    LatticeArc arc(arcs[i]);
+    arc.nextstate = lat.AddState();
+    lat.AddArc(i, arc);
+  }
+  lat.SetFinal(arcs.size(), LatticeWeight::One());
+  CompactLattice clat, aligned_clat;
+  ConvertLattice(lat, &clat);
+
+  bool aligned = WordAlignLattice(clat, *trans_model, info, 0, &aligned_clat);
+  KALDI_ASSERT(aligned);
+  std::vector<int32> words, begin_times, lengths;
+  std::vector<std::vector<int32> > prons, phone_lengths;
+  bool got_prons = CompactLatticeToWordProns(*trans_model, aligned_clat,
+                                             &words, &begin_times, &lengths,
+                                             &prons, &phone_lengths);
+  KALDI_ASSERT(got_prons);
+
+  // Give the arcs to the aligner a piece at a time, getting the words as we
+  // go.  At a random point we copy the aligner, as OnlineWordAligner does for
+  // tentative results, and check that the copy gives the same words.
+  IncrementalWordAligner aligner(*trans_model, info);
+  std::vector<AlignedWord> aligned_words, copy_aligned_words;
+  size_t copy_point = RandInt(0, arcs.size());
+  for (size_t i = 0; i <= arcs.size(); i++) {
+    if (i == copy_point) {
+      IncrementalWordAligner copy(aligner);
+      copy_aligned_words = aligned_words;
+      for (size_t j = i; j < arcs.size(); j++)
+        copy.AcceptArc(arcs[j]);
+      copy.Finish();
+      copy.GetCompleteWords(&copy_aligned_words);
+    }
+    if (i < arcs.size())
+      aligner.AcceptArc(arcs[i]);
+    if (RandInt(0, 3) == 0)
+      aligner.GetCompleteWords(&aligned_words);
+  }
+  aligner.Finish();
+  aligner.GetCompleteWords(&aligned_words);
+  KALDI_ASSERT(aligner.NumFrames() == static_cast<int32>(alignment.size()));
+
+  KALDI_ASSERT(aligned_words.size() == words.size() &&
+               copy_aligned_words.size() == words.size());
+  double total_cost = 0.0;
+  for (size_t i = 0; i < words.size(); i++) {
+    KALDI_ASSERT(aligned_words[i].word == words[i] &&
+                 aligned_words[i].start_frame == begin_times[i] &&
+                 aligned_words[i].num_frames == lengths[i]);
+    KALDI_ASSERT(copy_aligned_words[i].word == words[i] &&
+                 copy_aligned_words[i].start_frame == begin_times[i] &&
+                 copy_aligned_words[i].num_frames == lengths[i]);
+    total_cost += aligned_words[i].cost;
+  }
+  // Stop partway, as at the decoder's immortal point when decoding is not
+  // finished.  The words that are complete by then must be the first words of
+  // the whole path.  After Finish(), so must all but the last word, which may
+  // have been cut off and which ends where we stopped.
+  size_t stop_point = RandInt(0, arcs.size() - 1);
+  IncrementalWordAligner partial_aligner(*trans_model, info);
+  for (size_t i = 0; i < stop_point; i++)
+    partial_aligner.AcceptArc(arcs[i]);
+  std::vector<AlignedWord> partial_words;
+  partial_aligner.GetCompleteWords(&partial_words);
+  KALDI_ASSERT(partial_words.size() <= words.size());
+  for (size_t i = 0; i < partial_words.size(); i++)
+    KALDI_ASSERT(partial_words[i].word == words[i] &&
+                 partial_words[i].start_frame == begin_times[i] &&
+                 partial_words[i].num_frames == lengths[i]);
+  partial_aligner.Finish();
+  partial_aligner.GetCompleteWords(&partial_words);
+  KALDI_ASSERT(partial_words.size() <= words.size());
+  if (!partial_words.empty()) {
+    size_t last = partial_words.size() - 1;
+    for (size_t i = 0; i < last; i++)
+      KALDI_ASSERT(partial_words[i].word == words[i] &&
+                   partial_words[i].start_frame == begin_times[i] &&
+                   partial_words[i].num_frames == lengths[i]);
+    KALDI_ASSERT(partial_words[last].word == words[last] ||
+                 partial_words[last].word == info.partial_word_label);
+    KALDI_ASSERT(partial_words[last].start_frame == begin_times[last] &&
+                 partial_words[last].start_frame +
+                 partial_words[last].num_frames ==
+                 partial_aligner.NumFrames());
+  } else {
+    KALDI_ASSERT(partial_aligner.NumFrames() == 0);
+  }
+
+  // The word labels are never the silence label.
+  std::vector<int32> word_seq;
+  for (size_t i = 0; i < words.size(); i++)
+    if (words[i] != info.silence_label)
+      word_seq.push_back(words[i]);
+  KALDI_ASSERT(word_seq == ref_word_seq);
+
+  // The costs of the arcs are shared out among the words, so their total is
+  // the cost of the path.
+  LatticeWeight path_weight = LatticeWeight::One();
+  for (size_t i = 0; i < arcs.size(); i++)
+    path_weight = Times(path_weight, arcs[i].weight);
+  KALDI_ASSERT(ApproxEqual(total_cost,
+                           path_weight.Value1() + path_weight.Value2()));
+
+  delete ctx_dep;
+  delete trans_model;
+}
+
+}  // namespace kaldi
+
+int main() {
+  for (int32 i = 0; i < 100; i++)
+    kaldi::TestIncrementalWordAligner();
+  KALDI_LOG << "Success.";
+}
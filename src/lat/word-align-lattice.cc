@@ -924,6 +924,184 @@ void TestWordAlignedLattice(const CompactLattice &lat,
 }
 
 
+IncrementalWordAligner::IncrementalWordAligner(const TransitionModel &tmodel,
+                                               const WordBoundaryInfo &info):
+    tmodel_(&tmodel), info_(&info), num_frames_(0), cur_phone_(-1),
+    phone_start_frame_(0), phone_final_(false), phone_cost_(0.0),
+    pending_cost_(0.0), in_word_(false), word_start_frame_(0),
+    word_cost_(0.0), error_(false) { }
+
+void IncrementalWordAligner::Warn(const std::string &msg) {
+  if (!error_)
+    KALDI_WARN << msg;
+  error_ = true;
+}
+
+void IncrementalWordAligner::AcceptArc(const LatticeArc &arc) {
+  BaseFloat cost = arc.weight.Value1() + arc.weight.Value2();
+  if (arc.olabel != 0)
+    word_labels_.push_back(arc.olabel);
+  if (arc.ilabel == 0) {
+    if (cur_phone_ != -1 && !phone_final_)
+      phone_cost_ += cost;
+    else
+      pending_cost_ += cost;
+    Flush();
+    return;
+  }
+  int32 tid = arc.ilabel, phone = tmodel_->TransitionIdToPhone(tid);
+  if (cur_phone_ != -1) {
+    // As in WordAlignLattice(), a phone ends after its final transition-id,
+    // and (if info_->reorder) the self-loops that follow it.
+    if (phone_final_ && !(info_->reorder && tmodel_->IsSelfLoop(tid))) {
+      EndPhone();
+    } else if (phone != cur_phone_) {
+      Warn("Phone changed before final transition-id found "
+           "[broken lattice or mismatched model or wrong --reorder option?]");
+      EndPhone();
+    }
+  }
+  if (cur_phone_ == -1) {
+    cur_phone_ = phone;
+    phone_start_frame_ = num_frames_;
+    phone_final_ = false;
+    phone_cost_ = pending_cost_;
+    pending_cost_ = 0.0;
+  }
+  phone_cost_ += cost;
+  if (tmodel_->IsFinal(tid))
+    phone_final_ = true;
+  num_frames_++;
+  Flush();
+}
+
+void IncrementalWordAligner::EndPhone() {
+  KALDI_ASSERT(cur_phone_ != -1);
+  AlignedWord span;
+  span.start_frame = phone_start_frame_;
+  span.num_frames = num_frames_ - phone_start_frame_;
+  span.cost = phone_cost_;
+  switch (info_->TypeOfPhone(cur_phone_)) {
+    case WordBoundaryInfo::kNoPhone:
+      Warn("Phone " + std::to_string(cur_phone_) + " has no word-boundary "
+           "type; treating it as silence.");
+      // fall through.
+    case WordBoundaryInfo::kNonWordPhone:
+      if (in_word_) {
+        // Silence inside a word (e.g. if silence_may_be_word_internal).
+        word_cost_ += span.cost;
+      } else {
+        span.word = info_->silence_label;
+        pending_spans_.push_back(span);
+      }
+      break;
+    case WordBoundaryInfo::kWordBeginAndEndPhone:
+      if (in_word_) {
+        Warn("Unexpected phone inside a word [bad lattice or word-boundary "
+             "info?]");
+        EndWord();
+      }
+      span.word = -1;
+      pending_spans_.push_back(span);
+      break;
+    case WordBoundaryInfo::kWordBeginPhone:
+      if (in_word_) {
+        Warn("Word began before the previous one ended [bad lattice or "
+             "word-boundary info?]");
+        EndWord();
+      }
+      in_word_ = true;
+      word_start_frame_ = span.start_frame;
+      word_cost_ = span.cost;
+      break;
+    case WordBoundaryInfo::kWordInternalPhone:
+    case WordBoundaryInfo::kWordEndPhone:
+      if (!in_word_) {
+        Warn("Word-internal or word-end phone outside a word [bad lattice or "
+             "word-boundary info?]");
+        in_word_ = true;
+        word_start_frame_ = span.start_frame;
+        word_cost_ = 0.0;
+      }
+      word_cost_ += span.cost;
+      if (info_->TypeOfPhone(cur_phone_) == WordBoundaryInfo::kWordEndPhone)
+        EndWord();
+      break;
+  }
+  cur_phone_ = -1;
+}
+
+void IncrementalWordAligner::EndWord() {
+  KALDI_ASSERT(in_word_);
+  AlignedWord span;
+  span.word = -1;
+  span.start_frame = word_start_frame_;
+  span.num_frames = num_frames_ - word_start_frame_;
+  span.cost = word_cost_;
+  pending_spans_.push_back(span);
+  in_word_ = false;
+}
+
+void IncrementalWordAligner::Flush() {
+  while (!pending_spans_.empty()) {
+    AlignedWord &span = pending_spans_.front();
+    if (span.word == -1) {
+      if (word_labels_.empty())
+        return;
+      span.word = word_labels_.front();
+      word_labels_.pop_front();
+    }
+    complete_words_.push_back(span);
+    pending_spans_.pop_front();
+  }
+}
+
+void IncrementalWordAligner::Finish() {
+  if (cur_phone_ != -1) {
+    if (!phone_final_)
+      Warn("Path ended in the middle of a phone.");
+    EndPhone();
+  }
+  if (!pending_spans_.empty())
+    pending_spans_.back().cost += pending_cost_;
+  else if (!complete_words_.empty())
+    complete_words_.back().cost += pending_cost_;
+  pending_cost_ = 0.0;
+  bool partial_word = in_word_;
+  if (partial_word)
+    EndWord();
+  Flush();
+  if (partial_word) {
+    // As in WordAlignLattice(), a word that was cut off gets the partial-word
+    // label even if we know its label.  It is the last span.
+    if (pending_spans_.empty())
+      complete_words_.back().word = info_->partial_word_label;
+    else
+      pending_spans_.back().word = info_->partial_word_label;
+  }
+  if (!pending_spans_.empty()) {
+    Warn("Words without labels at the end of the path [bad lattice or "
+         "word-boundary info?]");
+    for (; !pending_spans_.empty(); pending_spans_.pop_front()) {
+      if (pending_spans_.front().word == -1)
+        pending_spans_.front().word = info_->partial_word_label;
+      complete_words_.push_back(pending_spans_.front());
+    }
+  }
+  if (!word_labels_.empty()) {
+    Warn("Word labels without phones at the end of the path [bad lattice or "
+         "word-boundary info?]");
+    word_labels_.clear();
+  }
+}
+
+void IncrementalWordAligner::GetCompleteWords(
+    std::vector<AlignedWord> *words) {
+  words->insert(words->end(), complete_words_.begin(), complete_words_.end());
+  complete_words_.clear();
+}
+
+
 
 
 
@@ -22,6 +22,8 @@
 #include <fst/fstlib.h>
 #include <fst/fst-decl.h>
 
+#include <deque>
+
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
 #include "fstext/fstext-lib.h"
@@ -207,5 +209,83 @@ void TestWordAlignedLattice(const CompactLattice &lat,
                             const WordBoundaryInfo &info,
                             const CompactLattice &aligned_lat);
 
+
+/// A word (or a stretch of silence) in the output of class
+/// IncrementalWordAligner.
+struct AlignedWord {
+  int32 word;  // The word label; info.silence_label for silence and other
+               // non-word phones, and info.partial_word_label for a word that
+               // was cut off by Finish() or whose label was missing.
+  int32 start_frame;
+  int32 num_frames;
+  BaseFloat cost;  // Total (graph + acoustic) cost of the word's arcs.
+  AlignedWord(): word(0), start_frame(0), num_frames(0), cost(0.0) { }
+};
+
+/// IncrementalWordAligner works out word boundaries from a single path (e.g.
+/// the best path of a decoder, as given by
+/// LatticeFasterOnlineDecoder::TraceBackBestPath()), one arc at a time, using
+/// the same rules as WordAlignLattice().  It outputs each word as soon as it
+/// knows where the word ends, so an online decoder can align the part of the
+/// best path that can no longer change just once, instead of re-aligning the
+/// whole best path each time (see class OnlineWordAligner).
+/// The object may be copied, e.g. to align a tentative continuation of the
+/// path and then throw it away; the TransitionModel and WordBoundaryInfo must
+/// outlive it and its copies.
+class IncrementalWordAligner {
+ public:
+  IncrementalWordAligner(const TransitionModel &tmodel,
+                         const WordBoundaryInfo &info);
+
+  /// Accepts the next arc of the path.  Its ilabel is a transition-id or zero,
+  /// and its olabel a word or zero.
+  void AcceptArc(const LatticeArc &arc);
+
+  /// Call this at the end of the path; it outputs whatever has not been output
+  /// yet, treating a word that has not ended as a partial word.
+  void Finish();
+
+  /// Appends to 'words' the words that are complete (i.e. that have ended and
+  /// whose labels we know) and have not been output before.
+  void GetCompleteWords(std::vector<AlignedWord> *words);
+
+  /// The number of frames (transition-ids) accepted so far.
+  int32 NumFrames() const { return num_frames_; }
+
+ private:
+  // Called when the phone that started at frame phone_start_frame_ ends at
+  // frame num_frames_.
+  void EndPhone();
+  // Closes the word that started at frame word_start_frame_.
+  void EndWord();
+  // Moves spans from pending_spans_ to complete_words_ while we know their
+  // labels.
+  void Flush();
+  void Warn(const std::string &msg);
+
+  // Pointers rather than references so that the object can be assigned.
+  const TransitionModel *tmodel_;
+  const WordBoundaryInfo *info_;
+  int32 num_frames_;
+
+  int32 cur_phone_;  // The phone we are in, or -1 if we are between phones.
+  int32 phone_start_frame_;
+  bool phone_final_;  // True if we have seen the final transition of the phone.
+  BaseFloat phone_cost_;
+  BaseFloat pending_cost_;  // Cost of epsilon arcs after the last phone ended.
+
+  bool in_word_;
+  int32 word_start_frame_;
+  BaseFloat word_cost_;
+
+  // Words and silences in the order they appear; a word whose label we don't
+  // know yet has word == -1.
+  std::deque<AlignedWord> pending_spans_;
+  // Word labels that we have seen and not yet assigned to a word.
+  std::deque<int32> word_labels_;
+  std::vector<AlignedWord> complete_words_;
+  bool error_;  // We only warn about the first error.
+};
+
 } // end namespace kaldi
 #endif
@@ -22,6 +22,7 @@
 #include "base/kaldi-common.h"
 #include "fstext/fstext-lib.h"
 #include "rnnlm/rnnlm-lattice-rescoring.h"
+#include "rnnlm/sampling-lm.h"
 #include "lm/const-arpa-lm.h"
 #include "util/common-utils.h"
 #include "nnet3/nnet-utils.h"
@@ -62,6 +63,8 @@ int main(int argc, char *argv[]) {
     ComposeLatticePrunedOptions compose_opts;
 
     int32 max_ngram_order = 3;
+    std::string sampling_lm_rxfilename;
+    int32 rnnlm_cache_size = 0;
     BaseFloat lm_scale = 0.5;
     BaseFloat acoustic_scale = 0.1;
     bool use_carpa = false;
@@ -78,6 +81,18 @@ int main(int argc, char *argv[]) {
     po.Register("use-const-arpa", &use_carpa, "If true, read the old-LM file "
                 "as a const-arpa file as opposed to an FST file");
 
+    po.Register("sampling-lm", &sampling_lm_rxfilename, "If set, a sampling "
+                "LM as written by rnnlm-get-sampling-lm, whose unigram "
+                "distribution is used to approximate the normalizer if "
+                "--normalize-probs=true (see --normalization-shortlist and "
+                "--normalization-samples).  This is much faster for large "
+                "vocabularies.");
+    po.Register("rnnlm-cache-size", &rnnlm_cache_size, "If positive, the "
+                "number of RNNLM states to keep in a cache that persists "
+                "across lattices, so that histories that were seen in earlier "
+                "lattices are not evaluated again.  Note: with "
+                "--max-ngram-order, the scores then depend on the order in "
+                "which the lattices are processed.");
     opts.Register(&po);
     compose_opts.Register(&po);
 
@@ -113,7 +128,7 @@ int main(int argc, char *argv[]) {
     KALDI_LOG << "Reading old LMs...";
     if (use_carpa) {
       const_arpa = new ConstArpaLm();
-      ReadKaldiObject(lm_to_subtract_rxfilename, const_arpa);
+      ReadConstArpaLm(lm_to_subtract_rxfilename, const_arpa);
       carpa_lm_to_subtract_fst = new ConstArpaLmDeterministicFst(*const_arpa);
       lm_to_subtract_det_scale
         = new fst::ScaleDeterministicOnDemandFst(-lm_scale,
@@ -136,7 +151,15 @@ int main(int argc, char *argv[]) {
     CuMatrix<BaseFloat> word_embedding_mat;
     ReadKaldiObject(word_embedding_rxfilename, &word_embedding_mat);
 
-    const rnnlm::RnnlmComputeStateInfo info(opts, rnnlm, word_embedding_mat);
+    rnnlm::RnnlmComputeStateInfo info(opts, rnnlm, word_embedding_mat);
+    if (!sampling_lm_rxfilename.empty()) {
+      rnnlm::SamplingLm sampling_lm;
+      ReadKaldiObject(sampling_lm_rxfilename, &sampling_lm);
+      info.InitApproximateNormalization(sampling_lm.GetUnigramDistribution());
+    }
+    rnnlm::RnnlmComputeStateCache *rnnlm_cache = NULL;
+    if (rnnlm_cache_size > 0)
+      rnnlm_cache = new rnnlm::RnnlmComputeStateCache(rnnlm_cache_size);
 
     // Reads and writes as compact lattice.
     SequentialCompactLatticeReader compact_lattice_reader(lats_rspecifier);
@@ -145,7 +168,8 @@ int main(int argc, char *argv[]) {
     int32 num_done = 0, num_err = 0;
 
     rnnlm::KaldiRnnlmDeterministicFst* lm_to_add_orig = 
-         new rnnlm::KaldiRnnlmDeterministicFst(max_ngram_order, info);
+         new rnnlm::KaldiRnnlmDeterministicFst(max_ngram_order, info,
+                                                rnnlm_cache);
 
     for (; !compact_lattice_reader.Done(); compact_lattice_reader.Next()) {
       fst::DeterministicOnDemandFst<StdArc> *lm_to_add =
@@ -193,6 +217,7 @@ int main(int argc, char *argv[]) {
 
     delete lm_to_subtract_fst;
     delete lm_to_add_orig;
+    delete rnnlm_cache;
     delete lm_to_subtract_det_backoff;
     delete lm_to_subtract_det_scale;
 
@@ -25,6 +25,7 @@
 #include "lat/kaldi-lattice.h"
 #include "lat/lattice-functions.h"
 #include "rnnlm/rnnlm-lattice-rescoring.h"
+#include "rnnlm/sampling-lm.h"
 #include "util/common-utils.h"
 #include "nnet3/nnet-utils.h"
 
@@ -51,6 +52,8 @@ int main(int argc, char *argv[]) {
     rnnlm::RnnlmComputeStateComputationOptions opts;
 
     int32 max_ngram_order = 3;
+    std::string sampling_lm_rxfilename;
+    int32 rnnlm_cache_size = 0;
     BaseFloat lm_scale = 1.0;
 
     po.Register("lm-scale", &lm_scale, "Scaling factor for language model "
@@ -59,6 +62,18 @@ int main(int argc, char *argv[]) {
         "If positive, allow RNNLM histories longer than this to be identified "
         "with each other for rescoring purposes (an approximation that "
         "saves time and reduces output lattice size).");
+    po.Register("sampling-lm", &sampling_lm_rxfilename, "If set, a sampling "
+                "LM as written by rnnlm-get-sampling-lm, whose unigram "
+                "distribution is used to approximate the normalizer if "
+                "--normalize-probs=true (see --normalization-shortlist and "
+                "--normalization-samples).  This is much faster for large "
+                "vocabularies.");
+    po.Register("rnnlm-cache-size", &rnnlm_cache_size, "If positive, the "
+                "number of RNNLM states to keep in a cache that persists "
+                "across lattices, so that histories that were seen in earlier "
+                "lattices are not evaluated again.  Note: with "
+                "--max-ngram-order, the scores then depend on the order in "
+                "which the lattices are processed.");
     opts.Register(&po);
 
     po.Read(argc, argv);
@@ -85,7 +100,15 @@ int main(int argc, char *argv[]) {
     CuMatrix<BaseFloat> word_embedding_mat;
     ReadKaldiObject(word_embedding_rxfilename, &word_embedding_mat);
 
-    const rnnlm::RnnlmComputeStateInfo info(opts, rnnlm, word_embedding_mat);
+    rnnlm::RnnlmComputeStateInfo info(opts, rnnlm, word_embedding_mat);
+    if (!sampling_lm_rxfilename.empty()) {
+      rnnlm::SamplingLm sampling_lm;
+      ReadKaldiObject(sampling_lm_rxfilename, &sampling_lm);
+      info.InitApproximateNormalization(sampling_lm.GetUnigramDistribution());
+    }
+    rnnlm::RnnlmComputeStateCache *rnnlm_cache = NULL;
+    if (rnnlm_cache_size > 0)
+      rnnlm_cache = new rnnlm::RnnlmComputeStateCache(rnnlm_cache_size);
 
     // Reads and writes as compact lattice.
     SequentialCompactLatticeReader compact_lattice_reader(lats_rspecifier);
@@ -93,7 +116,8 @@ int main(int argc, char *argv[]) {
 
     int32 n_done = 0, n_fail = 0;
 
-    rnnlm::KaldiRnnlmDeterministicFst rnnlm_fst(max_ngram_order, info);
+    rnnlm::KaldiRnnlmDeterministicFst rnnlm_fst(max_ngram_order, info,
+                                                rnnlm_cache);
 
     for (; !compact_lattice_reader.Done(); compact_lattice_reader.Next()) {
       std::string key = compact_lattice_reader.Key();
@@ -137,6 +161,7 @@ int main(int argc, char *argv[]) {
       }
       rnnlm_fst.Clear();
     }
+    delete rnnlm_cache;
 
     KALDI_LOG << "Done " << n_done << " lattices, failed for " << n_fail;
     return (n_done != 0 ? 0 : 1);
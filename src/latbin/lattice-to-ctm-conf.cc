@@ -21,8 +21,85 @@
 #include "util/common-utils.h"
 #include "util/kaldi-table.h"
 #include "lat/sausages.h"
+#include "util/kaldi-thread.h"
 #include <numeric>
 
+namespace kaldi {
+
+// Does the MBR computation for one utterance; the destructor writes the ctm
+// lines, so they come out in the order of the input when several of these are
+// run in parallel by class TaskSequencer.
+class LatticeToCtmConfTask {
+ public:
+  // 'one_best' and 'times' may be empty, meaning we use the 1-best of the
+  // lattice and the times from the lattice respectively.
+  LatticeToCtmConfTask(const MinimumBayesRiskOptions &mbr_opts,
+                       BaseFloat frame_shift,
+                       const std::string &key,
+                       const CompactLattice &clat,
+                       const std::vector<int32> *one_best,
+                       const std::vector<std::pair<BaseFloat,BaseFloat> > *times,
+                       std::ostream *os,
+                       int32 *n_done, int32 *n_words,
+                       BaseFloat *tot_bayes_risk):
+      mbr_opts_(mbr_opts), frame_shift_(frame_shift), key_(key), clat_(clat),
+      have_one_best_(one_best != NULL), have_times_(times != NULL),
+      mbr_(NULL), os_(os), n_done_(n_done), n_words_(n_words),
+      tot_bayes_risk_(tot_bayes_risk) {
+    if (one_best != NULL) one_best_ = *one_best;
+    if (times != NULL) times_ = *times;
+  }
+
+  void operator () () {
+    if (!have_one_best_) {
+      mbr_ = new MinimumBayesRisk(clat_, mbr_opts_);
+    } else if (!have_times_) {
+      mbr_ = new MinimumBayesRisk(clat_, one_best_, mbr_opts_); // no 'times',
+    } else {
+      // with initial 'times' of the bins,
+      mbr_ = new MinimumBayesRisk(clat_, one_best_, times_, mbr_opts_);
+    }
+  }
+
+  ~LatticeToCtmConfTask() {
+    const std::vector<BaseFloat> &conf = mbr_->GetOneBestConfidences();
+    const std::vector<int32> &words = mbr_->GetOneBest();
+    const std::vector<std::pair<BaseFloat, BaseFloat> > &times =
+        mbr_->GetOneBestTimes();
+    KALDI_ASSERT(conf.size() == words.size() && words.size() == times.size());
+    for (size_t i = 0; i < words.size(); i++) {
+      KALDI_ASSERT(words[i] != 0 || mbr_opts_.print_silence); // Should not have epsilons.
+      (*os_) << key_ << " 1 " << (frame_shift_ * times[i].first) << ' '
+             << (frame_shift_ * (times[i].second-times[i].first)) << ' '
+             << words[i] << ' ' << conf[i] << '\n';
+    }
+    KALDI_LOG << "For utterance " << key_ << ", Bayes Risk "
+              << mbr_->GetBayesRisk() << ", avg. confidence per-word "
+              << std::accumulate(conf.begin(),conf.end(),0.0) / words.size();
+    (*n_done_)++;
+    (*n_words_) += mbr_->GetOneBest().size();
+    (*tot_bayes_risk_) += mbr_->GetBayesRisk();
+    delete mbr_;
+  }
+
+ private:
+  const MinimumBayesRiskOptions &mbr_opts_;
+  BaseFloat frame_shift_;
+  std::string key_;
+  CompactLattice clat_;
+  bool have_one_best_;
+  std::vector<int32> one_best_;
+  bool have_times_;
+  std::vector<std::pair<BaseFloat,BaseFloat> > times_;
+  MinimumBayesRisk *mbr_;
+  std::ostream *os_;
+  int32 *n_done_;
+  int32 *n_words_;
+  BaseFloat *tot_bayes_risk_;
+};
+
+}  // namespace kaldi
+
 int main(int argc, char *argv[]) {
   try {
     using namespace kaldi;
@@ -54,6 +131,8 @@ int main(int argc, char *argv[]) {
         " e.g.: lattice-to-ctm-conf --acoustic-scale=0.1 ark:1.lats 1.ctm\n"
         "   or: lattice-to-ctm-conf --acoustic-scale=0.1 --decode-mbr=false\\\n"
         "                                      ark:1.lats ark:1.1best 1.ctm\n"
+        "With --num-threads > 1, several utterances are processed in parallel\n"
+        "(the output is the same).\n"
         "See also: lattice-mbr-decode, nbest-to-ctm, lattice-arc-post,\n"
         " steps/get_ctm.sh, steps/get_train_ctm.sh and utils/convert_ctm.pl.\n";
 
@@ -75,6 +154,8 @@ int main(int argc, char *argv[]) {
 
     MinimumBayesRiskOptions mbr_opts;
     mbr_opts.Register(&po);
+    TaskSequencerConfig sequencer_config; // has --num-threads option
+    sequencer_config.Register(&po);
 
     po.Read(argc, argv);
 
@@ -129,56 +210,37 @@ int main(int argc, char *argv[]) {
     int32 n_done = 0, n_words = 0;
     BaseFloat tot_bayes_risk = 0.0;
 
-    for (; !clat_reader.Done(); clat_reader.Next()) {
-      std::string key = clat_reader.Key();
-      CompactLattice clat = clat_reader.Value();
-      clat_reader.FreeCurrent();
-      fst::ScaleLattice(fst::LatticeScale(lm_scale, acoustic_scale), &clat);
-
-      MinimumBayesRisk *mbr = NULL;
-
-      if (one_best_rspecifier == "") {
-        mbr = new MinimumBayesRisk(clat, mbr_opts);
-      } else {
-        // check,
-        if (!one_best_reader.HasKey(key)) {
-          KALDI_WARN << "No 1-best present for utterance " << key;
-          continue;
-        }
-        if (times_rspecifier != "" && !times_reader.HasKey(key)) {
-          KALDI_WARN << "No 'times' present for utterance " << key;
-          continue;
-        }
-        // get the 'mbr' decoding object,
-        if (times_rspecifier == "") {
-          const std::vector<int32> &one_best = one_best_reader.Value(key);
-          mbr = new MinimumBayesRisk(clat, one_best, mbr_opts); // no 'times',
-        } else {
-          // with initial 'times' of the bins,
-          const std::vector<int32> &one_best = one_best_reader.Value(key);
-          const std::vector<std::pair<BaseFloat,BaseFloat> > &times = times_reader.Value(key);
-          mbr = new MinimumBayesRisk(clat, one_best, times, mbr_opts);
-        }
-      }
+    {
+      TaskSequencer<LatticeToCtmConfTask> sequencer(sequencer_config);
+      for (; !clat_reader.Done(); clat_reader.Next()) {
+        std::string key = clat_reader.Key();
+        CompactLattice clat = clat_reader.Value();
+        clat_reader.FreeCurrent();
+        fst::ScaleLattice(fst::LatticeScale(lm_scale, acoustic_scale), &clat);
 
-      const std::vector<BaseFloat> &conf = mbr->GetOneBestConfidences();
-      const std::vector<int32> &words = mbr->GetOneBest();
-      const std::vector<std::pair<BaseFloat, BaseFloat> > &times =
-          mbr->GetOneBestTimes();
-      KALDI_ASSERT(conf.size() == words.size() && words.size() == times.size());
-      for (size_t i = 0; i < words.size(); i++) {
-        KALDI_ASSERT(words[i] != 0 || mbr_opts.print_silence); // Should not have epsilons.
-        ko.Stream() << key << " 1 " << (frame_shift * times[i].first) << ' '
-                    << (frame_shift * (times[i].second-times[i].first)) << ' '
-                    << words[i] << ' ' << conf[i] << '\n';
+        const std::vector<int32> *one_best = NULL;
+        const std::vector<std::pair<BaseFloat,BaseFloat> > *times = NULL;
+        if (one_best_rspecifier != "") {
+          // check,
+          if (!one_best_reader.HasKey(key)) {
+            KALDI_WARN << "No 1-best present for utterance " << key;
+            continue;
+          }
+          if (times_rspecifier != "" && !times_reader.HasKey(key)) {
+            KALDI_WARN << "No 'times' present for utterance " << key;
+            continue;
+          }
+          one_best = &(one_best_reader.Value(key));
+          if (times_rspecifier != "")
+            times = &(times_reader.Value(key));
+        }
+        // The task copies what it needs, and runs the MBR decoding.
+        sequencer.Run(new LatticeToCtmConfTask(mbr_opts, frame_shift, key, clat,
+                                               one_best, times, &(ko.Stream()),
+                                               &n_done, &n_words,
+                                               &tot_bayes_risk));
       }
-      KALDI_LOG << "For utterance " << key << ", Bayes Risk "
-                << mbr->GetBayesRisk() << ", avg. confidence per-word "
-                << std::accumulate(conf.begin(),conf.end(),0.0) / words.size();
-      n_done++;
-      n_words += mbr->GetOneBest().size();
-      tot_bayes_risk += mbr->GetBayesRisk();
-      delete mbr;
+      sequencer.Wait();
     }
 
     KALDI_LOG << "Done " << n_done << " lattices.";
@@ -22,6 +22,7 @@
  * @brief Unit tests for language model code.
  */
 
+#include <cstdio>
 #include <iomanip>
 #include <iostream>
 #include <string>
@@ -44,6 +45,12 @@ struct NGramTestData {
   float backoff;
 };
 
+bool operator==(const NGramTestData &a, const NGramTestData &b) {
+  return a.line_number == b.line_number && a.logprob == b.logprob &&
+      std::equal(a.words, a.words + kMaxOrder, b.words) &&
+      a.backoff == b.backoff;
+}
+
 std::ostream& operator<<(std::ostream &os, const NGramTestData &data) {
   std::ios::fmtflags saved_state(os.flags());
   os << std::fixed << std::setprecision(6);
@@ -80,6 +87,7 @@ class TestableArpaFileParser : public ArpaFileParser {
         read_complete_(false),
         last_order_(0) { }
   void Validate(CountedArray<int32> counts, CountedArray<NGramTestData> ngrams);
+  const std::vector<NGramTestData> &NGrams() const { return ngrams_; }
 
  private:
   // ArpaFileParser overrides.
@@ -295,13 +303,15 @@ void ReadSymbolicLmNoOovTests() {
 void ReadSymbolicLmWithOovImpl(
     ArpaParseOptions::OovHandling oov,
     CountedArray<NGramTestData> expect_ngrams,
-    fst::SymbolTable* symbols) {
+    fst::SymbolTable* symbols,
+    int32 num_threads = 1) {
   int32 expect_counts[] = { 4, 2, 2 };
   ArpaParseOptions options;
   options.bos_symbol = 1;
   options.eos_symbol = 2;
   options.unk_symbol = 3;
   options.oov_handling = oov;
+  options.num_threads = num_threads;
   TestableArpaFileParser parser(options, symbols);
   std::istringstream stm(symbolic_lm, std::ios_base::in);
   parser.Read(stm);
@@ -317,7 +327,7 @@ void ReadSymbolicLmWithOovAddToSymbols() {
   KALDI_ASSERT(symbols.Find("\xCE\xB2") == 5);
 }
 
-void ReadSymbolicLmWithOovReplaceWithUnk() {
+void ReadSymbolicLmWithOovReplaceWithUnk(int32 num_threads) {
   NGramTestData expect_symbolic_unk_b[] = {
     { 15, -5.2, { 4, 0, 0 }, -3.3 },
     { 16, -3.4, { 3, 0, 0 },  0.0 },
@@ -333,11 +343,11 @@ void ReadSymbolicLmWithOovReplaceWithUnk() {
   TestSymbolTable symbols;
   ReadSymbolicLmWithOovImpl(ArpaParseOptions::kReplaceWithUnk,
                             MakeCountedArray(expect_symbolic_unk_b),
-                            &symbols);
+                            &symbols, num_threads);
   KALDI_ASSERT(symbols.NumSymbols() == 5);
 }
 
-void ReadSymbolicLmWithOovSkipNGram() {
+void ReadSymbolicLmWithOovSkipNGram(int32 num_threads) {
   NGramTestData expect_symbolic_no_b[] = {
     { 15, -5.2, { 4, 0, 0 }, -3.3 },
     { 17,  0.0, { 1, 0, 0 }, -2.5 },
@@ -350,17 +360,119 @@ void ReadSymbolicLmWithOovSkipNGram() {
   TestSymbolTable symbols;
   ReadSymbolicLmWithOovImpl(ArpaParseOptions::kSkipNGram,
                             MakeCountedArray(expect_symbolic_no_b),
-                            &symbols);
+                            &symbols, num_threads);
   KALDI_ASSERT(symbols.NumSymbols() == 5);
 }
 
 void ReadSymbolicLmWithOovTests() {
   KALDI_LOG << "ReadSymbolicLmWithOovAddToSymbols()";
   ReadSymbolicLmWithOovAddToSymbols();
-  KALDI_LOG << "ReadSymbolicLmWithOovReplaceWithUnk()";
-  ReadSymbolicLmWithOovReplaceWithUnk();
-  KALDI_LOG << "ReadSymbolicLmWithOovSkipNGram()";
-  ReadSymbolicLmWithOovSkipNGram();
+  for (int32 num_threads = 1; num_threads <= 2; num_threads++) {
+    KALDI_LOG << "ReadSymbolicLmWithOovReplaceWithUnk(" << num_threads << ")";
+    ReadSymbolicLmWithOovReplaceWithUnk(num_threads);
+    KALDI_LOG << "ReadSymbolicLmWithOovSkipNGram(" << num_threads << ")";
+    ReadSymbolicLmWithOovSkipNGram(num_threads);
+  }
+}
+
+// Reads an integer LM that is large enough to need several batches in
+// multi-threaded mode, and checks that we get the same n-grams, in the same
+// order, as with one thread.
+void ReadIntegerLmMultiThreaded() {
+  KALDI_LOG << "ReadIntegerLmMultiThreaded()";
+  int32 num_words = 30000, num_bigrams = 45000;
+  std::ostringstream os;
+  os << "\\data\\\nngram 1=" << num_words << "\nngram 2=" << num_bigrams
+     << "\n\n\\1-grams:\n";
+  for (int32 w = 1; w <= num_words; w++)
+    os << (-0.001 * w) << "\t" << w << "\t" << (-0.5 * (w % 3)) << "\n";
+  os << "\n\\2-grams:\n";
+  for (int32 i = 0; i < num_bigrams; i++) {
+    os << (-0.01 * (i % 100)) << "\t" << (1 + i % num_words) << " "
+       << (1 + (7 * i) % num_words) << "\n";
+    if (i % 1000 == 0) os << "\n";  // Empty lines are allowed.
+  }
+  os << "\\end\\\n";
+
+  ArpaParseOptions options;
+  options.bos_symbol = 1;
+  options.eos_symbol = 2;
+  TestableArpaFileParser parser(options, NULL);
+  std::istringstream stm(os.str(), std::ios_base::in);
+  parser.Read(stm);
+
+  for (int32 num_threads = 2; num_threads <= 3; num_threads++) {
+    options.num_threads = num_threads;
+    TestableArpaFileParser threaded_parser(options, NULL);
+    std::istringstream stm2(os.str(), std::ios_base::in);
+    threaded_parser.Read(stm2);
+    KALDI_ASSERT(parser.NGrams() == threaded_parser.NGrams());
+  }
+}
+
+// A parser that warns about every 1000th n-gram, as derived classes may do
+// from ConsumeNGram().
+class WarningArpaFileParser : public ArpaFileParser {
+ public:
+  explicit WarningArpaFileParser(const ArpaParseOptions &options)
+      : ArpaFileParser(options, NULL), num_ngrams_(0) { }
+ private:
+  virtual void ConsumeNGram(const NGram& ngram) {
+    if (++num_ngrams_ % 1000 == 0 && ShouldWarn())
+      KALDI_WARN << LineReference() << ": test warning";
+  }
+  int32 num_ngrams_;
+};
+
+// The line numbers of the warnings printed since the last clear().
+std::vector<int32> warning_line_numbers;
+
+void RecordWarning(const LogMessageEnvelope &envelope, const char *message) {
+  int32 line_number;
+  if (envelope.severity == LogMessageEnvelope::kWarning &&
+      std::sscanf(message, "line %d", &line_number) == 1)
+    warning_line_numbers.push_back(line_number);
+}
+
+// Checks that the warnings come in the order of the lines, and with their
+// line numbers, also when the lines are parsed in batches on several threads.
+void ReadIntegerLmWarningOrder() {
+  KALDI_LOG << "ReadIntegerLmWarningOrder()";
+  int32 num_words = 50000, directive_line = 45006;
+  std::ostringstream os;
+  os << "\\data\\\nngram 1=" << num_words << "\nngram 2=1\n\n\\1-grams:\n";
+  for (int32 w = 1; w <= num_words; w++) {
+    if (w + 5 == directive_line)
+      os << "\\3-grams:\n";  // A misplaced directive, which is an error.
+    os << (-0.001 * w) << "\t" << w << "\n";
+  }
+  os << "\n\\2-grams:\n-0.1\t1 2\n\\end\\\n";
+
+  ArpaParseOptions options;
+  options.bos_symbol = 1;
+  options.eos_symbol = 2;
+  options.max_warnings = -1;
+  for (int32 num_threads = 1; num_threads <= 2; num_threads++) {
+    options.num_threads = num_threads;
+    WarningArpaFileParser parser(options);
+    std::istringstream stm(os.str(), std::ios_base::in);
+    warning_line_numbers.clear();
+    LogHandler old_handler = SetLogHandler(RecordWarning);
+    bool threw = false;
+    try {
+      parser.Read(stm);
+    } catch (const KaldiFatalError &e) {
+      threw = true;
+    }
+    SetLogHandler(old_handler);
+    KALDI_ASSERT(threw);
+    // The test warnings for 45 n-grams before the directive, then the
+    // warning for the directive, after which we stop with an error.
+    KALDI_ASSERT(warning_line_numbers.size() == 46);
+    for (size_t i = 0; i + 1 < warning_line_numbers.size(); i++)
+      KALDI_ASSERT(warning_line_numbers[i] < warning_line_numbers[i + 1]);
+    KALDI_ASSERT(warning_line_numbers.back() == directive_line);
+  }
 }
 
 }  // namespace
@@ -370,4 +482,6 @@ int main(int argc, char *argv[]) {
   kaldi::ReadIntegerLmLogconvExpectSuccess();
   kaldi::ReadSymbolicLmNoOovTests();
   kaldi::ReadSymbolicLmWithOovTests();
+  kaldi::ReadIntegerLmMultiThreaded();
+  kaldi::ReadIntegerLmWarningOrder();
 }
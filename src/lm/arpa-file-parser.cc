@@ -20,11 +20,14 @@
 
 #include <fst/fstlib.h>
 
+#include <cerrno>
+#include <cstdlib>
 #include <sstream>
 
 #include "base/kaldi-error.h"
 #include "base/kaldi-math.h"
 #include "lm/arpa-file-parser.h"
+#include "util/kaldi-thread.h"
 #include "util/text-utils.h"
 
 namespace kaldi {
@@ -129,9 +132,6 @@ void ArpaFileParser::Read(std::istream &is) {
   // Signal that grammar order and n-gram counts are known.
   HeaderAvailable();
 
-  NGram ngram;
-  ngram.words.reserve(ngram_counts_.size());
-
   // Processes "\N-grams:" section.
   for (int32 cur_order = 1; cur_order <= ngram_counts_.size(); ++cur_order) {
     // Skips n-grams with zero count.
@@ -149,98 +149,19 @@ void ArpaFileParser::Read(std::istream &is) {
     KALDI_LOG << "Reading " << current_line_ << " section.";
 
     int32 ngram_count = 0;
-    while (++line_number_, getline(is, current_line_) && !is.eof()) {
-      if (current_line_.find_first_not_of(" \n\t\r") == std::string::npos) {
-        continue;
-      }
-      if (current_line_[0] == '\\') {
-        TrimTrailingWhitespace(&current_line_);
-        std::ostringstream next_keyword;
-        next_keyword << "\\" << cur_order + 1 << "-grams:";
-        if ((current_line_ != next_keyword.str()) &&
-            (current_line_ != "\\end\\")) {
-          if (ShouldWarn()) {
-            KALDI_WARN << "ignoring possible directive '" << current_line_
-                       << "' expecting '" << next_keyword.str() << "'";
-
-            if (warning_count_ > 0 &&
-                warning_count_ > static_cast<uint32>(options_.max_warnings)) {
-              KALDI_WARN << "Of " << warning_count_ << " parse warnings, "
-                         << options_.max_warnings << " were reported. "
-                         << "Run program with --max-arpa-warnings=-1 "
-                         << "to see all warnings";
-            }
-          }
-        } else {
-          break;
-        }
-      }
-
-      std::vector<std::string> col;
-      SplitStringToVector(current_line_, " \t", true, &col);
-
-      if (col.size() < 1 + cur_order ||
-          col.size() > 2 + cur_order ||
-          (cur_order == ngram_counts_.size() && col.size() != 1 + cur_order)) {
-        PARSE_ERR << "Invalid n-gram data line";
-      }
-      ++ngram_count;
-
-      // Parse out n-gram logprob and, if present, backoff weight.
-      if (!ConvertStringToReal(col[0], &ngram.logprob)) {
-        PARSE_ERR << "invalid n-gram logprob '" << col[0] << "'";
-      }
-      ngram.backoff = 0.0;
-      if (col.size() > cur_order + 1) {
-        if (!ConvertStringToReal(col[cur_order + 1], &ngram.backoff))
-          PARSE_ERR << "invalid backoff weight '" << col[cur_order + 1] << "'";
-      }
-      // Convert to natural log.
-      ngram.logprob *= M_LN10;
-      ngram.backoff *= M_LN10;
-
-      ngram.words.resize(cur_order);
-      bool skip_ngram = false;
-      for (int32 index = 0; !skip_ngram && index < cur_order; ++index) {
-        int32 word;
-        if (symbols_) {
-          // Symbol table provided, so symbol labels are expected.
-          if (options_.oov_handling == ArpaParseOptions::kAddToSymbols) {
-            word = symbols_->AddSymbol(col[1 + index]);
-          } else {
-            word = symbols_->Find(col[1 + index]);
-            if (word == -1) { // fst::kNoSymbol
-              switch (options_.oov_handling) {
-                case ArpaParseOptions::kReplaceWithUnk:
-                  word = options_.unk_symbol;
-                  break;
-                case ArpaParseOptions::kSkipNGram:
-                  if (ShouldWarn())
-                    KALDI_WARN << LineReference() << " skipped: word '"
-                               << col[1 + index] << "' not in symbol table";
-                  skip_ngram = true;
-                  break;
-                default:
-                  PARSE_ERR << "word '"  << col[1 + index]
-                            << "' not in symbol table";
-              }
-            }
-          }
-        } else {
-          // Symbols not provided, LM file should contain integers.
-          if (!ConvertStringToInteger(col[1 + index], &word) || word < 0) {
-            PARSE_ERR << "invalid symbol '" << col[1 + index] << "'";
-          }
-        }
-        // Whichever way we got it, an epsilon is invalid.
-        if (word == 0) {
-          PARSE_ERR << "epsilon symbol '" << col[1 + index]
-                    << "' is illegal in ARPA LM";
-        }
-        ngram.words[index] = word;
-      }
-      if (!skip_ngram) {
-        ConsumeNGram(ngram);
+    if (options_.num_threads > 1 &&
+        !(symbols_ != NULL &&
+          options_.oov_handling == ArpaParseOptions::kAddToSymbols)) {
+      ReadNGramsMultiThreaded(is, cur_order, &ngram_count);
+    } else {
+      NGram ngram;
+      ngram.words.reserve(ngram_counts_.size());
+      std::string message;
+      while (ReadNGramLine(is, cur_order, &current_line_, &line_number_)) {
+        ++ngram_count;
+        NGramStatus status = ParseNGram(current_line_, cur_order,
+                                        &ngram, &message);
+        ProcessNGram(cur_order, status, message, ngram);
       }
     }
     if (ngram_count > ngram_counts_[cur_order - 1]) {
@@ -267,6 +188,263 @@ void ArpaFileParser::Read(std::istream &is) {
 #undef PARSE_ERR
 }
 
+bool ArpaFileParser::ReadNGramLine(std::istream &is, int32 order,
+                                   std::string *line, int32 *line_number) {
+  while (++(*line_number), getline(is, *line) && !is.eof()) {
+    if (line->find_first_not_of(" \n\t\r") == std::string::npos) {
+      continue;
+    }
+    if ((*line)[0] == '\\') {
+      TrimTrailingWhitespace(line);
+      std::ostringstream next_keyword;
+      next_keyword << "\\" << order + 1 << "-grams:";
+      // Any other directive is returned as an n-gram line, and
+      // ProcessNGram() warns about it.
+      if ((*line == next_keyword.str()) || (*line == "\\end\\"))
+        return false;
+    }
+    return true;
+  }
+  return false;
+}
+
+// Finds the next field of an n-gram line, which is delimited by spaces or
+// tabs, starting at *pos; returns false if there are no more fields.
+static inline bool NextField(const char **pos, const char **begin,
+                             const char **end) {
+  const char *p = *pos;
+  while (*p == ' ' || *p == '\t') p++;
+  if (*p == '\0') return false;
+  *begin = p;
+  while (*p != ' ' && *p != '\t' && *p != '\0') p++;
+  *end = *pos = p;
+  return true;
+}
+
+// Converts the field [begin, end) to a real number.  This is much faster than
+// ConvertStringToReal(), which we only fall back to for strings strtof()
+// does not accept.
+static inline bool ParseRealField(const char *begin, const char *end,
+                                  float *out) {
+  char *stop;
+  *out = std::strtof(begin, &stop);
+  if (stop == end) return true;
+  return ConvertStringToReal(std::string(begin, end), out);
+}
+
+ArpaFileParser::NGramStatus ArpaFileParser::ParseNGram(
+    const std::string &line, int32 order, NGram *ngram,
+    std::string *message) const {
+  // The fields are the logprob, 'order' words and an optional backoff weight,
+  // which the highest order must not have.
+  int32 num_fields = 0;
+  const char *pos = line.c_str(), *begin = NULL, *end = NULL;
+  while (NextField(&pos, &begin, &end))
+    num_fields++;
+  if (num_fields < 1 + order || num_fields > 2 + order ||
+      (order == ngram_counts_.size() && num_fields != 1 + order)) {
+    *message = "Invalid n-gram data line";
+    return kNGramInvalid;
+  }
+
+  // Parse out n-gram logprob and, if present, backoff weight.
+  pos = line.c_str();
+  NextField(&pos, &begin, &end);
+  if (!ParseRealField(begin, end, &ngram->logprob)) {
+    *message = "invalid n-gram logprob '" + std::string(begin, end) + "'";
+    return kNGramInvalid;
+  }
+  const char *words_pos = pos;
+  ngram->backoff = 0.0;
+  if (num_fields > order + 1) {
+    for (int32 index = 0; index <= order; ++index)
+      NextField(&pos, &begin, &end);
+    if (!ParseRealField(begin, end, &ngram->backoff)) {
+      *message = "invalid backoff weight '" + std::string(begin, end) + "'";
+      return kNGramInvalid;
+    }
+  }
+  // Convert to natural log.
+  ngram->logprob *= M_LN10;
+  ngram->backoff *= M_LN10;
+
+  ngram->words.resize(order);
+  pos = words_pos;
+  std::string word_str;
+  for (int32 index = 0; index < order; ++index) {
+    NextField(&pos, &begin, &end);
+    int32 word;
+    if (symbols_) {
+      // Symbol table provided, so symbol labels are expected.
+      word_str.assign(begin, end);
+      if (options_.oov_handling == ArpaParseOptions::kAddToSymbols) {
+        // Only reached when reading with one thread.
+        word = symbols_->AddSymbol(word_str);
+      } else {
+        word = symbols_->Find(word_str);
+        if (word == -1) { // fst::kNoSymbol
+          switch (options_.oov_handling) {
+            case ArpaParseOptions::kReplaceWithUnk:
+              word = options_.unk_symbol;
+              break;
+            case ArpaParseOptions::kSkipNGram:
+              *message = word_str;
+              return kNGramSkipped;
+            default:
+              *message = "word '" + word_str + "' not in symbol table";
+              return kNGramInvalid;
+          }
+        }
+      }
+    } else {
+      // Symbols not provided, LM file should contain integers.
+      char *stop;
+      errno = 0;
+      long value = std::strtol(begin, &stop, 10);
+      word = static_cast<int32>(value);
+      if (stop != end || errno != 0 || word != value || word < 0) {
+        *message = "invalid symbol '" + std::string(begin, end) + "'";
+        return kNGramInvalid;
+      }
+    }
+    // Whichever way we got it, an epsilon is invalid.
+    if (word == 0) {
+      *message = "epsilon symbol '" + std::string(begin, end) +
+          "' is illegal in ARPA LM";
+      return kNGramInvalid;
+    }
+    ngram->words[index] = word;
+  }
+  return kNGramOk;
+}
+
+void ArpaFileParser::ProcessNGram(int32 order, NGramStatus status,
+                                  const std::string &message,
+                                  const NGram &ngram) {
+  if (current_line_[0] == '\\' && ShouldWarn()) {
+    KALDI_WARN << LineReference() << ": ignoring possible directive, "
+               << "expecting '\\" << order + 1 << "-grams:'";
+    if (warning_count_ > 0 &&
+        warning_count_ > static_cast<uint32>(options_.max_warnings)) {
+      KALDI_WARN << "Of " << warning_count_ << " parse warnings, "
+                 << options_.max_warnings << " were reported. "
+                 << "Run program with --max-arpa-warnings=-1 "
+                 << "to see all warnings";
+    }
+  }
+  if (status == kNGramOk) {
+    ConsumeNGram(ngram);
+  } else if (status == kNGramSkipped) {
+    if (ShouldWarn())
+      KALDI_WARN << LineReference() << " skipped: word '"
+                 << message << "' not in symbol table";
+  } else {
+    KALDI_ERR << LineReference() << ": " << message;
+  }
+}
+
+
+// A batch of n-gram lines, which ReadNGramsMultiThreaded() reads, parses and
+// consumes as a unit.
+struct ArpaFileParser::NGramBatch {
+  std::vector<std::string> lines;
+  std::vector<int32> line_numbers;
+  std::vector<NGram> ngrams;
+  std::vector<NGramStatus> status;
+  std::vector<std::string> messages;
+  size_t size;
+  NGramBatch(): size(0) { }
+};
+
+// Parses a range of the lines of an NGramBatch; thread i of n parses the i'th
+// of n equal parts.
+class ArpaFileParser::ParseTask: public MultiThreadable {
+ public:
+  ParseTask(const ArpaFileParser &parser, int32 order, NGramBatch *batch):
+      parser_(parser), order_(order), batch_(batch) { }
+  // Use the default copy constructor.
+  virtual void operator() () {
+    size_t begin = batch_->size * thread_id_ / num_threads_,
+        end = batch_->size * (thread_id_ + 1) / num_threads_;
+    for (size_t i = begin; i < end; i++)
+      batch_->status[i] = parser_.ParseNGram(batch_->lines[i], order_,
+                                             &(batch_->ngrams[i]),
+                                             &(batch_->messages[i]));
+  }
+ private:
+  const ArpaFileParser &parser_;
+  int32 order_;
+  NGramBatch *batch_;
+};
+
+void ArpaFileParser::ReadNGramsMultiThreaded(std::istream &is, int32 order,
+                                             int32 *ngram_count) {
+  // Each thread parses this many lines of a batch; the batches are large
+  // enough that starting the threads costs little.
+  const size_t kLinesPerThread = 10000;
+  size_t batch_size = kLinesPerThread * options_.num_threads;
+  // The reader's position; these only become current_line_ and line_number_
+  // once we are done with the batches, as we use those while consuming.
+  std::string line;
+  int32 line_number = line_number_;
+  bool section_done = false;
+
+  // We read batch k + 1 and consume batch k - 1 while batch k is being
+  // parsed, so we need three of them.
+  std::vector<NGramBatch> batches(3);
+  for (size_t b = 0; b < batches.size(); b++) {
+    NGramBatch &batch = batches[b];
+    batch.lines.resize(batch_size);
+    batch.line_numbers.resize(batch_size);
+    batch.ngrams.resize(batch_size);
+    batch.status.resize(batch_size);
+    batch.messages.resize(batch_size);
+  }
+  *ngram_count = 0;
+  // Reads the next batch into 'batch'.
+  auto read_batch = [&](NGramBatch *batch) {
+    batch->size = 0;
+    while (!section_done && batch->size < batch_size) {
+      if (!ReadNGramLine(is, order, &line, &line_number)) {
+        section_done = true;
+        break;
+      }
+      batch->lines[batch->size].swap(line);
+      batch->line_numbers[batch->size] = line_number;
+      batch->size++;
+    }
+    *ngram_count += batch->size;
+  };
+  // Consumes 'batch', which has been parsed.
+  auto consume_batch = [&](NGramBatch *batch) {
+    for (size_t i = 0; i < batch->size; i++) {
+      current_line_.swap(batch->lines[i]);
+      line_number_ = batch->line_numbers[i];
+      ProcessNGram(order, batch->status[i], batch->messages[i],
+                   batch->ngrams[i]);
+      current_line_.swap(batch->lines[i]);
+    }
+  };
+
+  NGramBatch *to_consume = &(batches[0]), *to_parse = &(batches[1]),
+      *to_read = &(batches[2]);
+  read_batch(to_parse);
+  while (to_parse->size > 0) {
+    {
+      MultiThreader<ParseTask> m(options_.num_threads,
+                                 ParseTask(*this, order, to_parse));
+      consume_batch(to_consume);
+      read_batch(to_read);
+    }  // Waits for the parsing to finish.
+    std::swap(to_consume, to_parse);
+    std::swap(to_parse, to_read);
+    to_read->size = 0;
+  }
+  consume_batch(to_consume);
+  current_line_.swap(line);
+  line_number_ = line_number;
+}
+
 std::string ArpaFileParser::LineReference() const {
   std::ostringstream ss;
   ss << "line " << line_number_ << " [" << current_line_ << "]";
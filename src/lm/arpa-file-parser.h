@@ -44,7 +44,7 @@ struct ArpaParseOptions {
 
   ArpaParseOptions():
       bos_symbol(-1), eos_symbol(-1), unk_symbol(-1),
-      oov_handling(kRaiseError), max_warnings(30) { }
+      oov_handling(kRaiseError), max_warnings(30), num_threads(1) { }
 
   void Register(OptionsItf *opts) {
     // Registering only the max_warnings count, since other options are
@@ -53,6 +53,10 @@ struct ArpaParseOptions {
     opts->Register("max-arpa-warnings", &max_warnings,
                    "Maximum warnings to report on ARPA parsing, "
                    "0 to disable, -1 to show all");
+    opts->Register("arpa-threads", &num_threads,
+                   "Number of threads used to parse the n-gram lines of the "
+                   "ARPA file.  The n-grams are still processed in file "
+                   "order, so the output does not depend on this.");
   }
 
   int32 bos_symbol;  ///< Symbol for <s>, Required non-epsilon.
@@ -60,6 +64,8 @@ struct ArpaParseOptions {
   int32 unk_symbol;  ///< Symbol for <unk>, Required for kReplaceWithUnk.
   OovHandling oov_handling;  ///< How to handle OOV words in the file.
   int32 max_warnings;  ///< Maximum warnings to report, <0 unlimited.
+  int32 num_threads;  ///< Threads for parsing n-gram lines; has no effect
+                      ///< with kAddToSymbols.
 };
 
 /**
@@ -92,7 +98,11 @@ class ArpaFileParser {
   ArpaFileParser(const ArpaParseOptions& options, fst::SymbolTable* symbols);
   virtual ~ArpaFileParser();
 
-  /// Read ARPA LM file from a stream.
+  /// Read ARPA LM file from a stream.  If options.num_threads > 1, the n-gram
+  /// lines are split into batches that are parsed by several threads while
+  /// this thread reads the next batch and calls ConsumeNGram() on the
+  /// previous one; ConsumeNGram() is still called from this thread, in file
+  /// order.
   void Read(std::istream &is);
 
   /// Parser options.
@@ -133,6 +143,41 @@ class ArpaFileParser {
   const std::vector<int32>& NgramCounts() const { return ngram_counts_; }
 
  private:
+  class ParseTask;
+  struct NGramBatch;
+
+  // Return values of ParseNGram().
+  enum NGramStatus { kNGramOk, kNGramSkipped, kNGramInvalid };
+
+  // Reads the next line of the section of n-grams of order 'order' into
+  // 'line', skipping empty lines and incrementing 'line_number' for each line
+  // read.  Returns false at the end of the section, in which case 'line' is
+  // the directive that ended it, or at the end of the file.  This does not
+  // print anything, so that all the warnings come from ProcessNGram(), in
+  // the order of the lines, also when reading with several threads.
+  bool ReadNGramLine(std::istream &is, int32 order,
+                     std::string *line, int32 *line_number);
+
+  // Parses 'line', an n-gram of order 'order', into 'ngram'.  On kNGramSkipped
+  // (an OOV word with kSkipNGram), 'message' is set to the word; on
+  // kNGramInvalid, it describes the problem.  This does not change the parser,
+  // so it may be called from several threads at once.
+  NGramStatus ParseNGram(const std::string &line, int32 order, NGram *ngram,
+                         std::string *message) const;
+
+  // Prints an error or warning, or calls ConsumeNGram(), depending on the
+  // result of ParseNGram() for a line of the section of order 'order'.  Also
+  // warns if the line is a directive other than the one that ends the
+  // section.  current_line_ and line_number_ must be set to the line in
+  // question.
+  void ProcessNGram(int32 order, NGramStatus status,
+                    const std::string &message, const NGram &ngram);
+
+  // Reads the section of n-grams of order 'order' using options_.num_threads
+  // threads; sets 'ngram_count' to the number of n-gram lines in it.
+  void ReadNGramsMultiThreaded(std::istream &is, int32 order,
+                               int32 *ngram_count);
+
   ArpaParseOptions options_;
   fst::SymbolTable* symbols_;  // the pointer is not owned here.
   int32 line_number_;
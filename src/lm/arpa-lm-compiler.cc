@@ -113,8 +113,10 @@ class OptimizedHistKey {
 template <class HistKey>
 class ArpaLmCompilerImpl : public ArpaLmCompilerImplInterface {
  public:
+  // 'num_histories' is the expected number of history states, used to size
+  // the hash table in advance.
   ArpaLmCompilerImpl(ArpaLmCompiler* parent, fst::StdVectorFst* fst,
-                     Symbol sub_eps);
+                     Symbol sub_eps, size_t num_histories);
 
   virtual void ConsumeNGram(const NGram &ngram, bool is_highest);
 
@@ -136,9 +138,13 @@ class ArpaLmCompilerImpl : public ArpaLmCompilerImplInterface {
 
 template <class HistKey>
 ArpaLmCompilerImpl<HistKey>::ArpaLmCompilerImpl(
-    ArpaLmCompiler* parent, fst::StdVectorFst* fst, Symbol sub_eps)
+    ArpaLmCompiler* parent, fst::StdVectorFst* fst, Symbol sub_eps,
+    size_t num_histories)
     : parent_(parent), fst_(fst), bos_symbol_(parent->Options().bos_symbol),
       eos_symbol_(parent->Options().eos_symbol), sub_eps_(sub_eps) {
+  // Rehashing a large table is slow, and rehashes would happen repeatedly
+  // while reading a large LM.
+  history_.reserve(num_histories + 1);
   // The algorithm maintains state per history. The 0-gram is a special state
   // for empty history. All unigrams (including BOS) backoff into this state.
   StateId zerogram = fst_->AddState();
@@ -293,10 +299,17 @@ void ArpaLmCompiler::HeaderAvailable() {
   if (Options().oov_handling == ArpaParseOptions::kAddToSymbols)
     max_symbol += NgramCounts()[0];
 
+  // All n-grams except those of the highest order become history states.
+  size_t num_histories = 0;
+  for (size_t i = 0; i + 1 < NgramCounts().size(); i++)
+    num_histories += NgramCounts()[i];
+
   if (NgramCounts().size() <= 4 && max_symbol < OptimizedHistKey::kMaxData) {
-    impl_ = new ArpaLmCompilerImpl<OptimizedHistKey>(this, &fst_, sub_eps_);
+    impl_ = new ArpaLmCompilerImpl<OptimizedHistKey>(this, &fst_, sub_eps_,
+                                                     num_histories);
   } else {
-    impl_ = new ArpaLmCompilerImpl<GeneralHistKey>(this, &fst_, sub_eps_);
+    impl_ = new ArpaLmCompilerImpl<GeneralHistKey>(this, &fst_, sub_eps_,
+                                                   num_histories);
     KALDI_LOG << "Reverting to slower state tracking because model is large: "
               << NgramCounts().size() << "-gram with symbols up to "
               << max_symbol;
@@ -0,0 +1,150 @@
+// lm/const-arpa-lm-test.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <set>
+#include <sstream>
+
+#include "lm/const-arpa-lm.h"
+
+namespace kaldi {
+
+// Writes a random ARPA language model with integer words to 'filename'.  Word
+// 1 is <s>, word 2 is </s> and word 3 is <unk>; 'num_words' is the number of
+// words including those.
+static void WriteRandomArpa(int32 num_words, int32 order,
+                            const std::string &filename) {
+  std::vector<std::set<std::vector<int32> > > ngrams(order);
+  for (int32 w = 1; w <= num_words; w++)
+    ngrams[0].insert(std::vector<int32>(1, w));
+  for (int32 k = 1; k < order; k++) {
+    std::vector<std::vector<int32> > hists(ngrams[k - 1].begin(),
+                                           ngrams[k - 1].end());
+    int32 num_ngrams = RandInt(1, 4 * num_words);
+    for (int32 i = 0; i < num_ngrams; i++) {
+      std::vector<int32> ngram = hists[RandInt(0, hists.size() - 1)];
+      if (ngram.back() == 2) continue;  // nothing follows </s>.
+      ngram.push_back(RandInt(2, num_words));
+      ngrams[k].insert(ngram);
+    }
+  }
+  std::ofstream os(filename.c_str());
+  os << "\\data\\\n";
+  for (int32 k = 0; k < order; k++)
+    os << "ngram " << (k + 1) << "=" << ngrams[k].size() << "\n";
+  for (int32 k = 0; k < order; k++) {
+    os << "\n\\" << (k + 1) << "-grams:\n";
+    for (std::set<std::vector<int32> >::const_iterator iter =
+             ngrams[k].begin(); iter != ngrams[k].end(); ++iter) {
+      const std::vector<int32> &ngram = *iter;
+      os << (ngram.size() == 1 && ngram[0] == 1 ? -99.0 : -5.0 * RandUniform());
+      for (size_t i = 0; i < ngram.size(); i++)
+        os << (i == 0 ? "\t" : " ") << ngram[i];
+      if (k + 1 < order && WithProb(0.7))
+        os << "\t" << (-2.0 * RandUniform());
+      os << "\n";
+    }
+  }
+  os << "\n\\end\\\n";
+}
+
+static void UnitTestQuantizedConstArpaLm() {
+  int32 num_words = RandInt(4, 30), order = RandInt(1, 4),
+      num_bits = (WithProb(0.5) ? 16 : RandInt(2, 8));
+  std::string arpa_filename = "tmp.arpa",
+      carpa_filename = "tmp.carpa",
+      quantized_filename = "tmp.quantized.carpa";
+  WriteRandomArpa(num_words, order, arpa_filename);
+
+  ArpaParseOptions options;
+  options.bos_symbol = 1;
+  options.eos_symbol = 2;
+  options.unk_symbol = 3;
+  BuildConstArpaLm(options, arpa_filename, carpa_filename);
+  BuildConstArpaLm(options, arpa_filename, quantized_filename, num_bits);
+
+  ConstArpaLm lm, quantized_lm, mapped_lm;
+  ReadKaldiObject(carpa_filename, &lm);
+  ReadKaldiObject(quantized_filename, &quantized_lm);
+  ReadConstArpaLm(quantized_filename, &mapped_lm);
+  KALDI_ASSERT(!lm.IsQuantized() && quantized_lm.IsQuantized() &&
+               mapped_lm.IsQuantized());
+  KALDI_ASSERT(quantized_lm.NgramOrder() == order);
+
+  // With 16 bits, the codebooks of this small LM hold all the distinct
+  // values, so the only differences come from ConstArpaLm dropping the
+  // least significant bit of some logprobs.
+  int32 num_tests = 200;
+  double total_error = 0.0;
+  for (int32 i = 0; i < num_tests; i++) {
+    std::vector<int32> hist;
+    int32 hist_length = RandInt(0, order - 1);
+    for (int32 j = 0; j < hist_length; j++)
+      hist.push_back(RandInt(1, num_words + 2));  // Include some OOVs.
+    int32 word = RandInt(2, num_words + 2);
+    float logprob = lm.GetNgramLogprob(word, hist),
+        quantized_logprob = quantized_lm.GetNgramLogprob(word, hist);
+    KALDI_ASSERT(quantized_logprob ==
+                 mapped_lm.GetNgramLogprob(word, hist));
+    if (num_bits == 16)
+      KALDI_ASSERT(std::abs(logprob - quantized_logprob) < 1.0e-04);
+    total_error += std::abs(logprob - quantized_logprob);
+    KALDI_ASSERT(lm.HistoryStateExists(hist) ==
+                 quantized_lm.HistoryStateExists(hist));
+  }
+  KALDI_LOG << "Average error with " << num_bits << " bits is "
+            << (total_error / num_tests);
+  KALDI_ASSERT(total_error / num_tests < 1.0);
+
+  // The quantized LM can be converted back to ARPA format, and it has the
+  // same n-grams.
+  std::ostringstream arpa, quantized_arpa;
+  lm.WriteArpa(arpa);
+  quantized_lm.WriteArpa(quantized_arpa);
+  std::string arpa_str = arpa.str(), quantized_arpa_str = quantized_arpa.str();
+  KALDI_ASSERT(std::count(arpa_str.begin(), arpa_str.end(), '\t') ==
+               std::count(quantized_arpa_str.begin(),
+                          quantized_arpa_str.end(), '\t'));
+
+  // Quantize() on an LM we read gives the same result as quantizing while
+  // building it.
+  ConstArpaLm lm2;
+  ReadKaldiObject(carpa_filename, &lm2);
+  lm2.Quantize(num_bits);
+  std::ostringstream os1, os2;
+  lm2.Write(os1, true);
+  quantized_lm.Write(os2, true);
+  KALDI_ASSERT(os1.str() == os2.str());
+
+  std::remove(arpa_filename.c_str());
+  std::remove(carpa_filename.c_str());
+  std::remove(quantized_filename.c_str());
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  for (int32 i = 0; i < 20; i++)
+    UnitTestQuantizedConstArpaLm();
+  KALDI_LOG << "Tests succeeded.";
+  return 0;
+}
@@ -18,9 +18,17 @@
 // limitations under the License.
 
 #include <algorithm>
+#include <cstring>
+#include <fstream>
 #include <limits>
 #include <sstream>
 #include <utility>
+#ifndef _MSC_VER
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #include "base/kaldi-math.h"
 #include "lm/arpa-file-parser.h"
@@ -49,6 +57,488 @@ struct ArpaLine {
   }
 };
 
+// Returns the number of bits needed to store the integers 0 ... max_value (at
+// least one).
+static int32 NumBitsFor(uint64 max_value) {
+  int32 ans = 1;
+  while (ans < 64 && (max_value >> ans) != 0)
+    ans++;
+  return ans;
+}
+
+// Makes a codebook of at most 2^num_bits values for quantizing 'values', by
+// dividing the sorted values into bins with equal counts and taking the mean of
+// each bin.  If 'exact_zero' is true, 0.0 is in the codebook and zeros are not
+// counted in the bins (we use this for backoffs, which are mostly zero).  The
+// codebook is sorted.
+static void MakeCodebook(const std::vector<float> &values, int32 num_bits,
+                         bool exact_zero, std::vector<float> *codebook) {
+  codebook->clear();
+  int64 num_centers = static_cast<int64>(1) << num_bits;
+  std::vector<float> sorted;
+  sorted.reserve(values.size());
+  for (size_t i = 0; i < values.size(); i++)
+    if (!exact_zero || values[i] != 0.0)
+      sorted.push_back(values[i]);
+  if (exact_zero || sorted.empty()) {
+    codebook->push_back(0.0);
+    num_centers--;
+  }
+  std::sort(sorted.begin(), sorted.end());
+  std::vector<float> distinct(sorted);
+  distinct.erase(std::unique(distinct.begin(), distinct.end()),
+                 distinct.end());
+  if (static_cast<int64>(distinct.size()) <= num_centers) {
+    codebook->insert(codebook->end(), distinct.begin(), distinct.end());
+  } else {
+    int64 n = sorted.size();
+    for (int64 b = 0; b < num_centers; b++) {
+      int64 begin = n * b / num_centers, end = n * (b + 1) / num_centers;
+      if (begin == end) continue;
+      double sum = 0.0;
+      for (int64 i = begin; i < end; i++)
+        sum += sorted[i];
+      codebook->push_back(sum / (end - begin));
+    }
+  }
+  std::sort(codebook->begin(), codebook->end());
+  codebook->erase(std::unique(codebook->begin(), codebook->end()),
+                  codebook->end());
+}
+
+// Returns the index of the element of the sorted 'codebook' nearest to
+// 'value'.
+static int32 EncodeValue(const std::vector<float> &codebook, float value) {
+  int32 i = std::lower_bound(codebook.begin(), codebook.end(), value) -
+      codebook.begin();
+  if (i == static_cast<int32>(codebook.size()) ||
+      (i > 0 && value - codebook[i - 1] < codebook[i] - value))
+    i--;
+  return i;
+}
+
+// This class holds the quantized format of ConstArpaLm; see the comment for
+// ConstArpaLm::Quantize().  Index k of the per-order arrays corresponds to
+// n-grams of order k + 1.  The n-grams of order one are indexed by word-id,
+// so there is an entry for each word (for words that are not in the language
+// model, words_[0] is zero).  For orders above one, the n-grams of each order
+// are sorted by their parent n-gram (in the order of the previous order's
+// arrays) and then by word, so the children of n-gram i of order k + 1 are
+// n-grams next_[k][i] ... next_[k][i + 1] - 1 of order k + 2.  All the
+// arrays are bit-packed into one block of memory, which is owned by this class
+// or memory-mapped.
+class QuantizedArpaTrie {
+ public:
+  // Describes an n-gram, used in Init().
+  struct Entry {
+    int32 word;
+    float logprob;
+    float backoff_logprob;
+    int64 num_children;
+  };
+
+  QuantizedArpaTrie(): ngram_order_(0), num_words_(0), data_(NULL),
+                       num_bytes_(0), mapped_(NULL), mapped_size_(0) { }
+
+  ~QuantizedArpaTrie() {
+#ifndef _MSC_VER
+    if (mapped_ != NULL)
+      munmap(mapped_, mapped_size_);
+#endif
+  }
+
+  // entries[k] contains the n-grams of order k + 1, in the order described
+  // above; entries[0] is indexed by word-id and has word == -1 for words that
+  // are not in the language model.
+  void Init(int32 num_bits, const std::vector<std::vector<Entry> > &entries);
+
+  void Write(std::ostream &os, bool binary) const;
+
+  // If 'map_filename' is not empty, it must be the file that 'is' is reading
+  // from, and we try to memory-map the data instead of reading it.
+  void Read(std::istream &is, bool binary, const std::string &map_filename);
+
+  int32 NgramOrder() const { return ngram_order_; }
+  int32 NumWords() const { return num_words_; }
+  bool HasUnigram(int32 word) const {
+    return word >= 0 && word < num_words_ && Get(words_[0], word) != 0;
+  }
+
+  // These have the same interface as the corresponding functions of
+  // ConstArpaLm; words have already been mapped to <unk> if needed.
+  float GetNgramLogprob(int32 word, const std::vector<int32> &hist) const;
+  bool HistoryStateExists(const std::vector<int32> &hist) const;
+
+  // Appends all the n-grams to 'output'.
+  void GetArpaLines(std::vector<ArpaLine> *output) const;
+
+ private:
+  // Describes a bit-packed array of unsigned integers of width at most 57
+  // bits, located at 'offset' bytes into data_.
+  struct PackedArray {
+    int64 offset;
+    int32 width;
+    PackedArray(): offset(0), width(0) { }
+  };
+
+  uint64 Get(const PackedArray &a, int64 i) const {
+    uint64 bit = static_cast<uint64>(i) * a.width, ans;
+    std::memcpy(&ans, data_ + a.offset + (bit >> 3), sizeof(ans));
+    return (ans >> (bit & 7)) & ((static_cast<uint64>(1) << a.width) - 1);
+  }
+
+  // Only used while building; 'data' is owned_data_.
+  void Set(const PackedArray &a, int64 i, uint64 value) {
+    KALDI_ASSERT((value >> a.width) == 0);
+    uint64 bit = static_cast<uint64>(i) * a.width, word;
+    char *ptr = &(owned_data_[0]) + a.offset + (bit >> 3);
+    std::memcpy(&word, ptr, sizeof(word));
+    word |= value << (bit & 7);
+    std::memcpy(ptr, &word, sizeof(word));
+  }
+
+  float Logprob(int32 k, int64 i) const {
+    uint64 code = Get(logprobs_[k], i);
+    if (k == 0) {
+      Int32AndFloat f(static_cast<int32>(code));
+      return f.f;
+    }
+    return prob_codebooks_[k][code];
+  }
+
+  float BackoffLogprob(int32 k, int64 i) const {
+    uint64 code = Get(backoffs_[k], i);
+    if (k == 0) {
+      Int32AndFloat f(static_cast<int32>(code));
+      return f.f;
+    }
+    return backoff_codebooks_[k][code];
+  }
+
+  // If n-gram i of order k + 1 has a child with word 'word', outputs its index
+  // to 'child' and returns true.
+  bool FindChild(int32 k, int64 i, int32 word, int64 *child) const;
+
+  // Finds the index of the n-gram 'seq' (of order seq.size()); returns false
+  // if it does not exist.
+  bool Find(const std::vector<int32> &seq, int64 *index) const;
+
+  void GetArpaLinesRecurse(int32 k, int64 i, std::vector<int32> *seq,
+                           std::vector<ArpaLine> *output) const;
+
+  // Places an array of 'size' elements of width 'width' at 'offset' bytes
+  // into the data, and advances 'offset' past it (to a multiple of 8 bytes).
+  static void AddArray(int64 size, int32 width, int64 *offset,
+                       PackedArray *array) {
+    KALDI_ASSERT(width > 0 && width <= 57);
+    array->offset = *offset;
+    array->width = width;
+    *offset += (size * width + 63) / 64 * 8;
+  }
+
+  // Sets up the arrays words_ etc. from ngram_order_, num_words_, counts_ and
+  // the codebooks, and sets num_bytes_.
+  void ComputeLayout();
+
+  int32 ngram_order_;
+  int32 num_words_;
+  // counts_[k] is the number of n-grams of order k + 1 (counts_[0] is
+  // num_words_).
+  std::vector<int64> counts_;
+  // Indexed by k; the codebooks for k = 0 are empty as unigrams are stored
+  // exactly.  There are no backoffs for the highest order.
+  std::vector<std::vector<float> > prob_codebooks_;
+  std::vector<std::vector<float> > backoff_codebooks_;
+
+  std::vector<PackedArray> words_;
+  std::vector<PackedArray> logprobs_;
+  std::vector<PackedArray> backoffs_;
+  std::vector<PackedArray> next_;
+
+  const char *data_;
+  int64 num_bytes_;
+  std::vector<char> owned_data_;
+  void *mapped_;
+  size_t mapped_size_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(QuantizedArpaTrie);
+};
+
+void QuantizedArpaTrie::ComputeLayout() {
+  int32 n = ngram_order_;
+  words_.resize(n);
+  logprobs_.resize(n);
+  backoffs_.resize(n);
+  next_.resize(n);
+  int64 offset = 0;  // Each array starts at a multiple of 8 bytes.
+  for (int32 k = 0; k < n; k++) {
+    int64 count = counts_[k];
+    if (k == 0) {
+      AddArray(count, 1, &offset, &(words_[k]));
+      AddArray(count, 32, &offset, &(logprobs_[k]));
+      AddArray(count, 32, &offset, &(backoffs_[k]));
+    } else {
+      AddArray(count, NumBitsFor(num_words_ - 1), &offset, &(words_[k]));
+      AddArray(count, NumBitsFor(prob_codebooks_[k].size() - 1), &offset,
+               &(logprobs_[k]));
+      if (k + 1 < n)
+        AddArray(count, NumBitsFor(backoff_codebooks_[k].size() - 1), &offset,
+                 &(backoffs_[k]));
+    }
+    if (k + 1 < n)
+      AddArray(count + 1, NumBitsFor(counts_[k + 1]), &offset, &(next_[k]));
+  }
+  // Get() reads 8 bytes at a time, so we may read a little past the end of
+  // the last array.
+  num_bytes_ = offset + 8;
+}
+
+void QuantizedArpaTrie::Init(int32 num_bits,
+                             const std::vector<std::vector<Entry> > &entries) {
+  KALDI_ASSERT(!entries.empty() && !entries[0].empty());
+  ngram_order_ = entries.size();
+  num_words_ = entries[0].size();
+  int32 n = ngram_order_;
+  counts_.resize(n);
+  prob_codebooks_.resize(n);
+  backoff_codebooks_.resize(n);
+  for (int32 k = 0; k < n; k++) {
+    counts_[k] = entries[k].size();
+    if (k == 0) continue;
+    std::vector<float> values(counts_[k]);
+    for (int64 i = 0; i < counts_[k]; i++)
+      values[i] = entries[k][i].logprob;
+    MakeCodebook(values, num_bits, false, &(prob_codebooks_[k]));
+    if (k + 1 < n) {
+      for (int64 i = 0; i < counts_[k]; i++)
+        values[i] = entries[k][i].backoff_logprob;
+      MakeCodebook(values, num_bits, true, &(backoff_codebooks_[k]));
+    }
+  }
+  ComputeLayout();
+  owned_data_.assign(num_bytes_, 0);
+  data_ = &(owned_data_[0]);
+
+  for (int32 k = 0; k < n; k++) {
+    int64 num_children = 0;
+    for (int64 i = 0; i < counts_[k]; i++) {
+      const Entry &e = entries[k][i];
+      if (k == 0) {
+        if (e.word < 0) {
+          KALDI_ASSERT(e.num_children == 0);
+        } else {
+          KALDI_ASSERT(e.word == i);
+          Set(words_[k], i, 1);
+          Int32AndFloat logprob(e.logprob), backoff(e.backoff_logprob);
+          Set(logprobs_[k], i, static_cast<uint32>(logprob.i));
+          Set(backoffs_[k], i, static_cast<uint32>(backoff.i));
+        }
+      } else {
+        Set(words_[k], i, e.word);
+        Set(logprobs_[k], i, EncodeValue(prob_codebooks_[k], e.logprob));
+        if (k + 1 < n)
+          Set(backoffs_[k], i,
+              EncodeValue(backoff_codebooks_[k], e.backoff_logprob));
+      }
+      if (k + 1 < n) {
+        Set(next_[k], i, num_children);
+        num_children += e.num_children;
+      } else {
+        KALDI_ASSERT(e.num_children == 0);
+      }
+    }
+    if (k + 1 < n) {
+      KALDI_ASSERT(num_children == counts_[k + 1]);
+      Set(next_[k], counts_[k], num_children);
+    }
+  }
+}
+
+void QuantizedArpaTrie::Write(std::ostream &os, bool binary) const {
+  WriteToken(os, binary, "<Counts>");
+  WriteIntegerVector(os, binary, counts_);
+  WriteToken(os, binary, "<Codebooks>");
+  for (int32 k = 1; k < ngram_order_; k++) {
+    for (int32 j = 0; j < 2; j++) {
+      const std::vector<float> &codebook =
+          (j == 0 ? prob_codebooks_[k] : backoff_codebooks_[k]);
+      WriteBasicType(os, binary, static_cast<int32>(codebook.size()));
+      for (size_t i = 0; i < codebook.size(); i++)
+        WriteBasicType(os, binary, codebook[i]);
+    }
+  }
+  WriteToken(os, binary, "<Data>");
+  WriteBasicType(os, binary, num_bytes_);
+  os.write(data_, num_bytes_);
+  if (!os.good())
+    KALDI_ERR << "QuantizedConstArpaLm <Data> section writing failed.";
+}
+
+void QuantizedArpaTrie::Read(std::istream &is, bool binary,
+                             const std::string &map_filename) {
+  ExpectToken(is, binary, "<Counts>");
+  ReadIntegerVector(is, binary, &counts_);
+  ngram_order_ = counts_.size();
+  if (ngram_order_ == 0 || counts_[0] <= 0 ||
+      counts_[0] > std::numeric_limits<int32>::max())
+    KALDI_ERR << "Bad n-gram counts in quantized ConstArpaLm";
+  num_words_ = counts_[0];
+  ExpectToken(is, binary, "<Codebooks>");
+  prob_codebooks_.resize(ngram_order_);
+  backoff_codebooks_.resize(ngram_order_);
+  for (int32 k = 1; k < ngram_order_; k++) {
+    for (int32 j = 0; j < 2; j++) {
+      std::vector<float> &codebook =
+          (j == 0 ? prob_codebooks_[k] : backoff_codebooks_[k]);
+      int32 size;
+      ReadBasicType(is, binary, &size);
+      if (size < 0 || (size == 0 && (j == 0 || k + 1 < ngram_order_)))
+        KALDI_ERR << "Bad codebook size " << size;
+      codebook.resize(size);
+      for (int32 i = 0; i < size; i++)
+        ReadBasicType(is, binary, &(codebook[i]));
+    }
+  }
+  ComputeLayout();
+  ExpectToken(is, binary, "<Data>");
+  int64 num_bytes;
+  ReadBasicType(is, binary, &num_bytes);
+  if (num_bytes != num_bytes_)
+    KALDI_ERR << "Expected " << num_bytes_ << " bytes of data in quantized "
+              << "ConstArpaLm, got " << num_bytes;
+#ifndef _MSC_VER
+  if (!map_filename.empty()) {
+    int64 offset = is.tellg();
+    int fd = open(map_filename.c_str(), O_RDONLY);
+    if (fd >= 0 && offset > 0) {
+      struct stat st;
+      if (fstat(fd, &st) == 0 && offset + num_bytes_ <= st.st_size) {
+        void *addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (addr != MAP_FAILED) {
+          mapped_ = addr;
+          mapped_size_ = st.st_size;
+          data_ = static_cast<const char*>(addr) + offset;
+        }
+      }
+    }
+    if (fd >= 0)
+      close(fd);
+    if (data_ != NULL) {
+      is.seekg(offset + num_bytes_);
+    } else {
+      KALDI_WARN << "Could not memory-map " << map_filename
+                 << "; reading it instead.";
+    }
+  }
+#endif
+  if (data_ == NULL) {
+    owned_data_.resize(num_bytes_);
+    is.read(&(owned_data_[0]), num_bytes_);
+    data_ = &(owned_data_[0]);
+  }
+  if (!is.good())
+    KALDI_ERR << "QuantizedConstArpaLm <Data> section reading failed.";
+  // Check that the last child indexes are consistent with the counts, which
+  // catches most kinds of corruption.
+  for (int32 k = 0; k + 1 < ngram_order_; k++)
+    if (static_cast<int64>(Get(next_[k], counts_[k])) != counts_[k + 1])
+      KALDI_ERR << "Quantized ConstArpaLm is corrupted.";
+}
+
+bool QuantizedArpaTrie::FindChild(int32 k, int64 i, int32 word,
+                                  int64 *child) const {
+  KALDI_ASSERT(k + 1 < ngram_order_);
+  // Binary search over the children.
+  int64 begin = Get(next_[k], i), end = Get(next_[k], i + 1);
+  const PackedArray &words = words_[k + 1];
+  while (begin < end) {
+    int64 mid = begin + (end - begin) / 2;
+    int32 mid_word = Get(words, mid);
+    if (mid_word == word) {
+      *child = mid;
+      return true;
+    } else if (mid_word < word) {
+      begin = mid + 1;
+    } else {
+      end = mid;
+    }
+  }
+  return false;
+}
+
+bool QuantizedArpaTrie::Find(const std::vector<int32> &seq,
+                             int64 *index) const {
+  KALDI_ASSERT(!seq.empty());
+  if (!HasUnigram(seq[0]) || static_cast<int32>(seq.size()) > ngram_order_)
+    return false;
+  int64 i = seq[0];
+  for (size_t k = 1; k < seq.size(); k++)
+    if (!FindChild(k - 1, i, seq[k], &i))
+      return false;
+  *index = i;
+  return true;
+}
+
+float QuantizedArpaTrie::GetNgramLogprob(
+    int32 word, const std::vector<int32> &hist) const {
+  KALDI_ASSERT(static_cast<int32>(hist.size()) < ngram_order_);
+  if (hist.empty()) {
+    if (!HasUnigram(word))
+      return std::numeric_limits<float>::min();
+    return Logprob(0, word);
+  }
+  float backoff_logprob = 0.0;
+  int64 h;
+  if (Find(hist, &h)) {
+    int32 k = hist.size() - 1;
+    int64 child;
+    if (FindChild(k, h, word, &child))
+      return Logprob(k + 1, child);
+    backoff_logprob = BackoffLogprob(k, h);
+  }
+  std::vector<int32> new_hist(hist.begin() + 1, hist.end());
+  return backoff_logprob + GetNgramLogprob(word, new_hist);
+}
+
+bool QuantizedArpaTrie::HistoryStateExists(
+    const std::vector<int32> &hist) const {
+  if (hist.empty())
+    return true;
+  int64 h;
+  int32 k = hist.size() - 1;
+  if (k + 1 >= ngram_order_ || !Find(hist, &h))
+    return false;
+  return Get(next_[k], h + 1) > Get(next_[k], h);
+}
+
+void QuantizedArpaTrie::GetArpaLinesRecurse(
+    int32 k, int64 i, std::vector<int32> *seq,
+    std::vector<ArpaLine> *output) const {
+  ArpaLine line;
+  line.words = *seq;
+  line.logprob = Logprob(k, i);
+  line.backoff_logprob = (k + 1 < ngram_order_ ? BackoffLogprob(k, i) : 0.0);
+  output->push_back(line);
+  if (k + 1 == ngram_order_)
+    return;
+  int64 begin = Get(next_[k], i), end = Get(next_[k], i + 1);
+  for (int64 c = begin; c < end; c++) {
+    seq->push_back(Get(words_[k + 1], c));
+    GetArpaLinesRecurse(k + 1, c, seq, output);
+    seq->pop_back();
+  }
+}
+
+void QuantizedArpaTrie::GetArpaLines(std::vector<ArpaLine> *output) const {
+  std::vector<int32> seq(1);
+  for (int32 w = 0; w < num_words_; w++) {
+    if (HasUnigram(w)) {
+      seq[0] = w;
+      GetArpaLinesRecurse(0, w, &seq, output);
+    }
+  }
+}
+
 // Auxiliary class to build ConstArpaLm. We first use this class to figure out
 // the relative address of different LmStates, and then put everything into one
 // block in memory.
@@ -187,6 +677,7 @@ class ConstArpaLmBuilder : public ArpaFileParser {
     lm_states_ = NULL;
     unigram_states_ = NULL;
     overflow_buffer_ = NULL;
+    quantize_bits_ = 0;
   }
 
   ~ConstArpaLmBuilder() {
@@ -211,6 +702,9 @@ class ConstArpaLmBuilder : public ArpaFileParser {
     max_address_offset_ = max_address_offset;
   }
 
+  // If num_bits > 0, Write() writes the quantized format.
+  void SetQuantizeBits(int32 num_bits) { quantize_bits_ = num_bits; }
+
  protected:
   // ArpaFileParser overrides.
   virtual void HeaderAvailable();
@@ -262,10 +756,20 @@ class ConstArpaLmBuilder : public ArpaFileParser {
   // Hash table from word sequences to LmStates.
   unordered_map<std::vector<int32>,
                 LmState*, VectorHasher<int32> > seq_to_state_;
+
+  // If positive, the number of bits to quantize to when writing.
+  int32 quantize_bits_;
 };
 
 void ConstArpaLmBuilder::HeaderAvailable() {
   ngram_order_ = NgramCounts().size();
+  // We create an LmState for every n-gram except those of the highest order;
+  // sizing the hash table now avoids rehashing it while reading.
+  size_t num_states = 0;
+  for (int32 i = 0; i < ngram_order_; i++)
+    if (i + 1 < ngram_order_ || ngram_order_ == 1)
+      num_states += NgramCounts()[i];
+  seq_to_state_.reserve(num_states);
 }
 
 void ConstArpaLmBuilder::ConsumeNGram(const NGram &ngram) {
@@ -491,15 +995,98 @@ void ConstArpaLmBuilder::Write(std::ostream &os, bool binary) const {
       Options().bos_symbol, Options().eos_symbol, Options().unk_symbol,
       ngram_order_, num_words_, overflow_buffer_size_, lm_states_size_,
       unigram_states_, overflow_buffer_, lm_states_);
+  if (quantize_bits_ > 0)
+    const_arpa_lm.Quantize(quantize_bits_);
   const_arpa_lm.Write(os, binary);
 }
 
+ConstArpaLm::~ConstArpaLm() {
+  if (memory_assigned_) {
+    delete[] lm_states_;
+    delete[] unigram_states_;
+    delete[] overflow_buffer_;
+  }
+  delete quantized_;
+}
+
+void ConstArpaLm::Quantize(int32 num_bits) {
+  KALDI_ASSERT(initialized_ && quantized_ == NULL);
+  if (num_bits < 2 || num_bits > 16)
+    KALDI_ERR << "Invalid number of bits for quantization " << num_bits
+              << " (expected 2 to 16)";
+
+  // Collect the n-grams of each order in the order that QuantizedArpaTrie
+  // needs: the n-grams of order one by word, and the others by parent and then
+  // word.  'states' are the LmStates of the current order's n-grams, or NULL
+  // for leaves.
+  typedef QuantizedArpaTrie::Entry Entry;
+  std::vector<std::vector<Entry> > entries(ngram_order_);
+  std::vector<int32*> states, next_states;
+  entries[0].resize(num_words_);
+  for (int32 w = 0; w < num_words_; w++) {
+    Entry &e = entries[0][w];
+    int32 *state = unigram_states_[w];
+    e.word = (state == NULL ? -1 : w);
+    e.logprob = (state == NULL ? 0.0 : Int32AndFloat(*state).f);
+    e.backoff_logprob = (state == NULL ? 0.0 : Int32AndFloat(*(state + 1)).f);
+    e.num_children = 0;
+    states.push_back(state);
+  }
+  for (int32 k = 0; k + 1 < ngram_order_; k++) {
+    next_states.clear();
+    for (size_t i = 0; i < states.size(); i++) {
+      int32 *state = states[i];
+      if (state == NULL) continue;
+      int32 num_children = *(state + 2);
+      entries[k][i].num_children = num_children;
+      for (int32 c = 0; c < num_children; c++) {
+        Entry e;
+        e.word = *(state + 3 + 2 * c);
+        int32 *child_state = NULL;
+        DecodeChildInfo(*(state + 4 + 2 * c), state, &child_state, &e.logprob);
+        e.backoff_logprob = (child_state == NULL ? 0.0 :
+                             Int32AndFloat(*(child_state + 1)).f);
+        e.num_children = 0;
+        entries[k + 1].push_back(e);
+        next_states.push_back(child_state);
+      }
+    }
+    states.swap(next_states);
+  }
+  quantized_ = new QuantizedArpaTrie();
+  quantized_->Init(num_bits, entries);
+
+  // We no longer need the unquantized LM.
+  if (memory_assigned_) {
+    delete[] lm_states_;
+    delete[] unigram_states_;
+    delete[] overflow_buffer_;
+    memory_assigned_ = false;
+  }
+  lm_states_ = NULL;
+  unigram_states_ = NULL;
+  overflow_buffer_ = NULL;
+}
+
 void ConstArpaLm::Write(std::ostream &os, bool binary) const {
   KALDI_ASSERT(initialized_);
   if (!binary) {
     KALDI_ERR << "text-mode writing is not implemented for ConstArpaLm.";
   }
 
+  if (quantized_ != NULL) {
+    WriteToken(os, binary, "<QuantizedConstArpaLm>");
+    WriteToken(os, binary, "<LmInfo>");
+    WriteBasicType(os, binary, bos_symbol_);
+    WriteBasicType(os, binary, eos_symbol_);
+    WriteBasicType(os, binary, unk_symbol_);
+    WriteBasicType(os, binary, ngram_order_);
+    WriteToken(os, binary, "</LmInfo>");
+    quantized_->Write(os, binary);
+    WriteToken(os, binary, "</QuantizedConstArpaLm>");
+    return;
+  }
+
   WriteToken(os, binary, "<ConstArpaLm>");
 
   // Misc info.
@@ -571,6 +1158,21 @@ void ConstArpaLm::Write(std::ostream &os, bool binary) const {
 }
 
 void ConstArpaLm::Read(std::istream &is, bool binary) {
+  ReadInternalAny(is, binary, "");
+}
+
+void ConstArpaLm::ReadMapped(const std::string &filename) {
+  std::ifstream is(filename.c_str(), std::ios::binary);
+  if (!is.is_open())
+    KALDI_ERR << "Could not open " << filename << " for reading.";
+  bool binary;
+  if (!InitKaldiInputStream(is, &binary))
+    KALDI_ERR << "Could not initialize stream reading " << filename;
+  ReadInternalAny(is, binary, filename);
+}
+
+void ConstArpaLm::ReadInternalAny(std::istream &is, bool binary,
+                                  const std::string &map_filename) {
   KALDI_ASSERT(!initialized_);
   if (!binary) {
     KALDI_ERR << "text-mode reading is not implemented for ConstArpaLm.";
@@ -579,18 +1181,52 @@ void ConstArpaLm::Read(std::istream &is, bool binary) {
   int first_char = is.peek();
   if (first_char == 4) {  // Old on-disk format starts with length of int32.
     ReadInternalOldFormat(is, binary);
-  } else {                // New on-disk format starts with token <ConstArpaLm>.
-    ReadInternal(is, binary);
+  } else {                // Newer on-disk formats start with a token.
+    std::string token;
+    ReadToken(is, binary, &token);
+    if (token == "<ConstArpaLm>")
+      ReadInternal(is, binary);
+    else if (token == "<QuantizedConstArpaLm>")
+      ReadInternalQuantized(is, binary, map_filename);
+    else
+      KALDI_ERR << "Expected <ConstArpaLm> or <QuantizedConstArpaLm>, got "
+                << token;
   }
 }
 
+void ConstArpaLm::ReadInternalQuantized(std::istream &is, bool binary,
+                                        const std::string &map_filename) {
+  KALDI_ASSERT(!initialized_);
+  ExpectToken(is, binary, "<LmInfo>");
+  ReadBasicType(is, binary, &bos_symbol_);
+  ReadBasicType(is, binary, &eos_symbol_);
+  ReadBasicType(is, binary, &unk_symbol_);
+  ReadBasicType(is, binary, &ngram_order_);
+  ExpectToken(is, binary, "</LmInfo>");
+  quantized_ = new QuantizedArpaTrie();
+  quantized_->Read(is, binary, map_filename);
+  ExpectToken(is, binary, "</QuantizedConstArpaLm>");
+
+  num_words_ = quantized_->NumWords();
+  KALDI_ASSERT(ngram_order_ > 0 && quantized_->NgramOrder() == ngram_order_);
+  KALDI_ASSERT(bos_symbol_ < num_words_ && bos_symbol_ > 0);
+  KALDI_ASSERT(eos_symbol_ < num_words_ && eos_symbol_ > 0);
+  KALDI_ASSERT(unk_symbol_ < num_words_ &&
+               (unk_symbol_ > 0 || unk_symbol_ == -1));
+  lm_states_ = NULL;
+  unigram_states_ = NULL;
+  overflow_buffer_ = NULL;
+  memory_assigned_ = false;
+  initialized_ = true;
+}
+
 void ConstArpaLm::ReadInternal(std::istream &is, bool binary) {
   KALDI_ASSERT(!initialized_);
   if (!binary) {
     KALDI_ERR << "text-mode reading is not implemented for ConstArpaLm.";
   }
 
-  ExpectToken(is, binary, "<ConstArpaLm>");
+  // The token <ConstArpaLm> has already been read by ReadInternalAny().
 
   // Misc info.
   ExpectToken(is, binary, "<LmInfo>");
@@ -718,6 +1354,14 @@ void ConstArpaLm::ReadInternalOldFormat(std::istream &is, bool binary) {
   initialized_ = true;
 }
 
+bool ConstArpaLm::HasUnigram(int32 word) const {
+  if (word < 0 || word >= num_words_)
+    return false;
+  if (quantized_ != NULL)
+    return quantized_->HasUnigram(word);
+  return unigram_states_[word] != NULL;
+}
+
 bool ConstArpaLm::HistoryStateExists(const std::vector<int32>& hist) const {
   // We do not create LmState for empty word sequence, but technically it is the
   // history state of all unigrams.
@@ -725,6 +1369,9 @@ bool ConstArpaLm::HistoryStateExists(const std::vector<int32>& hist) const {
     return true;
   }
 
+  if (quantized_ != NULL)
+    return quantized_->HistoryStateExists(hist);
+
   // Tries to locate the LmState of the given word sequence.
   int32* lm_state = GetLmState(hist);
   if (lm_state == NULL) {
@@ -764,19 +1411,20 @@ float ConstArpaLm::GetNgramLogprob(const int32 word,
   int32 mapped_word = word;
   if (unk_symbol_ != -1) {
     KALDI_ASSERT(mapped_word >= 0);
-    if (mapped_word >= num_words_ || unigram_states_[mapped_word] == NULL) {
+    if (!HasUnigram(mapped_word)) {
       mapped_word = unk_symbol_;
     }
     for (int32 i = 0; i < mapped_hist.size(); ++i) {
       KALDI_ASSERT(mapped_hist[i] >= 0);
-      if (mapped_hist[i] >= num_words_ ||
-          unigram_states_[mapped_hist[i]] == NULL) {
+      if (!HasUnigram(mapped_hist[i])) {
         mapped_hist[i] = unk_symbol_;
       }
     }
   }
 
   // Loops up n-gram probability.
+  if (quantized_ != NULL)
+    return quantized_->GetNgramLogprob(mapped_word, mapped_hist);
   return GetNgramLogprobRecurse(mapped_word, mapped_hist);
 }
 
@@ -953,10 +1601,14 @@ void ConstArpaLm::WriteArpa(std::ostream &os) const {
   KALDI_ASSERT(initialized_);
 
   std::vector<ArpaLine> tmp_output;
-  for (int32 i = 0; i < num_words_; ++i) {
-    if (unigram_states_[i] != NULL) {
-      std::vector<int32> seq(1, i);
-      WriteArpaRecurse(unigram_states_[i], seq, &tmp_output);
+  if (quantized_ != NULL) {
+    quantized_->GetArpaLines(&tmp_output);
+  } else {
+    for (int32 i = 0; i < num_words_; ++i) {
+      if (unigram_states_[i] != NULL) {
+        std::vector<int32> seq(1, i);
+        WriteArpaRecurse(unigram_states_[i], seq, &tmp_output);
+      }
     }
   }
 
@@ -1073,8 +1725,10 @@ bool ConstArpaLmDeterministicFst::GetArc(StateId s,
 
 bool BuildConstArpaLm(const ArpaParseOptions& options,
                       const std::string& arpa_rxfilename,
-                      const std::string& const_arpa_wxfilename) {
+                      const std::string& const_arpa_wxfilename,
+                      int32 quantize_bits) {
   ConstArpaLmBuilder lm_builder(options);
+  lm_builder.SetQuantizeBits(quantize_bits);
   KALDI_LOG << "Reading " << arpa_rxfilename;
   Input ki(arpa_rxfilename);
   lm_builder.Read(ki.Stream());
@@ -1082,4 +1736,11 @@ bool BuildConstArpaLm(const ArpaParseOptions& options,
   return true;
 }
 
+void ReadConstArpaLm(const std::string &rxfilename, ConstArpaLm *lm) {
+  if (ClassifyRxfilename(rxfilename) == kFileInput)
+    lm->ReadMapped(rxfilename);
+  else
+    ReadKaldiObject(rxfilename, lm);
+}
+
 }  // namespace kaldi
@@ -199,6 +199,10 @@ namespace kaldi {
 // Forward declaration of Auxiliary struct ArpaLine.
 struct ArpaLine;
 
+// Forward declaration of the class that holds the quantized format of
+// ConstArpaLm; see ConstArpaLm::Quantize().
+class QuantizedArpaTrie;
+
 union Int32AndFloat {
   int32 i;
   float f;
@@ -220,6 +224,7 @@ class ConstArpaLm {
     memory_assigned_ = false;
     initialized_ = false;
     ngram_order_ = 0;
+    quantized_ = NULL;
   }
 
   // Special constructor, will be used when you initialize ConstArpaLm from
@@ -245,23 +250,41 @@ class ConstArpaLm {
     lm_states_end_ = lm_states_ + lm_states_size_ - 1;
     memory_assigned_ = false;
     initialized_ = true;
+    quantized_ = NULL;
   }
 
-  ~ConstArpaLm() {
-    if (memory_assigned_) {
-      delete[] lm_states_;
-      delete[] unigram_states_;
-      delete[] overflow_buffer_;
-    }
-  }
+  ~ConstArpaLm();
 
-  // Reads the ConstArpaLm format language model. It calls ReadInternal() or
-  // ReadInternalOldFormat() to do the actual reading.
+  // Reads the ConstArpaLm format language model. It calls ReadInternal(),
+  // ReadInternalOldFormat() or ReadInternalQuantized() to do the actual
+  // reading.
   void Read(std::istream &is, bool binary);
 
-  // Writes the language model in ConstArpaLm format.
+  // Like Read(), but reads from the file 'filename', which must be an actual
+  // file.  If the LM is in the quantized format, the bulk of it is
+  // memory-mapped instead of being read into memory, so that all the processes
+  // on a machine that use the same LM share one copy of it.  You will normally
+  // call this via ReadConstArpaLm().
+  void ReadMapped(const std::string &filename);
+
+  // Writes the language model in ConstArpaLm format, or in the quantized
+  // format if Quantize() has been called.
   void Write(std::ostream &os, bool binary) const;
 
+  // Converts the language model to the quantized format, which uses about 2.5
+  // times less memory with num_bits = 8 (and less than 2 times less with
+  // num_bits = 16).  Instead of the LmState structures described above, the
+  // n-grams of each order are stored in bit-packed arrays, with the children of
+  // each n-gram stored contiguously in the arrays of the next order (sorted by
+  // word).  Word ids and child indexes use only as many bits as they need, and
+  // the logprobs and backoff logprobs of orders above one are replaced by
+  // indexes into per-order codebooks of size 2^num_bits; unigrams and zero
+  // backoffs are stored exactly.  num_bits must be in the range 2 to 16.  After
+  // this is called, Write() writes the quantized format.
+  void Quantize(int32 num_bits);
+
+  bool IsQuantized() const { return quantized_ != NULL; }
+
   // Creates Arpa format language model from ConstArpaLm format, and writes it
   // to output stream. This will be useful in testing.
   void WriteArpa(std::ostream &os) const;
@@ -284,6 +307,19 @@ class ConstArpaLm {
   // Function that loads data from stream to the class.
   void ReadInternal(std::istream &is, bool binary);
 
+  // Implements Read() and ReadMapped(); 'map_filename' is the filename if we
+  // are to memory-map the quantized format, else empty.
+  void ReadInternalAny(std::istream &is, bool binary,
+                       const std::string &map_filename);
+
+  // Function that loads the quantized format.  The token
+  // <QuantizedConstArpaLm> has already been read.
+  void ReadInternalQuantized(std::istream &is, bool binary,
+                             const std::string &map_filename);
+
+  // Returns true if 'word' is in the language model as a unigram.
+  bool HasUnigram(int32 word) const;
+
   // Function that loads data from stream to the class. This is a deprecated one
   // that handles the old on-disk format. We keep this for back-compatibility
   // purpose. We have modified the Write() function so for all the new on-disk
@@ -384,6 +420,11 @@ class ConstArpaLm {
   //
   // x = 1 + 1 + 1 + 2 * children.size() = 3 + 2 * children.size()
   int32* lm_states_;
+
+  // If the language model is in the quantized format, it is stored here and
+  // <lm_states_>, <unigram_states_> and <overflow_buffer_> are not used; else
+  // NULL.
+  QuantizedArpaTrie *quantized_;
 };
 
 /**
@@ -420,10 +461,17 @@ class ConstArpaLmDeterministicFst
 
 // Reads in an Arpa format language model and converts it into ConstArpaLm
 // format. We assume that the words in the input Arpa format language model have
-// been converted into integers.
+// been converted into integers.  If quantize_bits > 0, writes the quantized
+// format (see ConstArpaLm::Quantize()).
 bool BuildConstArpaLm(const ArpaParseOptions& options,
                       const std::string& arpa_rxfilename,
-                      const std::string& const_arpa_wxfilename);
+                      const std::string& const_arpa_wxfilename,
+                      int32 quantize_bits = 0);
+
+// Reads a ConstArpaLm from 'rxfilename'.  This is like ReadKaldiObject(), but
+// if 'rxfilename' is an actual file the quantized format is memory-mapped (see
+// ConstArpaLm::ReadMapped()).
+void ReadConstArpaLm(const std::string &rxfilename, ConstArpaLm *lm);
 
 }  // namespace kaldi
 
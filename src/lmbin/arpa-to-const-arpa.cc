@@ -40,11 +40,16 @@ int main(int argc, char *argv[]) {
         "\n"
         "Usage: arpa-to-const-arpa [opts] <input-arpa> <const-arpa>\n"
         " e.g.: arpa-to-const-arpa --bos-symbol=1 --eos-symbol=2 \\\n"
-        "                          arpa.txt const_arpa";
+        "                          arpa.txt const_arpa\n"
+        "\n"
+        "With --quantize-bits, writes a quantized format that uses about 2.5\n"
+        "times less memory (with 8 bits) and is memory-mapped when it is read\n"
+        "from a file, so processes on the same machine share one copy of it.\n";
 
     kaldi::ParseOptions po(usage);
 
     ArpaParseOptions options;
+    int32 quantize_bits = 0;
     options.Register(&po);
 
     // Ideally, these registrations would be in ArpaParseOptions, but some
@@ -59,6 +64,10 @@ int main(int argc, char *argv[]) {
     po.Register("eos-symbol", &options.eos_symbol,
                 "Integer corresponds to </s>. You must set this to your actual "
                 "EOS integer.");
+    po.Register("quantize-bits", &quantize_bits,
+                "If positive, write the quantized format, in which the "
+                "logprobs and backoffs of n-grams above order one are "
+                "quantized to this many bits (2 to 16, e.g. 8).");
 
     po.Read(argc, argv);
 
@@ -72,11 +81,15 @@ int main(int argc, char *argv[]) {
       exit(1);
     }
 
+    if (quantize_bits != 0 && (quantize_bits < 2 || quantize_bits > 16))
+      KALDI_ERR << "--quantize-bits must be 0 or in the range 2 to 16, got "
+                << quantize_bits;
+
     std::string arpa_rxfilename = po.GetArg(1),
         const_arpa_wxfilename = po.GetOptArg(2);
 
     bool ans = BuildConstArpaLm(options, arpa_rxfilename,
-                                const_arpa_wxfilename);
+                                const_arpa_wxfilename, quantize_bits);
     if (ans)
       return 0;
     else
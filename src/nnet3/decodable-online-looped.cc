@@ -26,7 +26,8 @@ namespace nnet3 {
 DecodableNnetLoopedOnlineBase::DecodableNnetLoopedOnlineBase(
     const DecodableNnetSimpleLoopedInfo &info,
     OnlineFeatureInterface *input_features,
-    OnlineFeatureInterface *ivector_features):
+    OnlineFeatureInterface *ivector_features,
+    NnetBatchOnlineComputer *batch_computer):
     num_chunks_computed_(0),
     current_log_post_subsampled_offset_(-1),
     info_(info),
@@ -34,7 +35,8 @@ DecodableNnetLoopedOnlineBase::DecodableNnetLoopedOnlineBase(
     input_features_(input_features),
     ivector_features_(ivector_features),
     computer_(info_.opts.compute_config, info_.computation,
-              info_.nnet, NULL) {   // NULL is 'nnet_to_update'
+              info_.nnet, NULL),   // NULL is 'nnet_to_update'
+    batch_computer_(batch_computer) {
   // Check that feature dimensions match.
   KALDI_ASSERT(input_features_ != NULL);
   int32 nnet_input_dim = info_.nnet.InputDim("input"),
@@ -50,6 +52,10 @@ DecodableNnetLoopedOnlineBase::DecodableNnetLoopedOnlineBase(
     KALDI_ERR << "Ivector feature dimension mismatch: got " << feat_ivector_dim
               << " but network expects " << nnet_ivector_dim;
   }
+  if (batch_computer_ != NULL &&
+      batch_computer_->GetOptions().acoustic_scale != info_.opts.acoustic_scale)
+    KALDI_ERR << "Acoustic scale of the batch computer does not match that "
+              << "of the decodable object.";
 }
 
 
@@ -115,7 +121,47 @@ void DecodableNnetLoopedOnlineBase::SetFrameOffset(int32 frame_offset) {
   frame_offset_ = frame_offset;
 }
 
+void DecodableNnetLoopedOnlineBase::GetInputFeatures(
+    int32 begin_input_frame, int32 end_input_frame,
+    int32 num_feature_frames_ready, Matrix<BaseFloat> *feats) {
+  feats->Resize(end_input_frame - begin_input_frame,
+                input_features_->Dim(), kUndefined);
+  for (int32 i = begin_input_frame; i < end_input_frame; i++) {
+    SubVector<BaseFloat> this_row(*feats, i - begin_input_frame);
+    int32 input_frame = i;
+    if (input_frame < 0) input_frame = 0;
+    if (input_frame >= num_feature_frames_ready)
+      input_frame = num_feature_frames_ready - 1;
+    input_features_->GetFrame(input_frame, &this_row);
+  }
+}
+
+void DecodableNnetLoopedOnlineBase::GetIvector(int32 most_recent_input_frame,
+                                               Vector<BaseFloat> *ivector) {
+  KALDI_ASSERT(ivector_features_ != NULL);
+  ivector->Resize(ivector_features_->Dim());
+  // we just get the iVector from the last input frame we needed,
+  // reduced as necessary
+  // we don't bother trying to be 'accurate' in getting the iVectors
+  // for their 'correct' frames, because in general using the
+  // iVector from as large 't' as possible will be better.
+  int32 num_ivector_frames_ready = ivector_features_->NumFramesReady();
+
+  if (num_ivector_frames_ready > 0) {
+    int32 ivector_frame_to_use = std::min<int32>(
+        most_recent_input_frame, num_ivector_frames_ready - 1);
+    ivector_features_->GetFrame(ivector_frame_to_use, ivector);
+  }
+  // else just leave the iVector zero (would only happen with very small
+  // chunk-size, like a chunk size of 2 which would be very inefficient; and
+  // only at file begin.
+}
+
 void DecodableNnetLoopedOnlineBase::AdvanceChunk() {
+  if (batch_computer_ != NULL) {
+    AdvanceChunkBatched();
+    return;
+  }
   // Prepare the input data for the next chunk of features.
   // note: 'end' means one past the last.
   int32 begin_input_frame, end_input_frame;
@@ -152,16 +198,9 @@ void DecodableNnetLoopedOnlineBase::AdvanceChunk() {
 
   CuMatrix<BaseFloat> feats_chunk;
   { // this block sets 'feats_chunk'.
-    Matrix<BaseFloat> this_feats(end_input_frame - begin_input_frame,
-                                 input_features_->Dim());
-    for (int32 i = begin_input_frame; i < end_input_frame; i++) {
-      SubVector<BaseFloat> this_row(this_feats, i - begin_input_frame);
-      int32 input_frame = i;
-      if (input_frame < 0) input_frame = 0;
-      if (input_frame >= num_feature_frames_ready)
-        input_frame = num_feature_frames_ready - 1;
-      input_features_->GetFrame(input_frame, &this_row);
-    }
+    Matrix<BaseFloat> this_feats;
+    GetInputFeatures(begin_input_frame, end_input_frame,
+                     num_feature_frames_ready, &this_feats);
     feats_chunk.Swap(&this_feats);
   }
   computer_.AcceptInput("input", &feats_chunk);
@@ -176,25 +215,8 @@ void DecodableNnetLoopedOnlineBase::AdvanceChunk() {
 			  info_.request2.inputs[1].indexes.size());
     KALDI_ASSERT(num_ivectors > 0);
 
-    Vector<BaseFloat> ivector(ivector_features_->Dim());
-    // we just get the iVector from the last input frame we needed,
-    // reduced as necessary
-    // we don't bother trying to be 'accurate' in getting the iVectors
-    // for their 'correct' frames, because in general using the
-    // iVector from as large 't' as possible will be better.
-
-    int32 most_recent_input_frame = num_feature_frames_ready - 1,
-      num_ivector_frames_ready = ivector_features_->NumFramesReady();
-
-    if (num_ivector_frames_ready > 0) {
-      int32 ivector_frame_to_use = std::min<int32>(
-          most_recent_input_frame, num_ivector_frames_ready - 1);
-      ivector_features_->GetFrame(ivector_frame_to_use,
-                                  &ivector);
-    }
-    // else just leave the iVector zero (would only happen with very small
-    // chunk-size, like a chunk size of 2 which would be very inefficient; and
-    // only at file begin.
+    Vector<BaseFloat> ivector;
+    GetIvector(num_feature_frames_ready - 1, &ivector);
 
     // note: we expect num_ivectors to be 1 in practice.
     Matrix<BaseFloat> ivectors(num_ivectors,
@@ -235,6 +257,114 @@ void DecodableNnetLoopedOnlineBase::AdvanceChunk() {
       (info_.frames_per_chunk / info_.opts.frame_subsampling_factor);
 }
 
+DecodableNnetLoopedOnlineBase::~DecodableNnetLoopedOnlineBase() {
+  // The batch computer may still be writing to these.
+  for (; !prepared_tasks_.empty(); prepared_tasks_.pop_front()) {
+    prepared_tasks_.front()->semaphore.Wait();
+    delete prepared_tasks_.front();
+  }
+}
+
+int32 DecodableNnetLoopedOnlineBase::NumChunksReady() const {
+  // This follows NumFramesReady(), but counts the chunks from the start.
+  int32 features_ready = input_features_->NumFramesReady();
+  if (features_ready == 0)
+    return 0;
+  bool input_finished = input_features_->IsLastFrame(features_ready - 1);
+  int32 sf = info_.opts.frame_subsampling_factor;
+  if (input_finished) {
+    int32 output_frames_per_chunk = info_.frames_per_chunk / sf,
+        num_output_frames = (features_ready + sf - 1) / sf;
+    return (num_output_frames + output_frames_per_chunk - 1) /
+        output_frames_per_chunk;
+  } else {
+    return std::max<int32>(0, features_ready - info_.frames_right_context) /
+        info_.frames_per_chunk;
+  }
+}
+
+void DecodableNnetLoopedOnlineBase::PrepareChunkTasks(
+    std::vector<NnetInferenceTask*> *tasks) {
+  KALDI_ASSERT(batch_computer_ != NULL);
+  int32 num_chunks_ready = NumChunksReady();
+  for (int32 c = num_chunks_computed_ + prepared_tasks_.size();
+       c < num_chunks_ready; c++) {
+    NnetInferenceTask *task = NewChunkTask(c);
+    prepared_tasks_.push_back(task);
+    tasks->push_back(task);
+  }
+}
+
+NnetInferenceTask *DecodableNnetLoopedOnlineBase::NewChunkTask(
+    int32 chunk_index) {
+  // Unlike the looped computation, every chunk is computed from scratch, so
+  // it needs its full left and right context.
+  int32 begin_output_frame = chunk_index * info_.frames_per_chunk,
+      begin_input_frame = begin_output_frame - info_.frames_left_context,
+      end_input_frame = begin_output_frame + info_.frames_per_chunk +
+                        info_.frames_right_context;
+
+  int32 num_feature_frames_ready = input_features_->NumFramesReady();
+  bool is_finished = input_features_->IsLastFrame(num_feature_frames_ready - 1);
+  if (end_input_frame > num_feature_frames_ready && !is_finished)
+    KALDI_ERR << "Attempt to access frame past the end of the available input";
+
+  int32 sf = info_.opts.frame_subsampling_factor,
+      num_output_frames = info_.frames_per_chunk / sf;
+
+  NnetInferenceTask *task = new NnetInferenceTask();
+  {
+    Matrix<BaseFloat> feats;
+    GetInputFeatures(begin_input_frame, end_input_frame,
+                     num_feature_frames_ready, &feats);
+    task->input.Swap(&feats);
+  }
+  task->first_input_t = -info_.frames_left_context;
+  task->output_t_stride = sf;
+  task->num_output_frames = num_output_frames;
+  task->num_initial_unused_output_frames = 0;
+  task->num_used_output_frames = num_output_frames;
+  task->first_used_output_frame_index = begin_output_frame / sf;
+  task->is_edge = false;
+  task->is_irregular = false;
+  if (info_.has_ivectors) {
+    Vector<BaseFloat> ivector;
+    GetIvector(num_feature_frames_ready - 1, &ivector);
+    task->ivector.Swap(&ivector);
+  }
+  // Streams that are further behind get their chunks computed first.
+  task->priority = -begin_output_frame;
+  task->output_to_cpu = true;
+  return task;
+}
+
+void DecodableNnetLoopedOnlineBase::AdvanceChunkBatched() {
+  NnetInferenceTask *task;
+  if (!prepared_tasks_.empty()) {
+    task = prepared_tasks_.front();
+    prepared_tasks_.pop_front();
+    task->semaphore.Wait();
+  } else {
+    task = NewChunkTask(num_chunks_computed_);
+    // This blocks until the chunk has been computed.
+    batch_computer_->ComputeTask(task);
+  }
+  // The batch computer has already subtracted the log-priors and applied the
+  // acoustic scale.
+  int32 num_output_frames =
+      info_.frames_per_chunk / info_.opts.frame_subsampling_factor;
+  current_log_post_.Resize(0, 0);
+  current_log_post_.Swap(&task->output_cpu);
+  delete task;
+  KALDI_ASSERT(current_log_post_.NumRows() == num_output_frames &&
+               current_log_post_.NumCols() == info_.output_dim);
+
+  num_chunks_computed_++;
+
+  current_log_post_subsampled_offset_ =
+      (num_chunks_computed_ - 1) * num_output_frames;
+}
+
 BaseFloat DecodableNnetLoopedOnline::LogLikelihood(int32 subsampled_frame,
                                                     int32 index) {
   subsampled_frame += frame_offset_;
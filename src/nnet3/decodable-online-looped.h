@@ -22,12 +22,16 @@
 #ifndef KALDI_NNET3_DECODABLE_ONLINE_LOOPED_H_
 #define KALDI_NNET3_DECODABLE_ONLINE_LOOPED_H_
 
+#include <deque>
+#include <vector>
+
 #include "itf/online-feature-itf.h"
 #include "itf/decodable-itf.h"
 #include "nnet3/am-nnet-simple.h"
 #include "nnet3/nnet-compute.h"
 #include "nnet3/nnet-optimize.h"
 #include "nnet3/decodable-simple-looped.h"
+#include "nnet3/nnet-batch-compute.h"
 #include "hmm/transition-model.h"
 
 namespace kaldi {
@@ -58,9 +62,15 @@ class DecodableNnetLoopedOnlineBase: public DecodableInterface {
   // Constructor.  'input_feature' is for the feature that will be given
   // as 'input' to the neural network; 'ivector_feature' is for the iVector
   // feature, or NULL if iVectors are not being used.
+  // If 'batch_computer' is non-NULL, each chunk is computed (with its left
+  // and right context) by that object, batched together with the chunks of
+  // other decoders that share it, instead of by the looped computation; see
+  // the documentation of class NnetBatchOnlineComputer for when that is
+  // appropriate.
   DecodableNnetLoopedOnlineBase(const DecodableNnetSimpleLoopedInfo &info,
                                  OnlineFeatureInterface *input_features,
-                                 OnlineFeatureInterface *ivector_features);
+                                 OnlineFeatureInterface *ivector_features,
+                                 NnetBatchOnlineComputer *batch_computer = NULL);
 
   // note: the LogLikelihood function is not overridden; the child
   // class needs to do this.
@@ -93,6 +103,18 @@ class DecodableNnetLoopedOnlineBase: public DecodableInterface {
   /// Returns the frame offset value.
   int32 GetFrameOffset() const { return frame_offset_; }
 
+  /// Only for use with a batch computer.  Creates the tasks for the chunks
+  /// whose input is ready and that have not been computed or prepared yet, and
+  /// appends them to 'tasks'.  The caller must give them to the batch
+  /// computer's SubmitTasks() (typically together with those of other
+  /// decodables) before the next call to LogLikelihood(), which uses them
+  /// instead of computing the chunks one at a time.  This object keeps
+  /// ownership of the tasks.
+  void PrepareChunkTasks(std::vector<NnetInferenceTask*> *tasks);
+
+  /// Waits for any prepared tasks that have not been used yet.
+  virtual ~DecodableNnetLoopedOnlineBase();
+
  protected:
 
   /// If the neural-network outputs for this frame are not cached, this function
@@ -134,11 +156,41 @@ class DecodableNnetLoopedOnlineBase: public DecodableInterface {
   // increment num_chunks_computed_.
   void AdvanceChunk();
 
+  // Used by AdvanceChunk() if batch_computer_ != NULL: does the computation
+  // for the next chunk (with its left and right context) via batch_computer_,
+  // or waits for it if it was prepared by PrepareChunkTasks().
+  void AdvanceChunkBatched();
+
+  // Returns a newly allocated task for chunk 'chunk_index' (with its left and
+  // right context), for batch_computer_.
+  NnetInferenceTask *NewChunkTask(int32 chunk_index);
+
+  // Returns the number of chunks whose input is ready (including ones that
+  // have been computed already).
+  int32 NumChunksReady() const;
+
+  // Gets the iVector to use for a chunk whose most recent input frame is
+  // 'most_recent_input_frame' (zero if none is ready yet).
+  void GetIvector(int32 most_recent_input_frame, Vector<BaseFloat> *ivector);
+
+  // Gets the input features for frames begin_input_frame <= t <
+  // end_input_frame, padding at the edges with copies of the first and last
+  // available frames.
+  void GetInputFeatures(int32 begin_input_frame, int32 end_input_frame,
+                        int32 num_feature_frames_ready,
+                        Matrix<BaseFloat> *feats);
+
   OnlineFeatureInterface *input_features_;
   OnlineFeatureInterface *ivector_features_;
 
   NnetComputer computer_;
 
+  NnetBatchOnlineComputer *batch_computer_;
+
+  // The tasks from PrepareChunkTasks() that have not been used yet, for chunks
+  // num_chunks_computed_, num_chunks_computed_ + 1, and so on.
+  std::deque<NnetInferenceTask*> prepared_tasks_;
+
   KALDI_DISALLOW_COPY_AND_ASSIGN(DecodableNnetLoopedOnlineBase);
 };
 
@@ -155,8 +207,10 @@ class DecodableNnetLoopedOnline: public DecodableNnetLoopedOnlineBase {
   DecodableNnetLoopedOnline(
       const DecodableNnetSimpleLoopedInfo &info,
       OnlineFeatureInterface *input_features,
-      OnlineFeatureInterface *ivector_features):
-      DecodableNnetLoopedOnlineBase(info, input_features, ivector_features) { }
+      OnlineFeatureInterface *ivector_features,
+      NnetBatchOnlineComputer *batch_computer = NULL):
+      DecodableNnetLoopedOnlineBase(info, input_features, ivector_features,
+                                    batch_computer) { }
 
 
   // returns the output-dim of the neural net.
@@ -186,8 +240,10 @@ class DecodableAmNnetLoopedOnline: public DecodableNnetLoopedOnlineBase {
       const TransitionModel &trans_model,
       const DecodableNnetSimpleLoopedInfo &info,
       OnlineFeatureInterface *input_features,
-      OnlineFeatureInterface *ivector_features):
-      DecodableNnetLoopedOnlineBase(info, input_features, ivector_features),
+      OnlineFeatureInterface *ivector_features,
+      NnetBatchOnlineComputer *batch_computer = NULL):
+      DecodableNnetLoopedOnlineBase(info, input_features, ivector_features,
+                                    batch_computer),
       trans_model_(trans_model) { }
 
 
@@ -20,6 +20,7 @@
 #include "nnet3/decodable-simple-looped.h"
 #include "nnet3/nnet-utils.h"
 #include "nnet3/nnet-compile-looped.h"
+#include "nnet3/nnet-computation-disk-cache.h"
 
 namespace kaldi {
 namespace nnet3 {
@@ -82,8 +83,29 @@ void DecodableNnetSimpleLoopedInfo::Init(
                                  num_sequences,
                                  &request1, &request2, &request3);
 
-  CompileLooped(*nnet, opts.optimize_config, request1, request2, request3,
-                &computation);
+  if (opts.computation_cache.empty()) {
+    CompileLooped(*nnet, opts.optimize_config, request1, request2, request3,
+                  &computation);
+  } else {
+    // The key covers everything that CompileLooped() depends on.  Note: the
+    // nnet has already been modified for the ivector period, so that is
+    // reflected in the model hash.
+    std::ostringstream os;
+    bool binary = true;
+    WriteToken(os, binary, "<CompileLooped>");
+    opts.optimize_config.Write(os, binary);
+    request1.Write(os, binary);
+    request2.Write(os, binary);
+    request3.Write(os, binary);
+    disk_cache = NnetComputationDiskCache::GetShared(opts.computation_cache,
+                                                     *nnet);
+    if (!disk_cache->Lookup(os.str(), &computation)) {
+      CompileLooped(*nnet, opts.optimize_config, request1, request2, request3,
+                    &computation);
+      disk_cache->Insert(os.str(), computation);
+      disk_cache->Write();
+    }
+  }
   computation.ComputeCudaIndexes();
   KALDI_VLOG(3) << "Computation is:\n"
                 << NnetComputationPrintInserter{computation, *nnet};
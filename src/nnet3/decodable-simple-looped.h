@@ -49,6 +49,7 @@ struct NnetSimpleLoopedComputationOptions {
   int32 frames_per_chunk;
   BaseFloat acoustic_scale;
   bool debug_computation;
+  std::string computation_cache;
   NnetOptimizeOptions optimize_config;
   NnetComputeOptions compute_config;
   NnetSimpleLoopedComputationOptions():
@@ -83,6 +84,12 @@ struct NnetSimpleLoopedComputationOptions {
                    "if needed.");
     opts->Register("debug-computation", &debug_computation, "If true, turn on "
                    "debug for the actual computation (very verbose!)");
+    opts->Register("computation-cache", &computation_cache,
+                   "If set, a file in which the compiled computation is kept "
+                   "between runs of the program, to save start-up time; it is "
+                   "created if it does not exist.  It is best kept next to the "
+                   "model, e.g. final.mdl.cache; it can be shared by programs "
+                   "run in parallel.");
 
     // register the optimization options with the prefix "optimization".
     ParseOptions optimization_opts("optimization", opts);
@@ -151,6 +158,11 @@ class DecodableNnetSimpleLoopedInfo  {
 
   // The compiled, 'looped' computation.
   NnetComputation computation;
+
+  // The cache that 'computation' was looked up in, if --computation-cache was
+  // set.  It is shared by all DecodableNnetSimpleLoopedInfo objects for the
+  // same model and file, so it is only read once.
+  std::shared_ptr<NnetComputationDiskCache> disk_cache;
 };
 
 /*
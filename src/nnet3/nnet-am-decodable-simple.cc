@@ -317,14 +317,25 @@ DecodableAmNnetSimpleParallel::DecodableAmNnetSimpleParallel(
     const MatrixBase<BaseFloat> &feats,
     const VectorBase<BaseFloat> *ivector,
     const MatrixBase<BaseFloat> *online_ivectors,
-    int32 online_ivector_period):
-    compiler_(am_nnet.GetNnet(), opts.optimize_config, opts.compiler_config),
+    int32 online_ivector_period,
+    CachingOptimizingCompiler *compiler):
+    own_compiler_(NULL),
     trans_model_(trans_model),
     feats_copy_(NULL),
     ivector_copy_(NULL),
     online_ivectors_copy_(NULL),
     decodable_nnet_(NULL) {
   try {
+    if (compiler == NULL) {
+      // A compiler that only lives as long as this object should not use the
+      // disk cache: each one would read the file and write it back.
+      CachingOptimizingCompilerOptions compiler_config(opts.compiler_config);
+      compiler_config.computation_cache = "";
+      own_compiler_ = new CachingOptimizingCompiler(am_nnet.GetNnet(),
+                                                    opts.optimize_config,
+                                                    compiler_config);
+      compiler = own_compiler_;
+    }
     feats_copy_ = new Matrix<BaseFloat>(feats);
     if (ivector != NULL)
       ivector_copy_ = new Vector<BaseFloat>(*ivector);
@@ -332,7 +343,7 @@ DecodableAmNnetSimpleParallel::DecodableAmNnetSimpleParallel(
       online_ivectors_copy_ = new Matrix<BaseFloat>(*online_ivectors);
     decodable_nnet_ = new DecodableNnetSimple(opts, am_nnet.GetNnet(),
                                               am_nnet.Priors(), *feats_copy_,
-                                              &compiler_, ivector_copy_,
+                                              compiler, ivector_copy_,
                                               online_ivectors_copy_,
                                               online_ivector_period);
 
@@ -346,6 +357,8 @@ void DecodableAmNnetSimpleParallel::DeletePointers() {
   // delete[] does nothing for null pointers, so we have no checks.
   delete decodable_nnet_;
   decodable_nnet_ = NULL;
+  delete own_compiler_;
+  own_compiler_ = NULL;
   delete feats_copy_;
   feats_copy_ = NULL;
   delete ivector_copy_;
@@ -94,6 +94,12 @@ struct NnetSimpleComputationOptions {
                    "input frames");
     opts->Register("debug-computation", &debug_computation, "If true, turn on "
                    "debug for the actual computation (very verbose!)");
+    opts->Register("computation-cache", &compiler_config.computation_cache,
+                   "If set, a file in which compiled computations are kept "
+                   "between runs of the program, to save compilation time; it "
+                   "is created if it does not exist.  It is best kept next to "
+                   "the model, e.g. final.mdl.cache; it can be shared by "
+                   "programs run in parallel.");
 
     // register the optimization options with the prefix "optimization".
     ParseOptions optimization_opts("optimization", opts);
@@ -356,11 +362,13 @@ class DecodableAmNnetSimpleParallel: public DecodableInterface {
         (1) It doesn't keep around pointers to the features and iVectors;
             instead, it creates copies of them (so the caller can
             delete the originals).
-        (2) It doesn't support the user passing in a pointer to the
-            CachingOptimizingCompiler-- because making that thread safe
-            would be quite complicated, and in any case multi-threaded
-            decoding probably makes the most sense when using CPU, and
-            in that case we don't expect the compilation phase to dominate.
+        (2) If you pass in a pointer to a CachingOptimizingCompiler, it
+            may be shared by all the decodable objects that exist at the
+            same time (its Compile() function is thread safe).  That is
+            required if you use the --computation-cache option, so that the
+            cache file is read once at the start of the program and written
+            once at the end; without a shared compiler each object creates
+            its own compiler, and the --computation-cache option is ignored.
 
      This constructor takes features as input, and you can either supply a
      single iVector input, estimated in batch-mode ('ivector'), or 'online'
@@ -385,6 +393,11 @@ class DecodableAmNnetSimpleParallel: public DecodableInterface {
      @param [in] online_ivector_period If you are using iVectors estimated 'online'
                         (i.e. if online_ivectors != NULL) gives the periodicity
                         (in frames) with which the iVectors are estimated.
+     @param [in] compiler  A pointer to a compiler shared between threads (see
+                        (2) above), or NULL to use a compiler owned by this
+                        object.  It should have been constructed with
+                        am_nnet.GetNnet(), opts.optimize_config and
+                        opts.compiler_config.
   */
   DecodableAmNnetSimpleParallel(
       const NnetSimpleComputationOptions &opts,
@@ -393,7 +406,8 @@ class DecodableAmNnetSimpleParallel: public DecodableInterface {
       const MatrixBase<BaseFloat> &feats,
       const VectorBase<BaseFloat> *ivector = NULL,
       const MatrixBase<BaseFloat> *online_ivectors = NULL,
-      int32 online_ivector_period = 1);
+      int32 online_ivector_period = 1,
+      CachingOptimizingCompiler *compiler = NULL);
 
 
   virtual BaseFloat LogLikelihood(int32 frame, int32 transition_id);
@@ -414,7 +428,8 @@ class DecodableAmNnetSimpleParallel: public DecodableInterface {
   KALDI_DISALLOW_COPY_AND_ASSIGN(DecodableAmNnetSimpleParallel);
   void DeletePointers();
 
-  CachingOptimizingCompiler compiler_;
+  // NULL if the caller supplied a compiler.
+  CachingOptimizingCompiler *own_compiler_;
   const TransitionModel &trans_model_;
 
   Matrix<BaseFloat> *feats_copy_;
@@ -34,7 +34,7 @@ NnetBatchComputer::NnetBatchComputer(
     const VectorBase<BaseFloat> &priors):
     opts_(opts),
     nnet_(nnet),
-    compiler_(nnet_, opts.optimize_config),
+    compiler_(nnet_, opts.optimize_config, opts.compiler_config),
     log_priors_(priors),
     num_full_minibatches_(0) {
   log_priors_.ApplyLog();
@@ -1185,6 +1185,56 @@ void NnetBatchInference::Compute() {
 }
 
 
+NnetBatchOnlineComputer::NnetBatchOnlineComputer(
+    const NnetBatchComputerOptions &opts,
+    const Nnet &nnet,
+    const VectorBase<BaseFloat> &priors):
+    computer_(opts, nnet, priors),
+    is_finished_(false) {
+  if (NnetIsRecurrent(nnet))
+    KALDI_WARN << "The neural net is recurrent; batched online computation "
+               << "will not give the same output as looped computation.";
+  compute_thread_ = std::thread(ComputeFunc, this);
+}
+
+void NnetBatchOnlineComputer::ComputeTask(NnetInferenceTask *task) {
+  KALDI_ASSERT(task->output_to_cpu);
+  computer_.AcceptTask(task);
+  tasks_ready_semaphore_.Signal();
+  task->semaphore.Wait();
+}
+
+void NnetBatchOnlineComputer::SubmitTasks(
+    const std::vector<NnetInferenceTask*> &tasks) {
+  for (size_t i = 0; i < tasks.size(); i++) {
+    KALDI_ASSERT(tasks[i]->output_to_cpu);
+    computer_.AcceptTask(tasks[i]);
+  }
+  // One signal is enough: Compute() keeps going until nothing is left.
+  if (!tasks.empty())
+    tasks_ready_semaphore_.Signal();
+}
+
+NnetBatchOnlineComputer::~NnetBatchOnlineComputer() {
+  is_finished_ = true;
+  tasks_ready_semaphore_.Signal();
+  compute_thread_.join();
+}
+
+// This is run as the thread of class NnetBatchOnlineComputer.
+void NnetBatchOnlineComputer::Compute() {
+  while (true) {
+    tasks_ready_semaphore_.Wait();
+    if (is_finished_)
+      return;
+    // Partial minibatches are always allowed: there is no end of input to
+    // wait for, and the streams are blocked until their chunks are done.
+    bool allow_partial_minibatch = true;
+    while (computer_.Compute(allow_partial_minibatch));
+  }
+}
+
+
 NnetBatchDecoder::NnetBatchDecoder(
     const fst::Fst<fst::StdArc> &fst,
     const LatticeFasterDecoderConfig &decoder_opts,
@@ -21,6 +21,7 @@
 #ifndef KALDI_NNET3_NNET_BATCH_COMPUTE_H_
 #define KALDI_NNET3_NNET_BATCH_COMPUTE_H_
 
+#include <atomic>
 #include <vector>
 #include <string>
 #include <list>
@@ -603,6 +604,80 @@ class NnetBatchInference {
 };
 
 
+/**
+   This class lets many online decoders, each running in its own thread, share
+   one NnetBatchComputer, so that the chunks of all the live streams are
+   evaluated together in minibatches (larger matrix multiplications) instead of
+   each stream running its own small computation.  It is intended for use on
+   CPU, via the 'batch_computer' argument of class
+   DecodableNnetLoopedOnlineBase.
+
+   Each stream submits one chunk at a time with ComputeTask(), which blocks
+   until that chunk's output is ready.  The computation is done in a single
+   background thread, which computes whatever is pending as soon as it is
+   free: while it is busy with one minibatch, chunks from other streams queue
+   up and go into the next one, so the minibatches get larger as the load
+   increases, without adding latency when the load is light.  A caller that
+   drives many streams from one thread can instead queue all their chunks at
+   once with SubmitTasks() and wait for them afterwards.
+
+   Because each chunk is computed with its full left and right context,
+   the output is identical to the looped computation only for models without
+   recurrence (TDNN, TDNN-F, CNN); for recurrent models each chunk would see
+   only its explicit left context.
+ */
+class NnetBatchOnlineComputer {
+ public:
+  /// The arguments are as for the constructor of class NnetBatchComputer.
+  /// The acoustic scale and the priors must be the same as those used for
+  /// the corresponding DecodableNnetSimpleLoopedInfo.
+  NnetBatchOnlineComputer(const NnetBatchComputerOptions &opts,
+                          const Nnet &nnet,
+                          const VectorBase<BaseFloat> &priors);
+
+  /// Queues the task and waits until it has been computed.  The caller should
+  /// set 'output_to_cpu' to true.  May be called from multiple threads at
+  /// once.
+  void ComputeTask(NnetInferenceTask *task);
+
+  /// Queues all of 'tasks' and returns without waiting; the background thread
+  /// is only woken up once they are all queued, so they are computed together
+  /// in minibatches of up to opts.minibatch_size.  Wait for each task with
+  /// task->semaphore.Wait() before using its output or deleting it.  The
+  /// caller should set 'output_to_cpu' to true.
+  void SubmitTasks(const std::vector<NnetInferenceTask*> &tasks);
+
+  const NnetBatchComputerOptions &GetOptions() {
+    return computer_.GetOptions();
+  }
+
+  /// The destructor waits for the background thread to finish; it must not be
+  /// called while any thread is still inside ComputeTask().
+  ~NnetBatchOnlineComputer();
+
+ private:
+  KALDI_DISALLOW_COPY_AND_ASSIGN(NnetBatchOnlineComputer);
+
+  // This is the computation thread, which is run in the background until the
+  // destructor is called.
+  void Compute();
+  static void ComputeFunc(NnetBatchOnlineComputer *object) {
+    object->Compute();
+  }
+
+  NnetBatchComputer computer_;
+
+  // Set in the destructor to make the computation thread exit; atomic because
+  // that thread reads it without a lock.
+  std::atomic<bool> is_finished_;
+
+  // Signaled once for every task accepted, and once by the destructor.
+  Semaphore tasks_ready_semaphore_;
+
+  std::thread compute_thread_;
+};
+
+
 /**
    Decoder object that uses multiple CPU threads for the graph search, plus a
    GPU for the neural net inference (that's done by a separate
@@ -531,7 +531,31 @@ void ChainExampleMerger::WriteMinibatch(
       suffix = "?lang=" + output_name.substr(pos+1, len);
   }
   key << "merged-" << (num_egs_written_++) << "-" << minibatch_size << suffix;
-  writer_->Write(key.str(), merged_eg);
+  if (writer_ != NULL) {
+    writer_->Write(key.str(), merged_eg);
+  } else {
+    NnetChainExample *eg = new NnetChainExample();
+    eg->Swap(&merged_eg);
+    merged_egs_.push_back(std::make_pair(key.str(), eg));
+  }
+}
+
+bool ChainExampleMerger::TakeMinibatch(std::string *key,
+                                       NnetChainExample *eg) {
+  KALDI_ASSERT(writer_ == NULL);
+  if (merged_egs_.empty())
+    return false;
+  *key = merged_egs_.front().first;
+  eg->Swap(merged_egs_.front().second);
+  delete merged_egs_.front().second;
+  merged_egs_.pop_front();
+  return true;
+}
+
+ChainExampleMerger::~ChainExampleMerger() {
+  Finish();
+  for (size_t i = 0; i < merged_egs_.size(); i++)
+    delete merged_egs_[i].second;
 }
 
 void ChainExampleMerger::Finish() {
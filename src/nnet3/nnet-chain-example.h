@@ -234,6 +234,8 @@ int32 GetChainNnetExampleSize(const NnetChainExample &a);
 /// in suitable minibatches as defined by ExampleMergingConfig.
 class ChainExampleMerger {
  public:
+  // If 'writer' is NULL, the merged examples are kept in this class
+  // instead of being written, and can be obtained with TakeMinibatch().
   ChainExampleMerger(const ExampleMergingConfig &config,
                      NnetChainExampleWriter *writer);
 
@@ -252,7 +254,12 @@ class ChainExampleMerger {
   // returns a suitable exit status for a program.
   int32 ExitStatus() { Finish(); return (num_egs_written_ > 0 ? 0 : 1); }
 
-  ~ChainExampleMerger() { Finish(); };
+  // Only usable if 'writer' was NULL in the constructor: if any merged
+  // examples are waiting, outputs the oldest one to 'key' and 'eg' and
+  // returns true; otherwise returns false.
+  bool TakeMinibatch(std::string *key, NnetChainExample *eg);
+
+  ~ChainExampleMerger();
  private:
   // called by Finish() and AcceptExample().  Merges, updates the stats, and
   // writes.  The 'egs' is non-const only because the egs are temporarily
@@ -272,6 +279,9 @@ class ChainExampleMerger {
                         NnetChainExampleStructureHasher,
                         NnetChainExampleStructureCompare> MapType;
 MapType eg_to_egs_;
+
+  // The merged examples, if 'writer_' is NULL.
+  std::deque<std::pair<std::string, NnetChainExample*> > merged_egs_;
 };
 
 
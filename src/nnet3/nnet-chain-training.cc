@@ -20,6 +20,7 @@
 
 #include "nnet3/nnet-chain-training.h"
 #include "nnet3/nnet-utils.h"
+#include "util/kaldi-thread.h"
 
 namespace kaldi {
 namespace nnet3 {
@@ -34,14 +35,27 @@ NnetChainTrainer::NnetChainTrainer(const NnetChainTrainingOptions &opts,
               opts_.nnet_config.compiler_config),
     num_minibatches_processed_(0),
     max_change_stats_(*nnet),
-    srand_seed_(RandInt(0, 100000)) {
+    srand_seed_(RandInt(0, 100000)),
+    buckets_(opts.nnet_config),
+    warned_padding_(false),
+    parallel_nnets_(NULL) {
+  // See the corresponding check in NnetTrainer::NnetTrainer().
+  if (!buckets_.Empty() && HasBatchnorm(*nnet))
+    KALDI_ERR << "--minibatch-buckets cannot be used with a model that has "
+              << "batch-norm components.";
   if (opts.nnet_config.zero_component_stats)
     ZeroComponentStats(nnet);
   KALDI_ASSERT(opts.nnet_config.momentum >= 0.0 &&
                opts.nnet_config.max_param_change >= 0.0 &&
-               opts.nnet_config.backstitch_training_interval > 0);
+               opts.nnet_config.backstitch_training_interval > 0 &&
+               opts.nnet_config.num_threads > 0);
   delta_nnet_ = nnet_->Copy();
   ScaleNnet(0.0, delta_nnet_);
+  if (opts.nnet_config.num_threads > 1) {
+    CheckDataParallelConfig(opts.nnet_config);
+    parallel_nnets_ = new DataParallelNnets(opts.nnet_config.num_threads,
+                                            nnet_, delta_nnet_);
+  }
 
   if (opts.nnet_config.read_cache != "") {
     bool binary;
@@ -59,15 +73,32 @@ NnetChainTrainer::NnetChainTrainer(const NnetChainTrainingOptions &opts,
 
 void NnetChainTrainer::Train(const NnetChainExample &chain_eg) {
   NVTX_RANGE(__func__);
-  bool need_model_derivative = true;
+  if (parallel_nnets_ != NULL) {
+    pending_egs_.push_back(chain_eg);
+    if (static_cast<int32>(pending_egs_.size()) ==
+        parallel_nnets_->NumWorkers())
+      TrainParallel();
+    return;
+  }
+  int32 num_sequences = GetNumNvalues(chain_eg.inputs, false);
+  if (buckets_.PaddedSize(num_sequences) != num_sequences) {
+    NnetChainExample padded_eg(chain_eg);
+    // The padding sequences must not enter the component stats (which the
+    // self-repair of nonlinearities is based on), so padded minibatches do
+    // not store them.
+    bool padded = PadMinibatch(num_sequences, &padded_eg);
+    TrainMinibatch(padded_eg, num_sequences, !padded);
+  } else {
+    TrainMinibatch(chain_eg, num_sequences, true);
+  }
+}
+
+void NnetChainTrainer::TrainMinibatch(const NnetChainExample &chain_eg,
+                                      int32 num_sequences,
+                                      bool store_component_stats) {
   const NnetTrainerOptions &nnet_config = opts_.nnet_config;
-  bool use_xent_regularization = (opts_.chain_config.xent_regularize != 0.0);
-  ComputationRequest request;
-  GetChainComputationRequest(*nnet_, chain_eg, need_model_derivative,
-                             nnet_config.store_component_stats,
-                             use_xent_regularization, need_model_derivative,
-                             &request);
-  std::shared_ptr<const NnetComputation> computation = compiler_.Compile(request);
+  std::shared_ptr<const NnetComputation> computation =
+      GetComputation(chain_eg, store_component_stats);
 
   if (nnet_config.backstitch_training_scale > 0.0 && num_minibatches_processed_
       % nnet_config.backstitch_training_interval ==
@@ -78,14 +109,16 @@ void NnetChainTrainer::Train(const NnetChainExample &chain_eg) {
     bool is_backstitch_step1 = true;
     srand(srand_seed_ + num_minibatches_processed_);
     ResetGenerators(nnet_);
-    TrainInternalBackstitch(chain_eg, *computation, is_backstitch_step1);
+    TrainInternalBackstitch(chain_eg, *computation, num_sequences,
+                            is_backstitch_step1);
     FreezeNaturalGradient(false, delta_nnet_); // un-freeze natural gradient
     is_backstitch_step1 = false;
     srand(srand_seed_ + num_minibatches_processed_);
     ResetGenerators(nnet_);
-    TrainInternalBackstitch(chain_eg, *computation, is_backstitch_step1);
+    TrainInternalBackstitch(chain_eg, *computation, num_sequences,
+                            is_backstitch_step1);
   } else { // conventional training
-    TrainInternal(chain_eg, *computation);
+    TrainInternal(chain_eg, *computation, num_sequences);
   }
   if (num_minibatches_processed_ == 0) {
     ConsolidateMemory(nnet_);
@@ -94,8 +127,69 @@ void NnetChainTrainer::Train(const NnetChainExample &chain_eg) {
   num_minibatches_processed_++;
 }
 
+std::shared_ptr<const NnetComputation> NnetChainTrainer::GetComputation(
+    const NnetChainExample &eg, bool store_component_stats) {
+  bool need_model_derivative = true;
+  bool use_xent_regularization = (opts_.chain_config.xent_regularize != 0.0);
+  ComputationRequest request;
+  GetChainComputationRequest(*nnet_, eg, need_model_derivative,
+                             store_component_stats &&
+                             opts_.nnet_config.store_component_stats,
+                             use_xent_regularization, need_model_derivative,
+                             &request);
+  // If the inputs were padded (see PadMinibatch()), pad the outputs to match;
+  // as in the supervision, their rows are ordered by 't' and then 'n'.
+  int32 num_sequences = GetNumNvalues(eg.inputs, false);
+  for (size_t i = 0; i < request.outputs.size(); i++) {
+    std::vector<Index> &indexes = request.outputs[i].indexes;
+    if (indexes.back().n + 1 != num_sequences) {
+      std::vector<Index> padded_indexes;
+      bool n_innermost = true;
+      bool ans = ChangeNumNValues(indexes, num_sequences, n_innermost,
+                                  &padded_indexes, NULL);
+      KALDI_ASSERT(ans);
+      indexes.swap(padded_indexes);
+    }
+  }
+  if (!buckets_.Empty())
+    buckets_.Precompile(request, &compiler_);
+  return compiler_.Compile(request);
+}
+
+bool NnetChainTrainer::PadMinibatch(int32 num_sequences,
+                                    NnetChainExample *eg) {
+  int32 padded_size = buckets_.PaddedSize(num_sequences);
+  // Only the inputs are padded: an NnetChainSupervision must have as many
+  // sequences as its supervision, so GetComputation() pads the outputs of the
+  // computation request instead.  We check that everything can be padded
+  // before padding anything, so that 'eg' is not left half-padded.
+  std::vector<Index> indexes;
+  bool ok = true;
+  for (size_t i = 0; i < eg->inputs.size() && ok; i++)
+    ok = ChangeNumNValues(eg->inputs[i].indexes, padded_size, false,
+                          &indexes, NULL);
+  for (size_t i = 0; i < eg->outputs.size() && ok; i++)
+    ok = ChangeNumNValues(eg->outputs[i].indexes, padded_size, true,
+                          &indexes, NULL);
+  if (!ok) {
+    if (!warned_padding_) {
+      KALDI_WARN << "Could not pad a minibatch for --minibatch-buckets, "
+                 << "because its indexes do not have the usual structure; "
+                 << "not padding it (will warn only once).";
+      warned_padding_ = true;
+    }
+    return false;
+  }
+  for (size_t i = 0; i < eg->inputs.size(); i++) {
+    bool ans = PadNnetIo(padded_size, false, &(eg->inputs[i]));
+    KALDI_ASSERT(ans);
+  }
+  return true;
+}
+
 void NnetChainTrainer::TrainInternal(const NnetChainExample &eg,
-                                     const NnetComputation &computation) {
+                                     const NnetComputation &computation,
+                                     int32 num_sequences) {
   NVTX_RANGE(__func__);
   const NnetTrainerOptions &nnet_config = opts_.nnet_config;
   // note: because we give the 1st arg (nnet_) as a pointer to the
@@ -108,14 +202,15 @@ void NnetChainTrainer::TrainInternal(const NnetChainExample &eg,
   computer.AcceptInputs(*nnet_, eg.inputs);
   computer.Run();
 
-  this->ProcessOutputs(false, eg, &computer);
+  std::vector<MinibatchObjf> objfs;
+  this->ProcessOutputs(false, eg, &computer, &objfs);
+  UpdateObjfStats(objfs, num_minibatches_processed_);
   computer.Run();
 
   // If relevant, add in the part of the gradient that comes from
   // parameter-level L2 regularization.
   ApplyL2Regularization(*nnet_,
-                        GetNumNvalues(eg.inputs, false) *
-                        nnet_config.l2_regularize_factor,
+                        num_sequences * nnet_config.l2_regularize_factor,
                         delta_nnet_);
 
   // Updates the parameters of nnet
@@ -142,6 +237,7 @@ void NnetChainTrainer::TrainInternal(const NnetChainExample &eg,
 
 void NnetChainTrainer::TrainInternalBackstitch(const NnetChainExample &eg,
                                                const NnetComputation &computation,
+                                               int32 num_sequences,
                                                bool is_backstitch_step1) {
   const NnetTrainerOptions &nnet_config = opts_.nnet_config;
   // note: because we give the 1st arg (nnet_) as a pointer to the
@@ -154,7 +250,9 @@ void NnetChainTrainer::TrainInternalBackstitch(const NnetChainExample &eg,
   computer.Run();
 
   bool is_backstitch_step2 = !is_backstitch_step1;
-  this->ProcessOutputs(is_backstitch_step2, eg, &computer);
+  std::vector<MinibatchObjf> objfs;
+  this->ProcessOutputs(is_backstitch_step2, eg, &computer, &objfs);
+  UpdateObjfStats(objfs, num_minibatches_processed_);
   computer.Run();
 
   BaseFloat max_change_scale, scale_adding;
@@ -173,7 +271,7 @@ void NnetChainTrainer::TrainInternalBackstitch(const NnetChainExample &eg,
     // passes of the backstitch, like we do here, but it probably minimizes
     // any harmful interactions with the max-change.
     ApplyL2Regularization(*nnet_,
-        1.0 / scale_adding * GetNumNvalues(eg.inputs, false) *
+        1.0 / scale_adding * num_sequences *
         nnet_config.l2_regularize_factor, delta_nnet_);
   }
 
@@ -201,9 +299,130 @@ void NnetChainTrainer::TrainInternalBackstitch(const NnetChainExample &eg,
   ScaleNnet(0.0, delta_nnet_);
 }
 
+// The class that runs the workers of data-parallel training in their threads.
+class NnetChainTrainer::WorkerClass: public MultiThreadable {
+ public:
+  explicit WorkerClass(NnetChainTrainer *trainer): trainer_(trainer) { }
+  void operator () () {
+    int32 num_egs = trainer_->pending_egs_.size();
+    for (int32 w = thread_id_; w < num_egs; w += num_threads_)
+      trainer_->TrainWorker(w);
+  }
+ private:
+  NnetChainTrainer *trainer_;
+};
+
+void NnetChainTrainer::TrainParallel() {
+  NVTX_RANGE(__func__);
+  const NnetTrainerOptions &nnet_config = opts_.nnet_config;
+  int32 num_egs = pending_egs_.size();
+  if (num_egs == 0)
+    return;
+  pending_computations_.resize(num_egs);
+  pending_objfs_.resize(num_egs);
+  int32 num_nvalues = 0;
+  for (int32 w = 0; w < num_egs; w++) {
+    int32 num_sequences = GetNumNvalues(pending_egs_[w].inputs, false);
+    num_nvalues += num_sequences;
+    bool padded = false;
+    if (buckets_.PaddedSize(num_sequences) != num_sequences)
+      padded = PadMinibatch(num_sequences, &(pending_egs_[w]));
+    // Only worker 0 uses the model nnet_ itself, so the component stats are
+    // only stored for its minibatches (and, as in Train(), not if they were
+    // padded).
+    bool store_component_stats = (w == 0 && !padded);
+    pending_computations_[w] = GetComputation(pending_egs_[w],
+                                              store_component_stats);
+  }
+  {
+    // The destructor of 'threader' waits for the threads.
+    MultiThreader<WorkerClass> threader(num_egs, WorkerClass(this));
+  }
+  for (int32 w = 0; w < num_egs; w++)
+    UpdateObjfStats(pending_objfs_[w], num_minibatches_processed_ + w);
+
+  parallel_nnets_->SumDeltas(num_egs);
+
+  // The rest is as in TrainInternal(), for the sum of the minibatches.
+  ApplyL2Regularization(*nnet_, num_nvalues * nnet_config.l2_regularize_factor,
+                        delta_nnet_);
+  bool success = UpdateNnetWithMaxChange(
+      *delta_nnet_, nnet_config.max_param_change,
+      1.0, 1.0 - nnet_config.momentum, nnet_, &max_change_stats_);
+  ScaleBatchnormStats(nnet_config.batchnorm_stats_scale, nnet_);
+  ConstrainOrthonormal(nnet_);
+  if (success)
+    ScaleNnet(nnet_config.momentum, delta_nnet_);
+  else
+    ScaleNnet(0.0, delta_nnet_);
+
+  parallel_nnets_->CopyParams();
+  if (num_minibatches_processed_ == 0) {
+    ConsolidateMemory(nnet_);
+    ConsolidateMemory(delta_nnet_);
+  }
+  num_minibatches_processed_ += num_egs;
+  pending_egs_.clear();
+  pending_computations_.clear();
+  pending_objfs_.clear();
+}
+
+void NnetChainTrainer::TrainWorker(int32 worker) {
+  const NnetChainExample &eg = pending_egs_[worker];
+  Nnet *nnet = parallel_nnets_->GetNnet(worker);
+  NnetComputer computer(opts_.nnet_config.compute_config,
+                        *(pending_computations_[worker]),
+                        nnet, parallel_nnets_->GetDeltaNnet(worker));
+  computer.AcceptInputs(*nnet, eg.inputs);
+  computer.Run();
+  this->ProcessOutputs(false, eg, &computer, &(pending_objfs_[worker]));
+  computer.Run();
+}
+
+void NnetChainTrainer::Flush() {
+  if (parallel_nnets_ != NULL)
+    TrainParallel();
+}
+
+void NnetChainTrainer::UpdateObjfStats(const std::vector<MinibatchObjf> &objfs,
+                                       int32 minibatch_counter) {
+  for (size_t i = 0; i < objfs.size(); i++) {
+    const MinibatchObjf &objf = objfs[i];
+    objf_info_[objf.output_name].UpdateStats(objf.output_name,
+                                             opts_.nnet_config.print_interval,
+                                             minibatch_counter,
+                                             objf.tot_weight, objf.tot_objf,
+                                             objf.tot_aux_objf);
+  }
+}
+
+// Works out, for the output of a minibatch whose 'num_sequences' sequences
+// were padded to 'padded_num_sequences' (see NnetChainTrainer::PadMinibatch()),
+// which rows are those of the real sequences, in order, and for each row, its
+// index among those or -1 if it belongs to a padding sequence.  The rows are
+// ordered by 't' and then 'n', as in the supervision.
+static void GetPaddingRowMaps(int32 num_sequences,
+                              int32 padded_num_sequences,
+                              int32 frames_per_sequence,
+                              CuArray<MatrixIndexT> *real_rows,
+                              CuArray<MatrixIndexT> *padded_rows) {
+  std::vector<MatrixIndexT> real(num_sequences * frames_per_sequence),
+      padded(padded_num_sequences * frames_per_sequence, -1);
+  for (int32 t = 0; t < frames_per_sequence; t++) {
+    for (int32 n = 0; n < num_sequences; n++) {
+      int32 r = t * num_sequences + n, p = t * padded_num_sequences + n;
+      real[r] = p;
+      padded[p] = r;
+    }
+  }
+  real_rows->CopyFromVec(real);
+  padded_rows->CopyFromVec(padded);
+}
+
 void NnetChainTrainer::ProcessOutputs(bool is_backstitch_step2,
                                       const NnetChainExample &eg,
-                                      NnetComputer *computer) {
+                                      NnetComputer *computer,
+                                      std::vector<MinibatchObjf> *objfs) {
   NVTX_RANGE(__func__);
   // normally the eg will have just one output named 'output', but
   // we don't assume this.
@@ -219,7 +438,26 @@ void NnetChainTrainer::ProcessOutputs(bool is_backstitch_step2,
         !nnet_->IsOutputNode(node_index))
       KALDI_ERR << "Network has no output named " << sup.name;
 
-    const CuMatrixBase<BaseFloat> &nnet_output = computer->GetOutput(sup.name);
+    const CuMatrixBase<BaseFloat> &full_output = computer->GetOutput(sup.name);
+    // If the minibatch was padded (see --minibatch-buckets), the supervision
+    // only covers the real sequences, so we work on their rows only.
+    int32 num_rows = sup.supervision.num_sequences *
+        sup.supervision.frames_per_sequence;
+    bool padded = (full_output.NumRows() != num_rows);
+    CuArray<MatrixIndexT> real_rows, padded_rows;
+    CuMatrix<BaseFloat> real_output;
+    if (padded) {
+      int32 frames_per_sequence = sup.supervision.frames_per_sequence,
+          padded_num_sequences = full_output.NumRows() / frames_per_sequence;
+      KALDI_ASSERT(full_output.NumRows() ==
+                   padded_num_sequences * frames_per_sequence);
+      GetPaddingRowMaps(sup.supervision.num_sequences, padded_num_sequences,
+                        frames_per_sequence, &real_rows, &padded_rows);
+      real_output.Resize(num_rows, full_output.NumCols(), kUndefined);
+      real_output.CopyRows(full_output, real_rows);
+    }
+    const CuMatrixBase<BaseFloat> &nnet_output =
+        (padded ? real_output : full_output);
     CuMatrix<BaseFloat> nnet_output_deriv(nnet_output.NumRows(),
                                           nnet_output.NumCols(),
                                           kUndefined);
@@ -238,15 +476,21 @@ void NnetChainTrainer::ProcessOutputs(bool is_backstitch_step2,
 
     if (use_xent) {
       // this block computes the cross-entropy objective.
-      const CuMatrixBase<BaseFloat> &xent_output = computer->GetOutput(
+      const CuMatrixBase<BaseFloat> &full_xent_output = computer->GetOutput(
           xent_name);
+      CuMatrix<BaseFloat> real_xent_output;
+      if (padded) {
+        real_xent_output.Resize(num_rows, full_xent_output.NumCols(),
+                                kUndefined);
+        real_xent_output.CopyRows(full_xent_output, real_rows);
+      }
+      const CuMatrixBase<BaseFloat> &xent_output =
+          (padded ? real_xent_output : full_xent_output);
       // at this point, xent_deriv is posteriors derived from the numerator
       // computation.  note, xent_objf has a factor of '.supervision.weight'
       BaseFloat xent_objf = TraceMatMat(xent_output, xent_deriv, kTrans);
-      objf_info_[xent_name + suffix].UpdateStats(xent_name + suffix,
-                                        opts_.nnet_config.print_interval,
-                                        num_minibatches_processed_,
-                                        tot_weight, xent_objf);
+      objfs->push_back(MinibatchObjf(xent_name + suffix, tot_weight,
+                                     xent_objf));
     }
 
     if (opts_.apply_deriv_weights && sup.deriv_weights.Dim() != 0) {
@@ -256,12 +500,24 @@ void NnetChainTrainer::ProcessOutputs(bool is_backstitch_step2,
         xent_deriv.MulRowsVec(cu_deriv_weights);
     }
 
+    if (padded) {
+      // The derivatives for the padding sequences are zero.
+      CuMatrix<BaseFloat> full_deriv(full_output.NumRows(),
+                                     full_output.NumCols(), kUndefined);
+      full_deriv.CopyRows(nnet_output_deriv, padded_rows);
+      nnet_output_deriv.Swap(&full_deriv);
+      if (use_xent) {
+        CuMatrix<BaseFloat> full_xent_deriv(full_output.NumRows(),
+                                            xent_deriv.NumCols(), kUndefined);
+        full_xent_deriv.CopyRows(xent_deriv, padded_rows);
+        xent_deriv.Swap(&full_xent_deriv);
+      }
+    }
+
     computer->AcceptInput(sup.name, &nnet_output_deriv);
 
-    objf_info_[sup.name + suffix].UpdateStats(sup.name + suffix,
-                                     opts_.nnet_config.print_interval,
-                                     num_minibatches_processed_,
-                                     tot_weight, tot_objf, tot_l2_term);
+    objfs->push_back(MinibatchObjf(sup.name + suffix, tot_weight, tot_objf,
+                                   tot_l2_term));
 
     if (use_xent) {
       xent_deriv.Scale(opts_.chain_config.xent_regularize);
@@ -281,10 +537,15 @@ bool NnetChainTrainer::PrintTotalStats() const {
     ans = info.PrintTotalStats(name) || ans;
   }
   max_change_stats_.Print(*nnet_);
+  compiler_.PrintShapeStats();
   return ans;
 }
 
 NnetChainTrainer::~NnetChainTrainer() {
+  if (!pending_egs_.empty())
+    KALDI_WARN << "Not training on the last " << pending_egs_.size()
+               << " minibatches: Flush() was not called.";
+  delete parallel_nnets_;
   if (opts_.nnet_config.write_cache != "") {
     Output ko(opts_.nnet_config.write_cache, opts_.nnet_config.binary_write_cache);
     compiler_.WriteCache(ko.Stream(), opts_.nnet_config.binary_write_cache);
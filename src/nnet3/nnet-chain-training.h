@@ -49,8 +49,8 @@ struct NnetChainTrainingOptions {
 
 
 /**
-   This class is for single-threaded training of neural nets using the 'chain'
-   model.
+   This class is for training of neural nets using the 'chain' model.  It is
+   single-threaded unless --num-threads > 1; see DataParallelNnets.
 */
 class NnetChainTrainer {
  public:
@@ -58,27 +58,71 @@ class NnetChainTrainer {
                    const fst::StdVectorFst &den_fst,
                    Nnet *nnet);
 
-  // train on one minibatch.
+  // train on one minibatch.  With --num-threads=N > 1, the minibatches are
+  // kept until there are N of them, and then trained on together.
   void Train(const NnetChainExample &eg);
 
+  // With --num-threads > 1, trains on the minibatches that Train() has kept,
+  // if any.  Call this after the last call to Train().
+  void Flush();
+
   // Prints out the final stats, and return true if there was a nonzero count.
   bool PrintTotalStats() const;
 
   ~NnetChainTrainer();
  private:
+  class WorkerClass;
+
+  // Does one step of training on 'eg' (which may have been padded);
+  // 'num_sequences' is its number of sequences before padding.  If
+  // 'store_component_stats' is false, the component stats are not stored
+  // even if the config says to.
+  void TrainMinibatch(const NnetChainExample &eg, int32 num_sequences,
+                      bool store_component_stats);
+
   // The internal function for doing one step of conventional SGD training.
+  // 'num_sequences' is the number of sequences in 'eg' before padding.
   void TrainInternal(const NnetChainExample &eg,
-                     const NnetComputation &computation);
+                     const NnetComputation &computation,
+                     int32 num_sequences);
 
   // The internal function for doing one step of backstitch training. Depending
   // on whether is_backstitch_step1 is true, It could be either the first
   // (backward) step, or the second (forward) step of backstitch.
   void TrainInternalBackstitch(const NnetChainExample &eg,
                                const NnetComputation &computation,
+                               int32 num_sequences,
                                bool is_backstitch_step1);
 
+  // Pads the inputs of 'eg', which has 'num_sequences' sequences, to the size
+  // of its bucket (see --minibatch-buckets), in place.  The supervision is not
+  // padded: GetComputation() pads the outputs of the computation request, and
+  // ProcessOutputs() ignores the rows of the padding sequences.  If this is
+  // not possible, it warns, leaves 'eg' unchanged and returns false.
+  bool PadMinibatch(int32 num_sequences, NnetChainExample *eg);
+
+  // Returns the computation for 'eg', compiling it if needed.
+  std::shared_ptr<const NnetComputation> GetComputation(
+      const NnetChainExample &eg, bool store_component_stats);
+
+  // Computes the objective functions and supplies their derivatives to
+  // 'computer', and outputs the objective functions to 'objfs'.
   void ProcessOutputs(bool is_backstitch_step2, const NnetChainExample &eg,
-                      NnetComputer *computer);
+                      NnetComputer *computer,
+                      std::vector<MinibatchObjf> *objfs);
+
+  // Adds the objective functions of minibatch number 'minibatch_counter' to
+  // objf_info_.
+  void UpdateObjfStats(const std::vector<MinibatchObjf> &objfs,
+                       int32 minibatch_counter);
+
+  // Does one step of data-parallel training on the minibatches in
+  // pending_egs_, one per worker.
+  void TrainParallel();
+
+  // Does the forward and backward passes of worker 'worker' on its minibatch
+  // in pending_egs_.  Called from the worker's thread.
+  void TrainWorker(int32 worker);
 
   const NnetChainTrainingOptions opts_;
 
@@ -102,6 +146,18 @@ class NnetChainTrainer {
   // consistent dropout masks.  It's set to a value derived from rand()
   // when the class is initialized.
   int32 srand_seed_;
+
+  // The minibatch sizes to pad the minibatches to (--minibatch-buckets).
+  MinibatchBuckets buckets_;
+  bool warned_padding_;
+
+  // Things used in data-parallel training (--num-threads > 1).
+  DataParallelNnets *parallel_nnets_;  // NULL if --num-threads=1.
+  // The minibatches waiting to be trained on, and, during TrainParallel(),
+  // their computations and objective functions.
+  std::vector<NnetChainExample> pending_egs_;
+  std::vector<std::shared_ptr<const NnetComputation> > pending_computations_;
+  std::vector<std::vector<MinibatchObjf> > pending_objfs_;
 };
 
 
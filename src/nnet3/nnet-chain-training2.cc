@@ -42,6 +42,10 @@ NnetChainTrainer2::NnetChainTrainer2(const NnetChainTraining2Options &opts,
   KALDI_ASSERT(opts.nnet_config.momentum >= 0.0 &&
                opts.nnet_config.max_param_change >= 0.0 &&
                opts.nnet_config.backstitch_training_interval > 0);
+  if (opts.nnet_config.num_threads != 1)
+    KALDI_ERR << "--num-threads > 1 is not supported by this trainer.";
+  if (!opts.nnet_config.minibatch_buckets.empty())
+    KALDI_ERR << "--minibatch-buckets is not supported by this trainer.";
   delta_nnet_ = nnet_->Copy();
   ScaleNnet(0.0, delta_nnet_);
 
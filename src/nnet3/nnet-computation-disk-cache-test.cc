@@ -0,0 +1,190 @@
+// nnet3/nnet-computation-disk-cache-test.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstdio>
+#include <fstream>
+#include "nnet3/nnet-computation-disk-cache.h"
+#include "nnet3/nnet-compile.h"
+#include "nnet3/nnet-test-utils.h"
+
+namespace kaldi {
+namespace nnet3 {
+
+static const char *cache_filename = "tmp.nnet-computation-disk-cache-test";
+
+// Returns the binary form of 'computation', for comparing computations.
+static std::string ComputationString(const NnetComputation &computation) {
+  std::ostringstream os;
+  computation.Write(os, true);
+  return os.str();
+}
+
+static void GenerateNnetAndComputation(Nnet *nnet,
+                                       NnetComputation *computation) {
+  struct NnetGenerationOptions gen_config;
+  std::vector<std::string> configs;
+  GenerateConfigSequence(gen_config, &configs);
+  for (size_t j = 0; j < configs.size(); j++) {
+    std::istringstream is(configs[j]);
+    nnet->ReadConfig(is);
+  }
+  ComputationRequest request;
+  std::vector<Matrix<BaseFloat> > inputs;
+  ComputeExampleComputationRequestSimple(*nnet, &request, &inputs);
+  Compiler compiler(request, *nnet);
+  CompilerOptions opts;
+  compiler.CreateComputation(opts, computation);
+}
+
+// Replaces the file with its first 'size' bytes.
+static void TruncateFile(const std::string &filename, size_t size) {
+  std::string contents;
+  {
+    std::ifstream is(filename.c_str(), std::ios::binary);
+    KALDI_ASSERT(is.is_open());
+    std::ostringstream os;
+    os << is.rdbuf();
+    contents = os.str();
+  }
+  KALDI_ASSERT(size < contents.size());
+  std::ofstream os(filename.c_str(), std::ios::binary);
+  os.write(contents.data(), size);
+}
+
+void UnitTestNnetComputationDiskCache() {
+  Nnet nnet;
+  NnetComputation computation;
+  GenerateNnetAndComputation(&nnet, &computation);
+  std::string key = "some-request", key2 = "another-request";
+  std::remove(cache_filename);
+
+  {  // A cache file that does not exist yet.
+    NnetComputationDiskCache cache(cache_filename, nnet);
+    NnetComputation c;
+    KALDI_ASSERT(!cache.Lookup(key, &c));
+    cache.Insert(key, computation);
+    KALDI_ASSERT(cache.Lookup(key, &c) &&
+                 ComputationString(c) == ComputationString(computation));
+    // The destructor writes the file.
+  }
+  {  // Round trip: the computation is read back from the file.
+    NnetComputationDiskCache cache(cache_filename, nnet);
+    NnetComputation c;
+    KALDI_ASSERT(cache.Lookup(key, &c) &&
+                 ComputationString(c) == ComputationString(computation));
+    KALDI_ASSERT(!cache.Lookup(key2, &c));
+  }
+
+  // A different model has a different hash, so it must not see the
+  // computations of the first one; and when it writes the file, they are
+  // dropped.
+  Nnet nnet2(nnet);
+  nnet2.SetNodeName(0, nnet.GetNodeName(0) + "-renamed");
+  KALDI_ASSERT(NnetHashString(nnet) != NnetHashString(nnet2) &&
+               NnetHashString(nnet) == NnetHashString(Nnet(nnet)));
+  {
+    NnetComputationDiskCache cache(cache_filename, nnet2);
+    NnetComputation c;
+    KALDI_ASSERT(!cache.Lookup(key, &c));
+    cache.Insert(key2, computation);
+  }
+  {
+    NnetComputationDiskCache cache(cache_filename, nnet), cache2(cache_filename,
+                                                                 nnet2);
+    NnetComputation c;
+    KALDI_ASSERT(!cache.Lookup(key, &c) && !cache.Lookup(key2, &c));
+    KALDI_ASSERT(cache2.Lookup(key2, &c) &&
+                 ComputationString(c) == ComputationString(computation));
+  }
+
+  // Keys are compared in full, not by a hash: keys that differ only in their
+  // last byte, or that contain null bytes, are separate entries.
+  std::string long_key(1000, '\0'), long_key2(long_key);
+  long_key2[999] = 'x';
+  {
+    {
+      NnetComputationDiskCache cache(cache_filename, nnet);
+      cache.Insert(long_key, computation);
+    }
+    NnetComputationDiskCache cache(cache_filename, nnet);
+    NnetComputation c;
+    KALDI_ASSERT(cache.Lookup(long_key, &c) && !cache.Lookup(long_key2, &c));
+  }
+
+  // GetShared() returns the same object for the same file and model, as long
+  // as someone holds it.
+  {
+    std::shared_ptr<NnetComputationDiskCache>
+        shared = NnetComputationDiskCache::GetShared(cache_filename, nnet),
+        shared2 = NnetComputationDiskCache::GetShared(cache_filename, nnet),
+        shared3 = NnetComputationDiskCache::GetShared(cache_filename, nnet2);
+    KALDI_ASSERT(shared == shared2 && shared != shared3);
+    NnetComputation c;
+    KALDI_ASSERT(shared->Lookup(long_key, &c) &&
+                 !shared3->Lookup(long_key, &c));
+  }
+
+  // A truncated file is ignored (with a warning), and replaced by the next
+  // Write().
+  {
+    std::ifstream is(cache_filename, std::ios::binary | std::ios::ate);
+    size_t size = is.tellg();
+    is.close();
+    TruncateFile(cache_filename, RandInt(0, size - 1));
+  }
+  {
+    NnetComputationDiskCache cache(cache_filename, nnet2);
+    NnetComputation c;
+    KALDI_ASSERT(!cache.Lookup(key2, &c));
+    cache.Insert(key, computation);
+    cache.Write();
+  }
+  {
+    NnetComputationDiskCache cache(cache_filename, nnet2);
+    NnetComputation c;
+    KALDI_ASSERT(cache.Lookup(key, &c) &&
+                 ComputationString(c) == ComputationString(computation));
+  }
+
+  // So is a file with the wrong contents.
+  {
+    std::ofstream os(cache_filename, std::ios::binary);
+    os << "this is not a computation cache\n";
+  }
+  {
+    NnetComputationDiskCache cache(cache_filename, nnet2);
+    NnetComputation c;
+    KALDI_ASSERT(!cache.Lookup(key, &c));
+  }
+  std::remove(cache_filename);
+}
+
+
+} // namespace nnet3
+} // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  using namespace kaldi::nnet3;
+  SetVerboseLevel(2);
+  for (int32 i = 0; i < 5; i++)
+    UnitTestNnetComputationDiskCache();
+  KALDI_LOG << "Nnet computation disk cache tests succeeded.";
+  return 0;
+}
@@ -0,0 +1,211 @@
+// nnet3/nnet-computation-disk-cache.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#ifdef _MSC_VER
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+#include "nnet3/nnet-computation-disk-cache.h"
+
+namespace kaldi {
+namespace nnet3 {
+
+// 128-bit FNV-1a hash, as two 64-bit halves.  We don't use std::hash because
+// its value may differ between builds, and the hashes are stored on disk.  The
+// FNV prime is 2^88 + 0x13b, so multiplying by it only needs 64-bit
+// arithmetic.
+static void Fnv1aHash128(const std::string &str, uint64 *hi, uint64 *lo) {
+  uint64 h = 0x6c62272e07bb0142ULL, l = 0x62b821756295c58dULL;
+  for (size_t i = 0; i < str.size(); i++) {
+    l ^= static_cast<unsigned char>(str[i]);
+    uint64 a = (l & 0xffffffffULL) * 0x13b,
+        b = (l >> 32) * 0x13b + (a >> 32);
+    h = h * 0x13b + (b >> 32) + (l << 24);
+    l = (b << 32) | (a & 0xffffffffULL);
+  }
+  *hi = h;
+  *lo = l;
+}
+
+std::string NnetHashString(const Nnet &nnet) {
+  std::ostringstream os;
+  nnet.Write(os, true);
+  uint64 hi, lo;
+  Fnv1aHash128(os.str(), &hi, &lo);
+  std::ostringstream hash;
+  hash << std::hex << std::setfill('0') << std::setw(16) << hi
+       << std::setw(16) << lo;
+  return hash.str();
+}
+
+
+NnetComputationDiskCache::NnetComputationDiskCache(
+    const std::string &filename, const Nnet &nnet):
+    filename_(filename), model_hash_(NnetHashString(nnet)),
+    modified_(false) {
+  if (ReadEntries(&entries_))
+    KALDI_VLOG(1) << "Read " << entries_.size()
+                  << " computations for this model from " << filename_;
+}
+
+std::shared_ptr<NnetComputationDiskCache> NnetComputationDiskCache::GetShared(
+    const std::string &filename, const Nnet &nnet) {
+  typedef std::map<std::pair<std::string, const Nnet*>,
+                   std::weak_ptr<NnetComputationDiskCache> > RegistryType;
+  static RegistryType registry;
+  static std::mutex registry_mutex;
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  std::weak_ptr<NnetComputationDiskCache> &entry =
+      registry[std::make_pair(filename, &nnet)];
+  std::shared_ptr<NnetComputationDiskCache> ans = entry.lock();
+  if (ans == NULL) {
+    ans = std::make_shared<NnetComputationDiskCache>(filename, nnet);
+    entry = ans;
+  }
+  return ans;
+}
+
+bool NnetComputationDiskCache::Lookup(const std::string &key,
+                                      NnetComputation *computation) const {
+  std::shared_ptr<const NnetComputation> ans;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    MapType::const_iterator iter = entries_.find(key);
+    if (iter == entries_.end())
+      return false;
+    ans = iter->second;
+  }
+  *computation = *ans;
+  return true;
+}
+
+void NnetComputationDiskCache::Insert(const std::string &key,
+                                      const NnetComputation &computation) {
+  std::shared_ptr<const NnetComputation> c =
+      std::make_shared<const NnetComputation>(computation);
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::pair<MapType::iterator, bool> p =
+      entries_.insert(std::make_pair(key, c));
+  if (p.second)
+    modified_ = true;
+}
+
+// The keys are arbitrary binary strings, so they are written as their size
+// followed by their bytes.  The file is always in binary mode.
+static void WriteKey(const std::string &key, std::ostream &os) {
+  WriteBasicType(os, true, static_cast<int32>(key.size()));
+  os.write(key.data(), key.size());
+}
+
+static void ReadKey(std::istream &is, std::string *key) {
+  int32 size;
+  ReadBasicType(is, true, &size);
+  if (size < 0)
+    KALDI_ERR << "Invalid key size " << size;
+  key->resize(size);
+  if (size > 0 && !is.read(&((*key)[0]), size))
+    KALDI_ERR << "Error reading key";
+}
+
+bool NnetComputationDiskCache::ReadEntries(MapType *entries) const {
+  std::ifstream is(filename_.c_str(), std::ios::binary);
+  if (!is.is_open())
+    return false;
+  try {
+    bool binary;
+    if (!InitKaldiInputStream(is, &binary) || !binary)
+      KALDI_ERR << "Could not initialize stream";
+    ExpectToken(is, binary, "<NnetComputationDiskCache>");
+    ExpectToken(is, binary, "<NumComputations>");
+    int32 num_computations;
+    ReadBasicType(is, binary, &num_computations);
+    for (int32 i = 0; i < num_computations; i++) {
+      std::string model_hash, key;
+      ExpectToken(is, binary, "<Model>");
+      ReadToken(is, binary, &model_hash);
+      ExpectToken(is, binary, "<Key>");
+      ReadKey(is, &key);
+      std::shared_ptr<NnetComputation> computation =
+          std::make_shared<NnetComputation>();
+      computation->Read(is, binary);
+      if (model_hash == model_hash_)
+        entries->insert(std::make_pair(key, computation));
+    }
+    ExpectToken(is, binary, "</NnetComputationDiskCache>");
+    return true;
+  } catch (const std::exception &e) {
+    KALDI_WARN << "Error reading computation cache from " << filename_
+               << ", ignoring it.";
+    return false;
+  }
+}
+
+void NnetComputationDiskCache::Write() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!modified_)
+    return;
+  // Pick up anything that other processes have written since we read the
+  // file.
+  ReadEntries(&entries_);
+
+  std::ostringstream tmp_name;
+  tmp_name << filename_ << ".tmp." << getpid();
+  std::string tmp_filename = tmp_name.str();
+  try {
+    std::ofstream os(tmp_filename.c_str(), std::ios::binary);
+    if (!os.is_open())
+      KALDI_ERR << "Could not open " << tmp_filename << " for writing";
+    bool binary = true;
+    InitKaldiOutputStream(os, binary);
+    WriteToken(os, binary, "<NnetComputationDiskCache>");
+    WriteToken(os, binary, "<NumComputations>");
+    WriteBasicType(os, binary, static_cast<int32>(entries_.size()));
+    for (MapType::const_iterator iter = entries_.begin();
+         iter != entries_.end(); ++iter) {
+      WriteToken(os, binary, "<Model>");
+      WriteToken(os, binary, model_hash_);
+      WriteToken(os, binary, "<Key>");
+      WriteKey(iter->first, os);
+      iter->second->Write(os, binary);
+    }
+    WriteToken(os, binary, "</NnetComputationDiskCache>");
+    os.close();
+    if (os.fail())
+      KALDI_ERR << "Error writing to " << tmp_filename;
+    if (std::rename(tmp_filename.c_str(), filename_.c_str()) != 0)
+      KALDI_ERR << "Could not rename " << tmp_filename << " to " << filename_;
+    modified_ = false;
+    KALDI_VLOG(1) << "Wrote " << entries_.size() << " computations to "
+                  << filename_;
+  } catch (const std::exception &e) {
+    std::remove(tmp_filename.c_str());
+    KALDI_WARN << "Failed to write computation cache to " << filename_;
+  }
+}
+
+
+} // namespace nnet3
+} // namespace kaldi
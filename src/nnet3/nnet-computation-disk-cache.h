@@ -0,0 +1,126 @@
+// nnet3/nnet-computation-disk-cache.h
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_NNET3_NNET_COMPUTATION_DISK_CACHE_H_
+#define KALDI_NNET3_NNET_COMPUTATION_DISK_CACHE_H_
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "nnet3/nnet-nnet.h"
+#include "nnet3/nnet-computation.h"
+
+namespace kaldi {
+namespace nnet3 {
+
+/// @file  nnet-computation-disk-cache.h
+///
+/// This file declares class NnetComputationDiskCache, which stores compiled
+/// and optimized computations in a file so that programs that are run many
+/// times with the same model (e.g. online decoders, or decoding jobs split
+/// into many pieces) do not have to compile the same computations on each
+/// start-up.
+
+
+/// Returns a 128-bit hash of the binary form of 'nnet', as a string of hex
+/// digits.  It changes if anything about the model changes, including its
+/// parameters.
+std::string NnetHashString(const Nnet &nnet);
+
+
+/**
+   NnetComputationDiskCache is a persistent store of computations, keyed by
+   the model and by a string supplied by the caller that identifies the
+   computation request(s) and the options that the computation was compiled
+   with (the caller would typically get it by writing them all in binary form
+   to a std::ostringstream).  The whole key string is stored in the file and
+   compared on lookup; the model is identified by NnetHashString().  The file
+   is read in the constructor.  New
+   computations are written out by Write(), which is also called from the
+   destructor.
+
+   Writing the file is safe if several processes share the same cache file:
+   Write() re-reads the file, merges its contents with what was added in this
+   process, writes the result to a temporary file and renames it to the real
+   filename, so readers never see a partially written file.  If two processes
+   write at the same time, the computations added by one of them may be lost,
+   which just means they will be compiled again next time.  Entries that
+   belong to other models are dropped when the file is written, so a cache
+   file kept next to a model (e.g. final.mdl.cache) does not grow without
+   limit when the model is retrained.
+
+   It is OK to call Lookup() and Insert() from multiple threads.
+ */
+class NnetComputationDiskCache {
+ public:
+  /// 'filename' is the cache file; it does not have to exist.  'nnet' must
+  /// not change while this object exists.
+  NnetComputationDiskCache(const std::string &filename, const Nnet &nnet);
+
+  /// If a computation for 'key' is in the cache, outputs it to 'computation'
+  /// and returns true; otherwise returns false.  The output computation will
+  /// not have had ComputeCudaIndexes() called.
+  bool Lookup(const std::string &key, NnetComputation *computation) const;
+
+  /// Adds a computation to the cache; it will be written to disk by the next
+  /// call to Write().
+  void Insert(const std::string &key, const NnetComputation &computation);
+
+  /// Writes the cache to disk if anything has been added since it was read
+  /// or last written (see the class comment).  On failure it prints a
+  /// warning; it never throws.
+  void Write();
+
+  ~NnetComputationDiskCache() { Write(); }
+
+  /// Returns a cache for 'filename' that is shared with all other callers in
+  /// this process that pass the same filename and the same Nnet object, so
+  /// that the file is read and the model hashed only once.  The cache lives
+  /// (and is written out when destroyed) until the last of them releases it.
+  /// 'nnet' must not change while any of them holds it.
+  static std::shared_ptr<NnetComputationDiskCache> GetShared(
+      const std::string &filename, const Nnet &nnet);
+
+ private:
+  // Maps the keys supplied by the caller to the computations; it only holds
+  // the entries for our model.
+  typedef std::unordered_map<std::string,
+                             std::shared_ptr<const NnetComputation> > MapType;
+
+  // Reads the entries of the file 'filename_' that belong to our model into
+  // 'entries'.  It does not overwrite entries that are already present.
+  // Returns false (without printing anything) if the file does not exist, and
+  // prints a warning and returns false if it could not be read.
+  bool ReadEntries(MapType *entries) const;
+
+  std::string filename_;
+  std::string model_hash_;
+  MapType entries_;
+  bool modified_;
+  mutable std::mutex mutex_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(NnetComputationDiskCache);
+};
+
+
+} // namespace nnet3
+} // namespace kaldi
+
+#endif
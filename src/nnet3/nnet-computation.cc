@@ -1214,6 +1214,9 @@ size_t ComputationRequestHasher::operator() (
   end = cr->outputs.end();
   for (; itr != end; ++itr)
     ans = ans * p2 + io_hasher(*itr);
+  // These are compared by operator ==, so they should be part of the hash.
+  ans = ans * 2 + (cr->need_model_derivative ? 1 : 0);
+  ans = ans * 2 + (cr->store_component_stats ? 1 : 0);
   return ans;
 }
 
@@ -124,6 +124,22 @@ class NnetComputer {
   void GetOutputDestructive(const std::string &output_name,
                             CuMatrix<BaseFloat> *output);
 
+  /// Returns the index of the next command to be executed.  Two computers
+  /// for the same computation that have the same program counter will have
+  /// the same set of matrices allocated.
+  int32 ProgramCounter() const { return program_counter_; }
+
+  /// Gives access to the matrix with index 'matrix_index' in the computation
+  /// (it will be empty if that matrix is not currently allocated).  This is
+  /// for code that moves the state of a paused looped computation between
+  /// computers, e.g. class RnnlmComputeStateBatcher; most code should not need
+  /// it.
+  const CuMatrix<BaseFloat> &GetMatrix(int32 matrix_index) const {
+    return matrices_[matrix_index];
+  }
+  CuMatrix<BaseFloat> &GetMatrix(int32 matrix_index) {
+    return matrices_[matrix_index];
+  }
 
   ~NnetComputer();
  private:
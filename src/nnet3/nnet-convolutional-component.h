@@ -552,15 +552,32 @@ class TdnnComponent: public UpdatableComponent {
   };
 
   CuMatrixBase<BaseFloat> &LinearParams() { return linear_params_; }
+  const CuMatrixBase<BaseFloat> &LinearParams() const { return linear_params_; }
 
   // This allows you to resize the vector in order to add a bias where
   // there previously was none-- obviously this should be done carefully.
   CuVector<BaseFloat> &BiasParams() { return bias_params_; }
+  const CuVector<BaseFloat> &BiasParams() const { return bias_params_; }
+
+  const std::vector<int32> &TimeOffsets() const { return time_offsets_; }
 
   BaseFloat OrthonormalConstraint() const { return orthonormal_constraint_; }
 
   void ConsolidateMemory();
  private:
+  // QuantizedTdnnComponent shares the index-handling code below.
+  friend class QuantizedTdnnComponent;
+
+  // Does the work of ReorderIndexes(), which does not depend on the
+  // parameters.
+  static void ReorderTdnnIndexes(std::vector<Index> *input_indexes,
+                                 std::vector<Index> *output_indexes);
+
+  // Does the work of PrecomputeIndexes(), given the time offsets.
+  static PrecomputedIndexes *PrecomputeTdnnIndexes(
+      const std::vector<int32> &time_offsets,
+      const std::vector<Index> &input_indexes,
+      const std::vector<Index> &output_indexes);
 
   // This static function is a utility function that extracts a CuSubMatrix
   // representing a subset of rows of 'input_matrix'.
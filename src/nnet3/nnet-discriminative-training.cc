@@ -35,6 +35,10 @@ NnetDiscriminativeTrainer::NnetDiscriminativeTrainer(
     num_minibatches_processed_(0) {
   if (opts.nnet_config.zero_component_stats)
     ZeroComponentStats(nnet);
+  if (opts.nnet_config.num_threads != 1)
+    KALDI_ERR << "--num-threads > 1 is not supported by this trainer.";
+  if (!opts.nnet_config.minibatch_buckets.empty())
+    KALDI_ERR << "--minibatch-buckets is not supported by this trainer.";
   if (opts.nnet_config.momentum == 0.0 &&
       opts.nnet_config.max_param_change == 0.0) {
     delta_nnet_= NULL;
@@ -0,0 +1,170 @@
+// nnet3/nnet-example-loader-test.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <unistd.h>
+
+#include "nnet3/nnet-example-loader.h"
+#include "nnet3/nnet-test-utils.h"
+
+namespace kaldi {
+namespace nnet3 {
+
+// Writes 'num_archives' archives of random examples, of a few different
+// structures, and outputs their rspecifiers and keys (in the order they are
+// in each archive).
+static void WriteTestArchives(int32 num_archives,
+                              std::vector<std::string> *rspecifiers,
+                              std::vector<std::vector<std::string> > *keys) {
+  rspecifiers->clear();
+  keys->clear();
+  keys->resize(num_archives);
+  for (int32 a = 0; a < num_archives; a++) {
+    std::ostringstream filename;
+    filename << "tmp-egs-loader-" << a << ".ark";
+    NnetExampleWriter writer("ark:" + filename.str());
+    int32 num_egs = RandInt(0, 30);
+    for (int32 i = 0; i < num_egs; i++) {
+      NnetExample eg;
+      GenerateSimpleNnetTrainingExample(RandInt(1, 3), 2, 2, 4, 5, 0, &eg);
+      std::ostringstream key;
+      key << "eg-" << a << "-" << i;
+      writer.Write(key.str(), eg);
+      (*keys)[a].push_back(key.str());
+    }
+    rspecifiers->push_back("ark:" + filename.str());
+  }
+}
+
+static void RemoveTestArchives(const std::vector<std::string> &rspecifiers) {
+  for (size_t i = 0; i < rspecifiers.size(); i++)
+    unlink(rspecifiers[i].substr(4).c_str());
+}
+
+// Reads all the minibatches, and outputs their keys and their contents (in
+// text form).
+static void ReadAll(const ExampleLoaderOptions &opts,
+                    const std::vector<std::string> &rspecifiers,
+                    std::vector<std::string> *keys,
+                    std::vector<std::string> *egs) {
+  keys->clear();
+  egs->clear();
+  srand(1);  // The shuffling is seeded from Rand().
+  NnetExampleLoader loader(opts, rspecifiers);
+  for (; !loader.Done(); loader.Next()) {
+    keys->push_back(loader.Key());
+    std::ostringstream os;
+    loader.Value().Write(os, false);
+    egs->push_back(os.str());
+  }
+}
+
+void UnitTestExampleLoaderNoMerging() {
+  std::vector<std::string> rspecifiers;
+  std::vector<std::vector<std::string> > archive_keys;
+  WriteTestArchives(RandInt(1, 4), &rspecifiers, &archive_keys);
+
+  // Without shuffling, the examples are taken from the archives in turn.
+  std::vector<std::string> expected_keys;
+  for (size_t i = 0; ; i++) {
+    size_t num_added = 0;
+    for (size_t a = 0; a < archive_keys.size(); a++) {
+      if (i < archive_keys[a].size()) {
+        expected_keys.push_back(archive_keys[a][i]);
+        num_added++;
+      }
+    }
+    if (num_added == 0) break;
+  }
+
+  ExampleLoaderOptions opts;
+  std::vector<std::string> keys, egs, keys2, egs2;
+  ReadAll(opts, rspecifiers, &keys, &egs);
+  KALDI_ASSERT(keys == expected_keys);
+  opts.prefetch = RandInt(1, 3);
+  ReadAll(opts, rspecifiers, &keys2, &egs2);
+  KALDI_ASSERT(keys2 == keys && egs2 == egs);
+
+  // With shuffling, we get the same examples in a different order, which
+  // does not depend on whether we use threads.
+  opts.shuffle_buffer_size = RandInt(1, 10);
+  opts.prefetch = 0;
+  ReadAll(opts, rspecifiers, &keys, &egs);
+  opts.prefetch = RandInt(1, 3);
+  ReadAll(opts, rspecifiers, &keys2, &egs2);
+  KALDI_ASSERT(keys2 == keys && egs2 == egs);
+  std::sort(keys.begin(), keys.end());
+  std::sort(expected_keys.begin(), expected_keys.end());
+  KALDI_ASSERT(keys == expected_keys);
+
+  {
+    // Check that destroying the loader before the end of the input works.
+    NnetExampleLoader loader(opts, rspecifiers);
+  }
+
+  RemoveTestArchives(rspecifiers);
+}
+
+void UnitTestExampleLoaderMerging() {
+  std::vector<std::string> rspecifiers;
+  std::vector<std::vector<std::string> > archive_keys;
+  WriteTestArchives(RandInt(1, 4), &rspecifiers, &archive_keys);
+  int32 num_egs = 0;
+  for (size_t a = 0; a < archive_keys.size(); a++)
+    num_egs += archive_keys[a].size();
+
+  ExampleLoaderOptions opts;
+  opts.merge = true;
+  opts.merging_config.minibatch_size = "1:4";
+  opts.shuffle_buffer_size = RandInt(0, 10);
+  std::vector<std::string> keys, egs, keys2, egs2;
+  ReadAll(opts, rspecifiers, &keys, &egs);
+  opts.prefetch = RandInt(1, 3);
+  ReadAll(opts, rspecifiers, &keys2, &egs2);
+  KALDI_ASSERT(keys2 == keys && egs2 == egs);
+
+  // The keys are of the form merged-<index>-<minibatch-size>, and with this
+  // --minibatch-size no examples are discarded.
+  int32 num_merged = 0;
+  for (size_t i = 0; i < keys.size(); i++) {
+    std::vector<int32> fields;
+    KALDI_ASSERT(SplitStringToIntegers(keys[i].substr(7), "-", false,
+                                       &fields) &&
+                 fields.size() == 2 && fields[0] == i &&
+                 fields[1] >= 1 && fields[1] <= 4);
+    num_merged += fields[1];
+  }
+  KALDI_ASSERT(num_merged == num_egs);
+
+  RemoveTestArchives(rspecifiers);
+}
+
+} // namespace nnet3
+} // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  using namespace kaldi::nnet3;
+
+  for (int32 i = 0; i < 5; i++) {
+    UnitTestExampleLoaderNoMerging();
+    UnitTestExampleLoaderMerging();
+  }
+  KALDI_LOG << "Example-loader tests succeeded.";
+  return 0;
+}
@@ -0,0 +1,302 @@
+// nnet3/nnet-example-loader.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nnet3/nnet-example-loader.h"
+
+namespace kaldi {
+namespace nnet3{
+
+template <class Example, class Merger>
+ExampleLoaderTpl<Example, Merger>::ExampleLoaderTpl(
+    const ExampleLoaderOptions &opts,
+    const std::vector<std::string> &rspecifiers):
+    opts_(opts), merging_config_(opts.merging_config), merger_(NULL),
+    merger_finished_(false), next_shard_(0), input_ended_(false),
+    flush_index_(0), current_eg_(NULL), merging_done_(false), stop_(false),
+    num_egs_read_(0), num_minibatches_(0), wait_time_(0.0),
+    input_wait_time_(0.0) {
+  KALDI_ASSERT(!rspecifiers.empty() && opts.shuffle_buffer_size >= 0 &&
+               opts.prefetch >= 0);
+  if (opts_.merge) {
+    merging_config_.ComputeDerived();
+    merger_ = new Merger(merging_config_, NULL);
+  }
+  shuffle_buffer_.resize(opts_.shuffle_buffer_size,
+                         KeyedExample("", static_cast<Example*>(NULL)));
+  for (size_t i = 0; i < rspecifiers.size(); i++) {
+    Shard *shard = new Shard();
+    shard->reader = new ReaderType(rspecifiers[i]);
+    shards_.push_back(shard);
+  }
+  if (opts_.prefetch > 0) {
+    for (size_t i = 0; i < shards_.size(); i++)
+      shards_[i]->thread = std::thread(
+          &ExampleLoaderTpl<Example, Merger>::ReadShard, this, shards_[i]);
+    merging_thread_ = std::thread(
+        &ExampleLoaderTpl<Example, Merger>::RunMerging, this);
+  }
+  Next();
+}
+
+template <class Example, class Merger>
+const std::string &ExampleLoaderTpl<Example, Merger>::Key() const {
+  KALDI_ASSERT(current_eg_ != NULL);
+  return current_key_;
+}
+
+template <class Example, class Merger>
+Example &ExampleLoaderTpl<Example, Merger>::Value() {
+  KALDI_ASSERT(current_eg_ != NULL);
+  return *current_eg_;
+}
+
+template <class Example, class Merger>
+void ExampleLoaderTpl<Example, Merger>::Next() {
+  delete current_eg_;
+  current_eg_ = NULL;
+  Timer timer;
+  if (opts_.prefetch == 0) {
+    if (GetNextMinibatch(&current_key_, &current_eg_))
+      num_minibatches_++;
+  } else {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (minibatches_.empty() && !merging_done_ && error_.empty())
+      output_ready_.wait(lock);
+    CheckErrors();
+    if (!minibatches_.empty()) {
+      current_key_ = minibatches_.front().first;
+      current_eg_ = minibatches_.front().second;
+      minibatches_.pop_front();
+      num_minibatches_++;
+      output_taken_.notify_one();
+    }
+  }
+  wait_time_ += timer.Elapsed();
+}
+
+template <class Example, class Merger>
+void ExampleLoaderTpl<Example, Merger>::CheckErrors() const {
+  if (!error_.empty())
+    KALDI_ERR << "Error reading or merging the examples: " << error_;
+}
+
+template <class Example, class Merger>
+void ExampleLoaderTpl<Example, Merger>::ReadShard(Shard *shard) {
+  try {
+    ReaderType &reader = *(shard->reader);
+    for (; !reader.Done(); reader.Next()) {
+      Example *eg = new Example();
+      eg->Swap(&(reader.Value()));
+      std::unique_lock<std::mutex> lock(mutex_);
+      while (shard->queue.size() >= kShardQueueSize && !stop_)
+        input_taken_.wait(lock);
+      if (stop_) {
+        delete eg;
+        return;
+      }
+      shard->queue.push_back(KeyedExample(reader.Key(), eg));
+      input_ready_.notify_all();
+    }
+  } catch (const std::exception &e) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (error_.empty())
+      error_ = e.what();
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  shard->done = true;
+  input_ready_.notify_all();
+}
+
+template <class Example, class Merger>
+void ExampleLoaderTpl<Example, Merger>::RunMerging() {
+  try {
+    std::string key;
+    Example *eg;
+    while (GetNextMinibatch(&key, &eg)) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      while (minibatches_.size() >= static_cast<size_t>(opts_.prefetch) &&
+             !stop_)
+        output_taken_.wait(lock);
+      if (stop_) {
+        delete eg;
+        return;
+      }
+      minibatches_.push_back(KeyedExample(key, eg));
+      output_ready_.notify_one();
+    }
+  } catch (const std::exception &e) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (error_.empty())
+      error_ = e.what();
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  merging_done_ = true;
+  output_ready_.notify_one();
+}
+
+template <class Example, class Merger>
+bool ExampleLoaderTpl<Example, Merger>::GetNextInput(std::string *key,
+                                                     Example **eg) {
+  // Take the examples from the shards in turn, skipping those that are
+  // finished.
+  for (size_t i = 0; i < shards_.size(); i++) {
+    Shard *shard = shards_[next_shard_];
+    next_shard_ = (next_shard_ + 1) % shards_.size();
+    if (opts_.prefetch == 0) {
+      ReaderType &reader = *(shard->reader);
+      if (reader.Done())
+        continue;
+      *key = reader.Key();
+      *eg = new Example();
+      (*eg)->Swap(&(reader.Value()));
+      reader.Next();
+    } else {
+      Timer timer;
+      std::unique_lock<std::mutex> lock(mutex_);
+      while (shard->queue.empty() && !shard->done && !stop_)
+        input_ready_.wait(lock);
+      input_wait_time_ += timer.Elapsed();
+      if (stop_)
+        return false;
+      CheckErrors();
+      if (shard->queue.empty())
+        continue;
+      *key = shard->queue.front().first;
+      *eg = shard->queue.front().second;
+      shard->queue.pop_front();
+      input_taken_.notify_all();
+    }
+    num_egs_read_++;
+    return true;
+  }
+  return false;
+}
+
+template <class Example, class Merger>
+bool ExampleLoaderTpl<Example, Merger>::GetNextShuffled(std::string *key,
+                                                        Example **eg) {
+  if (shuffle_buffer_.empty())
+    return GetNextInput(key, eg);
+  // This is the same randomization as nnet3-shuffle-egs --buffer-size.
+  while (!input_ended_) {
+    std::string this_key;
+    Example *this_eg;
+    if (!GetNextInput(&this_key, &this_eg)) {
+      input_ended_ = true;
+      break;
+    }
+    KeyedExample &slot = shuffle_buffer_[
+        RandInt(0, shuffle_buffer_.size() - 1, &rand_state_)];
+    if (slot.second == NULL) {
+      slot.first = this_key;
+      slot.second = this_eg;
+    } else {
+      *key = slot.first;
+      *eg = slot.second;
+      slot.first = this_key;
+      slot.second = this_eg;
+      return true;
+    }
+  }
+  // Flush the buffer.
+  for (; flush_index_ < shuffle_buffer_.size(); flush_index_++) {
+    KeyedExample &slot = shuffle_buffer_[flush_index_];
+    if (slot.second != NULL) {
+      *key = slot.first;
+      *eg = slot.second;
+      slot.second = NULL;
+      flush_index_++;
+      return true;
+    }
+  }
+  return false;
+}
+
+template <class Example, class Merger>
+bool ExampleLoaderTpl<Example, Merger>::GetNextMinibatch(std::string *key,
+                                                         Example **eg) {
+  if (merger_ == NULL)
+    return GetNextShuffled(key, eg);
+  Example *minibatch = new Example();
+  while (!merger_->TakeMinibatch(key, minibatch)) {
+    std::string this_key;
+    Example *this_eg;
+    if (GetNextShuffled(&this_key, &this_eg)) {
+      merger_->AcceptExample(this_eg);  // Takes ownership.
+    } else if (!merger_finished_) {
+      merger_->Finish();
+      merger_finished_ = true;
+    } else {
+      delete minibatch;
+      return false;
+    }
+  }
+  *eg = minibatch;
+  return true;
+}
+
+template <class Example, class Merger>
+void ExampleLoaderTpl<Example, Merger>::PrintStats() const {
+  double tot_time = timer_.Elapsed();
+  KALDI_LOG << "Read " << num_egs_read_ << " examples from "
+            << shards_.size() << " archive(s), and output "
+            << num_minibatches_ << (opts_.merge ? " minibatches" : " examples")
+            << "; waited " << wait_time_ << " seconds for them, out of "
+            << tot_time << " seconds ("
+            << (100.0 * wait_time_ / std::max(tot_time, 1.0e-10)) << "%).";
+  if (opts_.prefetch > 0)
+    KALDI_LOG << "The merging thread waited " << input_wait_time_
+              << " seconds for the examples to be read.";
+}
+
+template <class Example, class Merger>
+ExampleLoaderTpl<Example, Merger>::~ExampleLoaderTpl() {
+  if (opts_.prefetch > 0) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    input_ready_.notify_all();
+    input_taken_.notify_all();
+    output_taken_.notify_all();
+    merging_thread_.join();
+    for (size_t i = 0; i < shards_.size(); i++)
+      shards_[i]->thread.join();
+  }
+  PrintStats();
+  delete current_eg_;
+  for (size_t i = 0; i < minibatches_.size(); i++)
+    delete minibatches_[i].second;
+  for (size_t i = 0; i < shuffle_buffer_.size(); i++)
+    delete shuffle_buffer_[i].second;
+  for (size_t i = 0; i < shards_.size(); i++) {
+    for (size_t j = 0; j < shards_[i]->queue.size(); j++)
+      delete shards_[i]->queue[j].second;
+    delete shards_[i]->reader;
+    delete shards_[i];
+  }
+  delete merger_;
+}
+
+// Instantiate the templates for the types we need.
+template class ExampleLoaderTpl<NnetExample, ExampleMerger>;
+template class ExampleLoaderTpl<NnetChainExample, ChainExampleMerger>;
+
+} // namespace nnet3
+} // namespace kaldi
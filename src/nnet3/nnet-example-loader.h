@@ -0,0 +1,198 @@
+// nnet3/nnet-example-loader.h
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_NNET3_NNET_EXAMPLE_LOADER_H_
+#define KALDI_NNET3_NNET_EXAMPLE_LOADER_H_
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "base/timer.h"
+#include "nnet3/nnet-example-utils.h"
+#include "nnet3/nnet-chain-example.h"
+
+namespace kaldi {
+namespace nnet3 {
+
+/**
+   This file contains a class that does, inside the training program, what the
+   input pipelines of nnet3-train and nnet3-chain-train usually do with
+   separate programs: it reads the examples from one or more archives,
+   shuffles them (like nnet3-shuffle-egs --buffer-size) and merges them into
+   minibatches (like nnet3-merge-egs or nnet3-chain-merge-egs).  This avoids
+   writing and reading each example twice more through pipes.
+
+   If --egs-prefetch is > 0, each archive is read by its own thread, and the
+   shuffling and merging are done by another thread, which keeps up to that
+   many minibatches ready for the training.  The order of the examples does
+   not depend on the timing of the threads: the archives are read from in
+   turn, one example at a time.
+*/
+
+struct ExampleLoaderOptions {
+  bool merge;
+  int32 shuffle_buffer_size;
+  int32 prefetch;
+  ExampleMergingConfig merging_config;
+
+  ExampleLoaderOptions(): merge(false), shuffle_buffer_size(0),
+                          prefetch(0) { }
+
+  void Register(OptionsItf *opts) {
+    opts->Register("merge-egs", &merge, "If true, merge the examples into "
+                   "minibatches in this program, as nnet3-merge-egs or "
+                   "nnet3-chain-merge-egs would.  The merging is configured "
+                   "with the options prefixed with --merge., e.g. "
+                   "--merge.minibatch-size=128");
+    opts->Register("egs-shuffle-buffer-size", &shuffle_buffer_size, "If >0, "
+                   "shuffle the examples in this program, using a buffer of "
+                   "this many examples (like nnet3-shuffle-egs --buffer-size)");
+    opts->Register("egs-prefetch", &prefetch, "If >0, read the examples (one "
+                   "thread per input archive) and shuffle and merge them (one "
+                   "more thread) in the background, keeping up to this many "
+                   "minibatches ready in advance.");
+    ParseOptions merging_opts("merge", opts);
+    merging_config.Register(&merging_opts);
+  }
+};
+
+
+/**
+   ExampleLoaderTpl reads examples from a list of archives and outputs them,
+   shuffled and merged as configured by ExampleLoaderOptions.  Its interface is
+   like that of SequentialTableReader, so it can be used in the same loop.
+   'Example' is NnetExample or NnetChainExample, and 'Merger' the
+   corresponding merging class, ExampleMerger or ChainExampleMerger; use the
+   typedefs NnetExampleLoader and NnetChainExampleLoader.
+
+   When the examples are merged, the keys are those that the merging programs
+   would write (e.g. "merged-0-128"); otherwise they are the keys in the
+   archives.
+*/
+template <class Example, class Merger>
+class ExampleLoaderTpl {
+ public:
+  ExampleLoaderTpl(const ExampleLoaderOptions &opts,
+                   const std::vector<std::string> &rspecifiers);
+
+  bool Done() const { return current_eg_ == NULL; }
+  const std::string &Key() const;
+  Example &Value();
+  void Next();
+
+  /// Prints the number of examples and minibatches and the time spent
+  /// waiting for them.  Called from the destructor.
+  void PrintStats() const;
+
+  ~ExampleLoaderTpl();
+
+ private:
+  typedef SequentialTableReader<KaldiObjectHolder<Example> > ReaderType;
+  typedef std::pair<std::string, Example*> KeyedExample;
+
+  // The maximum number of examples read in advance from each archive, if the
+  // archives are read in background threads.
+  static const size_t kShardQueueSize = 64;
+
+  // One of the archives we read from.
+  struct Shard {
+    ReaderType *reader;
+    // The examples read in advance by the thread, if there are threads.
+    std::deque<KeyedExample> queue;
+    // True once all the examples of the archive have been read (they may
+    // still be in 'queue').
+    bool done;
+    std::thread thread;
+    Shard(): reader(NULL), done(false) { }
+  };
+
+  // The function run by the thread of each shard.
+  void ReadShard(Shard *shard);
+
+  // The function run by the thread that shuffles and merges the examples.
+  void RunMerging();
+
+  // Gets the next example from the shards, in turn; returns false if there
+  // are none left.  The caller owns *eg.
+  bool GetNextInput(std::string *key, Example **eg);
+
+  // As GetNextInput(), but after shuffling.
+  bool GetNextShuffled(std::string *key, Example **eg);
+
+  // As GetNextShuffled(), but after merging.
+  bool GetNextMinibatch(std::string *key, Example **eg);
+
+  // Throws if one of the threads failed.  Must be called with mutex_ held.
+  void CheckErrors() const;
+
+  ExampleLoaderOptions opts_;
+  // The merging config, after ComputeDerived(); merger_ keeps a reference to
+  // it.
+  ExampleMergingConfig merging_config_;
+  Merger *merger_;  // NULL if !opts_.merge.
+  bool merger_finished_;
+
+  std::vector<Shard*> shards_;
+  size_t next_shard_;  // The next shard to take an example from.
+
+  // The shuffling buffer; elements whose .second is NULL are empty.
+  std::vector<KeyedExample> shuffle_buffer_;
+  bool input_ended_;
+  size_t flush_index_;  // Where we are in flushing the buffer at the end.
+  RandomState rand_state_;
+
+  // The current minibatch.
+  std::string current_key_;
+  Example *current_eg_;
+
+  // Things used when there are threads.
+  std::thread merging_thread_;
+  std::deque<KeyedExample> minibatches_;  // The minibatches that are ready.
+  bool merging_done_;  // True once the last minibatch is in minibatches_.
+  bool stop_;  // Tells the threads to exit.
+  std::string error_;  // The error message, if one of the threads failed.
+  std::mutex mutex_;  // Protects all the above, and the queues of the shards.
+  std::condition_variable input_ready_;  // Signaled by the shards' threads.
+  std::condition_variable input_taken_;  // Signaled by the merging thread.
+  std::condition_variable output_ready_;  // Signaled by the merging thread.
+  std::condition_variable output_taken_;  // Signaled by Next().
+
+  // Statistics.
+  int64 num_egs_read_;
+  int64 num_minibatches_;
+  Timer timer_;
+  double wait_time_;  // Time spent in Next() waiting for the minibatches.
+  // Time the merging thread spent waiting for the shards' threads.
+  double input_wait_time_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(ExampleLoaderTpl);
+};
+
+typedef ExampleLoaderTpl<NnetExample, ExampleMerger> NnetExampleLoader;
+typedef ExampleLoaderTpl<NnetChainExample, ChainExampleMerger>
+    NnetChainExampleLoader;
+
+} // namespace nnet3
+} // namespace kaldi
+
+#endif // KALDI_NNET3_NNET_EXAMPLE_LOADER_H_
@@ -97,6 +97,65 @@ void UnitTestNnetMergeExamples() {
 
 
 
+void UnitTestPadNnetIo() {
+  for (int32 n = 0; n < 20; n++) {
+    int32 num_supervised_frames = RandInt(1, 10),
+                   left_context = RandInt(0, 5),
+                  right_context = RandInt(0, 5),
+                      input_dim = RandInt(1, 10),
+                     output_dim = RandInt(5, 10),
+                    ivector_dim = RandInt(-1, 2);
+    int32 num_egs = RandInt(1, 4);
+    std::vector<NnetExample> egs(num_egs);
+    GenerateSimpleNnetTrainingExample(num_supervised_frames, left_context,
+                                      right_context, input_dim, output_dim,
+                                      ivector_dim, &(egs[0]));
+    // The examples of a minibatch normally have the same 't' values, which
+    // is what padding requires, but GenerateSimpleNnetTrainingExample()
+    // shifts them at random; so we only change the input features.
+    for (int32 i = 1; i < num_egs; i++) {
+      egs[i] = egs[0];
+      Matrix<BaseFloat> feats(egs[i].io[0].features.NumRows(),
+                              egs[i].io[0].features.NumCols());
+      feats.SetRandn();
+      egs[i].io[0].features = feats;
+    }
+    NnetExample eg;
+    MergeExamples(egs, false, &eg);
+    int32 num_sequences = num_egs + RandInt(0, 3);
+    for (size_t i = 0; i < eg.io.size(); i++) {
+      NnetIo io(eg.io[i]);
+      bool zero_features = (io.name == "output");
+      KALDI_ASSERT(PadNnetIo(num_sequences, zero_features, &io));
+      KALDI_ASSERT(io.indexes.back().n == num_sequences - 1 &&
+                   io.features.NumRows() == io.indexes.size());
+      Matrix<BaseFloat> feats, padded_feats;
+      eg.io[i].features.GetMatrix(&feats);
+      io.features.GetMatrix(&padded_feats);
+      // The rows of the real sequences are unchanged, and those of the new
+      // sequences are copies of sequence 0, or zero.
+      for (size_t j = 0; j < io.indexes.size(); j++) {
+        Index index = io.indexes[j];
+        bool is_padding = (index.n >= num_egs);
+        if (is_padding)
+          index.n = 0;
+        std::vector<Index>::const_iterator iter =
+            std::find(eg.io[i].indexes.begin(), eg.io[i].indexes.end(), index);
+        KALDI_ASSERT(iter != eg.io[i].indexes.end());
+        SubVector<BaseFloat> row(padded_feats, j);
+        if (is_padding && zero_features) {
+          KALDI_ASSERT(row.Sum() == 0.0);
+        } else {
+          SubVector<BaseFloat> orig_row(feats,
+                                        iter - eg.io[i].indexes.begin());
+          KALDI_ASSERT(row.ApproxEqual(orig_row, 0.0));
+        }
+      }
+    }
+  }
+}
+
+
 } // namespace nnet3
 } // namespace kaldi
 
@@ -106,6 +165,7 @@ int main() {
 
   UnitTestNnetExample();
   UnitTestNnetMergeExamples();
+  UnitTestPadNnetIo();
 
   KALDI_LOG << "Nnet-example tests succeeded.";
 
@@ -19,6 +19,7 @@
 // limitations under the License.
 
 #include "nnet3/nnet-example-utils.h"
+#include "nnet3/nnet-optimize-utils.h"
 #include "lat/lattice-functions.h"
 #include "hmm/posterior.h"
 #include "util/text-utils.h"
@@ -210,6 +211,43 @@ void ShiftExampleTimes(int32 t_offset,
   }
 }
 
+bool PadNnetIo(int32 num_sequences, bool zero_features, NnetIo *io) {
+  int32 old_num_sequences = io->indexes.back().n + 1;
+  KALDI_ASSERT(num_sequences >= old_num_sequences);
+  std::vector<Index> indexes;
+  std::vector<int32> source_rows;
+  if (!ChangeNumNValues(io->indexes, num_sequences, false, &indexes,
+                        &source_rows))
+    return false;
+  if (zero_features) {
+    // Row index -1 means a zero row to CopyRows().
+    for (size_t i = 0; i < indexes.size(); i++)
+      if (indexes[i].n >= old_num_sequences)
+        source_rows[i] = -1;
+  }
+  if (io->features.Type() == kSparseMatrix) {
+    const SparseMatrix<BaseFloat> &src = io->features.GetSparseMatrix();
+    SparseMatrix<BaseFloat> dest(indexes.size(), src.NumCols());
+    for (size_t i = 0; i < indexes.size(); i++)
+      if (source_rows[i] >= 0)
+        dest.SetRow(i, src.Row(source_rows[i]));
+    io->features.SwapSparseMatrix(&dest);
+  } else {
+    // Compressed features have to be uncompressed first.
+    Matrix<BaseFloat> uncompressed;
+    if (io->features.Type() != kFullMatrix)
+      io->features.GetMatrix(&uncompressed);
+    const Matrix<BaseFloat> &src = (io->features.Type() == kFullMatrix ?
+                                    io->features.GetFullMatrix() :
+                                    uncompressed);
+    Matrix<BaseFloat> dest(indexes.size(), src.NumCols(), kUndefined);
+    dest.CopyRows(src, &(source_rows[0]));
+    io->features.SwapFullMatrix(&dest);
+  }
+  io->indexes.swap(indexes);
+  return true;
+}
+
 void GetComputationRequest(const Nnet &nnet,
                            const NnetExample &eg,
                            bool need_model_derivative,
@@ -1249,7 +1287,30 @@ void ExampleMerger::WriteMinibatch(const std::vector<NnetExample> &egs) {
   MergeExamples(egs, config_.compress, &merged_eg);
   std::ostringstream key;
   key << "merged-" << (num_egs_written_++) << "-" << minibatch_size;
-  writer_->Write(key.str(), merged_eg);
+  if (writer_ != NULL) {
+    writer_->Write(key.str(), merged_eg);
+  } else {
+    NnetExample *eg = new NnetExample();
+    eg->Swap(&merged_eg);
+    merged_egs_.push_back(std::make_pair(key.str(), eg));
+  }
+}
+
+bool ExampleMerger::TakeMinibatch(std::string *key, NnetExample *eg) {
+  KALDI_ASSERT(writer_ == NULL);
+  if (merged_egs_.empty())
+    return false;
+  *key = merged_egs_.front().first;
+  eg->Swap(merged_egs_.front().second);
+  delete merged_egs_.front().second;
+  merged_egs_.pop_front();
+  return true;
+}
+
+ExampleMerger::~ExampleMerger() {
+  Finish();
+  for (size_t i = 0; i < merged_egs_.size(); i++)
+    delete merged_egs_[i].second;
 }
 
 void ExampleMerger::Finish() {
@@ -21,6 +21,8 @@
 #ifndef KALDI_NNET3_NNET_EXAMPLE_UTILS_H_
 #define KALDI_NNET3_NNET_EXAMPLE_UTILS_H_
 
+#include <deque>
+
 #include "nnet3/nnet-example.h"
 #include "nnet3/nnet-computation.h"
 #include "nnet3/nnet-compute.h"
@@ -51,6 +53,18 @@ void ShiftExampleTimes(int32 t_offset,
                        const std::vector<std::string> &exclude_names,
                        NnetExample *eg);
 
+/** Pads 'io', which is typically part of a merged example, so that it has
+    'num_sequences' values of 'n' instead of N <= num_sequences: the new
+    sequences are added as ChangeNumNValues() (in nnet-optimize-utils.h) lays
+    them out, after the old one if N == 1, as MergeExamples() would.  Their
+    features are copies of those of sequence 0 if
+    'zero_features' is false, and zero if it is true; for the supervision of
+    an output with a linear objective, zero features mean zero weight.
+    Returns false, leaving 'io' unchanged, if its indexes do not have the
+    regular structure this requires.
+*/
+bool PadNnetIo(int32 num_sequences, bool zero_features, NnetIo *io);
+
 /**  This function takes a NnetExample (which should already have been
      frame-selected, if desired, and merged into a minibatch) and produces a
      ComputationRequest.  It assumes you don't want the derivatives w.r.t. the
@@ -487,6 +501,8 @@ class ExampleMergingStats {
 /// as defined by ExampleMergingConfig.
 class ExampleMerger {
  public:
+  // If 'writer' is NULL, the merged examples are kept in this class
+  // instead of being written, and can be obtained with TakeMinibatch().
   ExampleMerger(const ExampleMergingConfig &config,
                 NnetExampleWriter *writer);
 
@@ -505,7 +521,12 @@ class ExampleMerger {
   // returns a suitable exit status for a program.
   int32 ExitStatus() { Finish(); return (num_egs_written_ > 0 ? 0 : 1); }
 
-  ~ExampleMerger() { Finish(); };
+  // Only usable if 'writer' was NULL in the constructor: if any merged
+  // examples are waiting, outputs the oldest one to 'key' and 'eg' and
+  // returns true; otherwise returns false.
+  bool TakeMinibatch(std::string *key, NnetExample *eg);
+
+  ~ExampleMerger();
  private:
   // called by Finish() and AcceptExample().  Merges, updates the
   // stats, and writes.
@@ -522,6 +543,9 @@ class ExampleMerger {
                         NnetExampleStructureHasher,
                         NnetExampleStructureCompare> MapType;
    MapType eg_to_egs_;
+
+   // The merged examples, if 'writer_' is NULL.
+   std::deque<std::pair<std::string, NnetExample*> > merged_egs_;
 };
 
 } // namespace nnet3
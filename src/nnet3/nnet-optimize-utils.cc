@@ -3887,6 +3887,71 @@ bool RequestIsDecomposable(const ComputationRequest &request,
 }
 
 
+bool ChangeNumNValues(const std::vector<Index> &indexes,
+                      int32 num_n_values,
+                      bool n_innermost,
+                      std::vector<Index> *indexes_out,
+                      std::vector<int32> *source_rows) {
+  KALDI_ASSERT(!indexes.empty() && num_n_values > 0);
+  int32 size = indexes.size(),
+      old_num_n_values = indexes.back().n + 1,
+      n_stride;
+  if (old_num_n_values == 1) {
+    // FindNStride() can't work out the stride in this case, so the caller
+    // tells us the layout.
+    for (int32 i = 0; i < size; i++)
+      if (indexes[i].n != 0)
+        return false;
+    n_stride = (n_innermost ? 1 : size);
+  } else {
+    bool full_check = true;
+    n_stride = FindNStride(indexes, full_check);
+    if (n_stride == 0)
+      return false;
+  }
+  ConvertNumNValues(n_stride, old_num_n_values, num_n_values,
+                    indexes, indexes_out);
+  if (source_rows != NULL) {
+    // This mirrors the loop in ConvertNumNValues().
+    int32 block_size_in = n_stride * old_num_n_values,
+        block_size_out = n_stride * num_n_values;
+    source_rows->resize(indexes_out->size());
+    for (int32 i_in = 0; i_in < size; i_in++) {
+      if (indexes[i_in].n != 0)
+        continue;
+      int32 i_out = (i_in / block_size_in) * block_size_out +
+          i_in % block_size_in;
+      for (int32 n = 0; n < num_n_values; n++, i_out += n_stride)
+        (*source_rows)[i_out] = (n < old_num_n_values ? i_in + n * n_stride :
+                                 i_in);
+    }
+  }
+  return true;
+}
+
+bool ChangeNumNValues(const ComputationRequest &request,
+                      int32 num_n_values,
+                      ComputationRequest *request_out) {
+  for (size_t i = 0; i < request.outputs.size(); i++)
+    if (request.outputs[i].indexes.back().n == 0)
+      return false;  // A single sequence: we can't work out the layout.
+  request_out->inputs = request.inputs;
+  request_out->outputs = request.outputs;
+  request_out->need_model_derivative = request.need_model_derivative;
+  request_out->store_component_stats = request.store_component_stats;
+  request_out->misc_info = request.misc_info;
+  for (size_t i = 0; i < request.inputs.size(); i++)
+    if (!ChangeNumNValues(request.inputs[i].indexes, num_n_values, false,
+                          &(request_out->inputs[i].indexes), NULL))
+      return false;
+  for (size_t i = 0; i < request.outputs.size(); i++)
+    if (!ChangeNumNValues(request.outputs[i].indexes, num_n_values, false,
+                          &(request_out->outputs[i].indexes), NULL))
+      return false;
+  return true;
+}
+
+
 class ComputationLoopedOptimizer {
  public:
   ComputationLoopedOptimizer(const Nnet &nnet,
@@ -4973,9 +5038,12 @@ ComputationCache::ComputationCache(int32 cache_capacity):
 
 std::shared_ptr<const NnetComputation> ComputationCache::Insert(
     const ComputationRequest &request_in,
-    const NnetComputation *computation_in) {
+    const NnetComputation *computation_in,
+    const ComputationRequest **evicted_request) {
 
   std::lock_guard<std::mutex> lock(mutex_);
+  if (evicted_request != NULL)
+    *evicted_request = NULL;
   if (static_cast<int32>(computation_cache_.size()) >= cache_capacity_) {
     //  Cache has reached capacity; purge the least-recently-accessed request
     const CacheType::iterator iter =
@@ -4983,7 +5051,10 @@ std::shared_ptr<const NnetComputation> ComputationCache::Insert(
     KALDI_ASSERT(iter != computation_cache_.end());
     const ComputationRequest *request = iter->first;
     computation_cache_.erase(iter);
-    delete request;
+    if (evicted_request != NULL)
+      *evicted_request = request;
+    else
+      delete request;
     // we don't need to delete the computation in iter->second.first, as the
     // shared_ptr takes care of that automatically.
     access_queue_.pop_front();
@@ -403,6 +403,41 @@ bool RequestIsDecomposable(const ComputationRequest &request,
                            ComputationRequest *mini_request,
                            int32 *num_n_values);
 
+/**
+   This function, used when minibatches are padded to a fixed number of
+   sequences (see --minibatch-buckets in NnetTrainerOptions), converts a vector
+   of Indexes with 'n' values 0, 1, ... N-1 to one that is otherwise the same
+   but has 'n' values 0, 1, ... num_n_values - 1, laid out in the same way (as
+   in shortcut compilation).  The input must either have only n == 0 or have
+   the regular structure described for FindNStride() in nnet-optimize-utils.cc,
+   as merged examples do; if not, this function returns false.
+
+   If the input has only n == 0, its layout cannot be worked out from it, so
+   'n_innermost' says what it is: if true, the new 'n' values are innermost
+   (the Index (n, t, x) follows (n - 1, t, x)), as in merged chain
+   supervision, which is sorted by 't' and then 'n'; if false, the new
+   sequences follow the old one, as MergeExamples() lays out an NnetIo.
+   'n_innermost' is ignored if N > 1.
+
+   If 'source_rows' is not NULL, it outputs to it, for each row of
+   'indexes_out', the row of 'indexes' with the same Index, or, if its 'n' is
+   >= N, with the same Index except that n == 0.
+*/
+bool ChangeNumNValues(const std::vector<Index> &indexes,
+                      int32 num_n_values,
+                      bool n_innermost,
+                      std::vector<Index> *indexes_out,
+                      std::vector<int32> *source_rows);
+
+/// This version of ChangeNumNValues() converts all the inputs and outputs of a
+/// ComputationRequest, which must have more than one sequence (so that the
+/// layout of its 'n' values can be worked out).  Returns false if it has
+/// only one sequence, or if one of its inputs or outputs did not have the
+/// required structure.
+bool ChangeNumNValues(const ComputationRequest &request,
+                      int32 num_n_values,
+                      ComputationRequest *request_out);
+
 
 /**
   This function is used in 'shortcut' compilation to expand a computation
@@ -645,9 +680,13 @@ class ComputationCache {
   // Inserts the computation into the cache-- this is assumed to be the
   // computation for the computation-request 'request'.  Returns a shared_ptr
   // which can be used to access the object.  This function takes ownership of
-  // 'computation'.
-  std::shared_ptr<const NnetComputation> Insert(const ComputationRequest &request,
-                                                const NnetComputation *computation);
+  // 'computation'.  If 'evicted_request' is not NULL, it is set to the request
+  // whose computation was removed from the cache to make room (which the
+  // caller then owns), or to NULL if none was.
+  std::shared_ptr<const NnetComputation> Insert(
+      const ComputationRequest &request,
+      const NnetComputation *computation,
+      const ComputationRequest **evicted_request = NULL);
 
   ~ComputationCache();
 
@@ -639,7 +639,7 @@ CachingOptimizingCompiler::CachingOptimizingCompiler(
     seconds_taken_total_(0.0), seconds_taken_compile_(0.0),
     seconds_taken_optimize_(0.0), seconds_taken_expand_(0.0),
     seconds_taken_check_(0.0), seconds_taken_indexes_(0.0),
-    seconds_taken_io_(0.0), cache_(config.cache_capacity),
+    seconds_taken_io_(0.0), num_requests_(0), cache_(config.cache_capacity),
     nnet_left_context_(-1), nnet_right_context_(-1) { }
 
 CachingOptimizingCompiler::CachingOptimizingCompiler(
@@ -650,7 +650,7 @@ CachingOptimizingCompiler::CachingOptimizingCompiler(
     seconds_taken_total_(0.0), seconds_taken_compile_(0.0),
     seconds_taken_optimize_(0.0), seconds_taken_expand_(0.0),
     seconds_taken_check_(0.0), seconds_taken_indexes_(0.0),
-    seconds_taken_io_(0.0), cache_(config.cache_capacity),
+    seconds_taken_io_(0.0), num_requests_(0), cache_(config.cache_capacity),
     nnet_left_context_(-1), nnet_right_context_(-1) { }
 
 void CachingOptimizingCompiler::GetSimpleNnetContext(
@@ -693,6 +693,11 @@ void CachingOptimizingCompiler::WriteCache(std::ostream &os, bool binary) {
 }
 
 CachingOptimizingCompiler::~CachingOptimizingCompiler() {
+  if (disk_cache_ != NULL) {
+    Timer timer;
+    disk_cache_->Write();
+    seconds_taken_io_ += timer.Elapsed();
+  }
   if (seconds_taken_total_ > 0.0 || seconds_taken_io_ > 0.0) {
     std::ostringstream os;
     double seconds_taken_misc = seconds_taken_total_ - seconds_taken_compile_
@@ -711,32 +716,185 @@ CachingOptimizingCompiler::~CachingOptimizingCompiler() {
     // note: the leftover amount is misc things like hashing and == comparisons on
     // computation-requests, and calling RequestIsDecomposable().
   }
+  for (size_t i = 0; i < evicted_queue_.size(); i++)
+    delete evicted_queue_[i];
+}
+
+// Returns a short description of the shape of 'request' for
+// CachingOptimizingCompiler::PrintShapeStats(): the name, range of 't' values
+// and number of 'n' values of each input and output, e.g.
+// "input[t=-20:169,n=64] output[t=0:149,n=64]".
+static std::string RequestShape(const ComputationRequest &request) {
+  std::ostringstream os;
+  for (int32 i = 0; i < 2; i++) {
+    const std::vector<IoSpecification> &specs =
+        (i == 0 ? request.inputs : request.outputs);
+    for (size_t j = 0; j < specs.size(); j++) {
+      const std::vector<Index> &indexes = specs[j].indexes;
+      if (i != 0 || j != 0)
+        os << ' ';
+      os << specs[j].name;
+      if (indexes.empty())
+        continue;
+      int32 min_t = indexes[0].t, max_t = indexes[0].t, max_n = indexes[0].n;
+      std::vector<Index>::const_iterator iter = indexes.begin(),
+          end = indexes.end();
+      for (; iter != end; ++iter) {
+        if (iter->t == kNoTime) continue;
+        if (min_t == kNoTime || iter->t < min_t) min_t = iter->t;
+        if (max_t == kNoTime || iter->t > max_t) max_t = iter->t;
+        max_n = std::max(max_n, iter->n);
+      }
+      os << "[t=" << min_t << ':' << max_t << ",n=" << (max_n + 1) << ']';
+    }
+  }
+  return os.str();
 }
 
 std::shared_ptr<const NnetComputation> CachingOptimizingCompiler::Compile(
     const ComputationRequest  &in_request) {
   Timer timer;
-  std::shared_ptr<const NnetComputation>  ans = CompileInternal(in_request);
-  seconds_taken_total_ += timer.Elapsed();
+  bool compiled = false;
+  std::shared_ptr<const NnetComputation>  ans = CompileInternal(in_request,
+                                                                &compiled);
+  double elapsed = timer.Elapsed();
+  seconds_taken_total_ += elapsed;
+  num_requests_++;
+  if (compiled) {
+    // Only cache misses are recorded per shape, so that looking up a cached
+    // computation stays cheap.
+    std::string shape = RequestShape(in_request);
+    std::lock_guard<std::mutex> lock(shape_stats_mutex_);
+    ShapeStats &stats = shape_stats_[shape];
+    stats.num_compilations++;
+    stats.seconds_taken += elapsed;
+    if (evicted_requests_.count(&in_request) != 0)
+      stats.num_recompilations++;
+    // Only the most recently evicted requests are kept.  This is done here
+    // rather than in RecordEvicted() so that the request that compiling
+    // 'in_request' evicted cannot push 'in_request' itself out first.
+    while (static_cast<int32>(evicted_queue_.size()) >
+           config_.cache_capacity) {
+      const ComputationRequest *oldest = evicted_queue_.front();
+      evicted_queue_.pop_front();
+      evicted_requests_.erase(oldest);
+      delete oldest;
+    }
+  }
   return ans;
 }
 
+void CachingOptimizingCompiler::RecordEvicted(
+    const ComputationRequest *request) {
+  if (request == NULL)
+    return;
+  std::lock_guard<std::mutex> lock(shape_stats_mutex_);
+  if (!evicted_requests_.insert(request).second) {
+    delete request;  // It was already there (evicted more than once).
+    return;
+  }
+  evicted_queue_.push_back(request);
+}
+
+void CachingOptimizingCompiler::PrintShapeStats() const {
+  int64 tot_requests = num_requests_;
+  if (tot_requests == 0)
+    return;
+  std::lock_guard<std::mutex> lock(shape_stats_mutex_);
+  // Sort by the time spent compiling, most first.
+  std::vector<std::pair<double, std::string> > shapes;
+  int64 tot_compilations = 0, tot_recompilations = 0;
+  unordered_map<std::string, ShapeStats, StringHasher>::const_iterator
+      iter = shape_stats_.begin(), end = shape_stats_.end();
+  for (; iter != end; ++iter) {
+    shapes.push_back(std::pair<double, std::string>(-iter->second.seconds_taken,
+                                                    iter->first));
+    tot_compilations += iter->second.num_compilations;
+    tot_recompilations += iter->second.num_recompilations;
+  }
+  std::sort(shapes.begin(), shapes.end());
+  KALDI_LOG << "Compiled " << tot_compilations << " computations of "
+            << shapes.size() << " distinct shapes for " << tot_requests
+            << " requests (cache hit rate "
+            << (100.0 * (tot_requests - tot_compilations) / tot_requests)
+            << "%).";
+  const size_t max_shapes_to_print = 20;
+  for (size_t i = 0; i < shapes.size() && i < max_shapes_to_print; i++) {
+    const ShapeStats &stats = shape_stats_.find(shapes[i].second)->second;
+    KALDI_LOG << "Shape " << shapes[i].second << ": compiled "
+              << stats.num_compilations << " times ("
+              << stats.num_recompilations << " after eviction) in "
+              << stats.seconds_taken << " seconds.";
+  }
+  if (shapes.size() > max_shapes_to_print)
+    KALDI_LOG << "... and " << (shapes.size() - max_shapes_to_print)
+              << " more shapes.";
+  if (tot_recompilations > 0)
+    KALDI_LOG << tot_recompilations << " computations were compiled again "
+              << "because they had been evicted from the cache; consider "
+              << "increasing "
+              << "--compiler.cache-capacity (currently "
+              << config_.cache_capacity << ") or using --minibatch-buckets.";
+}
+
 std::shared_ptr<const NnetComputation> CachingOptimizingCompiler::CompileInternal(
-    const ComputationRequest  &request) {
+    const ComputationRequest  &request, bool *compiled) {
   std::shared_ptr<const NnetComputation> ans = cache_.Find(request);
   if (ans != NULL) {
     return ans;
   } else {
+    NnetComputationDiskCache *disk_cache = GetDiskCache();
+    std::string disk_cache_key;
+    if (disk_cache != NULL) {
+      disk_cache_key = DiskCacheKey(request);
+      NnetComputation *computation = new NnetComputation();
+      if (disk_cache->Lookup(disk_cache_key, computation)) {
+        computation->ComputeCudaIndexes();
+        const ComputationRequest *evicted = NULL;
+        ans = cache_.Insert(request, computation, &evicted);
+        RecordEvicted(evicted);
+        return ans;
+      }
+      delete computation;
+    }
+    if (compiled != NULL)
+      *compiled = true;
     const NnetComputation *computation = NULL;
     if (config_.use_shortcut)
       computation = CompileViaShortcut(request);
     if (computation == NULL)
       computation = CompileNoShortcut(request);
     KALDI_ASSERT(computation != NULL);
-    return cache_.Insert(request, computation);
+    if (disk_cache != NULL)
+      disk_cache->Insert(disk_cache_key, *computation);
+    const ComputationRequest *evicted = NULL;
+    ans = cache_.Insert(request, computation, &evicted);
+    RecordEvicted(evicted);
+    return ans;
   }
 }
 
+NnetComputationDiskCache* CachingOptimizingCompiler::GetDiskCache() {
+  if (config_.computation_cache.empty())
+    return NULL;
+  std::lock_guard<std::mutex> lock(disk_cache_mutex_);
+  if (disk_cache_ == NULL)
+    disk_cache_ = NnetComputationDiskCache::GetShared(config_.computation_cache,
+                                                      nnet_);
+  return disk_cache_.get();
+}
+
+std::string CachingOptimizingCompiler::DiskCacheKey(
+    const ComputationRequest &request) const {
+  std::ostringstream os;
+  bool binary = true;
+  WriteToken(os, binary, "<CachingOptimizingCompiler>");
+  opt_config_.Write(os, binary);
+  WriteBasicType(os, binary, config_.use_shortcut);
+  request.Write(os, binary);
+  return os.str();
+}
+
 
 const NnetComputation *CachingOptimizingCompiler::CompileNoShortcut(
     const ComputationRequest &request) {
@@ -21,9 +21,12 @@
 #ifndef KALDI_NNET3_NNET_OPTIMIZE_H_
 #define KALDI_NNET3_NNET_OPTIMIZE_H_
 
+#include <atomic>
+#include <deque>
 #include "nnet3/nnet-compile.h"
 #include "nnet3/nnet-analyze.h"
 #include "nnet3/nnet-optimize-utils.h"
+#include "nnet3/nnet-computation-disk-cache.h"
 
 namespace kaldi {
 namespace nnet3 {
@@ -192,6 +195,12 @@ void Optimize(const NnetOptimizeOptions &config,
 struct CachingOptimizingCompilerOptions {
   bool use_shortcut;
   int32 cache_capacity;
+  // If nonempty, the filename of a persistent cache of compiled computations
+  // (see class NnetComputationDiskCache).  This is not registered by
+  // Register() because it is only useful for programs that compile the same
+  // computations every time they are run, such as decoders; those register
+  // it themselves (see NnetSimpleComputationOptions).
+  std::string computation_cache;
 
   CachingOptimizingCompilerOptions():
       use_shortcut(true),
@@ -242,6 +251,14 @@ class CachingOptimizingCompiler {
   void ReadCache(std::istream &is, bool binary);
   void WriteCache(std::ostream &os, bool binary);
 
+  /// Prints the overall cache hit rate of Compile() and, for each distinct
+  /// "shape" of computation request that had to be compiled (the names, 't'
+  /// ranges and numbers of sequences of its inputs and outputs), how many
+  /// times it was compiled and the time spent compiling it, including the
+  /// recompilations of computations that had recently been evicted from the
+  /// cache (see --compiler.cache-capacity).
+  void PrintShapeStats() const;
+
 
   // GetSimpleNnetContext() is equivalent to calling:
   // ComputeSimpleNnetContext(nnet_, &nnet_left_context,
@@ -257,7 +274,10 @@ class CachingOptimizingCompiler {
   // This function just implements the work of Compile(); it's made a separate
   // function for the convenience of the timer code, to avoid it being called
   // twice (we also call this function directly from inside the class).
-  std::shared_ptr<const NnetComputation> CompileInternal(const ComputationRequest &request);
+  // If 'compiled' is not NULL, it sets *compiled to true if the computation
+  // was not in the cache (or the disk cache) and had to be compiled.
+  std::shared_ptr<const NnetComputation> CompileInternal(
+      const ComputationRequest &request, bool *compiled = NULL);
 
   // This function, called from CompileInternal(), is called when a
   // ComputationRequest has been determined not to have already been cached.  It
@@ -285,6 +305,22 @@ class CachingOptimizingCompiler {
   // the computation cache).
   const NnetComputation *CompileNoShortcut(const ComputationRequest &request);
 
+  // Returns disk_cache_, first creating it (which reads the file) if
+  // config_.computation_cache is set and this is the first call; returns NULL
+  // if config_.computation_cache is not set.  It is safe to call this from
+  // multiple threads.
+  NnetComputationDiskCache *GetDiskCache();
+
+  // Returns the key for 'request' in disk_cache_; it covers the request and
+  // the options that affect the compiled computation.
+  std::string DiskCacheKey(const ComputationRequest &request) const;
+
+  // Adds 'request', which was evicted from cache_ and is now owned by this
+  // class, to evicted_requests_ (Compile() then removes the oldest ones if
+  // there are more than config_.cache_capacity); does nothing if 'request'
+  // is NULL.
+  void RecordEvicted(const ComputationRequest *request);
+
   const Nnet &nnet_;
   CachingOptimizingCompilerOptions config_;
   NnetOptimizeOptions opt_config_;
@@ -299,8 +335,39 @@ class CachingOptimizingCompiler {
   double seconds_taken_indexes_;
   double seconds_taken_io_;
 
+  // The number of calls to Compile(), for PrintShapeStats().
+  std::atomic<int64> num_requests_;
+  // Statistics per shape of the computation requests that had to be compiled,
+  // for PrintShapeStats().
+  struct ShapeStats {
+    int32 num_compilations;
+    // The number of times a request was compiled again after it had been
+    // evicted from the cache.
+    int32 num_recompilations;
+    double seconds_taken;  // Time spent compiling.
+    ShapeStats(): num_compilations(0), num_recompilations(0),
+                  seconds_taken(0.0) { }
+  };
+  unordered_map<std::string, ShapeStats, StringHasher> shape_stats_;
+  // The most recently evicted requests (at most config_.cache_capacity of
+  // them, oldest first in evicted_queue_), which we own; used to detect
+  // recompilations.
+  unordered_set<const ComputationRequest*, ComputationRequestHasher,
+                ComputationRequestPtrEqual> evicted_requests_;
+  std::deque<const ComputationRequest*> evicted_queue_;
+  mutable std::mutex shape_stats_mutex_;
+
   ComputationCache cache_;
 
+  // The persistent cache, if config_.computation_cache is set; it is created
+  // the first time it is needed, so that the model can still be modified
+  // after this object is constructed.  It is shared with other users of the
+  // same file and model in this process (see
+  // NnetComputationDiskCache::GetShared()), and written out by the
+  // destructor.
+  std::shared_ptr<NnetComputationDiskCache> disk_cache_;
+  std::mutex disk_cache_mutex_;
+
   // These following two variables are only used by the function GetSimpleNnetContext().
   int32 nnet_left_context_;
   int32 nnet_right_context_;
@@ -0,0 +1,93 @@
+// nnet3/nnet-quantized-component-speed-test.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "base/kaldi-simd.h"
+#include "base/timer.h"
+#include "nnet3/nnet-quantized-component.h"
+#include "util/common-utils.h"
+
+namespace kaldi {
+namespace nnet3 {
+
+// This compares the speed of QuantizedMatrix::AddMatMatTrans() at each
+// SimdLevel the machine supports with that of the floating-point product
+// (i.e. BLAS), for the sizes of typical TDNN-F layers.
+
+static const char *SimdLevelName(int32 level) {
+  switch (level) {
+    case kSimdNone: return "plain C++";
+    case kSimdAvx2: return "AVX2";
+    case kSimdAvx512: return "AVX-512";
+    default: return "AVX-512 VNNI";
+  }
+}
+
+static void TestQuantizedMatrixSpeed(int32 num_rows, int32 num_cols,
+                                     int32 num_frames) {
+  BaseFloat time_in_secs = 0.2;
+  CuMatrix<BaseFloat> M(num_rows, num_cols), in(num_frames, num_cols),
+      out(num_frames, num_rows);
+  M.SetRandn();
+  in.SetRandn();
+  QuantizedMatrix qm(M);
+  double flops = 2.0 * num_rows * num_cols * num_frames;
+
+  Timer timer;
+  int32 iter = 0;
+  for (; timer.Elapsed() < time_in_secs; iter++)
+    out.AddMatMat(1.0, in, kNoTrans, M, kTrans, 1.0);
+  double float_gflops = flops * iter / (timer.Elapsed() * 1.0e+09);
+  KALDI_LOG << "For " << num_frames << " frames of " << num_rows << " x "
+            << num_cols << ", float product: " << float_gflops
+            << " gigaflops";
+
+  SimdLevel max_level = GetSimdLevel();
+  for (int32 level = kSimdNone; level <= max_level; level++) {
+    SetMaxSimdLevel(static_cast<SimdLevel>(level));
+    timer.Reset();
+    iter = 0;
+    for (; timer.Elapsed() < time_in_secs; iter++)
+      qm.AddMatMatTrans(in, &out);
+    double gflops = flops * iter / (timer.Elapsed() * 1.0e+09);
+    KALDI_LOG << "... quantized product, " << SimdLevelName(level) << ": "
+              << gflops << " gigaflops, speedup vs. float is "
+              << (gflops / float_gflops);
+  }
+  SetMaxSimdLevel(kSimdAvx512Vnni);
+}
+
+
+} // namespace nnet3
+} // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  using namespace kaldi::nnet3;
+#if HAVE_CUDA == 1
+  CuDevice::Instantiate().SelectGpuId("no");
+#endif
+  // The 'linear' and 'affine' parts of a TDNN-F layer with 1536 units and a
+  // 160-dimensional bottleneck, and a full 1536 x 1536 layer.
+  TestQuantizedMatrixSpeed(160, 1536 * 2, 128);
+  TestQuantizedMatrixSpeed(1536, 160 * 2, 128);
+  TestQuantizedMatrixSpeed(1536, 1536, 128);
+  TestQuantizedMatrixSpeed(1536, 1536, 16);
+  KALDI_LOG << "Tests succeeded.";
+  return 0;
+}
@@ -0,0 +1,196 @@
+// nnet3/nnet-quantized-component-test.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nnet3/nnet-quantized-component.h"
+#include "nnet3/nnet-computation.h"
+#include "util/common-utils.h"
+#include "base/kaldi-simd.h"
+
+namespace kaldi {
+namespace nnet3 {
+
+
+// Checks that the quantized product is close to the floating-point one.
+void UnitTestQuantizedMatrix() {
+  int32 num_rows = RandInt(1, 50), num_cols = RandInt(1, 300),
+      num_frames = RandInt(1, 20);
+  CuMatrix<BaseFloat> M(num_rows, num_cols), in(num_frames, num_cols),
+      out(num_frames, num_rows), ref_out(num_frames, num_rows);
+  M.SetRandn();
+  in.SetRandn();
+  out.SetRandn();
+  ref_out.CopyFromMat(out);
+
+  QuantizedMatrix qm(M);
+  KALDI_ASSERT(qm.NumRows() == num_rows && qm.NumCols() == num_cols);
+  qm.AddMatMatTrans(in, &out);
+  ref_out.AddMatMat(1.0, in, kNoTrans, M, kTrans, 1.0);
+
+  // Each element of the error is a sum of 'num_cols' roughly independent
+  // rounding errors, so allow for a relative error of a few percent.
+  CuMatrix<BaseFloat> diff(out);
+  diff.AddMat(-1.0, ref_out);
+  BaseFloat rel_error = diff.FrobeniusNorm() /
+      (std::max<BaseFloat>(ref_out.FrobeniusNorm(), 1.0e-10));
+  KALDI_LOG << "Relative error of quantized product is " << rel_error;
+  KALDI_ASSERT(rel_error < 0.05);
+
+  Matrix<BaseFloat> dequantized;
+  qm.GetMatrix(&dequantized);
+  CuMatrix<BaseFloat> cu_dequantized(dequantized);
+  cu_dequantized.AddMat(-1.0, M);
+  KALDI_ASSERT(cu_dequantized.FrobeniusNorm() < 0.02 * M.FrobeniusNorm() +
+               1.0e-10);
+
+  // The int8 sums are exact, so the plain C++, AVX2 and AVX-512 kernels
+  // should all give the same answer.
+  SimdLevel max_level = GetSimdLevel();
+  CuMatrix<BaseFloat> prod(num_frames, num_rows);
+  qm.AddMatMatTrans(in, &prod);
+  for (int32 level = kSimdNone; level < max_level; level++) {
+    SetMaxSimdLevel(static_cast<SimdLevel>(level));
+    CuMatrix<BaseFloat> prod2(num_frames, num_rows);
+    qm.AddMatMatTrans(in, &prod2);
+    KALDI_ASSERT(prod.ApproxEqual(prod2, 1.0e-06));
+  }
+  SetMaxSimdLevel(kSimdAvx512Vnni);
+
+  // Test I/O.
+  for (int32 i = 0; i < 2; i++) {
+    bool binary = (i == 0);
+    std::ostringstream os;
+    qm.Write(os, binary);
+    QuantizedMatrix qm2;
+    std::istringstream is(os.str());
+    qm2.Read(is, binary);
+    Matrix<BaseFloat> dequantized2;
+    qm2.GetMatrix(&dequantized2);
+    KALDI_ASSERT(dequantized.ApproxEqual(dequantized2, 1.0e-05));
+  }
+}
+
+void UnitTestQuantizedAffineComponent() {
+  int32 input_dim = RandInt(1, 100), output_dim = RandInt(1, 100),
+      num_frames = RandInt(1, 20);
+  CuMatrix<BaseFloat> linear_params(output_dim, input_dim);
+  CuVector<BaseFloat> bias_params(output_dim);
+  linear_params.SetRandn();
+  bias_params.SetRandn();
+  AffineComponent affine(linear_params, bias_params, 0.001);
+  QuantizedAffineComponent quantized(affine);
+  KALDI_ASSERT(quantized.InputDim() == input_dim &&
+               quantized.OutputDim() == output_dim);
+
+  CuMatrix<BaseFloat> in(num_frames, input_dim),
+      out(num_frames, output_dim), ref_out(num_frames, output_dim);
+  in.SetRandn();
+  affine.Propagate(NULL, in, &ref_out);
+  quantized.Propagate(NULL, in, &out);
+  CuMatrix<BaseFloat> diff(out);
+  diff.AddMat(-1.0, ref_out);
+  KALDI_ASSERT(diff.FrobeniusNorm() <
+               0.05 * ref_out.FrobeniusNorm() + 1.0e-05);
+
+  std::ostringstream os;
+  quantized.Write(os, true);
+  std::istringstream is(os.str());
+  Component *c = Component::ReadNew(is, true);
+  KALDI_ASSERT(c->Type() == "QuantizedAffineComponent" &&
+               c->InputDim() == input_dim && c->OutputDim() == output_dim);
+  KALDI_LOG << c->Info();
+  delete c;
+}
+
+// Checks QuantizedTdnnComponent against the TdnnComponent it was created from.
+void UnitTestQuantizedTdnnComponent() {
+  int32 input_dim = RandInt(1, 100), output_dim = RandInt(1, 100),
+      num_frames = RandInt(1, 20);
+  std::ostringstream config;
+  config << "input-dim=" << input_dim << " output-dim=" << output_dim
+         << " time-offsets=" << (RandInt(0, 1) == 0 ? "-1,0,1" : "-3,0,2")
+         << " bias-stddev=1.0 use-bias=" << (RandInt(0, 1) == 0 ?
+                                               "true" : "false");
+  ConfigLine cfl;
+  KALDI_ASSERT(cfl.ParseLine(config.str()));
+  TdnnComponent tdnn;
+  tdnn.InitFromConfig(&cfl);
+  QuantizedTdnnComponent quantized(tdnn);
+  KALDI_ASSERT(quantized.InputDim() == input_dim &&
+               quantized.OutputDim() == output_dim);
+
+  std::vector<Index> input_indexes, output_indexes;
+  for (int32 t = 0; t < num_frames; t++)
+    output_indexes.push_back(Index(0, t));
+  for (int32 t = -3; t < num_frames + 2; t++)
+    input_indexes.push_back(Index(0, t));
+  tdnn.ReorderIndexes(&input_indexes, &output_indexes);
+  MiscComputationInfo misc_info;
+  ComponentPrecomputedIndexes *indexes =
+      tdnn.PrecomputeIndexes(misc_info, input_indexes, output_indexes, false),
+      *quantized_indexes = quantized.PrecomputeIndexes(
+          misc_info, input_indexes, output_indexes, false);
+
+  CuMatrix<BaseFloat> in(input_indexes.size(), input_dim),
+      out(output_indexes.size(), output_dim),
+      ref_out(output_indexes.size(), output_dim);
+  in.SetRandn();
+  tdnn.Propagate(indexes, in, &ref_out);
+  quantized.Propagate(quantized_indexes, in, &out);
+  CuMatrix<BaseFloat> diff(out);
+  diff.AddMat(-1.0, ref_out);
+  BaseFloat rel_error = diff.FrobeniusNorm() /
+      (std::max<BaseFloat>(ref_out.FrobeniusNorm(), 1.0e-10));
+  KALDI_LOG << "Relative error of quantized TDNN is " << rel_error;
+  KALDI_ASSERT(rel_error < 0.05);
+  delete indexes;
+  delete quantized_indexes;
+
+  std::ostringstream os;
+  quantized.Write(os, false);
+  std::istringstream is(os.str());
+  Component *c = Component::ReadNew(is, false);
+  KALDI_ASSERT(c->Type() == "QuantizedTdnnComponent" &&
+               c->InputDim() == input_dim && c->OutputDim() == output_dim);
+  KALDI_LOG << c->Info();
+  delete c;
+}
+
+
+} // namespace nnet3
+} // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  using namespace kaldi::nnet3;
+  for (int32 loop = 0; loop < 2; loop++) {
+#if HAVE_CUDA == 1
+    if (loop == 0)
+      CuDevice::Instantiate().SelectGpuId("no");
+    else
+      CuDevice::Instantiate().SelectGpuId("optional");
+#endif
+    for (int32 i = 0; i < 5; i++) {
+      UnitTestQuantizedMatrix();
+      UnitTestQuantizedAffineComponent();
+      UnitTestQuantizedTdnnComponent();
+    }
+  }
+  KALDI_LOG << "Quantized component tests succeeded.";
+  return 0;
+}
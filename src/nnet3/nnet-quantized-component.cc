@@ -0,0 +1,617 @@
+// nnet3/nnet-quantized-component.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <sstream>
+#include "nnet3/nnet-quantized-component.h"
+#include "nnet3/nnet-parse.h"
+#include "nnet3/nnet-computation-graph.h"
+#include "cudamatrix/cu-device.h"
+#include "base/kaldi-simd.h"
+
+#ifdef KALDI_HAVE_X86_SIMD
+#define KALDI_QUANTIZED_SIMD 1
+#include <immintrin.h>
+#define KALDI_AVX2 __attribute__((target("avx2,fma")))
+#define KALDI_AVX512 \
+  __attribute__((target("avx512f,avx512bw,avx512vl,avx2,fma")))
+#define KALDI_AVX512_VNNI \
+  __attribute__((target("avx512f,avx512bw,avx512vl,avx512vnni,avx2,fma")))
+#endif
+
+namespace kaldi {
+namespace nnet3 {
+
+
+// Quantizes the 'dim' elements of 'in' to 'out', with the scale set so that
+// the element of largest magnitude maps to +-127.
+static void QuantizeRow(const BaseFloat *in, int32 dim,
+                        int8 *out, BaseFloat *scale) {
+  BaseFloat max_abs = 0.0;
+  for (int32 i = 0; i < dim; i++)
+    max_abs = std::max(max_abs, std::abs(in[i]));
+  if (max_abs == 0.0) {
+    std::fill(out, out + dim, 0);
+    *scale = 0.0;
+    return;
+  }
+  BaseFloat inv_scale = 127.0 / max_abs;
+  for (int32 i = 0; i < dim; i++)
+    out[i] = static_cast<int8>(std::floor(in[i] * inv_scale + 0.5));
+  *scale = max_abs / 127.0;
+}
+
+// The int8 kernels.  Each one computes the dot products of two (padded) input
+// rows x0 and x1 with 'num_rows' consecutive rows of the weights, where
+// num_rows is a multiple of 4, and writes them to sums0 and sums1.  The
+// vectorized versions work on two frames and four rows at a time, so each
+// load of the weights is used twice and each load of the inputs four times.
+// 'stride' is the (padded) row length, a multiple of 64, and 'row_offsets'
+// is the corresponding part of QuantizedMatrix::row_offsets_, which only the
+// VNNI kernel uses.
+typedef void (*Int8Kernel)(const int8 *x0, const int8 *x1, const int8 *w,
+                           int32 stride, int32 num_rows,
+                           const int32 *row_offsets,
+                           int32 *sums0, int32 *sums1);
+
+static void DotProductsInt8(const int8 *x0, const int8 *x1, const int8 *w,
+                            int32 stride, int32 num_rows,
+                            const int32 *row_offsets,
+                            int32 *sums0, int32 *sums1) {
+  for (int32 r = 0; r < num_rows; r++, w += stride) {
+    int32 sum0 = 0, sum1 = 0;
+    for (int32 c = 0; c < stride; c++) {
+      sum0 += static_cast<int32>(x0[c]) * static_cast<int32>(w[c]);
+      sum1 += static_cast<int32>(x1[c]) * static_cast<int32>(w[c]);
+    }
+    sums0[r] = sum0;
+    sums1[r] = sum1;
+  }
+}
+
+#ifdef KALDI_QUANTIZED_SIMD
+
+// Returns the sums of the elements of a, b, c and d (in that order).
+static inline KALDI_AVX2 __m128i HorizontalSum4Avx2(__m256i a, __m256i b,
+                                                    __m256i c, __m256i d) {
+  __m256i sum = _mm256_hadd_epi32(_mm256_hadd_epi32(a, b),
+                                  _mm256_hadd_epi32(c, d));
+  return _mm_add_epi32(_mm256_castsi256_si128(sum),
+                       _mm256_extracti128_si256(sum, 1));
+}
+
+// The AVX2 version: sign-extends 16 elements at a time to 16 bits and uses
+// vpmaddwd, which is exact (unlike vpmaddubsw, which saturates).
+//
+// As in feat/feature-simd.cc, the kernels call _mm256_zeroupper() themselves
+// because GCC only does that at -O2 and above.
+static KALDI_AVX2 void DotProductsInt8Avx2(
+    const int8 *x0, const int8 *x1, const int8 *w, int32 stride,
+    int32 num_rows, const int32 *row_offsets, int32 *sums0, int32 *sums1) {
+  for (int32 r = 0; r < num_rows; r += 4, w += 4 * stride) {
+    const int8 *w0 = w, *w1 = w + stride, *w2 = w + 2 * stride,
+        *w3 = w + 3 * stride;
+    __m256i s00 = _mm256_setzero_si256(), s01 = s00, s02 = s00, s03 = s00,
+        s10 = s00, s11 = s00, s12 = s00, s13 = s00;
+    for (int32 c = 0; c < stride; c += 16) {
+      __m256i a0 = _mm256_cvtepi8_epi16(
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(x0 + c))),
+          a1 = _mm256_cvtepi8_epi16(
+              _mm_loadu_si128(reinterpret_cast<const __m128i*>(x1 + c))),
+          b0 = _mm256_cvtepi8_epi16(
+              _mm_loadu_si128(reinterpret_cast<const __m128i*>(w0 + c))),
+          b1 = _mm256_cvtepi8_epi16(
+              _mm_loadu_si128(reinterpret_cast<const __m128i*>(w1 + c))),
+          b2 = _mm256_cvtepi8_epi16(
+              _mm_loadu_si128(reinterpret_cast<const __m128i*>(w2 + c))),
+          b3 = _mm256_cvtepi8_epi16(
+              _mm_loadu_si128(reinterpret_cast<const __m128i*>(w3 + c)));
+      s00 = _mm256_add_epi32(s00, _mm256_madd_epi16(a0, b0));
+      s01 = _mm256_add_epi32(s01, _mm256_madd_epi16(a0, b1));
+      s02 = _mm256_add_epi32(s02, _mm256_madd_epi16(a0, b2));
+      s03 = _mm256_add_epi32(s03, _mm256_madd_epi16(a0, b3));
+      s10 = _mm256_add_epi32(s10, _mm256_madd_epi16(a1, b0));
+      s11 = _mm256_add_epi32(s11, _mm256_madd_epi16(a1, b1));
+      s12 = _mm256_add_epi32(s12, _mm256_madd_epi16(a1, b2));
+      s13 = _mm256_add_epi32(s13, _mm256_madd_epi16(a1, b3));
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(sums0 + r),
+                     HorizontalSum4Avx2(s00, s01, s02, s03));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(sums1 + r),
+                     HorizontalSum4Avx2(s10, s11, s12, s13));
+  }
+  _mm256_zeroupper();
+}
+
+// Adds the two halves of a 512-bit vector of int32's.  (The masked extracts
+// avoid a spurious -Wuninitialized warning from GCC's unmasked ones.)
+static inline KALDI_AVX512 __m256i FoldAvx512(__m512i v) {
+  return _mm256_add_epi32(_mm512_maskz_extracti64x4_epi64(0xff, v, 0),
+                          _mm512_maskz_extracti64x4_epi64(0xff, v, 1));
+}
+
+// The AVX-512 version: like the AVX2 one, with 32 elements at a time.
+static KALDI_AVX512 void DotProductsInt8Avx512(
+    const int8 *x0, const int8 *x1, const int8 *w, int32 stride,
+    int32 num_rows, const int32 *row_offsets, int32 *sums0, int32 *sums1) {
+  for (int32 r = 0; r < num_rows; r += 4, w += 4 * stride) {
+    const int8 *w0 = w, *w1 = w + stride, *w2 = w + 2 * stride,
+        *w3 = w + 3 * stride;
+    __m512i s00 = _mm512_setzero_si512(), s01 = s00, s02 = s00, s03 = s00,
+        s10 = s00, s11 = s00, s12 = s00, s13 = s00;
+    for (int32 c = 0; c < stride; c += 32) {
+      __m512i a0 = _mm512_cvtepi8_epi16(
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x0 + c))),
+          a1 = _mm512_cvtepi8_epi16(
+              _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x1 + c))),
+          b0 = _mm512_cvtepi8_epi16(
+              _mm256_loadu_si256(reinterpret_cast<const __m256i*>(w0 + c))),
+          b1 = _mm512_cvtepi8_epi16(
+              _mm256_loadu_si256(reinterpret_cast<const __m256i*>(w1 + c))),
+          b2 = _mm512_cvtepi8_epi16(
+              _mm256_loadu_si256(reinterpret_cast<const __m256i*>(w2 + c))),
+          b3 = _mm512_cvtepi8_epi16(
+              _mm256_loadu_si256(reinterpret_cast<const __m256i*>(w3 + c)));
+      s00 = _mm512_add_epi32(s00, _mm512_madd_epi16(a0, b0));
+      s01 = _mm512_add_epi32(s01, _mm512_madd_epi16(a0, b1));
+      s02 = _mm512_add_epi32(s02, _mm512_madd_epi16(a0, b2));
+      s03 = _mm512_add_epi32(s03, _mm512_madd_epi16(a0, b3));
+      s10 = _mm512_add_epi32(s10, _mm512_madd_epi16(a1, b0));
+      s11 = _mm512_add_epi32(s11, _mm512_madd_epi16(a1, b1));
+      s12 = _mm512_add_epi32(s12, _mm512_madd_epi16(a1, b2));
+      s13 = _mm512_add_epi32(s13, _mm512_madd_epi16(a1, b3));
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(sums0 + r),
+                     HorizontalSum4Avx2(FoldAvx512(s00), FoldAvx512(s01),
+                                        FoldAvx512(s02), FoldAvx512(s03)));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(sums1 + r),
+                     HorizontalSum4Avx2(FoldAvx512(s10), FoldAvx512(s11),
+                                        FoldAvx512(s12), FoldAvx512(s13)));
+  }
+  _mm256_zeroupper();
+}
+
+// The VNNI version, which does 64 multiply-adds per instruction with
+// vpdpbusd.  That instruction multiplies unsigned by signed bytes, so we add
+// 128 to the inputs (by flipping their top bit) and subtract 128 times the
+// row sums of the weights afterwards.  The int32 sums may wrap around in
+// between, but the final results are exact.
+static KALDI_AVX512_VNNI void DotProductsInt8Avx512Vnni(
+    const int8 *x0, const int8 *x1, const int8 *w, int32 stride,
+    int32 num_rows, const int32 *row_offsets, int32 *sums0, int32 *sums1) {
+  const __m512i flip = _mm512_set1_epi8(static_cast<char>(0x80));
+  for (int32 r = 0; r < num_rows; r += 4, w += 4 * stride) {
+    const int8 *w0 = w, *w1 = w + stride, *w2 = w + 2 * stride,
+        *w3 = w + 3 * stride;
+    __m512i s00 = _mm512_setzero_si512(), s01 = s00, s02 = s00, s03 = s00,
+        s10 = s00, s11 = s00, s12 = s00, s13 = s00;
+    for (int32 c = 0; c < stride; c += 64) {
+      __m512i a0 = _mm512_xor_si512(_mm512_loadu_si512(x0 + c), flip),
+          a1 = _mm512_xor_si512(_mm512_loadu_si512(x1 + c), flip),
+          b0 = _mm512_loadu_si512(w0 + c), b1 = _mm512_loadu_si512(w1 + c),
+          b2 = _mm512_loadu_si512(w2 + c), b3 = _mm512_loadu_si512(w3 + c);
+      s00 = _mm512_dpbusd_epi32(s00, a0, b0);
+      s01 = _mm512_dpbusd_epi32(s01, a0, b1);
+      s02 = _mm512_dpbusd_epi32(s02, a0, b2);
+      s03 = _mm512_dpbusd_epi32(s03, a0, b3);
+      s10 = _mm512_dpbusd_epi32(s10, a1, b0);
+      s11 = _mm512_dpbusd_epi32(s11, a1, b1);
+      s12 = _mm512_dpbusd_epi32(s12, a1, b2);
+      s13 = _mm512_dpbusd_epi32(s13, a1, b3);
+    }
+    __m128i offsets = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(row_offsets + r));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(sums0 + r),
+                     _mm_sub_epi32(HorizontalSum4Avx2(
+                         FoldAvx512(s00), FoldAvx512(s01),
+                         FoldAvx512(s02), FoldAvx512(s03)), offsets));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(sums1 + r),
+                     _mm_sub_epi32(HorizontalSum4Avx2(
+                         FoldAvx512(s10), FoldAvx512(s11),
+                         FoldAvx512(s12), FoldAvx512(s13)), offsets));
+  }
+  _mm256_zeroupper();
+}
+
+#endif  // KALDI_QUANTIZED_SIMD
+
+static Int8Kernel GetInt8Kernel() {
+#ifdef KALDI_QUANTIZED_SIMD
+  switch (GetSimdLevel()) {
+    case kSimdAvx512Vnni: return DotProductsInt8Avx512Vnni;
+    case kSimdAvx512: return DotProductsInt8Avx512;
+    case kSimdAvx2: return DotProductsInt8Avx2;
+    default: break;
+  }
+#endif
+  return DotProductsInt8;
+}
+
+
+QuantizedMatrix::QuantizedMatrix(const CuMatrixBase<BaseFloat> &mat) {
+  Init(mat.NumRows(), mat.NumCols());
+  Matrix<BaseFloat> cpu_mat(mat);
+  for (int32 r = 0; r < num_rows_; r++)
+    QuantizeRow(cpu_mat.RowData(r), num_cols_,
+                &(data_[static_cast<size_t>(r) * stride_]),
+                &(row_scales_(r)));
+  ComputeRowOffsets();
+}
+
+void QuantizedMatrix::Init(int32 num_rows, int32 num_cols) {
+  // Each product of two int8's is at most 128 * 128 in magnitude, so this
+  // ensures the int32 sums (and row_offsets_) can't overflow.
+  KALDI_ASSERT(num_rows >= 0 && num_cols >= 0 && num_cols < (1 << 17));
+  num_rows_ = num_rows;
+  num_cols_ = num_cols;
+  stride_ = (num_cols + 63) / 64 * 64;
+  int32 padded_num_rows = (num_rows + 3) / 4 * 4;
+  data_.assign(static_cast<size_t>(padded_num_rows) * stride_, 0);
+  row_offsets_.assign(padded_num_rows, 0);
+  row_scales_.Resize(num_rows);
+}
+
+void QuantizedMatrix::ComputeRowOffsets() {
+  for (int32 r = 0; r < num_rows_; r++) {
+    const int8 *data = &(data_[static_cast<size_t>(r) * stride_]);
+    int32 sum = 0;
+    for (int32 c = 0; c < num_cols_; c++)
+      sum += data[c];
+    row_offsets_[r] = 128 * sum;
+  }
+}
+
+void QuantizedMatrix::AddMatMatTrans(const CuMatrixBase<BaseFloat> &in,
+                                     CuMatrixBase<BaseFloat> *out) const {
+  KALDI_ASSERT(in.NumCols() == num_cols_ && out->NumCols() == num_rows_ &&
+               in.NumRows() == out->NumRows());
+#if HAVE_CUDA == 1
+  if (CuDevice::Instantiate().Enabled()) {
+    Matrix<BaseFloat> cpu_in(in), cpu_out(*out);
+    AddMatMatTransCpu(cpu_in, &cpu_out);
+    out->CopyFromMat(cpu_out);
+    return;
+  }
+#endif
+  AddMatMatTransCpu(in.Mat(), &(out->Mat()));
+}
+
+void QuantizedMatrix::AddMatMatTransCpu(const MatrixBase<BaseFloat> &in,
+                                        MatrixBase<BaseFloat> *out) const {
+  int32 num_frames = in.NumRows();
+  if (num_frames == 0 || num_rows_ == 0)
+    return;
+  // The kernels work on pairs of frames, so if the number of frames is odd
+  // there is an extra frame of zeros.
+  int32 padded_num_frames = (num_frames + 1) / 2 * 2;
+  std::vector<int8> in_data(static_cast<size_t>(padded_num_frames) * stride_,
+                            0);
+  Vector<BaseFloat> in_scales(num_frames, kUndefined);
+  for (int32 t = 0; t < num_frames; t++)
+    QuantizeRow(in.RowData(t), num_cols_,
+                &(in_data[static_cast<size_t>(t) * stride_]),
+                &(in_scales(t)));
+
+  Int8Kernel kernel = GetInt8Kernel();
+  // We go through the weights in blocks of rows that fit in the L2 cache, and
+  // apply each block to all the frames.
+  int32 padded_num_rows = row_offsets_.size(),
+      block_size = std::max<int32>(4, (128 * 1024) / stride_ / 4 * 4);
+  std::vector<int32> sums0(block_size), sums1(block_size);
+  for (int32 r0 = 0; r0 < padded_num_rows; r0 += block_size) {
+    int32 this_block_size = std::min(block_size, padded_num_rows - r0),
+        this_num_rows = std::min(this_block_size, num_rows_ - r0);
+    const int8 *w = &(data_[static_cast<size_t>(r0) * stride_]);
+    const BaseFloat *row_scales = row_scales_.Data() + r0;
+    for (int32 t = 0; t < num_frames; t += 2) {
+      const int8 *x0 = &(in_data[static_cast<size_t>(t) * stride_]);
+      kernel(x0, x0 + stride_, w, stride_, this_block_size,
+             &(row_offsets_[r0]), &(sums0[0]), &(sums1[0]));
+      BaseFloat scale0 = in_scales(t), *out0 = out->RowData(t) + r0;
+      for (int32 r = 0; r < this_num_rows; r++)
+        out0[r] += scale0 * row_scales[r] * sums0[r];
+      if (t + 1 < num_frames) {
+        BaseFloat scale1 = in_scales(t + 1),
+            *out1 = out->RowData(t + 1) + r0;
+        for (int32 r = 0; r < this_num_rows; r++)
+          out1[r] += scale1 * row_scales[r] * sums1[r];
+      }
+    }
+  }
+}
+
+void QuantizedMatrix::GetMatrix(Matrix<BaseFloat> *mat) const {
+  mat->Resize(num_rows_, num_cols_, kUndefined);
+  for (int32 r = 0; r < num_rows_; r++) {
+    const int8 *data = &(data_[static_cast<size_t>(r) * stride_]);
+    BaseFloat scale = row_scales_(r), *row = mat->RowData(r);
+    for (int32 c = 0; c < num_cols_; c++)
+      row[c] = scale * data[c];
+  }
+}
+
+void QuantizedMatrix::Write(std::ostream &os, bool binary) const {
+  WriteBasicType(os, binary, num_rows_);
+  WriteBasicType(os, binary, num_cols_);
+  row_scales_.Write(os, binary);
+  for (int32 r = 0; r < num_rows_; r++) {
+    const int8 *data = &(data_[static_cast<size_t>(r) * stride_]);
+    if (binary) {
+      os.write(reinterpret_cast<const char*>(data), num_cols_);
+    } else {
+      for (int32 c = 0; c < num_cols_; c++)
+        WriteBasicType(os, binary, static_cast<int32>(data[c]));
+    }
+  }
+  if (!binary)
+    os << '\n';
+  if (os.fail())
+    KALDI_ERR << "Error writing quantized matrix to stream.";
+}
+
+void QuantizedMatrix::Read(std::istream &is, bool binary) {
+  int32 num_rows, num_cols;
+  ReadBasicType(is, binary, &num_rows);
+  ReadBasicType(is, binary, &num_cols);
+  Init(num_rows, num_cols);
+  row_scales_.Read(is, binary);
+  KALDI_ASSERT(row_scales_.Dim() == num_rows_);
+  for (int32 r = 0; r < num_rows_; r++) {
+    int8 *data = &(data_[static_cast<size_t>(r) * stride_]);
+    if (binary) {
+      is.read(reinterpret_cast<char*>(data), num_cols_);
+    } else {
+      for (int32 c = 0; c < num_cols_; c++) {
+        int32 value;
+        ReadBasicType(is, binary, &value);
+        KALDI_ASSERT(value >= -128 && value <= 127);
+        data[c] = static_cast<int8>(value);
+      }
+    }
+  }
+  if (is.fail())
+    KALDI_ERR << "Error reading quantized matrix from stream.";
+  ComputeRowOffsets();
+}
+
+
+QuantizedAffineComponent::QuantizedAffineComponent(const AffineComponent &c):
+    linear_params_(c.LinearParams()),
+    bias_params_(c.BiasParams()) { }
+
+QuantizedAffineComponent::QuantizedAffineComponent(const LinearComponent &c):
+    linear_params_(c.Params()) { }
+
+std::string QuantizedAffineComponent::Info() const {
+  std::ostringstream stream;
+  stream << Component::Info();
+  Matrix<BaseFloat> linear_params;
+  linear_params_.GetMatrix(&linear_params);
+  PrintParameterStats(stream, "linear-params",
+                      CuMatrix<BaseFloat>(linear_params));
+  if (bias_params_.Dim() == 0)
+    stream << ", has-bias=false";
+  else
+    PrintParameterStats(stream, "bias", bias_params_, true);
+  return stream.str();
+}
+
+void QuantizedAffineComponent::InitFromConfig(ConfigLine *cfl) {
+  KALDI_ERR << "QuantizedAffineComponent cannot be initialized from a config; "
+            << "use nnet3-am-quantize to create it from a trained model.";
+}
+
+void* QuantizedAffineComponent::Propagate(
+    const ComponentPrecomputedIndexes *indexes,
+    const CuMatrixBase<BaseFloat> &in,
+    CuMatrixBase<BaseFloat> *out) const {
+  // if there is no bias the kPropagateAdds property is set, so 'out' has
+  // been zeroed by the caller.
+  if (bias_params_.Dim() != 0)
+    out->CopyRowsFromVec(bias_params_);
+  linear_params_.AddMatMatTrans(in, out);
+  return NULL;
+}
+
+void QuantizedAffineComponent::Backprop(
+    const std::string &debug_info,
+    const ComponentPrecomputedIndexes *indexes,
+    const CuMatrixBase<BaseFloat> &, // in_value
+    const CuMatrixBase<BaseFloat> &, // out_value
+    const CuMatrixBase<BaseFloat> &, // out_deriv
+    void *memo,
+    Component *to_update,
+    CuMatrixBase<BaseFloat> *in_deriv) const {
+  KALDI_ERR << "QuantizedAffineComponent only supports inference "
+            << "(component " << debug_info << ")";
+}
+
+Component* QuantizedAffineComponent::Copy() const {
+  return new QuantizedAffineComponent(*this);
+}
+
+void QuantizedAffineComponent::Write(std::ostream &os, bool binary) const {
+  WriteToken(os, binary, "<QuantizedAffineComponent>");
+  WriteToken(os, binary, "<LinearParams>");
+  linear_params_.Write(os, binary);
+  WriteToken(os, binary, "<BiasParams>");
+  bias_params_.Write(os, binary);
+  WriteToken(os, binary, "</QuantizedAffineComponent>");
+}
+
+void QuantizedAffineComponent::Read(std::istream &is, bool binary) {
+  ExpectOneOrTwoTokens(is, binary, "<QuantizedAffineComponent>",
+                       "<LinearParams>");
+  linear_params_.Read(is, binary);
+  ExpectToken(is, binary, "<BiasParams>");
+  bias_params_.Read(is, binary);
+  ExpectToken(is, binary, "</QuantizedAffineComponent>");
+}
+
+
+QuantizedTdnnComponent::QuantizedTdnnComponent(const TdnnComponent &c):
+    time_offsets_(c.TimeOffsets()),
+    linear_params_(c.LinearParams()),
+    bias_params_(c.BiasParams()) { }
+
+std::string QuantizedTdnnComponent::Info() const {
+  std::ostringstream stream;
+  stream << Component::Info();
+  stream << ", time-offsets=";
+  for (size_t i = 0; i < time_offsets_.size(); i++) {
+    if (i != 0) stream << ',';
+    stream << time_offsets_[i];
+  }
+  Matrix<BaseFloat> linear_params;
+  linear_params_.GetMatrix(&linear_params);
+  PrintParameterStats(stream, "linear-params",
+                      CuMatrix<BaseFloat>(linear_params));
+  if (bias_params_.Dim() == 0)
+    stream << ", has-bias=false";
+  else
+    PrintParameterStats(stream, "bias", bias_params_, true);
+  return stream.str();
+}
+
+void QuantizedTdnnComponent::InitFromConfig(ConfigLine *cfl) {
+  KALDI_ERR << "QuantizedTdnnComponent cannot be initialized from a config; "
+            << "use nnet3-am-quantize to create it from a trained model.";
+}
+
+void* QuantizedTdnnComponent::Propagate(
+    const ComponentPrecomputedIndexes *indexes_in,
+    const CuMatrixBase<BaseFloat> &in,
+    CuMatrixBase<BaseFloat> *out) const {
+  const TdnnComponent::PrecomputedIndexes *indexes =
+      dynamic_cast<const TdnnComponent::PrecomputedIndexes*>(indexes_in);
+  KALDI_ASSERT(indexes != NULL &&
+               indexes->row_offsets.size() == time_offsets_.size());
+
+  if (bias_params_.Dim() != 0)
+    out->CopyRowsFromVec(bias_params_);
+
+  // Put the input parts for all the time offsets side by side, so that a
+  // single quantized product covers all of them.
+  int32 num_offsets = time_offsets_.size(),
+      input_dim = InputDim();
+  CuMatrix<BaseFloat> full_input(out->NumRows(), input_dim * num_offsets,
+                                 kUndefined);
+  for (int32 i = 0; i < num_offsets; i++) {
+    CuSubMatrix<BaseFloat> in_part = TdnnComponent::GetInputPart(
+        in, out->NumRows(), indexes->row_stride, indexes->row_offsets[i]);
+    full_input.ColRange(i * input_dim, input_dim).CopyFromMat(in_part);
+  }
+  linear_params_.AddMatMatTrans(full_input, out);
+  return NULL;
+}
+
+void QuantizedTdnnComponent::Backprop(
+    const std::string &debug_info,
+    const ComponentPrecomputedIndexes *indexes,
+    const CuMatrixBase<BaseFloat> &, // in_value
+    const CuMatrixBase<BaseFloat> &, // out_value
+    const CuMatrixBase<BaseFloat> &, // out_deriv
+    void *memo,
+    Component *to_update,
+    CuMatrixBase<BaseFloat> *in_deriv) const {
+  KALDI_ERR << "QuantizedTdnnComponent only supports inference "
+            << "(component " << debug_info << ")";
+}
+
+void QuantizedTdnnComponent::Write(std::ostream &os, bool binary) const {
+  WriteToken(os, binary, "<QuantizedTdnnComponent>");
+  WriteToken(os, binary, "<TimeOffsets>");
+  WriteIntegerVector(os, binary, time_offsets_);
+  WriteToken(os, binary, "<LinearParams>");
+  linear_params_.Write(os, binary);
+  WriteToken(os, binary, "<BiasParams>");
+  bias_params_.Write(os, binary);
+  WriteToken(os, binary, "</QuantizedTdnnComponent>");
+}
+
+void QuantizedTdnnComponent::Read(std::istream &is, bool binary) {
+  ExpectOneOrTwoTokens(is, binary, "<QuantizedTdnnComponent>",
+                       "<TimeOffsets>");
+  ReadIntegerVector(is, binary, &time_offsets_);
+  ExpectToken(is, binary, "<LinearParams>");
+  linear_params_.Read(is, binary);
+  ExpectToken(is, binary, "<BiasParams>");
+  bias_params_.Read(is, binary);
+  ExpectToken(is, binary, "</QuantizedTdnnComponent>");
+  KALDI_ASSERT(!time_offsets_.empty() &&
+               linear_params_.NumCols() % time_offsets_.size() == 0);
+}
+
+void QuantizedTdnnComponent::ReorderIndexes(
+    std::vector<Index> *input_indexes,
+    std::vector<Index> *output_indexes) const {
+  TdnnComponent::ReorderTdnnIndexes(input_indexes, output_indexes);
+}
+
+void QuantizedTdnnComponent::GetInputIndexes(
+    const MiscComputationInfo &misc_info,
+    const Index &output_index,
+    std::vector<Index> *desired_indexes) const {
+  KALDI_ASSERT(output_index.t != kNoTime);
+  size_t size = time_offsets_.size();
+  desired_indexes->resize(size);
+  for (size_t i = 0; i < size; i++) {
+    (*desired_indexes)[i].n = output_index.n;
+    (*desired_indexes)[i].t = output_index.t + time_offsets_[i];
+    (*desired_indexes)[i].x = output_index.x;
+  }
+}
+
+bool QuantizedTdnnComponent::IsComputable(
+    const MiscComputationInfo &misc_info,
+    const Index &output_index,
+    const IndexSet &input_index_set,
+    std::vector<Index> *used_inputs) const {
+  KALDI_ASSERT(output_index.t != kNoTime);
+  size_t size = time_offsets_.size();
+  Index index(output_index);
+
+  if (used_inputs != NULL) {
+    used_inputs->clear();
+    used_inputs->reserve(size);
+  }
+  for (size_t i = 0; i < size; i++) {
+    index.t = output_index.t + time_offsets_[i];
+    if (input_index_set(index)) {
+      if (used_inputs != NULL)
+        used_inputs->push_back(index);
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+ComponentPrecomputedIndexes* QuantizedTdnnComponent::PrecomputeIndexes(
+    const MiscComputationInfo &misc_info,
+    const std::vector<Index> &input_indexes,
+    const std::vector<Index> &output_indexes,
+    bool need_backprop) const {
+  return TdnnComponent::PrecomputeTdnnIndexes(time_offsets_, input_indexes,
+                                              output_indexes);
+}
+
+
+} // namespace nnet3
+} // namespace kaldi
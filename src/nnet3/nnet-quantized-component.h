@@ -0,0 +1,225 @@
+// nnet3/nnet-quantized-component.h
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_NNET3_NNET_QUANTIZED_COMPONENT_H_
+#define KALDI_NNET3_NNET_QUANTIZED_COMPONENT_H_
+
+#include "nnet3/nnet-common.h"
+#include "nnet3/nnet-component-itf.h"
+#include "nnet3/nnet-simple-component.h"
+#include "nnet3/nnet-convolutional-component.h"
+#include <iostream>
+
+namespace kaldi {
+namespace nnet3 {
+
+/// @file  nnet-quantized-component.h
+///
+/// This file contains inference-only versions of the affine, linear and TDNN
+/// components, whose weights are stored as 8-bit integers.  They are created
+/// from a trained model by the program nnet3-am-quantize, and cannot be
+/// trained.  The matrix products are done with 8-bit inputs and 32-bit integer
+/// accumulation, on the CPU.
+
+
+/**
+   QuantizedMatrix stores a matrix M in 8-bit form with one scale per row
+   (symmetric quantization): M(r, c) is approximately
+   row_scales_(r) * data_[r * stride_ + c].
+
+   In memory the rows are zero-padded to a multiple of 64 bytes and the
+   number of rows to a multiple of 4, which is what the int8 kernels in
+   AddMatMatTrans() work on; on disk the padding is not stored.
+ */
+class QuantizedMatrix {
+ public:
+  QuantizedMatrix(): num_rows_(0), num_cols_(0), stride_(0) { }
+
+  /// Quantizes 'mat'.
+  explicit QuantizedMatrix(const CuMatrixBase<BaseFloat> &mat);
+
+  int32 NumRows() const { return num_rows_; }
+  int32 NumCols() const { return num_cols_; }
+
+  /// Does *out += in * M^T, where M is this matrix.  The rows of 'in' are
+  /// quantized to 8 bits on the fly (one scale per row), and the products are
+  /// accumulated in 32-bit integers, using AVX2 or AVX-512 (VNNI) code if
+  /// GetSimdLevel() allows it.  If a GPU is in use the data is copied to the
+  /// CPU and back, as there is no GPU implementation.
+  void AddMatMatTrans(const CuMatrixBase<BaseFloat> &in,
+                      CuMatrixBase<BaseFloat> *out) const;
+
+  /// Outputs the de-quantized matrix.
+  void GetMatrix(Matrix<BaseFloat> *mat) const;
+
+  void Read(std::istream &is, bool binary);
+  void Write(std::ostream &os, bool binary) const;
+
+ private:
+  void AddMatMatTransCpu(const MatrixBase<BaseFloat> &in,
+                         MatrixBase<BaseFloat> *out) const;
+
+  // Sets stride_, resizes data_ (zeroing it) and sizes row_offsets_.
+  void Init(int32 num_rows, int32 num_cols);
+  // Sets row_offsets_ from data_.
+  void ComputeRowOffsets();
+
+  int32 num_rows_;
+  int32 num_cols_;
+  int32 stride_;  // num_cols_ rounded up to a multiple of 64.
+  // row-major, with stride stride_ and the number of rows rounded up to a
+  // multiple of 4; the padding is zero.
+  std::vector<int8> data_;
+  // For each (padded) row, 128 times the sum of its elements.  The VNNI
+  // kernel needs unsigned inputs, so it adds 128 to them and subtracts this.
+  std::vector<int32> row_offsets_;
+  Vector<BaseFloat> row_scales_;
+};
+
+
+/**
+   QuantizedAffineComponent is an inference-only version of AffineComponent,
+   NaturalGradientAffineComponent or LinearComponent (in which case it has no
+   bias), with 8-bit weights.
+ */
+class QuantizedAffineComponent: public Component {
+ public:
+  virtual int32 InputDim() const { return linear_params_.NumCols(); }
+  virtual int32 OutputDim() const { return linear_params_.NumRows(); }
+
+  virtual std::string Info() const;
+  virtual void InitFromConfig(ConfigLine *cfl);
+
+  QuantizedAffineComponent() { }  // should only precede Read().
+  QuantizedAffineComponent(const QuantizedAffineComponent &other):
+      linear_params_(other.linear_params_),
+      bias_params_(other.bias_params_) { }
+  explicit QuantizedAffineComponent(const AffineComponent &c);
+  explicit QuantizedAffineComponent(const LinearComponent &c);
+
+  virtual std::string Type() const { return "QuantizedAffineComponent"; }
+  virtual int32 Properties() const {
+    return kSimpleComponent|
+        (bias_params_.Dim() == 0 ? kPropagateAdds : 0);
+  }
+
+  virtual void* Propagate(const ComponentPrecomputedIndexes *indexes,
+                          const CuMatrixBase<BaseFloat> &in,
+                          CuMatrixBase<BaseFloat> *out) const;
+  virtual void Backprop(const std::string &debug_info,
+                        const ComponentPrecomputedIndexes *indexes,
+                        const CuMatrixBase<BaseFloat> &in_value,
+                        const CuMatrixBase<BaseFloat> &out_value,
+                        const CuMatrixBase<BaseFloat> &out_deriv,
+                        void *memo,
+                        Component *to_update,
+                        CuMatrixBase<BaseFloat> *in_deriv) const;
+
+  virtual Component* Copy() const;
+
+  virtual void Read(std::istream &is, bool binary);
+  virtual void Write(std::ostream &os, bool binary) const;
+
+ private:
+  QuantizedMatrix linear_params_;
+  CuVector<BaseFloat> bias_params_;  // empty if there is no bias.
+};
+
+
+/**
+   QuantizedTdnnComponent is an inference-only version of TdnnComponent with
+   8-bit weights.  It uses the same indexes and precomputed indexes as
+   TdnnComponent.
+ */
+class QuantizedTdnnComponent: public Component {
+ public:
+  virtual int32 InputDim() const {
+    return linear_params_.NumCols() / static_cast<int32>(time_offsets_.size());
+  }
+  virtual int32 OutputDim() const { return linear_params_.NumRows(); }
+
+  virtual std::string Info() const;
+  virtual void InitFromConfig(ConfigLine *cfl);
+
+  QuantizedTdnnComponent() { }  // should only precede Read().
+  QuantizedTdnnComponent(const QuantizedTdnnComponent &other):
+      time_offsets_(other.time_offsets_),
+      linear_params_(other.linear_params_),
+      bias_params_(other.bias_params_) { }
+  explicit QuantizedTdnnComponent(const TdnnComponent &c);
+
+  virtual std::string Type() const { return "QuantizedTdnnComponent"; }
+  virtual int32 Properties() const {
+    return kReordersIndexes|
+        (bias_params_.Dim() == 0 ? kPropagateAdds : 0);
+  }
+  virtual void* Propagate(const ComponentPrecomputedIndexes *indexes,
+                          const CuMatrixBase<BaseFloat> &in,
+                          CuMatrixBase<BaseFloat> *out) const;
+  virtual void Backprop(const std::string &debug_info,
+                        const ComponentPrecomputedIndexes *indexes,
+                        const CuMatrixBase<BaseFloat> &in_value,
+                        const CuMatrixBase<BaseFloat> &out_value,
+                        const CuMatrixBase<BaseFloat> &out_deriv,
+                        void *memo,
+                        Component *to_update,
+                        CuMatrixBase<BaseFloat> *in_deriv) const;
+
+  virtual void Read(std::istream &is, bool binary);
+  virtual void Write(std::ostream &os, bool binary) const;
+  virtual Component* Copy() const {
+    return new QuantizedTdnnComponent(*this);
+  }
+
+  virtual void ReorderIndexes(std::vector<Index> *input_indexes,
+                              std::vector<Index> *output_indexes) const;
+
+  virtual void GetInputIndexes(const MiscComputationInfo &misc_info,
+                               const Index &output_index,
+                               std::vector<Index> *desired_indexes) const;
+
+  virtual bool IsComputable(const MiscComputationInfo &misc_info,
+                            const Index &output_index,
+                            const IndexSet &input_index_set,
+                            std::vector<Index> *used_inputs) const;
+
+  virtual ComponentPrecomputedIndexes* PrecomputeIndexes(
+      const MiscComputationInfo &misc_info,
+      const std::vector<Index> &input_indexes,
+      const std::vector<Index> &output_indexes,
+      bool need_backprop) const;
+
+ private:
+  // The same as in TdnnComponent.
+  std::vector<int32> time_offsets_;
+
+  // The quantized version of TdnnComponent's linear_params_, of dimension
+  // OutputDim() by InputDim() * time_offsets_.size().
+  QuantizedMatrix linear_params_;
+
+  // empty if there is no bias.
+  CuVector<BaseFloat> bias_params_;
+};
+
+
+} // namespace nnet3
+} // namespace kaldi
+
+
+#endif
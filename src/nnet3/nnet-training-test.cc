@@ -0,0 +1,323 @@
+// nnet3/nnet-training-test.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "nnet3/nnet-training.h"
+#include "nnet3/nnet-example-utils.h"
+#include "nnet3/nnet-utils.h"
+
+namespace kaldi {
+namespace nnet3 {
+
+// A small feed-forward network with no natural gradient, batchnorm or dropout,
+// so that training on several minibatches in parallel is exactly equivalent
+// to training on them merged.
+static void GetTestNnet(int32 input_dim, int32 output_dim, Nnet *nnet) {
+  std::ostringstream config;
+  config << "component name=affine1 type=AffineComponent input-dim="
+         << (3 * input_dim) << " output-dim=20 learning-rate=0.01\n"
+         << "component name=relu1 type=RectifiedLinearComponent dim=20\n"
+         << "component name=affine2 type=AffineComponent input-dim=20 "
+         << "output-dim=" << output_dim << " learning-rate=0.01\n"
+         << "component name=log-softmax type=LogSoftmaxComponent dim="
+         << output_dim << "\n"
+         << "input-node name=input dim=" << input_dim << "\n"
+         << "component-node name=affine1 component=affine1 "
+         << "input=Append(Offset(input, -1), input, Offset(input, 1))\n"
+         << "component-node name=relu1 component=relu1 input=affine1\n"
+         << "component-node name=affine2 component=affine2 input=relu1\n"
+         << "component-node name=log-softmax component=log-softmax "
+         << "input=affine2\n"
+         << "output-node name=output input=log-softmax objective=linear\n";
+  std::istringstream is(config.str());
+  nnet->ReadConfig(is);
+}
+
+// Makes an example of one sequence with 'num_frames' supervised frames.  All
+// the examples have the same 't' values, as real examples do.
+static void GetTestExample(int32 num_frames, int32 input_dim,
+                           int32 output_dim, NnetExample *eg) {
+  Matrix<BaseFloat> feats(num_frames + 2, input_dim);
+  feats.SetRandn();
+  Posterior post(num_frames);
+  for (int32 t = 0; t < num_frames; t++)
+    post[t].push_back(std::pair<int32, BaseFloat>(RandInt(0, output_dim - 1),
+                                                  1.0));
+  eg->io.clear();
+  eg->io.push_back(NnetIo("input", -1, feats));
+  eg->io.push_back(NnetIo("output", output_dim, 0, post));
+}
+
+// Returns the squared difference between the parameters of the two nnets,
+// relative to the squared change in the parameters of 'nnet1' from 'init'.
+static BaseFloat RelativeDifference(const Nnet &init, const Nnet &nnet1,
+                                    const Nnet &nnet2) {
+  Nnet diff(nnet2), change(nnet1);
+  AddNnet(nnet1, -1.0, &diff);
+  AddNnet(init, -1.0, &change);
+  BaseFloat change_sumsq = DotProduct(change, change);
+  KALDI_ASSERT(change_sumsq > 0.0);
+  return DotProduct(diff, diff) / change_sumsq;
+}
+
+// Checks that training with --num-threads=N on a sequence of minibatches
+// gives the same model as single-threaded training on each group of N of
+// them merged, including the last, partial group that Flush() trains on.
+void UnitTestDataParallelTraining() {
+  int32 input_dim = RandInt(1, 10), output_dim = RandInt(2, 6),
+      num_frames = RandInt(1, 5),
+      num_threads = RandInt(2, 4),
+      num_egs = num_threads * RandInt(1, 5) + RandInt(1, num_threads - 1);
+  Nnet init_nnet;
+  GetTestNnet(input_dim, output_dim, &init_nnet);
+  std::vector<NnetExample> egs(num_egs);
+  for (int32 i = 0; i < num_egs; i++)
+    GetTestExample(num_frames, input_dim, output_dim, &(egs[i]));
+
+  NnetTrainerOptions config;
+  config.momentum = (RandInt(0, 1) == 0 ? 0.0 : 0.5);
+  config.max_param_change = (RandInt(0, 1) == 0 ? 0.0 : 0.2);
+  config.l2_regularize_factor = (RandInt(0, 1) == 0 ? 1.0 : 0.5);
+
+  Nnet nnet1(init_nnet);
+  {
+    NnetTrainer trainer(config, &nnet1);
+    for (int32 i = 0; i < num_egs; i += num_threads) {
+      std::vector<NnetExample> group(
+          egs.begin() + i, egs.begin() + std::min(i + num_threads, num_egs));
+      NnetExample merged_eg;
+      MergeExamples(group, false, &merged_eg);
+      trainer.Train(merged_eg);
+    }
+    KALDI_ASSERT(trainer.PrintTotalStats());
+  }
+
+  Nnet nnet2(init_nnet);
+  {
+    NnetTrainerOptions parallel_config(config);
+    parallel_config.num_threads = num_threads;
+    NnetTrainer trainer(parallel_config, &nnet2);
+    for (int32 i = 0; i < num_egs; i++)
+      trainer.Train(egs[i]);
+    trainer.Flush();
+    // A second call does nothing.
+    trainer.Flush();
+    KALDI_ASSERT(trainer.PrintTotalStats());
+  }
+
+  BaseFloat diff = RelativeDifference(init_nnet, nnet1, nnet2);
+  KALDI_LOG << "With " << num_threads << " threads and " << num_egs
+            << " minibatches, relative difference is " << diff;
+  KALDI_ASSERT(diff < 1.0e-06);
+}
+
+// Returns a minibatch of 'num_sequences' examples from GetTestExample().
+static void GetTestMinibatch(int32 num_sequences, int32 num_frames,
+                             int32 input_dim, int32 output_dim,
+                             NnetExample *minibatch) {
+  std::vector<NnetExample> egs(num_sequences);
+  for (int32 i = 0; i < num_sequences; i++)
+    GetTestExample(num_frames, input_dim, output_dim, &(egs[i]));
+  MergeExamples(egs, false, minibatch);
+}
+
+// Returns the computation request for a minibatch of 'num_sequences' examples
+// padded to 'padded_num_sequences', as NnetTrainer would compute it.
+static void GetPaddedRequest(const Nnet &nnet, int32 num_sequences,
+                             int32 padded_num_sequences,
+                             ComputationRequest *request) {
+  NnetExample eg;
+  GetTestMinibatch(num_sequences, 3, 4, 5, &eg);
+  for (size_t i = 0; i < eg.io.size(); i++) {
+    bool zero_features = (eg.io[i].name == "output");
+    KALDI_ASSERT(PadNnetIo(padded_num_sequences, zero_features,
+                           &(eg.io[i])));
+  }
+  GetComputationRequest(nnet, eg, true, false, request);
+}
+
+// Returns the computation request for a chain minibatch of 'num_sequences'
+// sequences padded to 'padded_num_sequences', as NnetChainTrainer would
+// compute it: the inputs are as in merged NnetIo's, with the sequences one
+// after the other, and the outputs as in merged chain supervision, ordered
+// by 't' and then 'n'.
+static void GetPaddedChainRequest(int32 num_sequences,
+                                  int32 padded_num_sequences,
+                                  ComputationRequest *request) {
+  int32 frames_per_sequence = 4, frame_skip = 3, left_context = 5,
+      right_context = 5;
+  std::vector<Index> input_indexes, output_indexes;
+  for (int32 n = 0; n < num_sequences; n++)
+    for (int32 t = -left_context;
+         t < frames_per_sequence * frame_skip + right_context; t++)
+      input_indexes.push_back(Index(n, t));
+  for (int32 i = 0; i < frames_per_sequence; i++)
+    for (int32 n = 0; n < num_sequences; n++)
+      output_indexes.push_back(Index(n, i * frame_skip));
+  request->inputs.clear();
+  request->outputs.clear();
+  request->inputs.push_back(IoSpecification("input", input_indexes, false));
+  request->outputs.push_back(IoSpecification("output", output_indexes, true));
+  request->outputs.push_back(IoSpecification("output-xent", output_indexes,
+                                             true));
+  request->need_model_derivative = true;
+  request->store_component_stats = false;
+  // This is what NnetChainTrainer::PadMinibatch() and GetComputation() do.
+  std::vector<Index> indexes;
+  KALDI_ASSERT(ChangeNumNValues(request->inputs[0].indexes,
+                                padded_num_sequences, false, &indexes, NULL));
+  request->inputs[0].indexes.swap(indexes);
+  for (size_t i = 0; i < request->outputs.size(); i++) {
+    KALDI_ASSERT(ChangeNumNValues(request->outputs[i].indexes,
+                                  padded_num_sequences, true, &indexes,
+                                  NULL));
+    request->outputs[i].indexes.swap(indexes);
+  }
+}
+
+// Checks that the requests that MinibatchBuckets precompiles are the same as
+// the requests of the padded minibatches of other sizes.
+void UnitTestMinibatchBucketRequests() {
+  NnetTrainerOptions config;
+  config.minibatch_buckets = "8,4,16";
+  MinibatchBuckets buckets(config);
+  KALDI_ASSERT(!buckets.Empty() && buckets.PaddedSize(1) == 4 &&
+               buckets.PaddedSize(4) == 4 && buckets.PaddedSize(5) == 8 &&
+               buckets.PaddedSize(17) == 17);
+
+  Nnet nnet;
+  GetTestNnet(4, 5, &nnet);
+  for (int32 chain = 0; chain < 2; chain++) {
+    int32 num_sequences = RandInt(2, 16),
+        padded_num_sequences = buckets.PaddedSize(num_sequences);
+    ComputationRequest request;
+    if (chain)
+      GetPaddedChainRequest(num_sequences, padded_num_sequences, &request);
+    else
+      GetPaddedRequest(nnet, num_sequences, padded_num_sequences, &request);
+    std::vector<ComputationRequest> bucket_requests;
+    KALDI_ASSERT(buckets.GetBucketRequests(request, &bucket_requests) &&
+                 bucket_requests.size() == 3);
+    for (int32 other_num_sequences = 1; other_num_sequences <= 16;
+         other_num_sequences++) {
+      int32 other_padded = buckets.PaddedSize(other_num_sequences);
+      ComputationRequest other_request;
+      if (chain)
+        GetPaddedChainRequest(other_num_sequences, other_padded,
+                              &other_request);
+      else
+        GetPaddedRequest(nnet, other_num_sequences, other_padded,
+                         &other_request);
+      int32 b = (other_padded == 4 ? 0 : (other_padded == 8 ? 1 : 2));
+      KALDI_ASSERT(other_request == bucket_requests[b]);
+    }
+  }
+
+  // A single sequence does not tell us the layout of the sequences.
+  ComputationRequest request;
+  std::vector<ComputationRequest> bucket_requests;
+  GetPaddedChainRequest(1, 1, &request);
+  KALDI_ASSERT(!buckets.GetBucketRequests(request, &bucket_requests));
+}
+
+// Checks that training with --minibatch-buckets gives the same model as
+// training without, since the padding sequences have zero weight.
+void UnitTestBucketedTraining() {
+  int32 input_dim = RandInt(1, 10), output_dim = RandInt(2, 6),
+      num_frames = RandInt(1, 3), num_minibatches = RandInt(5, 20);
+  Nnet init_nnet;
+  GetTestNnet(input_dim, output_dim, &init_nnet);
+  std::vector<NnetExample> minibatches(num_minibatches);
+  for (int32 i = 0; i < num_minibatches; i++)
+    GetTestMinibatch(RandInt(1, 9), num_frames, input_dim, output_dim,
+                     &(minibatches[i]));
+
+  NnetTrainerOptions config;
+  config.max_param_change = (RandInt(0, 1) == 0 ? 0.0 : 0.2);
+  config.num_threads = RandInt(1, 2);
+  Nnet nnet1(init_nnet), nnet2(init_nnet);
+  for (int32 b = 0; b < 2; b++) {
+    NnetTrainerOptions this_config(config);
+    if (b == 1)
+      this_config.minibatch_buckets = "4,8";
+    NnetTrainer trainer(this_config, (b == 0 ? &nnet1 : &nnet2));
+    for (int32 i = 0; i < num_minibatches; i++)
+      trainer.Train(minibatches[i]);
+    trainer.Flush();
+    KALDI_ASSERT(trainer.PrintTotalStats());
+  }
+
+  BaseFloat diff = RelativeDifference(init_nnet, nnet1, nnet2);
+  KALDI_LOG << "With minibatch buckets and " << config.num_threads
+            << " thread(s), relative difference is " << diff;
+  KALDI_ASSERT(diff < 1.0e-06);
+}
+
+// Checks that NnetTrainer refuses --minibatch-buckets for a model with
+// batch-norm, whose statistics would include the padding sequences.
+void UnitTestBucketsWithBatchnorm() {
+  std::istringstream is(
+      "component name=affine1 type=AffineComponent input-dim=4 output-dim=8 "
+      "learning-rate=0.01\n"
+      "component name=batchnorm1 type=BatchNormComponent dim=8\n"
+      "component name=affine2 type=AffineComponent input-dim=8 output-dim=3 "
+      "learning-rate=0.01\n"
+      "component name=log-softmax type=LogSoftmaxComponent dim=3\n"
+      "input-node name=input dim=4\n"
+      "component-node name=affine1 component=affine1 input=input\n"
+      "component-node name=batchnorm1 component=batchnorm1 input=affine1\n"
+      "component-node name=affine2 component=affine2 input=batchnorm1\n"
+      "component-node name=log-softmax component=log-softmax input=affine2\n"
+      "output-node name=output input=log-softmax objective=linear\n");
+  Nnet nnet;
+  nnet.ReadConfig(is);
+  NnetTrainerOptions config;
+  {
+    NnetTrainer trainer(config, &nnet);  // Should succeed.
+  }
+  config.minibatch_buckets = "4,8";
+  bool refused = false;
+  try {
+    NnetTrainer trainer(config, &nnet);
+  } catch (const KaldiFatalError &e) {
+    refused = (std::string(e.KaldiMessage()).find("batch-norm") !=
+               std::string::npos);
+    KALDI_LOG << "NnetTrainer refused --minibatch-buckets with batch-norm "
+              << "(this is expected).";
+  }
+  KALDI_ASSERT(refused);
+}
+
+} // namespace nnet3
+} // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  using namespace kaldi::nnet3;
+  SetVerboseLevel(2);
+
+  for (int32 i = 0; i < 10; i++)
+    UnitTestDataParallelTraining();
+  UnitTestMinibatchBucketRequests();
+  for (int32 i = 0; i < 5; i++)
+    UnitTestBucketedTraining();
+  UnitTestBucketsWithBatchnorm();
+
+  KALDI_LOG << "Nnet-training tests succeeded.";
+  return 0;
+}
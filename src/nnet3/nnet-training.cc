@@ -20,6 +20,7 @@
 
 #include "nnet3/nnet-training.h"
 #include "nnet3/nnet-utils.h"
+#include "util/kaldi-thread.h"
 
 namespace kaldi {
 namespace nnet3 {
@@ -31,14 +32,28 @@ NnetTrainer::NnetTrainer(const NnetTrainerOptions &config,
     compiler_(*nnet, config_.optimize_config, config_.compiler_config),
     num_minibatches_processed_(0),
     max_change_stats_(*nnet),
-    srand_seed_(RandInt(0, 100000)) {
+    srand_seed_(RandInt(0, 100000)),
+    buckets_(config),
+    warned_padding_(false),
+    parallel_nnets_(NULL) {
+  // The padding sequences are copies of a real sequence, so they would be
+  // included in the statistics that batch-norm computes over the minibatch.
+  if (!buckets_.Empty() && HasBatchnorm(*nnet))
+    KALDI_ERR << "--minibatch-buckets cannot be used with a model that has "
+              << "batch-norm components.";
   if (config.zero_component_stats)
     ZeroComponentStats(nnet);
   KALDI_ASSERT(config.momentum >= 0.0 &&
                config.max_param_change >= 0.0 &&
-               config.backstitch_training_interval > 0);
+               config.backstitch_training_interval > 0 &&
+               config.num_threads > 0);
   delta_nnet_ = nnet_->Copy();
   ScaleNnet(0.0, delta_nnet_);
+  if (config.num_threads > 1) {
+    CheckDataParallelConfig(config);
+    parallel_nnets_ = new DataParallelNnets(config.num_threads,
+                                            nnet_, delta_nnet_);
+  }
 
   if (config_.read_cache != "") {
     bool binary;
@@ -55,12 +70,30 @@ NnetTrainer::NnetTrainer(const NnetTrainerOptions &config,
 
 
 void NnetTrainer::Train(const NnetExample &eg) {
-  bool need_model_derivative = true;
-  ComputationRequest request;
-  GetComputationRequest(*nnet_, eg, need_model_derivative,
-                        config_.store_component_stats,
-                        &request);
-  std::shared_ptr<const NnetComputation> computation = compiler_.Compile(request);
+  if (parallel_nnets_ != NULL) {
+    pending_egs_.push_back(eg);
+    if (static_cast<int32>(pending_egs_.size()) ==
+        parallel_nnets_->NumWorkers())
+      TrainParallel();
+    return;
+  }
+  int32 num_sequences = GetNumNvalues(eg.io, false);
+  if (buckets_.PaddedSize(num_sequences) != num_sequences) {
+    NnetExample padded_eg(eg);
+    // The padding sequences must not enter the component stats (which the
+    // self-repair of nonlinearities is based on), so padded minibatches do
+    // not store them.
+    bool padded = PadMinibatch(num_sequences, &padded_eg);
+    TrainMinibatch(padded_eg, num_sequences, !padded);
+  } else {
+    TrainMinibatch(eg, num_sequences, true);
+  }
+}
+
+void NnetTrainer::TrainMinibatch(const NnetExample &eg, int32 num_sequences,
+                                 bool store_component_stats) {
+  std::shared_ptr<const NnetComputation> computation =
+      GetComputation(eg, store_component_stats);
 
   if (config_.backstitch_training_scale > 0.0 &&
       num_minibatches_processed_ % config_.backstitch_training_interval ==
@@ -71,14 +104,16 @@ void NnetTrainer::Train(const NnetExample &eg) {
     bool is_backstitch_step1 = true;
     srand(srand_seed_ + num_minibatches_processed_);
     ResetGenerators(nnet_);
-    TrainInternalBackstitch(eg, *computation, is_backstitch_step1);
+    TrainInternalBackstitch(eg, *computation, num_sequences,
+                            is_backstitch_step1);
     FreezeNaturalGradient(false, delta_nnet_); // un-freeze natural gradient
     is_backstitch_step1 = false;
     srand(srand_seed_ + num_minibatches_processed_);
     ResetGenerators(nnet_);
-    TrainInternalBackstitch(eg, *computation, is_backstitch_step1);
+    TrainInternalBackstitch(eg, *computation, num_sequences,
+                            is_backstitch_step1);
   } else { // conventional training
-    TrainInternal(eg, *computation);
+    TrainInternal(eg, *computation, num_sequences);
   }
   if (num_minibatches_processed_ == 0) {
     ConsolidateMemory(nnet_);
@@ -88,8 +123,55 @@ void NnetTrainer::Train(const NnetExample &eg) {
 
 }
 
+std::shared_ptr<const NnetComputation> NnetTrainer::GetComputation(
+    const NnetExample &eg, bool store_component_stats) {
+  bool need_model_derivative = true;
+  ComputationRequest request;
+  GetComputationRequest(*nnet_, eg, need_model_derivative,
+                        store_component_stats &&
+                        config_.store_component_stats,
+                        &request);
+  if (!buckets_.Empty())
+    buckets_.Precompile(request, &compiler_);
+  return compiler_.Compile(request);
+}
+
+bool NnetTrainer::PadMinibatch(int32 num_sequences, NnetExample *eg) {
+  int32 padded_size = buckets_.PaddedSize(num_sequences);
+  // Check that all the inputs and outputs can be padded before padding any
+  // of them, so that 'eg' is not left half-padded.
+  std::vector<Index> indexes;
+  for (size_t i = 0; i < eg->io.size(); i++) {
+    if (!ChangeNumNValues(eg->io[i].indexes, padded_size, false, &indexes,
+                          NULL)) {
+      if (!warned_padding_) {
+        KALDI_WARN << "Could not pad a minibatch for --minibatch-buckets, "
+                   << "because its indexes do not have the usual structure; "
+                   << "not padding it (will warn only once).";
+        warned_padding_ = true;
+      }
+      return false;
+    }
+  }
+  for (size_t i = 0; i < eg->io.size(); i++) {
+    NnetIo &io = eg->io[i];
+    int32 node_index = nnet_->GetNodeIndex(io.name);
+    KALDI_ASSERT(node_index >= 0);
+    bool is_output = nnet_->IsOutputNode(node_index);
+    if (is_output &&
+        nnet_->GetNode(node_index).u.objective_type != kLinear)
+      KALDI_ERR << "--minibatch-buckets is only supported with the linear "
+                << "objective function.";
+    // The padding sequences of the outputs have zero weight.
+    bool ans = PadNnetIo(padded_size, is_output, &io);
+    KALDI_ASSERT(ans);
+  }
+  return true;
+}
+
 void NnetTrainer::TrainInternal(const NnetExample &eg,
-                                const NnetComputation &computation) {
+                                const NnetComputation &computation,
+                                int32 num_sequences) {
   // note: because we give the 1st arg (nnet_) as a pointer to the
   // constructor of 'computer', it will use that copy of the nnet to
   // store stats.
@@ -99,13 +181,15 @@ void NnetTrainer::TrainInternal(const NnetExample &eg,
   computer.AcceptInputs(*nnet_, eg.io);
   computer.Run();
 
-  this->ProcessOutputs(false, eg, &computer);
+  std::vector<MinibatchObjf> objfs;
+  this->ProcessOutputs(false, eg, &computer, &objfs);
+  UpdateObjfStats(objfs, num_minibatches_processed_);
   computer.Run();
 
   // If relevant, add in the part of the gradient that comes from L2
   // regularization.
   ApplyL2Regularization(*nnet_,
-                        GetNumNvalues(eg.io, false) * config_.l2_regularize_factor,
+                        num_sequences * config_.l2_regularize_factor,
                         delta_nnet_);
 
   // Update the parameters of nnet
@@ -130,6 +214,7 @@ void NnetTrainer::TrainInternal(const NnetExample &eg,
 
 void NnetTrainer::TrainInternalBackstitch(const NnetExample &eg,
                                           const NnetComputation &computation,
+                                          int32 num_sequences,
                                           bool is_backstitch_step1) {
   // note: because we give the 1st arg (nnet_) as a pointer to the
   // constructor of 'computer', it will use that copy of the nnet to
@@ -141,7 +226,9 @@ void NnetTrainer::TrainInternalBackstitch(const NnetExample &eg,
   computer.Run();
 
   bool is_backstitch_step2 = !is_backstitch_step1;
-  this->ProcessOutputs(is_backstitch_step2, eg, &computer);
+  std::vector<MinibatchObjf> objfs;
+  this->ProcessOutputs(is_backstitch_step2, eg, &computer, &objfs);
+  UpdateObjfStats(objfs, num_minibatches_processed_);
   computer.Run();
 
   BaseFloat max_change_scale, scale_adding;
@@ -160,7 +247,7 @@ void NnetTrainer::TrainInternalBackstitch(const NnetExample &eg,
     // passes of the backstitch, like we do here, but it probably minimizes
     // any harmful interactions with the max-change.
     ApplyL2Regularization(*nnet_,
-                          1.0 / scale_adding * GetNumNvalues(eg.io, false) *
+                          1.0 / scale_adding * num_sequences *
                           config_.l2_regularize_factor, delta_nnet_);
   }
 
@@ -188,9 +275,105 @@ void NnetTrainer::TrainInternalBackstitch(const NnetExample &eg,
   ScaleNnet(0.0, delta_nnet_);
 }
 
+// The class that runs the workers of data-parallel training in their threads.
+class NnetTrainer::WorkerClass: public MultiThreadable {
+ public:
+  explicit WorkerClass(NnetTrainer *trainer): trainer_(trainer) { }
+  void operator () () {
+    int32 num_egs = trainer_->pending_egs_.size();
+    for (int32 w = thread_id_; w < num_egs; w += num_threads_)
+      trainer_->TrainWorker(w);
+  }
+ private:
+  NnetTrainer *trainer_;
+};
+
+void NnetTrainer::TrainParallel() {
+  int32 num_egs = pending_egs_.size();
+  if (num_egs == 0)
+    return;
+  pending_computations_.resize(num_egs);
+  pending_objfs_.resize(num_egs);
+  int32 num_nvalues = 0;
+  for (int32 w = 0; w < num_egs; w++) {
+    int32 num_sequences = GetNumNvalues(pending_egs_[w].io, false);
+    num_nvalues += num_sequences;
+    bool padded = false;
+    if (buckets_.PaddedSize(num_sequences) != num_sequences)
+      padded = PadMinibatch(num_sequences, &(pending_egs_[w]));
+    // Only worker 0 uses the model nnet_ itself, so the component stats are
+    // only stored for its minibatches (and, as in Train(), not if they were
+    // padded).
+    bool store_component_stats = (w == 0 && !padded);
+    pending_computations_[w] = GetComputation(pending_egs_[w],
+                                              store_component_stats);
+  }
+  {
+    // The destructor of 'threader' waits for the threads.
+    MultiThreader<WorkerClass> threader(num_egs, WorkerClass(this));
+  }
+  for (int32 w = 0; w < num_egs; w++)
+    UpdateObjfStats(pending_objfs_[w], num_minibatches_processed_ + w);
+
+  parallel_nnets_->SumDeltas(num_egs);
+
+  // The rest is as in TrainInternal(), for the sum of the minibatches.
+  ApplyL2Regularization(*nnet_, num_nvalues * config_.l2_regularize_factor,
+                        delta_nnet_);
+  bool success = UpdateNnetWithMaxChange(
+      *delta_nnet_, config_.max_param_change,
+      1.0, 1.0 - config_.momentum, nnet_, &max_change_stats_);
+  ScaleBatchnormStats(config_.batchnorm_stats_scale, nnet_);
+  ConstrainOrthonormal(nnet_);
+  if (success)
+    ScaleNnet(config_.momentum, delta_nnet_);
+  else
+    ScaleNnet(0.0, delta_nnet_);
+
+  parallel_nnets_->CopyParams();
+  if (num_minibatches_processed_ == 0) {
+    ConsolidateMemory(nnet_);
+    ConsolidateMemory(delta_nnet_);
+  }
+  num_minibatches_processed_ += num_egs;
+  pending_egs_.clear();
+  pending_computations_.clear();
+  pending_objfs_.clear();
+}
+
+void NnetTrainer::TrainWorker(int32 worker) {
+  const NnetExample &eg = pending_egs_[worker];
+  Nnet *nnet = parallel_nnets_->GetNnet(worker);
+  NnetComputer computer(config_.compute_config,
+                        *(pending_computations_[worker]),
+                        nnet, parallel_nnets_->GetDeltaNnet(worker));
+  computer.AcceptInputs(*nnet, eg.io);
+  computer.Run();
+  this->ProcessOutputs(false, eg, &computer, &(pending_objfs_[worker]));
+  computer.Run();
+}
+
+void NnetTrainer::Flush() {
+  if (parallel_nnets_ != NULL)
+    TrainParallel();
+}
+
+void NnetTrainer::UpdateObjfStats(const std::vector<MinibatchObjf> &objfs,
+                                  int32 minibatch_counter) {
+  for (size_t i = 0; i < objfs.size(); i++) {
+    const MinibatchObjf &objf = objfs[i];
+    objf_info_[objf.output_name].UpdateStats(objf.output_name,
+                                             config_.print_interval,
+                                             minibatch_counter,
+                                             objf.tot_weight, objf.tot_objf,
+                                             objf.tot_aux_objf);
+  }
+}
+
 void NnetTrainer::ProcessOutputs(bool is_backstitch_step2,
                                  const NnetExample &eg,
-                                 NnetComputer *computer) {
+                                 NnetComputer *computer,
+                                 std::vector<MinibatchObjf> *objfs) {
   // normally the eg will have just one output named 'output', but
   // we don't assume this.
   // In backstitch training, the output-name with the "_backstitch" suffix is
@@ -209,10 +392,7 @@ void NnetTrainer::ProcessOutputs(bool is_backstitch_step2,
       ComputeObjectiveFunction(io.features, obj_type, io.name,
                                supply_deriv, computer,
                                &tot_weight, &tot_objf);
-      objf_info_[io.name + suffix].UpdateStats(io.name + suffix,
-                                      config_.print_interval,
-                                      num_minibatches_processed_,
-                                      tot_weight, tot_objf);
+      objfs->push_back(MinibatchObjf(io.name + suffix, tot_weight, tot_objf));
     }
   }
 }
@@ -236,6 +416,7 @@ bool NnetTrainer::PrintTotalStats() const {
     ans = ans || ok;
   }
   max_change_stats_.Print(*nnet_);
+  compiler_.PrintShapeStats();
   return ans;
 }
 
@@ -328,6 +509,10 @@ bool ObjectiveFunctionInfo::PrintTotalStats(const std::string &name) const {
 }
 
 NnetTrainer::~NnetTrainer() {
+  if (!pending_egs_.empty())
+    KALDI_WARN << "Not training on the last " << pending_egs_.size()
+               << " minibatches: Flush() was not called.";
+  delete parallel_nnets_;
   if (config_.write_cache != "") {
     Output ko(config_.write_cache, config_.binary_write_cache);
     compiler_.WriteCache(ko.Stream(), config_.binary_write_cache);
@@ -336,6 +521,161 @@ NnetTrainer::~NnetTrainer() {
   delete delta_nnet_;
 }
 
+void CheckDataParallelConfig(const NnetTrainerOptions &config) {
+  if (config.backstitch_training_scale != 0.0)
+    KALDI_ERR << "--num-threads > 1 is not supported with backstitch training.";
+#if HAVE_CUDA == 1
+  if (CuDevice::Instantiate().Enabled())
+    KALDI_ERR << "--num-threads > 1 is not supported when using a GPU.";
+#endif
+}
+
+class DataParallelNnets::ThreadClass: public MultiThreadable {
+ public:
+  ThreadClass(DataParallelNnets *nnets, bool sum_deltas,
+              int32 num_active_workers):
+      nnets_(nnets), sum_deltas_(sum_deltas),
+      num_active_workers_(num_active_workers) { }
+  void operator () () {
+    const std::vector<int32> &components =
+        nnets_->thread_components_[thread_id_];
+    for (size_t i = 0; i < components.size(); i++) {
+      int32 c = components[i];
+      if (sum_deltas_) {
+        Component *delta = nnets_->delta_nnets_[0]->GetComponent(c);
+        for (int32 w = 1; w < num_active_workers_; w++) {
+          Component *worker_delta = nnets_->delta_nnets_[w]->GetComponent(c);
+          delta->Add(1.0, *worker_delta);
+          worker_delta->Scale(0.0);
+        }
+      } else {
+        const Component *comp = nnets_->nnets_[0]->GetComponent(c);
+        for (int32 w = 1; w < nnets_->NumWorkers(); w++) {
+          Component *worker_comp = nnets_->nnets_[w]->GetComponent(c);
+          worker_comp->Scale(0.0);
+          worker_comp->Add(1.0, *comp);
+        }
+      }
+    }
+  }
+ private:
+  DataParallelNnets *nnets_;
+  bool sum_deltas_;
+  int32 num_active_workers_;
+};
+
+DataParallelNnets::DataParallelNnets(int32 num_workers, Nnet *nnet,
+                                     Nnet *delta_nnet) {
+  KALDI_ASSERT(num_workers > 0);
+  nnets_.push_back(nnet);
+  delta_nnets_.push_back(delta_nnet);
+  for (int32 w = 1; w < num_workers; w++) {
+    nnets_.push_back(nnet->Copy());
+    // So that the workers' dropout masks differ.
+    ResetGenerators(nnets_.back());
+    delta_nnets_.push_back(delta_nnet->Copy());
+  }
+  // Give each updatable component, largest first, to the thread with the
+  // fewest parameters so far.
+  std::vector<std::pair<int32, int32> > sizes;  // (num-params, component).
+  for (int32 c = 0; c < nnet->NumComponents(); c++) {
+    const Component *comp = nnet->GetComponent(c);
+    if (comp->Properties() & kUpdatableComponent)
+      sizes.push_back(std::pair<int32, int32>(
+          dynamic_cast<const UpdatableComponent*>(comp)->NumParameters(), c));
+  }
+  std::sort(sizes.begin(), sizes.end(),
+            std::greater<std::pair<int32, int32> >());
+  thread_components_.resize(num_workers);
+  std::vector<int64> thread_sizes(num_workers, 0);
+  for (size_t i = 0; i < sizes.size(); i++) {
+    int32 t = std::min_element(thread_sizes.begin(), thread_sizes.end()) -
+        thread_sizes.begin();
+    thread_components_[t].push_back(sizes[i].second);
+    thread_sizes[t] += sizes[i].first;
+  }
+}
+
+void DataParallelNnets::SumDeltas(int32 num_active_workers) {
+  KALDI_ASSERT(num_active_workers > 0 && num_active_workers <= NumWorkers());
+  if (num_active_workers == 1)
+    return;
+  MultiThreader<ThreadClass> threader(NumWorkers(),
+                                      ThreadClass(this, true,
+                                                  num_active_workers));
+}
+
+void DataParallelNnets::CopyParams() {
+  MultiThreader<ThreadClass> threader(NumWorkers(),
+                                      ThreadClass(this, false, NumWorkers()));
+}
+
+DataParallelNnets::~DataParallelNnets() {
+  for (int32 w = 1; w < NumWorkers(); w++) {
+    delete nnets_[w];
+    delete delta_nnets_[w];
+  }
+}
+
+MinibatchBuckets::MinibatchBuckets(const NnetTrainerOptions &config):
+    cache_capacity_(config.compiler_config.cache_capacity) {
+  if (!config.minibatch_buckets.empty()) {
+    if (!SplitStringToIntegers(config.minibatch_buckets, ",", false,
+                               &sizes_) || sizes_.empty())
+      KALDI_ERR << "Invalid --minibatch-buckets option: "
+                << config.minibatch_buckets;
+    SortAndUniq(&sizes_);
+    if (sizes_[0] <= 0)
+      KALDI_ERR << "Invalid --minibatch-buckets option: "
+                << config.minibatch_buckets;
+  }
+}
+
+int32 MinibatchBuckets::PaddedSize(int32 num_sequences) const {
+  std::vector<int32>::const_iterator iter =
+      std::lower_bound(sizes_.begin(), sizes_.end(), num_sequences);
+  return (iter == sizes_.end() ? num_sequences : *iter);
+}
+
+bool MinibatchBuckets::GetBucketRequests(
+    const ComputationRequest &request,
+    std::vector<ComputationRequest> *requests) const {
+  requests->resize(sizes_.size());
+  for (size_t i = 0; i < sizes_.size(); i++)
+    if (!ChangeNumNValues(request, sizes_[i], &((*requests)[i])))
+      return false;
+  return true;
+}
+
+void MinibatchBuckets::Precompile(const ComputationRequest &request,
+                                  CachingOptimizingCompiler *compiler) {
+  // The structure is identified by the request with a single sequence.  (The
+  // requests are expanded from 'request' itself, not from that, because the
+  // layout of the sequences can't be worked out from a single one.)
+  ComputationRequest structure;
+  if (!ChangeNumNValues(request, 1, &structure))
+    return;
+  size_t hash = ComputationRequestHasher()(&structure);
+  if (structures_.count(hash) != 0)
+    return;
+  std::vector<ComputationRequest> requests;
+  if (!GetBucketRequests(request, &requests))
+    return;
+  structures_.insert(hash);
+  Timer timer;
+  for (size_t i = 0; i < requests.size(); i++)
+    compiler->Compile(requests[i]);
+  KALDI_LOG << "Compiled the computations for " << sizes_.size()
+            << " minibatch sizes for a new minibatch structure in "
+            << timer.Elapsed() << " seconds.";
+  if (structures_.size() * sizes_.size() >
+      static_cast<size_t>(cache_capacity_))
+    KALDI_WARN << "There are " << structures_.size() << " minibatch "
+               << "structures and " << sizes_.size() << " bucket sizes, "
+               << "more than --compiler.cache-capacity=" << cache_capacity_
+               << " computations; computations will be recompiled.";
+}
+
 void ComputeObjectiveFunction(const GeneralMatrix &supervision,
                               ObjectiveType objective_type,
                               const std::string &output_name,
@@ -45,6 +45,8 @@ struct NnetTrainerOptions {
   std::string write_cache;
   bool binary_write_cache;
   BaseFloat max_param_change;
+  int32 num_threads;
+  std::string minibatch_buckets;
   NnetOptimizeOptions optimize_config;
   NnetComputeOptions compute_config;
   CachingOptimizingCompilerOptions compiler_config;
@@ -59,7 +61,8 @@ struct NnetTrainerOptions {
       backstitch_training_interval(1),
       batchnorm_stats_scale(0.8),
       binary_write_cache(true),
-      max_param_change(2.0) { }
+      max_param_change(2.0),
+      num_threads(1) { }
   void Register(OptionsItf *opts) {
     opts->Register("store-component-stats", &store_component_stats,
                    "If true, store activations and derivatives for nonlinear "
@@ -105,6 +108,24 @@ struct NnetTrainerOptions {
                    "the cached computation.");
     opts->Register("binary-write-cache", &binary_write_cache, "Write "
                    "computation cache in binary mode");
+    opts->Register("num-threads", &num_threads, "If >1, do synchronous "
+                   "data-parallel training with this many threads (CPU only): "
+                   "each thread processes its own minibatch, and the sum of "
+                   "their parameter changes is applied to the model, so this "
+                   "is like training with minibatches this many times larger "
+                   "(e.g. the max-change applies to the summed change).  Not "
+                   "supported with backstitch training.  You will probably "
+                   "want to limit the threads of the BLAS library, e.g. "
+                   "OPENBLAS_NUM_THREADS=1.");
+    opts->Register("minibatch-buckets", &minibatch_buckets, "Comma-separated "
+                   "list of minibatch sizes (numbers of sequences), e.g. "
+                   "'32,64,128'.  If set, each minibatch is padded to the "
+                   "smallest of these sizes that is not smaller than it, with "
+                   "sequences of zero weight, and the first time a minibatch "
+                   "of a new structure is seen, the computations for all "
+                   "these sizes are compiled; this avoids recompilation when "
+                   "there are many different minibatch sizes.  Not supported "
+                   "with batch-norm components or the quadratic objective.");
 
     // register the optimization options with the prefix "optimization".
     ParseOptions optimization_opts("optimization", opts);
@@ -164,10 +185,120 @@ struct ObjectiveFunctionInfo {
   bool PrintTotalStats(const std::string &output_name) const;
 };
 
+// The objective function of one output for one minibatch, as computed by the
+// trainers' ProcessOutputs() functions before it is added to the
+// ObjectiveFunctionInfo of the output.  In data-parallel training the
+// minibatches are processed at the same time, so their objective functions
+// are kept in this form until they can be added in the order of the
+// minibatches.
+struct MinibatchObjf {
+  std::string output_name;
+  BaseFloat tot_weight;
+  BaseFloat tot_objf;
+  BaseFloat tot_aux_objf;
+  MinibatchObjf(const std::string &output_name, BaseFloat tot_weight,
+                BaseFloat tot_objf, BaseFloat tot_aux_objf = 0.0):
+      output_name(output_name), tot_weight(tot_weight), tot_objf(tot_objf),
+      tot_aux_objf(tot_aux_objf) { }
+};
+
+/**
+   This class holds the copies of the model used in data-parallel training
+   (--num-threads > 1 in NnetTrainer and NnetChainTrainer).  Each worker (one
+   per thread) has a model and a parameter change ('delta_nnet'); worker 0 uses
+   those of the trainer itself, and the others use copies.  After each worker
+   has done the backprop on its own minibatch, SumDeltas() adds up their
+   parameter changes into that of worker 0, which is used to update the model
+   as in the single-threaded case; CopyParams() then copies the updated
+   parameters to the other workers' models.  Both are done in parallel, with
+   the updatable components divided among the threads so that each thread
+   handles about the same number of parameters.
+
+   Note: the natural-gradient state is in the components of 'delta_nnet', so
+   each worker has its own, and the natural gradient is applied to the
+   derivatives of each minibatch before they are summed.
+*/
+class DataParallelNnets {
+ public:
+  // 'nnet' and 'delta_nnet' are the model and parameter change of worker 0;
+  // they are not owned here.
+  DataParallelNnets(int32 num_workers, Nnet *nnet, Nnet *delta_nnet);
+
+  int32 NumWorkers() const { return nnets_.size(); }
+
+  Nnet *GetNnet(int32 worker) { return nnets_[worker]; }
+
+  Nnet *GetDeltaNnet(int32 worker) { return delta_nnets_[worker]; }
+
+  // Adds the parameter changes of workers 1 ... num_active_workers - 1 to
+  // that of worker 0, and sets them to zero.
+  void SumDeltas(int32 num_active_workers);
+
+  // Copies the updatable components of worker 0's model to the other
+  // workers' models.
+  void CopyParams();
+
+  ~DataParallelNnets();
+ private:
+  class ThreadClass;
+
+  std::vector<Nnet*> nnets_;
+  std::vector<Nnet*> delta_nnets_;
+  // The indexes of the updatable components that each thread handles in
+  // SumDeltas() and CopyParams().
+  std::vector<std::vector<int32> > thread_components_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(DataParallelNnets);
+};
 
-/** This class is for single-threaded training of neural nets using
-    standard objective functions such as cross-entropy (implemented with
-    logsoftmax nonlinearity and a linear objective function) and quadratic loss.
+// Dies if the options are not compatible with data-parallel training
+// (--num-threads > 1).
+void CheckDataParallelConfig(const NnetTrainerOptions &config);
+
+/**
+   This class implements --minibatch-buckets for NnetTrainer and
+   NnetChainTrainer.  It works out the size to which each minibatch is to be
+   padded, and the first time it sees a minibatch of a new structure (ignoring
+   its number of sequences) it compiles the computations for all the bucket
+   sizes, so that training does not have to stop later to compile them.
+*/
+class MinibatchBuckets {
+ public:
+  explicit MinibatchBuckets(const NnetTrainerOptions &config);
+
+  // True if --minibatch-buckets was not set.
+  bool Empty() const { return sizes_.empty(); }
+
+  // Returns the size to which a minibatch of 'num_sequences' sequences is to
+  // be padded: the smallest bucket size >= num_sequences, or num_sequences if
+  // there is none.
+  int32 PaddedSize(int32 num_sequences) const;
+
+  // Outputs the computation requests for minibatches of all the bucket
+  // sizes with the same structure as 'request', which must have more than
+  // one sequence.  Returns false if this is not possible (see
+  // ChangeNumNValues()).
+  bool GetBucketRequests(const ComputationRequest &request,
+                         std::vector<ComputationRequest> *requests) const;
+
+  // If 'request', the computation request for a padded minibatch, has a
+  // structure that was not seen before, compiles the computations for all
+  // the bucket sizes.  Minibatches of a single sequence are ignored.
+  void Precompile(const ComputationRequest &request,
+                  CachingOptimizingCompiler *compiler);
+ private:
+  std::vector<int32> sizes_;  // The bucket sizes, sorted.
+  int32 cache_capacity_;
+  // The hashes of the structures seen so far (of their computation requests
+  // with a single sequence).
+  unordered_set<size_t> structures_;
+};
+
+
+/** This class is for training of neural nets using standard objective
+    functions such as cross-entropy (implemented with logsoftmax nonlinearity
+    and a linear objective function) and quadratic loss.  It is single-threaded
+    unless --num-threads > 1; see DataParallelNnets.
 
     Something that we should do in the future is to make it possible to have
     two different threads, one for the compilation, and one for the computation.
@@ -182,27 +313,70 @@ class NnetTrainer {
   NnetTrainer(const NnetTrainerOptions &config,
               Nnet *nnet);
 
-  // train on one minibatch.
+  // train on one minibatch.  With --num-threads=N > 1, the minibatches are
+  // kept until there are N of them, and then trained on together.
   void Train(const NnetExample &eg);
 
+  // With --num-threads > 1, trains on the minibatches that Train() has kept,
+  // if any.  Call this after the last call to Train().
+  void Flush();
+
   // Prints out the final stats, and return true if there was a nonzero count.
   bool PrintTotalStats() const;
 
   ~NnetTrainer();
  private:
+  class WorkerClass;
+
   // The internal function for doing one step of conventional SGD training.
+  // 'num_sequences' is the number of sequences in 'eg' before any padding.
   void TrainInternal(const NnetExample &eg,
-                     const NnetComputation &computation);
+                     const NnetComputation &computation,
+                     int32 num_sequences);
 
   // The internal function for doing one step of backstitch training. Depending
   // on whether is_backstitch_step1 is true, It could be either the first
   // (backward) step, or the second (forward) step of backstitch.
   void TrainInternalBackstitch(const NnetExample &eg,
                                const NnetComputation &computation,
+                               int32 num_sequences,
                                bool is_backstitch_step1);
 
+  // Does one step of training on 'eg' (which may have been padded);
+  // 'num_sequences' is its number of sequences before padding.  If
+  // 'store_component_stats' is false, the component stats are not stored
+  // even if the config says to.
+  void TrainMinibatch(const NnetExample &eg, int32 num_sequences,
+                      bool store_component_stats);
+
+  // Pads 'eg', which has 'num_sequences' sequences, to the size of its bucket
+  // (see --minibatch-buckets), in place.  If this is not possible, it warns,
+  // leaves 'eg' unchanged and returns false.
+  bool PadMinibatch(int32 num_sequences, NnetExample *eg);
+
+  // Gets the computation for 'eg'.  'store_component_stats' overrides
+  // config_.store_component_stats if false.
+  std::shared_ptr<const NnetComputation> GetComputation(
+      const NnetExample &eg, bool store_component_stats);
+
+  // Computes the objective functions and supplies their derivatives to
+  // 'computer', and outputs the objective functions to 'objfs'.
   void ProcessOutputs(bool is_backstitch_step2, const NnetExample &eg,
-                      NnetComputer *computer);
+                      NnetComputer *computer,
+                      std::vector<MinibatchObjf> *objfs);
+
+  // Adds the objective functions of minibatch number 'minibatch_counter' to
+  // objf_info_.
+  void UpdateObjfStats(const std::vector<MinibatchObjf> &objfs,
+                       int32 minibatch_counter);
+
+  // Does one step of data-parallel training on the minibatches in
+  // pending_egs_, one per worker.
+  void TrainParallel();
+
+  // Does the forward and backward passes of worker 'worker' on its minibatch
+  // in pending_egs_.  Called from the worker's thread.
+  void TrainWorker(int32 worker);
 
   const NnetTrainerOptions config_;
   Nnet *nnet_;
@@ -225,6 +399,17 @@ class NnetTrainer {
   // consistent dropout masks.  It's set to a value derived from rand()
   // when the class is initialized.
   int32 srand_seed_;
+
+  MinibatchBuckets buckets_;
+  bool warned_padding_;  // True if we warned that a minibatch was not padded.
+
+  // Things used in data-parallel training (config_.num_threads > 1).
+  DataParallelNnets *parallel_nnets_;  // NULL if config_.num_threads == 1.
+  // The minibatches waiting to be trained on, and, during TrainParallel(),
+  // their computations and objective functions.
+  std::vector<NnetExample> pending_egs_;
+  std::vector<std::shared_ptr<const NnetComputation> > pending_computations_;
+  std::vector<std::vector<MinibatchObjf> > pending_objfs_;
 };
 
 /**
@@ -25,6 +25,7 @@
 #include "nnet3/nnet-normalize-component.h"
 #include "nnet3/nnet-general-component.h"
 #include "nnet3/nnet-convolutional-component.h"
+#include "nnet3/nnet-quantized-component.h"
 #include "nnet3/nnet-parse.h"
 #include "nnet3/nnet-computation-graph.h"
 #include "nnet3/nnet-diagnostics.h"
@@ -489,6 +490,40 @@ void ConvertRepeatedToBlockAffine(Nnet *nnet) {
   }
 }
 
+int32 QuantizeNnet(const std::string &name_pattern, Nnet *nnet) {
+  int32 num_quantized = 0;
+  for (int32 i = 0; i < nnet->NumComponents(); i++) {
+    if (!NameMatchesPattern(nnet->GetComponentName(i).c_str(),
+                            name_pattern.c_str()))
+      continue;
+    const Component *c = nnet->GetComponent(i);
+    std::string type = c->Type();
+    Component *new_c = NULL;
+    if (type == "AffineComponent" ||
+        type == "NaturalGradientAffineComponent") {
+      // N.B.: NaturalGradientAffineComponent is a subclass of
+      // AffineComponent.
+      const AffineComponent *ac = dynamic_cast<const AffineComponent*>(c);
+      KALDI_ASSERT(ac != NULL);
+      new_c = new QuantizedAffineComponent(*ac);
+    } else if (type == "LinearComponent") {
+      const LinearComponent *lc = dynamic_cast<const LinearComponent*>(c);
+      KALDI_ASSERT(lc != NULL);
+      new_c = new QuantizedAffineComponent(*lc);
+    } else if (type == "TdnnComponent") {
+      const TdnnComponent *tc = dynamic_cast<const TdnnComponent*>(c);
+      KALDI_ASSERT(tc != NULL);
+      new_c = new QuantizedTdnnComponent(*tc);
+    }
+    if (new_c != NULL) {
+      // following call deletes c.
+      nnet->SetComponent(i, new_c);
+      num_quantized++;
+    }
+  }
+  return num_quantized;
+}
+
 std::string NnetInfo(const Nnet &nnet) {
   std::ostringstream ostr;
   if (IsSimpleNnet(nnet)) {
@@ -164,6 +164,15 @@ void FreezeNaturalGradient(bool freeze, Nnet *nnet);
 /// NaturalGradientRepeatedAffineComponent to BlockAffineComponent in nnet.
 void ConvertRepeatedToBlockAffine(Nnet *nnet);
 
+/// Replaces each component of type AffineComponent,
+/// NaturalGradientAffineComponent, LinearComponent or TdnnComponent whose
+/// name matches 'name_pattern' (see NameMatchesPattern()) with an
+/// inference-only version with 8-bit weights (QuantizedAffineComponent or
+/// QuantizedTdnnComponent).  Returns the number of components replaced.
+/// This should be done after CollapseModel(), which only knows about the
+/// unquantized components.
+int32 QuantizeNnet(const std::string &name_pattern, Nnet *nnet);
+
 /// This function returns various info about the neural net.
 /// If the nnet satisfied IsSimpleNnet(nnet), the info includes "left-context=5\nright-context=3\n...".  The info includes
 /// the output of nnet.Info().
@@ -122,7 +122,8 @@ int main(int argc, char *argv[]) {
       // this compiler object allows caching of computations across
       // different utterances.
       CachingOptimizingCompiler compiler(am_nnet.GetNnet(),
-                                         decodable_opts.optimize_config);
+                                         decodable_opts.optimize_config,
+                                         decodable_opts.compiler_config);
 
       RandomAccessBaseFloatMatrixReader online_ivector_reader(
           online_ivector_rspecifier);
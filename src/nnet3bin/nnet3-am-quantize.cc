@@ -0,0 +1,96 @@
+// nnet3bin/nnet3-am-quantize.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "hmm/transition-model.h"
+#include "nnet3/am-nnet-simple.h"
+#include "nnet3/nnet-utils.h"
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    using namespace kaldi::nnet3;
+    typedef kaldi::int32 int32;
+
+    const char *usage =
+        "Prepare an nnet3 acoustic model for CPU decoding with 8-bit weights:\n"
+        "sets test mode in dropout and batch-norm components, collapses the\n"
+        "model (see CollapseModel()), and replaces the affine, linear and TDNN\n"
+        "components with quantized versions that do their matrix products\n"
+        "in 8-bit integer arithmetic.  The output model can be used by the\n"
+        "decoding programs (e.g. nnet3-latgen-faster or\n"
+        "online2-wav-nnet3-latgen-faster) in place of the original one, but\n"
+        "it cannot be trained.\n"
+        "\n"
+        "Usage:  nnet3-am-quantize [options] <nnet-in> <nnet-out>\n"
+        "e.g.:\n"
+        " nnet3-am-quantize final.mdl final_int8.mdl\n"
+        " nnet3-am-quantize --component-names='tdnn*' final.mdl final_int8.mdl\n";
+
+    bool binary_write = true;
+    std::string component_names = "*";
+
+    ParseOptions po(usage);
+    po.Register("binary", &binary_write, "Write output in binary mode");
+    po.Register("component-names", &component_names,
+                "Only quantize components whose names match this pattern, in "
+                "which '*' matches any sequence of characters (e.g. 'tdnn*').  "
+                "The output layer is often the most sensitive to quantization, "
+                "so it may be worth excluding it.");
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() != 2) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    std::string nnet_rxfilename = po.GetArg(1),
+        nnet_wxfilename = po.GetArg(2);
+
+    TransitionModel trans_model;
+    AmNnetSimple am_nnet;
+    {
+      bool binary;
+      Input ki(nnet_rxfilename, &binary);
+      trans_model.Read(ki.Stream(), binary);
+      am_nnet.Read(ki.Stream(), binary);
+    }
+
+    SetBatchnormTestMode(true, &am_nnet.GetNnet());
+    SetDropoutTestMode(true, &am_nnet.GetNnet());
+    CollapseModel(CollapseModelConfig(), &am_nnet.GetNnet());
+
+    int32 num_quantized = QuantizeNnet(component_names, &am_nnet.GetNnet());
+    if (num_quantized == 0)
+      KALDI_WARN << "No components were quantized (check --component-names).";
+
+    Output ko(nnet_wxfilename, binary_write);
+    trans_model.Write(ko.Stream(), binary_write);
+    am_nnet.Write(ko.Stream(), binary_write);
+    KALDI_LOG << "Quantized " << num_quantized << " components of "
+              << nnet_rxfilename << " and wrote the model to "
+              << nnet_wxfilename;
+    return 0;
+  } catch(const std::exception &e) {
+    std::cerr << e.what() << '\n';
+    return -1;
+  }
+}
@@ -106,6 +106,12 @@ int main(int argc, char *argv[]) {
       SetDropoutTestMode(true, &(am_nnet.GetNnet()));
       CollapseModel(CollapseModelConfig(), &(am_nnet.GetNnet()));
     }
+    // The compiler is shared by all the decoding threads, so that
+    // computations (and the file given by --computation-cache, if any) are
+    // shared between utterances.
+    CachingOptimizingCompiler compiler(am_nnet.GetNnet(),
+                                       decodable_opts.optimize_config,
+                                       decodable_opts.compiler_config);
 
     bool determinize = config.determinize_lattice;
     CompactLatticeWriter compact_lattice_writer;
@@ -177,7 +183,7 @@ int main(int argc, char *argv[]) {
               DecodableAmNnetSimpleParallel(
                   decodable_opts, trans_model, am_nnet,
                   features, ivector, online_ivectors,
-                  online_ivector_period);
+                  online_ivector_period, &compiler);
 
           DecodeUtteranceLatticeFasterClass *task =
               new DecodeUtteranceLatticeFasterClass(
@@ -241,7 +247,7 @@ int main(int argc, char *argv[]) {
             DecodableAmNnetSimpleParallel(
                 decodable_opts, trans_model, am_nnet,
                 features, ivector, online_ivectors,
-                online_ivector_period);
+                online_ivector_period, &compiler);
 
         DecodeUtteranceLatticeFasterClass *task =
             new DecodeUtteranceLatticeFasterClass(
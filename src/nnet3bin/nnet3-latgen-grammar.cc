@@ -132,12 +132,13 @@ int main(int argc, char *argv[]) {
     // this compiler object allows caching of computations across
     // different utterances.
     CachingOptimizingCompiler compiler(am_nnet.GetNnet(),
-                                       decodable_opts.optimize_config);
+                                       decodable_opts.optimize_config,
+                                       decodable_opts.compiler_config);
 
     SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
 
     fst::ConstGrammarFst fst;
-    ReadKaldiObject(grammar_fst_rxfilename, &fst);
+    fst.Read(grammar_fst_rxfilename);
     timer.Reset();
 
     {
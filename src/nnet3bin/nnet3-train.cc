@@ -20,6 +20,7 @@
 #include "base/kaldi-common.h"
 #include "util/common-utils.h"
 #include "nnet3/nnet-training.h"
+#include "nnet3/nnet-example-loader.h"
 #include "cudamatrix/cu-allocator.h"
 
 int main(int argc, char *argv[]) {
@@ -32,19 +33,28 @@ int main(int argc, char *argv[]) {
     const char *usage =
         "Train nnet3 neural network parameters with backprop and stochastic\n"
         "gradient descent.  Minibatches are to be created by nnet3-merge-egs in\n"
-        "the input pipeline.  This training program is single-threaded (best to\n"
-        "use it with a GPU); see nnet3-train-parallel for multi-threaded training\n"
-        "that is better suited to CPUs.\n"
+        "the input pipeline, or by this program with --merge-egs=true.  If\n"
+        "several example archives are given, they are read from in turn.  This\n"
+        "training program is single-threaded (best to use it with a GPU) unless\n"
+        "--num-threads > 1, which does synchronous data-parallel training on\n"
+        "the CPU.\n"
         "\n"
-        "Usage:  nnet3-train [options] <raw-model-in> <training-examples-in> <raw-model-out>\n"
+        "Usage:  nnet3-train [options] <raw-model-in> <training-examples-in1> "
+        "[<training-examples-in2> ...] <raw-model-out>\n"
         "\n"
         "e.g.:\n"
-        "nnet3-train 1.raw 'ark:nnet3-merge-egs 1.egs ark:-|' 2.raw\n";
+        "nnet3-train 1.raw 'ark:nnet3-merge-egs 1.egs ark:-|' 2.raw\n"
+        "nnet3-train --egs-prefetch=4 --egs-shuffle-buffer-size=5000 \\\n"
+        "  --merge-egs=true --merge.minibatch-size=256 1.raw ark:egs.1.ark \\\n"
+        "  ark:egs.2.ark 2.raw\n"
+        "OPENBLAS_NUM_THREADS=1 nnet3-train --use-gpu=no --num-threads=8 \\\n"
+        "  1.raw 'ark:nnet3-merge-egs 1.egs ark:-|' 2.raw\n";
 
     int32 srand_seed = 0;
     bool binary_write = true;
     std::string use_gpu = "yes";
     NnetTrainerOptions train_config;
+    ExampleLoaderOptions loader_opts;
 
     ParseOptions po(usage);
     po.Register("srand", &srand_seed, "Seed for random number generator ");
@@ -53,13 +63,14 @@ int main(int argc, char *argv[]) {
                 "yes|no|optional|wait, only has effect if compiled with CUDA");
 
     train_config.Register(&po);
+    loader_opts.Register(&po);
     RegisterCuAllocatorOptions(&po);
 
     po.Read(argc, argv);
 
     srand(srand_seed);
 
-    if (po.NumArgs() != 3) {
+    if (po.NumArgs() < 3) {
       po.PrintUsage();
       exit(1);
     }
@@ -69,18 +80,23 @@ int main(int argc, char *argv[]) {
 #endif
 
     std::string nnet_rxfilename = po.GetArg(1),
-        examples_rspecifier = po.GetArg(2),
-        nnet_wxfilename = po.GetArg(3);
+        nnet_wxfilename = po.GetArg(po.NumArgs());
+    std::vector<std::string> examples_rspecifiers;
+    for (int32 i = 2; i < po.NumArgs(); i++)
+      examples_rspecifiers.push_back(po.GetArg(i));
 
     Nnet nnet;
     ReadKaldiObject(nnet_rxfilename, &nnet);
 
     NnetTrainer trainer(train_config, &nnet);
 
-    SequentialNnetExampleReader example_reader(examples_rspecifier);
+    {
+      NnetExampleLoader example_reader(loader_opts, examples_rspecifiers);
 
-    for (; !example_reader.Done(); example_reader.Next())
-      trainer.Train(example_reader.Value());
+      for (; !example_reader.Done(); example_reader.Next())
+        trainer.Train(example_reader.Value());
+      trainer.Flush();
+    }
 
     bool ok = trainer.PrintTotalStats();
 
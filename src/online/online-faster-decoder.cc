@@ -32,7 +32,7 @@ void OnlineFasterDecoder::ResetDecoder(bool full) {
   StateId start_state = fst_.Start();
   KALDI_ASSERT(start_state != fst::kNoStateId);
   Arc dummy_arc(0, 0, Weight::One(), start_state);
-  Token *dummy_token = new Token(dummy_arc, NULL);
+  Token *dummy_token = NewToken(dummy_arc, NULL);
   toks_.Insert(start_state, dummy_token);
   prev_immortal_tok_ = immortal_tok_ = dummy_token;
   utt_frames_ = 0;
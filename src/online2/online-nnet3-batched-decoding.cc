@@ -0,0 +1,195 @@
+// online2/online-nnet3-batched-decoding.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "online2/online-nnet3-batched-decoding.h"
+#include "fstext/fstext-utils.h"
+#include "lat/lattice-functions.h"
+
+namespace kaldi {
+
+static nnet3::NnetBatchOnlineComputer *NewBatchComputer(
+    const BatchedThreadedNnet3CpuOnlinePipelineConfig &config,
+    const nnet3::DecodableNnetSimpleLoopedInfo &decodable_info,
+    const nnet3::Nnet &nnet,
+    const VectorBase<BaseFloat> &priors) {
+  const nnet3::NnetSimpleLoopedComputationOptions &opts = config.compute_opts;
+  nnet3::NnetBatchComputerOptions batch_opts;
+  batch_opts.frame_subsampling_factor = opts.frame_subsampling_factor;
+  batch_opts.frames_per_chunk = decodable_info.frames_per_chunk;
+  batch_opts.acoustic_scale = opts.acoustic_scale;
+  batch_opts.optimize_config = opts.optimize_config;
+  batch_opts.compute_config = opts.compute_config;
+  batch_opts.minibatch_size = config.nnet_batch_size;
+  batch_opts.edge_minibatch_size = config.nnet_batch_size;
+  return new nnet3::NnetBatchOnlineComputer(batch_opts, nnet, priors);
+}
+
+BatchedThreadedNnet3CpuOnlinePipeline::BatchedThreadedNnet3CpuOnlinePipeline(
+    const BatchedThreadedNnet3CpuOnlinePipelineConfig &config,
+    const fst::Fst<fst::StdArc> &decode_fst,
+    nnet3::AmNnetSimple *am_nnet,
+    const TransitionModel &trans_model):
+    config_(config),
+    trans_model_(trans_model),
+    feature_info_(config.feature_opts),
+    batch_nnet_(config.nnet_batch_size > 0 ?
+                new nnet3::Nnet(am_nnet->GetNnet()) : NULL),
+    decodable_info_(config.compute_opts, am_nnet),
+    batch_computer_(batch_nnet_ == NULL ? NULL :
+                    NewBatchComputer(config, decodable_info_, *batch_nnet_,
+                                     am_nnet->Priors())),
+    graph_(decode_fst),
+    decoder_(config.decoder_opts, graph_, config.num_channels),
+    word_syms_(NULL),
+    channels_(config.num_channels) {
+  for (int32 c = config.num_channels - 1; c >= 0; c--)
+    free_channels_.push_back(c);
+}
+
+BatchedThreadedNnet3CpuOnlinePipeline::
+~BatchedThreadedNnet3CpuOnlinePipeline() {
+  for (size_t c = 0; c < channels_.size(); c++) {
+    delete channels_[c].decodable;
+    delete channels_[c].features;
+  }
+  delete batch_computer_;
+  delete batch_nnet_;
+}
+
+int32 BatchedThreadedNnet3CpuOnlinePipeline::GetChannel(
+    CorrelationID corr_id) const {
+  std::unordered_map<CorrelationID, int32>::const_iterator iter =
+      corr_id2channel_.find(corr_id);
+  if (iter == corr_id2channel_.end())
+    KALDI_ERR << "Unknown correlation id " << corr_id
+              << "; you must call TryInitCorrID() first.";
+  return iter->second;
+}
+
+bool BatchedThreadedNnet3CpuOnlinePipeline::TryInitCorrID(
+    CorrelationID corr_id, int wait_for) {
+  if (corr_id2channel_.count(corr_id) != 0)
+    KALDI_ERR << "Correlation id " << corr_id << " is already in use.";
+  if (free_channels_.empty())
+    return false;
+  int32 c = free_channels_.back();
+  free_channels_.pop_back();
+  corr_id2channel_[corr_id] = c;
+
+  ChannelState &channel = channels_[c];
+  channel.features = new OnlineNnet2FeaturePipeline(feature_info_);
+  channel.decodable = new nnet3::DecodableAmNnetLoopedOnline(
+      trans_model_, decodable_info_, channel.features->InputFeature(),
+      channel.features->IvectorFeature(), batch_computer_);
+  channel.callback = std::function<void(CompactLattice &)>();
+  channel.partial_hypothesis.clear();
+  decoder_.InitDecoding(std::vector<BatchedFasterDecoder::ChannelId>(1, c));
+  return true;
+}
+
+void BatchedThreadedNnet3CpuOnlinePipeline::SetLatticeCallback(
+    CorrelationID corr_id,
+    const std::function<void(CompactLattice &)> &callback) {
+  channels_[GetChannel(corr_id)].callback = callback;
+}
+
+void BatchedThreadedNnet3CpuOnlinePipeline::DecodeBatch(
+    const std::vector<CorrelationID> &corr_ids,
+    const std::vector<SubVector<BaseFloat> > &wave_samples,
+    const std::vector<bool> &is_first_chunk,
+    const std::vector<bool> &is_last_chunk,
+    std::vector<const std::string*> *partial_hypotheses) {
+  KALDI_ASSERT(corr_ids.size() == wave_samples.size() &&
+               corr_ids.size() == is_first_chunk.size() &&
+               corr_ids.size() == is_last_chunk.size());
+  BaseFloat samp_freq = GetModelFrequency();
+  std::vector<BatchedFasterDecoder::ChannelId> channels(corr_ids.size());
+  std::vector<DecodableInterface*> decodables(corr_ids.size());
+  for (size_t i = 0; i < corr_ids.size(); i++) {
+    int32 c = GetChannel(corr_ids[i]);
+    ChannelState &channel = channels_[c];
+    channel.features->AcceptWaveform(samp_freq, wave_samples[i]);
+    if (is_last_chunk[i])
+      channel.features->InputFinished();
+    channels[i] = c;
+    decodables[i] = channel.decodable;
+  }
+
+  if (batch_computer_ != NULL) {
+    // Queue the new chunks of all the channels at once, so they are computed
+    // together in minibatches while we go on; the decodables wait for them
+    // when the search gets to them.
+    std::vector<nnet3::NnetInferenceTask*> tasks;
+    for (size_t i = 0; i < channels.size(); i++)
+      channels_[channels[i]].decodable->PrepareChunkTasks(&tasks);
+    batch_computer_->SubmitTasks(tasks);
+  }
+
+  // This is where the work is done: the features and (unless batching) the
+  // neural net are computed on demand by the decodables, from the decoder's
+  // threads.
+  decoder_.AdvanceDecoding(channels, decodables);
+
+  if (partial_hypotheses != NULL) {
+    partial_hypotheses->resize(corr_ids.size());
+    for (size_t i = 0; i < corr_ids.size(); i++) {
+      ChannelState &channel = channels_[channels[i]];
+      channel.partial_hypothesis.clear();
+      Lattice best_path;
+      std::vector<int32> words;
+      if (word_syms_ != NULL &&
+          decoder_.GetBestPath(channels[i], false, &best_path) &&
+          fst::GetLinearSymbolSequence<LatticeArc, int32>(best_path, NULL,
+                                                          &words, NULL)) {
+        for (size_t j = 0; j < words.size(); j++) {
+          if (j > 0) channel.partial_hypothesis += ' ';
+          channel.partial_hypothesis += word_syms_->Find(words[j]);
+        }
+      }
+      (*partial_hypotheses)[i] = &(channel.partial_hypothesis);
+    }
+  }
+
+  for (size_t i = 0; i < corr_ids.size(); i++)
+    if (is_last_chunk[i])
+      FinalizeDecoding(corr_ids[i], channels[i]);
+}
+
+void BatchedThreadedNnet3CpuOnlinePipeline::FinalizeDecoding(
+    CorrelationID corr_id, int32 c) {
+  ChannelState &channel = channels_[c];
+  if (channel.callback) {
+    Lattice best_path;
+    CompactLattice clat;
+    if (decoder_.GetBestPath(c, true, &best_path))
+      ConvertLattice(best_path, &clat);
+    else
+      KALDI_WARN << "Decoding failed for correlation id " << corr_id;
+    channel.callback(clat);
+  }
+  delete channel.decodable;
+  delete channel.features;
+  channel.decodable = NULL;
+  channel.features = NULL;
+  channel.callback = std::function<void(CompactLattice &)>();
+  corr_id2channel_.erase(corr_id);
+  free_channels_.push_back(c);
+}
+
+}  // namespace kaldi
@@ -0,0 +1,167 @@
+// online2/online-nnet3-batched-decoding.h
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_ONLINE2_ONLINE_NNET3_BATCHED_DECODING_H_
+#define KALDI_ONLINE2_ONLINE_NNET3_BATCHED_DECODING_H_
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "decoder/batched-faster-decoder.h"
+#include "hmm/transition-model.h"
+#include "nnet3/decodable-online-looped.h"
+#include "nnet3/nnet-batch-compute.h"
+#include "online2/online-nnet2-feature-pipeline.h"
+
+namespace kaldi {
+/// @addtogroup  onlinedecoding OnlineDecoding
+/// @{
+
+struct BatchedThreadedNnet3CpuOnlinePipelineConfig {
+  int32 num_channels;
+  int32 nnet_batch_size;
+
+  OnlineNnet2FeaturePipelineConfig feature_opts;
+  BatchedFasterDecoderConfig decoder_opts;
+  nnet3::NnetSimpleLoopedComputationOptions compute_opts;
+
+  BatchedThreadedNnet3CpuOnlinePipelineConfig(): num_channels(64),
+                                                 nnet_batch_size(0) { }
+  void Register(OptionsItf *po) {
+    po->Register("num-channels", &num_channels,
+                 "The number of parallel audio channels, i.e. the maximum "
+                 "number of utterances being decoded at any time.");
+    po->Register("nnet-batch-size", &nnet_batch_size,
+                 "If >0, the new chunks of all the channels in a batch are "
+                 "queued together before the search and the neural net is "
+                 "evaluated on them in minibatches of up to this many chunks "
+                 "(only exact for non-recurrent models such as TDNN-F).");
+    feature_opts.Register(po);
+    decoder_opts.Register(po);
+    compute_opts.Register(po);
+  }
+};
+
+/**
+   This is a CPU counterpart of
+   cuda_decoder::BatchedThreadedNnet3CudaOnlinePipeline, with the same
+   interface: it decodes up to config.num_channels streams of audio, each
+   identified by a correlation id, and receives their audio in chunks through
+   DecodeBatch().  Feature extraction and the neural net are run per channel
+   (or, if config.nnet_batch_size > 0, the chunks that are ready in all the
+   channels are queued at once on an nnet3::NnetBatchOnlineComputer, which
+   evaluates them in minibatches), and the search is done for all the
+   channels of a batch by one BatchedFasterDecoder, on
+   config.decoder_opts.num_threads threads.
+
+   The differences from the CUDA pipeline are that the search keeps only the
+   best path, so the "lattice" given to the callback is the linear lattice of
+   the best path; and that callbacks are called from within DecodeBatch(), so
+   the channel of an utterance is free again as soon as its last chunk has been
+   decoded.
+*/
+class BatchedThreadedNnet3CpuOnlinePipeline {
+ public:
+  typedef uint64 CorrelationID;
+
+  /// 'am_nnet' is not const because DecodableNnetSimpleLoopedInfo may modify
+  /// it (see its constructor).  The arguments must outlive this object.
+  BatchedThreadedNnet3CpuOnlinePipeline(
+      const BatchedThreadedNnet3CpuOnlinePipelineConfig &config,
+      const fst::Fst<fst::StdArc> &decode_fst,
+      nnet3::AmNnetSimple *am_nnet,
+      const TransitionModel &trans_model);
+
+  /// Called when a new utterance with correlation id 'corr_id' starts.
+  /// Returns false if no channel is available.  'wait_for' is only there for
+  /// compatibility with the CUDA pipeline: channels are freed within
+  /// DecodeBatch(), so there is nothing to wait for.
+  bool TryInitCorrID(CorrelationID corr_id, int wait_for = 0);
+
+  /// Sets the function to call with the best path of utterance 'corr_id' when
+  /// its last chunk has been decoded.
+  void SetLatticeCallback(
+      CorrelationID corr_id,
+      const std::function<void(CompactLattice &)> &callback);
+
+  /// Decodes one chunk of audio for each of 'corr_ids'.  For the utterances
+  /// whose last chunk this is, the callback is called and the channel is
+  /// freed.  If 'partial_hypotheses' is not NULL (and SetSymbolTable() was
+  /// called), it is set to the current best word sequence of each utterance;
+  /// the pointers are only valid until the next call to DecodeBatch().
+  void DecodeBatch(const std::vector<CorrelationID> &corr_ids,
+                   const std::vector<SubVector<BaseFloat> > &wave_samples,
+                   const std::vector<bool> &is_first_chunk,
+                   const std::vector<bool> &is_last_chunk,
+                   std::vector<const std::string*> *partial_hypotheses = NULL);
+
+  BaseFloat GetModelFrequency() { return feature_info_.GetSamplingFrequency(); }
+
+  /// Used for partial hypotheses.
+  void SetSymbolTable(const fst::SymbolTable &word_syms) {
+    word_syms_ = &word_syms;
+  }
+
+  /// Callbacks are called from within DecodeBatch(), so this does nothing; it
+  /// is there for compatibility with the CUDA pipeline.
+  void WaitForLatticeCallbacks() { }
+
+  ~BatchedThreadedNnet3CpuOnlinePipeline();
+
+ private:
+  // The objects used by one channel while it is decoding an utterance.
+  struct ChannelState {
+    OnlineNnet2FeaturePipeline *features;
+    nnet3::DecodableAmNnetLoopedOnline *decodable;
+    std::function<void(CompactLattice &)> callback;
+    std::string partial_hypothesis;
+    ChannelState(): features(NULL), decodable(NULL) { }
+  };
+
+  // Returns the channel used by 'corr_id'; it is an error if there is none.
+  int32 GetChannel(CorrelationID corr_id) const;
+
+  // Calls the callback of the utterance on 'channel' and frees the channel.
+  void FinalizeDecoding(CorrelationID corr_id, int32 channel);
+
+  BatchedThreadedNnet3CpuOnlinePipelineConfig config_;
+  const TransitionModel &trans_model_;
+  OnlineNnet2FeaturePipelineInfo feature_info_;
+  // Copy of the nnet for batch_computer_, made before decodable_info_ modifies
+  // the original; NULL if not batching.
+  nnet3::Nnet *batch_nnet_;
+  nnet3::DecodableNnetSimpleLoopedInfo decodable_info_;
+  nnet3::NnetBatchOnlineComputer *batch_computer_;  // NULL if not batching.
+  fst::CsrFst graph_;
+  BatchedFasterDecoder decoder_;
+  const fst::SymbolTable *word_syms_;
+
+  std::vector<ChannelState> channels_;
+  std::vector<int32> free_channels_;
+  std::unordered_map<CorrelationID, int32> corr_id2channel_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(BatchedThreadedNnet3CpuOnlinePipeline);
+};
+
+/// @} End of "addtogroup onlinedecoding"
+}  // namespace kaldi
+
+#endif  // KALDI_ONLINE2_ONLINE_NNET3_BATCHED_DECODING_H_
@@ -53,12 +53,16 @@ class SingleUtteranceNnet3DecoderTpl {
  public:
 
   // Constructor. The pointer 'features' is not being given to this class to own
-  // and deallocate, it is owned externally.
+  // and deallocate, it is owned externally.  If 'batch_computer' is non-NULL
+  // (it is not owned either), the neural net is evaluated through it, batched
+  // with the other decoders that share it; see class
+  // nnet3::NnetBatchOnlineComputer.
   SingleUtteranceNnet3DecoderTpl(const LatticeFasterDecoderConfig &decoder_opts,
                                  const TransitionModel &trans_model,
                                  const nnet3::DecodableNnetSimpleLoopedInfo &info,
                                  const FST &fst,
-                                 OnlineNnet2FeaturePipeline *features);
+                                 OnlineNnet2FeaturePipeline *features,
+                                 nnet3::NnetBatchOnlineComputer *batch_computer = NULL);
 
   /// Initializes the decoding and sets the frame offset of the underlying
   /// decodable object. This method is called by the constructor. You can also
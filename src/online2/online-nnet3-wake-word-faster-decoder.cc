@@ -31,7 +31,7 @@ void OnlineWakeWordFasterDecoder::InitDecoding() {
   StateId start_state = fst_.Start();
   KALDI_ASSERT(start_state != fst::kNoStateId);
   Arc dummy_arc(0, 0, Weight::One(), start_state);
-  Token *dummy_token = new Token(dummy_arc, NULL);
+  Token *dummy_token = NewToken(dummy_arc, NULL);
   toks_.Insert(start_state, dummy_token);
   ProcessNonemitting(std::numeric_limits<float>::max());
   num_frames_decoded_ = 0;
@@ -0,0 +1,127 @@
+// online2/online-word-aligner.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+
+#include "online2/online-word-aligner.h"
+
+namespace kaldi {
+
+OnlineWordAligner::OnlineWordAligner(const TransitionModel &tmodel,
+                                     const WordBoundaryInfo &info,
+                                     int32 max_traceback_frames):
+    tmodel_(tmodel), info_(info),
+    max_traceback_frames_(max_traceback_frames),
+    aligner_(tmodel, info), last_immortal_tok_(NULL),
+    last_immortal_frame_(-1) {
+  KALDI_ASSERT(max_traceback_frames > 0);
+}
+
+void OnlineWordAligner::Reset() {
+  aligner_ = IncrementalWordAligner(tmodel_, info_);
+  last_immortal_tok_ = NULL;
+  last_immortal_frame_ = -1;
+  committed_words_.clear();
+}
+
+template <typename FST>
+void OnlineWordAligner::TraceBack(
+    const LatticeFasterOnlineDecoderTpl<FST> &decoder,
+    typename LatticeFasterOnlineDecoderTpl<FST>::BestPathIterator iter,
+    std::vector<LatticeArc> *arcs) const {
+  arcs->clear();
+  // All the paths that the decoder has now pass through last_immortal_tok_, so
+  // we will reach it (unless it is NULL, in which case we go back to the
+  // start).
+  while (!iter.Done() && iter.tok != last_immortal_tok_) {
+    LatticeArc arc;
+    iter = decoder.TraceBackBestPath(iter, &arc);
+    arcs->push_back(arc);
+  }
+  std::reverse(arcs->begin(), arcs->end());
+}
+
+template <typename FST>
+void OnlineWordAligner::Update(
+    const LatticeFasterOnlineDecoderTpl<FST> &decoder) {
+  if (decoder.NumFramesDecoded() == 0)
+    return;
+  // All the paths go through last_immortal_tok_, so there is no need to look
+  // back past it: ImmortalPoint() would find it at the latest.  This keeps the
+  // cost of Update() proportional to the frames decoded since the last call.
+  int32 num_frames = decoder.NumFramesDecoded(),
+      max_frames = std::min(max_traceback_frames_,
+                            num_frames - last_immortal_frame_ - 1);
+  typename LatticeFasterOnlineDecoderTpl<FST>::BestPathIterator iter =
+      decoder.ImmortalPoint(max_frames);
+  if (iter.Done() || iter.tok == last_immortal_tok_)
+    return;
+  std::vector<LatticeArc> arcs;
+  TraceBack(decoder, iter, &arcs);
+  for (size_t i = 0; i < arcs.size(); i++)
+    aligner_.AcceptArc(arcs[i]);
+  last_immortal_tok_ = iter.tok;
+  last_immortal_frame_ = iter.frame;
+  aligner_.GetCompleteWords(&committed_words_);
+}
+
+template <typename FST>
+void OnlineWordAligner::GetTentativeWords(
+    const LatticeFasterOnlineDecoderTpl<FST> &decoder,
+    std::vector<AlignedWord> *words) const {
+  words->clear();
+  if (decoder.NumFramesDecoded() == 0)
+    return;
+  std::vector<LatticeArc> arcs;
+  TraceBack(decoder, decoder.BestPathEnd(false), &arcs);
+  IncrementalWordAligner aligner(aligner_);
+  for (size_t i = 0; i < arcs.size(); i++)
+    aligner.AcceptArc(arcs[i]);
+  aligner.Finish();
+  aligner.GetCompleteWords(words);
+}
+
+template <typename FST>
+void OnlineWordAligner::Finalize(
+    const LatticeFasterOnlineDecoderTpl<FST> &decoder) {
+  if (decoder.NumFramesDecoded() > 0) {
+    std::vector<LatticeArc> arcs;
+    TraceBack(decoder, decoder.BestPathEnd(true), &arcs);
+    for (size_t i = 0; i < arcs.size(); i++)
+      aligner_.AcceptArc(arcs[i]);
+  }
+  aligner_.Finish();
+  aligner_.GetCompleteWords(&committed_words_);
+}
+
+// Instantiate the templates for the FST types that we'll need.
+#define INSTANTIATE_ONLINE_WORD_ALIGNER(FST)                              \
+  template void OnlineWordAligner::Update<FST>(                           \
+      const LatticeFasterOnlineDecoderTpl<FST> &decoder);                 \
+  template void OnlineWordAligner::GetTentativeWords<FST>(                \
+      const LatticeFasterOnlineDecoderTpl<FST> &decoder,                  \
+      std::vector<AlignedWord> *words) const;                             \
+  template void OnlineWordAligner::Finalize<FST>(                         \
+      const LatticeFasterOnlineDecoderTpl<FST> &decoder);
+
+INSTANTIATE_ONLINE_WORD_ALIGNER(fst::Fst<fst::StdArc>)
+INSTANTIATE_ONLINE_WORD_ALIGNER(fst::ConstGrammarFst)
+INSTANTIATE_ONLINE_WORD_ALIGNER(fst::VectorGrammarFst)
+
+}  // namespace kaldi
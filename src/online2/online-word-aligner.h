@@ -0,0 +1,113 @@
+// online2/online-word-aligner.h
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef KALDI_ONLINE2_ONLINE_WORD_ALIGNER_H_
+#define KALDI_ONLINE2_ONLINE_WORD_ALIGNER_H_
+
+#include <vector>
+
+#include "base/kaldi-common.h"
+#include "hmm/transition-model.h"
+#include "lat/word-align-lattice.h"
+#include "decoder/lattice-faster-online-decoder.h"
+
+namespace kaldi {
+/// @addtogroup  onlinedecoding OnlineDecoding
+/// @{
+
+/**
+   OnlineWordAligner gives word boundaries for the best path of a
+   LatticeFasterOnlineDecoder while it is decoding.  The part of the best path
+   that can no longer change (the part before the decoder's ImmortalPoint()) is
+   word-aligned once, as it becomes stable, and the words in it are kept; only
+   the part after it is aligned each time you ask for the current words.  This
+   makes the cost of getting the word timings for a partial result depend on
+   the length of that unstable part rather than on the length of the utterance,
+   unlike calling WordAlignLattice() on the output of GetBestPath().
+
+   Typical usage: call Reset() after each InitDecoding() of the decoder; call
+   Update() and then GetTentativeWords() after AdvanceDecoding() whenever you
+   want a partial result; and call Finalize() after FinalizeDecoding().
+ */
+class OnlineWordAligner {
+ public:
+  /// 'max_traceback_frames' limits how far back (in frames) we look for the
+  /// point where the decoder's paths meet.  Update() never looks back past the
+  /// point it found last time, so over an utterance it looks at each frame
+  /// about once, whatever 'max_traceback_frames' is.
+  OnlineWordAligner(const TransitionModel &tmodel,
+                    const WordBoundaryInfo &info,
+                    int32 max_traceback_frames = 1000);
+
+  /// Aligns the part of the best path that has become stable since the last
+  /// call, appending its words to CommittedWords().
+  template <typename FST>
+  void Update(const LatticeFasterOnlineDecoderTpl<FST> &decoder);
+
+  /// Puts in 'words' the words of the part of the best path that is not
+  /// stable yet (not including the final-probs); a word that has not ended
+  /// gets info.partial_word_label.  CommittedWords() followed by these is the
+  /// word alignment of the current best path.
+  template <typename FST>
+  void GetTentativeWords(const LatticeFasterOnlineDecoderTpl<FST> &decoder,
+                         std::vector<AlignedWord> *words) const;
+
+  /// Call this after the decoder's FinalizeDecoding(), or when there will be
+  /// no more frames; aligns the rest of the best path (using the final-probs)
+  /// and appends its words to CommittedWords().
+  template <typename FST>
+  void Finalize(const LatticeFasterOnlineDecoderTpl<FST> &decoder);
+
+  /// The words of the stable part of the best path, in order.  Word
+  /// boundaries are in frames (after frame subsampling), counted from the
+  /// start of decoding; silences have info.silence_label.
+  const std::vector<AlignedWord> &CommittedWords() const {
+    return committed_words_;
+  }
+
+  /// Forgets everything; call this when the decoder starts a new utterance.
+  void Reset();
+
+ private:
+  // Traces back from 'iter' to the last point we have aligned up to, putting
+  // the arcs in 'arcs' in order of time.
+  template <typename FST>
+  void TraceBack(const LatticeFasterOnlineDecoderTpl<FST> &decoder,
+                 typename LatticeFasterOnlineDecoderTpl<FST>::BestPathIterator
+                 iter,
+                 std::vector<LatticeArc> *arcs) const;
+
+  const TransitionModel &tmodel_;
+  const WordBoundaryInfo &info_;
+  int32 max_traceback_frames_;
+  // Aligns the stable part of the best path.
+  IncrementalWordAligner aligner_;
+  // The decoder's token at the end of the part we have given to aligner_, or
+  // NULL if we have not given it anything yet.
+  void *last_immortal_tok_;
+  // The frame of that token, as in BestPathIterator::frame; -1 at the start.
+  int32 last_immortal_frame_;
+  std::vector<AlignedWord> committed_words_;
+};
+
+/// @} End of "addtogroup onlinedecoding"
+}  // namespace kaldi
+
+#endif  // KALDI_ONLINE2_ONLINE_WORD_ALIGNER_H_
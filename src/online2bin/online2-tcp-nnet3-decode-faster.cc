@@ -28,6 +28,7 @@
 #include "fstext/fstext-lib.h"
 #include "lat/lattice-functions.h"
 #include "util/kaldi-thread.h"
+#include "util/kaldi-semaphore.h"
 #include "nnet3/nnet-utils.h"
 
 #include <netinet/in.h>
@@ -37,17 +38,34 @@
 #include <signal.h>
 #include <arpa/inet.h>
 #include <unistd.h>
+#include <memory>
 #include <string>
+#include <thread>
 
 namespace kaldi {
 
+class TcpConnection;
+
 class TcpServer {
  public:
   explicit TcpServer(int read_timeout);
   ~TcpServer();
 
-  bool Listen(int32 port);  // start listening on a given port
-  int32 Accept();  // accept a client and return its descriptor
+  bool Listen(int32 port, int32 backlog = 1);  // start listening on a given port
+  TcpConnection *Accept();  // accept a client; caller owns the returned object
+
+ private:
+  struct ::sockaddr_in h_addr_;
+  int32 server_desc_;
+  int read_timeout_;
+};
+
+// One accepted client.  Each connection owns its own socket and sample buffer,
+// so several of them can be served from different threads at the same time.
+class TcpConnection {
+ public:
+  TcpConnection(int32 client_desc, int read_timeout);
+  ~TcpConnection();
 
   bool ReadChunk(size_t len); // get more data and return false if end-of-stream
 
@@ -59,12 +77,30 @@ class TcpServer {
   void Disconnect();
 
  private:
-  struct ::sockaddr_in h_addr_;
-  int32 server_desc_, client_desc_;
+  int32 client_desc_;
   int16 *samp_buf_;
   size_t buf_len_, has_read_;
   pollfd client_set_[1];
   int read_timeout_;
+  KALDI_DISALLOW_COPY_AND_ASSIGN(TcpConnection);
+};
+
+// Everything that is shared, read-only, between the connections that are
+// decoded concurrently: the models, the graph and the configuration.
+struct TcpDecodingResources {
+  const OnlineNnet2FeaturePipelineInfo *feature_info;
+  const nnet3::NnetSimpleLoopedComputationOptions *decodable_opts;
+  const LatticeFasterDecoderConfig *decoder_opts;
+  const OnlineEndpointConfig *endpoint_opts;
+  const TransitionModel *trans_model;
+  const nnet3::DecodableNnetSimpleLoopedInfo *decodable_info;
+  const fst::Fst<fst::StdArc> *decode_fst;
+  const fst::SymbolTable *word_syms;
+  nnet3::NnetBatchOnlineComputer *batch_computer;  // NULL if not batching
+  BaseFloat chunk_length_secs;
+  BaseFloat output_period;
+  BaseFloat samp_freq;
+  bool produce_time;
 };
 
 std::string LatticeToString(const Lattice &lat, const fst::SymbolTable &word_syms) {
@@ -111,7 +147,149 @@ std::string LatticeToString(const CompactLattice &clat, const fst::SymbolTable &
   ConvertLattice(best_path_clat, &best_path_lat);
   return LatticeToString(best_path_lat, word_syms);
 }
+
+// Decodes the audio of one client until it disconnects, sending back partial
+// results and the final transcript of each endpointed segment.
+void DecodeConnection(const TcpDecodingResources &res, TcpConnection *conn) {
+  using namespace fst;
+
+  const OnlineNnet2FeaturePipelineInfo &feature_info = *res.feature_info;
+  const nnet3::NnetSimpleLoopedComputationOptions &decodable_opts =
+      *res.decodable_opts;
+  const LatticeFasterDecoderConfig &decoder_opts = *res.decoder_opts;
+  const OnlineEndpointConfig &endpoint_opts = *res.endpoint_opts;
+  const TransitionModel &trans_model = *res.trans_model;
+  const nnet3::DecodableNnetSimpleLoopedInfo &decodable_info =
+      *res.decodable_info;
+  const fst::Fst<fst::StdArc> *decode_fst = res.decode_fst;
+  const fst::SymbolTable *word_syms = res.word_syms;
+  BaseFloat chunk_length_secs = res.chunk_length_secs,
+      output_period = res.output_period,
+      samp_freq = res.samp_freq;
+  bool produce_time = res.produce_time;
+
+  BaseFloat frame_shift = feature_info.FrameShiftInSeconds();
+  int32 frame_subsampling = decodable_opts.frame_subsampling_factor;
+
+  int32 samp_count = 0;// this is used for output refresh rate
+  size_t chunk_len = static_cast<size_t>(chunk_length_secs * samp_freq);
+  int32 check_period = static_cast<int32>(samp_freq * output_period);
+  int32 check_count = check_period;
+
+  int32 frame_offset = 0;
+
+  bool eos = false;
+
+  OnlineNnet2FeaturePipeline feature_pipeline(feature_info);
+  SingleUtteranceNnet3Decoder decoder(decoder_opts, trans_model,
+                                      decodable_info,
+                                      *decode_fst, &feature_pipeline,
+                                      res.batch_computer);
+
+  while (!eos) {
+
+    decoder.InitDecoding(frame_offset);
+    OnlineSilenceWeighting silence_weighting(
+        trans_model,
+        feature_info.silence_weighting_config,
+        decodable_opts.frame_subsampling_factor);
+    std::vector<std::pair<int32, BaseFloat>> delta_weights;
+
+    while (true) {
+      eos = !conn->ReadChunk(chunk_len);
+
+      if (eos) {
+        feature_pipeline.InputFinished();
+
+        if (silence_weighting.Active() &&
+            feature_pipeline.IvectorFeature() != NULL) {
+          silence_weighting.ComputeCurrentTraceback(decoder.Decoder());
+          silence_weighting.GetDeltaWeights(feature_pipeline.NumFramesReady(),
+                                            frame_offset * decodable_opts.frame_subsampling_factor,
+                                            &delta_weights);
+          feature_pipeline.UpdateFrameWeights(delta_weights);
+        }
+
+        decoder.AdvanceDecoding();
+        decoder.FinalizeDecoding();
+        frame_offset += decoder.NumFramesDecoded();
+        if (decoder.NumFramesDecoded() > 0) {
+          CompactLattice lat;
+          decoder.GetLattice(true, &lat);
+          std::string msg = LatticeToString(lat, *word_syms);
+
+          // get time-span from previous endpoint to end of audio,
+          if (produce_time) {
+            int32 t_beg = frame_offset - decoder.NumFramesDecoded();
+            int32 t_end = frame_offset;
+            msg = GetTimeString(t_beg, t_end, frame_shift * frame_subsampling) + " " + msg;
+          }
+
+          KALDI_VLOG(1) << "EndOfAudio, sending message: " << msg;
+          conn->WriteLn(msg);
+        } else
+          conn->Write("\n");
+        conn->Disconnect();
+        break;
+      }
+
+      Vector<BaseFloat> wave_part = conn->GetChunk();
+      feature_pipeline.AcceptWaveform(samp_freq, wave_part);
+      samp_count += chunk_len;
+
+      if (silence_weighting.Active() &&
+          feature_pipeline.IvectorFeature() != NULL) {
+        silence_weighting.ComputeCurrentTraceback(decoder.Decoder());
+        silence_weighting.GetDeltaWeights(feature_pipeline.NumFramesReady(),
+                                          frame_offset * decodable_opts.frame_subsampling_factor,
+                                          &delta_weights);
+        feature_pipeline.UpdateFrameWeights(delta_weights);
+      }
+
+      decoder.AdvanceDecoding();
+
+      if (samp_count > check_count) {
+        if (decoder.NumFramesDecoded() > 0) {
+          Lattice lat;
+          decoder.GetBestPath(false, &lat);
+          TopSort(&lat); // for LatticeStateTimes(),
+          std::string msg = LatticeToString(lat, *word_syms);
+
+          // get time-span after previous endpoint,
+          if (produce_time) {
+            int32 t_beg = frame_offset;
+            int32 t_end = frame_offset + GetLatticeTimeSpan(lat);
+            msg = GetTimeString(t_beg, t_end, frame_shift * frame_subsampling) + " " + msg;
+          }
+
+          KALDI_VLOG(1) << "Temporary transcript: " << msg;
+          conn->WriteLn(msg, "\r");
+        }
+        check_count += check_period;
+      }
+
+      if (decoder.EndpointDetected(endpoint_opts)) {
+        decoder.FinalizeDecoding();
+        frame_offset += decoder.NumFramesDecoded();
+        CompactLattice lat;
+        decoder.GetLattice(true, &lat);
+        std::string msg = LatticeToString(lat, *word_syms);
+
+        // get time-span between endpoints,
+        if (produce_time) {
+          int32 t_beg = frame_offset - decoder.NumFramesDecoded();
+          int32 t_end = frame_offset;
+          msg = GetTimeString(t_beg, t_end, frame_shift * frame_subsampling) + " " + msg;
+        }
+
+        KALDI_VLOG(1) << "Endpoint, sending message: " << msg;
+        conn->WriteLn(msg);
+        break; // while (true)
+      }
+    }
+  }
 }
+}  // namespace kaldi
 
 int main(int argc, char *argv[]) {
   try {
@@ -127,6 +305,8 @@ int main(int argc, char *argv[]) {
         "speaker adaptation and endpointing.\n"
         "Note: some configuration values and inputs are set via config\n"
         "files whose filenames are passed as options\n"
+        "Up to --num-streams clients are decoded concurrently, sharing one\n"
+        "copy of the model and the graph.\n"
         "\n"
         "Usage: online2-tcp-nnet3-decode-faster [options] <nnet3-in> "
         "<fst-in> <word-symbol-table>\n";
@@ -147,6 +327,8 @@ int main(int argc, char *argv[]) {
     int port_num = 5050;
     int read_timeout = 3;
     bool produce_time = false;
+    int32 num_streams = 1;
+    int32 nnet_batch_size = 0;
 
     po.Register("samp-freq", &samp_freq,
                 "Sampling frequency of the input signal (coded as 16-bit slinear).");
@@ -162,6 +344,14 @@ int main(int argc, char *argv[]) {
                 "Port number the server will listen on.");
     po.Register("produce-time", &produce_time,
                 "Prepend begin/end times between endpoints (e.g. '5.46 6.81 <text_output>', in seconds)");
+    po.Register("num-streams", &num_streams,
+                "Maximum number of clients that are decoded concurrently, "
+                "each on its own thread; the model and the graph are shared "
+                "between them.");
+    po.Register("nnet-batch-size", &nnet_batch_size,
+                "If >0, the neural net is evaluated for all the streams "
+                "together, in minibatches of up to this many chunks "
+                "(only exact for non-recurrent models such as TDNN-F).");
 
     feature_opts.Register(&po);
     decodable_opts.Register(&po);
@@ -174,6 +364,8 @@ int main(int argc, char *argv[]) {
       po.PrintUsage();
       return 1;
     }
+    if (num_streams < 1)
+      KALDI_ERR << "--num-streams must be at least 1.";
 
     std::string nnet3_rxfilename = po.GetArg(1),
         fst_rxfilename = po.GetArg(2),
@@ -181,9 +373,6 @@ int main(int argc, char *argv[]) {
 
     OnlineNnet2FeaturePipelineInfo feature_info(feature_opts);
 
-    BaseFloat frame_shift = feature_info.FrameShiftInSeconds();
-    int32 frame_subsampling = decodable_opts.frame_subsampling_factor;
-
     KALDI_VLOG(1) << "Loading AM...";
 
     TransitionModel trans_model;
@@ -198,6 +387,12 @@ int main(int argc, char *argv[]) {
       nnet3::CollapseModel(nnet3::CollapseModelConfig(), &(am_nnet.GetNnet()));
     }
 
+    // The batched computation is done on a copy of the nnet made before
+    // DecodableNnetSimpleLoopedInfo modifies it for looped iVector input.
+    std::unique_ptr<nnet3::Nnet> batch_nnet;
+    if (nnet_batch_size > 0)
+      batch_nnet.reset(new nnet3::Nnet(am_nnet.GetNnet()));
+
     // this object contains precomputed stuff that is used by all decodable
     // objects.  It takes a pointer to am_nnet because if it has iVectors it has
     // to modify the nnet to accept iVectors at intervals.
@@ -216,130 +411,64 @@ int main(int argc, char *argv[]) {
 
     signal(SIGPIPE, SIG_IGN); // ignore SIGPIPE to avoid crashing when socket forcefully disconnected
 
+    TcpDecodingResources res;
+    res.feature_info = &feature_info;
+    res.decodable_opts = &decodable_opts;
+    res.decoder_opts = &decoder_opts;
+    res.endpoint_opts = &endpoint_opts;
+    res.trans_model = &trans_model;
+    res.decodable_info = &decodable_info;
+    res.decode_fst = decode_fst;
+    res.word_syms = word_syms;
+    // Declared after 'batch_nnet', which it uses, so it is destroyed first.
+    std::unique_ptr<nnet3::NnetBatchOnlineComputer> batch_computer;
+    res.batch_computer = NULL;
+    if (nnet_batch_size > 0) {
+      nnet3::NnetBatchComputerOptions batch_opts;
+      batch_opts.frame_subsampling_factor =
+          decodable_opts.frame_subsampling_factor;
+      batch_opts.frames_per_chunk = decodable_info.frames_per_chunk;
+      batch_opts.acoustic_scale = decodable_opts.acoustic_scale;
+      batch_opts.optimize_config = decodable_opts.optimize_config;
+      batch_opts.compute_config = decodable_opts.compute_config;
+      batch_opts.minibatch_size = nnet_batch_size;
+      batch_opts.edge_minibatch_size = nnet_batch_size;
+      // this object is shared by all the streams for the lifetime of the
+      // server.
+      batch_computer.reset(new nnet3::NnetBatchOnlineComputer(
+          batch_opts, *batch_nnet, am_nnet.Priors()));
+      res.batch_computer = batch_computer.get();
+    }
+    res.chunk_length_secs = chunk_length_secs;
+    res.output_period = output_period;
+    res.samp_freq = samp_freq;
+    res.produce_time = produce_time;
+
     TcpServer server(read_timeout);
 
-    server.Listen(port_num);
+    server.Listen(port_num, num_streams);
 
+    // Each accepted client is decoded on its own thread; at most
+    // 'num_streams' of them run at once, further clients wait in the listen
+    // queue until a slot frees up.
+    Semaphore free_slots(num_streams);
     while (true) {
-
-      server.Accept();
-
-      int32 samp_count = 0;// this is used for output refresh rate
-      size_t chunk_len = static_cast<size_t>(chunk_length_secs * samp_freq);
-      int32 check_period = static_cast<int32>(samp_freq * output_period);
-      int32 check_count = check_period;
-
-      int32 frame_offset = 0;
-
-      bool eos = false;
-
-      OnlineNnet2FeaturePipeline feature_pipeline(feature_info);
-      SingleUtteranceNnet3Decoder decoder(decoder_opts, trans_model,
-                                          decodable_info,
-                                          *decode_fst, &feature_pipeline);
-
-      while (!eos) {
-
-        decoder.InitDecoding(frame_offset);
-        OnlineSilenceWeighting silence_weighting(
-            trans_model,
-            feature_info.silence_weighting_config,
-            decodable_opts.frame_subsampling_factor);
-        std::vector<std::pair<int32, BaseFloat>> delta_weights;
-
-        while (true) {
-          eos = !server.ReadChunk(chunk_len);
-
-          if (eos) {
-            feature_pipeline.InputFinished();
-
-            if (silence_weighting.Active() &&
-                feature_pipeline.IvectorFeature() != NULL) {
-              silence_weighting.ComputeCurrentTraceback(decoder.Decoder());
-              silence_weighting.GetDeltaWeights(feature_pipeline.NumFramesReady(),
-                                                frame_offset * decodable_opts.frame_subsampling_factor,
-                                                &delta_weights);
-              feature_pipeline.UpdateFrameWeights(delta_weights);
-            }
-
-            decoder.AdvanceDecoding();
-            decoder.FinalizeDecoding();
-            frame_offset += decoder.NumFramesDecoded();
-            if (decoder.NumFramesDecoded() > 0) {
-              CompactLattice lat;
-              decoder.GetLattice(true, &lat);
-              std::string msg = LatticeToString(lat, *word_syms);
-
-              // get time-span from previous endpoint to end of audio,
-              if (produce_time) {
-                int32 t_beg = frame_offset - decoder.NumFramesDecoded();
-                int32 t_end = frame_offset;
-                msg = GetTimeString(t_beg, t_end, frame_shift * frame_subsampling) + " " + msg;
-              }
-
-              KALDI_VLOG(1) << "EndOfAudio, sending message: " << msg;
-              server.WriteLn(msg);
-            } else
-              server.Write("\n");
-            server.Disconnect();
-            break;
-          }
-
-          Vector<BaseFloat> wave_part = server.GetChunk();
-          feature_pipeline.AcceptWaveform(samp_freq, wave_part);
-          samp_count += chunk_len;
-
-          if (silence_weighting.Active() &&
-              feature_pipeline.IvectorFeature() != NULL) {
-            silence_weighting.ComputeCurrentTraceback(decoder.Decoder());
-            silence_weighting.GetDeltaWeights(feature_pipeline.NumFramesReady(),
-                                              frame_offset * decodable_opts.frame_subsampling_factor,
-                                              &delta_weights);
-            feature_pipeline.UpdateFrameWeights(delta_weights);
-          }
-
-          decoder.AdvanceDecoding();
-
-          if (samp_count > check_count) {
-            if (decoder.NumFramesDecoded() > 0) {
-              Lattice lat;
-              decoder.GetBestPath(false, &lat);
-              TopSort(&lat); // for LatticeStateTimes(),
-              std::string msg = LatticeToString(lat, *word_syms);
-
-              // get time-span after previous endpoint,
-              if (produce_time) {
-                int32 t_beg = frame_offset;
-                int32 t_end = frame_offset + GetLatticeTimeSpan(lat);
-                msg = GetTimeString(t_beg, t_end, frame_shift * frame_subsampling) + " " + msg;
-              }
-
-              KALDI_VLOG(1) << "Temporary transcript: " << msg;
-              server.WriteLn(msg, "\r");
-            }
-            check_count += check_period;
-          }
-
-          if (decoder.EndpointDetected(endpoint_opts)) {
-            decoder.FinalizeDecoding();
-            frame_offset += decoder.NumFramesDecoded();
-            CompactLattice lat;
-            decoder.GetLattice(true, &lat);
-            std::string msg = LatticeToString(lat, *word_syms);
-
-            // get time-span between endpoints,
-            if (produce_time) {
-              int32 t_beg = frame_offset - decoder.NumFramesDecoded();
-              int32 t_end = frame_offset;
-              msg = GetTimeString(t_beg, t_end, frame_shift * frame_subsampling) + " " + msg;
-            }
-
-            KALDI_VLOG(1) << "Endpoint, sending message: " << msg;
-            server.WriteLn(msg);
-            break; // while (true)
-          }
-        }
+      free_slots.Wait();
+      TcpConnection *conn = server.Accept();
+      if (conn == NULL) {
+        free_slots.Signal();
+        continue;
       }
+      std::thread([&res, &free_slots, conn]() {
+          try {
+            DecodeConnection(res, conn);
+          } catch (const std::exception &e) {
+            KALDI_WARN << "Error while decoding client, disconnecting: "
+                       << e.what();
+          }
+          delete conn;
+          free_slots.Signal();
+        }).detach();
     }
   } catch (const std::exception &e) {
     std::cerr << e.what();
@@ -351,13 +480,10 @@ int main(int argc, char *argv[]) {
 namespace kaldi {
 TcpServer::TcpServer(int read_timeout) {
   server_desc_ = -1;
-  client_desc_ = -1;
-  samp_buf_ = NULL;
-  buf_len_ = 0;
   read_timeout_ = 1000 * read_timeout;
 }
 
-bool TcpServer::Listen(int32 port) {
+bool TcpServer::Listen(int32 port, int32 backlog) {
   h_addr_.sin_addr.s_addr = INADDR_ANY;
   h_addr_.sin_port = htons(port);
   h_addr_.sin_family = AF_INET;
@@ -381,7 +507,7 @@ bool TcpServer::Listen(int32 port) {
     return false;
   }
 
-  if (listen(server_desc_, 1) == -1) {
+  if (listen(server_desc_, backlog) == -1) {
     KALDI_ERR << "Cannot listen on port!";
     return false;
   }
@@ -393,38 +519,53 @@ bool TcpServer::Listen(int32 port) {
 }
 
 TcpServer::~TcpServer() {
-  Disconnect();
   if (server_desc_ != -1)
     close(server_desc_);
-  delete[] samp_buf_;
 }
 
-int32 TcpServer::Accept() {
+TcpConnection *TcpServer::Accept() {
   KALDI_LOG << "Waiting for client...";
 
+  struct ::sockaddr_in client_addr;
   socklen_t len;
 
-  len = sizeof(struct sockaddr);
-  client_desc_ = accept(server_desc_, (struct sockaddr *) &h_addr_, &len);
+  len = sizeof(client_addr);
+  int32 client_desc = accept(server_desc_, (struct sockaddr *) &client_addr, &len);
+  if (client_desc == -1) {
+    KALDI_WARN << "Failed to accept connection.";
+    return NULL;
+  }
 
   struct sockaddr_storage addr;
   char ipstr[20];
 
   len = sizeof addr;
-  getpeername(client_desc_, (struct sockaddr *) &addr, &len);
+  getpeername(client_desc, (struct sockaddr *) &addr, &len);
 
   struct sockaddr_in *s = (struct sockaddr_in *) &addr;
   inet_ntop(AF_INET, &s->sin_addr, ipstr, sizeof ipstr);
 
+  KALDI_LOG << "Accepted connection from: " << ipstr;
+
+  return new TcpConnection(client_desc, read_timeout_);
+}
+
+TcpConnection::TcpConnection(int32 client_desc, int read_timeout) {
+  client_desc_ = client_desc;
+  samp_buf_ = NULL;
+  buf_len_ = 0;
+  has_read_ = 0;
   client_set_[0].fd = client_desc_;
   client_set_[0].events = POLLIN;
+  read_timeout_ = read_timeout;
+}
 
-  KALDI_LOG << "Accepted connection from: " << ipstr;
-
-  return client_desc_;
+TcpConnection::~TcpConnection() {
+  Disconnect();
+  delete[] samp_buf_;
 }
 
-bool TcpServer::ReadChunk(size_t len) {
+bool TcpConnection::ReadChunk(size_t len) {
   if (buf_len_ != len) {
     buf_len_ = len;
     delete[] samp_buf_;
@@ -459,7 +600,7 @@ bool TcpServer::ReadChunk(size_t len) {
   return has_read_ > 0;
 }
 
-Vector<BaseFloat> TcpServer::GetChunk() {
+Vector<BaseFloat> TcpConnection::GetChunk() {
   Vector<BaseFloat> buf;
 
   buf.Resize(static_cast<MatrixIndexT>(has_read_));
@@ -470,7 +611,7 @@ Vector<BaseFloat> TcpServer::GetChunk() {
   return buf;
 }
 
-bool TcpServer::Write(const std::string &msg) {
+bool TcpConnection::Write(const std::string &msg) {
 
   const char *p = msg.c_str();
   size_t to_write = msg.size();
@@ -487,13 +628,13 @@ bool TcpServer::Write(const std::string &msg) {
   return true;
 }
 
-bool TcpServer::WriteLn(const std::string &msg, const std::string &eol) {
+bool TcpConnection::WriteLn(const std::string &msg, const std::string &eol) {
   if (Write(msg))
     return Write(eol);
   else return false;
 }
 
-void TcpServer::Disconnect() {
+void TcpConnection::Disconnect() {
   if (client_desc_ != -1) {
     close(client_desc_);
     client_desc_ = -1;
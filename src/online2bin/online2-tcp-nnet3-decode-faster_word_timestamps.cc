@@ -25,9 +25,11 @@
 #include "online2/onlinebin-util.h"
 #include "online2/online-timing.h"
 #include "online2/online-endpoint.h"
+#include "online2/online-word-aligner.h"
 #include "fstext/fstext-lib.h"
 #include "lat/lattice-functions.h"
 #include "util/kaldi-thread.h"
+#include "util/kaldi-semaphore.h"
 #include "lat/word-align-lattice.h"
 #include "nnet3/nnet-utils.h"
 #include <sys/time.h>
@@ -42,7 +44,10 @@
 #include <signal.h>
 #include <arpa/inet.h>
 #include <unistd.h>
+#include <memory>
 #include <string>
+#include <thread>
+#include <mutex>
 #include <random>
 #include <sstream>
 
@@ -51,8 +56,11 @@ namespace uuid {
     static std::mt19937                    gen(rd());
     static std::uniform_int_distribution<> dis(0, 15);
     static std::uniform_int_distribution<> dis2(8, 11);
+    // the generator is shared by all the client threads.
+    static std::mutex gen_mutex;
 
     std::string generate_uuid_v4() {
+        std::lock_guard<std::mutex> lock(gen_mutex);
         std::stringstream ss;
         int i;
         ss << std::hex;
@@ -83,13 +91,28 @@ namespace uuid {
 
 namespace kaldi {
 
+class TcpConnection;
+
 class TcpServer {
  public:
   explicit TcpServer(int read_timeout);
   ~TcpServer();
 
-  bool Listen(int32 port);  // start listening on a given port
-  int32 Accept();  // accept a client and return its descriptor
+  bool Listen(int32 port, int32 backlog = 1);  // start listening on a given port
+  TcpConnection *Accept();  // accept a client; caller owns the returned object
+
+ private:
+  struct ::sockaddr_in h_addr_;
+  int32 server_desc_;
+  int read_timeout_;
+};
+
+// One accepted client.  Each connection owns its own socket and sample buffer,
+// so several of them can be served from different threads at the same time.
+class TcpConnection {
+ public:
+  TcpConnection(int32 client_desc, int read_timeout);
+  ~TcpConnection();
 
   bool ReadChunk(size_t len); // get more data and return false if end-of-stream
 
@@ -101,12 +124,31 @@ class TcpServer {
   void Disconnect();
 
  private:
-  struct ::sockaddr_in h_addr_;
-  int32 server_desc_, client_desc_;
+  int32 client_desc_;
   int16 *samp_buf_;
   size_t buf_len_, has_read_;
   pollfd client_set_[1];
   int read_timeout_;
+  KALDI_DISALLOW_COPY_AND_ASSIGN(TcpConnection);
+};
+
+// Everything that is shared, read-only, between the connections that are
+// decoded concurrently: the models, the graph and the configuration.
+struct TcpDecodingResources {
+  const OnlineNnet2FeaturePipelineInfo *feature_info;
+  const nnet3::NnetSimpleLoopedComputationOptions *decodable_opts;
+  const LatticeFasterDecoderConfig *decoder_opts;
+  const OnlineEndpointConfig *endpoint_opts;
+  const TransitionModel *trans_model;
+  const nnet3::DecodableNnetSimpleLoopedInfo *decodable_info;
+  const fst::Fst<fst::StdArc> *decode_fst;
+  const fst::SymbolTable *word_syms;
+  nnet3::NnetBatchOnlineComputer *batch_computer;  // NULL if not batching
+  const WordBoundaryInfo *word_boundary_info;
+  BaseFloat chunk_length_secs;
+  BaseFloat output_period;
+  BaseFloat samp_freq;
+  bool produce_time;
 };
 
 std::string LatticeToString(const Lattice &lat, const fst::SymbolTable &word_syms) {
@@ -153,15 +195,318 @@ std::string LatticeToString(const CompactLattice &clat, const fst::SymbolTable &
   ConvertLattice(best_path_clat, &best_path_lat);
   return LatticeToString(best_path_lat, word_syms);
 }
+
+// The JSON objects for a sequence of words with their times, as sent in the
+// partial results.
+struct WordTimesJson {
+  std::string words;  // Each word's object, followed by a comma.
+  std::string first_word_start;
+  std::string last_word_end;
+  int32 num_words;
+  double end_time;  // End of the last word, not counting start_shift.
+
+  WordTimesJson(): num_words(0), end_time(0.0) { }
+
+  // Appends 'word' unless it is silence or a word like <unk>.  'time_unit' is
+  // the length of a frame in seconds, and 'start_shift' the start time of the
+  // block.
+  void Append(const AlignedWord &word, const fst::SymbolTable &word_syms,
+              double time_unit, double start_shift) {
+    if (word.word == 0)
+      return;
+    std::string str = word_syms.Find(word.word);
+    if (str.find("<") == 0)
+      return;
+    int32 end_frame = word.start_frame + word.num_frames;
+    std::string str_start = std::to_string(word.start_frame * time_unit +
+                                           start_shift),
+        str_end = std::to_string(end_frame * time_unit + start_shift);
+    if (num_words == 0)
+      first_word_start = str_start;
+    words += "{\"word\":\"" + str + "\",\"start\":" + str_start +
+        ",\"end\":" + str_end + "},";
+    last_word_end = str_end;
+    end_time = end_frame * time_unit;
+    num_words++;
+  }
+};
+
+// Decodes the audio of one client until it disconnects, sending back partial
+// results and the final transcript of each endpointed segment.
+void DecodeConnection(const TcpDecodingResources &res, TcpConnection *conn) {
+  using namespace fst;
+  using namespace uuid;
+  using namespace std::chrono;
+  using json = nlohmann::json;
+
+  const OnlineNnet2FeaturePipelineInfo &feature_info = *res.feature_info;
+  const nnet3::NnetSimpleLoopedComputationOptions &decodable_opts =
+      *res.decodable_opts;
+  const LatticeFasterDecoderConfig &decoder_opts = *res.decoder_opts;
+  const OnlineEndpointConfig &endpoint_opts = *res.endpoint_opts;
+  const TransitionModel &trans_model = *res.trans_model;
+  const nnet3::DecodableNnetSimpleLoopedInfo &decodable_info =
+      *res.decodable_info;
+  const fst::Fst<fst::StdArc> *decode_fst = res.decode_fst;
+  const fst::SymbolTable *word_syms = res.word_syms;
+  const WordBoundaryInfo &word_boundary_info = *res.word_boundary_info;
+  BaseFloat chunk_length_secs = res.chunk_length_secs,
+      output_period = res.output_period,
+      samp_freq = res.samp_freq;
+
+  BaseFloat frame_shift = feature_info.FrameShiftInSeconds();
+  int32 frame_subsampling = decodable_opts.frame_subsampling_factor;
+
+  int32 samp_count = 0;// this is used for output refresh rate
+  size_t chunk_len = static_cast<size_t>(chunk_length_secs * samp_freq);
+  int32 check_period = static_cast<int32>(samp_freq * output_period);
+  int32 check_count = check_period;
+
+  int32 frame_offset = 0;
+
+  bool eos = false;
+  int word_count = 0;
+  int block = 0;
+  double last_timestamp = 0.0;
+  std::string current_hypothesis = "";
+  std::string global_message = "";
+  std::string global_block_start = "";
+  std::string global_block_end = "";
+  std::string block_uuid = generate_uuid_v4();
+  auto transcription_start = high_resolution_clock::now();
+
+  OnlineNnet2FeaturePipeline feature_pipeline(feature_info);
+  SingleUtteranceNnet3Decoder decoder(decoder_opts, trans_model,
+                                      decodable_info,
+                                      *decode_fst, &feature_pipeline,
+                                      res.batch_computer);
+  // The words of the stable part of the best path are aligned, and turned into
+  // JSON, only once, so the cost of each partial result only depends on the
+  // part of the best path that may still change.
+  OnlineWordAligner word_aligner(trans_model, word_boundary_info);
+  WordTimesJson committed_json;
+  size_t num_committed_words = 0;
+
+  while (!eos) {
+
+    decoder.InitDecoding(frame_offset);
+    word_aligner.Reset();
+    committed_json = WordTimesJson();
+    num_committed_words = 0;
+    OnlineSilenceWeighting silence_weighting(
+        trans_model,
+        feature_info.silence_weighting_config,
+        decodable_opts.frame_subsampling_factor);
+    std::vector<std::pair<int32, BaseFloat>> delta_weights;
+
+    while (true) {
+      eos = !conn->ReadChunk(chunk_len);
+
+      if (eos) {
+        feature_pipeline.InputFinished();
+
+        if (silence_weighting.Active() &&
+            feature_pipeline.IvectorFeature() != NULL) {
+          silence_weighting.ComputeCurrentTraceback(decoder.Decoder());
+          silence_weighting.GetDeltaWeights(feature_pipeline.NumFramesReady(),
+                                            frame_offset * decodable_opts.frame_subsampling_factor,
+                                            &delta_weights);
+          feature_pipeline.UpdateFrameWeights(delta_weights);
+        }
+
+        decoder.AdvanceDecoding();
+        decoder.FinalizeDecoding();
+        frame_offset += decoder.NumFramesDecoded();
+        if (decoder.NumFramesDecoded() > 0) {
+
+          CompactLattice lat;
+          decoder.GetLattice(true, &lat);
+          TopSort(&lat); // for LatticeStateTimes(),
+          std::string msg = LatticeToString(lat, *word_syms);
+          istringstream iss(msg);
+          vector<string> message_vector{istream_iterator<string>{iss}, istream_iterator<string>{}};
+          current_hypothesis = current_hypothesis + ",";
+
+          for (int i = word_count; i < message_vector.size(); i++) {
+            // Hack to deal with end of audio file timestamps
+            // we take the last timestamp from previous decoding and total duration of the audio, then uniformly assign 
+            // durations to the remaining words
+
+            double offset;
+            std::string word = message_vector[i];
+            if (word.find("<") == 0){
+                continue;
+            }
+            std::string str_start, str_end;
+
+            if (message_vector.size() - word_count > 0) {
+              offset = (frame_offset * frame_subsampling * frame_shift - last_timestamp) / (message_vector.size() - word_count);
+            }
+            else {
+              offset = 0.0;
+            }
+            str_start = std::to_string(last_timestamp);
+            last_timestamp = last_timestamp + offset;
+            str_end = std::to_string(last_timestamp);
+            current_hypothesis = current_hypothesis + "{\"word\":" + "\"" + word + "\"," + "\"start\":" + str_start + "," + "\"end\":" + str_end + "},";
+            word_count += 1;
+            global_block_end = str_end;
+          }
+
+          if (word_count > 0) {
+          current_hypothesis.erase(std::prev(current_hypothesis.end()));
+          struct timeval tp;
+          gettimeofday(&tp, NULL);
+          long int timestamp = tp.tv_sec * 1000 + tp.tv_usec / 1000;
+          std::string current_block = std::to_string(block);
+          std::string block_identifier = std::to_string(timestamp);
+          current_hypothesis = "\"block_uuid\":\"" + block_uuid + "\"" + ", " +  "\"block\":" + current_block
+              + ", " + "\"timestamp\": " + block_identifier + ", " + ", \"first_word_in_block_start\": " + global_block_start
+              + ", \"last_word_in_block_end\": " + global_block_end + ", " + "\"words\":[" + current_hypothesis + "]}";
+          global_message = current_hypothesis;
+
+          auto transcript_time = high_resolution_clock::now();
+          auto duration = duration_cast<milliseconds>( transcript_time - transcription_start ).count();
+          std::string current_duration = std::to_string(duration);
+
+          current_hypothesis = "{\"block_end\": true, \"time_from_beginning\": " + current_duration + ", " + current_hypothesis;
+
+          bool jv = json::accept(current_hypothesis);
+          if (jv) {
+            conn->Write(current_hypothesis);
+            KALDI_VLOG(1) << "EndOfAudio, sending message: " << current_hypothesis;
+            }
+          else {
+            KALDI_VLOG(1) << "Warning: Invalid json format encountered " << current_hypothesis;
+            }
+        }
+        else {
+            current_hypothesis = "";
+        }
+        }
+        conn->Disconnect();
+        break;
+      }
+
+      Vector<BaseFloat> wave_part = conn->GetChunk();
+      feature_pipeline.AcceptWaveform(samp_freq, wave_part);
+      samp_count += chunk_len;
+
+      if (silence_weighting.Active() &&
+          feature_pipeline.IvectorFeature() != NULL) {
+        silence_weighting.ComputeCurrentTraceback(decoder.Decoder());
+        silence_weighting.GetDeltaWeights(feature_pipeline.NumFramesReady(),
+                                          frame_offset * decodable_opts.frame_subsampling_factor,
+                                          &delta_weights);
+        feature_pipeline.UpdateFrameWeights(delta_weights);
+      }
+
+      decoder.AdvanceDecoding();
+
+      if (samp_count > check_count) {
+        if (decoder.NumFramesDecoded() > 0) {
+          double start_shift = frame_offset * frame_subsampling * frame_shift;
+          double time_unit = frame_shift * frame_subsampling;
+          word_aligner.Update(decoder.Decoder());
+          const std::vector<AlignedWord> &committed_words =
+              word_aligner.CommittedWords();
+          for (; num_committed_words < committed_words.size();
+               num_committed_words++)
+            committed_json.Append(committed_words[num_committed_words],
+                                  *word_syms, time_unit, start_shift);
+          std::vector<AlignedWord> tentative_words;
+          word_aligner.GetTentativeWords(decoder.Decoder(), &tentative_words);
+          WordTimesJson hypothesis_json(committed_json);
+          for (size_t i = 0; i < tentative_words.size(); i++)
+            hypothesis_json.Append(tentative_words[i], *word_syms, time_unit,
+                                   start_shift);
+
+          std::string message = hypothesis_json.words;
+          std::string first_word_in_block_start =
+              hypothesis_json.first_word_start;
+          std::string last_word_in_block_end = hypothesis_json.last_word_end;
+          word_count = hypothesis_json.num_words;
+          if (word_count > 0)
+            last_timestamp = hypothesis_json.end_time;
+
+          // remove trailing comma
+          if (word_count > 0) {
+
+            message.erase(std::prev(message.end()));
+            current_hypothesis = message;
+            global_block_start = first_word_in_block_start;
+            global_block_end = last_word_in_block_end;
+            struct timeval tp;
+            gettimeofday(&tp, NULL);
+            long int timestamp = tp.tv_sec * 1000 + tp.tv_usec / 1000;
+            std::string current_block = std::to_string(block);
+            std::string block_identifier = std::to_string(timestamp);
+            message = "\"block_uuid\":\"" + block_uuid + "\"" + ", " + "\"block\":" + current_block + ", "  + "\"timestamp\": "
+                + block_identifier + ", \"first_word_in_block_start\": " + first_word_in_block_start
+                + ", \"last_word_in_block_end\": " + last_word_in_block_end
+                + ", " + "\"words\":[" + message + "]}";
+            global_message = message;
+
+            auto transcript_time = high_resolution_clock::now();
+            auto duration = duration_cast<milliseconds>( transcript_time - transcription_start ).count();
+            std::string current_duration = std::to_string(duration);
+
+            message = "{\"block_end\": false, \"time_from_beginning\": " + current_duration + ", " + message;
+
+            bool jv = json::accept(message);
+            if (jv) {
+                conn->Write(message);
+                KALDI_VLOG(1) << "Temporary transcript: " << message;
+            }
+            else {
+               KALDI_VLOG(1) << "Warning: Invalid json format encountered " << message;
+            }
+          }
+        }
+        check_count += check_period;
+      }
+
+      if (decoder.EndpointDetected(endpoint_opts)) {
+        block += 1;
+        block_uuid = generate_uuid_v4();
+        decoder.FinalizeDecoding();
+        frame_offset += decoder.NumFramesDecoded();
+        CompactLattice lat;
+        decoder.GetLattice(true, &lat);
+        std::string msg = LatticeToString(lat, *word_syms);
+
+        auto transcript_time = high_resolution_clock::now();
+        auto duration = duration_cast<milliseconds>( transcript_time - transcription_start ).count();
+        std::string current_duration = std::to_string(duration);
+
+        if (word_count > 0) {
+            global_message = "{\"block_end\": true, \"time_from_beginning\": " + current_duration + ", " + global_message;
+
+            bool jv = json::accept(global_message);
+            if (jv) {
+                conn->Write(global_message);
+                KALDI_VLOG(1) << "Endpoint, sending message: " << global_message;
+                break;
+            }
+            else {
+              KALDI_VLOG(1) << "Warning: Invalid json format encountered " << global_message;
+              break;
+            }
+          }
+        else {
+            global_message = "";
+            break;
+         }
+       }
+     }
+  }
 }
+}  // namespace kaldi
 
 int main(int argc, char *argv[]) {
   try {
     using namespace kaldi;
-    using namespace uuid;
     using namespace fst;
-    using namespace std::chrono;
-    using json = nlohmann::json;
 
     typedef kaldi::int32 int32;
     typedef kaldi::int64 int64;
@@ -172,6 +517,8 @@ int main(int argc, char *argv[]) {
         "speaker adaptation and endpointing.\n"
         "Note: some configuration values and inputs are set via config\n"
         "files whose filenames are passed as options\n"
+        "Up to --num-streams clients are decoded concurrently, sharing one\n"
+        "copy of the model and the graph.\n"
         "\n"
         "Usage: online2-tcp-nnet3-decode-faster [options] <nnet3-in> "
         "<fst-in> <word-symbol-table>\n";
@@ -192,6 +539,8 @@ int main(int argc, char *argv[]) {
     int port_num = 5050;
     int read_timeout = 3;
     bool produce_time = false;
+    int32 num_streams = 1;
+    int32 nnet_batch_size = 0;
     std::string word_boundary = "";
 
     po.Register("samp-freq", &samp_freq,
@@ -208,6 +557,14 @@ int main(int argc, char *argv[]) {
                 "Port number the server will listen on.");
     po.Register("produce-time", &produce_time,
                 "Prepend begin/end times between endpoints (e.g. '5.46 6.81 <text_output>', in seconds)");
+    po.Register("num-streams", &num_streams,
+                "Maximum number of clients that are decoded concurrently, "
+                "each on its own thread; the model and the graph are shared "
+                "between them.");
+    po.Register("nnet-batch-size", &nnet_batch_size,
+                "If >0, the neural net is evaluated for all the streams "
+                "together, in minibatches of up to this many chunks "
+                "(only exact for non-recurrent models such as TDNN-F).");
     po.Register("word-boundary", &word_boundary,
                 "path to a word boundary file");
 
@@ -222,6 +579,8 @@ int main(int argc, char *argv[]) {
       po.PrintUsage();
       return 1;
     }
+    if (num_streams < 1)
+      KALDI_ERR << "--num-streams must be at least 1.";
 
     std::string nnet3_rxfilename = po.GetArg(1),
         fst_rxfilename = po.GetArg(2),
@@ -232,9 +591,6 @@ int main(int argc, char *argv[]) {
     WordBoundaryInfoNewOpts opts; // use default opts
     WordBoundaryInfo word_boundary_info(opts, word_boundary_filename);
 
-    BaseFloat frame_shift = feature_info.FrameShiftInSeconds();
-    int32 frame_subsampling = decodable_opts.frame_subsampling_factor;
-
     KALDI_VLOG(1) << "Loading AM...";
 
     TransitionModel trans_model;
@@ -249,6 +605,12 @@ int main(int argc, char *argv[]) {
       nnet3::CollapseModel(nnet3::CollapseModelConfig(), &(am_nnet.GetNnet()));
     }
 
+    // The batched computation is done on a copy of the nnet made before
+    // DecodableNnetSimpleLoopedInfo modifies it for looped iVector input.
+    std::unique_ptr<nnet3::Nnet> batch_nnet;
+    if (nnet_batch_size > 0)
+      batch_nnet.reset(new nnet3::Nnet(am_nnet.GetNnet()));
+
     // this object contains precomputed stuff that is used by all decodable
     // objects.  It takes a pointer to am_nnet because if it has iVectors it has
     // to modify the nnet to accept iVectors at intervals.
@@ -267,268 +629,65 @@ int main(int argc, char *argv[]) {
 
     signal(SIGPIPE, SIG_IGN); // ignore SIGPIPE to avoid crashing when socket forcefully disconnected
 
+    TcpDecodingResources res;
+    res.feature_info = &feature_info;
+    res.decodable_opts = &decodable_opts;
+    res.decoder_opts = &decoder_opts;
+    res.endpoint_opts = &endpoint_opts;
+    res.trans_model = &trans_model;
+    res.decodable_info = &decodable_info;
+    res.decode_fst = decode_fst;
+    res.word_syms = word_syms;
+    // Declared after 'batch_nnet', which it uses, so it is destroyed first.
+    std::unique_ptr<nnet3::NnetBatchOnlineComputer> batch_computer;
+    res.batch_computer = NULL;
+    if (nnet_batch_size > 0) {
+      nnet3::NnetBatchComputerOptions batch_opts;
+      batch_opts.frame_subsampling_factor =
+          decodable_opts.frame_subsampling_factor;
+      batch_opts.frames_per_chunk = decodable_info.frames_per_chunk;
+      batch_opts.acoustic_scale = decodable_opts.acoustic_scale;
+      batch_opts.optimize_config = decodable_opts.optimize_config;
+      batch_opts.compute_config = decodable_opts.compute_config;
+      batch_opts.minibatch_size = nnet_batch_size;
+      batch_opts.edge_minibatch_size = nnet_batch_size;
+      // this object is shared by all the streams for the lifetime of the
+      // server.
+      batch_computer.reset(new nnet3::NnetBatchOnlineComputer(
+          batch_opts, *batch_nnet, am_nnet.Priors()));
+      res.batch_computer = batch_computer.get();
+    }
+    res.word_boundary_info = &word_boundary_info;
+    res.chunk_length_secs = chunk_length_secs;
+    res.output_period = output_period;
+    res.samp_freq = samp_freq;
+    res.produce_time = produce_time;
+
     TcpServer server(read_timeout);
 
-    server.Listen(port_num);
+    server.Listen(port_num, num_streams);
 
+    // Each accepted client is decoded on its own thread; at most
+    // 'num_streams' of them run at once, further clients wait in the listen
+    // queue until a slot frees up.
+    Semaphore free_slots(num_streams);
     while (true) {
-
-      server.Accept();
-
-      int32 samp_count = 0;// this is used for output refresh rate
-      size_t chunk_len = static_cast<size_t>(chunk_length_secs * samp_freq);
-      int32 check_period = static_cast<int32>(samp_freq * output_period);
-      int32 check_count = check_period;
-
-      int32 frame_offset = 0;
-
-      bool eos = false;
-      int word_count = 0;
-      int block = 0;
-      double last_timestamp = 0.0;
-      std::string current_hypothesis = "";
-      std::string global_message = "";
-      std::string global_block_start = "";
-      std::string global_block_end = "";
-      std::string block_uuid = generate_uuid_v4();
-      auto transcription_start = high_resolution_clock::now();
-
-      OnlineNnet2FeaturePipeline feature_pipeline(feature_info);
-      SingleUtteranceNnet3Decoder decoder(decoder_opts, trans_model,
-                                          decodable_info,
-                                          *decode_fst, &feature_pipeline);
-
-      while (!eos) {
-
-        decoder.InitDecoding(frame_offset);
-        OnlineSilenceWeighting silence_weighting(
-            trans_model,
-            feature_info.silence_weighting_config,
-            decodable_opts.frame_subsampling_factor);
-        std::vector<std::pair<int32, BaseFloat>> delta_weights;
-
-        while (true) {
-          eos = !server.ReadChunk(chunk_len);
-
-          if (eos) {
-            feature_pipeline.InputFinished();
-
-            if (silence_weighting.Active() &&
-                feature_pipeline.IvectorFeature() != NULL) {
-              silence_weighting.ComputeCurrentTraceback(decoder.Decoder());
-              silence_weighting.GetDeltaWeights(feature_pipeline.NumFramesReady(),
-                                                frame_offset * decodable_opts.frame_subsampling_factor,
-                                                &delta_weights);
-              feature_pipeline.UpdateFrameWeights(delta_weights);
-            }
-
-            decoder.AdvanceDecoding();
-            decoder.FinalizeDecoding();
-            frame_offset += decoder.NumFramesDecoded();
-            if (decoder.NumFramesDecoded() > 0) {
-
-              CompactLattice lat;
-              decoder.GetLattice(true, &lat);
-              TopSort(&lat); // for LatticeStateTimes(),
-              std::string msg = LatticeToString(lat, *word_syms);
-              istringstream iss(msg);
-              vector<string> message_vector{istream_iterator<string>{iss}, istream_iterator<string>{}};
-              current_hypothesis = current_hypothesis + ",";
-
-              for (int i = word_count; i < message_vector.size(); i++) {
-                // Hack to deal with end of audio file timestamps
-                // we take the last timestamp from previous decoding and total duration of the audio, then uniformly assign 
-                // durations to the remaining words
-
-                double offset;
-                std::string word = message_vector[i];
-                if (word.find("<") == 0){
-                    continue;
-                }
-                std::string str_start, str_end;
-
-                if (message_vector.size() - word_count > 0) {
-                  offset = (frame_offset * frame_subsampling * frame_shift - last_timestamp) / (message_vector.size() - word_count);
-                }
-                else {
-                  offset = 0.0;
-                }
-                str_start = std::to_string(last_timestamp);
-                last_timestamp = last_timestamp + offset;
-                str_end = std::to_string(last_timestamp);
-                current_hypothesis = current_hypothesis + "{\"word\":" + "\"" + word + "\"," + "\"start\":" + str_start + "," + "\"end\":" + str_end + "},";
-                word_count += 1;
-                global_block_end = str_end;
-              }
-
-              if (word_count > 0) {
-              current_hypothesis.erase(std::prev(current_hypothesis.end()));
-              struct timeval tp;
-              gettimeofday(&tp, NULL);
-              long int timestamp = tp.tv_sec * 1000 + tp.tv_usec / 1000;
-              std::string current_block = std::to_string(block);
-              std::string block_identifier = std::to_string(timestamp);
-              current_hypothesis = "\"block_uuid\":\"" + block_uuid + "\"" + ", " +  "\"block\":" + current_block
-                  + ", " + "\"timestamp\": " + block_identifier + ", " + ", \"first_word_in_block_start\": " + global_block_start
-                  + ", \"last_word_in_block_end\": " + global_block_end + ", " + "\"words\":[" + current_hypothesis + "]}";
-              global_message = current_hypothesis;
-
-              auto transcript_time = high_resolution_clock::now();
-              auto duration = duration_cast<milliseconds>( transcript_time - transcription_start ).count();
-              std::string current_duration = std::to_string(duration);
-
-              current_hypothesis = "{\"block_end\": true, \"time_from_beginning\": " + current_duration + ", " + current_hypothesis;
-
-              bool jv = json::accept(current_hypothesis);
-              if (jv) {
-                server.Write(current_hypothesis);
-                KALDI_VLOG(1) << "EndOfAudio, sending message: " << current_hypothesis;
-                }
-              else {
-                KALDI_VLOG(1) << "Warning: Invalid json format encountered " << current_hypothesis;
-                }
-            }
-            else {
-                current_hypothesis = "";
-            }
-            }
-            server.Disconnect();
-            break;
-          }
-
-          Vector<BaseFloat> wave_part = server.GetChunk();
-          feature_pipeline.AcceptWaveform(samp_freq, wave_part);
-          samp_count += chunk_len;
-
-          if (silence_weighting.Active() &&
-              feature_pipeline.IvectorFeature() != NULL) {
-            silence_weighting.ComputeCurrentTraceback(decoder.Decoder());
-            silence_weighting.GetDeltaWeights(feature_pipeline.NumFramesReady(),
-                                              frame_offset * decodable_opts.frame_subsampling_factor,
-                                              &delta_weights);
-            feature_pipeline.UpdateFrameWeights(delta_weights);
-          }
-
-          decoder.AdvanceDecoding();
-
-          if (samp_count > check_count) {
-            if (decoder.NumFramesDecoded() > 0) {
-              double start_shift = frame_offset * frame_subsampling * frame_shift;
-              Lattice lat;
-              decoder.GetBestPath(false, &lat);
-
-              CompactLattice clat; // make empty compact lattice
-              ConvertLattice(lat, &clat); // convert lattice to compact lattice and save to clat
-
-              CompactLattice aligned_clat;
-              std::vector<int32> words, times, lengths; // define vectors
-              std::vector<std::vector<int32> > prons;
-              std::vector<std::vector<int32> > phone_lengths;
-
-              WordAlignLattice(clat, trans_model, word_boundary_info, 0, &aligned_clat); // Align lattice by words
-              CompactLatticeToWordProns(trans_model, aligned_clat, &words, &times, &lengths, &prons, &phone_lengths);
-
-              TopSort(&lat); // for LatticeStateTimes(),
-              std::string msg = LatticeToString(lat, *word_syms);
-              istringstream iss(msg);
-              vector<string> message_vector{istream_iterator<string>{iss}, istream_iterator<string>{}};
-              std::string message = "";
-              std::string first_word_in_block_start = "";
-              std::string last_word_in_block_end = "";
-              bool start_of_block_assigned = false;
-              word_count = 0;
-
-              for (int i = 0; i < words.size(); i++) {
-                if(words[i] == 0) {
-                continue;
-                }
-                std::string word = word_syms->Find(words[i]).c_str();
-                if (word.find("<") == 0){
-                    continue;
-                }
-                std::string str_start = std::to_string(times[i] * frame_shift * frame_subsampling + start_shift);
-                std::string str_end = std::to_string((times[i] + lengths[i]) * frame_shift * frame_subsampling + start_shift);
-                if (!start_of_block_assigned) {
-                    first_word_in_block_start = str_start;
-                    start_of_block_assigned = true;
-                }
-                message = message + "{\"word\":" + "\"" + word + "\"" + "," + "\"start\":" + str_start + "," + "\"end\":" + str_end + "},";
-                last_timestamp = (times[i] + lengths[i]) * frame_shift * frame_subsampling;
-                last_word_in_block_end = str_end;
-                word_count += 1; // we want to remember the number of words in each lattice hypothesis
-              }
-
-              // remove trailing comma
-              if (word_count > 0) {
-
-                message.erase(std::prev(message.end()));
-                current_hypothesis = message;
-                global_block_start = first_word_in_block_start;
-                global_block_end = last_word_in_block_end;
-                struct timeval tp;
-                gettimeofday(&tp, NULL);
-                long int timestamp = tp.tv_sec * 1000 + tp.tv_usec / 1000;
-                std::string current_block = std::to_string(block);
-                std::string block_identifier = std::to_string(timestamp);
-                message = "\"block_uuid\":\"" + block_uuid + "\"" + ", " + "\"block\":" + current_block + ", "  + "\"timestamp\": "
-                    + block_identifier + ", \"first_word_in_block_start\": " + first_word_in_block_start
-                    + ", \"last_word_in_block_end\": " + last_word_in_block_end
-                    + ", " + "\"words\":[" + message + "]}";
-                global_message = message;
-
-                auto transcript_time = high_resolution_clock::now();
-                auto duration = duration_cast<milliseconds>( transcript_time - transcription_start ).count();
-                std::string current_duration = std::to_string(duration);
-
-                message = "{\"block_end\": false, \"time_from_beginning\": " + current_duration + ", " + message;
-
-                bool jv = json::accept(message);
-                if (jv) {
-                    server.Write(message);
-                    KALDI_VLOG(1) << "Temporary transcript: " << message;
-                }
-                else {
-                   KALDI_VLOG(1) << "Warning: Invalid json format encountered " << message;
-                }
-              }
-            }
-            check_count += check_period;
-          }
-
-          if (decoder.EndpointDetected(endpoint_opts)) {
-            block += 1;
-            block_uuid = generate_uuid_v4();
-            decoder.FinalizeDecoding();
-            frame_offset += decoder.NumFramesDecoded();
-            CompactLattice lat;
-            decoder.GetLattice(true, &lat);
-            std::string msg = LatticeToString(lat, *word_syms);
-
-            auto transcript_time = high_resolution_clock::now();
-            auto duration = duration_cast<milliseconds>( transcript_time - transcription_start ).count();
-            std::string current_duration = std::to_string(duration);
-
-            if (word_count > 0) {
-                global_message = "{\"block_end\": true, \"time_from_beginning\": " + current_duration + ", " + global_message;
-
-                bool jv = json::accept(global_message);
-                if (jv) {
-                    server.Write(global_message);
-                    KALDI_VLOG(1) << "Endpoint, sending message: " << global_message;
-                    break;
-                }
-                else {
-                  KALDI_VLOG(1) << "Warning: Invalid json format encountered " << global_message;
-                  break;
-                }
-              }
-            else {
-                global_message = "";
-                break;
-             }
-           }
-         }
+      free_slots.Wait();
+      TcpConnection *conn = server.Accept();
+      if (conn == NULL) {
+        free_slots.Signal();
+        continue;
       }
+      std::thread([&res, &free_slots, conn]() {
+          try {
+            DecodeConnection(res, conn);
+          } catch (const std::exception &e) {
+            KALDI_WARN << "Error while decoding client, disconnecting: "
+                       << e.what();
+          }
+          delete conn;
+          free_slots.Signal();
+        }).detach();
     }
   } catch (const std::exception &e) {
     std::cerr << e.what();
@@ -540,13 +699,10 @@ int main(int argc, char *argv[]) {
 namespace kaldi {
 TcpServer::TcpServer(int read_timeout) {
   server_desc_ = -1;
-  client_desc_ = -1;
-  samp_buf_ = NULL;
-  buf_len_ = 0;
   read_timeout_ = 1000 * read_timeout;
 }
 
-bool TcpServer::Listen(int32 port) {
+bool TcpServer::Listen(int32 port, int32 backlog) {
   h_addr_.sin_addr.s_addr = INADDR_ANY;
   h_addr_.sin_port = htons(port);
   h_addr_.sin_family = AF_INET;
@@ -570,7 +726,7 @@ bool TcpServer::Listen(int32 port) {
     return false;
   }
 
-  if (listen(server_desc_, 1) == -1) {
+  if (listen(server_desc_, backlog) == -1) {
     KALDI_ERR << "Cannot listen on port!";
     return false;
   }
@@ -582,38 +738,53 @@ bool TcpServer::Listen(int32 port) {
 }
 
 TcpServer::~TcpServer() {
-  Disconnect();
   if (server_desc_ != -1)
     close(server_desc_);
-  delete[] samp_buf_;
 }
 
-int32 TcpServer::Accept() {
+TcpConnection *TcpServer::Accept() {
   KALDI_LOG << "Waiting for client...";
 
+  struct ::sockaddr_in client_addr;
   socklen_t len;
 
-  len = sizeof(struct sockaddr);
-  client_desc_ = accept(server_desc_, (struct sockaddr *) &h_addr_, &len);
+  len = sizeof(client_addr);
+  int32 client_desc = accept(server_desc_, (struct sockaddr *) &client_addr, &len);
+  if (client_desc == -1) {
+    KALDI_WARN << "Failed to accept connection.";
+    return NULL;
+  }
 
   struct sockaddr_storage addr;
   char ipstr[20];
 
   len = sizeof addr;
-  getpeername(client_desc_, (struct sockaddr *) &addr, &len);
+  getpeername(client_desc, (struct sockaddr *) &addr, &len);
 
   struct sockaddr_in *s = (struct sockaddr_in *) &addr;
   inet_ntop(AF_INET, &s->sin_addr, ipstr, sizeof ipstr);
 
+  KALDI_LOG << "Accepted connection from: " << ipstr;
+
+  return new TcpConnection(client_desc, read_timeout_);
+}
+
+TcpConnection::TcpConnection(int32 client_desc, int read_timeout) {
+  client_desc_ = client_desc;
+  samp_buf_ = NULL;
+  buf_len_ = 0;
+  has_read_ = 0;
   client_set_[0].fd = client_desc_;
   client_set_[0].events = POLLIN;
+  read_timeout_ = read_timeout;
+}
 
-  KALDI_LOG << "Accepted connection from: " << ipstr;
-
-  return client_desc_;
+TcpConnection::~TcpConnection() {
+  Disconnect();
+  delete[] samp_buf_;
 }
 
-bool TcpServer::ReadChunk(size_t len) {
+bool TcpConnection::ReadChunk(size_t len) {
   if (buf_len_ != len) {
     buf_len_ = len;
     delete[] samp_buf_;
@@ -648,7 +819,7 @@ bool TcpServer::ReadChunk(size_t len) {
   return has_read_ > 0;
 }
 
-Vector<BaseFloat> TcpServer::GetChunk() {
+Vector<BaseFloat> TcpConnection::GetChunk() {
   Vector<BaseFloat> buf;
 
   buf.Resize(static_cast<MatrixIndexT>(has_read_));
@@ -659,7 +830,7 @@ Vector<BaseFloat> TcpServer::GetChunk() {
   return buf;
 }
 
-bool TcpServer::Write(const std::string &msg) {
+bool TcpConnection::Write(const std::string &msg) {
 
   const char *p = msg.c_str();
   size_t to_write = msg.size();
@@ -676,13 +847,13 @@ bool TcpServer::Write(const std::string &msg) {
   return true;
 }
 
-bool TcpServer::WriteLn(const nlohmann::json &msg, const std::string &eol) {
+bool TcpConnection::WriteLn(const nlohmann::json &msg, const std::string &eol) {
   if (Write(msg))
     return Write(eol);
   else return false;
 }
 
-void TcpServer::Disconnect() {
+void TcpConnection::Disconnect() {
   if (client_desc_ != -1) {
     close(client_desc_);
     client_desc_ = -1;
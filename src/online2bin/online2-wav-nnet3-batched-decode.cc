@@ -0,0 +1,199 @@
+// online2bin/online2-wav-nnet3-batched-decode.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "feat/wave-reader.h"
+#include "online2/online-nnet3-batched-decoding.h"
+#include "fstext/fstext-lib.h"
+#include "lat/lattice-functions.h"
+#include "nnet3/nnet-utils.h"
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    using namespace fst;
+
+    typedef kaldi::int32 int32;
+    typedef kaldi::int64 int64;
+
+    const char *usage =
+        "Reads in wav file(s) and simulates online decoding with neural nets\n"
+        "(nnet3 setup) of many utterances at once, on CPU, with the batched\n"
+        "decoder (like batched-wav-nnet3-cuda-online, but without a GPU).\n"
+        "The utterances are fed to the decoder in chunks, up to\n"
+        "--num-channels of them at a time.  The output is the best path of\n"
+        "each utterance, as a linear lattice.\n"
+        "Note: some configuration values and inputs are set via config\n"
+        "files whose filenames are passed as options\n"
+        "\n"
+        "Usage: online2-wav-nnet3-batched-decode [options] <nnet3-in> "
+        "<fst-in> <wav-rspecifier> <lattice-wspecifier>\n";
+
+    std::string word_syms_rxfilename;
+    BaseFloat chunk_length_secs = 0.18;
+    BatchedThreadedNnet3CpuOnlinePipelineConfig pipeline_config;
+
+    ParseOptions po(usage);
+    po.Register("word-symbol-table", &word_syms_rxfilename,
+                "Symbol table for words [for debug output]");
+    po.Register("chunk-length", &chunk_length_secs,
+                "Length of chunk size in seconds, that we process.");
+    pipeline_config.Register(&po);
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() != 4) {
+      po.PrintUsage();
+      return 1;
+    }
+
+    std::string nnet3_rxfilename = po.GetArg(1),
+        fst_rxfilename = po.GetArg(2),
+        wav_rspecifier = po.GetArg(3),
+        clat_wspecifier = po.GetArg(4);
+
+    TransitionModel trans_model;
+    nnet3::AmNnetSimple am_nnet;
+    {
+      bool binary;
+      Input ki(nnet3_rxfilename, &binary);
+      trans_model.Read(ki.Stream(), binary);
+      am_nnet.Read(ki.Stream(), binary);
+      SetBatchnormTestMode(true, &(am_nnet.GetNnet()));
+      SetDropoutTestMode(true, &(am_nnet.GetNnet()));
+      nnet3::CollapseModel(nnet3::CollapseModelConfig(), &(am_nnet.GetNnet()));
+    }
+
+    fst::Fst<fst::StdArc> *decode_fst = ReadFstKaldiGeneric(fst_rxfilename);
+    // The pipeline makes its own copy of the graph.
+    BatchedThreadedNnet3CpuOnlinePipeline pipeline(pipeline_config,
+                                                   *decode_fst, &am_nnet,
+                                                   trans_model);
+    delete decode_fst;
+
+    fst::SymbolTable *word_syms = NULL;
+    if (word_syms_rxfilename != "")
+      if (!(word_syms = fst::SymbolTable::ReadText(word_syms_rxfilename)))
+        KALDI_ERR << "Could not read symbol table from file "
+                  << word_syms_rxfilename;
+
+    SequentialTableReader<WaveHolder> wav_reader(wav_rspecifier);
+    CompactLatticeWriter clat_writer(clat_wspecifier);
+
+    BaseFloat samp_freq = pipeline.GetModelFrequency();
+    int32 chunk_length = int32(samp_freq * chunk_length_secs);
+    if (chunk_length <= 0)
+      KALDI_ERR << "--chunk-length must be positive";
+
+    // The utterances being decoded.
+    typedef BatchedThreadedNnet3CpuOnlinePipeline::CorrelationID CorrelationID;
+    struct Stream {
+      CorrelationID corr_id;
+      std::string utt;
+      Vector<BaseFloat> wave;
+      int32 offset;
+    };
+    std::vector<Stream*> streams;
+    CorrelationID next_corr_id = 0;
+    int32 num_done = 0, num_fail = 0;
+    double tot_audio = 0.0;
+    Timer timer;
+
+    while (!wav_reader.Done() || !streams.empty()) {
+      // Start as many new utterances as there are free channels.
+      while (!wav_reader.Done() && pipeline.TryInitCorrID(next_corr_id)) {
+        Stream *stream = new Stream();
+        stream->corr_id = next_corr_id;
+        stream->utt = wav_reader.Key();
+        const WaveData &wave_data = wav_reader.Value();
+        if (wave_data.SampFreq() != samp_freq)
+          KALDI_ERR << "Sampling frequency mismatch, expected " << samp_freq
+                    << ", got " << wave_data.SampFreq();
+        // Use only the first channel.
+        stream->wave = wave_data.Data().Row(0);
+        stream->offset = 0;
+        tot_audio += wave_data.Duration();
+        std::string utt = stream->utt;
+        pipeline.SetLatticeCallback(
+            next_corr_id,
+            [&clat_writer, &num_done, &num_fail, word_syms, utt]
+            (CompactLattice &clat) {
+              if (clat.NumStates() == 0) {
+                KALDI_WARN << "Decoding failed for utterance " << utt;
+                num_fail++;
+                return;
+              }
+              if (word_syms != NULL) {
+                Lattice best_path;
+                ConvertLattice(clat, &best_path);
+                std::vector<int32> alignment, words;
+                GetLinearSymbolSequence(best_path, &alignment, &words,
+                                        static_cast<LatticeWeight*>(NULL));
+                std::cerr << utt << ' ';
+                for (size_t i = 0; i < words.size(); i++)
+                  std::cerr << word_syms->Find(words[i]) << ' ';
+                std::cerr << std::endl;
+              }
+              clat_writer.Write(utt, clat);
+              num_done++;
+            });
+        streams.push_back(stream);
+        next_corr_id++;
+        wav_reader.Next();
+      }
+
+      // Send the next chunk of every utterance.
+      std::vector<CorrelationID> corr_ids;
+      std::vector<SubVector<BaseFloat> > wave_samples;
+      std::vector<bool> is_first_chunk, is_last_chunk;
+      for (size_t i = 0; i < streams.size(); i++) {
+        Stream *stream = streams[i];
+        int32 num_samp = std::min(chunk_length,
+                                  stream->wave.Dim() - stream->offset);
+        corr_ids.push_back(stream->corr_id);
+        wave_samples.push_back(SubVector<BaseFloat>(stream->wave,
+                                                    stream->offset,
+                                                    num_samp));
+        is_first_chunk.push_back(stream->offset == 0);
+        stream->offset += num_samp;
+        is_last_chunk.push_back(stream->offset == stream->wave.Dim());
+      }
+      pipeline.DecodeBatch(corr_ids, wave_samples, is_first_chunk,
+                           is_last_chunk);
+
+      // The utterances that were finished have had their callbacks called.
+      size_t num_kept = 0;
+      for (size_t i = 0; i < streams.size(); i++) {
+        if (is_last_chunk[i]) delete streams[i];
+        else streams[num_kept++] = streams[i];
+      }
+      streams.resize(num_kept);
+    }
+
+    double elapsed = timer.Elapsed();
+    KALDI_LOG << "Decoded " << num_done << " utterances, failed for "
+              << num_fail << "; " << tot_audio << " seconds of audio in "
+              << elapsed << " seconds, real-time factor "
+              << (elapsed / tot_audio);
+    delete word_syms;
+    return (num_done != 0 ? 0 : 1);
+  } catch(const std::exception& e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
@@ -0,0 +1,223 @@
+// rnnlm/rnnlm-compute-state-test.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "rnnlm/rnnlm-compute-state.h"
+#include "util/stl-utils.h"
+
+namespace kaldi {
+namespace rnnlm {
+
+// Returns the config of a small RNNLM with embedding dimension 'dim'; it has
+// recurrence with delays of more than one frame, like real RNNLMs.
+static std::string GetRnnlmConfig(int32 dim, bool use_lstm) {
+  std::ostringstream os;
+  os << "input-node name=input dim=" << dim << "\n"
+     << "component name=tdnn1.affine type=NaturalGradientAffineComponent "
+     << "input-dim=" << (2 * dim) << " output-dim=12\n"
+     << "component-node name=tdnn1.affine component=tdnn1.affine "
+     << "input=Append(input, IfDefined(Offset(input, -1)))\n"
+     << "component name=tdnn1.relu type=RectifiedLinearComponent dim=12\n"
+     << "component-node name=tdnn1.relu component=tdnn1.relu "
+     << "input=tdnn1.affine\n";
+  if (use_lstm) {
+    // This is like a 'fast-lstm' layer.
+    int32 cell_dim = 6;
+    os << "component name=lstm2.W_all type=NaturalGradientAffineComponent "
+       << "input-dim=" << (12 + cell_dim) << " output-dim=" << (4 * cell_dim)
+       << "\n"
+       << "component-node name=lstm2.W_all component=lstm2.W_all "
+       << "input=Append(tdnn1.relu, IfDefined(Offset(lstm2.m, -2)))\n"
+       << "component name=lstm2.lstm_nonlin type=LstmNonlinearityComponent "
+       << "cell-dim=" << cell_dim << "\n"
+       << "component-node name=lstm2.lstm_nonlin component=lstm2.lstm_nonlin "
+       << "input=Append(lstm2.W_all, IfDefined(Offset(lstm2.c, -2)))\n"
+       << "dim-range-node name=lstm2.c input-node=lstm2.lstm_nonlin "
+       << "dim-offset=0 dim=" << cell_dim << "\n"
+       << "dim-range-node name=lstm2.m input-node=lstm2.lstm_nonlin "
+       << "dim-offset=" << cell_dim << " dim=" << cell_dim << "\n"
+       << "component name=output.affine type=NaturalGradientAffineComponent "
+       << "input-dim=" << cell_dim << " output-dim=" << dim << "\n"
+       << "component-node name=output.affine component=output.affine "
+       << "input=lstm2.m\n";
+  } else {
+    os << "component name=tdnn2.affine type=NaturalGradientAffineComponent "
+       << "input-dim=24 output-dim=12\n"
+       << "component-node name=tdnn2.affine component=tdnn2.affine "
+       << "input=Append(tdnn1.relu, IfDefined(Offset(tdnn2.tanh, -2)))\n"
+       << "component name=tdnn2.tanh type=TanhComponent dim=12\n"
+       << "component-node name=tdnn2.tanh component=tdnn2.tanh "
+       << "input=tdnn2.affine\n"
+       << "component name=output.affine type=NaturalGradientAffineComponent "
+       << "input-dim=12 output-dim=" << dim << "\n"
+       << "component-node name=output.affine component=output.affine "
+       << "input=tdnn2.tanh\n";
+  }
+  os << "output-node name=output input=output.affine objective=linear\n";
+  return os.str();
+}
+
+static void AssertSameState(const RnnlmComputeState &a,
+                            const RnnlmComputeState &b,
+                            int32 num_words) {
+  for (int32 w = 1; w < num_words; w++)
+    AssertEqual(a.LogProbOfWord(w), b.LogProbOfWord(w), 0.001);
+}
+
+// Checks that RnnlmComputeStateBatcher gives the same results as advancing the
+// states one by one.
+void UnitTestRnnlmComputeStateBatcher() {
+  int32 dim = RandInt(4, 10), num_words = RandInt(5, 40);
+  nnet3::Nnet rnnlm;
+  {
+    std::istringstream is(GetRnnlmConfig(dim, WithProb(0.5)));
+    rnnlm.ReadConfig(is);
+  }
+  CuMatrix<BaseFloat> word_embedding_mat(num_words, dim);
+  word_embedding_mat.SetRandn();
+
+  RnnlmComputeStateComputationOptions opts;
+  opts.bos_index = 1;
+  opts.eos_index = 2;
+  opts.normalize_probs = WithProb(0.5);
+  RnnlmComputeStateInfo info(opts, rnnlm, word_embedding_mat);
+  RnnlmComputeStateBatcher batcher(info, RandInt(1, 8));
+
+  // 'states' are advanced in batches, and 'ref_states' one at a time.
+  std::vector<RnnlmComputeState*> states, ref_states;
+  states.push_back(new RnnlmComputeState(info, opts.bos_index));
+  ref_states.push_back(new RnnlmComputeState(info, opts.bos_index));
+  for (int32 iter = 0; iter < 6; iter++) {
+    std::vector<const RnnlmComputeState*> to_advance;
+    std::vector<int32> parents, words;
+    int32 num_to_advance = RandInt(1, 12);
+    for (int32 i = 0; i < num_to_advance; i++) {
+      int32 parent = RandInt(0, states.size() - 1);
+      parents.push_back(parent);
+      words.push_back(RandInt(1, num_words - 1));
+      to_advance.push_back(states[parent]);
+    }
+    std::vector<RnnlmComputeState*> successors;
+    batcher.GetSuccessorStates(to_advance, words, &successors);
+    KALDI_ASSERT(successors.size() == to_advance.size());
+    for (int32 i = 0; i < num_to_advance; i++) {
+      states.push_back(successors[i]);
+      ref_states.push_back(
+          ref_states[parents[i]]->GetSuccessorState(words[i]));
+    }
+  }
+  for (size_t i = 0; i < states.size(); i++)
+    AssertSameState(*(states[i]), *(ref_states[i]), num_words);
+  DeletePointers(&states);
+  DeletePointers(&ref_states);
+}
+
+// Checks that the approximate normalizer from InitApproximateNormalization()
+// is, on average, close to the exact one.
+void UnitTestRnnlmApproximateNormalization() {
+  int32 dim = RandInt(4, 10), num_words = RandInt(300, 500);
+  nnet3::Nnet rnnlm;
+  {
+    std::istringstream is(GetRnnlmConfig(dim, false));
+    rnnlm.ReadConfig(is);
+  }
+  CuMatrix<BaseFloat> word_embedding_mat(num_words, dim);
+  word_embedding_mat.SetRandn();
+  word_embedding_mat.Scale(0.3);
+  CuMatrix<BaseFloat> predicted(5, dim);
+  predicted.SetRandn();
+  predicted.Scale(0.3);
+
+  RnnlmComputeStateComputationOptions opts;
+  opts.bos_index = 1;
+  opts.eos_index = 2;
+  opts.normalize_probs = true;
+  opts.normalization_shortlist = RandInt(0, 20);
+  opts.normalization_samples = RandInt(20, 50);
+  // Zipfian unigram distribution, with a couple of words that never occur
+  // (these are always summed exactly).
+  std::vector<BaseFloat> unigram_probs(num_words, 0.0);
+  double total = 0.0;
+  for (int32 w = 1; w < num_words; w++)
+    if (w % 100 != 0)
+      total += (unigram_probs[w] = 1.0 / w);
+  for (int32 w = 0; w < num_words; w++)
+    unigram_probs[w] /= total;
+
+  RnnlmComputeStateInfo exact_info(opts, rnnlm, word_embedding_mat);
+  CuVector<BaseFloat> exact(predicted.NumRows());
+  exact_info.ComputeLogNormalizers(predicted, &exact);
+  exact.ApplyExp();
+
+  // The approximate normalizer is an unbiased estimate of the exact one, so
+  // we check that the average over 'num_repeats' draws is within a few
+  // standard errors of it, with the standard error estimated from the sample
+  // variance.  (The small relative term allows for rounding, for when the
+  // normalization is done exactly).
+  RnnlmComputeStateInfo info(opts, rnnlm, word_embedding_mat);
+  int32 num_repeats = 50, num_rows = predicted.NumRows();
+  Vector<double> sum(num_rows), sumsq(num_rows);
+  for (int32 i = 0; i < num_repeats; i++) {
+    info.InitApproximateNormalization(unigram_probs);
+    KALDI_ASSERT(info.normalization_embeddings.NumRows() <
+                 opts.normalization_shortlist + opts.normalization_samples +
+                 num_words / 100 + 1);
+    CuVector<BaseFloat> approx(num_rows);
+    info.ComputeLogNormalizers(predicted, &approx);
+    approx.ApplyExp();
+    Vector<double> approx_cpu(approx);
+    sum.AddVec(1.0, approx_cpu);
+    sumsq.AddVec2(1.0, approx_cpu);
+  }
+  Vector<BaseFloat> exact_cpu(exact);
+  for (int32 r = 0; r < num_rows; r++) {
+    double mean = sum(r) / num_repeats,
+        variance = std::max(0.0, sumsq(r) / num_repeats - mean * mean) *
+            num_repeats / (num_repeats - 1),
+        std_error = std::sqrt(variance / num_repeats);
+    KALDI_LOG << "Exact normalizer is " << exact_cpu(r)
+              << ", average approximate one is " << mean
+              << " with standard error " << std_error;
+    KALDI_ASSERT(std::abs(mean - exact_cpu(r)) <=
+                 5.0 * std_error + 1.0e-03 * exact_cpu(r));
+  }
+}
+
+}  // namespace rnnlm
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  using namespace kaldi::rnnlm;
+  // The approximate-normalization test is statistical; with a fixed seed it
+  // can't fail intermittently.
+  srand(100);
+  for (int32 loop = 0; loop < 2; loop++) {
+#if HAVE_CUDA == 1
+    if (loop == 0)
+      CuDevice::Instantiate().SelectGpuId("no");
+    else
+      CuDevice::Instantiate().SelectGpuId("optional");
+#endif
+    for (int32 i = 0; i < 10; i++)
+      UnitTestRnnlmComputeStateBatcher();
+    UnitTestRnnlmApproximateNormalization();
+  }
+  KALDI_LOG << "Tests succeeded.";
+  return 0;
+}
@@ -19,7 +19,10 @@
 // See the Apache 2 License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <numeric>
 #include "rnnlm/rnnlm-compute-state.h"
+#include "rnnlm/sampler.h"
 #include "nnet3/nnet-utils.h"
 #include "nnet3/nnet-compile-looped.h"
 
@@ -70,6 +73,93 @@ RnnlmComputeStateInfo::RnnlmComputeStateInfo(
   }
 }
 
+void RnnlmComputeStateInfo::InitApproximateNormalization(
+    const std::vector<BaseFloat> &unigram_probs) {
+  int32 num_words = word_embedding_mat.NumRows();
+  if (static_cast<int32>(unigram_probs.size()) > num_words)
+    KALDI_ERR << "Unigram distribution has more words ("
+              << unigram_probs.size() << ") than the word embedding matrix ("
+              << num_words << ")";
+  std::vector<BaseFloat> probs(unigram_probs);
+  probs.resize(num_words, 0.0);
+  probs[0] = 0.0;  // <eps> is excluded from the normalizer.
+  double total = std::accumulate(probs.begin(), probs.end(), 0.0);
+  if (total <= 0.0)
+    KALDI_ERR << "Unigram distribution is empty";
+  for (int32 w = 0; w < num_words; w++)
+    probs[w] /= total;
+
+  int32 shortlist_size = opts.normalization_shortlist,
+      num_samples = opts.normalization_samples;
+  KALDI_ASSERT(shortlist_size >= 0 && num_samples >= 0);
+  std::vector<std::pair<BaseFloat, int32> > sorted_words;
+  for (int32 w = 1; w < num_words; w++)
+    sorted_words.push_back(std::pair<BaseFloat, int32>(-probs[w], w));
+  std::sort(sorted_words.begin(), sorted_words.end());
+  // The words we always sum over: the shortlist, and words that can never be
+  // sampled.
+  std::vector<int32> shortlist;
+  for (size_t i = 0; i < sorted_words.size(); i++)
+    if (static_cast<int32>(i) < shortlist_size || sorted_words[i].first == 0.0)
+      shortlist.push_back(sorted_words[i].second);
+  std::sort(shortlist.begin(), shortlist.end());
+  int32 num_words_to_sample = shortlist.size() + num_samples;
+  if (num_words_to_sample >= (num_words - 1) / 2) {
+    KALDI_LOG << "Normalization shortlist and sample would cover a large part "
+              << "of the vocabulary; normalizing exactly.";
+    return;
+  }
+
+  std::vector<std::pair<int32, BaseFloat> > sample;
+  if (num_samples == 0) {
+    for (size_t i = 0; i < shortlist.size(); i++)
+      sample.push_back(std::pair<int32, BaseFloat>(shortlist[i], 1.0));
+  } else {
+    Sampler sampler(probs);
+    std::vector<std::pair<int32, BaseFloat> > higher_order_probs;
+    sampler.SampleWords(num_words_to_sample, 1.0, higher_order_probs,
+                        shortlist, &sample);
+  }
+  std::vector<int32> rows;
+  Vector<BaseFloat> log_weights(sample.size());
+  for (size_t i = 0; i < sample.size(); i++) {
+    KALDI_ASSERT(sample[i].first > 0 && sample[i].second > 0.0);
+    rows.push_back(sample[i].first);
+    log_weights(i) = -Log(sample[i].second);
+  }
+  CuArray<int32> cu_rows(rows);
+  normalization_embeddings.Resize(rows.size(), word_embedding_mat.NumCols(),
+                                  kUndefined);
+  normalization_embeddings.CopyRows(word_embedding_mat, cu_rows);
+  normalization_log_weights = log_weights;
+  KALDI_LOG << "Approximating the RNNLM normalizer with " << shortlist.size()
+            << " shortlisted and " << (rows.size() - shortlist.size())
+            << " sampled words, out of " << (num_words - 1);
+}
+
+void RnnlmComputeStateInfo::ComputeLogNormalizers(
+    const CuMatrixBase<BaseFloat> &predicted_embeddings,
+    CuVectorBase<BaseFloat> *log_normalizers) const {
+  int32 num_rows = predicted_embeddings.NumRows();
+  KALDI_ASSERT(log_normalizers->Dim() == num_rows);
+  CuMatrix<BaseFloat> probs;
+  if (normalization_embeddings.NumRows() == 0) {
+    // We exclude the <eps> symbol, which is always 0.
+    int32 num_words = word_embedding_mat.NumRows();
+    probs.Resize(num_rows, num_words - 1, kUndefined);
+    probs.AddMatMat(1.0, predicted_embeddings, kNoTrans,
+                    word_embedding_mat.RowRange(1, num_words - 1), kTrans, 0.0);
+  } else {
+    probs.Resize(num_rows, normalization_embeddings.NumRows(), kUndefined);
+    probs.AddMatMat(1.0, predicted_embeddings, kNoTrans,
+                    normalization_embeddings, kTrans, 0.0);
+    probs.AddVecToRows(1.0, normalization_log_weights);
+  }
+  probs.ApplyExp();
+  log_normalizers->AddColSumMat(1.0, probs, 0.0);
+  log_normalizers->ApplyLog();
+}
+
 RnnlmComputeState::RnnlmComputeState(const RnnlmComputeStateInfo &info,
                                      int32 bos_index) :
     info_(info),
@@ -97,16 +187,10 @@ void RnnlmComputeState::AddWord(int32 word_index) {
   previous_word_ = word_index;
   AdvanceChunk();
 
-  const CuMatrix<BaseFloat> &word_embedding_mat = info_.word_embedding_mat;
   if (info_.opts.normalize_probs) {
-    CuVector<BaseFloat> log_probs(info_.word_embedding_mat.NumRows());
-
-    log_probs.AddMatVec(1.0, word_embedding_mat, kNoTrans,
-                        predicted_word_embedding_->Row(0), 0.0);
-    log_probs.ApplyExp();
-
-    // We excluding the <eps> symbol which is always 0.
-    normalization_factor_ = log(log_probs.Range(1, log_probs.Dim() - 1).Sum());
+    CuVector<BaseFloat> log_normalizer(1);
+    info_.ComputeLogNormalizers(*predicted_word_embedding_, &log_normalizer);
+    normalization_factor_ = log_normalizer(0);
   }
 }
 
@@ -157,5 +241,289 @@ void RnnlmComputeState::AdvanceChunk() {
   }
 }
 
+
+RnnlmComputeStateBatcher::RnnlmComputeStateBatcher(
+    const RnnlmComputeStateInfo &info, int32 max_batch_size):
+    info_(info), max_batch_size_(max_batch_size), usable_(true),
+    single_loop_pc_(-1) {
+  KALDI_ASSERT(max_batch_size > 0);
+  Init();
+}
+
+RnnlmComputeStateBatcher::~RnnlmComputeStateBatcher() {
+  for (size_t i = 0; i < batch_computations_.size(); i++)
+    delete batch_computations_[i];
+}
+
+void RnnlmComputeStateBatcher::Init() {
+  // Advance a state until its program counter repeats, which tells us where
+  // the repeated part of the looped computation is.
+  RnnlmComputeState state(info_, info_.opts.bos_index);
+  int32 prev_pc = state.computer_.ProgramCounter();
+  for (int32 i = 0; i < 10; i++) {
+    state.AddWord(info_.opts.bos_index);
+    int32 pc = state.computer_.ProgramCounter();
+    if (pc == prev_pc) {
+      single_loop_pc_ = pc;
+      break;
+    }
+    prev_pc = pc;
+  }
+  if (single_loop_pc_ < 0) {
+    KALDI_WARN << "RNNLM computation does not seem to be looped; states will "
+               << "be evaluated one at a time.";
+    usable_ = false;
+    return;
+  }
+  int32 num_matrices = info_.computation.matrices.size();
+  for (int32 m = 1; m < num_matrices; m++)
+    if (state.computer_.GetMatrix(m).NumRows() != 0)
+      live_matrices_.push_back(m);
+}
+
+RnnlmComputeStateBatcher::BatchComputation*
+RnnlmComputeStateBatcher::GetBatchComputation(int32 num_sequences) {
+  KALDI_ASSERT(num_sequences > 1 && num_sequences <= max_batch_size_);
+  if (batch_computations_.size() <= static_cast<size_t>(num_sequences))
+    batch_computations_.resize(num_sequences + 1, NULL);
+  if (batch_computations_[num_sequences] == NULL) {
+    BatchComputation *bc = new BatchComputation();
+    bc->num_sequences = num_sequences;
+    if (!InitBatchComputation(bc)) {
+      delete bc;
+      KALDI_WARN << "The structure of the batched RNNLM computation was not "
+                 << "as expected; states will be evaluated one at a time.";
+      usable_ = false;
+      return NULL;
+    }
+    batch_computations_[num_sequences] = bc;
+  }
+  return batch_computations_[num_sequences];
+}
+
+bool RnnlmComputeStateBatcher::InitBatchComputation(BatchComputation *bc) {
+  const nnet3::Nnet &rnnlm = info_.rnnlm;
+  const nnet3::NnetComputation &single = info_.computation;
+  int32 num_sequences = bc->num_sequences;
+  nnet3::ComputationRequest request1, request2, request3;
+  CreateLoopedComputationRequestSimple(rnnlm,
+                                       1, // num_frames
+                                       1, // frame_subsampling_factor
+                                       1, // ivector_period
+                                       0, // extra_left_context_initial
+                                       0, // extra_right_context
+                                       num_sequences,
+                                       &request1, &request2, &request3);
+  CompileLooped(rnnlm, info_.opts.optimize_config, request1, request2,
+                request3, &(bc->computation));
+  bc->computation.ComputeCudaIndexes();
+  const nnet3::NnetComputation &batched = bc->computation;
+
+  // Work out which rows of the input and output belong to which sequence.
+  // (The rows of the input and output matrices are in the same order as the
+  // indexes in the request.)
+  const std::vector<nnet3::Index> &input_indexes = request3.inputs[0].indexes,
+      &output_indexes = request3.outputs[0].indexes;
+  if (static_cast<int32>(input_indexes.size()) != num_sequences ||
+      static_cast<int32>(output_indexes.size()) != num_sequences)
+    return false;
+  bc->input_rows.resize(num_sequences, -1);
+  std::vector<int32> output_rows(num_sequences, -1);
+  for (int32 i = 0; i < num_sequences; i++) {
+    bc->input_rows[input_indexes[i].n] = i;
+    output_rows[output_indexes[i].n] = i;
+  }
+  for (int32 n = 0; n < num_sequences; n++)
+    if (bc->input_rows[n] < 0 || output_rows[n] < 0)
+      return false;
+  bc->output_rows.CopyFromVec(output_rows);
+
+  // Run the batched computer until it reaches the repeated part of the
+  // computation.
+  bc->computer = new nnet3::NnetComputer(info_.opts.compute_config,
+                                         bc->computation, rnnlm, NULL);
+  int32 loop_pc = -1, prev_pc = bc->computer->ProgramCounter();
+  for (int32 i = 0; i < 10; i++) {
+    CuMatrix<BaseFloat> input(num_sequences,
+                              info_.word_embedding_mat.NumCols(), kUndefined);
+    input.CopyRowsFromVec(info_.word_embedding_mat.Row(info_.opts.bos_index));
+    bc->computer->AcceptInput("input", &input);
+    bc->computer->Run();
+    bc->computer->GetOutput("output");
+    int32 pc = bc->computer->ProgramCounter();
+    if (pc == prev_pc) {
+      loop_pc = pc;
+      break;
+    }
+    prev_pc = pc;
+  }
+  if (loop_pc < 0 || batched.matrices.size() != single.matrices.size() ||
+      batched.matrix_debug_info.size() != single.matrices.size() ||
+      single.matrix_debug_info.size() != single.matrices.size())
+    return false;
+
+  // Check that the same matrices are allocated between chunks as for a single
+  // sequence.
+  int32 num_matrices = single.matrices.size();
+  std::vector<bool> is_live(num_matrices, false);
+  for (size_t i = 0; i < live_matrices_.size(); i++)
+    is_live[live_matrices_[i]] = true;
+  for (int32 m = 1; m < num_matrices; m++)
+    if ((bc->computer->GetMatrix(m).NumRows() != 0) != is_live[m])
+      return false;
+
+  typedef unordered_map<nnet3::Cindex, int32, nnet3::CindexHasher> MapType;
+  for (size_t i = 0; i < live_matrices_.size(); i++) {
+    int32 m = live_matrices_[i];
+    const std::vector<nnet3::Cindex>
+        &single_cindexes = single.matrix_debug_info[m].cindexes,
+        &batched_cindexes = batched.matrix_debug_info[m].cindexes;
+    int32 num_rows = single.matrices[m].num_rows;
+    if (static_cast<int32>(single_cindexes.size()) != num_rows ||
+        static_cast<int32>(batched_cindexes.size()) != num_rows * num_sequences ||
+        single.matrices[m].num_cols != batched.matrices[m].num_cols)
+      return false;
+    // Maps the cindexes of the single-sequence matrix (with n set to zero) to
+    // their row.
+    MapType single_rows;
+    for (int32 r = 0; r < num_rows; r++) {
+      nnet3::Cindex cindex = single_cindexes[r];
+      if (cindex.second.n != 0 || !single_rows.insert(
+              std::pair<nnet3::Cindex, int32>(cindex, r)).second)
+        return false;
+    }
+    std::vector<int32> gather(num_rows * num_sequences, -1),
+        scatter(num_rows * num_sequences, -1);
+    for (int32 row = 0; row < num_rows * num_sequences; row++) {
+      nnet3::Cindex cindex = batched_cindexes[row];
+      int32 n = cindex.second.n;
+      cindex.second.n = 0;
+      MapType::const_iterator iter = single_rows.find(cindex);
+      if (n < 0 || n >= num_sequences || iter == single_rows.end())
+        return false;
+      int32 stacked_row = n * num_rows + iter->second;
+      if (scatter[stacked_row] != -1)
+        return false;
+      gather[row] = stacked_row;
+      scatter[stacked_row] = row;
+    }
+    bc->gather_indexes.push_back(CuArray<int32>(gather));
+    bc->scatter_indexes.push_back(CuArray<int32>(scatter));
+  }
+  return true;
+}
+
+void RnnlmComputeStateBatcher::GetSuccessorStates(
+    const std::vector<const RnnlmComputeState*> &states,
+    const std::vector<int32> &next_words,
+    std::vector<RnnlmComputeState*> *successors) {
+  KALDI_ASSERT(states.size() == next_words.size());
+  successors->resize(states.size());
+  std::vector<int32> batch;
+  for (size_t i = 0; i < states.size(); i++) {
+    KALDI_ASSERT(&(states[i]->info_) == &info_);
+    if (usable_ && states[i]->computer_.ProgramCounter() == single_loop_pc_)
+      batch.push_back(i);
+    else
+      (*successors)[i] = states[i]->GetSuccessorState(next_words[i]);
+  }
+  for (size_t start = 0; start < batch.size(); start += max_batch_size_) {
+    size_t end = std::min(batch.size(), start + max_batch_size_);
+    std::vector<int32> indexes(batch.begin() + start, batch.begin() + end);
+    if (indexes.size() > 1 && usable_) {
+      AdvanceBatch(states, next_words, indexes, successors);
+    } else {
+      for (size_t i = 0; i < indexes.size(); i++)
+        (*successors)[indexes[i]] =
+            states[indexes[i]]->GetSuccessorState(next_words[indexes[i]]);
+    }
+  }
+}
+
+void RnnlmComputeStateBatcher::AdvanceBatch(
+    const std::vector<const RnnlmComputeState*> &states,
+    const std::vector<int32> &next_words,
+    const std::vector<int32> &indexes,
+    std::vector<RnnlmComputeState*> *successors) {
+  int32 num_states = indexes.size();
+  // We round the batch size up to a power of two (but not above
+  // max_batch_size_), so we don't have to compile too many computations; the
+  // extra sequences are copies of the first one.
+  int32 num_sequences = 2;
+  while (num_sequences < num_states)
+    num_sequences *= 2;
+  num_sequences = std::min(num_sequences, max_batch_size_);
+  BatchComputation *bc = GetBatchComputation(num_sequences);
+  if (bc == NULL) {
+    for (int32 i = 0; i < num_states; i++)
+      (*successors)[indexes[i]] =
+          states[indexes[i]]->GetSuccessorState(next_words[indexes[i]]);
+    return;
+  }
+  nnet3::NnetComputer *computer = bc->computer;
+  const nnet3::NnetComputation &single = info_.computation;
+
+  // Copy the states into the batched computer.
+  for (size_t i = 0; i < live_matrices_.size(); i++) {
+    int32 m = live_matrices_[i], num_rows = single.matrices[m].num_rows;
+    CuMatrix<BaseFloat> stacked(num_rows * num_sequences,
+                                single.matrices[m].num_cols, kUndefined);
+    for (int32 n = 0; n < num_sequences; n++) {
+      const RnnlmComputeState *state = states[indexes[n < num_states ? n : 0]];
+      stacked.RowRange(n * num_rows, num_rows).CopyFromMat(
+          state->computer_.GetMatrix(m));
+    }
+    computer->GetMatrix(m).CopyRows(stacked, bc->gather_indexes[i]);
+  }
+
+  std::vector<int32> input_words(num_sequences);
+  for (int32 n = 0; n < num_sequences; n++) {
+    int32 word = next_words[indexes[n < num_states ? n : 0]];
+    KALDI_ASSERT(word > 0 && word < info_.word_embedding_mat.NumRows());
+    input_words[bc->input_rows[n]] = word;
+  }
+  CuArray<int32> cu_input_words(input_words);
+  CuMatrix<BaseFloat> input(num_sequences, info_.word_embedding_mat.NumCols(),
+                            kUndefined);
+  input.CopyRows(info_.word_embedding_mat, cu_input_words);
+  computer->AcceptInput("input", &input);
+  computer->Run();
+  const CuMatrixBase<BaseFloat> &output = computer->GetOutput("output");
+
+  // Create the successor states and copy the new recurrent state into them.
+  for (int32 n = 0; n < num_states; n++) {
+    RnnlmComputeState *state = new RnnlmComputeState(*(states[indexes[n]]));
+    state->previous_word_ = next_words[indexes[n]];
+    (*successors)[indexes[n]] = state;
+  }
+  for (size_t i = 0; i < live_matrices_.size(); i++) {
+    int32 m = live_matrices_[i], num_rows = single.matrices[m].num_rows;
+    CuMatrix<BaseFloat> stacked(num_rows * num_sequences,
+                                single.matrices[m].num_cols, kUndefined);
+    stacked.CopyRows(computer->GetMatrix(m), bc->scatter_indexes[i]);
+    for (int32 n = 0; n < num_states; n++)
+      (*successors)[indexes[n]]->computer_.GetMatrix(m).CopyFromMat(
+          stacked.RowRange(n * num_rows, num_rows));
+  }
+  for (int32 n = 0; n < num_states; n++) {
+    RnnlmComputeState *state = (*successors)[indexes[n]];
+    state->predicted_word_embedding_ = &(state->computer_.GetOutput("output"));
+  }
+
+  if (info_.opts.normalize_probs) {
+    // Compute the normalizers of all the states with one matrix
+    // multiplication.
+    CuMatrix<BaseFloat> predicted(num_sequences, output.NumCols(), kUndefined);
+    predicted.CopyRows(output, bc->output_rows);
+    CuVector<BaseFloat> log_normalizers(num_states);
+    info_.ComputeLogNormalizers(predicted.RowRange(0, num_states),
+                                &log_normalizers);
+    Vector<BaseFloat> log_normalizers_cpu(log_normalizers);
+    for (int32 n = 0; n < num_states; n++)
+      (*successors)[indexes[n]]->normalization_factor_ =
+          log_normalizers_cpu(n);
+  }
+}
+
 } // namespace rnnlm
 } // namespace kaldi
@@ -41,6 +41,10 @@ struct RnnlmComputeStateComputationOptions {
   int32 eos_index;
   // This is not needed for computation; included only for ease of scripting.
   int32 brk_index;
+  // These are only used if normalize_probs is true and
+  // RnnlmComputeStateInfo::InitApproximateNormalization() has been called.
+  int32 normalization_shortlist;
+  int32 normalization_samples;
   nnet3::NnetOptimizeOptions optimize_config;
   nnet3::NnetComputeOptions compute_config;
   RnnlmComputeStateComputationOptions():
@@ -48,7 +52,9 @@ struct RnnlmComputeStateComputationOptions {
       normalize_probs(false),
       bos_index(-1),
       eos_index(-1),
-      brk_index(-1)
+      brk_index(-1),
+      normalization_shortlist(2000),
+      normalization_samples(2000)
       { }
 
   void Register(OptionsItf *opts) {
@@ -64,6 +70,15 @@ struct RnnlmComputeStateComputationOptions {
     opts->Register("brk-symbol", &brk_index, "Index in wordlist representing "
                    "the break symbol. It is not needed in the computation "
                    "and we are including it for ease of scripting");
+    opts->Register("normalization-shortlist", &normalization_shortlist,
+                   "If the normalizer is approximated (see --sampling-lm), "
+                   "the number of most frequent words whose probabilities "
+                   "are always summed exactly.");
+    opts->Register("normalization-samples", &normalization_samples,
+                   "If the normalizer is approximated (see --sampling-lm), "
+                   "the number of words, in addition to the shortlist, that "
+                   "are sampled according to their unigram probabilities to "
+                   "estimate the rest of the normalizer.");
 
     // Register the optimization options with the prefix "optimization".
     ParseOptions optimization_opts("optimization", opts);
@@ -87,12 +102,39 @@ class RnnlmComputeStateInfo  {
       const kaldi::nnet3::Nnet &rnnlm,
       const CuMatrix<BaseFloat> &word_embedding_mat);
 
+  /// Makes the normalizer that is computed if opts.normalize_probs is true
+  /// (the log of the sum over all words of the exp'ed scores) approximate,
+  /// which is much faster for large vocabularies.  'unigram_probs' is
+  /// typically SamplingLm::GetUnigramDistribution(); it may be shorter than
+  /// the vocabulary.  We sum over a fixed set of words: the
+  /// opts.normalization_shortlist most frequent words, plus any words with zero
+  /// unigram probability, plus opts.normalization_samples words sampled
+  /// (without replacement) using the class Sampler.  The sampled words' terms
+  /// are divided by their probabilities of being sampled, so the sum is an
+  /// unbiased estimate of the total.  The sample is drawn once here, so the
+  /// same words are used for every state.  If the shortlist and sample would
+  /// cover most of the vocabulary, this does nothing and the normalizer stays
+  /// exact.
+  void InitApproximateNormalization(const std::vector<BaseFloat> &unigram_probs);
+
+  /// Sets (*log_normalizers)(i) to the normalizer for the predicted word
+  /// embedding in row i of 'predicted_embeddings' (this is the exact normalizer
+  /// unless InitApproximateNormalization() was called).
+  void ComputeLogNormalizers(
+      const CuMatrixBase<BaseFloat> &predicted_embeddings,
+      CuVectorBase<BaseFloat> *log_normalizers) const;
+
   const RnnlmComputeStateComputationOptions &opts;
   const kaldi::nnet3::Nnet &rnnlm;
   const CuMatrix<BaseFloat> &word_embedding_mat;
 
   // The compiled, 'looped' computation.
   nnet3::NnetComputation computation;
+
+  // If the normalizer is approximated, the embeddings of the words we sum over
+  // and the logs of the weights of their terms; else empty.
+  CuMatrix<BaseFloat> normalization_embeddings;
+  CuVector<BaseFloat> normalization_log_weights;
 };
 
 /*
@@ -126,6 +168,8 @@ class RnnlmComputeState {
   /// Advance the state of the RNNLM by appending this word to the word sequence.
   void AddWord(int32 word_index);
  private:
+  friend class RnnlmComputeStateBatcher;
+
   /// This function does the computation for the next chunk.
   void AdvanceChunk();
 
@@ -143,6 +187,97 @@ class RnnlmComputeState {
 };
 
 
+/*
+  This class advances many RnnlmComputeStates by one word each in a single
+  minibatched computation.  That is much faster than calling
+  GetSuccessorState() on each of them: each call to that runs its own tiny
+  nnet3 computation, so most of the time goes into per-computation overhead
+  and matrix-vector products.
+
+  For each batch size it compiles a looped computation with that many
+  sequences.  To evaluate a batch, it copies the recurrent state of each
+  RnnlmComputeState (i.e. the matrices that are allocated in its NnetComputer
+  between chunks) into the rows of the batched computer that belong to that
+  sequence, runs one chunk, and copies the rows back out into the successor
+  states.  The rows are matched up using the cindexes in the computations'
+  debug info.  This only works for states whose computation has reached the
+  repeated part of the looped computation (i.e. all states except those within
+  a couple of words of the BOS state); any other states, and all states if the
+  model's computation does not have the structure we expect, are advanced one
+  at a time.  The successor states are exactly the same (up to roundoff) as
+  those you would get from GetSuccessorState().
+
+  This class is not thread-safe.
+*/
+class RnnlmComputeStateBatcher {
+ public:
+  /// 'max_batch_size' is the largest number of states we will evaluate in
+  /// one computation; larger requests will be split up.
+  RnnlmComputeStateBatcher(const RnnlmComputeStateInfo &info,
+                           int32 max_batch_size = 64);
+
+  /// This is equivalent to doing
+  ///  (*successors)[i] = states[i]->GetSuccessorState(next_words[i]);
+  /// for each i, but faster.  The output pointers are owned by the caller.
+  void GetSuccessorStates(const std::vector<const RnnlmComputeState*> &states,
+                          const std::vector<int32> &next_words,
+                          std::vector<RnnlmComputeState*> *successors);
+
+  ~RnnlmComputeStateBatcher();
+ private:
+  struct BatchComputation {
+    int32 num_sequences;
+    nnet3::NnetComputation computation;
+    // A computer for 'computation' that is paused between chunks in the
+    // repeated part of the looped computation; it's reused for each batch.
+    nnet3::NnetComputer *computer;
+    // For each matrix in live_matrices_, maps each row of the batched matrix
+    // to a row of the matrices of the individual states stacked together
+    // (i.e. row n * num_rows + r for row r of sequence n), and the reverse.
+    std::vector<CuArray<int32> > gather_indexes;
+    std::vector<CuArray<int32> > scatter_indexes;
+    // input_rows[n] and output_rows[n] are the rows of the input and output
+    // matrices that belong to sequence n.
+    std::vector<int32> input_rows;
+    CuArray<int32> output_rows;
+    BatchComputation(): num_sequences(0), computer(NULL) { }
+    ~BatchComputation() { delete computer; }
+  };
+
+  // Works out single_loop_pc_ and live_matrices_ (and sets usable_ to false
+  // if the computation is not looped in the way we expect).
+  void Init();
+
+  // Returns the batched computation for 'num_sequences', compiling it if
+  // needed; returns NULL if it was not compatible with the single-sequence
+  // computation.
+  BatchComputation *GetBatchComputation(int32 num_sequences);
+
+  bool InitBatchComputation(BatchComputation *bc);
+
+  // Evaluates the states states[indexes[i]]; indexes.size() must be between
+  // 2 and max_batch_size_.
+  void AdvanceBatch(const std::vector<const RnnlmComputeState*> &states,
+                    const std::vector<int32> &next_words,
+                    const std::vector<int32> &indexes,
+                    std::vector<RnnlmComputeState*> *successors);
+
+  const RnnlmComputeStateInfo &info_;
+  int32 max_batch_size_;
+  // False if we found that batching is not possible for this model.
+  bool usable_;
+  // The program counter of the computer of an RnnlmComputeState once it is in
+  // the repeated part of the looped computation.
+  int32 single_loop_pc_;
+  // The matrices that are allocated between chunks at that point.
+  std::vector<int32> live_matrices_;
+  // Indexed by num_sequences; NULL if not compiled yet.
+  std::vector<BatchComputation*> batch_computations_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(RnnlmComputeStateBatcher);
+};
+
+
 } // namespace rnnlm
 } // namespace kaldi
 
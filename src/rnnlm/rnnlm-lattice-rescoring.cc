@@ -28,31 +28,69 @@
 namespace kaldi {
 namespace rnnlm {
 
+RnnlmComputeStateCache::RnnlmComputeStateCache(size_t capacity):
+    capacity_(capacity), num_lookups_(0), num_hits_(0) {
+  KALDI_ASSERT(capacity > 0);
+}
+
+RnnlmComputeStateCache::~RnnlmComputeStateCache() {
+  if (num_lookups_ > 0)
+    KALDI_VLOG(1) << "RNNLM state cache: " << num_hits_ << " hits out of "
+                  << num_lookups_ << " lookups.";
+}
+
+std::shared_ptr<const RnnlmComputeState> RnnlmComputeStateCache::Lookup(
+    const std::vector<int32> &history, int32 word) {
+  std::vector<int32> key(history);
+  key.push_back(word);
+  std::lock_guard<std::mutex> lock(mutex_);
+  num_lookups_++;
+  MapType::iterator iter = map_.find(key);
+  if (iter == map_.end())
+    return std::shared_ptr<const RnnlmComputeState>();
+  num_hits_++;
+  // Move the entry to the front of the list.
+  entries_.splice(entries_.begin(), entries_, iter->second);
+  return iter->second->second;
+}
+
+void RnnlmComputeStateCache::Insert(
+    const std::vector<int32> &history, int32 word,
+    const std::shared_ptr<const RnnlmComputeState> &state) {
+  std::vector<int32> key(history);
+  key.push_back(word);
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (map_.count(key) != 0)
+    return;  // Another FST added it first.
+  entries_.push_front(EntryType(key, state));
+  map_[key] = entries_.begin();
+  if (entries_.size() > capacity_) {
+    map_.erase(entries_.back().first);
+    entries_.pop_back();
+  }
+}
+
+
 KaldiRnnlmDeterministicFst::~KaldiRnnlmDeterministicFst() {
-  int32 size = state_to_rnnlm_state_.size();
-  for (int32 i = 0; i < size; i++)
-    delete state_to_rnnlm_state_[i];
-  
   state_to_rnnlm_state_.resize(0);
   state_to_wseq_.resize(0);
   wseq_to_state_.clear();
+  prepared_states_.clear();
 }
 
 void KaldiRnnlmDeterministicFst::Clear() {
   // This function is similar to the destructor but we retain the 0-th entries
   // in each map which corresponds to the <bos> state.
-  int32 size = state_to_rnnlm_state_.size();
-  for (int32 i = 1; i < size; i++)
-    delete state_to_rnnlm_state_[i];
-  
   state_to_rnnlm_state_.resize(1);
   state_to_wseq_.resize(1);
   wseq_to_state_.clear();
   wseq_to_state_[state_to_wseq_[0]] = 0;
+  prepared_states_.clear();
 }
 
 KaldiRnnlmDeterministicFst::KaldiRnnlmDeterministicFst(int32 max_ngram_order,
-    const RnnlmComputeStateInfo &info) {
+    const RnnlmComputeStateInfo &info, RnnlmComputeStateCache *cache):
+    batcher_(info), cache_(cache) {
   max_ngram_order_ = max_ngram_order;
   bos_index_ = info.opts.bos_index;
   eos_index_ = info.opts.eos_index;
@@ -60,7 +98,8 @@ KaldiRnnlmDeterministicFst::KaldiRnnlmDeterministicFst(int32 max_ngram_order,
   std::vector<Label> bos_seq;
   bos_seq.push_back(bos_index_);
   state_to_wseq_.push_back(bos_seq);
-  RnnlmComputeState *decodable_rnnlm = new RnnlmComputeState(info, bos_index_);
+  std::shared_ptr<const RnnlmComputeState> decodable_rnnlm(
+      new RnnlmComputeState(info, bos_index_));
   wseq_to_state_[bos_seq] = 0;
   start_state_ = 0;
 
@@ -71,27 +110,33 @@ fst::StdArc::Weight KaldiRnnlmDeterministicFst::Final(StateId s) {
   /// At this point, we have created the state.
   KALDI_ASSERT(static_cast<size_t>(s) < state_to_wseq_.size());
 
-  RnnlmComputeState* rnn = state_to_rnnlm_state_[s];
+  const RnnlmComputeState *rnn = state_to_rnnlm_state_[s].get();
   return Weight(-rnn->LogProbOfWord(eos_index_));
 }
 
+void KaldiRnnlmDeterministicFst::GetNextWordSeq(
+    StateId s, Label ilabel, std::vector<Label> *word_seq) const {
+  *word_seq = state_to_wseq_[s];
+  word_seq->push_back(ilabel);
+  if (max_ngram_order_ > 0) {
+    while (word_seq->size() >= max_ngram_order_) {
+      /// History state has at most <max_ngram_order_> - 1 words in the state.
+      word_seq->erase(word_seq->begin(), word_seq->begin() + 1);
+    }
+  }
+}
+
 bool KaldiRnnlmDeterministicFst::GetArc(StateId s, Label ilabel,
                                         fst::StdArc *oarc) {
   /// At this point, we have created the state.
   KALDI_ASSERT(static_cast<size_t>(s) < state_to_wseq_.size());
 
-  std::vector<Label> word_seq = state_to_wseq_[s];
-  const RnnlmComputeState* rnnlm = state_to_rnnlm_state_[s];
+  const RnnlmComputeState* rnnlm = state_to_rnnlm_state_[s].get();
 
   BaseFloat logprob = rnnlm->LogProbOfWord(ilabel);
 
-  word_seq.push_back(ilabel);
-  if (max_ngram_order_ > 0) {
-    while (word_seq.size() >= max_ngram_order_) {
-      /// History state has at most <max_ngram_order_> - 1 words in the state.
-      word_seq.erase(word_seq.begin(), word_seq.begin() + 1);
-    }
-  }
+  std::vector<Label> word_seq;
+  GetNextWordSeq(s, ilabel, &word_seq);
 
   std::pair<const std::vector<Label>, StateId> wseq_state_pair(
       word_seq, static_cast<Label>(state_to_wseq_.size()));
@@ -101,9 +146,26 @@ bool KaldiRnnlmDeterministicFst::GetArc(StateId s, Label ilabel,
   typedef MapType::iterator IterType;
   std::pair<IterType, bool> result = wseq_to_state_.insert(wseq_state_pair);
 
+  // If PrepareArcs() computed the RNNLM state for this arc, take it.
+  std::shared_ptr<const RnnlmComputeState> rnnlm2;
+  if (!prepared_states_.empty()) {
+    PreparedMapType::iterator iter =
+        prepared_states_.find(std::make_pair(s, ilabel));
+    if (iter != prepared_states_.end()) {
+      rnnlm2 = iter->second;
+      prepared_states_.erase(iter);
+    }
+  }
+
   // If the pair was just inserted, then also add it to state_to_* structures.
   if (result.second == true) {
-    RnnlmComputeState *rnnlm2 = rnnlm->GetSuccessorState(ilabel);
+    if (rnnlm2 == NULL && cache_ != NULL)
+      rnnlm2 = cache_->Lookup(state_to_wseq_[s], ilabel);
+    if (rnnlm2 == NULL) {
+      rnnlm2.reset(rnnlm->GetSuccessorState(ilabel));
+      if (cache_ != NULL)
+        cache_->Insert(state_to_wseq_[s], ilabel, rnnlm2);
+    }
     state_to_wseq_.push_back(word_seq);
     state_to_rnnlm_state_.push_back(rnnlm2);
   }
@@ -116,5 +178,48 @@ bool KaldiRnnlmDeterministicFst::GetArc(StateId s, Label ilabel,
   return true;
 }
 
+void KaldiRnnlmDeterministicFst::PrepareArcs(
+    const std::vector<std::pair<StateId, Label> > &arcs) {
+  size_t num_states = state_to_wseq_.size();
+  std::vector<const RnnlmComputeState*> states;
+  // The arcs whose RNNLM states we compute, indexed like 'states'.
+  std::vector<std::pair<StateId, Label> > new_arcs;
+  std::vector<int32> words;
+  std::vector<Label> word_seq;
+  for (size_t i = 0; i < arcs.size(); i++) {
+    StateId s = arcs[i].first;
+    Label ilabel = arcs[i].second;
+    KALDI_ASSERT(static_cast<size_t>(s) < num_states);
+    // We only need the RNNLM state if GetArc() would create a new FST state.
+    // Note: two arcs that lead to the same history (because of
+    // max_ngram_order_) are both prepared, since we don't know yet which of
+    // them GetArc() will see first.
+    GetNextWordSeq(s, ilabel, &word_seq);
+    if (wseq_to_state_.count(word_seq) != 0 ||
+        prepared_states_.count(arcs[i]) != 0)
+      continue;
+    std::shared_ptr<const RnnlmComputeState> &rnnlm =
+        prepared_states_[arcs[i]];
+    if (cache_ != NULL)
+      rnnlm = cache_->Lookup(state_to_wseq_[s], ilabel);
+    if (rnnlm == NULL) {
+      new_arcs.push_back(arcs[i]);
+      states.push_back(state_to_rnnlm_state_[s].get());
+      words.push_back(ilabel);
+    }
+  }
+  if (states.empty())
+    return;
+  std::vector<RnnlmComputeState*> successors;
+  batcher_.GetSuccessorStates(states, words, &successors);
+  for (size_t i = 0; i < successors.size(); i++) {
+    std::shared_ptr<const RnnlmComputeState> &rnnlm =
+        prepared_states_[new_arcs[i]];
+    rnnlm.reset(successors[i]);
+    if (cache_ != NULL)
+      cache_->Insert(state_to_wseq_[new_arcs[i].first], words[i], rnnlm);
+  }
+}
+
 }  // namespace rnnlm
 }  // namespace kaldi
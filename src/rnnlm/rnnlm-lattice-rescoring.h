@@ -22,6 +22,9 @@
 #ifndef KALDI_RNNLM_RNNLM_LATTICE_RESCORING_H_
 #define KALDI_RNNLM_RNNLM_LATTICE_RESCORING_H_
 
+#include <list>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -33,6 +36,59 @@
 namespace kaldi {
 namespace rnnlm {
 
+/*
+  RnnlmComputeStateCache is an LRU cache of RNNLM states, keyed by (history,
+  word), that can be shared between KaldiRnnlmDeterministicFst objects (e.g.
+  one per thread, or one that is Clear()'ed for each lattice).  Lattices of the
+  same speaker or task share many histories, so this saves us from evaluating
+  the RNNLM for them again.  All the FSTs that share a cache must use the same
+  RnnlmComputeStateInfo (or at least the same model and options) and the same
+  max_ngram_order.  This class is thread-safe.
+
+  Caution: with max_ngram_order > 0 the history is truncated, and the state
+  stored for it is the one computed for whichever full history reached it
+  first, possibly in an earlier lattice.  So the scores of a lattice then
+  depend on which lattices were rescored before it (and, with several
+  threads, on timing).  Without truncation the cached states are the same as
+  recomputed ones, up to roundoff.  For this reason the cache is off unless
+  --rnnlm-cache-size is set.
+*/
+class RnnlmComputeStateCache {
+ public:
+  /// 'capacity' is the maximum number of states stored.
+  explicit RnnlmComputeStateCache(size_t capacity);
+
+  /// If the state for 'history' followed by 'word' is in the cache, returns it
+  /// (and marks it as recently used); otherwise returns NULL.
+  std::shared_ptr<const RnnlmComputeState> Lookup(
+      const std::vector<int32> &history, int32 word);
+
+  /// Adds the state for 'history' followed by 'word' to the cache, removing
+  /// the least recently used state if the cache is full.
+  void Insert(const std::vector<int32> &history, int32 word,
+              const std::shared_ptr<const RnnlmComputeState> &state);
+
+  ~RnnlmComputeStateCache();
+ private:
+  // The key is the history with the word appended.
+  typedef std::pair<std::vector<int32>,
+                    std::shared_ptr<const RnnlmComputeState> > EntryType;
+  typedef std::list<EntryType> ListType;
+  typedef unordered_map<std::vector<int32>, ListType::iterator,
+                        VectorHasher<int32> > MapType;
+
+  size_t capacity_;
+  std::mutex mutex_;
+  // Most recently used first.
+  ListType entries_;
+  MapType map_;
+  int64 num_lookups_;
+  int64 num_hits_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(RnnlmComputeStateCache);
+};
+
+
 class KaldiRnnlmDeterministicFst
     : public fst::DeterministicOnDemandFst<fst::StdArc> {
  public:
@@ -40,9 +96,11 @@ class KaldiRnnlmDeterministicFst
   typedef fst::StdArc::StateId StateId;
   typedef fst::StdArc::Label Label;
 
-  // Does not take ownership.
+  // Does not take ownership.  If 'cache' is not NULL, RNNLM states are looked
+  // up in it before we compute them, and states we compute are added to it.
   KaldiRnnlmDeterministicFst(int32 max_ngram_order,
-      const RnnlmComputeStateInfo &info);
+      const RnnlmComputeStateInfo &info,
+      RnnlmComputeStateCache *cache = NULL);
   ~KaldiRnnlmDeterministicFst();
 
   void Clear();
@@ -57,7 +115,20 @@ class KaldiRnnlmDeterministicFst
 
   virtual bool GetArc(StateId s, Label ilabel, fst::StdArc* oarc);
 
+  // Evaluates, in one minibatch, the RNNLM states that GetArc() would have to
+  // compute for the arcs in 'arcs'; they are kept until GetArc() is called
+  // for that arc.  It does not create any FST states, so the state numbering,
+  // and which history a state gets when --max-ngram-order merges histories,
+  // are the same as if it had not been called.
+  virtual void PrepareArcs(const std::vector<std::pair<StateId, Label> > &arcs);
+
  private:
+  // Outputs to 'word_seq' the history (as used as a key in wseq_to_state_) of
+  // the state we get to by taking the arc with label 'ilabel' from state 's'.
+  void GetNextWordSeq(StateId s, Label ilabel,
+                      std::vector<Label> *word_seq) const;
+
+
   typedef unordered_map
       <std::vector<Label>, StateId, VectorHasher<Label> > MapType;
   StateId start_state_;
@@ -70,9 +141,21 @@ class KaldiRnnlmDeterministicFst
   // Mapping from state-id to history sequence>
   std::vector<std::vector<Label> > state_to_wseq_;
 
-  // Mapping from state-id to RNNLM states.
-  // The pointers are owned in this class
-  std::vector<RnnlmComputeState*> state_to_rnnlm_state_;
+  // Mapping from state-id to RNNLM states.  They are shared with cache_, if
+  // it is not NULL.
+  std::vector<std::shared_ptr<const RnnlmComputeState> > state_to_rnnlm_state_;
+
+  // Used in PrepareArcs() to evaluate many states at once.
+  RnnlmComputeStateBatcher batcher_;
+
+  // The RNNLM states computed by PrepareArcs() for arcs (state, word) whose
+  // destination state GetArc() has not created yet.
+  typedef unordered_map<std::pair<StateId, Label>,
+                        std::shared_ptr<const RnnlmComputeState>,
+                        PairHasher<int32> > PreparedMapType;
+  PreparedMapType prepared_states_;
+
+  RnnlmComputeStateCache *cache_;
 
 };
 
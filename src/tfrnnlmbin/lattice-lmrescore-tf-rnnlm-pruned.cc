@@ -116,7 +116,7 @@ int main(int argc, char *argv[]) {
     KALDI_LOG << "Reading old LMs...";
     if (use_carpa) {
       const_arpa = new ConstArpaLm();
-      ReadKaldiObject(lm_to_subtract_rxfilename, const_arpa);
+      ReadConstArpaLm(lm_to_subtract_rxfilename, const_arpa);
       carpa_lm_to_subtract_fst = new ConstArpaLmDeterministicFst(*const_arpa);
       lm_to_subtract_det_scale
         = new fst::ScaleDeterministicOnDemandFst(-lm_scale,
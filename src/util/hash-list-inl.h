@@ -189,6 +189,155 @@ void HashList<I, T>::InsertMore(I key, T val) {
 }
 
 
+template<class I, class T> OpenHashList<I, T>::OpenHashList():
+    list_head_(NULL), num_keys_(0), freed_head_(NULL) {
+  Allocate(min_size_);
+}
+
+template<class I, class T>
+void OpenHashList<I, T>::Allocate(size_t size) {
+  KALDI_ASSERT(size >= 2 && (size & (size - 1)) == 0);
+  Slot empty_slot;
+  empty_slot.key = I();
+  empty_slot.stamp = 0;
+  empty_slot.elem = NULL;
+  slots_.assign(size, empty_slot);
+  mask_ = size - 1;
+  shift_ = 64;
+  for (size_t s = size; s > 1; s >>= 1)
+    shift_--;
+  stamp_ = 1;
+}
+
+template<class I, class T> void OpenHashList<I, T>::SetSize(size_t sz) {
+  KALDI_ASSERT(list_head_ == NULL && num_keys_ == 0);  // make sure empty.
+  if (sz > slots_.size()) {
+    size_t size = slots_.size();
+    while (size < sz) size *= 2;
+    Allocate(size);
+  }
+}
+
+template<class I, class T>
+typename OpenHashList<I, T>::Elem* OpenHashList<I, T>::Clear() {
+  stamp_++;
+  if (stamp_ == 0) {  // The stamps have wrapped around; this is very rare.
+    for (size_t i = 0; i < slots_.size(); i++)
+      slots_[i].stamp = 0;
+    stamp_ = 1;
+  }
+  num_keys_ = 0;
+  Elem *ans = list_head_;
+  list_head_ = NULL;
+  return ans;
+}
+
+template<class I, class T>
+inline void OpenHashList<I, T>::Delete(Elem *e) {
+  e->tail = freed_head_;
+  freed_head_ = e;
+}
+
+template<class I, class T>
+inline typename OpenHashList<I, T>::Elem* OpenHashList<I, T>::New() {
+  if (freed_head_) {
+    Elem *ans = freed_head_;
+    freed_head_ = freed_head_->tail;
+    return ans;
+  } else {
+    Elem *tmp = new Elem[allocate_block_size_];
+    for (size_t i = 0; i+1 < allocate_block_size_; i++)
+      tmp[i].tail = tmp+i+1;
+    tmp[allocate_block_size_-1].tail = NULL;
+    freed_head_ = tmp;
+    allocated_.push_back(tmp);
+    return this->New();
+  }
+}
+
+template<class I, class T>
+inline typename OpenHashList<I, T>::Elem* OpenHashList<I, T>::Find(I key) {
+  for (size_t i = Hash(key); ; i = (i + 1) & mask_) {
+    const Slot &slot = slots_[i];
+    if (slot.stamp != stamp_) return NULL;  // Reached an empty slot.
+    if (slot.key == key) return slot.elem;
+  }
+}
+
+template<class I, class T>
+inline typename OpenHashList<I, T>::Elem* OpenHashList<I, T>::Insert(I key,
+                                                                     T val) {
+  size_t i = Hash(key);
+  for (; slots_[i].stamp == stamp_; i = (i + 1) & mask_)
+    if (slots_[i].key == key) return slots_[i].elem;
+
+  // This is a new element.  Insert it at the head of the list.
+  Elem *elem = New();
+  elem->key = key;
+  elem->val = val;
+  elem->tail = list_head_;
+  list_head_ = elem;
+  Slot &slot = slots_[i];
+  slot.key = key;
+  slot.stamp = stamp_;
+  slot.elem = elem;
+  if (++num_keys_ * 2 > slots_.size())
+    Grow();
+  return elem;
+}
+
+template<class I, class T>
+void OpenHashList<I, T>::InsertMore(I key, T val) {
+  Elem *e = Find(key);
+  KALDI_ASSERT(e != NULL);  // assume one element is already here.
+  // Go to the last of the elements with this key, which follow each other.
+  while (e->tail != NULL && e->tail->key == key)
+    e = e->tail;
+  Elem *elem = New();
+  elem->key = key;
+  elem->val = val;
+  elem->tail = e->tail;
+  e->tail = elem;
+}
+
+template<class I, class T>
+void OpenHashList<I, T>::Grow() {
+  Allocate(slots_.size() * 2);
+  num_keys_ = 0;
+  for (Elem *e = list_head_; e != NULL; e = e->tail) {
+    size_t i = Hash(e->key);
+    for (; slots_[i].stamp == stamp_; i = (i + 1) & mask_)
+      if (slots_[i].key == e->key) break;
+    Slot &slot = slots_[i];
+    if (slot.stamp != stamp_) {
+      // First element with this key (the others, from InsertMore(), follow
+      // it in the list).
+      slot.key = e->key;
+      slot.stamp = stamp_;
+      slot.elem = e;
+      num_keys_++;
+    }
+  }
+}
+
+template<class I, class T>
+OpenHashList<I, T>::~OpenHashList() {
+  // Check for memory leaks, as in ~HashList().
+  size_t num_in_list = 0, num_allocated = 0;
+  for (Elem *e = freed_head_; e != NULL; e = e->tail)
+    num_in_list++;
+  for (size_t i = 0; i < allocated_.size(); i++) {
+    num_allocated += allocate_block_size_;
+    delete[] allocated_[i];
+  }
+  if (num_in_list != num_allocated) {
+    KALDI_WARN << "Possible memory leak: " << num_in_list
+               << " != " << num_allocated
+               << ": you might have forgotten to call Delete on "
+               << "some Elems";
+  }
+}
+
 }  // end namespace kaldi
 
 #endif  // KALDI_UTIL_HASH_LIST_INL_H_
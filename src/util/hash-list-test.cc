@@ -21,15 +21,17 @@
 
 #include "util/hash-list.h"
 #include <map>  // for baseline.
+#include <set>
 #include <cstdlib>
 #include <iostream>
 
 namespace kaldi {
 
-template<class Int, class T> void TestHashList() {
-  typedef typename HashList<Int, T>::Elem Elem;
+// HashType is HashList<Int, T> or OpenHashList<Int, T>.
+template<class Int, class T, class HashType> void TestHashList() {
+  typedef typename HashType::Elem Elem;
 
-  HashList<Int, T> hash;
+  HashType hash;
   hash.SetSize(200);  // must be called before use.
   std::map<Int, T> m1;
   for (size_t j = 0; j < 50; j++) {
@@ -84,6 +86,52 @@ template<class Int, class T> void TestHashList() {
 
     KALDI_ASSERT(m1.size() == count);
   }
+  for (Elem *h = hash.Clear(), *tmp; h != NULL; h = tmp) {
+    tmp = h->tail;
+    hash.Delete(h);
+  }
+}
+
+// Tests InsertMore(), and that OpenHashList grows by itself when more
+// elements are inserted than SetSize() asked for.
+template<class Int, class T, class HashType> void TestHashListInsertMore() {
+  typedef typename HashType::Elem Elem;
+
+  HashType hash;
+  hash.SetSize(4);
+  std::multimap<Int, T> m;
+  for (size_t j = 0; j < 300; j++) {
+    Int key = Rand() % 100;
+    T val = Rand() % 50;
+    if (hash.Find(key) == NULL) hash.Insert(key, val);
+    else hash.InsertMore(key, val);
+    m.insert(std::make_pair(key, val));
+  }
+  // Check that the elements with the same key follow each other, and that
+  // they are all there.
+  std::set<Int> keys_seen;
+  size_t count = 0;
+  for (const Elem *e = hash.GetList(); e != NULL; ) {
+    Int key = e->key;
+    KALDI_ASSERT(keys_seen.count(key) == 0);
+    keys_seen.insert(key);
+    KALDI_ASSERT(hash.Find(key) == e);
+    std::multiset<T> vals, ref_vals;
+    for (; e != NULL && e->key == key; e = e->tail, count++)
+      vals.insert(e->val);
+    typename std::multimap<Int, T>::const_iterator iter = m.lower_bound(key),
+        end = m.upper_bound(key);
+    for (; iter != end; ++iter)
+      ref_vals.insert(iter->second);
+    KALDI_ASSERT(vals == ref_vals);
+  }
+  KALDI_ASSERT(count == m.size());
+
+  for (Elem *h = hash.Clear(), *tmp; h != NULL; h = tmp) {
+    tmp = h->tail;
+    hash.Delete(h);
+  }
+  KALDI_ASSERT(hash.GetList() == NULL && hash.Find(1) == NULL);
 }
 
 
@@ -96,12 +144,20 @@ template<class Int, class T> void TestHashList() {
 int main() {
   using namespace kaldi;
   for (size_t i = 0;i < 3;i++) {
-    TestHashList<int, unsigned int>();
-    TestHashList<unsigned int, int>();
-    TestHashList<int16, int32>();
-    TestHashList<int16, int32>();
-    TestHashList<char, unsigned char>();
-    TestHashList<unsigned char, int>();
+    TestHashList<int, unsigned int, HashList<int, unsigned int> >();
+    TestHashList<unsigned int, int, HashList<unsigned int, int> >();
+    TestHashList<int16, int32, HashList<int16, int32> >();
+    TestHashList<int16, int32, HashList<int16, int32> >();
+    TestHashList<char, unsigned char, HashList<char, unsigned char> >();
+    TestHashList<unsigned char, int, HashList<unsigned char, int> >();
+    TestHashList<int, unsigned int, OpenHashList<int, unsigned int> >();
+    TestHashList<unsigned int, int, OpenHashList<unsigned int, int> >();
+    TestHashList<int16, int32, OpenHashList<int16, int32> >();
+    TestHashList<char, unsigned char, OpenHashList<char, unsigned char> >();
+    TestHashList<unsigned char, int, OpenHashList<unsigned char, int> >();
+    TestHashList<uint64, int, OpenHashList<uint64, int> >();
+    TestHashListInsertMore<int, int, HashList<int, int> >();
+    TestHashListInsertMore<int, int, OpenHashList<int, int> >();
   }
   std::cout << "Test OK.\n";
 }
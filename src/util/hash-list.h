@@ -140,6 +140,94 @@ template<class I, class T> class HashList {
 };
 
 
+
+/// OpenHashList has the same interface and the same semantics as HashList (a
+/// list of Elems that the user walks, plus a hash that is cleared separately
+/// by Clear()), but its hash uses open addressing with linear probing instead
+/// of chained buckets.  The keys are stored in the hash table itself next to
+/// the Elem pointers, so a lookup reads a few adjacent slots (for 32-bit keys,
+/// four slots fit in a 64-byte cache line) rather than following a chain of
+/// Elems.  Each slot also has a stamp, and a slot is in use only if its stamp
+/// is the current one; Clear() just changes the current stamp, so it takes
+/// constant time however large the table is.
+///
+/// The number of slots is always a power of two, and the table doubles its
+/// size by itself when it becomes half full, so SetSize() is only a hint.
+/// The order of the list differs from that of HashList: new elements are
+/// added at the head of the list (except with InsertMore(), which puts them
+/// after the other elements with the same key).  The keys must be of integer
+/// type.
+template<class I, class T> class OpenHashList {
+ public:
+  typedef typename HashList<I, T>::Elem Elem;
+
+  OpenHashList();
+
+  /// See HashList::Clear().
+  Elem *Clear();
+
+  /// See HashList::GetList().
+  const Elem *GetList() const { return list_head_; }
+
+  /// See HashList::Delete().
+  inline void Delete(Elem *e);
+
+  /// See HashList::New().
+  inline Elem *New();
+
+  /// See HashList::Find().
+  inline Elem *Find(I key);
+
+  /// See HashList::Insert().
+  inline Elem *Insert(I key, T val);
+
+  /// See HashList::InsertMore().
+  inline void InsertMore(I key, T val);
+
+  /// Makes sure the hash has at least 'sz' slots (rounded up to a power of
+  /// two).  It must be called while the hash is empty.  Unlike for HashList,
+  /// this never reduces the size.
+  void SetSize(size_t sz);
+
+  /// Returns the current number of slots.
+  inline size_t Size() const { return slots_.size(); }
+
+  ~OpenHashList();
+ private:
+  struct Slot {
+    I key;
+    uint32 stamp;  // The slot is in use only if this equals stamp_.
+    Elem *elem;  // The first Elem in the list with this key.
+  };
+
+  // Returns the index of the slot where the probing for 'key' starts
+  // (Fibonacci hashing: the top bits of key * 2^64 / golden ratio).
+  inline size_t Hash(I key) const {
+    return static_cast<size_t>(
+        (static_cast<uint64>(key) * 11400714819323198485ULL) >> shift_);
+  }
+
+  // Allocates 'size' empty slots, which must be a power of two.
+  void Allocate(size_t size);
+
+  // Doubles the number of slots and re-inserts the keys in the list.
+  void Grow();
+
+  Elem *list_head_;  // Head of currently stored list.
+  std::vector<Slot> slots_;
+  size_t mask_;  // slots_.size() - 1.
+  int32 shift_;  // 64 - log2(slots_.size()).
+  uint32 stamp_;
+  size_t num_keys_;  // The number of slots in use.
+
+  Elem *freed_head_;  // Head of list of currently freed elements.
+  std::vector<Elem*> allocated_;  // List of allocated blocks.
+
+  static const size_t allocate_block_size_ = 1024;
+  static const size_t min_size_ = 16;
+};
+
+
 }  // end namespace kaldi
 
 #include "util/hash-list-inl.h"
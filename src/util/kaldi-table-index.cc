@@ -0,0 +1,303 @@
+// util/kaldi-table-index.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cstring>
+#ifndef _MSC_VER
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "util/kaldi-table-index.h"
+#include "util/kaldi-io.h"
+
+namespace kaldi {
+
+std::string ArchiveIndexFilename(const std::string &archive_filename) {
+  return archive_filename + ".idx";
+}
+
+bool ArchiveIndexExists(const std::string &archive_rxfilename) {
+  if (ClassifyRxfilename(archive_rxfilename) != kFileInput)
+    return false;
+  std::ifstream is(ArchiveIndexFilename(archive_rxfilename).c_str());
+  return is.is_open();
+}
+
+
+void ArchiveIndexWriter::Add(const std::string &key, int64 begin, int64 end) {
+  KALDI_ASSERT(begin > static_cast<int64>(key.size()) && end >= begin);
+  Entry e;
+  e.key = key;
+  e.begin = begin;
+  e.end = end;
+  entries_.push_back(e);
+  archive_size_ = std::max(archive_size_, end);
+}
+
+void ArchiveIndexWriter::Clear() {
+  entries_.clear();
+  archive_size_ = 0;
+}
+
+bool ArchiveIndexWriter::Write(const std::string &archive_filename) {
+  // stable_sort so that if there are duplicate keys, the first one in the
+  // archive is the one we keep.
+  std::stable_sort(entries_.begin(), entries_.end());
+  size_t num_unique = 0;
+  for (size_t i = 0; i < entries_.size(); i++) {
+    if (num_unique > 0 && entries_[i].key == entries_[num_unique - 1].key) {
+      KALDI_WARN << "Duplicate key " << entries_[i].key << " in archive "
+                 << archive_filename << "; the index will only contain "
+                 << "the first one.";
+      continue;
+    }
+    if (num_unique != i)
+      entries_[num_unique] = entries_[i];
+    num_unique++;
+  }
+  entries_.resize(num_unique);
+
+  std::string index_filename = ArchiveIndexFilename(archive_filename);
+  std::ofstream os(index_filename.c_str(), std::ios::binary);
+  if (!os.is_open()) {
+    KALDI_WARN << "Could not open " << index_filename << " for writing.";
+    return false;
+  }
+  bool binary = true;
+  InitKaldiOutputStream(os, binary);
+  WriteToken(os, binary, "<ArchiveIndex>");
+  WriteToken(os, binary, "<ArchiveSize>");
+  WriteBasicType(os, binary, archive_size_);
+  WriteToken(os, binary, "<NumEntries>");
+  WriteBasicType(os, binary, static_cast<int64>(entries_.size()));
+  for (size_t i = 0; i < entries_.size(); i++) {
+    WriteToken(os, binary, entries_[i].key);
+    WriteBasicType(os, binary, entries_[i].begin);
+    WriteBasicType(os, binary, entries_[i].end);
+  }
+  WriteToken(os, binary, "</ArchiveIndex>");
+  os.close();
+  if (os.fail()) {
+    KALDI_WARN << "Error writing archive index to " << index_filename;
+    return false;
+  }
+  return true;
+}
+
+
+std::streambuf::pos_type MemoryInputBuf::seekoff(
+    off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) {
+  if (!(which & std::ios_base::in))
+    return pos_type(off_type(-1));
+  char *target;
+  if (dir == std::ios_base::beg)
+    target = eback() + off;
+  else if (dir == std::ios_base::cur)
+    target = gptr() + off;
+  else
+    target = egptr() + off;
+  if (target < eback() || target > egptr())
+    return pos_type(off_type(-1));
+  setg(eback(), target, egptr());
+  return pos_type(target - eback());
+}
+
+std::streambuf::pos_type MemoryInputBuf::seekpos(
+    pos_type pos, std::ios_base::openmode which) {
+  return seekoff(off_type(pos), std::ios_base::beg, which);
+}
+
+
+IndexedArchive::IndexedArchive(): is_open_(false), archive_size_(0),
+                                  last_found_(0), data_(NULL), fd_(-1),
+                                  mem_stream_(&buf_) { }
+
+bool IndexedArchive::ReadIndex() {
+  std::string index_filename = ArchiveIndexFilename(archive_filename_);
+  std::ifstream is(index_filename.c_str(), std::ios::binary);
+  if (!is.is_open()) {
+    KALDI_WARN << "Could not open archive index " << index_filename;
+    return false;
+  }
+  try {
+    bool binary;
+    if (!InitKaldiInputStream(is, &binary) || !binary)
+      KALDI_ERR << "Expected binary index";
+    ExpectToken(is, binary, "<ArchiveIndex>");
+    ExpectToken(is, binary, "<ArchiveSize>");
+    ReadBasicType(is, binary, &archive_size_);
+    ExpectToken(is, binary, "<NumEntries>");
+    int64 num_entries;
+    ReadBasicType(is, binary, &num_entries);
+    if (num_entries < 0)
+      KALDI_ERR << "Bad number of entries " << num_entries;
+    keys_.resize(num_entries);
+    begin_.resize(num_entries);
+    end_.resize(num_entries);
+    for (int64 i = 0; i < num_entries; i++) {
+      ReadToken(is, binary, &(keys_[i]));
+      ReadBasicType(is, binary, &(begin_[i]));
+      ReadBasicType(is, binary, &(end_[i]));
+      if (i > 0 && !(keys_[i - 1] < keys_[i]))
+        KALDI_ERR << "Keys are not sorted and unique";
+      if (begin_[i] <= static_cast<int64>(keys_[i].size()) ||
+          end_[i] < begin_[i] || end_[i] > archive_size_)
+        KALDI_ERR << "Invalid position for key " << keys_[i];
+    }
+    ExpectToken(is, binary, "</ArchiveIndex>");
+  } catch (const std::exception &e) {
+    KALDI_WARN << "Error reading archive index " << index_filename;
+    return false;
+  }
+  return true;
+}
+
+bool IndexedArchive::Open(const std::string &archive_filename) {
+  Close();
+  archive_filename_ = archive_filename;
+  if (!ReadIndex())
+    return false;
+  int64 file_size = -1;
+#ifndef _MSC_VER
+  int fd = open(archive_filename_.c_str(), O_RDONLY);
+  if (fd >= 0) {
+    struct stat st;
+    if (fstat(fd, &st) == 0) {
+      file_size = st.st_size;
+      if (file_size == archive_size_ && file_size > 0) {
+        void *addr = mmap(NULL, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr != MAP_FAILED)
+          data_ = static_cast<char*>(addr);
+      }
+    }
+    // We keep the file open while it is mapped, so that Stream() can check
+    // that it has not been truncated.
+    if (data_ != NULL)
+      fd_ = fd;
+    else
+      close(fd);
+  }
+#endif
+  if (data_ == NULL) {
+    // We could not memory-map the archive; read it as a regular file.
+    file_.open(archive_filename_.c_str(), std::ios::binary);
+    if (!file_.is_open()) {
+      KALDI_WARN << "Could not open archive " << archive_filename_;
+      return false;
+    }
+    file_.seekg(0, std::ios::end);
+    file_size = file_.tellg();
+  }
+  if (file_size != archive_size_) {
+    KALDI_WARN << "Archive " << archive_filename_ << " has size " << file_size
+               << " but its index " << ArchiveIndexFilename(archive_filename_)
+               << " says " << archive_size_ << "; not using the index.";
+    Close();
+    return false;
+  }
+  is_open_ = true;
+  return true;
+}
+
+int64 IndexedArchive::Find(const std::string &key) const {
+  // Check the last key found and the one after; this makes HasKey() followed by
+  // Value(), and in-order access, fast.
+  for (size_t i = last_found_; i < last_found_ + 2 && i < keys_.size(); i++) {
+    if (keys_[i] == key) {
+      last_found_ = i;
+      return i;
+    }
+  }
+  std::vector<std::string>::const_iterator iter =
+      std::lower_bound(keys_.begin(), keys_.end(), key);
+  if (iter == keys_.end() || *iter != key)
+    return -1;
+  last_found_ = iter - keys_.begin();
+  return last_found_;
+}
+
+bool IndexedArchive::HasKey(const std::string &key) const {
+  KALDI_ASSERT(is_open_);
+  return Find(key) != -1;
+}
+
+std::istream *IndexedArchive::Stream(const std::string &key) {
+  KALDI_ASSERT(is_open_);
+  int64 i = Find(key);
+  if (i == -1)
+    return NULL;
+  int64 key_begin = begin_[i] - static_cast<int64>(key.size()) - 1;
+  // Check that the archive has "key " just before the object, which guards
+  // against the archive having been changed after the index was written.
+  bool key_ok;
+  std::istream *ans;
+  if (data_ != NULL) {
+    // Touching mapped pages beyond the end of the file would kill the process
+    // with SIGBUS, so make sure the archive has not shrunk since we opened it.
+#ifndef _MSC_VER
+    struct stat st;
+    if (fstat(fd_, &st) != 0 || st.st_size < end_[i])
+      KALDI_ERR << "Archive " << archive_filename_ << " was truncated or "
+                << "removed while it was being read.";
+#endif
+    key_ok = (std::memcmp(data_ + key_begin, key.data(), key.size()) == 0 &&
+              data_[begin_[i] - 1] == ' ');
+    buf_.SetRegion(data_ + begin_[i], data_ + end_[i]);
+    mem_stream_.clear();
+    ans = &mem_stream_;
+  } else {
+    file_.clear();
+    file_.seekg(key_begin);
+    std::string str(key.size() + 1, '\0');
+    file_.read(&(str[0]), str.size());
+    key_ok = (file_.good() && str.compare(0, key.size(), key) == 0 &&
+              str[key.size()] == ' ');
+    ans = &file_;
+  }
+  if (!key_ok)
+    KALDI_ERR << "Archive " << archive_filename_ << " does not match its index "
+              << ArchiveIndexFilename(archive_filename_) << " (expected key "
+              << key << " at byte " << key_begin << "); the index is probably "
+              << "out of date.";
+  return ans;
+}
+
+void IndexedArchive::Close() {
+#ifndef _MSC_VER
+  if (data_ != NULL)
+    munmap(data_, archive_size_);
+  if (fd_ >= 0)
+    close(fd_);
+#endif
+  fd_ = -1;
+  data_ = NULL;
+  if (file_.is_open())
+    file_.close();
+  keys_.clear();
+  begin_.clear();
+  end_.clear();
+  last_found_ = 0;
+  archive_size_ = 0;
+  is_open_ = false;
+}
+
+}  // end namespace kaldi
@@ -0,0 +1,157 @@
+// util/kaldi-table-index.h
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_UTIL_KALDI_TABLE_INDEX_H_
+#define KALDI_UTIL_KALDI_TABLE_INDEX_H_
+
+#include <fstream>
+#include <istream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#include "base/kaldi-common.h"
+
+namespace kaldi {
+
+/// \addtogroup table_group
+/// @{
+
+// This header contains the code for archive indexes.  An index is a file
+// written next to an archive (the archive's filename with ".idx" appended) by
+// a TableWriter whose wspecifier has the "i" option, e.g. "ark,i:foo.ark".  It
+// lists the position of each object in the archive, sorted by key, so that
+// RandomAccessTableReader can read any object directly, without the archive
+// having to be sorted or read in order.  RandomAccessTableReader uses the index
+// automatically if it exists and the rspecifier is "ark:" followed by an
+// actual filename.  The archive is memory-mapped where possible, so the
+// objects are read from the page cache without first copying them into a
+// stream buffer.  The archive must not be rewritten or truncated while it is
+// open: each read checks that the file is still large enough, and throws if
+// not, but a truncation during a read would still kill the process (SIGBUS).
+
+/// Returns the filename of the index of 'archive_filename'.
+std::string ArchiveIndexFilename(const std::string &archive_filename);
+
+/// Returns true if 'archive_rxfilename' is an actual file and its index
+/// exists.  It does not check that the index is valid.
+bool ArchiveIndexExists(const std::string &archive_rxfilename);
+
+
+/// ArchiveIndexWriter accumulates the positions of the objects written to an
+/// archive and writes them to the index file.
+class ArchiveIndexWriter {
+ public:
+  ArchiveIndexWriter(): archive_size_(0) { }
+
+  /// Records that the object with key 'key' occupies bytes 'begin' to 'end' - 1
+  /// of the archive; 'begin' is the position just after "key ".
+  void Add(const std::string &key, int64 begin, int64 end);
+
+  /// Writes the index for the archive 'archive_filename'.  Returns false and
+  /// prints a warning on failure.
+  bool Write(const std::string &archive_filename);
+
+  /// Forgets everything that was added.
+  void Clear();
+
+ private:
+  struct Entry {
+    std::string key;
+    int64 begin;
+    int64 end;
+    bool operator < (const Entry &other) const { return key < other.key; }
+  };
+  std::vector<Entry> entries_;
+  int64 archive_size_;  // The largest 'end' seen so far.
+};
+
+
+// A std::streambuf that reads from a region of memory, without copying it.
+class MemoryInputBuf: public std::streambuf {
+ public:
+  void SetRegion(const char *begin, const char *end) {
+    char *b = const_cast<char*>(begin), *e = const_cast<char*>(end);
+    setg(b, b, e);
+  }
+ protected:
+  virtual pos_type seekoff(off_type off, std::ios_base::seekdir dir,
+                           std::ios_base::openmode which);
+  virtual pos_type seekpos(pos_type pos, std::ios_base::openmode which);
+};
+
+
+/// IndexedArchive gives random access to the objects in an archive that has
+/// an index.
+class IndexedArchive {
+ public:
+  IndexedArchive();
+
+  /// Reads the index of 'archive_filename' and opens the archive.  Returns
+  /// false and prints a warning if the index could not be read or does not
+  /// match the archive (e.g. if the archive was rewritten without an index).
+  bool Open(const std::string &archive_filename);
+
+  bool IsOpen() const { return is_open_; }
+
+  bool HasKey(const std::string &key) const;
+
+  /// If 'key' is in the archive, returns a stream positioned at the start of
+  /// its object (which the Holder can read); otherwise returns NULL.  The
+  /// stream is only valid until the next call to this function or Close().
+  /// Throws if the archive does not contain "key " where the index says it
+  /// should.
+  std::istream *Stream(const std::string &key);
+
+  /// Returns the filename of the archive.
+  const std::string &Filename() const { return archive_filename_; }
+
+  void Close();
+
+  ~IndexedArchive() { Close(); }
+
+ private:
+  // Returns the index into keys_ of 'key', or -1 if not present.
+  int64 Find(const std::string &key) const;
+
+  bool ReadIndex();
+
+  bool is_open_;
+  std::string archive_filename_;
+  int64 archive_size_;
+  std::vector<std::string> keys_;  // sorted.
+  std::vector<int64> begin_;  // byte offsets, indexed like keys_.
+  std::vector<int64> end_;
+  mutable size_t last_found_;  // speeds up HasKey() followed by Value().
+
+  // If the archive is memory-mapped, its address and its file descriptor;
+  // else NULL and -1, and we read it via file_.
+  char *data_;
+  int fd_;
+  MemoryInputBuf buf_;
+  std::istream mem_stream_;
+  std::ifstream file_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(IndexedArchive);
+};
+
+/// @} end "addtogroup table_group"
+}  // end namespace kaldi
+
+#endif  // KALDI_UTIL_KALDI_TABLE_INDEX_H_
@@ -24,6 +24,7 @@
 #define KALDI_UTIL_KALDI_TABLE_INL_H_
 
 #include <algorithm>
+#include <cstdio>
 #include <string>
 #include <thread>
 #include <utility>
@@ -31,6 +32,7 @@
 #include <errno.h>
 #include "util/kaldi-io.h"
 #include "util/kaldi-holder.h"
+#include "util/kaldi-table-index.h"
 #include "util/text-utils.h"
 #include "util/stl-utils.h"  // for StringHasher.
 #include "util/kaldi-semaphore.h"
@@ -959,6 +961,29 @@ SequentialTableReader<Holder>::~SequentialTableReader() {
 
 
 
+// Called when opening an archive for writing.  If we are to write an index
+// (the "i" option) but the archive is not an actual file, warns and sets
+// opts->index to false.  If we are not writing an index, removes (with a
+// warning) any index left over from a previous archive with the same name: it
+// describes the old contents of the file, which we are about to overwrite.
+inline void PrepareArchiveIndex(const std::string &archive_wxfilename,
+                                WspecifierOptions *opts) {
+  if (ClassifyWxfilename(archive_wxfilename) != kFileOutput) {
+    if (opts->index)
+      KALDI_WARN << "Not writing an index for archive "
+                 << PrintableWxfilename(archive_wxfilename)
+                 << " as it is not an actual file.";
+    opts->index = false;
+  } else if (!opts->index) {
+    std::string index_filename = ArchiveIndexFilename(archive_wxfilename);
+    if (std::remove(index_filename.c_str()) == 0)
+      KALDI_WARN << "Removed the archive index " << index_filename
+                 << ", as it belonged to the previous contents of "
+                 << archive_wxfilename << " (use the \"i\" option to write "
+                 << "a new one).";
+  }
+}
+
 template<class Holder> class TableWriterImplBase {
  public:
   typedef typename Holder::T T;
@@ -1014,6 +1039,8 @@ class TableWriterArchiveImpl: public TableWriterImplBase<Holder> {
                                            NULL,
                                            &opts_);
     KALDI_ASSERT(ws == kArchiveWspecifier);  // or wrongly called.
+    PrepareArchiveIndex(archive_wxfilename_, &opts_);
+    index_writer_.Clear();
 
     if (output_.Open(archive_wxfilename_, opts_.binary, false)) {  // false
                                                       // means no binary header.
@@ -1053,6 +1080,8 @@ class TableWriterArchiveImpl: public TableWriterImplBase<Holder> {
     if (!IsToken(key))  // e.g. empty string or has spaces...
       KALDI_ERR << "Using invalid key " << key;
     output_.Stream() << key << ' ';
+    int64 begin = (opts_.index ? static_cast<int64>(output_.Stream().tellp())
+                   : 0);
     if (!Holder::Write(output_.Stream(), opts_.binary, value)) {
       KALDI_WARN << "Write failure to "
                  << PrintableWxfilename(archive_wxfilename_);
@@ -1062,6 +1091,8 @@ class TableWriterArchiveImpl: public TableWriterImplBase<Holder> {
     if (state_ == kWriteError) return false;  // Even if this Write seems to
     // have succeeded, we fail because a previous Write failed and the archive
     // may be corrupted and unreadable.
+    if (opts_.index)
+      index_writer_.Add(key, begin, output_.Stream().tellp());
 
     if (opts_.flush)
       Flush();
@@ -1097,6 +1128,8 @@ class TableWriterArchiveImpl: public TableWriterImplBase<Holder> {
       return false;
     }
     state_ = kUninitialized;
+    if (opts_.index && !index_writer_.Write(archive_wxfilename_))
+      return false;
     return true;
   }
 
@@ -1115,6 +1148,7 @@ class TableWriterArchiveImpl: public TableWriterImplBase<Holder> {
   WspecifierOptions opts_;
   std::string wspecifier_;
   std::string archive_wxfilename_;
+  ArchiveIndexWriter index_writer_;  // only used if opts_.index.
   enum {               // is stream open?
     kUninitialized,    // no
     kOpen,             // yes
@@ -1311,6 +1345,8 @@ class TableWriterBothImpl: public TableWriterImplBase<Holder> {
       KALDI_WARN << "When writing to both archive and script, the script file "
           "will generally not be interpreted correctly unless the archive is "
           "an actual file: wspecifier = " << wspecifier;
+    PrepareArchiveIndex(archive_wxfilename_, &opts_);
+    index_writer_.Clear();
 
     if (!archive_output_.Open(archive_wxfilename_, opts_.binary, false)) {
       // false means no binary header.
@@ -1405,6 +1441,8 @@ class TableWriterBothImpl: public TableWriterImplBase<Holder> {
     if (state_ == kWriteError) return false;  // Even if this Write seems to
     // have succeeded, we fail because a previous Write failed and the archive
     // may be corrupted and unreadable.
+    if (opts_.index)
+      index_writer_.Add(key, archive_os_pos, archive_os.tellp());
 
     if (opts_.flush)
       Flush();
@@ -1434,6 +1472,8 @@ class TableWriterBothImpl: public TableWriterImplBase<Holder> {
       if (!script_output_.Close()) close_success = false;
     bool ans = close_success && (state_ != kWriteError);
     state_ = kUninitialized;
+    if (ans && opts_.index && !index_writer_.Write(archive_wxfilename_))
+      ans = false;
     return ans;
   }
 
@@ -1455,6 +1495,7 @@ class TableWriterBothImpl: public TableWriterImplBase<Holder> {
   std::string archive_wxfilename_;
   std::string script_wxfilename_;
   std::string wspecifier_;
+  ArchiveIndexWriter index_writer_;  // only used if opts_.index.
   enum {               // is stream open?
     kUninitialized,    // no
     kOpen,             // yes
@@ -2501,6 +2542,86 @@ class RandomAccessTableReaderUnsortedArchiveImpl:
 };
 
 
+// RandomAccessTableReaderIndexedArchiveImpl is used for an "ark:" rspecifier
+// whose archive has an index (see kaldi-table-index.h).  It looks up each key
+// in the index and reads the object directly from the (memory-mapped)
+// archive, so it works for archives in any order and keeps only the most
+// recently read object in memory.
+template<class Holder>
+class RandomAccessTableReaderIndexedArchiveImpl:
+      public RandomAccessTableReaderImplBase<Holder> {
+ public:
+  typedef typename Holder::T T;
+
+  RandomAccessTableReaderIndexedArchiveImpl(): have_object_(false) { }
+
+  virtual bool Open(const std::string &rspecifier) {
+    rspecifier_ = rspecifier;
+    RspecifierType rs = ClassifyRspecifier(rspecifier,
+                                           &archive_rxfilename_,
+                                           &opts_);
+    KALDI_ASSERT(rs == kArchiveRspecifier);
+    return archive_.Open(archive_rxfilename_);
+  }
+
+  virtual bool HasKey(const std::string &key) {
+    // In permissive mode we have to check that the object can be read.
+    if (opts_.permissive)
+      return ReadObject(key);
+    else
+      return archive_.HasKey(key);
+  }
+
+  virtual const T &Value(const std::string &key) {
+    if (!ReadObject(key))
+      KALDI_ERR << "Value() called but no such key " << key
+                << " in archive " << PrintableRxfilename(archive_rxfilename_);
+    return holder_.Value();
+  }
+
+  virtual bool Close() {
+    archive_.Close();
+    holder_.Clear();
+    have_object_ = false;
+    return true;
+  }
+
+ private:
+  // Reads the object for 'key' into holder_, if it is not already there.
+  // Returns false if the key is not present, or (in permissive mode) if the
+  // object could not be read.
+  bool ReadObject(const std::string &key) {
+    if (have_object_ && key == cur_key_)
+      return true;
+    have_object_ = false;
+    std::istream *is = archive_.Stream(key);
+    if (is == NULL)
+      return false;
+    if (!holder_.Read(*is)) {
+      if (opts_.permissive) {
+        KALDI_WARN << "Failed to read object with key " << key
+                   << " from archive " << archive_rxfilename_
+                   << "; ignoring it because you specified permissive mode.";
+        return false;
+      }
+      KALDI_ERR << "Failed to read object with key " << key
+                << " from archive " << archive_rxfilename_;
+    }
+    cur_key_ = key;
+    have_object_ = true;
+    return true;
+  }
+
+  std::string rspecifier_;
+  std::string archive_rxfilename_;
+  RspecifierOptions opts_;
+  IndexedArchive archive_;
+  Holder holder_;
+  std::string cur_key_;
+  bool have_object_;  // true if holder_ contains the object for cur_key_.
+};
+
+
 
 
 
@@ -2518,12 +2639,22 @@ bool RandomAccessTableReader<Holder>::Open(const std::string &rspecifier) {
   if (IsOpen())
     KALDI_ERR << "Already open.";
   RspecifierOptions opts;
-  RspecifierType rs = ClassifyRspecifier(rspecifier, NULL, &opts);
+  std::string rxfilename;
+  RspecifierType rs = ClassifyRspecifier(rspecifier, &rxfilename, &opts);
   switch (rs) {
     case kScriptRspecifier:
       impl_ = new RandomAccessTableReaderScriptImpl<Holder>();
       break;
     case kArchiveRspecifier:
+      if (ArchiveIndexExists(rxfilename)) {
+        impl_ = new RandomAccessTableReaderIndexedArchiveImpl<Holder>();
+        if (impl_->Open(rspecifier))
+          return true;
+        // A warning will have been printed; read the archive without the
+        // index.
+        delete impl_;
+        impl_ = NULL;
+      }
       if (opts.sorted) {
         if (opts.called_sorted)  // "doubly" sorted case.
           impl_ = new RandomAccessTableReaderDSortedArchiveImpl<Holder>();
@@ -1045,6 +1045,65 @@ void UnitTestTableRandomBothDoubleMatrix(bool binary, bool read_scp,
 }
 
 
+// Writes an archive with an index, in random order, and reads it back with
+// random access in a different random order.
+void UnitTestTableRandomIndexedMatrix(bool binary, bool write_scp) {
+  int32 sz = Rand() % 10;
+  std::vector<std::string> k;
+  std::vector<Matrix<double> > v;
+  for (int32 i = 0; i < sz; i++) {
+    k.push_back("key" + std::to_string(i));
+    v.resize(v.size() + 1);
+    v.back().Resize(1 + Rand() % 3, 1 + Rand() % 3);
+    v.back().SetRandn();
+  }
+  std::vector<int32> order(sz);
+  for (int32 i = 0; i < sz; i++)
+    order[i] = i;
+  RandomizeVector(&order);
+
+  std::string wspecifier = std::string(binary ? "b," : "t,") +
+      (write_scp ? "ark,scp,i:tmpf,tmpf.scp" : "ark,i:tmpf");
+  DoubleMatrixWriter bw(wspecifier);
+  for (int32 i = 0; i < sz; i++)
+    bw.Write(k[order[i]], v[order[i]]);
+  KALDI_ASSERT(bw.Close());
+  KALDI_ASSERT(ArchiveIndexExists("tmpf"));
+
+  RandomAccessDoubleMatrixReader sbr("ark:tmpf");
+  RandomizeVector(&order);
+  for (int32 i = 0; i < sz; i++) {
+    const std::string &key = k[order[i]];
+    if (Rand() % 2 == 0)
+      KALDI_ASSERT(sbr.HasKey(key));
+    KALDI_ASSERT(v[order[i]].ApproxEqual(sbr.Value(key),
+                                         binary ? 1.0e-10 : 0.01));
+  }
+  KALDI_ASSERT(!sbr.HasKey("nosuchkey"));
+  KALDI_ASSERT(sbr.Close());
+
+  // If the archive is truncated while it is open, reading from it must throw
+  // rather than crash.
+  if (sz > 0) {
+    RandomAccessDoubleMatrixReader sbr2("ark:tmpf");
+    KALDI_ASSERT(truncate("tmpf", 0) == 0);
+    bool threw = false;
+    try {
+      sbr2.Value(k[0]);
+    } catch (const KaldiFatalError &e) {
+      threw = true;
+    }
+    KALDI_ASSERT(threw);
+  }
+
+  // Writing the archive again without the index must remove the old index.
+  DoubleMatrixWriter bw2("ark:tmpf");
+  KALDI_ASSERT(bw2.Close());
+  KALDI_ASSERT(!ArchiveIndexExists("tmpf"));
+  unlink("tmpf");
+  unlink("tmpf.scp");
+}
+
 
 }  // end namespace kaldi.
 
@@ -1079,6 +1138,7 @@ int main() {
           }
         }
       }
+      UnitTestTableRandomIndexedMatrix(b, c);
     }
   }
   std::cout << "Test OK.\n";
@@ -71,12 +71,17 @@ typedef std::vector<std::string> KeyList;
 //  p means permissive mode, when writing to an "scp" file only: will ignore
 //     missing scp entries, i.e. won't write anything for those files but will
 //     return success status).
+//  i means write an index of the archive, to the archive's filename with
+//     ".idx" appended; the archive must be an actual file.  Random access
+//     to an archive with an index is fast and needs no sorting, see
+//     kaldi-table-index.h.
 //
 //  So the following are valid wspecifiers:
 //  ark,b,f:foo
 //  "ark,b,b:| gzip -c > foo"
 //  "ark,scp,t,nf:foo.ark,|gzip -c > foo.scp.gz"
 //  ark,b:-
+//  ark,i:foo.ark
 //
 //  The meanings of rxfilename and wxfilename are as described in
 //  kaldi-io.h (they are filenames but include pipes, stdin/stdout
@@ -114,7 +119,9 @@ struct WspecifierOptions {
   bool binary;
   bool flush;
   bool permissive;  // will ignore absent scp entries.
-  WspecifierOptions(): binary(true), flush(false), permissive(false) { }
+  bool index;  // will write an index of the archive.
+  WspecifierOptions(): binary(true), flush(false), permissive(false),
+                       index(false) { }
 };
 
 // ClassifyWspecifier returns the type of the wspecifier string,
@@ -193,6 +200,10 @@ bool WriteScriptFile(std::ostream &os,
 //   b   is ignored [for scripting convenience]
 //   t   is ignored [for scripting convenience]
 //
+//  If a random-access reader is given an rspecifier "ark:filename" where
+//  filename is an actual file that has an index (see the "i" option for
+//  wspecifiers), it uses the index to read the objects directly, and the
+//  options above make no difference.
 //
 //  So for instance the following would be a valid rspecifier:
 //
@@ -107,6 +107,7 @@ void TestTaskSequencer() {
   config.num_threads = 1 + Rand() % 20;
   if (Rand() % 2 == 1 )
     config.num_threads_total = config.num_threads + Rand() % config.num_threads;
+  config.pin_threads = (Rand() % 2 == 0);
 
   int32 num_tasks = Rand() % 100;
 
@@ -115,6 +116,12 @@ void TestTaskSequencer() {
     TaskSequencer<MyTaskClass> sequencer(config);
     for (int32 i = 0; i < num_tasks; i++) {
       sequencer.Run(new MyTaskClass(i, &task_output));
+      if (i == num_tasks / 2) {
+        // Check that Wait() waits for everything so far, and that the
+        // sequencer can be used again afterwards.
+        sequencer.Wait();
+        KALDI_ASSERT(task_output.size() == static_cast<size_t>(i + 1));
+      }
     }
   } // and let "sequencer" be destroyed, which waits for the last threads.
   KALDI_ASSERT(task_output.size() == static_cast<size_t>(num_tasks));
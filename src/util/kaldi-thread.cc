@@ -18,6 +18,10 @@
 // See the Apache 2 License for the specific language governing permissions and
 // limitations under the License.
 
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
 #include "base/kaldi-common.h"
 #include "util/kaldi-thread.h"
 
@@ -28,6 +32,31 @@ MultiThreadable::~MultiThreadable() {
   // default implementation does nothing
 }
 
+bool PinThreadToCpu(int32 index, std::thread *thread) {
+#ifdef __linux__
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+    return false;
+  int32 num_allowed = CPU_COUNT(&allowed);
+  if (num_allowed == 0)
+    return false;
+  int32 n = index % num_allowed;
+  for (int32 cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    if (CPU_ISSET(cpu, &allowed) && n-- == 0) {
+      cpu_set_t set;
+      CPU_ZERO(&set);
+      CPU_SET(cpu, &set);
+      return pthread_setaffinity_np(thread->native_handle(),
+                                    sizeof(set), &set) == 0;
+    }
+  }
+  return false;
+#else
+  return false;
+#endif
+}
+
 
 
 }  // end namespace kaldi
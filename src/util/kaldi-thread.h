@@ -22,8 +22,12 @@
 #ifndef KALDI_THREAD_KALDI_THREAD_H_
 #define KALDI_THREAD_KALDI_THREAD_H_ 1
 
-#include <thread>
 #include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include "itf/options-itf.h"
 #include "util/kaldi-semaphore.h"
 
@@ -43,11 +47,12 @@
 // must be output in the same order they came in. Here, we again accept objects
 // of some class C with an operator () that takes no arguments. C may also have
 // a destructor with side effects (typically some kind of output).
-// TaskSequencer is responsible for running the jobs in parallel. It has a
-// function Run() that will accept a new object of class C; this will block
-// until a thread is free, at which time it will spawn a thread that starts
-// running the operator () of the object. When threads are finished running,
-// the objects will be deleted. TaskSequencer guarantees that the destructors
+// TaskSequencer is responsible for running the jobs in parallel, in a pool of
+// worker threads. It has a function Run() that will accept a new object of
+// class C; this will block if too many jobs are already waiting, and
+// otherwise queues the object for a worker thread, which will run its
+// operator (). When the jobs are finished running, the objects will be
+// deleted. TaskSequencer guarantees that the destructors
 // will be called sequentially (not in parallel) and in the same order the
 // objects were given to the Run() function, so that it is safe for the
 // destructor to have side effects such as outputting data.
@@ -156,37 +161,64 @@ template<class C> void RunMultiThreaded(const C &c_in) {
 struct TaskSequencerConfig {
   int32 num_threads;
   int32 num_threads_total;
-  TaskSequencerConfig(): num_threads(1), num_threads_total(0)  { }
+  bool pin_threads;
+  TaskSequencerConfig(): num_threads(1), num_threads_total(0),
+                         pin_threads(false) { }
   void Register(OptionsItf *opts) {
     opts->Register("num-threads", &num_threads, "Number of actively processing "
                    "threads to run in parallel");
-    opts->Register("num-threads-total", &num_threads_total, "Total number of "
-                   "threads, including those that are waiting on other threads "
-                   "to produce their output.  Controls memory use.  If <= 0, "
+    opts->Register("num-threads-total", &num_threads_total, "Maximum number "
+                   "of tasks in progress at any one time, including those that "
+                   "are waiting to be started or waiting for earlier tasks to "
+                   "produce their output.  Controls memory use.  If <= 0, "
                    "defaults to --num-threads plus 20.  Otherwise, must "
                    "be >= num-threads.");
+    opts->Register("pin-threads", &pin_threads, "If true, pin each worker "
+                   "thread to its own CPU (Linux only).  The CPUs are taken "
+                   "in order from the ones the process is allowed to run on, so "
+                   "you can use e.g. 'numactl --cpunodebind' to choose the "
+                   "NUMA node(s).");
   }
 };
 
+/// Pins 'thread' to the CPU numbered 'index' (modulo the number of CPUs)
+/// among those that this process is allowed to run on.  Returns false if this
+/// is not supported or failed.  Currently only implemented on Linux.
+bool PinThreadToCpu(int32 index, std::thread *thread);
+
 // C should have an operator () taking no arguments, that does some kind
 // of computation, and a destructor that produces some kind of output (the
 // destructors will be run sequentially in the same order Run as called.
+//
+// The tasks are run by a fixed pool of config.num_threads worker threads that
+// is created in the constructor, so there is no cost to create a thread per
+// task.  When a worker finishes a task, it deletes all the finished tasks that
+// are next in line to be output; a flag ensures that only one thread at a
+// time does this, so the destructors never run in parallel.
 template<class C>
 class TaskSequencer {
  public:
   TaskSequencer(const TaskSequencerConfig &config):
       num_threads_(config.num_threads),
-      threads_avail_(config.num_threads),
-      tot_threads_avail_(config.num_threads_total > 0 ? config.num_threads_total :
-                         config.num_threads + 20),
-      thread_list_(NULL) {
+      max_tasks_(config.num_threads_total > 0 ? config.num_threads_total :
+                 config.num_threads + 20),
+      first_seq_(0), next_start_seq_(0),
+      outputting_(false), stop_(false) {
     KALDI_ASSERT((config.num_threads_total <= 0 ||
                   config.num_threads_total >= config.num_threads) &&
                  "num-threads-total, if specified, must be >= num-threads");
+    for (int32 i = 0; i < num_threads_; i++) {
+      threads_.push_back(std::thread(&TaskSequencer<C>::RunWorker, this));
+      if (config.pin_threads && !PinThreadToCpu(i, &(threads_.back())) &&
+          i == 0)
+        KALDI_WARN << "Could not pin threads to CPUs.";
+    }
   }
 
   /// This function takes ownership of the pointer "c", and will delete it
-  /// in the same sequence as Run was called on the jobs.
+  /// in the same sequence as Run was called on the jobs.  It blocks while
+  /// there are already num_threads tasks waiting to be started, or
+  /// num_threads_total tasks in progress.
   void Run(C *c) {
     // run in main thread
     if (num_threads_ == 0) {
@@ -194,90 +226,101 @@ class TaskSequencer {
       delete c;
       return;
     }
-
-    threads_avail_.Wait(); // wait till we have a thread for computation free.
-    tot_threads_avail_.Wait(); // this ensures we don't have too many threads
-    // waiting on I/O, and consume too much memory.
-
-    // put the new RunTaskArgsList object at head of the singly
-    // linked list thread_list_.
-    thread_list_ = new RunTaskArgsList(this, c, thread_list_);
-    thread_list_->thread = std::thread(TaskSequencer<C>::RunTask,
-                                       thread_list_);
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (NumWaiting() >= static_cast<size_t>(num_threads_) ||
+           tasks_.size() >= static_cast<size_t>(max_tasks_))
+      slot_free_.wait(lock);
+    tasks_.push_back(Task(c));
+    task_ready_.notify_one();
   }
 
   void Wait() { // You call this at the end if it's more convenient
     // than waiting for the destructor.  It waits for all tasks to finish.
-    if (thread_list_ != NULL) {
-      thread_list_->thread.join();
-      KALDI_ASSERT(thread_list_->tail == NULL); // thread would not
-      // have exited without setting tail to NULL.
-      delete thread_list_;
-      thread_list_ = NULL;
-    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!tasks_.empty() || outputting_)
+      all_done_.wait(lock);
   }
 
-  /// The destructor waits for the last thread to exit.
+  /// The destructor waits for all the tasks to finish and then stops the
+  /// worker threads.
   ~TaskSequencer() {
     Wait();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    task_ready_.notify_all();
+    for (size_t i = 0; i < threads_.size(); i++)
+      threads_[i].join();
   }
  private:
-  struct RunTaskArgsList {
-    TaskSequencer *me; // Think of this as a "this" pointer.
-    C *c; // Clist element of the task we're expected
-    std::thread thread;
-    RunTaskArgsList *tail;
-    RunTaskArgsList(TaskSequencer *me, C *c, RunTaskArgsList *tail):
-        me(me), c(c), tail(tail) {}
+  struct Task {
+    C *c;
+    bool done;  // true if c's operator () has finished.
+    explicit Task(C *c): c(c), done(false) { }
   };
-  // This static function gets run in the threads that we create.
-  static void RunTask(RunTaskArgsList *args) {
-    // (1) run the job.
-    (*(args->c))(); // call operator () on args->c, which does the computation.
-    args->me->threads_avail_.Signal(); // Signal that the compute-intensive
-    // part of the thread is done (we want to run no more than
-    // config_.num_threads of these.)
-
-    // (2) we want to destroy the object "c" now, by deleting it.  But for
-    //     correct sequencing (this is the whole point of this class, it
-    //     is intended to ensure the output of the program is in correct order),
-    //     we first wait till the previous thread, whose details will be in "tail",
-    //     is finished.
-    if (args->tail != NULL) {
-      args->tail->thread.join();
-    }
 
-    delete args->c; // delete the object "c".  This may cause some output,
-    // e.g. to a stream.  We don't need to worry about concurrent access to
-    // the output stream, because each thread waits for the previous thread
-    // to be done, before doing this.  So there is no risk of concurrent
-    // access.
-    args->c = NULL;
-
-    if (args->tail != NULL) {
-      KALDI_ASSERT(args->tail->tail == NULL); // Because we already
-      // did join on args->tail->thread, which means that
-      // thread was done, and before it exited, it would have
-      // deleted and set to NULL its tail (which is the next line of code).
-      delete args->tail;
-      args->tail = NULL;
+  // Returns the number of tasks that have not been started yet.  Requires
+  // mutex_ to be held.
+  size_t NumWaiting() const {
+    return static_cast<size_t>(first_seq_ + tasks_.size() - next_start_seq_);
+  }
+
+  // This function gets run in the worker threads.
+  void RunWorker() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      while (NumWaiting() == 0 && !stop_)
+        task_ready_.wait(lock);
+      if (NumWaiting() == 0)
+        return;  // stop_ is true and there is nothing left to do.
+      int64 seq = next_start_seq_++;
+      C *c = tasks_[seq - first_seq_].c;
+      slot_free_.notify_one();
+      lock.unlock();
+      (*c)();  // call operator () on c, which does the computation.
+      lock.lock();
+      // tasks_.front() cannot have been removed while we ran the task, since
+      // it would have had to be done, and tasks are removed in order.
+      tasks_[seq - first_seq_].done = true;
+      if (outputting_)
+        continue;  // The thread that is outputting will delete it.
+      outputting_ = true;
+      while (!tasks_.empty() && tasks_.front().done) {
+        C *to_delete = tasks_.front().c;
+        tasks_.pop_front();
+        first_seq_++;
+        lock.unlock();
+        delete to_delete;  // This may cause some output, e.g. to a stream.
+        // There is no risk of concurrent access to the output, since only
+        // the thread that set outputting_ gets here.
+        lock.lock();
+        slot_free_.notify_one();
+      }
+      outputting_ = false;
+      if (tasks_.empty())
+        all_done_.notify_all();
     }
-    // At this point we are exiting from the thread.  Signal the
-    // "tot_threads_avail_" semaphore which is used to limit the total number of threads that are alive, including
-    // not onlhy those that are in active computation in c->operator (), but those
-    // that are waiting on I/O or other threads.
-    args->me->tot_threads_avail_.Signal();
   }
 
-  int32 num_threads_; // copy of config.num_threads (since Semaphore doesn't store original count)
+  int32 num_threads_; // copy of config.num_threads.
+  int32 max_tasks_;  // the maximum size of tasks_.
 
-  Semaphore threads_avail_; // Initialized to the number of threads we are
-  // supposed to run with; the function Run() waits on this.
+  std::mutex mutex_;  // protects all the variables below.
+  std::condition_variable task_ready_;  // signaled when a task is added.
+  std::condition_variable slot_free_;  // signaled when a task starts or is
+                                       // deleted.
+  std::condition_variable all_done_;  // signaled when tasks_ becomes empty.
 
-  Semaphore tot_threads_avail_; // We use this semaphore to ensure we don't
-  // consume too much memory...
-  RunTaskArgsList *thread_list_;
+  // The tasks in progress, in the order that Run() was called; the front one
+  // is the next one to be deleted.
+  std::deque<Task> tasks_;
+  int64 first_seq_;  // The sequence number of tasks_.front().
+  int64 next_start_seq_;  // The sequence number of the next task to start.
+  bool outputting_;  // true while a thread is deleting finished tasks.
+  bool stop_;  // set in the destructor, to make the workers exit.
 
+  std::vector<std::thread> threads_;
 };
 
 } // namespace kaldi
@@ -0,0 +1,79 @@
+// util/pool-allocator-test.cc
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "util/pool-allocator.h"
+#include <set>
+
+namespace kaldi {
+
+struct TestObject {
+  int32 a;
+  double b;
+  TestObject *next;
+  TestObject(int32 a, double b, TestObject *next): a(a), b(b), next(next) { }
+};
+
+void TestPoolAllocator() {
+  size_t block_size = 1 + Rand() % 20;
+  PoolAllocator<TestObject> pool(block_size);
+
+  for (int32 iter = 0; iter < 5; iter++) {
+    std::vector<TestObject*> live;
+    size_t peak = 0;
+    for (int32 i = 0; i < 500; i++) {
+      if (!live.empty() && Rand() % 3 == 0) {
+        size_t j = Rand() % live.size();
+        pool.Delete(live[j]);
+        live[j] = live.back();
+        live.pop_back();
+      } else {
+        TestObject *prev = (live.empty() ? NULL : live.back());
+        live.push_back(pool.New(i, 0.5 * i, prev));
+        KALDI_ASSERT(live.back()->a == i && live.back()->next == prev);
+      }
+      KALDI_ASSERT(pool.NumInUse() == live.size());
+      peak = std::max(peak, live.size());
+    }
+    // all live objects are distinct and intact.
+    std::set<TestObject*> distinct(live.begin(), live.end());
+    KALDI_ASSERT(distinct.size() == live.size());
+    for (size_t j = 0; j < live.size(); j++)
+      KALDI_ASSERT(live[j]->b == 0.5 * live[j]->a);
+    KALDI_ASSERT(pool.PeakInUse() >= peak);
+
+    size_t memory = pool.MemoryInBytes();
+    pool.Reset();
+    KALDI_ASSERT(pool.NumInUse() == 0);
+    // Allocating again up to the previous peak must not need more memory.
+    for (size_t j = 0; j < peak; j++)
+      pool.New(0, 0.0, static_cast<TestObject*>(NULL));
+    KALDI_ASSERT(pool.MemoryInBytes() == memory);
+    pool.Reset();
+  }
+}
+
+}  // end namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  for (int32 i = 0; i < 10; i++)
+    TestPoolAllocator();
+  std::cout << "Test OK.\n";
+}
@@ -0,0 +1,139 @@
+// util/pool-allocator.h
+
+// Copyright 2026  agent
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef KALDI_UTIL_POOL_ALLOCATOR_H_
+#define KALDI_UTIL_POOL_ALLOCATOR_H_
+#include <vector>
+#include <new>
+#include <utility>
+#include <type_traits>
+#include "base/kaldi-common.h"
+
+
+/* This header provides a simple allocator for large numbers of small objects
+   of a single type, such as the tokens and forward-links of the decoders.
+   Objects are carved out of large blocks, and freed objects are kept on a
+   free list for reuse, so allocation and deallocation are a few instructions
+   each instead of a call to malloc/free.  When all the objects are known to be
+   dead (e.g. at the start of a new utterance), Reset() reclaims all of them in
+   one go, without visiting them.  The memory is only given back to the system
+   when the object is destroyed.
+
+   See pool-allocator-test.cc for an example of how to use this object.
+*/
+
+
+namespace kaldi {
+
+template<class T> class PoolAllocator {
+ public:
+  /// 'block_size' is the number of objects allocated at a time.
+  explicit PoolAllocator(size_t block_size = 1024):
+      block_size_(block_size), free_head_(NULL),
+      cur_block_(0), next_in_block_(block_size),
+      num_in_use_(0), peak_in_use_(0) {
+    KALDI_ASSERT(block_size > 0);
+  }
+
+  /// Like 'new T(args...)'.
+  template<typename... Args>
+  inline T *New(Args&&... args) {
+    Slot *slot = free_head_;
+    if (slot != NULL) {
+      free_head_ = slot->next;
+    } else {
+      if (next_in_block_ == block_size_)
+        NextBlock();
+      slot = blocks_[cur_block_] + next_in_block_++;
+    }
+    if (++num_in_use_ > peak_in_use_)
+      peak_in_use_ = num_in_use_;
+    return new (static_cast<void*>(slot)) T(std::forward<Args>(args)...);
+  }
+
+  /// Like 'delete t', for a 't' obtained from New().
+  inline void Delete(T *t) {
+    t->~T();
+    Slot *slot = reinterpret_cast<Slot*>(t);
+    slot->next = free_head_;
+    free_head_ = slot;
+    num_in_use_--;
+  }
+
+  /// Reclaims all the objects obtained from New() at once, without calling
+  /// their destructors (so it is only available for trivially destructible
+  /// types).  The memory is kept for reuse.
+  void Reset() {
+    static_assert(std::is_trivially_destructible<T>::value,
+                  "PoolAllocator::Reset() requires a trivially destructible "
+                  "type.");
+    free_head_ = NULL;
+    cur_block_ = 0;
+    next_in_block_ = (blocks_.empty() ? block_size_ : 0);
+    num_in_use_ = 0;
+  }
+
+  /// Returns the number of objects currently allocated.
+  size_t NumInUse() const { return num_in_use_; }
+
+  /// Returns the largest number of objects that were ever allocated at the
+  /// same time.
+  size_t PeakInUse() const { return peak_in_use_; }
+
+  /// Returns the number of bytes of memory held by this object.
+  size_t MemoryInBytes() const {
+    return blocks_.size() * block_size_ * sizeof(Slot);
+  }
+
+  ~PoolAllocator() {
+    for (size_t i = 0; i < blocks_.size(); i++)
+      delete [] blocks_[i];
+  }
+
+ private:
+  union Slot {
+    Slot *next;  // next in the free list, while not allocated.
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+  };
+
+  // Moves to the next block, allocating it if we have never been this far
+  // (blocks are reused after Reset()).
+  void NextBlock() {
+    if (!blocks_.empty())
+      cur_block_++;
+    if (cur_block_ == blocks_.size())
+      blocks_.push_back(new Slot[block_size_]);
+    next_in_block_ = 0;
+  }
+
+  size_t block_size_;
+  std::vector<Slot*> blocks_;  // the allocated blocks.
+  Slot *free_head_;  // head of the list of freed objects.
+  size_t cur_block_;  // index into blocks_ of the block we are carving from.
+  size_t next_in_block_;  // next unused slot in blocks_[cur_block_].
+  size_t num_in_use_;
+  size_t peak_in_use_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(PoolAllocator);
+};
+
+}  // end namespace kaldi
+
+#endif  // KALDI_UTIL_POOL_ALLOCATOR_H_